@@ -80,6 +80,7 @@ int xdp_prog(struct xdp_md *ctx)
 		return XDP_ABORTED;
 
 	parser_ctx->ctx.frame_num = 0;
+	parser_ctx->ctx.num_encaps = 0;
 	parser_ctx->ctx.next = CODE_IGNORE;
 	parser_ctx->ctx.metadata = parser_ctx->frame;
 	parser_ctx->ctx.parser = xdp2_parser_simple_tuple;
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Common definition of VXLAN flow tracker context */
+
+#ifndef __SAMPLES_XDP_FLOW_TRACKER_VXLAN_COMMON__
+#define __SAMPLES_XDP_FLOW_TRACKER_VXLAN_COMMON__
+
+#include "xdp2/parser.h"
+#include "xdp2/parser_metadata.h"
+#include "xdp2/proto_defs_define.h"
+#include "xdp2/utility.h"
+
+/* One metadata frame for the outer headers and one for the headers
+ * encapsulated in VXLAN
+ */
+#define FLOW_TRACKER_NUM_FRAMES 2
+
+struct flow_tracker_ctx {
+	struct xdp2_xdp_ctx ctx;
+	struct xdp2_metadata_all frame[FLOW_TRACKER_NUM_FRAMES];
+};
+
+#endif /* __SAMPLES_XDP_FLOW_TRACKER_VXLAN_COMMON__ */
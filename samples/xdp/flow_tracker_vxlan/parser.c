@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Parser for Ethernet, IPv4, UDP, and VXLAN with an encapsulated Ethernet,
+ * IPv4, and TCP or UDP. The VXLAN node is an encapsulation protocol so the
+ * inner headers are written to the second metadata frame
+ */
+
+#include "common.h"
+
+/* Meta data functions for parser nodes. Use the canned templates
+ * for common metadata
+ */
+
+XDP2_METADATA_TEMP_ether(ether_metadata, xdp2_metadata_all)
+XDP2_METADATA_TEMP_ipv4(ipv4_metadata, xdp2_metadata_all)
+XDP2_METADATA_TEMP_ports(ports_metadata, xdp2_metadata_all)
+
+/* Save the VNI in the outer frame. The frame is advanced after the
+ * VXLAN header has been processed
+ */
+static void vxlan_metadata(const void *vvxh, size_t hdr_len, void *imetadata,
+			   void *iframe, const struct xdp2_ctrl_data *ctrl)
+{
+	struct xdp2_metadata_all *frame = iframe;
+
+	frame->keyid = ((struct vxlanhdr *)vvxh)->vx_vni;
+}
+
+/* Parse nodes. Parse nodes are composed of the common XDP2 Parser protocol
+ * nodes, metadata functions defined above, and protocol tables defined
+ * below
+ */
+
+XDP2_MAKE_PARSE_NODE(ether_node, xdp2_parse_ether, ether_table,
+		     (.ops.extract_metadata = ether_metadata));
+XDP2_MAKE_PARSE_NODE(ip_check_node, xdp2_parse_ip, ip_check_table, ());
+XDP2_MAKE_PARSE_NODE(ipv4_node, xdp2_parse_ipv4, ipv4_table,
+		     (.ops.extract_metadata = ipv4_metadata));
+XDP2_MAKE_PARSE_NODE(udp_node, xdp2_parse_udp, udp_table,
+		     (.ops.extract_metadata = ports_metadata));
+XDP2_MAKE_PARSE_NODE(vxlan_node, xdp2_parse_vxlan, vxlan_table,
+		     (.ops.extract_metadata = vxlan_metadata));
+XDP2_MAKE_LEAF_PARSE_NODE(ports_node, xdp2_parse_ports,
+			  (.ops.extract_metadata = ports_metadata));
+
+/* Protocol tables */
+
+XDP2_MAKE_PROTO_TABLE(ether_table,
+		      ( __cpu_to_be16(ETH_P_IP), ip_check_node )
+);
+
+XDP2_MAKE_PROTO_TABLE(ip_check_table,
+		      ( 4, ipv4_node )
+);
+
+XDP2_MAKE_PROTO_TABLE(ipv4_table,
+		      ( IPPROTO_TCP, ports_node ),
+		      ( IPPROTO_UDP, udp_node )
+);
+
+XDP2_MAKE_PROTO_TABLE(udp_table,
+		      ( __cpu_to_be16(4789), vxlan_node )
+);
+
+XDP2_MAKE_PROTO_TABLE(vxlan_table,
+		      ( ETH_P_TEB, ether_node )
+);
+
+XDP2_PARSER(xdp2_parser_vxlan_tuple, "XDP2 parser for VXLAN 5 tuple",
+	    ether_node,
+	    (.max_frames = FLOW_TRACKER_NUM_FRAMES,
+	     .max_encaps = 1,
+	     .metameta_size = 0,
+	     .frame_size = sizeof(struct xdp2_metadata_all)
+	    )
+);
@@ -8,9 +8,15 @@
 //-----------------------------------------------------------------------------
 // Platform-specific functions and macros
 #include <linux/types.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
+#include "crc/crc16.h"
+#include "crc/crc32c.h"
+#include "crc/crc64.h"
+#include "xdp2/pvbuf.h"
+
 #define CRC64     3
 #define CRC16     1
 #define CRC32     2
@@ -23,6 +29,78 @@
 /* DSA Changes */
 __u64 crc_dsa(unsigned char bitw, __u64 crc, const void *data, size_t len);
 
-// TODO: Support pvbuf changes for crc
+/* Compute a CRC over a pvbuf or pbuf */
+
+struct __crc_pvbuf_iter {
+	unsigned char bitw;
+	size_t len;
+	size_t offset;
+	__u64 crc;
+};
+
+static inline bool __crc_pvbuf_iterate(void *priv, __u8 *data, size_t len)
+{
+	struct __crc_pvbuf_iter *ist = priv;
+	bool done = false;
+
+	if (ist->offset) {
+		if (len <= ist->offset) {
+			ist->offset -= len;
+			return true;
+		}
+		data += ist->offset;
+		len -= ist->offset;
+
+		ist->offset = 0;
+	}
+
+	if (ist->len) {
+		len = len < ist->len ? len : ist->len;
+		ist->len -= len;
+		done = !ist->len;
+	}
+
+	switch (ist->bitw) {
+	case CRC16:
+		ist->crc = crc16_update(ist->crc, data, len);
+		break;
+	case CRC32:
+		ist->crc = crc32c(ist->crc, data, len);
+		break;
+	case CRC64:
+		ist->crc = crc64(ist->crc, data, len);
+		break;
+	}
+
+	return !done;
+}
+
+/* Continue the CRC of type bitw (CRC16, CRC32 for CRC-32C, or CRC64) from
+ * crc over len bytes of a pvbuf starting at offset. A len of zero covers
+ * the rest of the pvbuf. Chaining works the same as for the flat buffer
+ * functions
+ */
+static inline __u64 __crc_pvbuf(struct xdp2_pvbuf_mgr *pvmgr,
+				unsigned char bitw, __u64 crc,
+				xdp2_paddr_t paddr, size_t len, size_t offset)
+{
+	struct __crc_pvbuf_iter ist = {
+		.bitw = bitw,
+		.len = len,
+		.offset = offset,
+		.crc = crc,
+	};
+
+	__xdp2_pvbuf_iterate(pvmgr, paddr, __crc_pvbuf_iterate, &ist);
+
+	return ist.crc;
+}
+
+static inline __u64 crc_pvbuf(unsigned char bitw, __u64 crc,
+			      xdp2_paddr_t paddr, size_t len, size_t offset)
+{
+	return __crc_pvbuf(&xdp2_pvbuf_global_mgr, bitw, crc, paddr,
+			   len, offset);
+}
 
 #endif // CRC_H
@@ -2,10 +2,27 @@
 #define CRC16_H
 
 #include <linux/types.h>
+#include <stddef.h>
 
 /* crc16.h */
 
 /* Return the CRC-16 of buf[0..len-1] */
 __u16 crc16(const char *buf, int len);
 
+/* Continue a CRC-16 over buf[0..len-1] starting from crc (zero for the
+ * first chunk)
+ */
+__u16 crc16_update(__u16 crc, const void *buf, size_t len);
+
+/* Name of the implementation in use ("sw" or "pclmul") */
+extern const char *crc16_impl;
+
+/* Select the fastest implementation for the CPU. The software version is
+ * used until this is called
+ */
+void crc16_init(void);
+
+/* Table-driven version, exposed for testing and benchmarking */
+__u16 crc16_sw(__u16 crc, const void *buf, size_t len);
+
 #endif    /* CRC16_H */
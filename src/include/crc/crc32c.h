@@ -16,6 +16,11 @@
 typedef __u32 (*crc_func)(__u32 crc, const void *buf, size_t len);
 extern crc_func crc32c;
 
+// Name of the implementation crc32c() currently points to ("sw" or "sse4.2")
+extern const char *crc32c_impl;
+
+// Select the fastest implementation for the CPU. crc32c() is the software
+// version until this is called
 void crc32c_init(void);
 
 // Expose a prototype for the crc32c software variant simply for testing purposes
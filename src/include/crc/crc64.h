@@ -4,11 +4,18 @@
 #include <linux/types.h>
 #include <stdint.h>
 
+/* Name of the implementation crc64() uses ("sw" or "pclmul") */
+extern const char *crc64_impl;
+
+/* Build the tables and select the fastest implementation for the CPU. Must
+ * be called before crc64()
+ */
 void crc64_init(void);
 __u64 crc64(__u64 crc, const void *s, size_t l);
 __u64 crc64_dsa(__u64 crc, const void *s, size_t l);
 
-__u64 crc16(const void *s, size_t l);
+/* Table-driven version, exposed for testing and benchmarking */
+__u64 crc64_sw(__u64 crc, const void *s, size_t l);
 
 #ifdef REDIS_TEST
 int crc64Test(int argc, char *argv[], int flags);
@@ -30,10 +30,12 @@
 /* Falon implementation definitions */
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <netinet/in.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/queue.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -44,6 +46,7 @@
 #include "xdp2/locks.h"
 #include "xdp2/timer.h"
 #include "xdp2/udp_comm.h"
+#include "xdp2/utility.h"
 
 struct falcon_instance;
 
@@ -412,8 +415,23 @@ struct falcon_conn {
 	struct falcon_conn_stats conn_stats;
 	struct falcon_conn_initiator_stats initiator_stats;
 	struct falcon_conn_target_stats target_stats;
+
+	/**** Lookup ****/
+
+	/* Linkage in the instance { remote, dport, protocol type } hash
+	 * table
+	 */
+	LIST_ENTRY(falcon_conn) remote_hash_link;
+
+	/* Linkage in the instance { remote, remote CID } hash table. A
+	 * connection is in this table once its remote CID is known
+	 */
+	LIST_ENTRY(falcon_conn) rcid_hash_link;
+	bool in_rcid_hash;
 };
 
+LIST_HEAD(falcon_conn_hash_head, falcon_conn);
+
 #define FALCON_MAX_CONNS 1024
 
 struct falcon_instance_stats {
@@ -444,13 +462,185 @@ struct falcon_instance {
 
 	struct falcon_instance_stats stats;
 
+	/* Hash tables of connections keyed by { remote, dport, protocol
+	 * type } and by { remote, remote CID }. The number of buckets in
+	 * each is conn_hash_mask + 1 (a power of two)
+	 */
+	unsigned int conn_hash_mask;
+	struct falcon_conn_hash_head *conn_remote_hash;
+	struct falcon_conn_hash_head *conn_rcid_hash;
+
 	struct falcon_conn *conns[];
 };
 
+/* Connection hash tables
+ *
+ * Received packets carry our local CID and are looked up by indexing
+ * conns[]. Finding a connection by its remote attributes (to reuse a
+ * connection to a destination, or to match the peer's CID) is done by
+ * hashing into one of the instance hash tables
+ */
+
+static inline __u64 __falcon_conn_remote_key(struct in_addr remote,
+					     unsigned short dport,
+					     enum falcon_protocol_type
+							protocol_type)
+{
+	return ((__u64)remote.s_addr << 32) | ((__u64)dport << 16) |
+	       (protocol_type & 0xffff);
+}
+
+static inline __u64 __falcon_conn_rcid_key(struct in_addr remote,
+					   __u32 remote_cid)
+{
+	return ((__u64)remote.s_addr << 32) | remote_cid;
+}
+
+static inline struct falcon_conn_hash_head *__falcon_conn_hash_bucket(
+		struct falcon_instance *instance,
+		struct falcon_conn_hash_head *table, __u64 key)
+{
+	return &table[xdp2_hash_mix64(key) & instance->conn_hash_mask];
+}
+
+/* Allocate the connection hash tables for an instance. The tables are
+ * sized to the next power of two of max_conns. Returns zero on success
+ * or -ENOMEM
+ */
+static inline int falcon_instance_conn_hash_init(
+		struct falcon_instance *instance)
+{
+	unsigned int num_buckets = XDP2_ROUND_POW_TWO(instance->max_conns);
+	unsigned int i;
+
+	instance->conn_remote_hash = calloc(num_buckets,
+					sizeof(*instance->conn_remote_hash));
+	instance->conn_rcid_hash = calloc(num_buckets,
+					sizeof(*instance->conn_rcid_hash));
+	if (!instance->conn_remote_hash || !instance->conn_rcid_hash) {
+		free(instance->conn_remote_hash);
+		free(instance->conn_rcid_hash);
+		instance->conn_remote_hash = NULL;
+		instance->conn_rcid_hash = NULL;
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < num_buckets; i++) {
+		LIST_INIT(&instance->conn_remote_hash[i]);
+		LIST_INIT(&instance->conn_rcid_hash[i]);
+	}
+
+	instance->conn_hash_mask = num_buckets - 1;
+
+	return 0;
+}
+
+static inline void falcon_instance_conn_hash_fini(
+		struct falcon_instance *instance)
+{
+	free(instance->conn_remote_hash);
+	free(instance->conn_rcid_hash);
+	instance->conn_remote_hash = NULL;
+	instance->conn_rcid_hash = NULL;
+	instance->conn_hash_mask = 0;
+}
+
+/* Insert a connection in the instance's conns[] array and hash tables.
+ * The connection's remote, dport, protocol_type, and instance must be
+ * set. If remote_cid is non-zero the connection is also hashed by
+ * remote CID
+ */
+static inline void falcon_conn_hash_insert(struct falcon_instance *instance,
+					   struct falcon_conn *conn)
+{
+	instance->conns[conn->local_cid] = conn;
+
+	LIST_INSERT_HEAD(__falcon_conn_hash_bucket(instance,
+			instance->conn_remote_hash,
+			__falcon_conn_remote_key(conn->remote, conn->dport,
+						 conn->protocol_type)),
+			 conn, remote_hash_link);
+
+	if (conn->remote_cid) {
+		LIST_INSERT_HEAD(__falcon_conn_hash_bucket(instance,
+				instance->conn_rcid_hash,
+				__falcon_conn_rcid_key(conn->remote,
+						       conn->remote_cid)),
+				 conn, rcid_hash_link);
+		conn->in_rcid_hash = true;
+	}
+}
+
+/* Remove a connection from the instance's conns[] array and hash tables */
+static inline void falcon_conn_hash_remove(struct falcon_instance *instance,
+					   struct falcon_conn *conn)
+{
+	LIST_REMOVE(conn, remote_hash_link);
+
+	if (conn->in_rcid_hash) {
+		LIST_REMOVE(conn, rcid_hash_link);
+		conn->in_rcid_hash = false;
+	}
+
+	instance->conns[conn->local_cid] = NULL;
+}
+
 static inline void falcon_set_remote_cid(struct falcon_instance *instance,
 					 __u32 local_cid, __u32 remote_cid)
 {
-	instance->conns[local_cid]->remote_cid = remote_cid;
+	struct falcon_conn *conn = instance->conns[local_cid];
+
+	if (conn->in_rcid_hash)
+		LIST_REMOVE(conn, rcid_hash_link);
+
+	conn->remote_cid = remote_cid;
+
+	LIST_INSERT_HEAD(__falcon_conn_hash_bucket(instance,
+			instance->conn_rcid_hash,
+			__falcon_conn_rcid_key(conn->remote, remote_cid)),
+			 conn, rcid_hash_link);
+	conn->in_rcid_hash = true;
+}
+
+/* Lookup a connection to a destination for a protocol type */
+static inline struct falcon_conn *falcon_lookup_conn(
+		struct falcon_instance *instance, struct in_addr remote,
+		unsigned short dport,
+		enum falcon_protocol_type protocol_type)
+{
+	struct falcon_conn_hash_head *head;
+	struct falcon_conn *conn;
+
+	head = __falcon_conn_hash_bucket(instance, instance->conn_remote_hash,
+			__falcon_conn_remote_key(remote, dport,
+						 protocol_type));
+
+	LIST_FOREACH(conn, head, remote_hash_link)
+		if (conn->remote.s_addr == remote.s_addr &&
+		    conn->dport == dport &&
+		    conn->protocol_type == protocol_type)
+			return conn;
+
+	return NULL;
+}
+
+/* Lookup a connection by the peer's address and CID */
+static inline struct falcon_conn *falcon_lookup_conn_by_remote_cid(
+		struct falcon_instance *instance, struct in_addr remote,
+		__u32 remote_cid)
+{
+	struct falcon_conn_hash_head *head;
+	struct falcon_conn *conn;
+
+	head = __falcon_conn_hash_bucket(instance, instance->conn_rcid_hash,
+			__falcon_conn_rcid_key(remote, remote_cid));
+
+	LIST_FOREACH(conn, head, rcid_hash_link)
+		if (conn->remote.s_addr == remote.s_addr &&
+		    conn->remote_cid == remote_cid)
+			return conn;
+
+	return NULL;
 }
 
 /* Functions to create and send Falcon packets */
@@ -35,6 +35,7 @@
 
 #include "xdp2/utility.h"
 #include "siphash/siphash.h"
+#include "xdp2/hash.h"
 
 struct parselite_metadata {
 	__u8 addr_type;
@@ -137,6 +138,17 @@ bool parselite_parse(void *hdr, size_t len,
 		     unsigned int start_mode_mode);
 
 void parselite_hash_secret_init(siphash_key_t *init_key);
+
+/* Set the hash algorithm used by parselite_compute_hash (see
+ * xdp2/hash.h). The default is XDP2_HASH_SIPHASH
+ */
+void parselite_hash_set_algo(enum xdp2_hash_algo algo);
+
+/* Set the key for XDP2_HASH_TOEPLITZ. The default is the RSS key from the
+ * Microsoft RSS specification
+ */
+void parselite_hash_set_toeplitz_key(const __u8 *key);
+
 void parselite_print_metadata(struct parselite_metadata *metadata);
 void parselite_print_hash_input(struct parselite_metadata *metadata);
 
@@ -202,13 +214,15 @@ static inline size_t parselite_hash_length(
 	return sizeof(*metadata) - diff;
 }
 
-extern siphash_key_t __parselite_hash_key;
+extern struct xdp2_hash_key __parselite_hash_key;
+extern enum xdp2_hash_algo __parselite_hash_algo;
 
 static inline __u32 parselite_compute_hash(const void *start, size_t len)
 {
 	__u32 hash;
 
-	hash = siphash(start, len, &__parselite_hash_key);
+	hash = xdp2_hash(__parselite_hash_algo, start, len,
+			 &__parselite_hash_key);
 	if (!hash)
 		hash = 1;
 
@@ -29,9 +29,15 @@
 
 /* Definitions for UET protocol implementation */
 
-#include "xdp2/bitmap.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+
+#include "xdp2/id_alloc.h"
 #include "xdp2/timer.h"
 #include "xdp2/udp_comm.h"
+#include "xdp2/utility.h"
 
 #include "uet/debug.h"
 
@@ -118,8 +124,21 @@ struct uet_pdc {
 
 	/* PDC stats */
 	struct uet_pdc_stats stats;
+
+	/* Linkage in the fep initiator tuple hash table. Only initiator
+	 * PDCs are in this table
+	 */
+	LIST_ENTRY(uet_pdc) init_hash_link;
+
+	/* Linkage in the fep { remote FA, remote PDCID } hash table. A
+	 * PDC is in this table once its remote PDCID is known
+	 */
+	LIST_ENTRY(uet_pdc) rpdcid_hash_link;
+	bool in_rpdcid_hash;
 };
 
+LIST_HEAD(uet_pdc_hash_head, uet_pdc);
+
 #define UET_PDC_STATS_BUMP(PDC, NAME) do {			\
 	struct uet_pdc *_pdc = PDC;				\
 								\
@@ -156,8 +175,19 @@ struct uet_fep {
 	/* Statistics */
 	struct uet_fep_stats stats;
 
-	/* Bitmap of allocated PDCs */
-	unsigned long *pdc_alloc_map;
+	/* Allocator of PDC indices, PDCID is the index plus one. Initialized
+	 * to max_pdcs IDs
+	 */
+	struct xdp2_id_alloc pdc_ids;
+
+	/* Hash tables of open PDCs keyed by the initiator tuple
+	 * { remote FA, port, PDC type, TC } and by { remote FA, remote
+	 * PDCID }. The number of buckets in each is pdc_hash_mask + 1
+	 * (a power of two). Maintained by uet_pdc_open and uet_pdc_close
+	 */
+	unsigned int pdc_hash_mask;
+	struct uet_pdc_hash_head *pdc_init_hash;
+	struct uet_pdc_hash_head *pdc_rpdcid_hash;
 
 	/* PDCs, number indicated by max_pdcs */
 	struct uet_pdc pdcs[];
@@ -171,26 +201,177 @@ struct uet_fep {
 
 struct uet_fep *uet_create_fep(void);
 
+/* PDC hash tables
+ *
+ * Lookups on connection setup (initiator requests and SYN packets) are
+ * done by hashing the lookup tuple into one of the two fep hash tables
+ * instead of scanning every allocated PDC
+ */
+
+static inline __u64 __uet_pdc_init_key(struct in_addr dest, __be16 port,
+				       enum uet_pdc_type pdc_type,
+				       __u8 traffic_class)
+{
+	return ((__u64)dest.s_addr << 32) | ((__u64)port << 16) |
+	       ((__u64)(pdc_type & 0xff) << 8) | traffic_class;
+}
+
+static inline __u64 __uet_pdc_rpdcid_key(struct in_addr address,
+					 __be16 pdcid)
+{
+	return ((__u64)address.s_addr << 32) | pdcid;
+}
+
+static inline struct uet_pdc_hash_head *__uet_pdc_hash_bucket(
+		struct uet_fep *fep, struct uet_pdc_hash_head *table,
+		__u64 key)
+{
+	return &table[xdp2_hash_mix64(key) & fep->pdc_hash_mask];
+}
+
+/* Allocate the PDC hash tables for a fep. The tables are sized to the
+ * next power of two of max_pdcs so that the average chain length is
+ * at most one. Returns zero on success or -ENOMEM
+ */
+static inline int uet_fep_pdc_hash_init(struct uet_fep *fep)
+{
+	unsigned int num_buckets = XDP2_ROUND_POW_TWO(fep->max_pdcs);
+	unsigned int i;
+
+	fep->pdc_init_hash = calloc(num_buckets,
+				    sizeof(*fep->pdc_init_hash));
+	fep->pdc_rpdcid_hash = calloc(num_buckets,
+				      sizeof(*fep->pdc_rpdcid_hash));
+	if (!fep->pdc_init_hash || !fep->pdc_rpdcid_hash) {
+		free(fep->pdc_init_hash);
+		free(fep->pdc_rpdcid_hash);
+		fep->pdc_init_hash = NULL;
+		fep->pdc_rpdcid_hash = NULL;
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < num_buckets; i++) {
+		LIST_INIT(&fep->pdc_init_hash[i]);
+		LIST_INIT(&fep->pdc_rpdcid_hash[i]);
+	}
+
+	fep->pdc_hash_mask = num_buckets - 1;
+
+	return 0;
+}
+
+static inline void uet_fep_pdc_hash_fini(struct uet_fep *fep)
+{
+	free(fep->pdc_init_hash);
+	free(fep->pdc_rpdcid_hash);
+	fep->pdc_init_hash = NULL;
+	fep->pdc_rpdcid_hash = NULL;
+	fep->pdc_hash_mask = 0;
+}
+
+/* Set the remote PDCID of a PDC and (re)hash it in the remote PDCID
+ * table. For an initiator PDC this is called when the target's PDCID
+ * is learned from the first response
+ */
+static inline void uet_pdc_set_remote_pdcid(struct uet_pdc *pdc,
+					    __be16 remote_pdcid)
+{
+	struct uet_fep *fep = pdc->fep;
+
+	if (pdc->in_rpdcid_hash)
+		LIST_REMOVE(pdc, rpdcid_hash_link);
+
+	pdc->remote_pdcid = remote_pdcid;
+
+	LIST_INSERT_HEAD(__uet_pdc_hash_bucket(fep, fep->pdc_rpdcid_hash,
+			__uet_pdc_rpdcid_key(pdc->remote_fa, remote_pdcid)),
+			 pdc, rpdcid_hash_link);
+	pdc->in_rpdcid_hash = true;
+}
+
+/* Open a PDC. A free PDC is allocated from the fep and is inserted in the
+ * lookup hash tables. remote_pdcid is zero for an initiator PDC whose
+ * target PDCID isn't known yet. Returns NULL if all PDCs are in use
+ */
+static inline struct uet_pdc *uet_pdc_open(struct uet_fep *fep,
+		struct in_addr local_fa, struct in_addr remote_fa,
+		__be16 remote_port, enum uet_pdc_type pdc_type,
+		__u8 traffic_class, bool initiator, __be16 remote_pdcid)
+{
+	struct uet_pdc *pdc;
+	unsigned int i;
+
+	i = xdp2_id_alloc_get(&fep->pdc_ids);
+	if (i >= fep->max_pdcs)
+		return NULL;
+
+	pdc = &fep->pdcs[i];
+	memset(pdc, 0, sizeof(*pdc));
+
+	pdc->fep = fep;
+	pdc->type = pdc_type;
+	pdc->initiator = initiator;
+	pdc->traffic_class = traffic_class;
+	pdc->local_fa = local_fa;
+	pdc->remote_fa = remote_fa;
+	pdc->remote_port = remote_port;
+	pdc->local_pdcid = htons(i + 1);
+	pdc->state = UET_PDC_STATE_OPENING;
+
+	if (initiator)
+		LIST_INSERT_HEAD(__uet_pdc_hash_bucket(fep,
+				fep->pdc_init_hash,
+				__uet_pdc_init_key(remote_fa, remote_port,
+						   pdc_type, traffic_class)),
+				 pdc, init_hash_link);
+
+	if (remote_pdcid)
+		uet_pdc_set_remote_pdcid(pdc, remote_pdcid);
+
+	return pdc;
+}
+
+/* Close a PDC. The PDC is removed from the lookup hash tables and is
+ * returned to the fep
+ */
+static inline void uet_pdc_close(struct uet_pdc *pdc)
+{
+	struct uet_fep *fep = pdc->fep;
+
+	if (pdc->initiator)
+		LIST_REMOVE(pdc, init_hash_link);
+
+	if (pdc->in_rpdcid_hash) {
+		LIST_REMOVE(pdc, rpdcid_hash_link);
+		pdc->in_rpdcid_hash = false;
+	}
+
+	pdc->state = UET_PDC_STATE_CLOSED;
+
+	xdp2_id_alloc_clear(&fep->pdc_ids, ntohs(pdc->local_pdcid) - 1);
+}
+
 /* Lookup a PDC based on the parameters of an initiator request */
 static inline struct uet_pdc *uet_pdc_get_pdc_from_initiator_request(
 		struct uet_fep *fep, struct in_addr src,
 		struct in_addr dest, __be16 port,
 		enum uet_pdc_type pdc_type, __u8 traffic_class)
 {
+	struct uet_pdc_hash_head *head;
 	struct uet_pdc *pdc;
-	int i;
 
-	i = 0;
-	xdp2_bitmap_foreach_bit(fep->pdc_alloc_map, i, fep->max_pdcs) {
-		pdc = &fep->pdcs[i];
+	head = __uet_pdc_hash_bucket(fep, fep->pdc_init_hash,
+			__uet_pdc_init_key(dest, port, pdc_type,
+					   traffic_class));
 
-		if (pdc && pdc->initiator &&
-		    pdc->remote_fa.s_addr == dest.s_addr &&
+	LIST_FOREACH(pdc, head, init_hash_link) {
+		if (pdc->remote_fa.s_addr == dest.s_addr &&
 		    pdc->remote_port == port && pdc->type == pdc_type &&
 		    pdc->traffic_class == traffic_class) {
 			XDP2_ASSERT(pdc->state != UET_PDC_STATE_CLOSED,
-				    "PDC bitmap says open but PDC state is "
-				    "closed for PDC %u\n", i);
+				    "PDC hash has PDC but PDC state is "
+				    "closed for PDC %u\n",
+				    ntohs(pdc->local_pdcid));
 			return pdc;
 		}
 	}
@@ -203,19 +384,20 @@ static inline struct uet_pdc *uet_get_from_syn(struct uet_fep *fep,
 					       struct in_addr address,
 					       __be16 pdcid)
 {
+	struct uet_pdc_hash_head *head;
 	struct uet_pdc *pdc;
-	int i = 0;
 
-	xdp2_bitmap_foreach_bit(fep->pdc_alloc_map, i, fep->max_pdcs) {
-		pdc = &fep->pdcs[i];
+	head = __uet_pdc_hash_bucket(fep, fep->pdc_rpdcid_hash,
+			__uet_pdc_rpdcid_key(address, pdcid));
 
+	LIST_FOREACH(pdc, head, rpdcid_hash_link) {
 		if (pdc->remote_fa.s_addr != address.s_addr ||
 		    pdc->remote_pdcid != pdcid)
 			continue;
 
 		XDP2_ASSERT(pdc->state != UET_PDC_STATE_CLOSED,
-			    "PDC bitmap says open but PDC state is "
-			    "closed for PDC %u\n", i);
+			    "PDC hash has PDC but PDC state is "
+			    "closed for PDC %u\n", ntohs(pdc->local_pdcid));
 
 		/* Hurray, we have found a PDC */
 		return pdc;
@@ -0,0 +1,170 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XDP2_ACCEL_STAGES_H__
+#define __XDP2_ACCEL_STAGES_H__
+
+/* Accelerator stage library
+ *
+ * Ready made accelerators to compose pipelines with XDP2_PIPELINE:
+ *
+ *	xdp2_accel_lzf_compress: D -> D, compress a byte stream into a
+ *		stream of LZF blocks
+ *	xdp2_accel_lzf_decompress: D -> D, decompress a stream of LZF blocks
+ *	xdp2_accel_crc32c_append: D -> D, pass the data through and append
+ *		its CRC-32C
+ *	xdp2_accel_crc32c_verify: D -> D or D -> X, pass the data through
+ *		except for the last four bytes and check that they're the
+ *		CRC-32C of the data
+ *	xdp2_accel_checksum: D -> D or D -> X, compute the Internet checksum
+ *		of the data, optionally appending it in D -> D mode
+ *	xdp2_accel_segment: P -> P, split pvbufs into packets of at most
+ *		a segment size
+ *
+ * Each stage keeps its state in a structure that is the stage's argument
+ * in the args array given to the pipeline run function. The state is set
+ * by the stage's init function before each run. The stages are streaming,
+ * they process whatever input is available and hold partial blocks in
+ * their state until there's more input or the end of the input (a call
+ * with zero length input), so they work with any pipe sizes.
+ *
+ * Errors are returned by the handlers as negative errno values and are
+ * reported in error and error_stage of the run: EINVAL for a malformed
+ * LZF stream, EBADMSG for a CRC mismatch, and ENOMEM when a segment can't
+ * be allocated. A stage reports an error once and then skips the bad block
+ * or packet so that the pipeline still completes.
+ *
+ * The LZF stages use the block format of the lzf tool from liblzf. Each
+ * block has a header of "ZV", a type byte, and big endian lengths:
+ *
+ *	type 0 (stored): uncompressed length, followed by the data
+ *	type 1 (compressed): compressed length and uncompressed length,
+ *		followed by the compressed data
+ *
+ * A block holds up to XDP2_ACCEL_LZF_MAX_BLOCK bytes of data. A block is
+ * stored when compression doesn't make it smaller.
+ *
+ * Programs that use the LZF or CRC stages link with liblzf_compress and
+ * libcrc
+ */
+
+#include <linux/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "xdp2/accelerator.h"
+#include "xdp2/pvbuf.h"
+
+/* LZF compress and decompress */
+
+#define XDP2_ACCEL_LZF_MAX_BLOCK	((1 << 16) - 1)
+#define XDP2_ACCEL_LZF_HDR_LEN		7
+
+/* Maximum length of the compressed output for LEN bytes of input with a
+ * block size of BLOCK_SIZE. A block that doesn't compress is stored with a
+ * five byte header
+ */
+#define XDP2_ACCEL_LZF_MAX_OUT(LEN, BLOCK_SIZE)				\
+	((LEN) + ((LEN) + (BLOCK_SIZE) - 1) / (BLOCK_SIZE) * 5)
+
+struct xdp2_accel_lzf {
+	size_t block_size;
+	size_t in_len;	/* Bytes in ibuf */
+	size_t need;	/* Bytes needed in ibuf for next block or header */
+	size_t out_len;	/* Bytes in obuf */
+	size_t out_off;	/* Bytes of obuf already output */
+	bool bad;	/* Skipping a malformed stream */
+	__u8 ibuf[XDP2_ACCEL_LZF_HDR_LEN + XDP2_ACCEL_LZF_MAX_BLOCK];
+	__u8 obuf[XDP2_ACCEL_LZF_HDR_LEN + XDP2_ACCEL_LZF_MAX_BLOCK];
+};
+
+/* Initialize the state for an LZF stage. block_size is the number of input
+ * bytes compressed in each block, zero or a value greater than
+ * XDP2_ACCEL_LZF_MAX_BLOCK gives XDP2_ACCEL_LZF_MAX_BLOCK. block_size is
+ * ignored for decompression
+ */
+void xdp2_accel_lzf_init(struct xdp2_accel_lzf *lzf, size_t block_size);
+
+extern const struct xdp2_accelerator xdp2_accel_lzf_compress;
+extern const struct xdp2_accelerator xdp2_accel_lzf_decompress;
+
+/* CRC-32C append and verify. The CRC is in little endian byte order */
+
+#define XDP2_ACCEL_CRC32C_LEN		sizeof(__u32)
+
+struct xdp2_accel_crc32c {
+	__u32 crc;
+	__u8 trailer[XDP2_ACCEL_CRC32C_LEN];
+	size_t trailer_len;	/* CRC bytes output or held */
+	bool finished;
+	bool ok;		/* Verify succeeded */
+};
+
+void xdp2_accel_crc32c_init(struct xdp2_accel_crc32c *crc);
+
+extern const struct xdp2_accelerator xdp2_accel_crc32c_append;
+extern const struct xdp2_accelerator xdp2_accel_crc32c_verify;
+
+/* Internet checksum. csum is the checksum of the data after the end of the
+ * input, as it would be set in a protocol header
+ */
+
+struct xdp2_accel_checksum {
+	__u64 sum;
+	size_t len;
+	__u16 csum;
+	bool append;
+	bool finished;
+	size_t trailer_len;	/* Checksum bytes output */
+};
+
+/* Initialize the state for a checksum stage. If append is set then a D -> D
+ * stage appends the checksum to the data
+ */
+void xdp2_accel_checksum_init(struct xdp2_accel_checksum *cs, bool append);
+
+extern const struct xdp2_accelerator xdp2_accel_checksum;
+
+/* Segmentation. Each input pvbuf is split into pvbufs of segment_size
+ * bytes, the last one holding the remainder. The segments are clones of
+ * the input so the data isn't copied, and the input pvbuf is freed after
+ * its last segment is output
+ */
+
+struct xdp2_accel_segment {
+	size_t segment_size;
+	xdp2_paddr_t pkt;	/* Packet being segmented */
+	size_t offset;
+	size_t length;
+};
+
+/* Initialize the state for a segment stage, segment_size must be non-zero */
+void xdp2_accel_segment_init(struct xdp2_accel_segment *seg,
+			     size_t segment_size);
+
+extern const struct xdp2_accelerator xdp2_accel_segment;
+
+#endif /* __XDP2_ACCEL_STAGES_H__ */
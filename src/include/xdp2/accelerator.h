@@ -67,87 +67,124 @@ struct xdp2_accelerator {
 #define XDP2_PIPE_DEFAULT_SIZE_P 256
 #define XDP2_PIPE_DEFAULT_SIZE_X 0
 
-/* Pipe structure */
+/* Pipe structure. A pipe is a single producer, single consumer ring
+ * between two stages of a pipeline. prod and cons are free running counts
+ * of the objects produced into and consumed from the pipe, the position of
+ * each in the ring is the count modulo size. The producer owns prod and
+ * the consumer owns cons, each publishes its count with a release store and
+ * reads the other's with an acquire load, so the stages on either side of
+ * a pipe may run in different threads. done is set by the producer when
+ * its stage is finished
+ */
 struct xdp2_pipe {
-	unsigned int cons_ptr;
-	unsigned int prod_ptr;
-	bool pipe_full;
+	unsigned long prod;
+	bool done;
 	unsigned int size;
+	unsigned long cons __aligned(XDP2_CACHELINE_SIZE);
 	union {
 		__u8 data[0];
 		void *pkts[0];
-	};
+	} __aligned(XDP2_CACHELINE_SIZE);
 };
 
+/* Load the count of the other side of a pipe */
+static inline unsigned long __xdp2_pipe_load(const unsigned long *count)
+{
+	return __atomic_load_n(count, __ATOMIC_ACQUIRE);
+}
+
+/* Check pipe for legal counts */
+static inline void __xdp2_pipe_check_pipe(struct xdp2_pipe *pipe)
+{
+	XDP2_ASSERT(__xdp2_pipe_load(&pipe->prod) -
+		    __xdp2_pipe_load(&pipe->cons) <= pipe->size,
+		    "Pipe counts out of bounds %lu - %lu > %u for pipe %p",
+		    pipe->prod, pipe->cons, pipe->size, pipe);
+}
 
-/* Check pipe for legal pointers */
-static void __xdp2_pipe_check_pipe(struct xdp2_pipe *pipe)
+/* Return the position of the producer in the pipe array */
+static inline unsigned int __xdp2_pipe_prod_pos(struct xdp2_pipe *pipe)
 {
-	XDP2_ASSERT(pipe->cons_ptr < pipe->size,
-		    "Consumer pointer out of bounds %u >= %u for pipe %p",
-		    pipe->cons_ptr, pipe->size, pipe);
-	XDP2_ASSERT(pipe->prod_ptr < pipe->size,
-		    "Producer pointer out of bounds %u >= %u for pipe %p",
-		    pipe->prod_ptr, pipe->size, pipe);
-	XDP2_ASSERT(!pipe->pipe_full || pipe->cons_ptr == pipe->prod_ptr,
-		    "Bad full condition for pipe %p\n", pipe);
+	return pipe->prod % pipe->size;
+}
+
+/* Return the position of the consumer in the pipe array */
+static inline unsigned int __xdp2_pipe_cons_pos(struct xdp2_pipe *pipe)
+{
+	return pipe->cons % pipe->size;
 }
 
 /* Return amount of available space in the pipe to the right of the
- * producer pointer
+ * producer pointer. Called by the producer
  */
 static inline size_t __xdp2_pipe_empty_right(struct xdp2_pipe *pipe)
 {
-	__xdp2_pipe_check_pipe(pipe);
-
-	if (pipe->pipe_full)
-		return 0;
-
-	if (pipe->prod_ptr >= pipe->cons_ptr)
-		return pipe->size - pipe->prod_ptr;
+	size_t space = pipe->size - (pipe->prod -
+				     __xdp2_pipe_load(&pipe->cons));
 
-	return pipe->cons_ptr - pipe->prod_ptr;
+	return xdp2_min(space, pipe->size - __xdp2_pipe_prod_pos(pipe));
 }
 
-/* Return number of object in pipe to the right of the consumer pointer */
+/* Return number of object in pipe to the right of the consumer pointer.
+ * Called by the consumer
+ */
 static inline size_t __xdp2_pipe_filled_right(struct xdp2_pipe *pipe)
 {
-	__xdp2_pipe_check_pipe(pipe);
-
-	if (pipe->pipe_full)
-		return pipe->size - pipe->cons_ptr;
+	size_t filled = __xdp2_pipe_load(&pipe->prod) - pipe->cons;
 
-	if (pipe->prod_ptr >= pipe->cons_ptr)
-		return pipe->prod_ptr - pipe->cons_ptr;
+	return xdp2_min(filled, pipe->size - __xdp2_pipe_cons_pos(pipe));
+}
 
-	return pipe->size - pipe->cons_ptr;
+/* Publish objects written by the producer */
+static inline void __xdp2_pipe_produce(struct xdp2_pipe *pipe, size_t num)
+{
+	__atomic_store_n(&pipe->prod, pipe->prod + num, __ATOMIC_RELEASE);
 }
 
-/* Check if pipe is empty */
-static inline bool __xdp2_pipe_empty(struct xdp2_pipe *pipe)
+/* Release objects read by the consumer */
+static inline void __xdp2_pipe_consume(struct xdp2_pipe *pipe, size_t num)
 {
-	__xdp2_pipe_check_pipe(pipe);
+	__atomic_store_n(&pipe->cons, pipe->cons + num, __ATOMIC_RELEASE);
+}
 
-	return (pipe->cons_ptr == pipe->prod_ptr) && !pipe->pipe_full;
+/* Producer signals that it's finished */
+static inline void __xdp2_pipe_set_done(struct xdp2_pipe *pipe)
+{
+	__atomic_store_n(&pipe->done, true, __ATOMIC_RELEASE);
 }
 
-/* Check if pipe is full */
-static inline bool __xdp2_pipe_full(struct xdp2_pipe *pipe)
+/* Check if the producer is finished. If this returns true then all the
+ * objects in the pipe have been published
+ */
+static inline bool __xdp2_pipe_done(struct xdp2_pipe *pipe)
 {
-	__xdp2_pipe_check_pipe(pipe);
+	return __atomic_load_n(&pipe->done, __ATOMIC_ACQUIRE);
+}
 
-	return pipe->pipe_full;
+/* Reset a pipe to empty. Only called when neither side is running */
+static inline void __xdp2_pipe_reset(struct xdp2_pipe *pipe)
+{
+	pipe->prod = 0;
+	pipe->cons = 0;
+	pipe->done = false;
 }
 
 /* Return number of objects in a pipe */
 static inline size_t __xdp2_pipe_occupancy(struct xdp2_pipe *pipe)
 {
-	__xdp2_pipe_check_pipe(pipe);
+	return __xdp2_pipe_load(&pipe->prod) - __xdp2_pipe_load(&pipe->cons);
+}
 
-	if (pipe->pipe_full)
-		return pipe->size;
+/* Check if pipe is empty */
+static inline bool __xdp2_pipe_empty(struct xdp2_pipe *pipe)
+{
+	return !__xdp2_pipe_occupancy(pipe);
+}
 
-	return (pipe->prod_ptr - pipe->cons_ptr + pipe->size) % pipe->size;
+/* Check if pipe is full */
+static inline bool __xdp2_pipe_full(struct xdp2_pipe *pipe)
+{
+	return __xdp2_pipe_occupancy(pipe) == pipe->size;
 }
 
 /* Return number of available objects in a pipe */
@@ -164,10 +201,15 @@ struct xdp2_pipeline_stage {
 	size_t pipe_size;
 };
 
-/* Pipeline structure */
+struct xdp2_pipeline_threads;
+
+/* Pipeline structure. threads is set when the pipeline runs in threaded
+ * mode
+ */
 struct xdp2_pipeline {
 	unsigned int num_stages;
 	struct xdp2_pipeline_stage stages[XDP2_PIPELINE_MAX_STAGES];
+	struct xdp2_pipeline_threads *threads;
 } XDP2_ALIGN_SECTION;
 
 XDP2_DEFINE_SECTION(xdp2_pipeline_section, struct xdp2_pipeline);
@@ -175,7 +217,10 @@ XDP2_DEFINE_SECTION(xdp2_pipeline_section, struct xdp2_pipeline);
 /* Prototypes for frontend functions to run a pipeline. Function names have
  * format __xdp2_run_pipeline_XY where X describes the input to the pipeline
  * as a block of data (X=d) or a list of packets (X=p). Y describes the output
- * of the pipeline as a block of data (Y=d) or a list of packets (Y=p)
+ * of the pipeline as a block of data (Y=d) or a list of packets (Y=p).
+ *
+ * If the output fills up while stages still hold objects the run ends with
+ * error set to ENOSPC, and the objects left in the pipeline are dropped
  */
 
 size_t __xdp2_run_pipeline_d(struct xdp2_pipeline *pline, void *input,
@@ -274,6 +319,38 @@ int xdp2_init_pipeline(struct xdp2_pipeline *pline);
 
 int xdp2_init_pipelines(void);
 
+/* Threaded pipelines
+ *
+ * By default all the stages of a pipeline run in the calling thread. In
+ * threaded mode the stages are divided into groups of consecutive stages
+ * and each group runs in its own thread, so that stages overlap with data
+ * streaming through the pipes between them. The first group runs in the
+ * calling thread and the other groups run in worker threads. A stage that
+ * has no input, or no room in its output pipe, isn't called until the
+ * adjacent stage catches up. The run functions and the handler interface
+ * are the same in both modes, and the run returns when the last stage is
+ * done. Errors are reported through error and error_stage as in the
+ * sequential mode, for the first error seen by any of the threads. An
+ * error from a stage ends the run, and a run in which no stage can make
+ * progress ends with ENOSPC.
+ *
+ * A pipeline may only run once at a time in either mode. Handlers for a
+ * threaded pipeline must be safe to call from the worker threads
+ */
+
+/* Start threaded mode for a pipeline. group_sizes is an array of num_groups
+ * stage counts that add up to the number of stages in the pipeline, if it's
+ * NULL each stage is a group. cpus gives the CPUs to pin the worker
+ * threads to, cpus[i - 1] for group i, a negative CPU or a NULL cpus leaves
+ * workers unpinned. Returns zero or a negative errno
+ */
+int xdp2_pipeline_start_threads(struct xdp2_pipeline *pline,
+				const unsigned int *group_sizes,
+				unsigned int num_groups, const int *cpus);
+
+/* Stop the worker threads of a pipeline and return it to sequential mode */
+void xdp2_pipeline_stop_threads(struct xdp2_pipeline *pline);
+
 /* Macros to make frontend pipeline functions */
 
 #define __XDP2_PIPELINE_MAKE_FUNC_DD(NAME)				\
@@ -108,6 +108,7 @@ struct xdp2_proto_array_table_entry {
 struct xdp2_proto_array_table {
 	int num_ents;
 	const struct xdp2_proto_array_table_entry *entries;
+	struct xdp2_proto_dispatch *dispatch;
 };
 
 /* Parse node for parsing a protocol header that contains an array to be
@@ -163,10 +164,12 @@ struct xdp2_proto_array_def {
 #define XDP2_MAKE_ARRAY_TABLE(NAME, ...)				\
 	static const struct xdp2_proto_array_table_entry __##NAME[] =	\
 		 { __XDP2_MAKE_ARRAY_TABLE_ENTRIES(__VA_ARGS__) };	\
+	XDP2_MAKE_PROTO_DISPATCH(__##NAME##_dispatch);			\
 	static const struct xdp2_proto_array_table NAME = {		\
 		.num_ents = sizeof(__##NAME) /				\
 			sizeof(struct xdp2_proto_array_table_entry),	\
 		.entries = __##NAME,					\
+		XDP2_PROTO_DISPATCH_REF(__##NAME##_dispatch)		\
 	}
 
 /* Forward declarations for array parser nodes */
@@ -1410,6 +1410,110 @@ __XDP2_BITMAP_READ_WRITE_PERMUTE_SWP(16, __u16, 16swp)
 __XDP2_BITMAP_READ_WRITE_PERMUTE_SWP(32, __u32, 32swp)
 __XDP2_BITMAP_READ_WRITE_PERMUTE_SWP(64, __u64, 64swp)
 
+/******** Bulk operations on large bitmaps
+ *
+ *	xdp2_bitmap_bulk_find
+ *	xdp2_bitmap_bulk_find_zero
+ *	xdp2_bitmap_bulk_weight
+ *	xdp2_bitmap_bulk_and
+ *	xdp2_bitmap_bulk_or
+ *	xdp2_bitmap_bulk_and_not
+ *
+ * unsigned int xdp2_bitmap_bulk_find(const unsigned long *addr,
+ *				      unsigned int pos, unsigned int nbits)
+ * unsigned int xdp2_bitmap_bulk_find_zero(const unsigned long *addr,
+ *					   unsigned int pos,
+ *					   unsigned int nbits)
+ * unsigned int xdp2_bitmap_bulk_weight(const unsigned long *addr,
+ *					unsigned int nbits)
+ * void xdp2_bitmap_bulk_{and,or,and_not}(unsigned long *dest,
+ *					  const unsigned long *src1,
+ *					  const unsigned long *src2,
+ *					  unsigned int nbits)
+ *
+ * Out of line versions of xdp2_bitmap_find, xdp2_bitmap_find_zero,
+ * xdp2_bitmap_test(..., XDP2_BITMAP_TEST_WEIGHT), and xdp2_bitmap_and,
+ * xdp2_bitmap_or, and xdp2_bitmap_and_not for native bitmaps of many words
+ * (e.g. allocation maps). The weight and logical operations start at bit
+ * zero, the logical operations don't modify bits of dest at or past nbits.
+ *
+ * These are implemented by kernels in the library. There are generic,
+ * popcnt (popcnt and tzcnt on each word), and AVX2 kernels; the best one
+ * supported by the CPU is selected when the library is loaded. For small
+ * bitmaps the inline functions are faster
+ */
+
+struct xdp2_bitmap_kernel {
+	const char *name;
+	unsigned int (*find)(const unsigned long *addr, unsigned int pos,
+			     unsigned int nbits);
+	unsigned int (*find_zero)(const unsigned long *addr,
+				  unsigned int pos, unsigned int nbits);
+	unsigned int (*weight)(const unsigned long *addr,
+			       unsigned int nbits);
+	void (*op_and)(unsigned long *dest, const unsigned long *src1,
+		       const unsigned long *src2, unsigned int nbits);
+	void (*op_or)(unsigned long *dest, const unsigned long *src1,
+		      const unsigned long *src2, unsigned int nbits);
+	void (*op_and_not)(unsigned long *dest, const unsigned long *src1,
+			   const unsigned long *src2, unsigned int nbits);
+	bool (*supported)(void);
+};
+
+extern const struct xdp2_bitmap_kernel xdp2_bitmap_kernels[];
+extern const unsigned int xdp2_bitmap_num_kernels;
+
+extern const struct xdp2_bitmap_kernel *xdp2_bitmap_kernel;
+
+/* Select a bitmap kernel by name. Returns false if the kernel is unknown
+ * or not supported by the CPU
+ */
+bool xdp2_bitmap_set_kernel(const char *name);
+
+static inline unsigned int xdp2_bitmap_bulk_find(const unsigned long *addr,
+						 unsigned int pos,
+						 unsigned int nbits)
+{
+	return xdp2_bitmap_kernel->find(addr, pos, nbits);
+}
+
+static inline unsigned int xdp2_bitmap_bulk_find_zero(
+		const unsigned long *addr, unsigned int pos,
+		unsigned int nbits)
+{
+	return xdp2_bitmap_kernel->find_zero(addr, pos, nbits);
+}
+
+static inline unsigned int xdp2_bitmap_bulk_weight(
+		const unsigned long *addr, unsigned int nbits)
+{
+	return xdp2_bitmap_kernel->weight(addr, nbits);
+}
+
+static inline void xdp2_bitmap_bulk_and(unsigned long *dest,
+					const unsigned long *src1,
+					const unsigned long *src2,
+					unsigned int nbits)
+{
+	xdp2_bitmap_kernel->op_and(dest, src1, src2, nbits);
+}
+
+static inline void xdp2_bitmap_bulk_or(unsigned long *dest,
+				       const unsigned long *src1,
+				       const unsigned long *src2,
+				       unsigned int nbits)
+{
+	xdp2_bitmap_kernel->op_or(dest, src1, src2, nbits);
+}
+
+static inline void xdp2_bitmap_bulk_and_not(unsigned long *dest,
+					    const unsigned long *src1,
+					    const unsigned long *src2,
+					    unsigned int nbits)
+{
+	xdp2_bitmap_kernel->op_and_not(dest, src1, src2, nbits);
+}
+
 /* The bitmap functions in linux/bitmap.h can be mapped to XDP2 bitmap
  * operations as shown below.
  *
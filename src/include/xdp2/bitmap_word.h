@@ -152,11 +152,26 @@ static inline unsigned int						\
 
 XDP2_PMACRO_APPLY_ALL(__XDP2_BITMAP_FIND_DEFAULT_FUNCT, 8, 16, 32, 64)
 
-/* Use ffs variant by default */
-#define xdp2_bitmap_word8_find __xdp2_bitmap_word8_find_ffs
-#define xdp2_bitmap_word16_find __xdp2_bitmap_word16_find_ffs
-#define xdp2_bitmap_word32_find __xdp2_bitmap_word32_find_ffs
-#define xdp2_bitmap_word64_find __xdp2_bitmap_word64_find_ffs
+/* Count trailing zeroes variant. This is one tzcnt instruction when
+ * compiled with BMI (e.g. -march=haswell or later), else bsf and a test
+ */
+#define __XDP2_BITMAP_WORD_FIND_CTZ_FUNCT(N, CAST, FUNC)		\
+static inline unsigned int						\
+	__xdp2_bitmap_word##N##_find_ctz(__u##N v)			\
+{									\
+	return v ? (unsigned int)FUNC((CAST)v) : N;			\
+}
+
+__XDP2_BITMAP_WORD_FIND_CTZ_FUNCT(8, __u32, __builtin_ctz)
+__XDP2_BITMAP_WORD_FIND_CTZ_FUNCT(16, __u32, __builtin_ctz)
+__XDP2_BITMAP_WORD_FIND_CTZ_FUNCT(32, __u32, __builtin_ctz)
+__XDP2_BITMAP_WORD_FIND_CTZ_FUNCT(64, __u64, __builtin_ctzll)
+
+/* Use ctz variant by default */
+#define xdp2_bitmap_word8_find __xdp2_bitmap_word8_find_ctz
+#define xdp2_bitmap_word16_find __xdp2_bitmap_word16_find_ctz
+#define xdp2_bitmap_word32_find __xdp2_bitmap_word32_find_ctz
+#define xdp2_bitmap_word64_find __xdp2_bitmap_word64_find_ctz
 
 /* Find first set bit from a starting position */
 
@@ -297,10 +312,27 @@ static inline unsigned int						\
 
 XDP2_PMACRO_APPLY_ALL(__XDP2_BITMAP_REV_FIND_LOG_FUNCT, 8, 16, 32, 64)
 
-#define xdp2_bitmap_word8_rev_find __xdp2_bitmap_word8_rev_find_log
-#define xdp2_bitmap_word16_rev_find __xdp2_bitmap_word16_rev_find_log
-#define xdp2_bitmap_word32_rev_find __xdp2_bitmap_word32_rev_find_log
-#define xdp2_bitmap_word64_rev_find __xdp2_bitmap_word64_rev_find_log
+/* Count leading zeroes variant. This is one lzcnt instruction when
+ * compiled with LZCNT, else bsr and a test
+ */
+#define __XDP2_BITMAP_REV_FIND_CLZ_FUNCT(N, CAST, FUNC)		\
+static inline unsigned int						\
+	__xdp2_bitmap_word##N##_rev_find_clz(__u##N v)			\
+{									\
+	return v ? (unsigned int)(sizeof(CAST) * 8 - 1 -		\
+				  FUNC((CAST)v)) : (N);		\
+}
+
+__XDP2_BITMAP_REV_FIND_CLZ_FUNCT(8, __u32, __builtin_clz)
+__XDP2_BITMAP_REV_FIND_CLZ_FUNCT(16, __u32, __builtin_clz)
+__XDP2_BITMAP_REV_FIND_CLZ_FUNCT(32, __u32, __builtin_clz)
+__XDP2_BITMAP_REV_FIND_CLZ_FUNCT(64, __u64, __builtin_clzll)
+
+/* Use clz variant by default */
+#define xdp2_bitmap_word8_rev_find __xdp2_bitmap_word8_rev_find_clz
+#define xdp2_bitmap_word16_rev_find __xdp2_bitmap_word16_rev_find_clz
+#define xdp2_bitmap_word32_rev_find __xdp2_bitmap_word32_rev_find_clz
+#define xdp2_bitmap_word64_rev_find __xdp2_bitmap_word64_rev_find_clz
 
 /* Find last zero bit */
 
@@ -311,14 +343,26 @@ static inline unsigned int						\
 	return __xdp2_bitmap_word##N##_rev_find_default(~v);		\
 }
 
+XDP2_PMACRO_APPLY_ALL(__XDP2_BITMAP_REV_FIND_ZERO_DEFAULT_FUNCT,
+		      8, 16, 32, 64)
+
+#define __XDP2_BITMAP_REV_FIND_ZERO_CLZ_FUNCT(N)			\
+static inline unsigned int						\
+	__xdp2_bitmap_word##N##_rev_find_zero_clz(__u##N v)		\
+{									\
+	return __xdp2_bitmap_word##N##_rev_find_clz((__u##N)~v);	\
+}
+
+XDP2_PMACRO_APPLY_ALL(__XDP2_BITMAP_REV_FIND_ZERO_CLZ_FUNCT, 8, 16, 32, 64)
+
 #define xdp2_bitmap_word8_rev_find_zero				\
-		__xdp2_bitmap_word8_rev_find_zero_default
+		__xdp2_bitmap_word8_rev_find_zero_clz
 #define xdp2_bitmap_word16_rev_find_zero				\
-		__xdp2_bitmap_word16_rev_find_zero_default
+		__xdp2_bitmap_word16_rev_find_zero_clz
 #define xdp2_bitmap_word32_rev_find_zero				\
-		__xdp2_bitmap_word32_rev_find_zero_default
+		__xdp2_bitmap_word32_rev_find_zero_clz
 #define xdp2_bitmap_word64_rev_find_zero				\
-		__xdp2_bitmap_word64_rev_find_zero_default
+		__xdp2_bitmap_word64_rev_find_zero_clz
 
 /* Find last set bit from a starting position */
 
@@ -33,6 +33,8 @@
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <byteswap.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "xdp2/utility.h"
 
@@ -109,27 +111,89 @@ static inline __u64 xdp2_checksum_add64(__u64 val1, __u64 val2)
 	return __xdp2_checksum_add64(val1, val2);
 }
 
-static inline __u16 __xdp2_checksum_compute(const void *src, size_t len)
-{
-	__u64 sum = 0;
-	int i;
+/* Checksum kernels
+ *
+ * A kernel returns the sum of the thirty-two bit words in a buffer, plus the
+ * trailing two and one bytes, in a sixty-four bit accumulator that is folded
+ * to the sixteen bit one's complement sum. There are scalar, SSE2, AVX2, and
+ * AVX-512 kernels; the best one supported by the CPU is selected when the
+ * library is loaded. Buffers shorter than XDP2_CHECKSUM_INLINE_MAX (like
+ * IP headers) are summed by the inline scalar kernel
+ */
 
-	XDP2_ASSERT(len < (1UL << 32), "Checksum length too big: %lu",
-		     len);
+#define XDP2_CHECKSUM_INLINE_MAX	64
+
+struct xdp2_checksum_kernel {
+	const char *name;
+	__u64 (*partial)(const void *src, size_t len);
+	bool (*supported)(void);
+};
+
+extern const struct xdp2_checksum_kernel xdp2_checksum_kernels[];
+extern const unsigned int xdp2_checksum_num_kernels;
+
+extern __u64 (*xdp2_checksum_partial_func)(const void *src, size_t len);
+extern const char *xdp2_checksum_kernel_name;
+
+/* Select a checksum kernel by name. Returns false if the kernel is unknown
+ * or not supported by the CPU
+ */
+bool xdp2_checksum_set_kernel(const char *name);
+
+/* Scalar kernel: sum sixty-four bit words as pairs of thirty-two bit words */
+static inline __u64 __xdp2_checksum_partial_scalar(const void *src,
+						   size_t len)
+{
+	__u64 sum = 0, sum2 = 0, w1, w2;
+	__u32 w;
+	__u16 h;
 
-	/* Sum thirty-two bit words */
-	for (i = 0; i < len / sizeof(__u32); i++, src += sizeof(__u32))
-		sum += *(__u32 *)src;
+	for (; len >= 2 * sizeof(__u64); len -= 2 * sizeof(__u64)) {
+		memcpy(&w1, src, sizeof(w1));
+		memcpy(&w2, src + sizeof(w1), sizeof(w2));
+		sum += (w1 & 0xffffffff) + (w1 >> 32);
+		sum2 += (w2 & 0xffffffff) + (w2 >> 32);
+		src += 2 * sizeof(__u64);
+	}
+	sum += sum2;
 
+	if (len & 8) {
+		memcpy(&w1, src, sizeof(w1));
+		sum += (w1 & 0xffffffff) + (w1 >> 32);
+		src += sizeof(__u64);
+	}
+	if (len & 4) {
+		memcpy(&w, src, sizeof(w));
+		sum += w;
+		src += sizeof(__u32);
+	}
 	if (len & 2) { /* Extra two bytes */
-		sum += *(__u16 *)src;
+		memcpy(&h, src, sizeof(h));
+		sum += h;
 		src += sizeof(__u16);
 	}
 	if (len & 1) /* Odd length */
 		sum += *(__u8 *)src;
 
+	return sum;
+}
+
+/* Return the unfolded sum over a buffer using the selected kernel */
+static inline __u64 xdp2_checksum_partial(const void *src, size_t len)
+{
+	XDP2_ASSERT(len < (1UL << 32), "Checksum length too big: %lu",
+		     len);
+
+	if (len < XDP2_CHECKSUM_INLINE_MAX)
+		return __xdp2_checksum_partial_scalar(src, len);
+
+	return xdp2_checksum_partial_func(src, len);
+}
+
+static inline __u16 __xdp2_checksum_compute(const void *src, size_t len)
+{
 	/* Return sum folded to sixteen bits*/
-	return __xdp2_checksum_fold64(sum);
+	return __xdp2_checksum_fold64(xdp2_checksum_partial(src, len));
 }
 
 static inline __u16 xdp2_checksum_compute(const void *src, size_t len)
@@ -137,4 +201,64 @@ static inline __u16 xdp2_checksum_compute(const void *src, size_t len)
 	return __xdp2_checksum_compute(src, len);
 }
 
+/* Incremental checksum update (RFC 1624)
+ *
+ * Update a checksum field for a change of a field covered by the checksum
+ * from old to new, per equation 3 of RFC 1624: HC' = ~(~HC + ~m + m'). The
+ * checksum and the values are taken as they are in the packet (no byte
+ * swapping is needed since the one's complement sum is independent of byte
+ * order), and the new checksum field value is returned
+ */
+static inline __u16 xdp2_checksum_update16(__u16 csum, __u16 old, __u16 new)
+{
+	__u32 sum = (__u16)~csum;
+
+	sum += (__u16)~old;
+	sum += new;
+
+	return ~__xdp2_checksum_fold32(sum);
+}
+
+static inline __u16 xdp2_checksum_update32(__u16 csum, __u32 old, __u32 new)
+{
+	__u64 sum = (__u16)~csum;
+
+	sum += ~old;
+	sum += new;
+
+	return ~__xdp2_checksum_fold64(sum);
+}
+
+/* Update a checksum for a change of a field of len bytes (for instance an
+ * IPv6 address). The field must start at an even offset in the checksummed
+ * data
+ */
+static inline __u16 xdp2_checksum_update(__u16 csum, const void *old,
+					 const void *new, size_t len)
+{
+	__u64 sum = (__u16)~csum;
+
+	/* ~old is the same as 0xffff... - old for each word, so sum the
+	 * complement of the old value's partial sum
+	 */
+	sum += (__u16)~__xdp2_checksum_fold64(
+				__xdp2_checksum_partial_scalar(old, len));
+	sum += __xdp2_checksum_partial_scalar(new, len);
+
+	return ~__xdp2_checksum_fold64(sum);
+}
+
+/* Decrement the TTL in an IPv4 header and update the header checksum */
+static inline void xdp2_checksum_ipv4_dec_ttl(struct iphdr *iph)
+{
+	__u16 old, new;
+
+	/* TTL and protocol are one sixteen bit word of the header */
+	memcpy(&old, &iph->ttl, sizeof(old));
+	iph->ttl--;
+	memcpy(&new, &iph->ttl, sizeof(new));
+
+	iph->check = xdp2_checksum_update16(iph->check, old, new);
+}
+
 #endif /* __XDP2_CHECKSUM_H__ */
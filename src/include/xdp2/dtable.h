@@ -30,6 +30,9 @@
 
 #include <sys/queue.h>
 
+#include "xdp2/hash.h"
+#include "xdp2/id_alloc.h"
+#include "xdp2/qsbr.h"
 #include "xdp2/table_common.h"
 
 typedef void (*xdp2_dftable_func_t)(void *call_arg, void *entry_arg);
@@ -43,6 +46,7 @@ struct __xdp2_dtable_entry_func_target {
 struct xdp2_dtable_entry {
 	int ident;
 	struct xdp2_dtable_entry *next;
+	struct xdp2_dtable_entry *id_next;
 	LIST_ENTRY(xdp2_dtable_entry) list_ent;
 	LIST_ENTRY(xdp2_dtable_entry) list_ent_lookup;
 	__u8 data[];
@@ -60,10 +64,38 @@ enum xdp2_dtable_table_types {
 	XDP2_DTABLE_TABLE_TYPE_LPM,
 };
 
+/* Lookup algorithms for ternary tables. LINEAR compares the key with each
+ * entry in order of position. TSS (tuple space search) groups the entries
+ * by key mask into hashed subtables and does one hash lookup per distinct
+ * key mask, which is much faster for large ACL style tables
+ */
+enum xdp2_dtable_tern_algo {
+	XDP2_DTABLE_TERN_LINEAR = 0,
+	XDP2_DTABLE_TERN_TSS,
+};
+
+/* Table configuration. For plain tables size is a hint for the expected
+ * number of entries and is used to presize the hash index (-1U means no
+ * hint), and hash_algo selects the hash function for keys (see
+ * xdp2/hash.h). For ternary tables tern_algo selects the lookup algorithm
+ */
 struct xdp2_dtable_config {
 	size_t size;
+	enum xdp2_dtable_tern_algo tern_algo;
+	enum xdp2_hash_algo hash_algo;
 };
 
+/* Hash index for plain tables (opaque, defined in dtable.c) */
+struct xdp2_dtable_hash;
+
+/* Tuple space search index for ternary tables (opaque, defined in
+ * dtable.c)
+ */
+struct xdp2_dtable_tss;
+
+/* Trie for longest prefix match tables (see xdp2/lpm_trie.h) */
+struct xdp2_lpm_trie;
+
 #define DTABLE_STRUCT_ELS()						\
 	const char *name;						\
 	size_t key_len;							\
@@ -76,7 +108,14 @@ struct xdp2_dtable_config {
 	struct __xdp2_dtable_list_head entries_lookup;			\
 	bool constant;							\
 	enum xdp2_dtable_table_types table_type;			\
-	struct xdp2_dtable_config config;
+	struct xdp2_dtable_config config;				\
+	struct xdp2_dtable_hash *hash;					\
+	struct xdp2_lpm_trie *trie;					\
+	struct xdp2_dtable_tss *tss;					\
+	struct xdp2_id_alloc entry_ids;					\
+	struct xdp2_dtable_entry **id_index;				\
+	unsigned int id_index_mask;					\
+	unsigned int num_entries;
 
 struct xdp2_dtable_table {
 	DTABLE_STRUCT_ELS();
@@ -101,6 +140,25 @@ __XDP2_DTABLE_DEFINE_TABLE(plain)
 __XDP2_DTABLE_DEFINE_TABLE(tern)
 __XDP2_DTABLE_DEFINE_TABLE(lpm)
 
+/* Concurrency
+ *
+ * Lookups in dynamic tables are lock-free and may run on any number of
+ * threads concurrently with updates (add, delete, and change) from a
+ * control thread. Updates must be serialized by the caller. Updates never
+ * modify an entry or index that a reader can reach: changed entries are
+ * replaced by copies, indexes are updated with single pointer stores or
+ * replaced, and unlinked memory is freed after a grace period of the
+ * xdp2_dtable_qsbr domain.
+ *
+ * A thread doing lookups registers with xdp2_qsbr_register(
+ * &xdp2_dtable_qsbr) and calls xdp2_qsbr_quiescent periodically, for
+ * instance after each batch of packets. A target returned by a lookup is
+ * valid until the thread's next quiescent state. Threads that don't
+ * register are treated as always quiescent, that is safe if no updates
+ * are done concurrently with their lookups
+ */
+extern struct xdp2_qsbr xdp2_dtable_qsbr;
+
 /* Table functions prototypes */
 
 /* Called to initialize any constant dtable (from section array) */
@@ -165,6 +223,20 @@ int xdp2_dtable_change_lpm(struct xdp2_dtable_lpm_table *table,
 int xdp2_dtable_change_lpm_by_id(struct xdp2_dtable_lpm_table *table,
 				 int ident, void *target);
 
+/* Set the hash algorithm for the keys of a plain table. The table must be
+ * empty. Returns zero on success, -EBUSY if the table has entries, or
+ * -EINVAL if the algorithm isn't known
+ */
+int xdp2_dtable_set_hash_algo(struct xdp2_dtable_plain_table *table,
+			      enum xdp2_hash_algo algo);
+
+/* Set the lookup algorithm of a ternary table. Switching to TSS builds
+ * the index from the current entries. Returns zero on success, -ENOMEM,
+ * or -EINVAL if the key is too long for TSS
+ */
+int xdp2_dtable_set_tern_algo(struct xdp2_dtable_tern_table *table,
+			      enum xdp2_dtable_tern_algo algo);
+
 const void *xdp2_dtable_lookup_plain(struct xdp2_dtable_plain_table *table,
 				     const void *key);
 
@@ -28,6 +28,8 @@
 #define __XDP2_FIFO_H__
 
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
@@ -53,7 +55,55 @@
  *
  * The queue is an array of __u64's that is managed is a ring based on the
  * producer and consumer pointers
+ *
+ * A FIFO operates in one of three modes:
+ *
+ *  - XDP2_FIFO_MODE_LOCKED: every enqueue and dequeue is done under the
+ *    FIFO mutex (the default)
+ *  - XDP2_FIFO_MODE_SPSC: lock-free ring for exactly one producer thread
+ *    and one consumer thread. Each side keeps a cached copy of the other
+ *    side's index so that the shared cache line is only read when the
+ *    cached value says the ring is full or empty
+ *  - XDP2_FIFO_MODE_MPMC: lock-free ring for any number of producers and
+ *    consumers. Slots are reserved by a compare and swap on the head index
+ *    and published in order on the tail index
+ *
+ * Lock-free modes require the number of entries to be a power of two. The
+ * mutex is only taken in lock-free modes to block waiters and to update
+ * poll groups when the FIFO becomes readable or writable
+ */
+
+enum xdp2_fifo_mode {
+	XDP2_FIFO_MODE_LOCKED = 0,
+	XDP2_FIFO_MODE_SPSC,
+	XDP2_FIFO_MODE_MPMC,
+};
+
+static inline const char *xdp2_fifo_mode_to_text(enum xdp2_fifo_mode mode)
+{
+	switch (mode) {
+	case XDP2_FIFO_MODE_LOCKED:
+		return "locked";
+	case XDP2_FIFO_MODE_SPSC:
+		return "spsc";
+	case XDP2_FIFO_MODE_MPMC:
+		return "mpmc";
+	default:
+		return "unknown";
+	}
+}
+
+/* One side (producer or consumer) of a lock-free ring. Indexes are free
+ * running and are masked with num_ents - 1 to get a slot. head is the next
+ * index to reserve and tail is the index up to which entries have been
+ * published to the other side. In SPSC mode head and tail are advanced
+ * together and cache holds the last seen tail of the other side
  */
+struct xdp2_fifo_ring_side {
+	atomic_uint head;
+	atomic_uint tail;
+	unsigned int cache;
+} __aligned(XDP2_CACHELINE_SIZE);
 
 /* Producer stats structure. This structure contains counters for various
  * events related to the producer side of a FIFO
@@ -221,6 +271,7 @@ struct xdp2_fifo {
 	unsigned int num_ents; /* Number of entries in the queue */
 	unsigned int low_water_mark; /* Must be > 0 */
 	__u8 ent_size; /* Size of one entry in __u64 units */
+	__u8 mode; /* enum xdp2_fifo_mode */
 	bool initted;
 
 	/* Number of address translators to apply to stats, read_poll, and
@@ -270,6 +321,13 @@ struct xdp2_fifo {
 	atomic_ulong num_enqueued;
 	atomic_ulong num_dequeued;
 	atomic_uint num_enqueue_waiters;
+	atomic_uint num_dequeue_waiters; /* Lock-free modes only */
+
+	/* Producer and consumer indexes for lock-free modes. Each is on its
+	 * own cache line
+	 */
+	struct xdp2_fifo_ring_side ring_prod;
+	struct xdp2_fifo_ring_side ring_cons;
 
 	/* Array of pointers to messages for ring fifo */
 	__u64 queue[];
@@ -398,8 +456,27 @@ static inline unsigned int xdp2_fifo_sw_num_in_queue(
 								fifo->num_ents;
 }
 
+/* Number of entries published by producers and not yet released by
+ * consumers in a lock-free ring
+ */
+static inline unsigned int xdp2_fifo_ring_num_in_queue(
+						const struct xdp2_fifo *fifo)
+{
+	unsigned int cons = atomic_load_explicit(
+			&((struct xdp2_fifo *)fifo)->ring_cons.tail,
+			memory_order_acquire);
+	unsigned int prod = atomic_load_explicit(
+			&((struct xdp2_fifo *)fifo)->ring_prod.tail,
+			memory_order_acquire);
+
+	return xdp2_min(prod - cons, fifo->num_ents);
+}
+
 static inline unsigned int xdp2_fifo_num_in_queue(const struct xdp2_fifo *fifo)
 {
+	if (fifo->mode != XDP2_FIFO_MODE_LOCKED)
+		return xdp2_fifo_ring_num_in_queue(fifo);
+
 	return xdp2_fifo_sw_num_in_queue(fifo);
 }
 
@@ -412,7 +489,7 @@ static inline unsigned int xdp2_fifo_sw_avail_in_queue(
 static inline unsigned int xdp2_fifo_avail_in_queue(
 						const struct xdp2_fifo *fifo)
 {
-	return xdp2_fifo_sw_avail_in_queue(fifo);
+	return fifo->num_ents - xdp2_fifo_num_in_queue(fifo);
 }
 
 static inline bool xdp2_fifo_sw_is_empty(const struct xdp2_fifo *fifo)
@@ -423,6 +500,9 @@ static inline bool xdp2_fifo_sw_is_empty(const struct xdp2_fifo *fifo)
 
 static inline bool xdp2_fifo_is_empty(const struct xdp2_fifo *fifo)
 {
+	if (fifo->mode != XDP2_FIFO_MODE_LOCKED)
+		return !xdp2_fifo_ring_num_in_queue(fifo);
+
 	return xdp2_fifo_sw_is_empty(fifo);
 }
 
@@ -433,6 +513,9 @@ static inline bool xdp2_fifo_sw_is_full(const struct xdp2_fifo *fifo)
 
 static inline bool xdp2_fifo_is_full(const struct xdp2_fifo *fifo)
 {
+	if (fifo->mode != XDP2_FIFO_MODE_LOCKED)
+		return xdp2_fifo_ring_num_in_queue(fifo) == fifo->num_ents;
+
 	return xdp2_fifo_sw_is_full(fifo);
 }
 
@@ -621,7 +704,7 @@ static inline void xdp2_fifo_enable_read_poll(struct xdp2_fifo *fifo)
 	 */
 	XDP2_FIFO_MUTEX_LOCK(&fifo->mutex, "FIFO mutex in "
 			     "xdp2_fifo_enable_read_poll");
-	make_readable = xdp2_fifo_sw_num_in_queue(fifo);
+	make_readable = xdp2_fifo_num_in_queue(fifo);
 	XDP2_FIFO_MUTEX_UNLOCK(&fifo->mutex);
 
 	if (make_readable)
@@ -792,7 +875,7 @@ static inline void xdp2_fifo_enable_write_poll(struct xdp2_fifo *fifo)
 
 	XDP2_FIFO_MUTEX_LOCK(&fifo->mutex, "FIFO mutex in "
 			     "xdp2_fifo_set_write_fifo");
-	make_writable = !!xdp2_fifo_sw_avail_in_queue(fifo);
+	make_writable = !!xdp2_fifo_avail_in_queue(fifo);
 	XDP2_FIFO_MUTEX_UNLOCK(&fifo->mutex);
 
 	if (make_writable)
@@ -1367,12 +1450,20 @@ static inline bool ___xdp2_fifo_sw_enqueue(struct xdp2_fifo *fifo,
 	(__xdp2_fifo_sw_enqueue(FIFO, 1, &v, WAIT));			\
 })
 
+static inline unsigned int ___xdp2_fifo_ring_enqueue(struct xdp2_fifo *fifo,
+		unsigned int num, __u64 *messagesp, unsigned int count,
+		bool burst, bool wait, char *_file, int _line);
+
+static inline unsigned int ___xdp2_fifo_ring_dequeue(struct xdp2_fifo *fifo,
+		unsigned int num, __u64 *messagesp, unsigned int count,
+		bool burst, bool wait, char *_file, int _line);
+
 /* Enqueue a message on a fifo
  *
  * Returns true if message was successfully enqueued, returns false if the
  * fifo is full and wait is set to false
  *
- * Called function takes FIFO mutex
+ * Called function takes FIFO mutex in locked mode
  */
 static inline bool ___xdp2_fifo_enqueue(struct xdp2_fifo *fifo,
 					unsigned int num, __u64 *messagep,
@@ -1382,7 +1473,12 @@ static inline bool ___xdp2_fifo_enqueue(struct xdp2_fifo *fifo,
 
 	__XDP2_FIFO_BUMP_PROD_COUNT(fifo, requests);
 
-	ret = ___xdp2_fifo_sw_enqueue(fifo, num, messagep, wait, _file, _line);
+	if (fifo->mode != XDP2_FIFO_MODE_LOCKED)
+		ret = !!___xdp2_fifo_ring_enqueue(fifo, num, messagep, 1,
+						  false, wait, _file, _line);
+	else
+		ret = ___xdp2_fifo_sw_enqueue(fifo, num, messagep, wait,
+					      _file, _line);
 
 	if (ret)
 		__XDP2_FIFO_BUMP_NUM_ENQUEUED(fifo);
@@ -1417,7 +1513,12 @@ static inline void ___xdp2_fifo_enqueue_nocheck(struct xdp2_fifo *fifo,
 
 	__XDP2_FIFO_BUMP_PROD_COUNT(fifo, requests);
 
-	ret = ___xdp2_fifo_sw_enqueue(fifo, num, messagep, false, _file, _line);
+	if (fifo->mode != XDP2_FIFO_MODE_LOCKED)
+		ret = !!___xdp2_fifo_ring_enqueue(fifo, num, messagep, 1,
+						  false, false, _file, _line);
+	else
+		ret = ___xdp2_fifo_sw_enqueue(fifo, num, messagep, false,
+					      _file, _line);
 
 	XDP2_ASSERT(ret, "Enqueue on a \"no check\" FIFO failed");
 
@@ -1527,7 +1628,7 @@ static void xdp2_fifo_make_non_readable_after_dequeue(struct xdp2_fifo *fifo)
 	XDP2_FIFO_MUTEX_LOCK(&fifo->mutex, "Fifo mutex in "
 			     "xdp2_fifo_make_non_readable_after_dequeue");
 
-	if (!xdp2_fifo_sw_is_empty(fifo)) {
+	if (!xdp2_fifo_is_empty(fifo)) {
 		/* Queue became readable after we dropped the mutex lock. Note
 		 * that after release the fifo mutex, it's possible that a
 		 * dequeue operation occurs and again the fifo is non-readable--
@@ -1682,7 +1783,7 @@ static inline bool ___xdp2_fifo_sw_dequeue(struct xdp2_fifo *fifo,
  * contents are valid, returns false if the fifo is empty and wait is set
  * to false
  *
- * Called function takes the FIFO mutex
+ * Called function takes the FIFO mutex in locked mode
  */
 static inline bool ___xdp2_fifo_dequeue(struct xdp2_fifo *fifo,
 					unsigned int num, __u64 *messagep,
@@ -1690,7 +1791,12 @@ static inline bool ___xdp2_fifo_dequeue(struct xdp2_fifo *fifo,
 {
 	bool ret;
 
-	ret = ___xdp2_fifo_sw_dequeue(fifo, num, messagep, wait, _file, _line);
+	if (fifo->mode != XDP2_FIFO_MODE_LOCKED)
+		ret = !!___xdp2_fifo_ring_dequeue(fifo, num, messagep, 1,
+						  false, wait, _file, _line);
+	else
+		ret = ___xdp2_fifo_sw_dequeue(fifo, num, messagep, wait,
+					      _file, _line);
 
 	if (ret)
 		__XDP2_FIFO_BUMP_NUM_DEQUEUED(fifo);
@@ -1706,6 +1812,424 @@ static inline bool ___xdp2_fifo_dequeue(struct xdp2_fifo *fifo,
 #define xdp2_fifo_dequeue(FIFO, MESSAGEP, WAIT)			\
 	__xdp2_fifo_dequeue(FIFO, 1, MESSAGEP, WAIT)
 
+/* Lock-free ring implementation (XDP2_FIFO_MODE_SPSC and
+ * XDP2_FIFO_MODE_MPMC)
+ *
+ * Enqueue reserves slots on the producer head, copies the messages, and
+ * publishes them by advancing the producer tail. Dequeue does the same with
+ * the consumer indexes. After publishing, each side does a full fence and
+ * reads the other side's tail to detect the empty to non-empty and full to
+ * below low water mark transitions. Since both sides fence between their
+ * store and load, at least one side sees the transition and updates the
+ * poll group (the poll group functions recheck the FIFO state under the
+ * mutex, so the worst effect of both sides acting is a spurious wakeup)
+ */
+
+static inline void xdp2_fifo_ring_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/* Wake up a thread blocked on a lock-free FIFO. Taking and releasing the
+ * mutex ensures that a waiter is either before its recheck of the ring, and
+ * will see the update, or already waiting on the condition variable
+ */
+static inline void __xdp2_fifo_ring_wake(struct xdp2_fifo *fifo,
+					 XDP2_LOCKS_COND_T *cond)
+{
+	if (!cond)
+		return;
+
+	XDP2_FIFO_MUTEX_LOCK(&fifo->mutex, "Fifo mutex in "
+			     "__xdp2_fifo_ring_wake");
+	XDP2_FIFO_MUTEX_UNLOCK(&fifo->mutex);
+
+	XDP2_LOCKS_COND_SIGNAL(cond);
+}
+
+/* Reserve up to count slots on one side of the ring. avail_base is the
+ * number of entries the other side's tail gives (num_ents for the producer
+ * and zero for the consumer). Returns the number of slots reserved and the
+ * first index in *headp. If burst is false then either all count slots or
+ * none are reserved
+ */
+static inline unsigned int __xdp2_fifo_ring_reserve(struct xdp2_fifo *fifo,
+		struct xdp2_fifo_ring_side *side,
+		struct xdp2_fifo_ring_side *other, unsigned int avail_base,
+		unsigned int count, bool burst, unsigned int *headp)
+{
+	unsigned int head, avail, n;
+
+	head = atomic_load_explicit(&side->head, memory_order_relaxed);
+
+	if (fifo->mode == XDP2_FIFO_MODE_SPSC) {
+		avail = avail_base + side->cache - head;
+		if (avail < count) {
+			/* Refresh the cached index of the other side */
+			side->cache = atomic_load_explicit(&other->tail,
+							memory_order_acquire);
+			avail = avail_base + side->cache - head;
+		}
+
+		n = xdp2_min(avail, count);
+		if (!n || (!burst && n < count))
+			return 0;
+
+		atomic_store_explicit(&side->head, head + n,
+				      memory_order_relaxed);
+		*headp = head;
+
+		return n;
+	}
+
+	do {
+		avail = avail_base + atomic_load_explicit(&other->tail,
+						memory_order_acquire) - head;
+		n = xdp2_min(avail, count);
+		if (!n || (!burst && n < count))
+			return 0;
+	} while (!atomic_compare_exchange_weak_explicit(&side->head, &head,
+							 head + n,
+							 memory_order_relaxed,
+							 memory_order_relaxed));
+	*headp = head;
+
+	return n;
+}
+
+/* Number of spins waiting for an earlier MPMC reservation to be published
+ * before yielding the CPU. This bounds the cost of the reserving thread
+ * being preempted when there are more threads than CPUs
+ */
+#define XDP2_FIFO_RING_SPINS 256
+
+/* Publish reserved slots. In MPMC mode wait for earlier reservations on
+ * the same side to be published first
+ */
+static inline void __xdp2_fifo_ring_publish(struct xdp2_fifo *fifo,
+					    struct xdp2_fifo_ring_side *side,
+					    unsigned int head, unsigned int n)
+{
+	unsigned int spins = 0;
+
+	if (fifo->mode == XDP2_FIFO_MODE_MPMC) {
+		while (atomic_load_explicit(&side->tail,
+					    memory_order_relaxed) != head) {
+			if (++spins % XDP2_FIFO_RING_SPINS)
+				xdp2_fifo_ring_relax();
+			else
+				sched_yield();
+		}
+	}
+
+	atomic_store_explicit(&side->tail, head + n, memory_order_release);
+}
+
+/* Block until the ring has room for count entries (or for any entries if
+ * burst is set) or until it has entries to dequeue. Takes the FIFO mutex
+ */
+static inline void __xdp2_fifo_ring_wait(struct xdp2_fifo *fifo,
+					 bool producer, unsigned int count,
+					 bool burst)
+{
+	XDP2_LOCKS_COND_T *cond = producer ? fifo->producer_cond :
+					     fifo->consumer_cond;
+	atomic_uint *waiters = producer ? &fifo->num_enqueue_waiters :
+					  &fifo->num_dequeue_waiters;
+	unsigned int need = burst ? 1 : count;
+
+	XDP2_ASSERT(cond, "Waiting on lock-free FIFO %s but cond is not set "
+			  "for FIFO", producer ? "enqueue" : "dequeue");
+
+	XDP2_FIFO_MUTEX_LOCK(&fifo->mutex, "Fifo mutex in "
+			     "__xdp2_fifo_ring_wait");
+
+	atomic_fetch_add(waiters, 1);
+
+	while ((producer ? xdp2_fifo_avail_in_queue(fifo) :
+			   xdp2_fifo_num_in_queue(fifo)) < need) {
+		XDP2_LOCKS_COND_WAIT(cond, &fifo->mutex);
+
+		if ((producer ? xdp2_fifo_avail_in_queue(fifo) :
+				xdp2_fifo_num_in_queue(fifo)) < need) {
+			if (producer)
+				__XDP2_FIFO_BUMP_PROD_COUNT(fifo,
+							    spurious_wakeups);
+			else
+				__XDP2_FIFO_BUMP_CONS_COUNT(fifo,
+							    spurious_wakeups);
+		}
+	}
+
+	atomic_fetch_sub(waiters, 1);
+
+	XDP2_FIFO_MUTEX_UNLOCK(&fifo->mutex);
+
+	if (producer)
+		__XDP2_FIFO_BUMP_PROD_COUNT(fifo, after_wait);
+	else
+		__XDP2_FIFO_BUMP_CONS_COUNT(fifo, after_wait);
+}
+
+/* Enqueue count messages of num __u64's each on a lock-free FIFO. The
+ * messages are consecutive in messagesp with a stride of num
+ *
+ * If burst is set then as many messages as fit are enqueued, else either
+ * all count messages are enqueued or none. Returns the number of messages
+ * enqueued, if wait is set this blocks until at least one message (burst)
+ * or all messages can be enqueued
+ */
+static inline unsigned int ___xdp2_fifo_ring_enqueue(struct xdp2_fifo *fifo,
+		unsigned int num, __u64 *messagesp, unsigned int count,
+		bool burst, bool wait, char *_file, int _line)
+{
+	unsigned int mask = fifo->num_ents - 1;
+	unsigned int head, cons, n, i;
+
+	__XDP2_FIFO_CHECK_MAGIC(fifo, _file, _line);
+
+	XDP2_ASSERT(num <= fifo->ent_size,
+		    "FIFO enqueue: enqueue %u dwords is greater than "
+		    "FIFO element size %u", num, fifo->ent_size);
+
+	while (!(n = __xdp2_fifo_ring_reserve(fifo, &fifo->ring_prod,
+					      &fifo->ring_cons, fifo->num_ents,
+					      count, burst, &head))) {
+		if (!count)
+			return 0;
+
+		__XDP2_FIFO_BUMP_PROD_COUNT(fifo, blocked);
+
+		if (!wait)
+			return 0;
+
+		__XDP2_FIFO_BUMP_PROD_COUNT(fifo, waits);
+		__xdp2_fifo_ring_wait(fifo, true, count, burst);
+	}
+
+	if (fifo->ent_size == 1) {
+		for (i = 0; i < n; i++)
+			fifo->queue[(head + i) & mask] = messagesp[i];
+	} else {
+		for (i = 0; i < n; i++)
+			memcpy(&fifo->queue[((head + i) & mask) *
+					    fifo->ent_size],
+			       &messagesp[i * num], num * sizeof(__u64));
+	}
+
+	__xdp2_fifo_ring_publish(fifo, &fifo->ring_prod, head, n);
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	cons = atomic_load_explicit(&fifo->ring_cons.tail,
+				    memory_order_relaxed);
+
+	if (fifo->stats) {
+		struct xdp2_fifo_stats *stats = FIFO_FIELD_XLAT(fifo, stats);
+
+		if (head + n - cons > stats->producer.max_enqueued)
+			stats->producer.max_enqueued = head + n - cons;
+	}
+
+	if (head + n - cons >= fifo->num_ents) {
+		__XDP2_FIFO_BUMP_PROD_COUNT(fifo, queue_full);
+
+		__atomic_store_n(&fifo->queue_full, true, __ATOMIC_SEQ_CST);
+
+		if (fifo->write_poll)
+			xdp2_fifo_mark_non_writable(fifo);
+
+		/* Consumers may have drained the FIFO before seeing
+		 * queue_full set
+		 */
+		if (xdp2_fifo_ring_num_in_queue(fifo) < fifo->low_water_mark &&
+		    __atomic_exchange_n(&fifo->queue_full, false,
+					__ATOMIC_SEQ_CST) &&
+		    fifo->write_poll)
+			xdp2_fifo_make_writable(fifo);
+	}
+
+	if (cons == head) {
+		/* The FIFO was empty before these entries were published */
+		__XDP2_FIFO_BUMP_PROD_COUNT(fifo, saw_empty);
+
+		if (fifo->read_poll)
+			xdp2_fifo_make_readable(fifo);
+	}
+
+	if (atomic_load_explicit(&fifo->num_dequeue_waiters,
+				 memory_order_relaxed))
+		__xdp2_fifo_ring_wake(fifo, fifo->consumer_cond);
+
+	return n;
+}
+
+/* Dequeue up to count messages of num __u64's each from a lock-free FIFO
+ * into messagesp with a stride of num. Semantics of burst and wait are the
+ * same as for ___xdp2_fifo_ring_enqueue
+ */
+static inline unsigned int ___xdp2_fifo_ring_dequeue(struct xdp2_fifo *fifo,
+		unsigned int num, __u64 *messagesp, unsigned int count,
+		bool burst, bool wait, char *_file, int _line)
+{
+	unsigned int mask = fifo->num_ents - 1;
+	unsigned int head, num_enqueued, n, i;
+
+	__XDP2_FIFO_CHECK_MAGIC(fifo, _file, _line);
+
+	XDP2_ASSERT(num <= fifo->ent_size,
+		    "FIFO dequeue: dequeue %u dwords is greater than "
+		    "FIFO element size %u", num, fifo->ent_size);
+
+	while (!(n = __xdp2_fifo_ring_reserve(fifo, &fifo->ring_cons,
+					      &fifo->ring_prod, 0, count,
+					      burst, &head))) {
+		if (!count)
+			return 0;
+
+		__XDP2_FIFO_BUMP_CONS_COUNT(fifo, blocked);
+
+		if (!wait) {
+			/* Ensure the fifo is non-readable for poll so we
+			 * don't spin on an empty fifo marked readable
+			 */
+			if (fifo->read_poll)
+				xdp2_fifo_make_non_readable_after_dequeue(fifo);
+			return 0;
+		}
+
+		__XDP2_FIFO_BUMP_CONS_COUNT(fifo, waits);
+		__xdp2_fifo_ring_wait(fifo, false, count, burst);
+	}
+
+	if (fifo->ent_size == 1) {
+		for (i = 0; i < n; i++)
+			messagesp[i] = fifo->queue[(head + i) & mask];
+	} else {
+		for (i = 0; i < n; i++)
+			memcpy(&messagesp[i * num],
+			       &fifo->queue[((head + i) & mask) *
+					    fifo->ent_size],
+			       num * sizeof(__u64));
+	}
+
+	__xdp2_fifo_ring_publish(fifo, &fifo->ring_cons, head, n);
+
+	__XDP2_FIFO_BUMP_CONS_COUNT(fifo, requests);
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	num_enqueued = atomic_load_explicit(&fifo->ring_prod.tail,
+					    memory_order_relaxed) - (head + n);
+
+	if (fifo->stats) {
+		struct xdp2_fifo_stats *stats = FIFO_FIELD_XLAT(fifo, stats);
+
+		if (num_enqueued < stats->consumer.min_enqueued)
+			stats->consumer.min_enqueued = num_enqueued;
+	}
+
+	if (num_enqueued < fifo->low_water_mark &&
+	    __atomic_load_n(&fifo->queue_full, __ATOMIC_SEQ_CST) &&
+	    __atomic_exchange_n(&fifo->queue_full, false, __ATOMIC_SEQ_CST)) {
+		__XDP2_FIFO_BUMP_CONS_COUNT(fifo, unblocked);
+
+		if (fifo->write_poll)
+			xdp2_fifo_make_writable(fifo);
+	}
+
+	if (!num_enqueued && fifo->read_poll)
+		xdp2_fifo_make_non_readable_after_dequeue(fifo);
+
+	if (atomic_load_explicit(&fifo->num_enqueue_waiters,
+				 memory_order_relaxed))
+		__xdp2_fifo_ring_wake(fifo, fifo->producer_cond);
+
+	return n;
+}
+
+/* Burst enqueue. Enqueue up to count messages of num __u64's each from
+ * messagesp (consecutive with a stride of num). Returns the number of
+ * messages enqueued. If wait is set then block until at least one message
+ * is enqueued
+ *
+ * In locked mode this takes the FIFO mutex for each message
+ */
+static inline unsigned int ___xdp2_fifo_enqueue_burst(struct xdp2_fifo *fifo,
+		unsigned int num, __u64 *messagesp, unsigned int count,
+		bool wait, char *_file, int _line)
+{
+	unsigned int n;
+
+	__XDP2_FIFO_BUMP_PROD_COUNT(fifo, requests);
+
+	if (fifo->mode != XDP2_FIFO_MODE_LOCKED) {
+		n = ___xdp2_fifo_ring_enqueue(fifo, num, messagesp, count,
+					      true, wait, _file, _line);
+	} else {
+		for (n = 0; n < count; n++)
+			if (!___xdp2_fifo_sw_enqueue(fifo, num,
+						     &messagesp[n * num],
+						     wait && !n, _file, _line))
+				break;
+	}
+
+	if (n)
+		fifo->num_enqueued += n;
+	else if (count)
+		__XDP2_FIFO_BUMP_PROD_COUNT(fifo, fails);
+
+	return n;
+}
+
+#define __xdp2_fifo_enqueue_burst(FIFO, NUM, MESSAGESP, COUNT, WAIT)	\
+	___xdp2_fifo_enqueue_burst(FIFO, NUM, MESSAGESP, COUNT, WAIT,	\
+				   __FILE__, __LINE__)
+
+#define xdp2_fifo_enqueue_burst(FIFO, MESSAGESP, COUNT, WAIT)		\
+	__xdp2_fifo_enqueue_burst(FIFO, 1, MESSAGESP, COUNT, WAIT)
+
+/* Burst dequeue. Dequeue up to count messages of num __u64's each into
+ * messagesp (consecutive with a stride of num). Returns the number of
+ * messages dequeued. If wait is set then block until at least one message
+ * is dequeued
+ *
+ * In locked mode this takes the FIFO mutex for each message
+ */
+static inline unsigned int ___xdp2_fifo_dequeue_burst(struct xdp2_fifo *fifo,
+		unsigned int num, __u64 *messagesp, unsigned int count,
+		bool wait, char *_file, int _line)
+{
+	unsigned int n;
+
+	if (fifo->mode != XDP2_FIFO_MODE_LOCKED) {
+		n = ___xdp2_fifo_ring_dequeue(fifo, num, messagesp, count,
+					      true, wait, _file, _line);
+	} else {
+		for (n = 0; n < count; n++)
+			if (!___xdp2_fifo_sw_dequeue(fifo, num,
+						     &messagesp[n * num],
+						     wait && !n, _file, _line))
+				break;
+	}
+
+	if (n)
+		fifo->num_dequeued += n;
+	else if (count)
+		__XDP2_FIFO_BUMP_CONS_COUNT(fifo, fails);
+
+	return n;
+}
+
+#define __xdp2_fifo_dequeue_burst(FIFO, NUM, MESSAGESP, COUNT, WAIT)	\
+	___xdp2_fifo_dequeue_burst(FIFO, NUM, MESSAGESP, COUNT, WAIT,	\
+				   __FILE__, __LINE__)
+
+#define xdp2_fifo_dequeue_burst(FIFO, MESSAGESP, COUNT, WAIT)		\
+	__xdp2_fifo_dequeue_burst(FIFO, 1, MESSAGESP, COUNT, WAIT)
+
 /* Initialize the FIFO. The consumer and producer variables are initialized
  * in separate calls. This allows the common FIFO structure to first be
  * initialized, and then the two parties each initialize their part of the
@@ -1713,18 +2237,25 @@ static inline bool ___xdp2_fifo_dequeue(struct xdp2_fifo *fifo,
  *
  * Initializes the FIFO mutex
  */
-static inline void __xdp2_fifo_init(struct xdp2_fifo *fifo,
-				    unsigned int num_ents,
-				    unsigned int ent_size,
-				    unsigned int low_water_mark,
-				    struct xdp2_fifo_stats *stats,
-				    int addr_xlat_num)
-{
+static inline void __xdp2_fifo_init_mode(struct xdp2_fifo *fifo,
+					 unsigned int num_ents,
+					 unsigned int ent_size,
+					 unsigned int low_water_mark,
+					 struct xdp2_fifo_stats *stats,
+					 int addr_xlat_num,
+					 enum xdp2_fifo_mode mode)
+{
+	XDP2_ASSERT(mode == XDP2_FIFO_MODE_LOCKED ||
+		    (num_ents && !(num_ents & (num_ents - 1))),
+		    "Lock-free FIFO number of entries %u is not a power "
+		    "of two", num_ents);
+
 	memset(fifo, 0, sizeof(*fifo));
 
 	fifo->num_ents = num_ents;
 	fifo->ent_size = ent_size;
 	fifo->low_water_mark = low_water_mark;
+	fifo->mode = mode;
 
 	/* Save pointer to stats structure as a relative address */
 	if (stats) {
@@ -1740,6 +2271,17 @@ static inline void __xdp2_fifo_init(struct xdp2_fifo *fifo,
 	fifo->initted = true;
 }
 
+static inline void __xdp2_fifo_init(struct xdp2_fifo *fifo,
+				    unsigned int num_ents,
+				    unsigned int ent_size,
+				    unsigned int low_water_mark,
+				    struct xdp2_fifo_stats *stats,
+				    int addr_xlat_num)
+{
+	__xdp2_fifo_init_mode(fifo, num_ents, ent_size, low_water_mark,
+			      stats, addr_xlat_num, XDP2_FIFO_MODE_LOCKED);
+}
+
 static inline void xdp2_fifo_init(struct xdp2_fifo *fifo,
 				  unsigned int num_ents,
 				  unsigned int low_water_mark,
@@ -1785,23 +2327,37 @@ static inline void xdp2_fifo_init_fifos(struct xdp2_fifo *fifo,
 	__XDP2_FIFO_SIZE(LIMIT, 1)
 
 /* Allocate memory and initialize a FIFO */
-static inline struct xdp2_fifo *__xdp2_fifo_create(
+static inline struct xdp2_fifo *__xdp2_fifo_create_mode(
 		unsigned int num_ents, unsigned int ent_size,
 		unsigned int low_water_mark, struct xdp2_fifo_stats *stats,
-		int addr_xlat_num)
+		int addr_xlat_num, enum xdp2_fifo_mode mode)
 {
 	struct xdp2_fifo *fifo;
 
-	fifo = calloc(1, __XDP2_FIFO_SIZE(num_ents, ent_size));
+	fifo = aligned_alloc(XDP2_CACHELINE_SIZE,
+			     xdp2_round_up(__XDP2_FIFO_SIZE(num_ents, ent_size),
+					   XDP2_CACHELINE_SIZE));
 	if (!fifo)
 		return NULL;
 
-	__xdp2_fifo_init(fifo, num_ents, ent_size, low_water_mark, stats,
-			 addr_xlat_num);
+	memset(fifo, 0, __XDP2_FIFO_SIZE(num_ents, ent_size));
+
+	__xdp2_fifo_init_mode(fifo, num_ents, ent_size, low_water_mark, stats,
+			      addr_xlat_num, mode);
 
 	return fifo;
 }
 
+static inline struct xdp2_fifo *__xdp2_fifo_create(
+		unsigned int num_ents, unsigned int ent_size,
+		unsigned int low_water_mark, struct xdp2_fifo_stats *stats,
+		int addr_xlat_num)
+{
+	return __xdp2_fifo_create_mode(num_ents, ent_size, low_water_mark,
+				       stats, addr_xlat_num,
+				       XDP2_FIFO_MODE_LOCKED);
+}
+
 static inline struct xdp2_fifo *xdp2_fifo_create(
 		unsigned int num_ents, unsigned int low_water_mark,
 		struct xdp2_fifo_stats *stats)
@@ -1810,6 +2366,14 @@ static inline struct xdp2_fifo *xdp2_fifo_create(
 				  XDP2_ADDR_XLAT_NO_XLAT);
 }
 
+static inline struct xdp2_fifo *xdp2_fifo_create_mode(
+		unsigned int num_ents, unsigned int low_water_mark,
+		struct xdp2_fifo_stats *stats, enum xdp2_fifo_mode mode)
+{
+	return __xdp2_fifo_create_mode(num_ents, 1, low_water_mark, stats,
+				       XDP2_ADDR_XLAT_NO_XLAT, mode);
+}
+
 /* Initialize the producer side of a FIFO.
  *
  * Takes the FIFO mutex
@@ -209,6 +209,7 @@ struct xdp2_proto_flag_fields_table_entry {
 struct xdp2_proto_flag_fields_table {
 	int num_ents;
 	const struct xdp2_proto_flag_fields_table_entry *entries;
+	struct xdp2_proto_dispatch *dispatch;
 };
 
 /* A flag-fields parse node. Note this is a super structure for a XDP2 parse
@@ -249,11 +250,13 @@ struct xdp2_proto_flag_fields_def {
 	static const struct xdp2_proto_flag_fields_table_entry		\
 					__##NAME[] =			\
 		{ __XDP2_MAKE_FLAG_FIELD_TABLE_ENTRIES(__VA_ARGS__) };	\
+	XDP2_MAKE_PROTO_DISPATCH(__##NAME##_dispatch);			\
 	static const struct xdp2_proto_flag_fields_table NAME = {	\
 		.num_ents = sizeof(__##NAME) /				\
 			sizeof(struct					\
 				xdp2_proto_flag_fields_table_entry),	\
 		.entries = __##NAME,					\
+		XDP2_PROTO_DISPATCH_REF(__##NAME##_dispatch)		\
 	}
 
 /* Forward declarations for flag-fields parse nodes */
@@ -0,0 +1,478 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XDP2_HASH_H__
+#define __XDP2_HASH_H__
+
+/* Pluggable hash functions
+ *
+ * Hash functions used for metadata hashing in the parser and for keying
+ * dynamic tables. The algorithm is selected at runtime by configuration:
+ *
+ *	XDP2_HASH_SIPHASH: SipHash-2-4, a keyed PRF that resists hash
+ *		flooding. This is the default
+ *	XDP2_HASH_CRC32C: two lanes of CRC32C computed with the CRC32
+ *		instruction when available (SSE4.2 on x86, the CRC extension
+ *		on ARMv8). The low 32 bits are the first lane, the high
+ *		32 bits are the second lane over rotated words
+ *	XDP2_HASH_XXH3: an xxHash3 style hash that mixes sixteen bytes
+ *		at a time with a 64x64->128 bit multiply and fold
+ *	XDP2_HASH_TOEPLITZ: the Toeplitz hash used by NICs for receive side
+ *		scaling (RSS). With the same key and input ordering the result
+ *		matches the hash reported by the NIC. The result is 32 bits
+ *
+ * CRC32C, xxHash3 style, and Toeplitz are not cryptographically strong and
+ * should only be used where the hash inputs aren't attacker controlled or
+ * when compatibility with a NIC is required. All the algorithms produce
+ * the same result for the same input and key regardless of the CPU
+ * features used to compute them
+ */
+
+#include <errno.h>
+#include <linux/types.h>
+#include <stddef.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__bpf__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include "siphash/siphash.h"
+
+enum xdp2_hash_algo {
+	XDP2_HASH_SIPHASH = 0,
+	XDP2_HASH_CRC32C,
+	XDP2_HASH_XXH3,
+	XDP2_HASH_TOEPLITZ,
+
+	__XDP2_HASH_MAX
+};
+
+#define XDP2_HASH_TOEPLITZ_KEY_LEN	40
+
+/* The default RSS key from the Microsoft RSS specification. This is the
+ * key most NIC drivers program by default
+ */
+#define XDP2_HASH_TOEPLITZ_DEFAULT_KEY {				\
+	0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,			\
+	0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,			\
+	0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,			\
+	0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,			\
+	0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,			\
+}
+
+/* Precomputed lookup tables for the Toeplitz hash with one key. tbl[i][v]
+ * is the XOR of the key windows selected by the bits of byte value v at
+ * byte position i of the input, so the hash is one table lookup per input
+ * byte instead of one conditional XOR per input bit. The key windows
+ * repeat with the key length so there is a table for each key byte
+ */
+struct xdp2_hash_toeplitz_tbl {
+	__u32 tbl[XDP2_HASH_TOEPLITZ_KEY_LEN][256];
+};
+
+/* Keys for all the hash algorithms. siphash is the SipHash key, seed seeds
+ * CRC32C and xxHash3 style hashes, and toeplitz is the RSS key. If
+ * toeplitz_tbl is set it holds the lookup tables for the toeplitz key and
+ * is used to compute the Toeplitz hash
+ */
+struct xdp2_hash_key {
+	siphash_key_t siphash;
+	__u64 seed;
+	__u8 toeplitz[XDP2_HASH_TOEPLITZ_KEY_LEN];
+	const struct xdp2_hash_toeplitz_tbl *toeplitz_tbl;
+};
+
+/* Return the name of a hash algorithm */
+static inline const char *xdp2_hash_algo_name(enum xdp2_hash_algo algo)
+{
+	switch (algo) {
+	case XDP2_HASH_SIPHASH:
+		return "siphash";
+	case XDP2_HASH_CRC32C:
+		return "crc32c";
+	case XDP2_HASH_XXH3:
+		return "xxh3";
+	case XDP2_HASH_TOEPLITZ:
+		return "toeplitz";
+	default:
+		return "unknown";
+	}
+}
+
+/* Return the hash algorithm for a name or -EINVAL if the name isn't known */
+static inline int xdp2_hash_algo_from_name(const char *name)
+{
+	int i;
+
+	for (i = 0; i < __XDP2_HASH_MAX; i++)
+		if (!strcmp(name, xdp2_hash_algo_name(i)))
+			return i;
+
+	return -EINVAL;
+}
+
+/* Load up to eight bytes into a word with the missing high order bytes
+ * set to zero. Overlapping loads avoid a variable length copy, the bytes
+ * in the overlap are the same in both loads so ORing them is harmless
+ */
+static inline __u64 __xdp2_hash_load_partial(const __u8 *p, size_t len)
+{
+	__u32 lo, hi;
+
+	if (len >= sizeof(__u32)) {
+		memcpy(&lo, p, sizeof(lo));
+		memcpy(&hi, p + len - sizeof(hi), sizeof(hi));
+
+		return lo | ((__u64)hi << ((len - sizeof(hi)) * 8));
+	}
+
+	if (!len)
+		return 0;
+
+	return p[0] | ((__u64)p[len / 2] << (len / 2 * 8)) |
+	       ((__u64)p[len - 1] << ((len - 1) * 8));
+}
+
+static inline __u64 __xdp2_hash_load64(const __u8 *p)
+{
+	__u64 v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline __u64 __xdp2_hash_rol64(__u64 v, unsigned int shift)
+{
+	return (v << shift) | (v >> (64 - shift));
+}
+
+/* CRC32C hash */
+
+static inline __u32 __xdp2_hash_crc32c_sw_step(__u32 crc, __u64 v)
+{
+	int i, j;
+
+	for (i = 0; i < 8; i++, v >>= 8) {
+		crc ^= (__u8)v;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+	}
+
+	return crc;
+}
+
+/* Compute two CRC32C lanes over the input with STEP folding a 64-bit word
+ * into a lane. This is always inlined so that STEP is a direct call
+ */
+static inline __attribute__((always_inline)) __u64 __xdp2_hash_crc32c_lanes(
+		const void *data, size_t len, __u64 seed,
+		__u32 (*step)(__u32 crc, __u64 v))
+{
+	__u32 a = (__u32)seed ^ (__u32)len, b = (__u32)(seed >> 32);
+	const __u8 *p = data;
+	__u64 v;
+
+	for (; len >= sizeof(__u64); len -= sizeof(__u64),
+				     p += sizeof(__u64)) {
+		v = __xdp2_hash_load64(p);
+		a = step(a, v);
+		b = step(b, __xdp2_hash_rol64(v, 32));
+	}
+
+	if (len) {
+		v = __xdp2_hash_load_partial(p, len);
+		a = step(a, v);
+		b = step(b, __xdp2_hash_rol64(v, 32));
+	}
+
+	return ((__u64)b << 32) | a;
+}
+
+static inline __u64 __xdp2_hash_crc32c_sw(const void *data, size_t len,
+					  __u64 seed)
+{
+	return __xdp2_hash_crc32c_lanes(data, len, seed,
+					__xdp2_hash_crc32c_sw_step);
+}
+
+#if defined(__x86_64__) && !defined(__bpf__)
+
+static inline __attribute__((target("sse4.2"))) __u32
+__xdp2_hash_crc32c_hw_step(__u32 crc, __u64 v)
+{
+	return _mm_crc32_u64(crc, v);
+}
+
+static inline __attribute__((target("sse4.2"))) __u64
+__xdp2_hash_crc32c_hw(const void *data, size_t len, __u64 seed)
+{
+	return __xdp2_hash_crc32c_lanes(data, len, seed,
+					__xdp2_hash_crc32c_hw_step);
+}
+
+#elif defined(__ARM_FEATURE_CRC32)
+
+static inline __u32 __xdp2_hash_crc32c_hw_step(__u32 crc, __u64 v)
+{
+	return __crc32cd(crc, v);
+}
+
+static inline __u64 __xdp2_hash_crc32c_hw(const void *data, size_t len,
+					  __u64 seed)
+{
+	return __xdp2_hash_crc32c_lanes(data, len, seed,
+					__xdp2_hash_crc32c_hw_step);
+}
+
+#endif
+
+/* Compute the CRC32C hash. When the compiler target doesn't include the
+ * CRC32 instruction on x86 the CPU is checked at runtime and the table
+ * free software version is used as a fallback
+ */
+static inline __u64 xdp2_hash_crc32c(const void *data, size_t len,
+				     __u64 seed)
+{
+#if (defined(__SSE4_2__) && defined(__x86_64__)) || \
+    defined(__ARM_FEATURE_CRC32)
+	return __xdp2_hash_crc32c_hw(data, len, seed);
+#elif defined(__x86_64__) && !defined(__bpf__)
+	if (__builtin_cpu_supports("sse4.2"))
+		return __xdp2_hash_crc32c_hw(data, len, seed);
+
+	return __xdp2_hash_crc32c_sw(data, len, seed);
+#else
+	return __xdp2_hash_crc32c_sw(data, len, seed);
+#endif
+}
+
+/* xxHash3 style hash */
+
+#define XDP2_HASH_PRIME64_1	0x9e3779b185ebca87ULL
+#define XDP2_HASH_PRIME64_2	0xc2b2ae3d27d4eb4fULL
+
+/* Multiply two 64-bit words to a 128-bit result and fold the halves */
+static inline __u64 __xdp2_hash_mul_fold(__u64 a, __u64 b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)a * b;
+
+	return (__u64)r ^ (__u64)(r >> 64);
+#else
+	__u64 lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+	__u64 hi_lo = (a >> 32) * (b & 0xffffffff);
+	__u64 lo_hi = (a & 0xffffffff) * (b >> 32);
+	__u64 hi_hi = (a >> 32) * (b >> 32);
+	__u64 cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+
+	return ((cross << 32) | (lo_lo & 0xffffffff)) ^
+	       (hi_hi + (hi_lo >> 32) + (cross >> 32));
+#endif
+}
+
+static inline __u64 __xdp2_hash_xxh3_mix16(__u64 w0, __u64 w1,
+					   __u64 seed, unsigned int i)
+{
+	static const __u64 secret[8] = {
+		0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL,
+		0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+		0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL,
+		0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+	};
+
+	i = (i * 2) & 7;
+
+	return __xdp2_hash_mul_fold(w0 ^ (secret[i] + seed),
+				    w1 ^ (secret[i + 1] - seed));
+}
+
+static inline __u64 __xdp2_hash_avalanche(__u64 h)
+{
+	h ^= h >> 37;
+	h *= 0x165667919e3779f9ULL;
+	h ^= h >> 32;
+
+	return h;
+}
+
+static inline __u64 xdp2_hash_xxh3(const void *data, size_t len, __u64 seed)
+{
+	__u64 acc = seed ^ (len * XDP2_HASH_PRIME64_1);
+	const __u8 *p = data;
+	unsigned int i = 0;
+	size_t rem = len;
+
+	for (; rem >= 16; rem -= 16, p += 16, i++)
+		acc += __xdp2_hash_xxh3_mix16(__xdp2_hash_load64(p),
+					      __xdp2_hash_load64(p + 8),
+					      seed, i);
+
+	if (rem) {
+		__u64 w0, w1;
+
+		if (len >= 16) {
+			/* Overlap the tail with the previous block */
+			p = (const __u8 *)data + len - 16;
+			w0 = __xdp2_hash_load64(p);
+			w1 = __xdp2_hash_load64(p + 8);
+		} else if (rem > 8) {
+			w0 = __xdp2_hash_load64(p);
+			w1 = __xdp2_hash_load_partial(p + 8, rem - 8);
+		} else {
+			w0 = __xdp2_hash_load_partial(p, rem);
+			w1 = XDP2_HASH_PRIME64_2;
+		}
+		acc += __xdp2_hash_xxh3_mix16(w0, w1, seed, i);
+	}
+
+	return __xdp2_hash_avalanche(acc);
+}
+
+/* Toeplitz hash */
+
+/* Compute the Toeplitz hash of the input. For each set bit of the input,
+ * numbered from the most significant bit of the first byte, the 32 bits of
+ * the key starting at the same bit number are XORed into the result.
+ * The RSS key covers inputs of up to 36 bytes (an IPv6 address pair and
+ * ports), for longer inputs the key wraps around
+ */
+static inline __u32 xdp2_hash_toeplitz(const void *data, size_t len,
+				       const __u8 *key)
+{
+	const __u8 *p = data;
+	unsigned int k = 4;
+	__u32 hash = 0, v;
+	size_t i;
+	int b;
+
+	v = ((__u32)key[0] << 24) | ((__u32)key[1] << 16) |
+	    ((__u32)key[2] << 8) | key[3];
+
+	for (i = 0; i < len; i++) {
+		__u8 next = key[k];
+
+		if (++k == XDP2_HASH_TOEPLITZ_KEY_LEN)
+			k = 0;
+
+		for (b = 7; b >= 0; b--) {
+			if (p[i] & (1 << b))
+				hash ^= v;
+			v = (v << 1) | ((next >> b) & 1);
+		}
+	}
+
+	return hash;
+}
+
+/* Build the Toeplitz lookup tables for a key */
+static inline void xdp2_hash_toeplitz_tbl_init(
+		struct xdp2_hash_toeplitz_tbl *t, const __u8 *key)
+{
+	unsigned int i, j, v;
+	__u32 win[8];
+	__u64 w;
+
+	for (i = 0; i < XDP2_HASH_TOEPLITZ_KEY_LEN; i++) {
+		/* Forty bits of key starting at byte i hold the 32-bit
+		 * windows for the eight bits of the input byte
+		 */
+		for (w = 0, j = 0; j < 5; j++)
+			w = (w << 8) |
+				key[(i + j) % XDP2_HASH_TOEPLITZ_KEY_LEN];
+
+		for (j = 0; j < 8; j++)
+			win[j] = w >> (8 - j);
+
+		t->tbl[i][0] = 0;
+		for (v = 1; v < 256; v++)
+			t->tbl[i][v] = t->tbl[i][v & (v - 1)] ^
+				       win[7 - __builtin_ctz(v)];
+	}
+}
+
+/* Compute the Toeplitz hash of the input using lookup tables as if the
+ * input started at byte pos of a larger input. The hash is linear, so the
+ * hash of a concatenation is the XOR of the hashes of its parts at their
+ * positions
+ */
+static inline __u32 __xdp2_hash_toeplitz_tbl(
+		const struct xdp2_hash_toeplitz_tbl *t, const void *data,
+		size_t len, unsigned int pos)
+{
+	unsigned int k = pos % XDP2_HASH_TOEPLITZ_KEY_LEN;
+	const __u8 *p = data;
+	__u32 hash = 0;
+	size_t i, n;
+
+	/* Inner loop runs to the end of the key without a wrap check */
+	for (; len; len -= n, p += n, k = 0) {
+		n = XDP2_HASH_TOEPLITZ_KEY_LEN - k;
+		if (n > len)
+			n = len;
+
+		for (i = 0; i < n; i++)
+			hash ^= t->tbl[k + i][p[i]];
+	}
+
+	return hash;
+}
+
+/* Compute the Toeplitz hash of the input using lookup tables. Gives the
+ * same result as xdp2_hash_toeplitz with the key of the tables
+ */
+static inline __u32 xdp2_hash_toeplitz_tbl(
+		const struct xdp2_hash_toeplitz_tbl *t, const void *data,
+		size_t len)
+{
+	return __xdp2_hash_toeplitz_tbl(t, data, len, 0);
+}
+
+/* Compute the hash of len bytes of data with a hash algorithm */
+static inline __u64 xdp2_hash(enum xdp2_hash_algo algo, const void *data,
+			      size_t len, const struct xdp2_hash_key *key)
+{
+	switch (algo) {
+	case XDP2_HASH_CRC32C:
+		return xdp2_hash_crc32c(data, len, key->seed);
+	case XDP2_HASH_XXH3:
+		return xdp2_hash_xxh3(data, len, key->seed);
+	case XDP2_HASH_TOEPLITZ:
+		if (key->toeplitz_tbl)
+			return xdp2_hash_toeplitz_tbl(key->toeplitz_tbl, data,
+						      len);
+		return xdp2_hash_toeplitz(data, len, key->toeplitz);
+	case XDP2_HASH_SIPHASH:
+	default:
+		return siphash(data, len, &key->siphash);
+	}
+}
+
+#endif /* __XDP2_HASH_H__ */
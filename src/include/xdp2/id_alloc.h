@@ -0,0 +1,424 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XDP2_ID_ALLOC_H__
+#define __XDP2_ID_ALLOC_H__
+
+/* Hierarchical bitmap ID allocator
+ *
+ * An ID allocator manages the IDs 0 to nbits - 1 in a bitmap with a bit set
+ * for each allocated ID. Finding a free ID by scanning a flat bitmap is
+ * linear in the size of the bitmap and is slow for large, mostly full
+ * bitmaps. The allocator keeps two hierarchies of summary bitmaps on top of
+ * the ID bitmap: in the free hierarchy bit i at level L is set if word i at
+ * level L - 1 has a free ID under it, and in the used hierarchy bit i at
+ * level L is set if word i at level L - 1 has an allocated ID under it.
+ * Levels are added until the top level fits in one word, so a 64-bit word
+ * covers 4K IDs in two levels, 256K IDs in three levels, and 16M IDs in
+ * four levels.
+ *
+ * Allocating, freeing, and finding the next free or allocated ID from
+ * a position are O(levels): a search walks up from the starting word
+ * until a summary word has a candidate at or after the position, and then
+ * walks down taking the first candidate at each level
+ *
+ * The ID bitmap bits past nbits are set so that the last word is full when
+ * all of its IDs are allocated
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xdp2/bitmap.h"
+
+#define XDP2_ID_ALLOC_MAX_LEVELS	6
+
+struct xdp2_id_alloc {
+	unsigned int nbits;
+	unsigned int count;
+	unsigned int levels;
+	unsigned int level_bits[XDP2_ID_ALLOC_MAX_LEVELS];
+	unsigned long *map;
+	unsigned long *free_sum[XDP2_ID_ALLOC_MAX_LEVELS];
+	unsigned long *used_sum[XDP2_ID_ALLOC_MAX_LEVELS];
+};
+
+#define __XDP2_ID_ALLOC_BPW XDP2_BITMAP_BITS_PER_WORD
+
+/* Search for the first candidate at or after pos. Candidates in the ID
+ * bitmap are set bits xor'ed with invert, candidates in the summary
+ * bitmaps are set bits
+ */
+static inline unsigned int __xdp2_id_alloc_search(
+		const struct xdp2_id_alloc *ida, unsigned long *const *sum,
+		unsigned long invert, unsigned int pos)
+{
+	unsigned int level = 0, word;
+	const unsigned long *map;
+	unsigned long v;
+
+	if (!ida->levels)
+		return ida->nbits;
+
+	/* Walk up until a word has a candidate at or after pos */
+	for (;;) {
+		if (pos >= ida->level_bits[level])
+			return ida->nbits;
+
+		map = level ? sum[level] : ida->map;
+		word = pos / __XDP2_ID_ALLOC_BPW;
+		v = (map[word] ^ (level ? 0 : invert)) &
+				(~0UL << (pos % __XDP2_ID_ALLOC_BPW));
+		if (v)
+			break;
+
+		if (level == ida->levels - 1)
+			return ida->nbits;
+
+		pos = word + 1;
+		level++;
+	}
+
+	pos = word * __XDP2_ID_ALLOC_BPW + __builtin_ctzl(v);
+
+	/* Walk down taking the first candidate at each level */
+	while (level--) {
+		map = level ? sum[level] : ida->map;
+		v = map[pos] ^ (level ? 0 : invert);
+		pos = pos * __XDP2_ID_ALLOC_BPW + __builtin_ctzl(v);
+	}
+
+	return pos < ida->nbits ? pos : ida->nbits;
+}
+
+/* Set bit idx at summary level one, and at the levels above while the
+ * word at the level below was empty
+ */
+static inline void __xdp2_id_alloc_sum_set(struct xdp2_id_alloc *ida,
+					   unsigned long **sum,
+					   unsigned int idx)
+{
+	unsigned int level;
+	unsigned long old;
+
+	for (level = 1; level < ida->levels; level++) {
+		old = sum[level][idx / __XDP2_ID_ALLOC_BPW];
+		sum[level][idx / __XDP2_ID_ALLOC_BPW] =
+				old | (1UL << (idx % __XDP2_ID_ALLOC_BPW));
+		if (old)
+			break;
+		idx /= __XDP2_ID_ALLOC_BPW;
+	}
+}
+
+/* Clear bit idx at summary level one, and at the levels above while the
+ * word becomes empty
+ */
+static inline void __xdp2_id_alloc_sum_clear(struct xdp2_id_alloc *ida,
+					     unsigned long **sum,
+					     unsigned int idx)
+{
+	unsigned long *w;
+	unsigned int level;
+
+	for (level = 1; level < ida->levels; level++) {
+		w = &sum[level][idx / __XDP2_ID_ALLOC_BPW];
+		*w &= ~(1UL << (idx % __XDP2_ID_ALLOC_BPW));
+		if (*w)
+			break;
+		idx /= __XDP2_ID_ALLOC_BPW;
+	}
+}
+
+/* Rebuild the summary bitmaps from the ID bitmap */
+static inline void __xdp2_id_alloc_rebuild(struct xdp2_id_alloc *ida)
+{
+	unsigned int level, i;
+	unsigned long v;
+
+	for (level = 1; level < ida->levels; level++) {
+		memset(ida->free_sum[level], 0, XDP2_BITMAP_NUM_BITS_TO_WORDS(
+			ida->level_bits[level]) * sizeof(unsigned long));
+		memset(ida->used_sum[level], 0, XDP2_BITMAP_NUM_BITS_TO_WORDS(
+			ida->level_bits[level]) * sizeof(unsigned long));
+
+		/* Bit i at a level summarizes word i at the level below */
+		for (i = 0; i < ida->level_bits[level]; i++) {
+			if (level == 1) {
+				v = ida->map[i];
+				if (v != ~0UL)
+					xdp2_bitmap_set(ida->free_sum[1], i);
+				if (v)
+					xdp2_bitmap_set(ida->used_sum[1], i);
+				continue;
+			}
+			if (ida->free_sum[level - 1][i])
+				xdp2_bitmap_set(ida->free_sum[level], i);
+			if (ida->used_sum[level - 1][i])
+				xdp2_bitmap_set(ida->used_sum[level], i);
+		}
+	}
+}
+
+/* Compute the levels and allocate the bitmaps for nbits IDs. The ID
+ * bitmap is cleared except for the bits past nbits. Returns zero on
+ * success, -EINVAL if nbits is zero or too large, or -ENOMEM
+ */
+static inline int __xdp2_id_alloc_alloc(struct xdp2_id_alloc *ida,
+					unsigned int nbits)
+{
+	unsigned int level_words[XDP2_ID_ALLOC_MAX_LEVELS];
+	unsigned int levels = 1, total, i;
+	unsigned long *mem;
+
+	if (!nbits)
+		return -EINVAL;
+
+	ida->level_bits[0] = nbits;
+	level_words[0] = XDP2_BITMAP_NUM_BITS_TO_WORDS(nbits);
+	total = level_words[0];
+
+	while (level_words[levels - 1] > 1) {
+		if (levels >= XDP2_ID_ALLOC_MAX_LEVELS)
+			return -EINVAL;
+		ida->level_bits[levels] = level_words[levels - 1];
+		level_words[levels] = XDP2_BITMAP_NUM_BITS_TO_WORDS(
+					ida->level_bits[levels]);
+		total += 2 * level_words[levels];
+		levels++;
+	}
+
+	mem = calloc(total, sizeof(unsigned long));
+	if (!mem)
+		return -ENOMEM;
+
+	ida->map = mem;
+	mem += level_words[0];
+	ida->free_sum[0] = NULL;
+	ida->used_sum[0] = NULL;
+	for (i = 1; i < levels; i++) {
+		ida->free_sum[i] = mem;
+		mem += level_words[i];
+		ida->used_sum[i] = mem;
+		mem += level_words[i];
+	}
+
+	if (nbits % __XDP2_ID_ALLOC_BPW)
+		ida->map[level_words[0] - 1] =
+				~0UL << (nbits % __XDP2_ID_ALLOC_BPW);
+
+	ida->nbits = nbits;
+	ida->levels = levels;
+
+	return 0;
+}
+
+/* Initialize an ID allocator for IDs 0 to nbits - 1, all IDs are free.
+ * Returns zero on success, -EINVAL if nbits is zero or too large, or
+ * -ENOMEM
+ */
+static inline int xdp2_id_alloc_init(struct xdp2_id_alloc *ida,
+				     unsigned int nbits)
+{
+	int err;
+
+	memset(ida, 0, sizeof(*ida));
+
+	err = __xdp2_id_alloc_alloc(ida, nbits);
+	if (err)
+		return err;
+
+	__xdp2_id_alloc_rebuild(ida);
+
+	return 0;
+}
+
+static inline void xdp2_id_alloc_fini(struct xdp2_id_alloc *ida)
+{
+	free(ida->map);
+	memset(ida, 0, sizeof(*ida));
+}
+
+/* Grow an ID allocator to nbits IDs keeping the allocated IDs. An
+ * allocator that was zeroed and not initialized may be grown. Returns
+ * zero on success, -EINVAL if nbits is smaller than the current size or
+ * too large, or -ENOMEM in which case the allocator is unchanged
+ */
+static inline int xdp2_id_alloc_grow(struct xdp2_id_alloc *ida,
+				     unsigned int nbits)
+{
+	struct xdp2_id_alloc nida;
+	unsigned int i;
+	int err;
+
+	if (nbits < ida->nbits)
+		return -EINVAL;
+
+	if (nbits == ida->nbits && ida->levels)
+		return 0;
+
+	memset(&nida, 0, sizeof(nida));
+
+	err = __xdp2_id_alloc_alloc(&nida, nbits);
+	if (err)
+		return err;
+
+	if (ida->levels) {
+		i = XDP2_BITMAP_NUM_BITS_TO_WORDS(ida->nbits);
+		memcpy(nida.map, ida->map, i * sizeof(unsigned long));
+
+		/* The old bits past nbits are now IDs and are free */
+		if (ida->nbits % __XDP2_ID_ALLOC_BPW)
+			nida.map[i - 1] &= ~(~0UL << (ida->nbits %
+						     __XDP2_ID_ALLOC_BPW));
+
+		/* Restore the bits past the new nbits if they share the
+		 * old last word
+		 */
+		if (i == XDP2_BITMAP_NUM_BITS_TO_WORDS(nbits) &&
+		    nbits % __XDP2_ID_ALLOC_BPW)
+			nida.map[i - 1] |= ~0UL << (nbits %
+						    __XDP2_ID_ALLOC_BPW);
+
+		nida.count = ida->count;
+	}
+
+	__xdp2_id_alloc_rebuild(&nida);
+
+	free(ida->map);
+	*ida = nida;
+
+	return 0;
+}
+
+/* Return true if an ID is allocated */
+static inline bool xdp2_id_alloc_test(const struct xdp2_id_alloc *ida,
+				      unsigned int id)
+{
+	return id < ida->nbits && xdp2_bitmap_isset(ida->map, id);
+}
+
+/* Mark an ID as allocated. Returns false if the ID was already allocated
+ * or is out of range
+ */
+static inline bool xdp2_id_alloc_set(struct xdp2_id_alloc *ida,
+				     unsigned int id)
+{
+	unsigned int word = id / __XDP2_ID_ALLOC_BPW;
+	unsigned long bit = 1UL << (id % __XDP2_ID_ALLOC_BPW);
+	unsigned long old;
+
+	if (id >= ida->nbits)
+		return false;
+
+	old = ida->map[word];
+	if (old & bit)
+		return false;
+
+	ida->map[word] = old | bit;
+	ida->count++;
+
+	if (!old)
+		__xdp2_id_alloc_sum_set(ida, ida->used_sum, word);
+	if (ida->map[word] == ~0UL)
+		__xdp2_id_alloc_sum_clear(ida, ida->free_sum, word);
+
+	return true;
+}
+
+/* Free an ID. Returns false if the ID was not allocated or is out of
+ * range
+ */
+static inline bool xdp2_id_alloc_clear(struct xdp2_id_alloc *ida,
+				       unsigned int id)
+{
+	unsigned int word = id / __XDP2_ID_ALLOC_BPW;
+	unsigned long bit = 1UL << (id % __XDP2_ID_ALLOC_BPW);
+	unsigned long old;
+
+	if (id >= ida->nbits)
+		return false;
+
+	old = ida->map[word];
+	if (!(old & bit))
+		return false;
+
+	ida->map[word] = old & ~bit;
+	ida->count--;
+
+	if (old == ~0UL)
+		__xdp2_id_alloc_sum_set(ida, ida->free_sum, word);
+	if (!ida->map[word])
+		__xdp2_id_alloc_sum_clear(ida, ida->used_sum, word);
+
+	return true;
+}
+
+/* Find the first free ID at or after pos. Returns nbits if there is none */
+static inline unsigned int xdp2_id_alloc_find_next_free(
+		const struct xdp2_id_alloc *ida, unsigned int pos)
+{
+	return __xdp2_id_alloc_search(ida, ida->free_sum, ~0UL, pos);
+}
+
+/* Find the first allocated ID at or after pos. Returns nbits if there is
+ * none
+ */
+static inline unsigned int xdp2_id_alloc_find_next(
+		const struct xdp2_id_alloc *ida, unsigned int pos)
+{
+	return __xdp2_id_alloc_search(ida, ida->used_sum, 0, pos);
+}
+
+/* Allocate the lowest free ID at or after pos. Returns nbits if all the
+ * IDs from pos are allocated
+ */
+static inline unsigned int xdp2_id_alloc_get_from(struct xdp2_id_alloc *ida,
+						  unsigned int pos)
+{
+	unsigned int id = xdp2_id_alloc_find_next_free(ida, pos);
+
+	if (id < ida->nbits)
+		xdp2_id_alloc_set(ida, id);
+
+	return id;
+}
+
+/* Allocate the lowest free ID. Returns nbits if all IDs are allocated */
+static inline unsigned int xdp2_id_alloc_get(struct xdp2_id_alloc *ida)
+{
+	return xdp2_id_alloc_get_from(ida, 0);
+}
+
+/* Iterate over the allocated IDs in order */
+#define xdp2_id_alloc_foreach(IDA, ID)					\
+	for ((ID) = xdp2_id_alloc_find_next(IDA, 0);			\
+	     (ID) < (IDA)->nbits;					\
+	     (ID) = xdp2_id_alloc_find_next(IDA, (ID) + 1))
+
+#endif /* __XDP2_ID_ALLOC_H__ */
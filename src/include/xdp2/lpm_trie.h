@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XDP2_LPM_TRIE_H__
+#define __XDP2_LPM_TRIE_H__
+
+/* Multibit trie for longest prefix match
+ *
+ * The trie is a tree bitmap with an eight bit stride. Each node covers one
+ * byte of the key. A node has an internal bitmap of the prefixes of length
+ * zero to seven bits that terminate in the node, and an external bitmap of
+ * the child nodes for the 256 values of the byte. The values and children
+ * of a node are kept in dense arrays indexed by the rank of a bit in the
+ * corresponding bitmap, so a node is compact regardless of how many
+ * prefixes or children it has. A lookup visits at most one node per key
+ * byte (four for an IPv4 address, sixteen for IPv6)
+ *
+ * Keys are arbitrary byte strings of a fixed length for a trie, and prefix
+ * lengths are in bits. Values are opaque pointers
+ *
+ * If qsbr is set in a trie then lookups may run concurrently with updates
+ * (updates must still be serialized). Updates copy the nodes on the path
+ * to the changed prefix and publish a new root, and the replaced arrays
+ * are freed after a QSBR grace period
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <linux/types.h>
+
+struct xdp2_lpm_trie_node;
+struct xdp2_qsbr;
+
+struct xdp2_lpm_trie {
+	size_t key_len;
+	struct xdp2_lpm_trie_node *root;
+	unsigned int num_prefixes;
+	unsigned int num_nodes;
+	struct xdp2_qsbr *qsbr;
+};
+
+/* Initialize a trie for keys of key_len bytes */
+void xdp2_lpm_trie_init(struct xdp2_lpm_trie *trie, size_t key_len);
+
+/* Free all the nodes in a trie */
+void xdp2_lpm_trie_destroy(struct xdp2_lpm_trie *trie);
+
+/* Insert a prefix. Returns zero on success, -EALREADY if the prefix is
+ * already in the trie, -EINVAL if the prefix length is longer than the
+ * key, or -ENOMEM
+ */
+int xdp2_lpm_trie_insert(struct xdp2_lpm_trie *trie, const void *key,
+			 size_t prefix_len, const void *value);
+
+/* Delete a prefix. Returns zero on success or -ENOENT if the prefix is not
+ * in the trie
+ */
+int xdp2_lpm_trie_delete(struct xdp2_lpm_trie *trie, const void *key,
+			 size_t prefix_len);
+
+/* Replace the value of a prefix. Concurrent lookups return either the
+ * old or the new value. Returns zero on success or -ENOENT if the prefix
+ * is not in the trie
+ */
+int xdp2_lpm_trie_replace(struct xdp2_lpm_trie *trie, const void *key,
+			  size_t prefix_len, const void *value);
+
+/* Return the value for an exact prefix or NULL if it's not in the trie */
+const void *xdp2_lpm_trie_find(const struct xdp2_lpm_trie *trie,
+			       const void *key, size_t prefix_len);
+
+/* Return the value of the longest prefix matching the key or NULL if
+ * there is no match
+ */
+const void *xdp2_lpm_trie_lookup(const struct xdp2_lpm_trie *trie,
+				 const void *key);
+
+/* Get a trie for an array of static LPM table entries. The trie is built
+ * on first use and saved in *ptrie, subsequent calls return the saved trie.
+ * Each entry is entry_size bytes with the key at offset zero and an
+ * unsigned int prefix length at prefix_len_off. The values in the trie are
+ * pointers to the entries. Entries with a zero prefix length are not
+ * inserted. Returns NULL if the trie can't be built
+ */
+const struct xdp2_lpm_trie *xdp2_lpm_trie_get_static(
+		struct xdp2_lpm_trie **ptrie, const void *entries,
+		unsigned int num_els, size_t entry_size, size_t key_len,
+		size_t prefix_len_off);
+
+#endif /* __XDP2_LPM_TRIE_H__ */
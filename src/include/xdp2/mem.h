@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XDP2_MEM_H__
+#define __XDP2_MEM_H__
+
+/* Placement of large memory regions
+ *
+ * Packet buffer pools and shared memory regions can be many gigabytes.
+ * Backing them with 2MB or 1GB hugepages cuts TLB misses, binding them to
+ * the NUMA node of the threads that use them avoids cross socket memory
+ * traffic, and pre-faulting them moves page fault cost out of the packet
+ * path.
+ *
+ * A struct xdp2_mem_config describes the placement. A zeroed configuration
+ * means regular pages, no binding, and no pre-faulting, in which case
+ * xdp2_mem_alloc is just calloc. When hugepages are requested but none are
+ * available the memory falls back to regular pages with transparent
+ * hugepages enabled, unless no_fallback is set
+ */
+
+#include <linux/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+enum xdp2_mem_page_size {
+	XDP2_MEM_PAGE_DEFAULT = 0,
+	XDP2_MEM_PAGE_2M,
+	XDP2_MEM_PAGE_1G,
+};
+
+/* Maximum number of NUMA nodes that memory can be bound to */
+#define XDP2_MEM_MAX_NODES	64
+
+struct xdp2_mem_config {
+	enum xdp2_mem_page_size page_size;
+	bool numa_bind;
+	unsigned int numa_node;
+	bool prefault;
+	bool no_fallback;
+};
+
+static inline bool xdp2_mem_config_is_default(
+		const struct xdp2_mem_config *config)
+{
+	return !config || (config->page_size == XDP2_MEM_PAGE_DEFAULT &&
+			   !config->numa_bind && !config->prefault);
+}
+
+/* Return the size in bytes of a page size */
+size_t xdp2_mem_page_bytes(enum xdp2_mem_page_size page_size);
+
+/* Allocate zeroed memory placed according to config (which may be NULL).
+ * Returns NULL on failure
+ */
+void *xdp2_mem_alloc(size_t size, const struct xdp2_mem_config *config);
+
+/* Free memory allocated by xdp2_mem_alloc */
+void xdp2_mem_free(void *p);
+
+/* Return the size of the pages backing memory allocated by xdp2_mem_alloc.
+ * This is the system page size if the allocation fell back to regular
+ * pages
+ */
+size_t xdp2_mem_alloc_page_bytes(const void *p);
+
+/* Bind a page aligned memory range to a NUMA node. Must be called before
+ * the memory is faulted in. Returns zero or a negative errno
+ */
+int xdp2_mem_bind(void *p, size_t size, unsigned int node);
+
+/* Fault in a memory range by writing zero to the first byte of each page.
+ * The memory must be zeroed already, for instance a new anonymous mapping
+ */
+void xdp2_mem_prefault(void *p, size_t size, size_t page_bytes);
+
+/* Return the NUMA node that a CPU belongs to, or -1 if unknown */
+int xdp2_mem_cpu_node(unsigned int cpu);
+
+/* Return the NUMA node of the CPU the calling thread is running on */
+int xdp2_mem_current_node(void);
+
+/* Return the number of possible NUMA nodes */
+unsigned int xdp2_mem_num_nodes(void);
+
+#endif /* __XDP2_MEM_H__ */
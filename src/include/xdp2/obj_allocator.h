@@ -58,6 +58,15 @@ struct xdp2_obj_allocator_free_list {
 	unsigned long allocs;
 	unsigned long alloc_fails;
 
+	/* Per-thread cache stats. These are updated under the mutex when a
+	 * magazine is refilled or flushed
+	 */
+	unsigned int num_cached;
+	unsigned long cache_allocs;
+	unsigned long cache_frees;
+	unsigned long cache_refills;
+	unsigned long cache_flushes;
+
 	XDP2_LOCKS_MUTEX_T mutex; /* Lock for fifo structure */
 };
 
@@ -79,9 +88,46 @@ struct xdp2_obj_allocator {
 
 	void *base; /* Address xlat applies */
 
+	/* Per-thread cache (magazine) configuration. Zero cache_size means
+	 * that objects are allocated and freed directly on the shared free
+	 * list
+	 */
+	unsigned int cache_size;
+	unsigned int cache_batch;
+
 	struct xdp2_obj_allocator_free_list alloc_free_list;
 };
 
+/* Per-thread object caches
+ *
+ * When enabled for an allocator by xdp2_obj_alloc_cache_enable, each thread
+ * keeps a magazine of up to cache_size free objects for the allocator.
+ * Allocs and frees are satisfied from the magazine without taking the
+ * allocator's mutex. An empty magazine is refilled with cache_batch objects
+ * from the shared free list under one lock acquisition, and a full magazine
+ * flushes cache_batch objects back to the shared free list the same way.
+ * Magazines hold absolute object addresses and are private to a thread; they
+ * are flushed when the thread exits or by xdp2_obj_alloc_cache_flush_all
+ */
+
+#define XDP2_OBJ_ALLOC_MAX_THREAD_CACHES 32
+
+struct xdp2_obj_alloc_magazine {
+	struct xdp2_obj_allocator *allocator;
+	unsigned int num;
+	unsigned long allocs; /* Not yet accounted in allocator stats */
+	unsigned long frees; /* Not yet accounted in allocator stats */
+	void **objs;
+};
+
+struct xdp2_obj_alloc_thread_cache {
+	unsigned int num_mags;
+	struct xdp2_obj_alloc_magazine mags[XDP2_OBJ_ALLOC_MAX_THREAD_CACHES];
+};
+
+extern __thread struct xdp2_obj_alloc_thread_cache
+					*__xdp2_obj_alloc_thread_cache;
+
 /* Size of struct xdp2_obj_allocator for FIFO allocators. This is the size
  * of the base object allocator structure plus the size of the queue entries
  * (the number of objects times 8 (each queue entry is eight bytes)
@@ -128,6 +174,45 @@ void __xdp2_obj_alloc_show_allocator(struct xdp2_obj_allocator *allocator,
 				      void *cli, const void *arg),
 				      const void *arg);
 
+/* Enable per-thread caches for an allocator. cache_size is the maximum
+ * number of objects held by a thread's magazine and batch is the number of
+ * objects moved between a magazine and the shared free list at a time (zero
+ * means half of cache_size). This should be called before any objects are
+ * allocated. Returns false if the arguments are invalid
+ */
+bool xdp2_obj_alloc_cache_enable(struct xdp2_obj_allocator *allocator,
+				  unsigned int cache_size, unsigned int batch);
+
+/* Return the objects in the calling thread's magazine for an allocator to
+ * the shared free list
+ */
+void xdp2_obj_alloc_cache_flush(struct xdp2_obj_allocator *allocator);
+
+/* Flush all the magazines of the calling thread and release the thread's
+ * cache. This is called automatically at thread exit
+ */
+void xdp2_obj_alloc_cache_flush_all(void);
+
+struct xdp2_obj_alloc_magazine *__xdp2_obj_alloc_new_magazine(
+				struct xdp2_obj_allocator *allocator);
+
+bool __xdp2_obj_alloc_magazine_refill(struct xdp2_obj_allocator *allocator,
+				       struct xdp2_obj_alloc_magazine *mag);
+
+void __xdp2_obj_alloc_magazine_flush(struct xdp2_obj_allocator *allocator,
+				      struct xdp2_obj_alloc_magazine *mag,
+				      unsigned int num);
+
+/* Bulk allocate up to num objects. Returns the number of objects allocated
+ * which is less than num if the allocator is exhausted
+ */
+unsigned int xdp2_obj_alloc_alloc_bulk(struct xdp2_obj_allocator *allocator,
+				       void **objs, unsigned int num);
+
+/* Bulk free num objects */
+void xdp2_obj_alloc_free_bulk(struct xdp2_obj_allocator *allocator,
+			      void **objs, unsigned int num);
+
 static inline void xdp2_obj_alloc_show_allocator(
 		struct xdp2_obj_allocator *allocator, void *cli)
 {
@@ -251,8 +336,59 @@ static inline void __xdp2_obj_alloc_free_list_free(
 	__xdp2_obj_alloc_free_list_free(ALLOCATOR, OBJ, __FILE__, __LINE__)
 
 #define xdp2_obj_alloc_free_list_free_by_index(ALLOCATOR, INDEX)	\
-		xdp2_obj_alloc_free_list_free(allocator,		\
-			xdp2_obj_alloc_index_to_obj(allocator, index))
+		xdp2_obj_alloc_free_list_free(ALLOCATOR,		\
+			xdp2_obj_alloc_index_to_obj(ALLOCATOR, INDEX))
+
+/* Return the calling thread's magazine for an allocator, or NULL if the
+ * allocator doesn't have per-thread caches enabled
+ */
+static inline struct xdp2_obj_alloc_magazine *xdp2_obj_alloc_get_magazine(
+				struct xdp2_obj_allocator *allocator)
+{
+	struct xdp2_obj_alloc_thread_cache *tcache =
+					__xdp2_obj_alloc_thread_cache;
+	unsigned int i;
+
+	if (!allocator->cache_size)
+		return NULL;
+
+	if (tcache) {
+		for (i = 0; i < tcache->num_mags; i++)
+			if (tcache->mags[i].allocator == allocator)
+				return &tcache->mags[i];
+	}
+
+	return __xdp2_obj_alloc_new_magazine(allocator);
+}
+
+static inline void *__xdp2_obj_alloc_magazine_alloc(
+		struct xdp2_obj_allocator *allocator,
+		struct xdp2_obj_alloc_magazine *mag, unsigned int *num)
+{
+	void *obj;
+
+	if (!mag->num && !__xdp2_obj_alloc_magazine_refill(allocator, mag))
+		return NULL;
+
+	obj = mag->objs[--mag->num];
+	mag->allocs++;
+
+	*num = xdp2_obj_alloc_obj_to_index(allocator, obj);
+
+	return obj;
+}
+
+static inline void __xdp2_obj_alloc_magazine_free(
+		struct xdp2_obj_allocator *allocator,
+		struct xdp2_obj_alloc_magazine *mag, void *obj)
+{
+	if (mag->num >= allocator->cache_size)
+		__xdp2_obj_alloc_magazine_flush(allocator, mag,
+						 allocator->cache_batch);
+
+	mag->objs[mag->num++] = obj;
+	mag->frees++;
+}
 
 static inline void __xdp2_obj_alloc_init(
 		struct xdp2_obj_allocator *allocator,
@@ -287,9 +423,15 @@ static inline void *__xdp2_obj_alloc_alloc(struct xdp2_obj_allocator
 					    unsigned int *num,
 					    char *_file, int _line)
 {
+	struct xdp2_obj_alloc_magazine *mag;
 	void *obj;
 
-	obj = __xdp2_obj_alloc_free_list_alloc(allocator, num, _file, _line);
+	mag = xdp2_obj_alloc_get_magazine(allocator);
+	if (mag)
+		obj = __xdp2_obj_alloc_magazine_alloc(allocator, mag, num);
+	else
+		obj = __xdp2_obj_alloc_free_list_alloc(allocator, num,
+							_file, _line);
 	if (!obj)
 		return NULL;
 
@@ -308,15 +450,22 @@ static inline void *__xdp2_obj_alloc_alloc(struct xdp2_obj_allocator
 static inline void xdp2_obj_alloc_free(struct xdp2_obj_allocator *allocator,
 					void *obj)
 {
+	struct xdp2_obj_alloc_magazine *mag;
+
 	XDP2_OBJ_ALLOC_CHECK(allocator, obj, "Free object: ");
 
-	xdp2_obj_alloc_free_list_free(allocator, obj);
+	mag = xdp2_obj_alloc_get_magazine(allocator);
+	if (mag)
+		__xdp2_obj_alloc_magazine_free(allocator, mag, obj);
+	else
+		xdp2_obj_alloc_free_list_free(allocator, obj);
 }
 
 static inline void xdp2_obj_alloc_free_by_index(
 		struct xdp2_obj_allocator *allocator, unsigned int index)
 {
-	xdp2_obj_alloc_free_list_free_by_index(allocator, index);
+	xdp2_obj_alloc_free(allocator,
+			    xdp2_obj_alloc_index_to_obj(allocator, index));
 }
 
 /* Return the base of the accelerator objects, this is a relative address */
@@ -50,9 +50,10 @@
 #include "xdp2/tlvs.h"
 #include "xdp2/utility.h"
 
-/* Siphash is userspace-only */
+/* Siphash and the other hash functions are userspace-only */
 #if !defined(__KERNEL__) && !defined(__bpf__)
 #include "siphash/siphash.h"
+#include "xdp2/hash.h"
 #endif
 
 /* Text code debugging utilities are userspace-only (use snprintf) */
@@ -198,10 +199,12 @@ static inline const char *xdp2_get_text_code(int code)
 #define XDP2_MAKE_PROTO_TABLE(NAME, ...)				\
 	static const struct xdp2_proto_table_entry __##NAME[] =		\
 		{ __XDP2_MAKE_PROTO_TABLE_ENTRIES(__VA_ARGS__) };	\
+	XDP2_MAKE_PROTO_DISPATCH(__##NAME##_dispatch);			\
 	static const struct xdp2_proto_table NAME =	{		\
 		.num_ents = sizeof(__##NAME) /				\
 				sizeof(struct xdp2_proto_table_entry),	\
 		.entries = __##NAME,					\
+		XDP2_PROTO_DISPATCH_REF(__##NAME##_dispatch)		\
 	}
 
 /* User visible plain parse node. Just contains an xdp2_parse_node structure */
@@ -292,6 +295,55 @@ static inline int __xdp2_parse_fast(const struct xdp2_parser *parser, void *hdr,
 
 bool xdp2_parse_validate_fast(const struct xdp2_parser *parser);
 
+/* Initialize a parser. This builds the dispatch indexes for the protocol
+ * tables in the parse graph so that next protocol lookups are constant time
+ * or logarithmic instead of a linear search. Calling this is optional,
+ * without it lookups use a linear search of the protocol tables
+ */
+#ifndef __KERNEL__
+int xdp2_parser_init(const struct xdp2_parser *parser);
+#else
+static inline int xdp2_parser_init(const struct xdp2_parser *parser)
+{
+	return 0;
+}
+#endif
+
+/* Maximum number of packets parsed together in a burst. Larger bursts are
+ * processed in chunks of this size
+ */
+#define XDP2_PARSE_BURST_MAX		64
+
+/* Descriptor for one packet in a burst
+ *
+ *	- hdr: pointer to start of packet
+ *	- len: length of packet
+ *	- metadata: metadata structure
+ *	- ctrl: control data for the packet
+ *	- ret: XDP2 return code for parsing the packet (output)
+ */
+struct xdp2_parse_burst_pkt {
+	void *hdr;
+	size_t len;
+	void *metadata;
+	struct xdp2_ctrl_data *ctrl;
+	int ret;
+};
+
+#ifndef __KERNEL__
+unsigned int __xdp2_parse_burst(const struct xdp2_parser *parser,
+				struct xdp2_parse_burst_pkt *pkts,
+				unsigned int num, unsigned int flags);
+#else
+static inline unsigned int __xdp2_parse_burst(
+		const struct xdp2_parser *parser,
+		struct xdp2_parse_burst_pkt *pkts,
+		unsigned int num, unsigned int flags)
+{
+	return 0;
+}
+#endif
+
 /* Parse packet starting from a parser node
  *
  * Arguments:
@@ -330,6 +382,45 @@ static inline int xdp2_parse_fast(const struct xdp2_parser *parser,
 	return __xdp2_parse_fast(parser, hdr, len, metadata, ctrl);
 }
 
+/* Parse a burst of packets
+ *
+ * Arguments:
+ *	- parser: Parser being invoked
+ *	- pkts: array of packet descriptors
+ *	- num: number of packets in the burst
+ *	- flags: allowed parameterized parsing
+ *
+ * The XDP2 return code for each packet is set in the ret field of its
+ * descriptor. Returns the number of packets that were parsed with an
+ * okay return code. Optimized parsers don't have a burst entry point so
+ * their packets are parsed one at a time
+ */
+static inline unsigned int xdp2_parse_burst(const struct xdp2_parser *parser,
+					    struct xdp2_parse_burst_pkt *pkts,
+					    unsigned int num,
+					    unsigned int flags)
+{
+	unsigned int i, num_okay = 0;
+
+	switch (parser->parser_type) {
+	case XDP2_GENERIC:
+		return __xdp2_parse_burst(parser, pkts, num, flags);
+	case XDP2_OPTIMIZED:
+		for (i = 0; i < num; i++) {
+			pkts[i].ret = (parser->parser_entry_point)(parser,
+					pkts[i].hdr, pkts[i].len,
+					pkts[i].metadata, pkts[i].ctrl, flags);
+			if (XDP2_CODE_IS_OKAY(pkts[i].ret))
+				num_okay++;
+		}
+		return num_okay;
+	default:
+		for (i = 0; i < num; i++)
+			pkts[i].ret = XDP2_STOP_FAIL;
+		return 0;
+	}
+}
+
 #define XDP2_CTRL_RESET_VAR_DATA(CTRL) do {				\
 	struct xdp2_ctrl_data *_ctrl = (CTRL);				\
 									\
@@ -464,17 +555,18 @@ static inline int __xdp2_parse_run_exit_node(const struct xdp2_parser *parser,
 /* Siphash-related code is userspace-only */
 #if !defined(__KERNEL__) && !defined(__bpf__)
 
-extern siphash_key_t __xdp2_hash_key;
+extern struct xdp2_hash_key __xdp2_hash_key;
+extern enum xdp2_hash_algo __xdp2_hash_algo;
 
-/* Helper functions to compute the siphash from start pointer
- * through len bytes. Note that siphash library expects start to
- * be aligned to 64 bits
+/* Helper functions to compute the hash from start pointer through len
+ * bytes using the configured hash algorithm (see xdp2/hash.h). Note that
+ * siphash library expects start to be aligned to 64 bits
  */
 static inline __u32 xdp2_compute_hash(const void *start, size_t len)
 {
 	__u32 hash;
 
-	hash = siphash(start, len, &__xdp2_hash_key);
+	hash = xdp2_hash(__xdp2_hash_algo, start, len, &__xdp2_hash_key);
 	if (!hash)
 		hash = 1;
 
@@ -508,6 +600,16 @@ static inline __u32 xdp2_compute_hash(const void *start, size_t len)
  */
 void xdp2_hash_secret_init(siphash_key_t *init_key);
 
+/* Set the hash algorithm used by xdp2_compute_hash and
+ * XDP2_COMMON_COMPUTE_HASH. The default is XDP2_HASH_SIPHASH
+ */
+void xdp2_hash_set_algo(enum xdp2_hash_algo algo);
+
+/* Set the key for XDP2_HASH_TOEPLITZ. The default is the RSS key from the
+ * Microsoft RSS specification
+ */
+void xdp2_hash_set_toeplitz_key(const __u8 *key);
+
 /* Function to print the raw bytesused in a hash */
 void xdp2_print_hash_input(const void *start, size_t len);
 
@@ -166,6 +166,7 @@ struct xdp2_xdp_ctx {
 	__u32 frame_num;
 	__u32 next;
 	__u32 offset;
+	__u32 num_encaps;
 	void *metadata;
 	const struct xdp2_parser *parser;
 };
@@ -247,6 +248,62 @@ struct xdp2_proto_table_entry {
 	const struct xdp2_parse_node *node;
 };
 
+/* Dispatch index types for protocol tables */
+enum xdp2_proto_dispatch_type {
+	/* Index not built, linear search of the table entries */
+	XDP2_DISPATCH_NONE = 0,
+	/* Table is small so linear search of the table entries is fastest */
+	XDP2_DISPATCH_LINEAR,
+	/* Direct index array over the range of keys in the table */
+	XDP2_DISPATCH_DENSE,
+	/* Sorted array of keys with binary search */
+	XDP2_DISPATCH_SORTED,
+};
+
+/* Maximum number of entries in a table for which linear search is used */
+#define XDP2_DISPATCH_LINEAR_MAX	4
+
+/* Maximum range of keys for a dense dispatch index. A dense index is also
+ * used if the key range is no more than four times the number of entries
+ */
+#define XDP2_DISPATCH_DENSE_MAX		256
+
+/* Dispatch index for a protocol table
+ *
+ * A dispatch index is an alternative representation of a protocol table
+ * (next protocol, TLV, array element, or flag-fields table) that provides
+ * constant time or logarithmic lookup instead of a linear search of the
+ * table. The index is built by xdp2_parser_init and the representation is
+ * selected based on the number and range of the keys in the table.
+ *
+ * type: Dispatch type
+ * min_key: Minimum key in the table (for DENSE)
+ * num: Number of slots in the dense array or number of sorted keys
+ * keys: Array of sorted keys (for SORTED)
+ * nodes: Nodes indexed by key - min_key (for DENSE), or nodes in order of
+ *	the sorted keys (for SORTED)
+ */
+struct xdp2_proto_dispatch {
+	enum xdp2_proto_dispatch_type type;
+	int min_key;
+	unsigned int num;
+	int *keys;
+	const void **nodes;
+};
+
+/* Helpers for the protocol table macros to instantiate the dispatch index
+ * for a table. The index is userspace only
+ */
+#if !defined(__KERNEL__) && !defined(__bpf__)
+#define XDP2_MAKE_PROTO_DISPATCH(NAME)					\
+	static struct xdp2_proto_dispatch NAME
+#define XDP2_PROTO_DISPATCH_REF(NAME) .dispatch = &NAME,
+#else
+#define XDP2_MAKE_PROTO_DISPATCH(NAME)					\
+	static struct xdp2_proto_dispatch NAME __unused()
+#define XDP2_PROTO_DISPATCH_REF(NAME)
+#endif
+
 /* Protocol table
  *
  * Contains a protocol table that maps a protocol number to a parse
@@ -255,6 +312,7 @@ struct xdp2_proto_table_entry {
 struct xdp2_proto_table {
 	int num_ents;
 	const struct xdp2_proto_table_entry *entries;
+	struct xdp2_proto_dispatch *dispatch;
 };
 
 #define XDP2_PARSE_NODE_F_ZERO_LEN_OK	1
@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XDP2_PGO_H__
+#define __XDP2_PGO_H__
+
+/* Edge profiles for profile guided optimization of parsers
+ *
+ * xdp2-compiler --pgo-instrument builds an optimized parser that counts how
+ * many times each edge of the parse graph is taken. There is one counter
+ * per edge, defined in the xdp2_pgo_section section so that the counters
+ * of all the instrumented parsers in a program can be found at run time.
+ *
+ * xdp2_pgo_write writes the counters as a text profile, one edge per line:
+ *
+ *	<parser> <from node> <to node> <hits>
+ *
+ * Blank lines and lines starting with '#' are comments. The profile is
+ * consumed by xdp2-compiler --profile <file> to lay out the parse functions
+ * for the common case (see documentation/xdp2-compiler.md)
+ */
+
+#include <stdio.h>
+
+#include <linux/types.h>
+
+#include "xdp2/compiler_helpers.h"
+
+struct xdp2_pgo_edge {
+	const char *parser;
+	const char *from;
+	const char *to;
+	__u64 hits;
+} XDP2_ALIGN_SECTION;
+
+XDP2_DEFINE_SECTION(xdp2_pgo_section, struct xdp2_pgo_edge);
+
+/* Define the counter for an edge of an instrumented parser. Emitted by
+ * xdp2-compiler
+ */
+#define XDP2_PGO_EDGE(NAME, PARSER, FROM, TO)				\
+static struct xdp2_pgo_edge NAME					\
+	XDP2_SECTION_ATTR(xdp2_pgo_section) __unused() = {		\
+	.parser = PARSER,						\
+	.from = FROM,							\
+	.to = TO,							\
+}
+
+/* Count a hit on an edge. Parsers may run on several threads so the
+ * counter is bumped atomically
+ */
+static inline void xdp2_pgo_hit(struct xdp2_pgo_edge *edge)
+{
+	__atomic_fetch_add(&edge->hits, 1, __ATOMIC_RELAXED);
+}
+
+/* Return the number of edge counters linked into the program */
+unsigned int xdp2_pgo_num_edges(void);
+
+/* Zero all the edge counters */
+void xdp2_pgo_reset(void);
+
+/* Write the profile to a stream or to a file. Returns zero on success or
+ * a negative errno value
+ */
+int xdp2_pgo_write(FILE *file);
+int xdp2_pgo_write_file(const char *path);
+
+#endif /* __XDP2_PGO_H__ */
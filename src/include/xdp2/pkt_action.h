@@ -27,21 +27,42 @@
 #ifndef __XDP2_PKTACTION_H__
 #define __XDP2_PKTACTION_H__
 
+/* Packet actions
+ *
+ * When packets are received through the packet I/O layer (pkt_io.h), the
+ * packet argument is the packet handle (struct xdp2_pkt_io_pkt) from
+ * xdp2_pkt_io_recv_burst. Sending queues the packet on the device
+ * registered for the port, and dropping frees it. If no device is registered
+ * (for instance when packets are read from a pcap file) the actions are
+ * no-ops
+ */
+
+#include "xdp2/pkt_io.h"
+
 struct xdp2_pkt_send_params {
 	unsigned int port;
 };
 
 static inline void xdp2_pkt_drop(void *pkt)
 {
+	struct xdp2_pkt_io_pkt *ppkt = pkt;
+
+	if (xdp2_pkt_io_num_devs && ppkt)
+		xdp2_pkt_io_free_pkt(ppkt->dev->pvmgr, ppkt);
 }
 
 static inline void xdp2_pkt_send(void *pkt, unsigned int port)
 {
+	struct xdp2_pkt_io_dev *dev = xdp2_pkt_io_get_dev(port);
+
+	if (dev && pkt)
+		xdp2_pkt_io_queue_send(dev, pkt);
 }
 
 static inline void xdp2_pkt_send_params(void *pkt, unsigned int port,
 					struct xdp2_pkt_send_params *params)
 {
+	xdp2_pkt_send(pkt, port);
 }
 
 #endif /* __XDP2_PKTACTION_H__ */
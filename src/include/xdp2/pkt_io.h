@@ -0,0 +1,286 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XDP2_PKT_IO_H__
+#define __XDP2_PKT_IO_H__
+
+/* Packet I/O
+ *
+ * The packet I/O layer sends and receives packets on network interfaces
+ * through pluggable backends. Received packets are placed in pbufs of a
+ * packet buffer manager and are returned to the caller in bursts as packet
+ * handles (struct xdp2_pkt_io_pkt). A handle is passed to the packet actions
+ * in pkt_action.h, so a program can receive a burst, run the parser on each
+ * packet, and drop or send the packets from the handlers. Packets sent by
+ * xdp2_pkt_send are queued per device and transmitted in bursts
+ *
+ * Backends:
+ *
+ *   - "tpacket": AF_PACKET socket with mmap'ed TPACKET_V3 receive and
+ *     transmit rings. The kernel retires blocks of variable sized frames in
+ *     the receive ring; a burst walks the frames of the ready blocks and
+ *     copies each one into a pbuf (the ring memory is owned by the kernel
+ *     and blocks are handed back as soon as they are walked). Transmit
+ *     copies packets into the frames of the transmit ring, and one send()
+ *     kicks the whole burst
+ *
+ *   - "xdp": AF_XDP socket. The UMEM is the memory of the pbuf allocator
+ *     for the configured frame size, so the kernel receives directly into
+ *     pbufs, and pbufs of that size (and pvbufs that consist of a single
+ *     such pbuf) are transmitted without a copy. The fill ring is refilled
+ *     from the pbuf allocator, and pbufs are freed when they are returned
+ *     on the completion ring. A small XDP program that redirects packets
+ *     for the device queue to the socket is loaded and attached to the
+ *     interface. The pbuf size class for the frame size must be configured
+ *     with a page aligned base (see xdp2_pkt_io_alloc_pbuf_base)
+ *
+ *   - "loop": in memory loopback. Packets sent on the device are received
+ *     on the same device without a copy. This is meant for testing
+ *
+ * All the devices that packets are forwarded between must use the same
+ * packet buffer manager since the pbufs of a received packet are freed by
+ * the device that sends it
+ */
+
+#include <linux/types.h>
+#include <net/if.h>
+#include <stdbool.h>
+
+#include "xdp2/pvbuf.h"
+
+#define XDP2_PKT_IO_MAX_PORTS		64
+#define XDP2_PKT_IO_BURST		32
+
+#define XDP2_PKT_IO_DEF_FRAME_SIZE	2048
+#define XDP2_PKT_IO_DEF_NUM_FRAMES	2048
+
+struct xdp2_pkt_io_dev;
+
+/* Packet handle. paddr is a pbuf or a pvbuf that holds the packet, data and
+ * len are the linear packet data for a pbuf (data is NULL for a pvbuf). A
+ * packet action that consumes the packet sets paddr to XDP2_PADDR_NULL
+ */
+struct xdp2_pkt_io_pkt {
+	xdp2_paddr_t paddr;
+	void *data;
+	size_t len;
+	struct xdp2_pkt_io_dev *dev;
+};
+
+/* Device configuration. Zero values select defaults */
+struct xdp2_pkt_io_config {
+	const char *ifname;
+	unsigned int queue_id;
+
+	/* Ethertype to receive in host byte order, zero for all */
+	unsigned short protocol;
+
+	/* Size of a ring frame (also the pbuf size for the xdp backend) and
+	 * number of frames in each ring
+	 */
+	unsigned int frame_size;
+	unsigned int num_frames;
+
+	/* xdp backend: bind in driver zero-copy mode and attach the XDP
+	 * program in driver mode (default is copy mode and generic XDP)
+	 */
+	bool zero_copy;
+	bool drv_mode;
+};
+
+struct xdp2_pkt_io_stats {
+	unsigned long rx_packets;
+	unsigned long rx_bytes;
+	unsigned long rx_drops;
+	unsigned long rx_bursts;
+	unsigned long tx_packets;
+	unsigned long tx_bytes;
+	unsigned long tx_drops;
+	unsigned long tx_bursts;
+	unsigned long tx_zero_copy;
+};
+
+/* Backend operations. recv_burst returns the number of packets received
+ * (without blocking). send_burst consumes all the packets: it returns the
+ * number of packets that were queued to the interface, the rest are freed
+ */
+struct xdp2_pkt_io_ops {
+	const char *name;
+	int (*open)(struct xdp2_pkt_io_dev *dev);
+	void (*close)(struct xdp2_pkt_io_dev *dev);
+	unsigned int (*recv_burst)(struct xdp2_pkt_io_dev *dev,
+				   struct xdp2_pkt_io_pkt *pkts,
+				   unsigned int num);
+	unsigned int (*send_burst)(struct xdp2_pkt_io_dev *dev,
+				   struct xdp2_pkt_io_pkt *pkts,
+				   unsigned int num);
+	int (*poll)(struct xdp2_pkt_io_dev *dev, int timeout);
+};
+
+struct xdp2_pkt_io_dev {
+	const struct xdp2_pkt_io_ops *ops;
+	struct xdp2_pvbuf_mgr *pvmgr;
+	struct xdp2_pkt_io_config config;
+	char ifname[IF_NAMESIZE];
+	int ifindex;
+	unsigned int port;
+	int fd;
+
+	/* Backend private state */
+	void *priv;
+
+	/* Packets queued by xdp2_pkt_io_queue_send */
+	unsigned int num_tx_pending;
+	struct xdp2_pkt_io_pkt tx_pending[XDP2_PKT_IO_BURST];
+
+	struct xdp2_pkt_io_stats stats;
+};
+
+extern struct xdp2_pkt_io_dev *xdp2_pkt_io_ports[XDP2_PKT_IO_MAX_PORTS];
+extern unsigned int xdp2_pkt_io_num_devs;
+
+extern const struct xdp2_pkt_io_ops xdp2_pkt_io_tpacket_ops;
+extern const struct xdp2_pkt_io_ops xdp2_pkt_io_xdp_ops;
+extern const struct xdp2_pkt_io_ops xdp2_pkt_io_loop_ops;
+
+/* Find a backend by name */
+const struct xdp2_pkt_io_ops *xdp2_pkt_io_find_backend(const char *name);
+
+/* Open a device with a backend and register it as a port. Returns NULL on
+ * error
+ */
+struct xdp2_pkt_io_dev *__xdp2_pkt_io_open(struct xdp2_pvbuf_mgr *pvmgr,
+		const char *backend, const struct xdp2_pkt_io_config *config,
+		unsigned int port);
+
+static inline struct xdp2_pkt_io_dev *xdp2_pkt_io_open(const char *backend,
+		const struct xdp2_pkt_io_config *config, unsigned int port)
+{
+	return __xdp2_pkt_io_open(&xdp2_pvbuf_global_mgr, backend, config,
+				  port);
+}
+
+/* Flush pending transmits, close the device, and unregister the port */
+void xdp2_pkt_io_close(struct xdp2_pkt_io_dev *dev);
+
+/* Get the device for a port, NULL if none is registered */
+static inline struct xdp2_pkt_io_dev *xdp2_pkt_io_get_dev(unsigned int port)
+{
+	return port < XDP2_PKT_IO_MAX_PORTS ? xdp2_pkt_io_ports[port] : NULL;
+}
+
+/* Free the packet in a handle if it hasn't been consumed */
+static inline void xdp2_pkt_io_free_pkt(struct xdp2_pvbuf_mgr *pvmgr,
+					struct xdp2_pkt_io_pkt *pkt)
+{
+	if (pkt->paddr == XDP2_PADDR_NULL)
+		return;
+
+	if (XDP2_PADDR_IS_PVBUF(pkt->paddr))
+		__xdp2_pvbuf_free(pvmgr, pkt->paddr);
+	else
+		__xdp2_pbuf_free(pvmgr, pkt->paddr);
+
+	pkt->paddr = XDP2_PADDR_NULL;
+}
+
+/* Receive a burst of packets. Returns the number of packets received */
+unsigned int xdp2_pkt_io_recv_burst(struct xdp2_pkt_io_dev *dev,
+				    struct xdp2_pkt_io_pkt *pkts,
+				    unsigned int num);
+
+/* Release a received burst after processing: packets that were not sent or
+ * dropped by a packet action are freed
+ */
+static inline void xdp2_pkt_io_release_burst(struct xdp2_pkt_io_dev *dev,
+					     struct xdp2_pkt_io_pkt *pkts,
+					     unsigned int num)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++)
+		xdp2_pkt_io_free_pkt(dev->pvmgr, &pkts[i]);
+}
+
+/* Send a burst of packets. The packets are consumed; the number queued to
+ * the interface is returned
+ */
+unsigned int xdp2_pkt_io_send_burst(struct xdp2_pkt_io_dev *dev,
+				    struct xdp2_pkt_io_pkt *pkts,
+				    unsigned int num);
+
+/* Transmit the packets queued on a device */
+static inline void xdp2_pkt_io_flush(struct xdp2_pkt_io_dev *dev)
+{
+	unsigned int num = dev->num_tx_pending;
+
+	if (num) {
+		dev->num_tx_pending = 0;
+		xdp2_pkt_io_send_burst(dev, dev->tx_pending, num);
+	}
+}
+
+/* Transmit the packets queued on all devices */
+void xdp2_pkt_io_flush_all(void);
+
+/* Queue a packet to be sent on a device. The packet is consumed, and the
+ * queue is transmitted when it fills up or is flushed
+ */
+static inline void xdp2_pkt_io_queue_send(struct xdp2_pkt_io_dev *dev,
+					  struct xdp2_pkt_io_pkt *pkt)
+{
+	if (pkt->paddr == XDP2_PADDR_NULL)
+		return;
+
+	dev->tx_pending[dev->num_tx_pending++] = *pkt;
+	pkt->paddr = XDP2_PADDR_NULL;
+
+	if (dev->num_tx_pending == XDP2_PKT_IO_BURST)
+		xdp2_pkt_io_flush(dev);
+}
+
+/* Wait up to timeout milliseconds for packets to receive. Returns greater
+ * than zero if packets may be received, zero on timeout, and less than
+ * zero on error
+ */
+int xdp2_pkt_io_poll(struct xdp2_pkt_io_dev *dev, int timeout);
+
+/* Copy the packet in a handle to a linear buffer. Returns the length of
+ * the packet, or zero if it doesn't fit
+ */
+size_t __xdp2_pkt_io_copy_pkt(struct xdp2_pvbuf_mgr *pvmgr,
+			      struct xdp2_pkt_io_pkt *pkt, void *data,
+			      size_t max_len);
+
+/* Allocate page aligned memory for the objects of a pbuf size class, for
+ * use as the base in struct xdp2_pbuf_init_allocator. Returns NULL on error
+ */
+void *xdp2_pkt_io_alloc_pbuf_base(unsigned int num_objs, size_t size);
+
+/* Print the device and its statistics */
+void xdp2_pkt_io_show_dev(struct xdp2_pkt_io_dev *dev, void *cli);
+
+#endif /* __XDP2_PKT_IO_H__ */
@@ -33,6 +33,7 @@
 
 #include "xdp2/bitmap_word.h"
 #include "xdp2/cli.h"
+#include "xdp2/mem.h"
 #include "xdp2/obj_allocator.h"
 #include "xdp2/utility.h"
 
@@ -1277,7 +1278,11 @@ struct xdp2_pbuf_allocator {
 	atomic_uint refcnt[0];
 };
 
-/* Helper structure for initializing pbuf allocators */
+/* Helper structure for initializing pbuf allocators. mem_config sets the
+ * placement of the pools, allocators, and reference counts that are
+ * allocated by init (see xdp2/mem.h). A zeroed mem_config allocates them
+ * from the heap
+ */
 struct xdp2_pbuf_init_allocator {
 	struct {
 		unsigned int num_objs;
@@ -1286,9 +1291,12 @@ struct xdp2_pbuf_init_allocator {
 		struct xdp2_pbuf_allocator *pallocator;
 		struct xdp2_fifo_stats *fifo_stats;
 	} obj[XDP2_PBUF_NUM_SIZE_SHIFTS];
+	struct xdp2_mem_config mem_config;
 };
 
-/* Helper structure for initializing pvbuf allocators */
+/* Helper structure for initializing pvbuf allocators. mem_config is the
+ * same as for pbuf allocators
+ */
 struct xdp2_pvbuf_init_allocator {
 	struct {
 		unsigned int num_pvbufs;
@@ -1296,6 +1304,7 @@ struct xdp2_pvbuf_init_allocator {
 		struct xdp2_obj_allocator *allocator;
 		struct xdp2_fifo_stats *fifo_stats;
 	} obj[XDP2_PVBUF_NUM_SIZES];
+	struct xdp2_mem_config mem_config;
 };
 
 /* An entry in the pbuf allocator table. The pbuf allocator is an array of
@@ -3165,6 +3174,74 @@ static inline int xdp2_pvbuf_init(struct xdp2_pbuf_init_allocator
 				 short_addr_config, long_addr_config);
 }
 
+/* Per NUMA node packet buffer managers
+ *
+ * A node manager has its pools bound to a NUMA node so that threads
+ * running on the node allocate local memory. Threads select a manager with
+ * xdp2_pvbuf_set_thread_mgr or xdp2_pvbuf_select_node_mgr, and use it via
+ * xdp2_pvbuf_local_mgr with the double underscore functions that take a
+ * pvmgr argument. The front end functions always use the global manager.
+ *
+ * A pvbuf or pbuf must be accessed and freed using the manager that
+ * allocated it. Packets that move between nodes need to be copied or
+ * freed back to the node they came from
+ */
+
+/* Initialize the packet buffer manager for a NUMA node. The allocator
+ * configurations are the same as for xdp2_pvbuf_init except that their
+ * mem_config is bound to node, and any pools given in the configurations
+ * should be node local memory. Returns zero or a negative errno
+ */
+int xdp2_pvbuf_init_node(unsigned int node,
+			 struct xdp2_pbuf_init_allocator *pbuf_allocs,
+			 struct xdp2_pvbuf_init_allocator *pvbuf_allocs,
+			 bool random_pvbuf_size, bool alloc_one_ref);
+
+/* Return the packet buffer manager for a NUMA node, or NULL if the node's
+ * manager hasn't been initialized
+ */
+struct xdp2_pvbuf_mgr *xdp2_pvbuf_node_mgr(unsigned int node);
+
+/* The packet buffer manager selected by the calling thread */
+extern __thread struct xdp2_pvbuf_mgr *xdp2_pvbuf_thread_mgr;
+
+/* Set the packet buffer manager for the calling thread. NULL selects the
+ * global manager
+ */
+static inline void xdp2_pvbuf_set_thread_mgr(struct xdp2_pvbuf_mgr *pvmgr)
+{
+	xdp2_pvbuf_thread_mgr = pvmgr;
+}
+
+/* Select the manager for the NUMA node the calling thread is running on,
+ * or the global manager if that node doesn't have one. The thread should
+ * be pinned to a CPU first. Returns the selected manager
+ */
+struct xdp2_pvbuf_mgr *xdp2_pvbuf_select_node_mgr(void);
+
+/* Return the packet buffer manager selected by the calling thread, or the
+ * global manager if the thread hasn't selected one
+ */
+static inline struct xdp2_pvbuf_mgr *xdp2_pvbuf_local_mgr(void)
+{
+	return xdp2_pvbuf_thread_mgr ? : &xdp2_pvbuf_global_mgr;
+}
+
+/* Enable per-thread object caches on all the pvbuf and pbuf allocators of a
+ * packet buffer manager. See xdp2_obj_alloc_cache_enable
+ */
+bool __xdp2_pvbuf_enable_thread_caches(struct xdp2_pvbuf_mgr *pvmgr,
+				       unsigned int cache_size,
+				       unsigned int batch);
+
+/* Enable per-thread object caches for the global packet buffer manager */
+static inline bool xdp2_pvbuf_enable_thread_caches(unsigned int cache_size,
+						   unsigned int batch)
+{
+	return __xdp2_pvbuf_enable_thread_caches(&xdp2_pvbuf_global_mgr,
+						 cache_size, batch);
+}
+
 /* Print functions */
 
 /* Print a pvbuf managed by the global packet buffer manager */
@@ -0,0 +1,210 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XDP2_QSBR_H__
+#define __XDP2_QSBR_H__
+
+/* Quiescent state based reclamation (QSBR)
+ *
+ * QSBR lets reader threads access shared data structures without locks
+ * or atomic read-modify-write operations while an updater changes them.
+ * An updater unlinks an object so that new readers can't find it, and
+ * frees the object only after a grace period, that is after every reader
+ * thread has passed through a quiescent state where it holds no
+ * references to the shared data.
+ *
+ * A QSBR domain has a global epoch. Reader threads register with the
+ * domain and call xdp2_qsbr_quiescent between operations (for instance
+ * after each batch of packets) to announce that they've seen the current
+ * epoch and hold no references. A thread that blocks for a long time
+ * should go offline with xdp2_qsbr_offline so that it doesn't hold up
+ * grace periods, and come back with xdp2_qsbr_online.
+ *
+ * An updater defers freeing an object with xdp2_qsbr_call, which tags
+ * the callback with a new epoch. The callback is run by xdp2_qsbr_reclaim
+ * once every online reader has observed that epoch. xdp2_qsbr_synchronize
+ * waits for a full grace period, and xdp2_qsbr_barrier waits for a grace
+ * period and runs all pending callbacks. A reader thread must not call
+ * xdp2_qsbr_synchronize or xdp2_qsbr_barrier while it's online in the same
+ * domain since it would wait on itself.
+ *
+ * Pointers to shared objects are published with xdp2_rcu_assign_pointer
+ * and read with xdp2_rcu_dereference. The XDP2_LIST_*_RCU macros do the
+ * same for sys/queue LIST lists
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/queue.h>
+
+#include <linux/types.h>
+
+#include "xdp2/utility.h"
+
+/* Publish a pointer to an initialized object */
+#define xdp2_rcu_assign_pointer(P, V)					\
+	__atomic_store_n(&(P), (V), __ATOMIC_RELEASE)
+
+/* Read a pointer published by xdp2_rcu_assign_pointer */
+#define xdp2_rcu_dereference(P) __atomic_load_n(&(P), __ATOMIC_CONSUME)
+
+/* RCU variants of sys/queue LIST operations. Updaters must be serialized,
+ * readers iterate with XDP2_LIST_FOREACH_RCU. A removed element's next
+ * pointer is left intact so that a reader on the element can continue
+ */
+#define XDP2_LIST_INSERT_HEAD_RCU(HEAD, ELM, FIELD) do {		\
+	(ELM)->FIELD.le_next = LIST_FIRST(HEAD);			\
+	(ELM)->FIELD.le_prev = &LIST_FIRST(HEAD);			\
+	if (LIST_FIRST(HEAD))						\
+		LIST_FIRST(HEAD)->FIELD.le_prev =			\
+					&(ELM)->FIELD.le_next;		\
+	xdp2_rcu_assign_pointer(LIST_FIRST(HEAD), (ELM));		\
+} while (0)
+
+#define XDP2_LIST_INSERT_AFTER_RCU(LISTELM, ELM, FIELD) do {		\
+	(ELM)->FIELD.le_next = LIST_NEXT(LISTELM, FIELD);		\
+	(ELM)->FIELD.le_prev = &LIST_NEXT(LISTELM, FIELD);		\
+	if (LIST_NEXT(LISTELM, FIELD))					\
+		LIST_NEXT(LISTELM, FIELD)->FIELD.le_prev =		\
+					&(ELM)->FIELD.le_next;		\
+	xdp2_rcu_assign_pointer(LIST_NEXT(LISTELM, FIELD), (ELM));	\
+} while (0)
+
+#define XDP2_LIST_REMOVE_RCU(ELM, FIELD) do {				\
+	if (LIST_NEXT(ELM, FIELD))					\
+		LIST_NEXT(ELM, FIELD)->FIELD.le_prev =			\
+					(ELM)->FIELD.le_prev;		\
+	__atomic_store_n((ELM)->FIELD.le_prev, LIST_NEXT(ELM, FIELD),	\
+			 __ATOMIC_RELAXED);				\
+} while (0)
+
+#define XDP2_LIST_FOREACH_RCU(VAR, HEAD, FIELD)			\
+	for ((VAR) = xdp2_rcu_dereference(LIST_FIRST(HEAD));		\
+	     (VAR);							\
+	     (VAR) = xdp2_rcu_dereference(LIST_NEXT(VAR, FIELD)))
+
+/* Per reader thread state. epoch is the global epoch observed at the
+ * thread's last quiescent state, or zero if the thread is offline
+ */
+struct xdp2_qsbr_thread {
+	__u64 epoch;
+	struct xdp2_qsbr *qsbr;
+	LIST_ENTRY(xdp2_qsbr_thread) link;
+} __aligned(XDP2_CACHELINE_SIZE);
+
+/* Deferred callback */
+struct xdp2_qsbr_cb {
+	void (*func)(void *arg);
+	void *arg;
+	__u64 epoch;
+	struct xdp2_qsbr_cb *next;
+};
+
+/* Number of pending callbacks at which xdp2_qsbr_call tries to reclaim */
+#define XDP2_QSBR_RECLAIM_THRESH	64
+
+struct xdp2_qsbr {
+	__u64 epoch __aligned(XDP2_CACHELINE_SIZE);
+
+	/* Protects the threads list and the callbacks queue */
+	pthread_mutex_t lock __aligned(XDP2_CACHELINE_SIZE);
+	LIST_HEAD(, xdp2_qsbr_thread) threads;
+	struct xdp2_qsbr_cb *cbs_head;
+	struct xdp2_qsbr_cb **cbs_tail;
+	unsigned int num_cbs;
+};
+
+#define XDP2_QSBR_INITIALIZER(NAME) {					\
+	.epoch = 1,							\
+	.lock = PTHREAD_MUTEX_INITIALIZER,				\
+	.threads = LIST_HEAD_INITIALIZER((NAME).threads),		\
+	.cbs_tail = &(NAME).cbs_head,					\
+}
+
+#define XDP2_QSBR_DEFINE(NAME)						\
+	struct xdp2_qsbr NAME = XDP2_QSBR_INITIALIZER(NAME)
+
+void xdp2_qsbr_init(struct xdp2_qsbr *qsbr);
+
+/* Wait for a grace period and run all pending callbacks */
+void xdp2_qsbr_fini(struct xdp2_qsbr *qsbr);
+
+/* Register the calling reader thread. The thread starts online. Returns
+ * NULL on allocation failure
+ */
+struct xdp2_qsbr_thread *xdp2_qsbr_register(struct xdp2_qsbr *qsbr);
+
+void xdp2_qsbr_unregister(struct xdp2_qsbr_thread *thread);
+
+/* Wait until every online reader has passed through a quiescent state */
+void xdp2_qsbr_synchronize(struct xdp2_qsbr *qsbr);
+
+/* Run func(arg) after a grace period. Callbacks are run by
+ * xdp2_qsbr_reclaim, xdp2_qsbr_barrier, or a later xdp2_qsbr_call.
+ * Returns zero or -ENOMEM in which case the function synchronizes and
+ * runs func(arg) directly
+ */
+int xdp2_qsbr_call(struct xdp2_qsbr *qsbr, void (*func)(void *arg),
+		   void *arg);
+
+/* Run callbacks whose grace period has completed without waiting.
+ * Returns the number of callbacks run
+ */
+unsigned int xdp2_qsbr_reclaim(struct xdp2_qsbr *qsbr);
+
+/* Wait for a grace period and run all pending callbacks */
+void xdp2_qsbr_barrier(struct xdp2_qsbr *qsbr);
+
+/* Reader side operations */
+
+/* Announce a quiescent state: the thread holds no references to objects
+ * protected by the domain
+ */
+static inline void xdp2_qsbr_quiescent(struct xdp2_qsbr_thread *thread)
+{
+	__atomic_store_n(&thread->epoch,
+			 __atomic_load_n(&thread->qsbr->epoch,
+					 __ATOMIC_ACQUIRE),
+			 __ATOMIC_RELEASE);
+}
+
+/* Take the thread offline, it may block without holding up grace periods
+ * but must not access protected objects until it's back online
+ */
+static inline void xdp2_qsbr_offline(struct xdp2_qsbr_thread *thread)
+{
+	__atomic_store_n(&thread->epoch, 0, __ATOMIC_RELEASE);
+}
+
+static inline void xdp2_qsbr_online(struct xdp2_qsbr_thread *thread)
+{
+	xdp2_qsbr_quiescent(thread);
+
+	/* The epoch store must be visible before any protected reads */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif /* __XDP2_QSBR_H__ */
@@ -0,0 +1,201 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XDP2_RSS_H__
+#define __XDP2_RSS_H__
+
+/* Software receive side scaling (RSS)
+ *
+ * Spread parsed packets over worker cores the way a NIC does: the
+ * Toeplitz hash of the flow fields selects an entry in an indirection
+ * table and the entry is the number of the queue to steer the packet to.
+ * Each queue is an xdp2_fifo read by one worker, so all the packets of a
+ * flow go to the same worker.
+ *
+ * The Toeplitz hash is computed with precomputed lookup tables for the
+ * key. Two hash inputs are supported:
+ *
+ *	XDP2_RSS_COMPUTE_HASH hashes the same metadata region as
+ *		XDP2_COMMON_COMPUTE_HASH
+ *	XDP2_RSS_COMPUTE_NIC_HASH hashes the source and destination
+ *		addresses followed by the source and destination ports for
+ *		TCP and UDP, which is the input NICs use. With the same key
+ *		and indirection table a flow is steered to the same queue
+ *		number as with NIC RSS
+ *
+ * Like NICs, the indirection table is indexed by the low order bits of the
+ * hash. Its entries can be changed while packets are being steered, for
+ * instance to move load off a worker, and each entry is updated with a
+ * single store. Steering functions must be called from one producer
+ * thread per FIFO unless the FIFOs are in XDP2_FIFO_MODE_MPMC or
+ * XDP2_FIFO_MODE_LOCKED mode
+ */
+
+#include <linux/types.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+
+#include "xdp2/fifo.h"
+#include "xdp2/hash.h"
+#include "xdp2/parser_metadata.h"
+
+#define XDP2_RSS_DEFAULT_INDIR_SIZE	128
+#define XDP2_RSS_MAX_QUEUES		(1 << 16)
+
+/* Per queue steering counters. These are updated without atomics so they
+ * are approximate when more than one thread steers packets
+ */
+struct xdp2_rss_queue_stats {
+	__u64 steered;
+	__u64 drops;
+};
+
+struct xdp2_rss {
+	struct xdp2_hash_toeplitz_tbl tbl;
+	__u8 key[XDP2_HASH_TOEPLITZ_KEY_LEN];
+	unsigned int num_queues;
+	unsigned int indir_mask;
+	struct xdp2_fifo **fifos;
+	struct xdp2_rss_queue_stats *stats;
+	__u16 indir[];
+};
+
+/* Create an RSS steering stage for num_queues FIFOs. indir_size is the
+ * number of entries in the indirection table, a power of two (zero for
+ * XDP2_RSS_DEFAULT_INDIR_SIZE). key is the Toeplitz key, if it's NULL
+ * the default key from the Microsoft RSS specification is used. The
+ * indirection table is initialized to spread the hash values equally
+ * across the queues. Returns NULL on a bad argument or allocation failure
+ */
+struct xdp2_rss *xdp2_rss_create(struct xdp2_fifo **fifos,
+				 unsigned int num_queues,
+				 unsigned int indir_size, const __u8 *key);
+
+void xdp2_rss_free(struct xdp2_rss *rss);
+
+/* Set the Toeplitz key and rebuild the lookup tables. Must not be called
+ * while packets are being steered
+ */
+void xdp2_rss_set_key(struct xdp2_rss *rss, const __u8 *key);
+
+/* Set the indirection table. indir has one queue number per entry of the
+ * table. Returns zero on success or -EINVAL if a queue number is out of
+ * range (the table isn't changed)
+ */
+int xdp2_rss_set_indir(struct xdp2_rss *rss, const __u16 *indir);
+
+/* Set the indirection table to spread the hash values equally over the
+ * first num queues. Returns zero on success or -EINVAL if num is zero or
+ * greater than the number of queues
+ */
+int xdp2_rss_set_indir_equal(struct xdp2_rss *rss, unsigned int num);
+
+/* Steer a burst of count messages. The queue for messages[i] is selected
+ * by hashes[i], and the messages for each queue are enqueued in one burst
+ * in their original order. If wait is set then block while a FIFO is
+ * full. Messages that couldn't be enqueued are counted as drops and, if
+ * dropped isn't NULL, returned in dropped. Returns the number of messages
+ * enqueued
+ */
+unsigned int xdp2_rss_steer_burst(struct xdp2_rss *rss, const __u32 *hashes,
+				  const __u64 *messages, unsigned int count,
+				  bool wait, __u64 *dropped);
+
+/* Return the Toeplitz hash of len bytes of data */
+static inline __u32 xdp2_rss_hash(const struct xdp2_rss *rss,
+				  const void *data, size_t len)
+{
+	return xdp2_hash_toeplitz_tbl(&rss->tbl, data, len);
+}
+
+/* Return the queue number for a hash */
+static inline unsigned int xdp2_rss_hash_to_queue(const struct xdp2_rss *rss,
+						  __u32 hash)
+{
+	return __atomic_load_n(&rss->indir[hash & rss->indir_mask],
+			       __ATOMIC_RELAXED);
+}
+
+/* Steer one message to the queue selected by hash. Returns true if the
+ * message was enqueued
+ */
+static inline bool xdp2_rss_steer(struct xdp2_rss *rss, __u32 hash,
+				  __u64 message, bool wait)
+{
+	unsigned int queue = xdp2_rss_hash_to_queue(rss, hash);
+
+	if (!xdp2_fifo_enqueue(rss->fifos[queue], message, wait)) {
+		rss->stats[queue].drops++;
+		return false;
+	}
+
+	rss->stats[queue].steered++;
+
+	return true;
+}
+
+/* Compute the Toeplitz hash over the metadata hash region. Arguments are
+ * the same as for XDP2_COMMON_COMPUTE_HASH
+ */
+#define XDP2_RSS_COMPUTE_HASH(RSS, METADATA, HASH_START_FIELD) ({	\
+	const void *start = XDP2_HASH_START(METADATA,			\
+					    HASH_START_FIELD);		\
+	size_t olen = XDP2_HASH_LENGTH(METADATA,			\
+				offsetof(typeof(*METADATA),		\
+				HASH_START_FIELD));			\
+									\
+	xdp2_rss_hash(RSS, start, olen);				\
+})
+
+/* Compute the Toeplitz hash over the NIC RSS input from metadata with the
+ * common addrs, ports, and ip_proto fields. The addresses and ports are
+ * hashed in place, the hash of the concatenated input is the XOR of the
+ * hashes of the parts at their positions
+ */
+#define XDP2_RSS_COMPUTE_NIC_HASH(RSS, METADATA) ({			\
+	size_t alen = 0;						\
+	__u32 hash = 0;							\
+									\
+	switch ((METADATA)->addr_type) {				\
+	case XDP2_ADDR_TYPE_IPV4:					\
+		alen = sizeof((METADATA)->addrs.v4_addrs);		\
+		break;							\
+	case XDP2_ADDR_TYPE_IPV6:					\
+		alen = sizeof((METADATA)->addrs.v6_addrs);		\
+		break;							\
+	}								\
+	if (alen) {							\
+		hash = xdp2_rss_hash(RSS, &(METADATA)->addrs, alen);	\
+		if ((METADATA)->ip_proto == IPPROTO_TCP ||		\
+		    (METADATA)->ip_proto == IPPROTO_UDP)		\
+			hash ^= __xdp2_hash_toeplitz_tbl(&(RSS)->tbl,	\
+				&(METADATA)->ports,			\
+				sizeof((METADATA)->ports), alen);	\
+	}								\
+	hash;								\
+})
+
+#endif /* __XDP2_RSS_H__ */
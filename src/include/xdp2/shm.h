@@ -37,11 +37,34 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "xdp2/mem.h"
+
 int xdp2_shm_open_file(const char *name, size_t size, off_t offset,
 		       bool create, size_t *fsize);
 void *xdp2_shm_map(const char *file, size_t size, off_t offset, bool create,
 		   bool zero_it);
 
+/* Map a shared memory file with memory placement (see xdp2/mem.h). For
+ * hugepages the file must be on hugetlbfs, a new file is sized to a
+ * multiple of the hugepage size. NUMA binding applies to pages faulted in
+ * after mapping, that is to a new or zeroed region
+ */
+void *xdp2_shm_map_mem(const char *file, size_t size, off_t offset,
+		       bool create, bool zero_it,
+		       const struct xdp2_mem_config *config);
+
+/* Create an anonymous shared memory file, backed by hugepages if config
+ * requests them. The file descriptor can be mapped with xdp2_shm_map_fd
+ * and shared with other processes by fork or over a Unix socket. Returns
+ * the file descriptor or -1 on error
+ */
+int xdp2_shm_memfd_create(const char *name, size_t size,
+			  const struct xdp2_mem_config *config);
+
+/* Map a shared memory file descriptor with memory placement */
+void *xdp2_shm_map_fd(int fd, size_t size, off_t offset, bool zero_it,
+		      const struct xdp2_mem_config *config);
+
 void *xdp2_shm_map_make(const char *file, size_t size, off_t offset,
 			bool set_xlat, size_t shm_size, size_t conf_size,
 			char *shm_name, unsigned int shm_type,
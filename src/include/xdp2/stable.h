@@ -28,8 +28,10 @@
 
 /* (Better than) P4-like lookup tables in C */
 
+#include <stddef.h>
 #include <string.h>
 
+#include "xdp2/lpm_trie.h"
 #include "xdp2/pmacro.h"
 #include "xdp2/table_common.h"
 #include "xdp2/utility.h"
@@ -459,7 +461,9 @@ static __unused() inline bool XDP2_JOIN2(NAME, _compare_by_key)		\
 			COMMON_ARGS_SIG, COMMON_ARGS_LIST,		\
 			XDP2_JOIN2(NAME, _section_entries), true, tern)
 
-/* Make lookup functions for longest prefix match by key */
+/* Make lookup functions for longest prefix match by key. The lookup uses a
+ * trie that is built from the table's entries on the first lookup
+ */
 #define __XDP2_SFTABLE_MAKE_LOOKUP_LPM_FUNC_BY_KEY(NAME,		\
 		COMMON_ARGS_SIG, COMMON_ARGS_LIST, SECTION, KEY_TYPE)	\
 	static __unused() inline void XDP2_JOIN2(NAME, _lookup_by_key)(	\
@@ -471,17 +475,31 @@ static __unused() inline bool XDP2_JOIN2(NAME, _compare_by_key)		\
 					   SECTION)();			\
 		const struct XDP2_JOIN2(NAME, _entry_struct)		\
 						*lm_def = NULL;		\
+		static struct xdp2_lpm_trie *trie;			\
+		const struct xdp2_lpm_trie *ltrie;			\
 		int longest_match = 0, num_els, i;			\
 									\
 		num_els = XDP2_JOIN2(xdp2_section_array_size_,		\
 				     SECTION)();			\
-		for (i = 0; i < num_els; i++) {				\
-			if (longest_match >= def_base[i].prefix_len)	\
-				continue;				\
-			if (XDP2_JOIN2(NAME, _compare_by_key)(key,	\
-						 &def_base[i]))	{	\
-				longest_match = def_base[i].prefix_len;	\
-				lm_def = &def_base[i];			\
+		ltrie = xdp2_lpm_trie_get_static(&trie, def_base,	\
+			num_els, sizeof(*def_base),			\
+			sizeof(def_base->key),				\
+			offsetof(struct XDP2_JOIN2(NAME, _entry_struct),\
+				 prefix_len));				\
+		if (ltrie) {						\
+			lm_def = xdp2_lpm_trie_lookup(ltrie, key);	\
+		} else {						\
+			/* Couldn't build the trie, do a linear scan */	\
+			for (i = 0; i < num_els; i++) {			\
+				if (longest_match >=			\
+						def_base[i].prefix_len)	\
+					continue;			\
+				if (XDP2_JOIN2(NAME, _compare_by_key)(	\
+						key, &def_base[i])) {	\
+					longest_match =			\
+						def_base[i].prefix_len;	\
+					lm_def = &def_base[i];		\
+				}					\
 			}						\
 		}							\
 		if (lm_def)						\
@@ -598,7 +616,9 @@ static __unused() inline bool XDP2_JOIN2(NAME, _compare_by_key)		\
 					    TARG_TYPE,			\
 			XDP2_JOIN2(NAME, _section_entries), true, tern)
 
-/* Make lookup functions for longest prefix match by key */
+/* Make lookup functions for longest prefix match by key. The lookup uses a
+ * trie that is built from the table's entries on the first lookup
+ */
 #define __XDP2_STABLE_MAKE_LOOKUP_LPM_FUNC_BY_KEY(NAME,			\
 		TARG_TYPE, SECTION, KEY_TYPE)				\
 	static __unused() inline TARG_TYPE XDP2_JOIN2(			\
@@ -611,17 +631,31 @@ static __unused() inline bool XDP2_JOIN2(NAME, _compare_by_key)		\
 					   SECTION)();			\
 		const struct XDP2_JOIN2(NAME, _entry_struct)		\
 					*lm_def = NULL;			\
+		static struct xdp2_lpm_trie *trie;			\
+		const struct xdp2_lpm_trie *ltrie;			\
 		int longest_match = 0, num_els, i;			\
 									\
 		num_els = XDP2_JOIN2(xdp2_section_array_size_,		\
 				     SECTION)();			\
-		for (i = 0; i < num_els; i++) {				\
-			if (longest_match >= def_base[i].prefix_len)	\
-				continue;				\
-			if (XDP2_JOIN2(NAME, _compare_by_key)(key,	\
-						 &def_base[i]))	{	\
-				longest_match = def_base[i].prefix_len;	\
-				lm_def = &def_base[i];			\
+		ltrie = xdp2_lpm_trie_get_static(&trie, def_base,	\
+			num_els, sizeof(*def_base),			\
+			sizeof(def_base->key),				\
+			offsetof(struct XDP2_JOIN2(NAME, _entry_struct),\
+				 prefix_len));				\
+		if (ltrie) {						\
+			lm_def = xdp2_lpm_trie_lookup(ltrie, key);	\
+		} else {						\
+			/* Couldn't build the trie, do a linear scan */	\
+			for (i = 0; i < num_els; i++) {			\
+				if (longest_match >=			\
+						def_base[i].prefix_len)	\
+					continue;			\
+				if (XDP2_JOIN2(NAME, _compare_by_key)(	\
+						key, &def_base[i])) {	\
+					longest_match =			\
+						def_base[i].prefix_len;	\
+					lm_def = &def_base[i];		\
+				}					\
 			}						\
 		}							\
 		if (lm_def)						\
@@ -100,33 +100,144 @@
 
 #include <string.h>
 
+#if defined(__SSE2__) && !defined(__bpf__)
+#include <immintrin.h>
+#endif
+
 #include "xdp2/utility.h"
 
-/* Function to compare two fields */
+/* Function to compare two fields
+ *
+ * Keys are compared a word at a time instead of a byte at a time. The
+ * compare functions are inline and the key length is normally a compile
+ * time constant (sizeof the key structure), in which case the compiler
+ * specializes and unrolls the compare for the key length. 32 and 16 byte
+ * chunks use AVX2 or SSE2 when the compiler targets them (see
+ * C_MARCH_FLAGS in config.mk), the rest is compared in 64-bit words. A
+ * tail that's not a multiple of the word size is loaded overlapping the
+ * previous word so that no bytes past the end of the keys are read
+ */
+
+static inline __u64 __xdp2_compare_load64(const void *p)
+{
+	__u64 v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline __u32 __xdp2_compare_load32(const void *p)
+{
+	__u32 v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline __u16 __xdp2_compare_load16(const void *p)
+{
+	__u16 v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline __u8 __xdp2_compare_load8(const void *p)
+{
+	return *(const __u8 *)p;
+}
+
+/* Return non-zero if two fields differ in any bit that is set in mask. If
+ * mask is NULL all the bits are compared
+ */
+static inline __u64 __xdp2_compare_diff(const void *_f1, const void *_f2,
+					const void *_mask, size_t len)
+{
+	const __u8 *f1 = (const __u8 *)_f1, *f2 = (const __u8 *)_f2;
+	const __u8 *mask = (const __u8 *)_mask;
+	__u64 diff = 0;
+	size_t i = 0;
+
+#define __XDP2_COMPARE_WORD(BITS, OFF) do {				\
+	__u##BITS __d = __xdp2_compare_load##BITS(&f1[OFF]) ^		\
+			__xdp2_compare_load##BITS(&f2[OFF]);		\
+									\
+	if (mask)							\
+		__d &= __xdp2_compare_load##BITS(&mask[OFF]);		\
+	diff |= __d;							\
+} while (0)
+
+#if defined(__AVX2__) && !defined(__bpf__)
+	if (len >= 32) {
+		__m256i acc = _mm256_setzero_si256();
+
+		for (; i + 32 <= len; i += 32) {
+			__m256i d = _mm256_xor_si256(
+				_mm256_loadu_si256((const __m256i *)&f1[i]),
+				_mm256_loadu_si256((const __m256i *)&f2[i]));
+
+			if (mask)
+				d = _mm256_and_si256(d, _mm256_loadu_si256(
+					(const __m256i *)&mask[i]));
+			acc = _mm256_or_si256(acc, d);
+		}
+		diff = !_mm256_testz_si256(acc, acc);
+	}
+#endif
+#if defined(__SSE2__) && !defined(__bpf__)
+	if (len - i >= 16) {
+		__m128i acc = _mm_setzero_si128();
+
+		for (; i + 16 <= len; i += 16) {
+			__m128i d = _mm_xor_si128(
+				_mm_loadu_si128((const __m128i *)&f1[i]),
+				_mm_loadu_si128((const __m128i *)&f2[i]));
+
+			if (mask)
+				d = _mm_and_si128(d, _mm_loadu_si128(
+					(const __m128i *)&mask[i]));
+			acc = _mm_or_si128(acc, d);
+		}
+		diff |= _mm_movemask_epi8(_mm_cmpeq_epi8(acc,
+				_mm_setzero_si128())) != 0xffff;
+	}
+#endif
+
+	if (len >= 8) {
+		for (; i + 8 <= len; i += 8)
+			__XDP2_COMPARE_WORD(64, i);
+		if (i < len)
+			__XDP2_COMPARE_WORD(64, len - 8);
+	} else if (len >= 4) {
+		__XDP2_COMPARE_WORD(32, 0);
+		__XDP2_COMPARE_WORD(32, len - 4);
+	} else if (len >= 2) {
+		__XDP2_COMPARE_WORD(16, 0);
+		__XDP2_COMPARE_WORD(16, len - 2);
+	} else if (len) {
+		__XDP2_COMPARE_WORD(8, 0);
+	}
+
+#undef __XDP2_COMPARE_WORD
+
+	return diff;
+}
 
 /* Compare two fields for equality */
 static inline bool xdp2_compare_equal(const void *f1, const void *f2,
 				      size_t len)
 {
-	return !memcmp(f1, f2, len);
+	return !__xdp2_compare_diff(f1, f2, NULL, len);
 }
 
 /* Compare tenary fields by apply the key mask */
 static inline bool xdp2_compare_tern(const void *_f1,
 		const void *_f2, const void *_mask, size_t len)
 {
-	__u8 mask, c1, c2;
-	int i;
-
-	for (i = 0; i < len; i++) {
-		c1 = ((__u8 *)_f1)[i];
-		c2 = ((__u8 *)_f2)[i];
-		mask = ((__u8 *)_mask)[i];
-		if ((c1 ^ c2) & mask)
-			return false;
-	}
-
-	return true;
+	return !__xdp2_compare_diff(_f1, _f2, _mask, len);
 }
 
 /* Compare fields by longest prefix match */
@@ -137,7 +248,7 @@ static inline bool xdp2_compare_prefix(const void *_f1,
 	int mod = prefix_len % 8;
 	__u8 mask, c1, c2;
 
-	if (memcmp(_f1, _f2, div) != 0)
+	if (!xdp2_compare_equal(_f1, _f2, div))
 		return false;
 
 	if (!mod)
@@ -29,9 +29,17 @@
 
 /* XDP2 timers
  *
- * This is a fairly simple timer wheel implementation. An instance of a
- * timer is defined by the timer_wheel structure. Like most timer wheel
- * implementations this contains an array of linked list timer structures
+ * This is a hierarchical timer wheel implementation. An instance of a
+ * timer is defined by the timer_wheel structure. The wheel has a number of
+ * levels, each level is an array of 2^num_slots_order slots where each slot
+ * is a linked list of timer structures. Level zero has a granularity of one
+ * time unit, and each successive level has a granularity 2^num_slots_order
+ * times that of the level below. A timer is placed in the lowest level that
+ * covers its expiration time relative to the wheel's clock. When the clock
+ * of a level wraps around, the next slot of the level above is cascaded
+ * (the timers are redistributed to the lower levels). Add and remove are
+ * O(1) and a timer is touched at most once per level before it expires,
+ * long timeouts are not rescanned every revolution of the wheel
  *
  * A timer wheel has no defined granularity. Granaularity is a property
  * applied by the user of the timer wheel. For instance, an application
@@ -50,7 +58,12 @@
  * For instance, the pop timer could be a running interval timer or could
  * be a programmed hardware time. The timer_wheel implementation invokes the
  * set_next_timer_pop callback to indicate the next time that the timer wheel
- * should be run (that is the time of the next timer that will expire)
+ * should be run (that is the time of the next timer that will expire or the
+ * next time that a level needs to be cascaded)
+ *
+ * Expired timers are removed from the wheel in batches of up to
+ * XDP2_TIMER_EXPIRE_BATCH timers, and the callbacks for a batch are invoked
+ * with the timer wheel lock released
  *
  * A timer is specified by the xdp2_timer structure. In the API, the
  * timer structure is provided by the caller. A timer structure should be
@@ -59,8 +72,10 @@
  *
  * The API functions are:
  *	- xdp2_timer_create_wheel: Mallocs and initializes a timer wheel.
- *	  Arguments include number of slots, the get_current_time and
+ *	  Arguments include number of slots order, the get_current_time and
  *	  set_next_timer_pop functions
+ *	- xdp2_timer_create_local_wheel: Mallocs and initializes a per-thread
+ *	  timer wheel (see below)
  *	- xdp2_timer_add: Add a timer with some delay time to fire ((relative
  *	  to the current time, not absolute time). Arguments are the
  *	  timer wheel, the timer structure, and the expiration time. If the
@@ -91,10 +106,23 @@
  *    timer fires xdp2_timer_rmove should be call from the callback on
  *    the timer (just in case the callabck was for an old timeout), and
  *    then the structure is free-able per #1
+ *
+ * Per-thread timer wheels
+ *
+ * A local timer wheel is owned by the thread that creates it. The owner
+ * thread adds timers and runs the wheel (typically by polling
+ * xdp2_run_timer_wheel from its main loop) without taking any locks. Other
+ * threads may only remove timers from a local wheel. A remote remove is
+ * queued on a lock-free list and is processed by the owner thread the next
+ * time it adds a timer or runs the wheel; a remote remove always returns
+ * true so rule #3 above applies. A remote remove that races with the owner
+ * re-adding the same timer may cancel the new timeout
  */
 
 #include <linux/types.h>
+#include <pthread.h>
 #include <sys/queue.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 
 #include "xdp2/locks.h"
@@ -113,17 +141,24 @@ struct xdp2_timer {
 	/* Timer is set and is in timer wheel */
 	bool timer_set;
 
-	/* Generation and index
-	 *
-	 * Expiration time is (gen * wheel->num_slots) + index
-	 */
-	unsigned long gen;
+	/* Expiration time, and level and slot index in the timer wheel */
+	unsigned long expire_time;
+	unsigned int level;
 	unsigned int index;
 
 	/* List glue */
 	CIRCLEQ_ENTRY(xdp2_timer) list_ent;
+
+	/* Queue of remote removes for a local timer wheel */
+	struct xdp2_timer *cancel_next;
+	atomic_bool cancel_queued;
 };
 
+/* Maximum number of expired timers whose callbacks are invoked in one batch
+ * with the timer wheel lock released
+ */
+#define XDP2_TIMER_EXPIRE_BATCH 32
+
 struct xdp2_timer_wheel_stats {
 	unsigned long add_timers;
 	unsigned long add_already_running;
@@ -132,15 +167,14 @@ struct xdp2_timer_wheel_stats {
 	unsigned long timer_expires;
 
 	unsigned long run_timer_wheel;
-	unsigned long slot_retries;
+	unsigned long expire_batches;
+	unsigned long cascades;
+	unsigned long cascade_timers;
+	unsigned long remote_removes;
 	unsigned long timer_thread_signaled;
 	unsigned long run_timer_wheel_retries;
 	unsigned long spurious_run_timer_wheel;
 	unsigned long remove_wheel_running;
-
-	unsigned long timer_wheel_same_gen;
-	unsigned long timer_wheel_next_gen;
-	unsigned long timer_wheel_skip_gens;
 };
 
 #define __XDP2_TIMER_BUMP_STAT(WHEEL, NAME) do {			\
@@ -171,13 +205,21 @@ struct xdp2_timer_wheel {
 	 */
 	void (*set_next_timer_pop)(void *cbarg, unsigned long expire_time);
 
-	/* Number of slots */
+	/* Number of slots per level and levels */
 	int num_slots;
+	unsigned int num_slots_order;
+	unsigned int num_levels;
 
 	const char *where;
 
-	/* Bitmap of active slots */
+	/* Bitmaps of active slots, one for each level */
 	unsigned long *slot_bitmap;
+	unsigned int bitmap_words;
+
+	/* Next time to be processed by the timer wheel. All ticks before
+	 * this have been processed
+	 */
+	unsigned long clock;
 
 	/* Next expiration time */
 	unsigned long next_expire_time;
@@ -197,6 +239,13 @@ struct xdp2_timer_wheel {
 	/* Timer wheel is running and got another request to run again */
 	bool run_again;
 
+	/* Local wheel is owned by one thread and isn't locked */
+	bool local;
+	pthread_t owner;
+
+	/* Timers removed by threads other than the owner of a local wheel */
+	struct xdp2_timer *_Atomic cancel_list;
+
 	/* Timer wheel statistics */
 	struct xdp2_timer_wheel_stats stats;
 
@@ -206,7 +255,9 @@ struct xdp2_timer_wheel {
 	unsigned int time_div;
 	unsigned long next_pop_time;
 
-	/* Timer wheel slots */
+	/* Timer wheel slots. Slots for level N start at
+	 * N * num_slots
+	 */
 	struct __xdp2_timer_wheel_list_head slots[];
 };
 
@@ -218,6 +269,17 @@ struct xdp2_timer_wheel *xdp2_timer_create_wheel(
 					   unsigned long expire_time),
 		unsigned int time_units);
 
+/* Create a local timer wheel owned by the calling thread. The owner thread
+ * runs the wheel itself, set_next_timer_pop is optional and is called with
+ * the next time the wheel needs to be run
+ */
+struct xdp2_timer_wheel *xdp2_timer_create_local_wheel(
+		unsigned int num_slots_order, void *cbarg,
+		unsigned long (*get_current_time)(void *cbarg),
+		void (*set_next_timer_pop)(void *cbarg,
+					   unsigned long expire_time),
+		unsigned int time_units);
+
 /* Create timer wheel with a timer thread to drive the clock */
 struct xdp2_timer_wheel *xdp2_timer_create_wheel_with_timer_thread(
 		unsigned int num_slots_order,
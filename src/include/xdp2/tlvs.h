@@ -117,6 +117,7 @@ struct xdp2_proto_tlvs_table_entry {
 struct xdp2_proto_tlvs_table {
 	int num_ents;
 	const struct xdp2_proto_tlvs_table_entry *entries;
+	struct xdp2_proto_dispatch *dispatch;
 };
 
 /* Parse node for parsing a protocol header that contains TLVs to be
@@ -221,10 +222,12 @@ const struct xdp2_parse_tlv_node *xdp2_parse_lookup_tlv(
 #define XDP2_MAKE_TLV_TABLE(NAME, ...)					\
 	static const struct xdp2_proto_tlvs_table_entry __##NAME[] =	\
 		 { __XDP2_MAKE_TLV_TABLE_ENTRIES(__VA_ARGS__) };	\
+	XDP2_MAKE_PROTO_DISPATCH(__##NAME##_dispatch);			\
 	static const struct xdp2_proto_tlvs_table NAME = {		\
 		.num_ents = sizeof(__##NAME) /				\
 			sizeof(struct xdp2_proto_tlvs_table_entry),	\
 		.entries = __##NAME,					\
+		XDP2_PROTO_DISPATCH_REF(__##NAME##_dispatch)		\
 	}
 
 /* Forward declarations for TLV parser nodes */
@@ -30,21 +30,87 @@
 
 #include <linux/types.h>
 #include <netinet/in.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
-/* Communication handler for UDP */
+#include "xdp2/pvbuf.h"
+
+#ifndef SOL_UDP
+#define SOL_UDP		17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT	103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO		104
+#endif
+
+/* Maximum number of messages in one batched send or receive call, and
+ * maximum number of datagrams the kernel builds from one GSO send
+ */
+#define XDP2_COMM_BATCH_MAX	64
+
+/* Maximum number of iovecs in an iovec or pvbuf send */
+#define XDP2_COMM_MAX_IOVS	64
+
+/* Message for batched send and receive
+ *
+ * For send, buff and len are the data and addr and port (network byte
+ * order) are the destination. If seg_size is non-zero the data is sent as
+ * consecutive datagrams of seg_size bytes, the last one may be shorter,
+ * using UDP GSO if the socket supports it (the data must fit in one UDP
+ * datagram and be at most XDP2_COMM_BATCH_MAX segments)
+ *
+ * For receive, buff and len are the buffer and its size. On return len
+ * is the number of bytes received, and addr and port are the source. If
+ * UDP GRO is enabled the kernel may coalesce datagrams from the same flow
+ * in which case seg_size is set and buff holds consecutive datagrams of
+ * seg_size bytes (the last one may be shorter), else seg_size is zero
+ */
+struct xdp2_comm_msg {
+	void *buff;
+	size_t len;
+	struct in_addr addr;
+	unsigned short port;
+	unsigned short seg_size;
+};
+
+/* Communication handle flags */
+#define XDP2_COMM_F_GSO		(1 << 0)	/* UDP_SEGMENT supported */
+#define XDP2_COMM_F_GRO		(1 << 1)	/* UDP_GRO enabled */
+
+/* Communication handler for UDP
+ *
+ * send_data_batch and recv_data_batch send or receive up to num messages
+ * (at most XDP2_COMM_BATCH_MAX are processed per call) and return the
+ * number of messages sent or received, or -1 with errno set if none were.
+ * recv_data_batch returns zero if wait is false and no data is pending.
+ * send_data_iov sends one datagram gathered from an iovec array
+ */
 struct xdp2_comm_handle {
 	int info;
+	unsigned int flags;
 	ssize_t (*send_data)(struct xdp2_comm_handle *comm,
 			     void *buff, size_t count, struct in_addr to,
 			     unsigned short to_port);
 	ssize_t (*recv_data)(struct xdp2_comm_handle *comm, void *buff,
 			     size_t count, struct in_addr *from,
 			     unsigned short *from_port);
+	int (*send_data_batch)(struct xdp2_comm_handle *comm,
+			       struct xdp2_comm_msg *msgs, unsigned int num);
+	int (*recv_data_batch)(struct xdp2_comm_handle *comm,
+			       struct xdp2_comm_msg *msgs, unsigned int num,
+			       bool wait);
+	ssize_t (*send_data_iov)(struct xdp2_comm_handle *comm,
+				 const struct iovec *iov, unsigned int iovcnt,
+				 struct in_addr to, unsigned short to_port);
 };
 
 /* Send UDP data on a socket */
@@ -132,6 +198,46 @@ static inline ssize_t xdp2_udp_socket_recv_data(
 	return xdp2_udp_socket_recv(comm->info, buff, len, from, from_port);
 }
 
+/* Batched and scatter-gather operations for UDP sockets */
+
+int xdp2_udp_socket_send_batch(struct xdp2_comm_handle *comm,
+			       struct xdp2_comm_msg *msgs, unsigned int num);
+
+int xdp2_udp_socket_recv_batch(struct xdp2_comm_handle *comm,
+			       struct xdp2_comm_msg *msgs, unsigned int num,
+			       bool wait);
+
+ssize_t xdp2_udp_socket_send_iov(struct xdp2_comm_handle *comm,
+				 const struct iovec *iov, unsigned int iovcnt,
+				 struct in_addr to, unsigned short to_port);
+
+/* Send the data of a pvbuf as one datagram without linearizing it. Each
+ * pbuf in the pvbuf is an iovec element in the send (the pvbuf must have
+ * at most XDP2_COMM_MAX_IOVS pbufs). The pvbuf is not freed
+ */
+ssize_t __xdp2_udp_socket_send_pvbuf(struct xdp2_pvbuf_mgr *pvmgr,
+				     struct xdp2_comm_handle *comm,
+				     xdp2_paddr_t paddr, struct in_addr to,
+				     unsigned short to_port);
+
+static inline ssize_t xdp2_udp_socket_send_pvbuf(
+		struct xdp2_comm_handle *comm, xdp2_paddr_t paddr,
+		struct in_addr to, unsigned short to_port)
+{
+	return __xdp2_udp_socket_send_pvbuf(&xdp2_pvbuf_global_mgr, comm,
+					    paddr, to, to_port);
+}
+
+/* Set XDP2_COMM_F_GSO in the handle if the socket supports UDP_SEGMENT */
+void xdp2_udp_socket_probe_gso(struct xdp2_comm_handle *comm);
+
+/* Enable or disable UDP GRO on the socket. With GRO enabled a receive may
+ * return several coalesced datagrams, this is only reported by
+ * recv_data_batch so GRO should not be enabled if recv_data is used.
+ * Returns zero on success, else -1 with errno set
+ */
+int xdp2_udp_socket_set_gro(struct xdp2_comm_handle *comm, bool enable);
+
 /* Create a UDP server socket communications handler */
 static inline struct xdp2_comm_handle *xdp2_udp_socket_start(int port)
 {
@@ -142,7 +248,7 @@ static inline struct xdp2_comm_handle *xdp2_udp_socket_start(int port)
 	if (sockfd < 0)
 		return NULL;
 
-	handle = malloc(sizeof(*handle));
+	handle = calloc(1, sizeof(*handle));
 	if (!handle) {
 		close(sockfd);
 		return NULL;
@@ -151,6 +257,11 @@ static inline struct xdp2_comm_handle *xdp2_udp_socket_start(int port)
 	handle->info = sockfd;
 	handle->send_data = xdp2_udp_socket_send_data;
 	handle->recv_data = xdp2_udp_socket_recv_data;
+	handle->send_data_batch = xdp2_udp_socket_send_batch;
+	handle->recv_data_batch = xdp2_udp_socket_recv_batch;
+	handle->send_data_iov = xdp2_udp_socket_send_iov;
+
+	xdp2_udp_socket_probe_gso(handle);
 
 	return handle;
 }
@@ -559,6 +559,22 @@ static inline unsigned long xdp2_round_up_div(unsigned long x, unsigned int r)
 	return (x + (r - 1)) / r;
 }
 
+/* Mix a 64-bit key into a 32-bit hash value. This is the MurmurHash3
+ * 64-bit finalizer, it's cheap and distributes small fixed size keys
+ * (e.g. an address and an identifier packed into a __u64) well enough
+ * to index power of two sized hash tables
+ */
+static inline __u32 xdp2_hash_mix64(__u64 v)
+{
+	v ^= v >> 33;
+	v *= 0xff51afd7ed558ccdULL;
+	v ^= v >> 33;
+	v *= 0xc4ceb9fe1a85ec53ULL;
+	v ^= v >> 33;
+
+	return (__u32)v;
+}
+
 #define	__XDP2_LOG_1(n) (((n) >= 2ULL) ? 1 : 0)
 #define	__XDP2_LOG_2(n) (((n) >= 1ULL << 2) ?				\
 		(2 + __XDP2_LOG_1((n) >> 2)) :	__XDP2_LOG_1(n))
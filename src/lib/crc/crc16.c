@@ -79,13 +79,148 @@ static const __u16 crc16tab[256] = {
 	0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
 };
 
-__u16 crc16(const char *buf, int len)
+__u16 crc16_sw(__u16 crc, const void *buf, size_t len)
 {
-	__u16 crc = 0;
-	int counter;
+	const __u8 *next = buf;
 
-	for (counter = 0; counter < len; counter++)
-		crc = (crc<<8) ^ crc16tab[((crc>>8) ^ *buf++) & 0x00FF];
+	while (len--)
+		crc = (crc<<8) ^ crc16tab[((crc>>8) ^ *next++) & 0x00FF];
 
 	return crc;
 }
+
+static __u16 (*crc16_func)(__u16 crc, const void *buf, size_t len) = crc16_sw;
+const char *crc16_impl = "sw";
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+/* Carry-less multiply folding. CRC16 is not reflected so each 16 byte block
+ * is byte swapped to put the first byte in the high order bits, after which
+ * advancing the high qword by n bits uses x^(n+64) mod P and the low qword
+ * x^n mod P. The 128-bit remainder is congruent to the data, so its CRC
+ * (computed with the table) is the CRC of the data.
+ */
+#define CRC16_POLY 0x11021
+
+static __u64 crc16_fold_128[2];
+static __u64 crc16_fold_512[2];
+
+/* Return x^n mod P */
+static __u64 crc16_xpow(unsigned int n)
+{
+	__u32 r = 1;
+
+	while (n--) {
+		r <<= 1;
+		if (r & 0x10000)
+			r ^= CRC16_POLY;
+	}
+
+	return r;
+}
+
+static void crc16_init_pclmul(void)
+{
+	crc16_fold_128[0] = crc16_xpow(128);
+	crc16_fold_128[1] = crc16_xpow(128 + 64);
+	crc16_fold_512[0] = crc16_xpow(512);
+	crc16_fold_512[1] = crc16_xpow(512 + 64);
+}
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crc16_load(const __u8 *p)
+{
+	const __m128i swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+					  8, 9, 10, 11, 12, 13, 14, 15);
+
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), swap);
+}
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crc16_fold(__m128i x, __m128i k, __m128i data)
+{
+	return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+					   _mm_clmulepi64_si128(x, k, 0x11)),
+			     data);
+}
+
+__attribute__((target("pclmul,ssse3")))
+static __u16 crc16_pclmul(__u16 crc, const void *buf, size_t len)
+{
+	const __m128i swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+					  8, 9, 10, 11, 12, 13, 14, 15);
+	const __u8 *next = buf;
+	__m128i x0, x1, x2, x3, k;
+	__u8 rem[16];
+
+	if (len < 128)
+		return crc16_sw(crc, buf, len);
+
+	x0 = crc16_load(next);
+	x1 = crc16_load(next + 16);
+	x2 = crc16_load(next + 32);
+	x3 = crc16_load(next + 48);
+
+	/* The running CRC is folded into the first two bytes */
+	x0 = _mm_xor_si128(x0, _mm_set_epi64x((__u64)crc << 48, 0));
+	next += 64;
+	len -= 64;
+
+	k = _mm_loadu_si128((const __m128i *)crc16_fold_512);
+	while (len >= 64) {
+		x0 = crc16_fold(x0, k, crc16_load(next));
+		x1 = crc16_fold(x1, k, crc16_load(next + 16));
+		x2 = crc16_fold(x2, k, crc16_load(next + 32));
+		x3 = crc16_fold(x3, k, crc16_load(next + 48));
+		next += 64;
+		len -= 64;
+	}
+
+	k = _mm_loadu_si128((const __m128i *)crc16_fold_128);
+	x0 = crc16_fold(x0, k, x1);
+	x0 = crc16_fold(x0, k, x2);
+	x0 = crc16_fold(x0, k, x3);
+	while (len >= 16) {
+		x0 = crc16_fold(x0, k, crc16_load(next));
+		next += 16;
+		len -= 16;
+	}
+
+	_mm_storeu_si128((__m128i *)rem, _mm_shuffle_epi8(x0, swap));
+	crc = crc16_sw(0, rem, sizeof(rem));
+
+	return crc16_sw(crc, next, len);
+}
+
+#endif /* __x86_64__ */
+
+/* Select the carry-less multiply version when the CPU supports PCLMULQDQ */
+void crc16_init(void)
+{
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("pclmul") &&
+	    __builtin_cpu_supports("ssse3")) {
+		crc16_init_pclmul();
+		crc16_func = crc16_pclmul;
+		crc16_impl = "pclmul";
+		return;
+	}
+#endif
+	crc16_func = crc16_sw;
+	crc16_impl = "sw";
+}
+
+__u16 crc16_update(__u16 crc, const void *buf, size_t len)
+{
+	return crc16_func(crc, buf, len);
+}
+
+__u16 crc16(const char *buf, int len)
+{
+	if (len <= 0)
+		return 0;
+
+	return crc16_func(0, buf, len);
+}
@@ -43,7 +43,12 @@
 #include <pthread.h>
 #include "crc/crc32c.h"
 
-crc_func crc32c;
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+crc_func crc32c = crc32c_sw;
+const char *crc32c_impl = "sw";
 
 /* CRC-32C (iSCSI) polynomial in reversed bit order. */
 #define POLY 0x82f63b78
@@ -51,9 +56,176 @@ crc_func crc32c;
 static __u32 crc32c_sw_little(__u32 crc, void const *buf, size_t len);
 static __u32 crc32c_sw_big(__u32 crc, void const *buf, size_t len);
 
+#if defined(__x86_64__)
+
+/* Block sizes for three-way parallel crc computation.  LONG and SHORT must
+ * both be powers of two.  The crc32 instruction has a latency of three
+ * cycles and a throughput of one per cycle, so three independent streams
+ * keep the unit busy; the streams are then combined by shifting the earlier
+ * crcs over the zeros of the later blocks.
+ */
+#define LONG 8192
+#define SHORT 256
+
+/* Multiply a and b modulo the CRC-32C polynomial, both in reversed bit
+ * order.
+ */
+static __u32 crc32c_multmodp(__u32 a, __u32 b)
+{
+	__u32 m = (__u32)1 << 31, p = 0;
+
+	if (!a)
+		return 0;
+
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ POLY : b >> 1;
+	}
+	return p;
+}
+
+/* Construct a table that applies len zero bytes to a crc, indexed by each
+ * byte of the crc.
+ */
+static void crc32c_zeros(__u32 zeros[][256], size_t len)
+{
+	__u32 op = (__u32)1 << 31;	/* x^0 */
+	unsigned int n, k;
+	size_t i;
+
+	for (i = 0; i < len * 8; i++)
+		op = op & 1 ? (op >> 1) ^ POLY : op >> 1;
+
+	for (n = 0; n < 256; n++)
+		for (k = 0; k < 4; k++)
+			zeros[k][n] = crc32c_multmodp(n << (8 * k), op);
+}
+
+/* Apply the zeros operator table to crc. */
+static inline __u32 crc32c_shift(__u32 zeros[][256], __u32 crc)
+{
+	return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^
+	       zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+static __u32 crc32c_long[4][256];
+static __u32 crc32c_short[4][256];
+
+static void crc32c_init_hw(void)
+{
+	crc32c_zeros(crc32c_long, LONG);
+	crc32c_zeros(crc32c_short, SHORT);
+}
+
+/* Compute a CRC-32C using the Intel crc32 instruction.  Buffers of at least
+ * three SHORT blocks are processed as three interleaved streams.
+ */
+__attribute__((target("sse4.2")))
+static __u32 crc32c_hw(__u32 crc, void const *buf, size_t len)
+{
+	unsigned char const *next = buf;
+	unsigned char const *end;
+	__u64 crc0, crc1, crc2;
+
+	crc0 = (__u32)~crc;
+
+	/* Compute the crc to bring the data pointer to an eight-byte
+	 * boundary
+	 */
+	while (len && ((uintptr_t)next & 7) != 0) {
+		crc0 = _mm_crc32_u8(crc0, *next);
+		next++;
+		len--;
+	}
+
+	/* Compute the crc on sets of LONG*3 bytes, executing three
+	 * independent crc instructions, each on LONG bytes
+	 */
+	while (len >= LONG * 3) {
+		crc1 = 0;
+		crc2 = 0;
+		end = next + LONG;
+		do {
+			crc0 = _mm_crc32_u64(crc0,
+					     *(__u64 const *)next);
+			crc1 = _mm_crc32_u64(crc1,
+					     *(__u64 const *)(next + LONG));
+			crc2 = _mm_crc32_u64(crc2,
+					     *(__u64 const *)(next + 2 * LONG));
+			next += 8;
+		} while (next < end);
+		crc0 = crc32c_shift(crc32c_long, crc0) ^ crc1;
+		crc0 = crc32c_shift(crc32c_long, crc0) ^ crc2;
+		next += LONG * 2;
+		len -= LONG * 3;
+	}
+
+	/* Do the same thing, but now on SHORT*3 blocks for the remaining
+	 * data less than a LONG*3 block
+	 */
+	while (len >= SHORT * 3) {
+		crc1 = 0;
+		crc2 = 0;
+		end = next + SHORT;
+		do {
+			crc0 = _mm_crc32_u64(crc0,
+					     *(__u64 const *)next);
+			crc1 = _mm_crc32_u64(crc1,
+					     *(__u64 const *)(next + SHORT));
+			crc2 = _mm_crc32_u64(crc2,
+					     *(__u64 const *)(next + 2 * SHORT));
+			next += 8;
+		} while (next < end);
+		crc0 = crc32c_shift(crc32c_short, crc0) ^ crc1;
+		crc0 = crc32c_shift(crc32c_short, crc0) ^ crc2;
+		next += SHORT * 2;
+		len -= SHORT * 3;
+	}
+
+	/* Compute the crc on the remaining eight-byte units less than a
+	 * SHORT*3 block
+	 */
+	while (len >= 8) {
+		crc0 = _mm_crc32_u64(crc0, *(__u64 const *)next);
+		next += 8;
+		len -= 8;
+	}
+
+	/* Compute the crc for up to seven leftover bytes */
+	while (len) {
+		crc0 = _mm_crc32_u8(crc0, *next);
+		next++;
+		len--;
+	}
+
+	return ~(__u32)crc0;
+}
+
+#endif /* __x86_64__ */
+
+/* Select the hardware crc32 instruction when the CPU supports SSE 4.2,
+ * otherwise fall back to the table-driven software version
+ */
 void crc32c_init(void)
 {
-    crc32c = crc32c_sw;
+#if defined(__x86_64__)
+	static pthread_once_t crc32c_once_hw = PTHREAD_ONCE_INIT;
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2")) {
+		pthread_once(&crc32c_once_hw, crc32c_init_hw);
+		crc32c = crc32c_hw;
+		crc32c_impl = "sse4.2";
+		return;
+	}
+#endif
+	crc32c = crc32c_sw;
+	crc32c_impl = "sw";
 }
 
 /* Construct table for software CRC-32C little-endian calculation. */
@@ -116,16 +116,139 @@ static __u64 _crc64(uint_fast64_t crc, const void *in_data, size_t len)
 
 /******************** END GENERATED PYCRC FUNCTIONS ********************/
 
-/* Initializes the 16KB lookup tables. */
+/* Compute crc64 with the slice-by-8 tables */
+__u64 crc64_sw(__u64 crc, const void *s, size_t l)
+{
+	return crcspeed64native(crc64_table, crc, (void *)s, l);
+}
+
+static __u64 (*crc64_func)(__u64 crc, const void *s, size_t l) = crc64_sw;
+const char *crc64_impl = "sw";
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+/* Carry-less multiply folding (see Intel's "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction"). The bulk of the buffer
+ * is folded sixteen bytes at a time into a 128-bit remainder that is
+ * congruent to the data modulo the polynomial, so the CRC of the remainder
+ * is the CRC of the data. The remainder and any tail are then run through
+ * the tables.
+ *
+ * In the reflected domain the first eight bytes of a 128-bit register are
+ * the high order coefficients, and the carry-less product of two reflected
+ * values carries an extra factor of x. Advancing the low qword by n bits
+ * therefore uses x^(n+63) mod P and the high qword x^(n-1) mod P.
+ */
+static __u64 crc64_fold_128[2];
+static __u64 crc64_fold_512[2];
+
+/* Return x^n mod P in reflected bit order */
+static __u64 crc64_xpow(unsigned int n, __u64 poly)
+{
+	__u64 r = (__u64)1 << 63;
+
+	while (n--)
+		r = r & 1 ? (r >> 1) ^ poly : r >> 1;
+
+	return r;
+}
+
+static void crc64_init_pclmul(void)
+{
+	__u64 poly = crc_reflect(POLY, 64);
+
+	crc64_fold_128[0] = crc64_xpow(128 + 63, poly);
+	crc64_fold_128[1] = crc64_xpow(128 - 1, poly);
+	crc64_fold_512[0] = crc64_xpow(512 + 63, poly);
+	crc64_fold_512[1] = crc64_xpow(512 - 1, poly);
+}
+
+__attribute__((target("pclmul,sse2")))
+static inline __m128i crc64_fold(__m128i x, __m128i k, __m128i data)
+{
+	return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+					   _mm_clmulepi64_si128(x, k, 0x11)),
+			     data);
+}
+
+__attribute__((target("pclmul,sse2")))
+static __u64 crc64_pclmul(__u64 crc, const void *s, size_t l)
+{
+	const __u8 *next = s;
+	__m128i x0, x1, x2, x3, k;
+	__u8 rem[16];
+
+	if (l < 128)
+		return crc64_sw(crc, s, l);
+
+	x0 = _mm_loadu_si128((const __m128i *)next);
+	x1 = _mm_loadu_si128((const __m128i *)(next + 16));
+	x2 = _mm_loadu_si128((const __m128i *)(next + 32));
+	x3 = _mm_loadu_si128((const __m128i *)(next + 48));
+
+	/* The running CRC is folded into the first eight bytes */
+	x0 = _mm_xor_si128(x0, _mm_cvtsi64_si128(crc));
+	next += 64;
+	l -= 64;
+
+	/* Four independent folds of 512 bits per iteration */
+	k = _mm_loadu_si128((const __m128i *)crc64_fold_512);
+	while (l >= 64) {
+		x0 = crc64_fold(x0, k, _mm_loadu_si128((const __m128i *)next));
+		x1 = crc64_fold(x1, k,
+				_mm_loadu_si128((const __m128i *)(next + 16)));
+		x2 = crc64_fold(x2, k,
+				_mm_loadu_si128((const __m128i *)(next + 32)));
+		x3 = crc64_fold(x3, k,
+				_mm_loadu_si128((const __m128i *)(next + 48)));
+		next += 64;
+		l -= 64;
+	}
+
+	/* Reduce to one register and fold in remaining 16 byte blocks */
+	k = _mm_loadu_si128((const __m128i *)crc64_fold_128);
+	x0 = crc64_fold(x0, k, x1);
+	x0 = crc64_fold(x0, k, x2);
+	x0 = crc64_fold(x0, k, x3);
+	while (l >= 16) {
+		x0 = crc64_fold(x0, k, _mm_loadu_si128((const __m128i *)next));
+		next += 16;
+		l -= 16;
+	}
+
+	_mm_storeu_si128((__m128i *)rem, x0);
+	crc = crcspeed64little(crc64_table, 0, rem, sizeof(rem));
+
+	return crcspeed64little(crc64_table, crc, (void *)next, l);
+}
+
+#endif /* __x86_64__ */
+
+/* Initializes the 16KB lookup tables and selects the carry-less multiply
+ * version when the CPU supports PCLMULQDQ
+ */
 void crc64_init(void)
 {
 	crcspeed64native_init(_crc64, crc64_table);
+
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("pclmul")) {
+		crc64_init_pclmul();
+		crc64_func = crc64_pclmul;
+		crc64_impl = "pclmul";
+		return;
+	}
+#endif
+	crc64_func = crc64_sw;
+	crc64_impl = "sw";
 }
 
 /* Compute crc64 */
 __u64 crc64(__u64 crc, const void *s, size_t l)
 {
-    return crcspeed64native(crc64_table, crc, (void *) s, l);
+	return crc64_func(crc, s, l);
 }
 
 /* Test main */
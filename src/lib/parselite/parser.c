@@ -723,19 +723,55 @@ doreturn:
 	return ret;
 }
 
-siphash_key_t __parselite_hash_key;
+struct xdp2_hash_key __parselite_hash_key = {
+	.toeplitz = XDP2_HASH_TOEPLITZ_DEFAULT_KEY,
+};
+enum xdp2_hash_algo __parselite_hash_algo = XDP2_HASH_SIPHASH;
 
+/* Same key derivation as xdp2_hash_secret_init so that parselite and the
+ * XDP2 parser compute the same hashes when given the same key
+ */
 void parselite_hash_secret_init(siphash_key_t *init_key)
 {
+	siphash_key_t *skey = &__parselite_hash_key.siphash;
+
 	if (init_key) {
-		__parselite_hash_key = *init_key;
+		*skey = *init_key;
 	} else {
-		__u8 *bytes = (__u8 *)&__parselite_hash_key;
+		__u8 *bytes = (__u8 *)skey;
 		int i;
 
-		for (i = 0; i < sizeof(__parselite_hash_key); i++)
+		for (i = 0; i < sizeof(*skey); i++)
 			bytes[i] = rand();
 	}
+
+	__parselite_hash_key.seed = skey->key[0] ^
+			__xdp2_hash_rol64(skey->key[1], 32);
+}
+
+static struct xdp2_hash_toeplitz_tbl parselite_toeplitz_tbl;
+
+/* Build the Toeplitz lookup tables for the current key */
+static void parselite_toeplitz_tbl_build(void)
+{
+	xdp2_hash_toeplitz_tbl_init(&parselite_toeplitz_tbl,
+				    __parselite_hash_key.toeplitz);
+	__parselite_hash_key.toeplitz_tbl = &parselite_toeplitz_tbl;
+}
+
+void parselite_hash_set_algo(enum xdp2_hash_algo algo)
+{
+	if (algo == XDP2_HASH_TOEPLITZ && !__parselite_hash_key.toeplitz_tbl)
+		parselite_toeplitz_tbl_build();
+
+	__parselite_hash_algo = algo;
+}
+
+void parselite_hash_set_toeplitz_key(const __u8 *key)
+{
+	memcpy(__parselite_hash_key.toeplitz, key,
+	       sizeof(__parselite_hash_key.toeplitz));
+	parselite_toeplitz_tbl_build();
 }
 
 void parselite_print_metadata(struct parselite_metadata *metadata)
@@ -0,0 +1,580 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Accelerator stage library: LZF, CRC-32C, Internet checksum, and
+ * segmentation stages for pipelines
+ */
+
+#include <byteswap.h>
+#include <errno.h>
+#include <string.h>
+
+#include "crc/crc32c.h"
+#include "lzf/lzf_compress.h"
+#include "lzf/lzf_decompress.h"
+#include "xdp2/accel_stages.h"
+#include "xdp2/checksum.h"
+#include "xdp2/utility.h"
+
+/* Output the bytes of a trailer that haven't been output yet. Returns the
+ * number of bytes output, or -EAGAIN if there's no room for any
+ */
+static ssize_t output_trailer(const __u8 *trailer, size_t len, size_t *off,
+			      __u8 *obytes, size_t obytes_size)
+{
+	size_t n = xdp2_min(len - *off, obytes_size);
+
+	if (*off == len)
+		return 0;
+
+	if (!n)
+		return -EAGAIN;
+
+	memcpy(obytes, &trailer[*off], n);
+	*off += n;
+
+	return n;
+}
+
+/* Return value of a D -> D handler that holds data. When nothing was
+ * output return -EAGAIN if there's held output so that the stage isn't
+ * considered done at the end of the input
+ */
+static ssize_t held_ret(size_t produced, bool holding)
+{
+	if (produced)
+		return produced;
+
+	return holding ? -EAGAIN : 0;
+}
+
+/* LZF */
+
+#define LZF_BLOCK_STORED	0
+#define LZF_BLOCK_COMPRESSED	1
+#define LZF_HDR_LEN_STORED	5
+
+static void put_be16(__u8 *p, size_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static size_t get_be16(const __u8 *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+void xdp2_accel_lzf_init(struct xdp2_accel_lzf *lzf, size_t block_size)
+{
+	if (!block_size || block_size > XDP2_ACCEL_LZF_MAX_BLOCK)
+		block_size = XDP2_ACCEL_LZF_MAX_BLOCK;
+
+	lzf->block_size = block_size;
+	lzf->in_len = 0;
+	lzf->need = LZF_HDR_LEN_STORED;
+	lzf->out_len = 0;
+	lzf->out_off = 0;
+	lzf->bad = false;
+}
+
+/* Copy held output to the output bytes */
+static size_t lzf_flush(struct xdp2_accel_lzf *lzf, __u8 **obytes,
+			size_t *obytes_size)
+{
+	size_t len = xdp2_min(lzf->out_len - lzf->out_off, *obytes_size);
+
+	memcpy(*obytes, &lzf->obuf[lzf->out_off], len);
+	lzf->out_off += len;
+	*obytes += len;
+	*obytes_size -= len;
+
+	if (lzf->out_off == lzf->out_len)
+		lzf->out_len = lzf->out_off = 0;
+
+	return len;
+}
+
+/* Compress the input block into a block in obuf */
+static void lzf_make_block(struct xdp2_accel_lzf *lzf)
+{
+	size_t stored_over = XDP2_ACCEL_LZF_HDR_LEN - LZF_HDR_LEN_STORED;
+	__u8 *hdr = lzf->obuf;
+	size_t clen = 0;
+
+	/* Only use a compressed block if it's smaller than a stored one */
+	if (lzf->in_len > stored_over)
+		clen = lzf_compress(lzf->ibuf, lzf->in_len,
+				    &lzf->obuf[XDP2_ACCEL_LZF_HDR_LEN],
+				    lzf->in_len - stored_over - 1);
+
+	hdr[0] = 'Z';
+	hdr[1] = 'V';
+
+	if (clen) {
+		hdr[2] = LZF_BLOCK_COMPRESSED;
+		put_be16(&hdr[3], clen);
+		put_be16(&hdr[5], lzf->in_len);
+		lzf->out_len = XDP2_ACCEL_LZF_HDR_LEN + clen;
+	} else {
+		hdr[2] = LZF_BLOCK_STORED;
+		put_be16(&hdr[3], lzf->in_len);
+		memcpy(&lzf->obuf[LZF_HDR_LEN_STORED], lzf->ibuf, lzf->in_len);
+		lzf->out_len = LZF_HDR_LEN_STORED + lzf->in_len;
+	}
+
+	lzf->out_off = 0;
+	lzf->in_len = 0;
+}
+
+static ssize_t lzf_compress_dd(__u8 *ibytes, size_t ibytes_size,
+			       __u8 *obytes, size_t obytes_size,
+			       size_t *ibytes_consumed, void *arg)
+{
+	struct xdp2_accel_lzf *lzf = arg;
+	size_t len, orig_osize = obytes_size;
+	bool end = !ibytes_size;
+
+	*ibytes_consumed = 0;
+
+	while (1) {
+		if (lzf->out_len) {
+			lzf_flush(lzf, &obytes, &obytes_size);
+			if (lzf->out_len)
+				break;
+		}
+
+		if (!ibytes_size) {
+			if (!end || !lzf->in_len)
+				break;
+
+			/* End of the input, compress the partial block */
+			lzf_make_block(lzf);
+			continue;
+		}
+
+		len = xdp2_min(ibytes_size, lzf->block_size - lzf->in_len);
+		memcpy(&lzf->ibuf[lzf->in_len], ibytes, len);
+		lzf->in_len += len;
+		ibytes += len;
+		ibytes_size -= len;
+		*ibytes_consumed += len;
+
+		if (lzf->in_len == lzf->block_size)
+			lzf_make_block(lzf);
+	}
+
+	return held_ret(orig_osize - obytes_size, lzf->out_len);
+}
+
+/* Decode the block in ibuf when the header or the whole block has been
+ * received. Sets need to the length of the block when only the header is
+ * in ibuf
+ */
+static int lzf_decode_block(struct xdp2_accel_lzf *lzf)
+{
+	const __u8 *hdr = lzf->ibuf;
+	size_t clen, ulen;
+
+	if (hdr[0] != 'Z' || hdr[1] != 'V')
+		return -EINVAL;
+
+	switch (hdr[2]) {
+	case LZF_BLOCK_STORED:
+		ulen = get_be16(&hdr[3]);
+		if (lzf->in_len < LZF_HDR_LEN_STORED + ulen) {
+			lzf->need = LZF_HDR_LEN_STORED + ulen;
+			return 0;
+		}
+		memcpy(lzf->obuf, &lzf->ibuf[LZF_HDR_LEN_STORED], ulen);
+		break;
+	case LZF_BLOCK_COMPRESSED:
+		if (lzf->in_len < XDP2_ACCEL_LZF_HDR_LEN) {
+			lzf->need = XDP2_ACCEL_LZF_HDR_LEN;
+			return 0;
+		}
+		clen = get_be16(&hdr[3]);
+		ulen = get_be16(&hdr[5]);
+		if (lzf->in_len < XDP2_ACCEL_LZF_HDR_LEN + clen) {
+			lzf->need = XDP2_ACCEL_LZF_HDR_LEN + clen;
+			return 0;
+		}
+		if (lzf_decompress(&lzf->ibuf[XDP2_ACCEL_LZF_HDR_LEN], clen,
+				   lzf->obuf, ulen) != ulen)
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	lzf->out_len = ulen;
+	lzf->out_off = 0;
+	lzf->in_len = 0;
+	lzf->need = LZF_HDR_LEN_STORED;
+
+	return 0;
+}
+
+static ssize_t lzf_decompress_dd(__u8 *ibytes, size_t ibytes_size,
+				 __u8 *obytes, size_t obytes_size,
+				 size_t *ibytes_consumed, void *arg)
+{
+	struct xdp2_accel_lzf *lzf = arg;
+	size_t len, orig_osize = obytes_size;
+	int ret;
+
+	if (lzf->bad) {
+		/* Skip the rest of a malformed stream */
+		*ibytes_consumed = ibytes_size;
+		return 0;
+	}
+
+	*ibytes_consumed = 0;
+
+	if (!ibytes_size && lzf->in_len && !lzf->out_len) {
+		/* The input ends in the middle of a block */
+		lzf->bad = true;
+		return -EINVAL;
+	}
+
+	while (1) {
+		if (lzf->out_len) {
+			lzf_flush(lzf, &obytes, &obytes_size);
+			if (lzf->out_len)
+				break;
+		}
+
+		if (!ibytes_size)
+			break;
+
+		len = xdp2_min(ibytes_size, lzf->need - lzf->in_len);
+		memcpy(&lzf->ibuf[lzf->in_len], ibytes, len);
+		lzf->in_len += len;
+		ibytes += len;
+		ibytes_size -= len;
+		*ibytes_consumed += len;
+
+		if (lzf->in_len < lzf->need)
+			continue;
+
+		ret = lzf_decode_block(lzf);
+		if (ret < 0) {
+			lzf->bad = true;
+			*ibytes_consumed += ibytes_size;
+			return ret;
+		}
+	}
+
+	return held_ret(orig_osize - obytes_size, lzf->out_len);
+}
+
+const struct xdp2_accelerator xdp2_accel_lzf_compress = {
+	.handler_dd = lzf_compress_dd,
+};
+
+const struct xdp2_accelerator xdp2_accel_lzf_decompress = {
+	.handler_dd = lzf_decompress_dd,
+};
+
+/* CRC-32C */
+
+void xdp2_accel_crc32c_init(struct xdp2_accel_crc32c *crc)
+{
+	crc32c_init();
+
+	memset(crc, 0, sizeof(*crc));
+}
+
+static void crc32c_set_trailer(__u8 *trailer, __u32 crc)
+{
+	int i;
+
+	for (i = 0; i < XDP2_ACCEL_CRC32C_LEN; i++)
+		trailer[i] = crc >> (8 * i);
+}
+
+static ssize_t crc32c_append_dd(__u8 *ibytes, size_t ibytes_size,
+				__u8 *obytes, size_t obytes_size,
+				size_t *ibytes_consumed, void *arg)
+{
+	struct xdp2_accel_crc32c *crc = arg;
+	size_t len;
+
+	if (ibytes_size) {
+		len = xdp2_min(ibytes_size, obytes_size);
+		crc->crc = crc32c(crc->crc, ibytes, len);
+		memcpy(obytes, ibytes, len);
+		*ibytes_consumed = len;
+
+		return len;
+	}
+
+	*ibytes_consumed = 0;
+
+	/* End of the input, output the CRC */
+	if (!crc->finished) {
+		crc32c_set_trailer(crc->trailer, crc->crc);
+		crc->finished = true;
+	}
+
+	return output_trailer(crc->trailer, XDP2_ACCEL_CRC32C_LEN,
+			      &crc->trailer_len, obytes, obytes_size);
+}
+
+/* Pass through held bytes and input except for the last four bytes seen
+ * which are held. If obytes is NULL then the data isn't output
+ */
+static ssize_t crc32c_verify(__u8 *ibytes, size_t ibytes_size,
+			     __u8 *obytes, size_t obytes_size,
+			     size_t *ibytes_consumed, void *arg)
+{
+	struct xdp2_accel_crc32c *crc = arg;
+	size_t total = crc->trailer_len + ibytes_size;
+	size_t len, hlen;
+	__u8 expect[XDP2_ACCEL_CRC32C_LEN];
+
+	*ibytes_consumed = 0;
+
+	if (!ibytes_size) {
+		/* End of the input, the held bytes are the CRC */
+		if (crc->finished)
+			return 0;
+
+		crc->finished = true;
+
+		if (crc->trailer_len < XDP2_ACCEL_CRC32C_LEN)
+			return -EINVAL;
+
+		crc32c_set_trailer(expect, crc->crc);
+		crc->ok = !memcmp(expect, crc->trailer,
+				  XDP2_ACCEL_CRC32C_LEN);
+
+		return crc->ok ? 0 : -EBADMSG;
+	}
+
+	len = total > XDP2_ACCEL_CRC32C_LEN ?
+				total - XDP2_ACCEL_CRC32C_LEN : 0;
+	if (obytes)
+		len = xdp2_min(len, obytes_size);
+
+	/* Output from the held bytes first and then from the input */
+	hlen = xdp2_min(len, crc->trailer_len);
+	if (hlen) {
+		crc->crc = crc32c(crc->crc, crc->trailer, hlen);
+		if (obytes)
+			memcpy(obytes, crc->trailer, hlen);
+		memmove(crc->trailer, &crc->trailer[hlen],
+			crc->trailer_len - hlen);
+		crc->trailer_len -= hlen;
+	}
+
+	if (len > hlen) {
+		crc->crc = crc32c(crc->crc, ibytes, len - hlen);
+		if (obytes)
+			memcpy(&obytes[hlen], ibytes, len - hlen);
+		*ibytes_consumed = len - hlen;
+		ibytes += len - hlen;
+		ibytes_size -= len - hlen;
+	}
+
+	/* Hold the rest of the input if it fits */
+	if (crc->trailer_len + ibytes_size <= XDP2_ACCEL_CRC32C_LEN) {
+		memcpy(&crc->trailer[crc->trailer_len], ibytes, ibytes_size);
+		crc->trailer_len += ibytes_size;
+		*ibytes_consumed += ibytes_size;
+	}
+
+	return len;
+}
+
+static ssize_t crc32c_verify_dd(__u8 *ibytes, size_t ibytes_size,
+				__u8 *obytes, size_t obytes_size,
+				size_t *ibytes_consumed, void *arg)
+{
+	return crc32c_verify(ibytes, ibytes_size, obytes, obytes_size,
+			     ibytes_consumed, arg);
+}
+
+static void crc32c_verify_dx(__u8 *ibytes, size_t ibytes_size,
+			     size_t *ibytes_consumed, void *arg)
+{
+	crc32c_verify(ibytes, ibytes_size, NULL, 0, ibytes_consumed, arg);
+}
+
+const struct xdp2_accelerator xdp2_accel_crc32c_append = {
+	.handler_dd = crc32c_append_dd,
+};
+
+const struct xdp2_accelerator xdp2_accel_crc32c_verify = {
+	.handler_dd = crc32c_verify_dd,
+	.handler_dx = crc32c_verify_dx,
+};
+
+/* Internet checksum */
+
+void xdp2_accel_checksum_init(struct xdp2_accel_checksum *cs, bool append)
+{
+	memset(cs, 0, sizeof(*cs));
+	cs->append = append;
+}
+
+/* Add a block of data to the checksum. The sum of a block that starts at
+ * an odd offset in the data is byte swapped
+ */
+static void checksum_add(struct xdp2_accel_checksum *cs, const __u8 *data,
+			 size_t len)
+{
+	__u16 sum;
+
+	if (!len)
+		return;
+
+	sum = xdp2_checksum_compute(data, len);
+	if (cs->len & 1)
+		sum = bswap_16(sum);
+
+	cs->sum += sum;
+	cs->len += len;
+}
+
+static void checksum_finish(struct xdp2_accel_checksum *cs)
+{
+	if (cs->finished)
+		return;
+
+	cs->csum = ~xdp2_checksum_fold64(cs->sum);
+	cs->finished = true;
+}
+
+static ssize_t checksum_dd(__u8 *ibytes, size_t ibytes_size,
+			   __u8 *obytes, size_t obytes_size,
+			   size_t *ibytes_consumed, void *arg)
+{
+	struct xdp2_accel_checksum *cs = arg;
+	size_t len;
+
+	if (ibytes_size) {
+		len = xdp2_min(ibytes_size, obytes_size);
+		checksum_add(cs, ibytes, len);
+		memcpy(obytes, ibytes, len);
+		*ibytes_consumed = len;
+
+		return len;
+	}
+
+	*ibytes_consumed = 0;
+
+	checksum_finish(cs);
+
+	if (!cs->append)
+		return 0;
+
+	return output_trailer((__u8 *)&cs->csum, sizeof(cs->csum),
+			      &cs->trailer_len, obytes, obytes_size);
+}
+
+static void checksum_dx(__u8 *ibytes, size_t ibytes_size,
+			size_t *ibytes_consumed, void *arg)
+{
+	struct xdp2_accel_checksum *cs = arg;
+
+	checksum_add(cs, ibytes, ibytes_size);
+	*ibytes_consumed = ibytes_size;
+
+	if (!ibytes_size)
+		checksum_finish(cs);
+}
+
+const struct xdp2_accelerator xdp2_accel_checksum = {
+	.handler_dd = checksum_dd,
+	.handler_dx = checksum_dx,
+};
+
+/* Segmentation */
+
+void xdp2_accel_segment_init(struct xdp2_accel_segment *seg,
+			     size_t segment_size)
+{
+	XDP2_ASSERT(segment_size, "Segment size is zero");
+
+	memset(seg, 0, sizeof(*seg));
+	seg->segment_size = segment_size;
+}
+
+static int segment_pp(void **ipkts, unsigned int ipkts_cnt,
+		      void **opkts, unsigned int opkts_cnt,
+		      unsigned int *ipkts_consumed, void *arg)
+{
+	struct xdp2_accel_segment *seg = arg;
+	xdp2_paddr_t *pkts = (xdp2_paddr_t *)ipkts;
+	unsigned int produced = 0;
+	xdp2_paddr_t paddr;
+	size_t len, retlen;
+
+	*ipkts_consumed = 0;
+
+	while (1) {
+		if (!seg->pkt) {
+			if (*ipkts_consumed == ipkts_cnt)
+				break;
+
+			seg->pkt = pkts[(*ipkts_consumed)++];
+			seg->offset = 0;
+			seg->length = xdp2_pvbuf_calc_length(seg->pkt);
+		}
+
+		if (seg->offset == seg->length) {
+			/* Output all the segments of the packet */
+			xdp2_pvbuf_free(seg->pkt);
+			seg->pkt = XDP2_PADDR_NULL;
+			continue;
+		}
+
+		if (produced == opkts_cnt)
+			break;
+
+		len = xdp2_min(seg->segment_size, seg->length - seg->offset);
+		paddr = xdp2_pvbuf_clone(seg->pkt, seg->offset, len, &retlen);
+		if (!paddr) {
+			/* Drop the rest of the packet */
+			xdp2_pvbuf_free(seg->pkt);
+			seg->pkt = XDP2_PADDR_NULL;
+			return produced ? : -ENOMEM;
+		}
+
+		opkts[produced++] = (void *)paddr;
+		seg->offset += len;
+	}
+
+	if (produced)
+		return produced;
+
+	return seg->pkt ? -EAGAIN : 0;
+}
+
+const struct xdp2_accelerator xdp2_accel_segment = {
+	.handler_pp = segment_pp,
+};
@@ -25,6 +25,10 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "xdp2/accelerator.h"
 
@@ -43,34 +47,55 @@
 	v;								\
 })
 
-static void adjust_output_pipe(struct xdp2_pipe *opipe, ssize_t produced)
+/* Return the sum of the producer and consumer counts of the pipes in a
+ * pipeline. The counts only increase, so a pass over the stages that
+ * doesn't change the sum didn't move any objects between stages
+ */
+static unsigned long pipes_count(const struct xdp2_pipeline *pline)
 {
-	size_t open_right = __xdp2_pipe_empty_right(opipe);
+	unsigned long count = 0;
+	int i;
+
+	for (i = 0; i < pline->num_stages - 1; i++)
+		count += pline->stages[i].pipe->prod +
+			 pline->stages[i].pipe->cons;
+
+	return count;
+}
+
+/* Report that the pipeline can't make progress. This happens when the
+ * output is full and the stages hold objects that they can't output. The
+ * objects left in the pipes are discarded so that the next run starts
+ * with empty pipes
+ */
+static void no_progress_err(const struct xdp2_pipeline *pline,
+			    unsigned int *error, unsigned int *error_stage)
+{
+	int i;
+
+	if (error && !*error) {
+		*error = ENOSPC;
+		if (error_stage)
+			*error_stage = pline->num_stages;
+	}
+
+	for (i = 0; i < pline->num_stages - 1; i++)
+		__xdp2_pipe_reset(pline->stages[i].pipe);
+}
 
+static void adjust_output_pipe(struct xdp2_pipe *opipe, ssize_t produced,
+			       size_t open_right)
+{
 	if (produced <= 0)
 		return;
 
 	XDP2_ASSERT(produced <= open_right, "Bad dp produced: %lu > %lu",
 		    produced, open_right);
 
-	opipe->prod_ptr += produced;
-
-	if (opipe->prod_ptr == opipe->size) {
-		/* We hit the limit of the input pipe array. Reset producer
-		 * pointer
-		 */
-		opipe->prod_ptr = 0;
-	}
-
-	if (opipe->prod_ptr == opipe->cons_ptr) {
-		/* We know we wrote at least one byte so the pipe must be
-		 * full if the consumer and producer pointers are equal
-		 */
-		opipe->pipe_full = true;
-	}
+	/* Publish the objects written to the pipe */
+	__xdp2_pipe_produce(opipe, produced);
 
 	__xdp2_pipe_check_pipe(opipe);
-
 }
 
 /* Output from a data pipe (or source) to a data pipe */
@@ -88,14 +113,13 @@ static ssize_t output_to_pipe_d_(const struct xdp2_pipeline_stage *stage,
 	case XDP2_PIPELINE_D:
 		/* Call handler for data to data pipe */
 		produced = accel->handler_dd(ibytes, ibytes_len,
-					     &opipe->data[opipe->prod_ptr],
-					     __xdp2_pipe_empty_right(opipe),
-					     consumed, arg);
+				&opipe->data[__xdp2_pipe_prod_pos(opipe)],
+				open_right, consumed, arg);
 		break;
 	case XDP2_PIPELINE_P:
 		produced = accel->handler_dp(ibytes, ibytes_len,
-					     &opipe->pkts[opipe->prod_ptr],
-					     open_right, consumed, arg);
+				&opipe->pkts[__xdp2_pipe_prod_pos(opipe)],
+				open_right, consumed, arg);
 		break;
 	case XDP2_PIPELINE_X:
 		accel->handler_dx(ibytes, ibytes_len, consumed, arg);
@@ -105,7 +129,7 @@ static ssize_t output_to_pipe_d_(const struct xdp2_pipeline_stage *stage,
 	XDP2_ASSERT(*consumed <= ibytes_len, "Bad dp consumed: %lu > %lu",
 	    *consumed, ibytes_len);
 
-	adjust_output_pipe(opipe, produced);
+	adjust_output_pipe(opipe, produced, open_right);
 
 	return produced;
 }
@@ -118,23 +142,22 @@ static ssize_t output_to_pipe_p_(const struct xdp2_pipeline_stage *stage,
 {
 	const struct xdp2_accelerator *accel = stage->accel;
 	struct xdp2_pipe *opipe = stage->pipe;
+	size_t open_right = __xdp2_pipe_empty_right(opipe);
 	ssize_t produced = 0;
 
 	switch (out_type) {
 	case XDP2_PIPELINE_D:
 		/* Call handler for packet to data pipe */
 		produced = accel->handler_pd(ipkts, ipkts_cnt,
-					     &opipe->data[opipe->prod_ptr],
-					     __xdp2_pipe_empty_right(opipe),
-					     consumed, arg);
+				&opipe->data[__xdp2_pipe_prod_pos(opipe)],
+				open_right, consumed, arg);
 		break;
 
 	case XDP2_PIPELINE_P:
 		/* Call handler for packet to packet pipe */
 		produced = accel->handler_pp(ipkts, ipkts_cnt,
-					     &opipe->pkts[opipe->prod_ptr],
-					     __xdp2_pipe_empty_right(opipe),
-					     consumed, arg);
+				&opipe->pkts[__xdp2_pipe_prod_pos(opipe)],
+				open_right, consumed, arg);
 		break;
 	case XDP2_PIPELINE_X:
 		/* Call handler for packet to null pipe */
@@ -142,7 +165,7 @@ static ssize_t output_to_pipe_p_(const struct xdp2_pipeline_stage *stage,
 		return 0;
 	}
 
-	adjust_output_pipe(opipe, produced);
+	adjust_output_pipe(opipe, produced, open_right);
 
 	return produced;
 }
@@ -161,27 +184,27 @@ static ssize_t output_stage(const struct xdp2_pipeline_stage *stage,
 
 	XDP2_SELECT_START(prev_stage->type, stage->type)
 	XDP2_SELECT_CASE(XDP2_PIPELINE_D, XDP2_PIPELINE_D)
-		ibytes_addr = &ipipe->data[ipipe->cons_ptr];
+		ibytes_addr = &ipipe->data[__xdp2_pipe_cons_pos(ipipe)];
 		produced = output_to_pipe_d_(stage, ibytes_addr,
 					     __xdp2_pipe_filled_right(ipipe),
 					     &consumed, arg,
 					     XDP2_PIPELINE_D);
 		break;
 	XDP2_SELECT_CASE(XDP2_PIPELINE_D, XDP2_PIPELINE_P)
-		ibytes_addr = &ipipe->data[ipipe->cons_ptr];
+		ibytes_addr = &ipipe->data[__xdp2_pipe_cons_pos(ipipe)];
 		produced = (size_t)output_to_pipe_d_(stage, ibytes_addr,
 				__xdp2_pipe_filled_right(ipipe),
 				&consumed, arg, XDP2_PIPELINE_P);
 		break;
 	XDP2_SELECT_CASE(XDP2_PIPELINE_P, XDP2_PIPELINE_D)
-		ipkts_addr = &ipipe->pkts[ipipe->cons_ptr];
+		ipkts_addr = &ipipe->pkts[__xdp2_pipe_cons_pos(ipipe)];
 		produced = output_to_pipe_p_(stage, ipkts_addr,
 				(unsigned int)__xdp2_pipe_filled_right(ipipe),
 				&pkts_consumed, arg, XDP2_PIPELINE_D);
 		consumed = (size_t)pkts_consumed;
 		break;
 	XDP2_SELECT_CASE(XDP2_PIPELINE_P, XDP2_PIPELINE_P)
-		ipkts_addr = &ipipe->pkts[ipipe->cons_ptr];
+		ipkts_addr = &ipipe->pkts[__xdp2_pipe_cons_pos(ipipe)];
 		produced = (size_t)output_to_pipe_p_(stage, ipkts_addr,
 				(unsigned int)__xdp2_pipe_filled_right(ipipe),
 				&pkts_consumed, arg, XDP2_PIPELINE_P);
@@ -195,10 +218,7 @@ static ssize_t output_stage(const struct xdp2_pipeline_stage *stage,
 		/* Move the consumer pointer (note that the producer pointer
 		 * was adjusted in the output_to_pipe_XX functions)
 		 */
-		ipipe->cons_ptr += consumed;
-		ipipe->pipe_full = false;
-		if (ipipe->cons_ptr == ipipe->size)
-			ipipe->cons_ptr = 0;
+		__xdp2_pipe_consume(ipipe, consumed);
 	}
 
 	return produced;
@@ -278,56 +298,56 @@ static ssize_t output_last_stage(const struct xdp2_pipeline_stage *stage,
 
 	XDP2_SELECT_START(prev_stage->type, stage->type)
 	XDP2_SELECT_CASE(XDP2_PIPELINE_D, XDP2_PIPELINE_D)
-		ibytes_addr = &ipipe->data[ipipe->cons_ptr];
+		ibytes_addr = &ipipe->data[__xdp2_pipe_cons_pos(ipipe)];
 		produced = accel->handler_dd(ibytes_addr,
 				__xdp2_pipe_filled_right(ipipe),
 				(__u8 *)output, out_len, &consumed, arg);
-		XDP2_ASSERT(produced <= out_len,
+		XDP2_ASSERT(produced <= (ssize_t)out_len,
 			    "Last DD handler over-produced : %lu > %lu\n",
 			    produced, out_len);
 		break;
 	XDP2_SELECT_CASE(XDP2_PIPELINE_D, XDP2_PIPELINE_P)
-		ibytes_addr = &ipipe->data[ipipe->cons_ptr];
+		ibytes_addr = &ipipe->data[__xdp2_pipe_cons_pos(ipipe)];
 		produced = accel->handler_dp((__u8 *)ibytes_addr,
 				__xdp2_pipe_filled_right(ipipe),
 				(void **)output, (unsigned int)out_len,
 				&consumed, arg);
-		XDP2_ASSERT(produced <= out_len,
+		XDP2_ASSERT(produced <= (ssize_t)out_len,
 			    "Last DP handler over-produced : %lu > %lu\n",
 			    produced, out_len);
 		break;
 	XDP2_SELECT_CASE(XDP2_PIPELINE_D, XDP2_PIPELINE_X)
-		ibytes_addr = &ipipe->data[ipipe->cons_ptr];
+		ibytes_addr = &ipipe->data[__xdp2_pipe_cons_pos(ipipe)];
 		accel->handler_dx((__u8 *)ibytes_addr,
 				  __xdp2_pipe_filled_right(ipipe),
 				  &consumed, arg);
 		produced = 0;
 		break;
 	XDP2_SELECT_CASE(XDP2_PIPELINE_P, XDP2_PIPELINE_D)
-		ipkts_addr = &ipipe->pkts[ipipe->cons_ptr];
+		ipkts_addr = &ipipe->pkts[__xdp2_pipe_cons_pos(ipipe)];
 		produced = accel->handler_pd(ipkts_addr,
 				(unsigned int)__xdp2_pipe_filled_right(ipipe),
 				(__u8 *)output, out_len,
 				&pkts_consumed, arg);
-		XDP2_ASSERT(produced <= out_len,
+		XDP2_ASSERT(produced <= (ssize_t)out_len,
 			    "Last PD handler over-produced : %lu > %lu\n",
 			    produced, out_len);
 		consumed = (size_t)pkts_consumed;
 
 		break;
 	XDP2_SELECT_CASE(XDP2_PIPELINE_P, XDP2_PIPELINE_P)
-		ipkts_addr = &ipipe->pkts[ipipe->cons_ptr];
+		ipkts_addr = &ipipe->pkts[__xdp2_pipe_cons_pos(ipipe)];
 		produced = (size_t)accel->handler_pp(ipkts_addr,
 				(unsigned int)__xdp2_pipe_filled_right(ipipe),
 				(void **)output, (unsigned int)out_len,
 				&pkts_consumed, arg);
-		XDP2_ASSERT(produced <= out_len,
+		XDP2_ASSERT(produced <= (ssize_t)out_len,
 			    "Last PP handler over-produced : %lu > %lu\n",
 			    produced, out_len);
 		consumed = (size_t)pkts_consumed;
 		break;
 	XDP2_SELECT_CASE(XDP2_PIPELINE_P, XDP2_PIPELINE_X)
-		ipkts_addr = &ipipe->pkts[ipipe->cons_ptr];
+		ipkts_addr = &ipipe->pkts[__xdp2_pipe_cons_pos(ipipe)];
 		accel->handler_px(ipkts_addr,
 				  (unsigned int)__xdp2_pipe_filled_right(ipipe),
 				  &pkts_consumed, arg);
@@ -342,11 +362,7 @@ static ssize_t output_last_stage(const struct xdp2_pipeline_stage *stage,
 		/* Move the consumer pointer (note that the producer pointer
 		 * was adjusted in the output_to_pipe_XX functions)
 		 */
-
-		ipipe->cons_ptr += consumed;
-		ipipe->pipe_full = false;
-		if (ipipe->cons_ptr == ipipe->size)
-			ipipe->cons_ptr = 0;
+		__xdp2_pipe_consume(ipipe, consumed);
 	}
 
 	__xdp2_pipe_check_pipe(ipipe);
@@ -354,9 +370,12 @@ static ssize_t output_last_stage(const struct xdp2_pipeline_stage *stage,
 	return produced;
 }
 
-/* Run the last stage of a pipeline */
+/* Run the last stage of a pipeline. upstream_done indicates that the stage
+ * before the last is done
+ */
 static ssize_t run_last_stage(const struct xdp2_pipeline *pline, void *output,
-			      size_t out_len, void *arg, bool *done)
+			      size_t out_len, void *arg, bool upstream_done,
+			      bool *done)
 {
 	const struct xdp2_pipeline_stage *stage =
 			&pline->stages[pline->num_stages - 1];
@@ -366,16 +385,17 @@ static ssize_t run_last_stage(const struct xdp2_pipeline *pline, void *output,
 	ssize_t produced;
 	bool ldone;
 
-	if (__xdp2_pipe_empty(ipipe) && !done) {
+	if (__xdp2_pipe_empty(ipipe) && !upstream_done) {
 		/* Don't call the handler with a zero input length until
 		 * before the pipe is done. This way when the handler sees
 		 * the zero length input it knows that's the end of the
 		 * possible input
 		 */
+		*done = false;
 		return 0;
 	}
 
-	ldone = __xdp2_pipe_empty(ipipe) && done;
+	ldone = __xdp2_pipe_empty(ipipe) && upstream_done;
 
 	produced = output_last_stage(stage, prev_stage, output, out_len, arg);
 
@@ -395,14 +415,21 @@ static size_t run_stages_after_first(struct xdp2_pipeline *pline,
 	const struct xdp2_pipeline_stage *last_stage =
 				&pline->stages[pline->num_stages - 1];
 	ssize_t produced = 0;
+	unsigned long count;
+	size_t osize;
 	int not_done;
 
 	for (not_done = 1; not_done < pline->num_stages - 1;) {
+		count = pipes_count(pline);
+		osize = output_size;
+
 		not_done = run_all_intermedate(pline, not_done, error,
 					       error_stage, args, true);
 
 		produced = run_last_stage(pline, output, output_size,
-					  args[pline->num_stages - 1], done);
+					  args[pline->num_stages - 1],
+					  not_done >= pline->num_stages - 1,
+					  done);
 
 		if (produced >= 0) {
 			if (last_stage->type == XDP2_PIPELINE_P)
@@ -413,12 +440,25 @@ static size_t run_stages_after_first(struct xdp2_pipeline *pline,
 		} else {
 			PRODUCED_ERR(produced, pline->num_stages);
 		}
+
+		if (not_done < pline->num_stages - 1 &&
+		    osize == output_size && count == pipes_count(pline)) {
+			/* Nothing moved so nothing will change in another
+			 * pass over the stages
+			 */
+			no_progress_err(pline, error, error_stage);
+			return output_size;
+		}
 	}
 
-	/* Intermediate stages are done, finish last stage */
-	for (*done = false; !*done; *done = true) {
+	/* Intermediate stages are done, run the last stage until it's done.
+	 * Stop if it doesn't produce any output since the output space
+	 * won't change
+	 */
+	do {
 		produced = run_last_stage(pline, output, output_size,
-					  args[pline->num_stages - 1], done);
+					  args[pline->num_stages - 1], true,
+					  done);
 		if (produced >= 0) {
 			if (last_stage->type == XDP2_PIPELINE_P)
 				output += produced * sizeof(void *);
@@ -428,11 +468,24 @@ static size_t run_stages_after_first(struct xdp2_pipeline *pline,
 		} else {
 			PRODUCED_ERR(produced, pline->num_stages);
 		}
+	} while (produced > 0);
+
+	if (!*done) {
+		/* The last stage holds objects that don't fit in the
+		 * output
+		 */
+		no_progress_err(pline, error, error_stage);
 	}
 
 	return output_size;
 }
 
+static size_t run_pipeline_threaded(struct xdp2_pipeline *pline,
+				    bool pkt_input, void *input,
+				    size_t input_size, void *output,
+				    size_t output_size, unsigned int *error,
+				    unsigned int *error_stage, void **args);
+
 /* Run pipeline with a flat data block of some size as input. The pipeline
  * output may be and another data block or a set of packets. The return
  * value is the number of objects (bytes or packets) written to output
@@ -446,16 +499,25 @@ size_t __xdp2_run_pipeline_d(struct xdp2_pipeline *pline, void *input,
 				&pline->stages[pline->num_stages - 1];
 	const struct xdp2_pipeline_stage *stage = &pline->stages[0];
 	void *null_args[XDP2_PIPELINE_MAX_STAGES] = {};
-	size_t consumed, orig_osize = output_size;
+	size_t consumed, osize, orig_osize = output_size;
 	ssize_t produced = 0;
+	unsigned long count;
 	bool done = false;
 
 	args = args ? : null_args;
 
+	if (pline->threads)
+		return run_pipeline_threaded(pline, false, input, input_size,
+					     output, output_size, error,
+					     error_stage, args);
+
 	/* Run all the stages in the pipeline in sequence and in a loop
 	 * until we've exhusated the input size (XXX First stage is done)
 	 */
 	while (1) {
+		count = pipes_count(pline);
+		osize = output_size;
+
 		/* Run first stage based on whether the upstream pipe
 		 * is data or packet
 		 */
@@ -484,7 +546,8 @@ size_t __xdp2_run_pipeline_d(struct xdp2_pipeline *pline, void *input,
 
 		/* Run last stage */
 		produced = run_last_stage(pline, output, output_size,
-					  args[pline->num_stages - 1], &done);
+					  args[pline->num_stages - 1], false,
+					  &done);
 		if (produced >= 0) {
 			if (last_stage->type == XDP2_PIPELINE_P)
 				output += produced * sizeof(void *);
@@ -494,6 +557,15 @@ size_t __xdp2_run_pipeline_d(struct xdp2_pipeline *pline, void *input,
 		} else {
 			PRODUCED_ERR(produced, pline->num_stages);
 		}
+
+		if (!consumed && osize == output_size &&
+		    count == pipes_count(pline)) {
+			/* Nothing moved so nothing will change in another
+			 * pass over the stages
+			 */
+			no_progress_err(pline, error, error_stage);
+			return orig_osize - output_size;
+		}
 	}
 
 	output_size = run_stages_after_first(pline, output, output_size,
@@ -515,8 +587,9 @@ size_t __xdp2_run_pipeline_p(struct xdp2_pipeline *pline, void **ipkts,
 				&pline->stages[pline->num_stages - 1];
 	const struct xdp2_pipeline_stage *stage = &pline->stages[0];
 	void *null_args[XDP2_PIPELINE_MAX_STAGES] = {};
-	size_t orig_osize = output_size;
+	size_t osize, orig_osize = output_size;
 	unsigned int consumed;
+	unsigned long count;
 	bool done = false;
 	ssize_t produced;
 
@@ -524,10 +597,18 @@ size_t __xdp2_run_pipeline_p(struct xdp2_pipeline *pline, void **ipkts,
 
 	*error = 0;
 
+	if (pline->threads)
+		return run_pipeline_threaded(pline, true, ipkts, ipkts_cnt,
+					     output, output_size, error,
+					     error_stage, args);
+
 	/* Run all the stages in the pipeline in sequence and in a loop
 	 * until we've exhausted the input pac kets (XXX First stage is done)
 	 */
 	while (1) {
+		count = pipes_count(pline);
+		osize = output_size;
+
 		/* Run first stage based on whether the upstream pipe
 		 * is data or packet
 		 */
@@ -553,7 +634,8 @@ size_t __xdp2_run_pipeline_p(struct xdp2_pipeline *pline, void **ipkts,
 				    args, false);
 
 		produced = run_last_stage(pline, output, output_size,
-					  args[pline->num_stages - 1], &done);
+					  args[pline->num_stages - 1], false,
+					  &done);
 
 		if (produced >= 0) {
 			if (last_stage->type == XDP2_PIPELINE_P)
@@ -564,6 +646,15 @@ size_t __xdp2_run_pipeline_p(struct xdp2_pipeline *pline, void **ipkts,
 		} else {
 			PRODUCED_ERR(produced, pline->num_stages);
 		}
+
+		if (!consumed && osize == output_size &&
+		    count == pipes_count(pline)) {
+			/* Nothing moved so nothing will change in another
+			 * pass over the stages
+			 */
+			no_progress_err(pline, error, error_stage);
+			return orig_osize - output_size;
+		}
 	}
 
 	output_size = run_stages_after_first(pline, output, output_size,
@@ -594,8 +685,16 @@ int xdp2_init_pipeline(struct xdp2_pipeline *pline)
 			XDP2_ERR(1, "Bad size");
 		}
 
-		/* Malloc the pipe memory */
-		stage->pipe = malloc(sizeof(struct xdp2_pipe) + dsize);
+		/* Allocate the pipe memory. The producer and consumer
+		 * counts are on separate cache lines for threaded mode
+		 */
+		stage->pipe = aligned_alloc(XDP2_CACHELINE_SIZE,
+				xdp2_round_up(sizeof(struct xdp2_pipe) + dsize,
+					      XDP2_CACHELINE_SIZE));
+		if (!stage->pipe)
+			return -ENOMEM;
+
+		__xdp2_pipe_reset(stage->pipe);
 		stage->pipe->size = stage->pipe_size;
 	}
 
@@ -623,3 +722,534 @@ int xdp2_init_pipelines(void)
 
 	return 0;
 }
+
+/* Threaded pipelines */
+
+/* Number of times a thread polls without progress before yielding the CPU */
+#define PIPELINE_IDLE_SPINS 64
+
+/* Number of times a worker polls for the next run before sleeping */
+#define PIPELINE_WAIT_SPINS 1024
+
+/* A group of consecutive stages run by one thread. Group zero is run by the
+ * thread that calls the run function
+ */
+struct xdp2_pipeline_worker {
+	struct xdp2_pipeline_threads *pt;
+	pthread_t thread;
+	unsigned int first_stage;
+	unsigned int last_stage;
+	int cpu;
+
+	/* Rounds over the group's stages in the current run, rounds in which
+	 * a stage made progress, and whether the group is done
+	 */
+	unsigned long rounds;
+	unsigned long progress_rounds;
+	bool finished;
+};
+
+/* Snapshot of the progress_rounds and rounds of the groups, used by the
+ * calling thread to detect a run that can't make progress
+ */
+struct xdp2_pipeline_stall {
+	bool valid;
+	unsigned long progress_rounds[XDP2_PIPELINE_MAX_STAGES];
+	unsigned long rounds[XDP2_PIPELINE_MAX_STAGES];
+};
+
+struct xdp2_pipeline_threads {
+	struct xdp2_pipeline *pline;
+	unsigned int num_groups;
+
+	/* A run is started by incrementing seq, stop tells the workers to
+	 * exit. Both are set under the mutex
+	 */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	unsigned long seq;
+	bool stop;
+
+	/* Number of worker groups that haven't finished the current run */
+	unsigned int running;
+
+	/* Arguments of the current run. The input is only accessed by the
+	 * first stage and the output by the last stage
+	 */
+	bool pkt_input;
+	void *input;
+	size_t input_size;
+	void *output;
+	size_t output_size;
+	void **args;
+	unsigned int error;
+	unsigned int error_stage;
+
+	/* Set on an error or when the pipeline can't make progress, all the
+	 * groups stop
+	 */
+	bool abort;
+
+	/* Only used by the calling thread */
+	struct xdp2_pipeline_stall stall;
+
+	struct xdp2_pipeline_worker workers[XDP2_PIPELINE_MAX_STAGES];
+};
+
+static inline void pipeline_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/* Called when a thread has nothing to do. Spin briefly since the adjacent
+ * stages are usually running on other CPUs, then yield in case they are
+ * waiting for this CPU
+ */
+static inline void pipeline_relax(unsigned int *idle)
+{
+	if (++*idle < PIPELINE_IDLE_SPINS)
+		pipeline_cpu_relax();
+	else
+		sched_yield();
+}
+
+/* Record an error from a threaded stage, the first error is reported. An
+ * error ends the run since the stage may never consume its input, and a
+ * stage that's blocked on it would wait forever
+ */
+static void thread_err(struct xdp2_pipeline_threads *pt, ssize_t produced,
+		       unsigned int stage_num)
+{
+	unsigned int no_error = 0;
+
+	if (produced >= 0 || produced == -EAGAIN)
+		return;
+
+	if (__atomic_compare_exchange_n(&pt->error, &no_error, -produced,
+					false, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED))
+		pt->error_stage = stage_num;
+
+	__atomic_store_n(&pt->abort, true, __ATOMIC_RELAXED);
+}
+
+/* Check if a threaded run can't make progress, called by the calling thread
+ * when it's idle. The run is stuck if no group made progress since the
+ * snapshot and every group that isn't done completed a whole round after
+ * the snapshot, that is it ran all of its stages against pipes that didn't
+ * change. The run ends with ENOSPC as in the sequential mode
+ */
+static void thread_check_stall(struct xdp2_pipeline_threads *pt)
+{
+	struct xdp2_pipeline_stall *stall = &pt->stall;
+	unsigned long progress_rounds[XDP2_PIPELINE_MAX_STAGES];
+	unsigned long rounds[XDP2_PIPELINE_MAX_STAGES];
+	bool changed = !stall->valid, waiting = false, running = false;
+	struct xdp2_pipeline_worker *w;
+	unsigned int i;
+
+	for (i = 0; i < pt->num_groups; i++) {
+		w = &pt->workers[i];
+
+		/* Read rounds first, a round increments progress_rounds
+		 * before rounds so the progress of the rounds counted is
+		 * seen
+		 */
+		rounds[i] = __atomic_load_n(&w->rounds, __ATOMIC_ACQUIRE);
+		progress_rounds[i] = __atomic_load_n(&w->progress_rounds,
+						     __ATOMIC_RELAXED);
+
+		if (progress_rounds[i] != stall->progress_rounds[i])
+			changed = true;
+
+		if (__atomic_load_n(&w->finished, __ATOMIC_RELAXED))
+			continue;
+
+		running = true;
+		if (rounds[i] < stall->rounds[i] + 2)
+			waiting = true;
+	}
+
+	if (changed) {
+		memcpy(stall->progress_rounds, progress_rounds,
+		       pt->num_groups * sizeof(progress_rounds[0]));
+		memcpy(stall->rounds, rounds,
+		       pt->num_groups * sizeof(rounds[0]));
+		stall->valid = true;
+	} else if (running && !waiting) {
+		thread_err(pt, -ENOSPC, pt->pline->num_stages);
+	}
+}
+
+/* Run the first stage of a threaded pipeline from the input. Returns true
+ * if the stage made progress
+ */
+static bool thread_run_first(struct xdp2_pipeline_threads *pt, bool *done)
+{
+	const struct xdp2_pipeline_stage *stage = &pt->pline->stages[0];
+	bool input_empty = !pt->input_size;
+	unsigned int pkts_consumed = 0;
+	size_t consumed = 0;
+	ssize_t produced;
+
+	/* Backpressure, wait for the next stage to drain the pipe */
+	if (__xdp2_pipe_full(stage->pipe))
+		return false;
+
+	if (pt->pkt_input) {
+		produced = output_to_pipe_p_(stage, pt->input,
+					     pt->input_size, &pkts_consumed,
+					     pt->args[0], stage->type);
+		pt->input += pkts_consumed * sizeof(void *);
+		consumed = pkts_consumed;
+	} else {
+		produced = output_to_pipe_d_(stage, pt->input,
+					     pt->input_size, &consumed,
+					     pt->args[0], stage->type);
+		pt->input += consumed;
+	}
+	pt->input_size -= consumed;
+
+	thread_err(pt, produced, 0);
+
+	if (input_empty && !produced) {
+		/* All the input is consumed and the handler reported
+		 * it's done
+		 */
+		__xdp2_pipe_set_done(stage->pipe);
+		*done = true;
+	}
+
+	return consumed || produced > 0 || *done;
+}
+
+/* Run an intermediate stage of a threaded pipeline */
+static bool thread_run_intermediate(struct xdp2_pipeline_threads *pt,
+				    unsigned int stage_num, bool *done)
+{
+	const struct xdp2_pipeline_stage *stage =
+					&pt->pline->stages[stage_num];
+	const struct xdp2_pipeline_stage *prev_stage = stage - 1;
+	struct xdp2_pipe *ipipe = prev_stage->pipe;
+	unsigned long cons = ipipe->cons;
+	bool empty, ldone;
+	ssize_t ret;
+
+	/* Check done before empty, the upstream stage publishes all of its
+	 * output before it sets done
+	 */
+	ldone = __xdp2_pipe_done(ipipe);
+	empty = __xdp2_pipe_empty(ipipe);
+	ldone = ldone && empty;
+
+	if ((empty && !ldone) || __xdp2_pipe_full(stage->pipe))
+		return false;
+
+	ret = output_stage(stage, prev_stage, pt->args[stage_num]);
+
+	thread_err(pt, ret, stage_num);
+
+	/* The stage is done when the input pipe is empty and the handler
+	 * return zero
+	 */
+	if (ldone && !ret) {
+		__xdp2_pipe_set_done(stage->pipe);
+		*done = true;
+	}
+
+	return ret > 0 || ipipe->cons != cons || *done;
+}
+
+/* Run the last stage of a threaded pipeline into the output */
+static bool thread_run_last(struct xdp2_pipeline_threads *pt, bool *done)
+{
+	const struct xdp2_pipeline *pline = pt->pline;
+	const struct xdp2_pipeline_stage *stage =
+					&pline->stages[pline->num_stages - 1];
+	const struct xdp2_pipeline_stage *prev_stage = stage - 1;
+	struct xdp2_pipe *ipipe = prev_stage->pipe;
+	unsigned long cons = ipipe->cons;
+	bool empty, ldone, settled;
+	ssize_t produced;
+
+	ldone = __xdp2_pipe_done(ipipe);
+	empty = __xdp2_pipe_empty(ipipe);
+	settled = ldone || __xdp2_pipe_full(ipipe);
+	ldone = ldone && empty;
+
+	if (empty && !ldone)
+		return false;
+
+	produced = output_last_stage(stage, prev_stage, pt->output,
+				     pt->output_size,
+				     pt->args[pline->num_stages - 1]);
+	if (produced >= 0) {
+		if (stage->type == XDP2_PIPELINE_P)
+			pt->output += produced * sizeof(void *);
+		else
+			pt->output += produced;
+		pt->output_size -= produced;
+	} else {
+		thread_err(pt, produced, pline->num_stages);
+	}
+
+	/* The last stage is done when the input pipe is empty and the
+	 * handler doesn't produce output. If it returns an error at that
+	 * point it's done too since the output space won't change
+	 */
+	if (ldone && produced <= 0)
+		*done = true;
+
+	if (produced <= 0 && ipipe->cons == cons && settled &&
+	    (!*done || produced == -EAGAIN)) {
+		/* The input pipe can't change until this stage consumes from
+		 * it, and the stage can't output what it holds, so the
+		 * output is full
+		 */
+		thread_err(pt, -ENOSPC, pline->num_stages);
+	}
+
+	return produced > 0 || ipipe->cons != cons || *done;
+}
+
+/* Run a group of stages until they're all done */
+static void thread_run_group(struct xdp2_pipeline_threads *pt,
+			     struct xdp2_pipeline_worker *w)
+{
+	unsigned int last = pt->pline->num_stages - 1;
+	bool done[XDP2_PIPELINE_MAX_STAGES] = {};
+	unsigned int i, num_done = 0, idle = 0;
+	bool progress;
+
+	while (num_done <= w->last_stage - w->first_stage &&
+	       !__atomic_load_n(&pt->abort, __ATOMIC_RELAXED)) {
+		progress = false;
+
+		for (i = w->first_stage; i <= w->last_stage; i++) {
+			if (done[i])
+				continue;
+
+			if (i == 0)
+				progress |= thread_run_first(pt, &done[i]);
+			else if (i == last)
+				progress |= thread_run_last(pt, &done[i]);
+			else
+				progress |= thread_run_intermediate(pt, i,
+								    &done[i]);
+			if (done[i])
+				num_done++;
+		}
+
+		if (progress) {
+			__atomic_store_n(&w->progress_rounds,
+					 w->progress_rounds + 1,
+					 __ATOMIC_RELEASE);
+			idle = 0;
+		}
+		__atomic_store_n(&w->rounds, w->rounds + 1, __ATOMIC_RELEASE);
+
+		if (!progress) {
+			/* The first group runs in the calling thread */
+			if (w == pt->workers)
+				thread_check_stall(pt);
+			pipeline_relax(&idle);
+		}
+	}
+
+	__atomic_store_n(&w->finished, true, __ATOMIC_RELEASE);
+}
+
+static void *pipeline_worker(void *arg)
+{
+	struct xdp2_pipeline_worker *w = arg;
+	struct xdp2_pipeline_threads *pt = w->pt;
+	unsigned long seq = 0;
+	unsigned int i;
+	cpu_set_t cpus;
+	bool stop;
+
+	if (w->cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(w->cpu, &cpus);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(cpus),
+					   &cpus))
+			XDP2_WARN("Pipeline worker unable to pin to CPU %d",
+				  w->cpu);
+	}
+
+	while (1) {
+		/* Back to back runs are common so poll for a while before
+		 * sleeping
+		 */
+		for (i = 0; i < PIPELINE_WAIT_SPINS &&
+			    __atomic_load_n(&pt->seq, __ATOMIC_ACQUIRE) == seq;
+		     i++)
+			pipeline_cpu_relax();
+
+		pthread_mutex_lock(&pt->mutex);
+		while (pt->seq == seq && !pt->stop)
+			pthread_cond_wait(&pt->cond, &pt->mutex);
+		seq = pt->seq;
+		stop = pt->stop;
+		pthread_mutex_unlock(&pt->mutex);
+
+		if (stop)
+			break;
+
+		thread_run_group(pt, w);
+
+		/* Publishes the group's output and errors to the caller */
+		__atomic_fetch_sub(&pt->running, 1, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+static size_t run_pipeline_threaded(struct xdp2_pipeline *pline,
+				    bool pkt_input, void *input,
+				    size_t input_size, void *output,
+				    size_t output_size, unsigned int *error,
+				    unsigned int *error_stage, void **args)
+{
+	struct xdp2_pipeline_threads *pt = pline->threads;
+	unsigned int i, idle = 0;
+
+	for (i = 0; i < pline->num_stages - 1; i++)
+		__xdp2_pipe_reset(pline->stages[i].pipe);
+
+	pt->pkt_input = pkt_input;
+	pt->input = input;
+	pt->input_size = input_size;
+	pt->output = output;
+	pt->output_size = output_size;
+	pt->args = args;
+	pt->error = 0;
+	pt->error_stage = 0;
+	pt->abort = false;
+	pt->stall.valid = false;
+	pt->running = pt->num_groups - 1;
+
+	for (i = 0; i < pt->num_groups; i++) {
+		pt->workers[i].rounds = 0;
+		pt->workers[i].progress_rounds = 0;
+		pt->workers[i].finished = false;
+	}
+
+	/* Start the workers, the mutex publishes the run arguments */
+	pthread_mutex_lock(&pt->mutex);
+	__atomic_store_n(&pt->seq, pt->seq + 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&pt->cond);
+	pthread_mutex_unlock(&pt->mutex);
+
+	thread_run_group(pt, &pt->workers[0]);
+
+	while (__atomic_load_n(&pt->running, __ATOMIC_ACQUIRE)) {
+		thread_check_stall(pt);
+		pipeline_relax(&idle);
+	}
+
+	if (pt->error && error && !*error) {
+		*error = pt->error;
+		if (error_stage)
+			*error_stage = pt->error_stage;
+	}
+
+	return output_size - pt->output_size;
+}
+
+/* Stop and join the first num workers of a pipeline */
+static void stop_workers(struct xdp2_pipeline_threads *pt, unsigned int num)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&pt->mutex);
+	pt->stop = true;
+	pthread_cond_broadcast(&pt->cond);
+	pthread_mutex_unlock(&pt->mutex);
+
+	for (i = 1; i < num; i++)
+		pthread_join(pt->workers[i].thread, NULL);
+
+	pthread_cond_destroy(&pt->cond);
+	pthread_mutex_destroy(&pt->mutex);
+	free(pt);
+}
+
+int xdp2_pipeline_start_threads(struct xdp2_pipeline *pline,
+				const unsigned int *group_sizes,
+				unsigned int num_groups, const int *cpus)
+{
+	struct xdp2_pipeline_threads *pt;
+	struct xdp2_pipeline_worker *w;
+	unsigned int i, stage = 0;
+	int ret;
+
+	if (pline->threads)
+		return -EBUSY;
+
+	if (!group_sizes)
+		num_groups = pline->num_stages;
+
+	if (pline->num_stages < 2 || !pline->stages[0].pipe ||
+	    !num_groups || num_groups > pline->num_stages)
+		return -EINVAL;
+
+	pt = calloc(1, sizeof(*pt));
+	if (!pt)
+		return -ENOMEM;
+
+	pt->pline = pline;
+	pt->num_groups = num_groups;
+
+	for (i = 0; i < num_groups; i++) {
+		unsigned int size = group_sizes ? group_sizes[i] : 1;
+
+		if (!size || stage + size > pline->num_stages) {
+			free(pt);
+			return -EINVAL;
+		}
+
+		w = &pt->workers[i];
+		w->pt = pt;
+		w->first_stage = stage;
+		w->last_stage = stage + size - 1;
+		w->cpu = (i && cpus) ? cpus[i - 1] : -1;
+
+		stage += size;
+	}
+
+	if (stage != pline->num_stages) {
+		free(pt);
+		return -EINVAL;
+	}
+
+	pthread_mutex_init(&pt->mutex, NULL);
+	pthread_cond_init(&pt->cond, NULL);
+
+	for (i = 1; i < num_groups; i++) {
+		ret = pthread_create(&pt->workers[i].thread, NULL,
+				     pipeline_worker, &pt->workers[i]);
+		if (ret) {
+			stop_workers(pt, i);
+			return -ret;
+		}
+	}
+
+	pline->threads = pt;
+
+	return 0;
+}
+
+void xdp2_pipeline_stop_threads(struct xdp2_pipeline *pline)
+{
+	struct xdp2_pipeline_threads *pt = pline->threads;
+
+	if (!pt)
+		return;
+
+	pline->threads = NULL;
+
+	stop_workers(pt, pt->num_groups);
+}
@@ -0,0 +1,423 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Bulk bitmap kernels and runtime selection
+ *
+ * The generic kernel uses the inline word at a time bitmap functions. The
+ * popcnt kernel is the same loop over sixty-four bit words compiled for
+ * popcnt, tzcnt, and lzcnt. The AVX2 kernel skips runs of empty (or full
+ * for find zero) words thirty-two bytes at a time, counts bits with
+ * nibble table lookups (pshufb) summed by psadbw, and does the logical
+ * operations on thirty-two byte vectors. The bits of a partial last word
+ * are handled by the scalar code
+ */
+
+#include <string.h>
+
+#include "xdp2/bitmap.h"
+#include "xdp2/utility.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+static bool bitmap_supported_always(void)
+{
+	return true;
+}
+
+/* Generic kernel */
+
+static unsigned int bitmap_find_generic(const unsigned long *addr,
+					unsigned int pos, unsigned int nbits)
+{
+	return xdp2_bitmap_find(addr, pos, nbits);
+}
+
+static unsigned int bitmap_find_zero_generic(const unsigned long *addr,
+					     unsigned int pos,
+					     unsigned int nbits)
+{
+	return xdp2_bitmap_find_zero(addr, pos, nbits);
+}
+
+static unsigned int bitmap_weight_generic(const unsigned long *addr,
+					  unsigned int nbits)
+{
+	return xdp2_bitmap_test((unsigned long *)addr, 0, nbits,
+				XDP2_BITMAP_TEST_WEIGHT);
+}
+
+static void bitmap_and_generic(unsigned long *dest,
+			       const unsigned long *src1,
+			       const unsigned long *src2, unsigned int nbits)
+{
+	xdp2_bitmap_and(dest, src1, src2, 0, nbits);
+}
+
+static void bitmap_or_generic(unsigned long *dest, const unsigned long *src1,
+			      const unsigned long *src2, unsigned int nbits)
+{
+	xdp2_bitmap_or(dest, src1, src2, 0, nbits);
+}
+
+static void bitmap_and_not_generic(unsigned long *dest,
+				   const unsigned long *src1,
+				   const unsigned long *src2,
+				   unsigned int nbits)
+{
+	xdp2_bitmap_and_not(dest, src1, src2, 0, nbits);
+}
+
+#if defined(__x86_64__)
+
+#define BITS_TO_U64S(NBITS) (((NBITS) + 63) / 64)
+
+/* Mask of the valid bits in the last word of an nbits bitmap */
+static inline __u64 last_word_mask(unsigned int nbits)
+{
+	return nbits % 64 ? (1ULL << (nbits % 64)) - 1 : ~0ULL;
+}
+
+/* Word loops. flip is zero to find a set bit or all ones to find a zero
+ * bit. These are inlined into the target specific kernels below so that
+ * ctz and popcount compile to tzcnt and popcnt
+ */
+
+static inline __attribute__((always_inline)) unsigned int find_words(
+		const __u64 *addr, unsigned int i, unsigned int nbits,
+		__u64 v, __u64 flip)
+{
+	unsigned int nwords = BITS_TO_U64S(nbits), pos;
+
+	for (;;) {
+		if (v) {
+			pos = i * 64 + __builtin_ctzll(v);
+			return pos < nbits ? pos : nbits;
+		}
+		if (++i >= nwords)
+			return nbits;
+		v = addr[i] ^ flip;
+	}
+}
+
+static inline __attribute__((always_inline)) unsigned int find_scalar(
+		const __u64 *addr, unsigned int pos, unsigned int nbits,
+		__u64 flip)
+{
+	unsigned int i = pos / 64;
+
+	if (pos >= nbits)
+		return nbits;
+
+	return find_words(addr, i, nbits,
+			  (addr[i] ^ flip) & (~0ULL << (pos % 64)), flip);
+}
+
+static inline __attribute__((always_inline)) unsigned int weight_words(
+		const __u64 *addr, unsigned int i, unsigned int nbits)
+{
+	unsigned int nwords = nbits / 64, w = 0;
+
+	for (; i < nwords; i++)
+		w += __builtin_popcountll(addr[i]);
+
+	if (nbits % 64)
+		w += __builtin_popcountll(addr[i] & last_word_mask(nbits));
+
+	return w;
+}
+
+#define BITMAP_LOGICAL_WORDS(NAME, EXPR)				\
+static inline __attribute__((always_inline)) void NAME(		\
+		__u64 *dest, const __u64 *src1, const __u64 *src2,	\
+		unsigned int i, unsigned int nbits)			\
+{									\
+	unsigned int nwords = nbits / 64;				\
+	__u64 mask;							\
+									\
+	for (; i < nwords; i++)						\
+		dest[i] = EXPR;						\
+									\
+	if (nbits % 64) {						\
+		mask = last_word_mask(nbits);				\
+		dest[i] = (dest[i] & ~mask) | ((EXPR) & mask);		\
+	}								\
+}
+
+BITMAP_LOGICAL_WORDS(and_words, src1[i] & src2[i])
+BITMAP_LOGICAL_WORDS(or_words, src1[i] | src2[i])
+BITMAP_LOGICAL_WORDS(and_not_words, src1[i] & ~src2[i])
+
+/* popcnt kernel */
+
+#define POPCNT_TARGET __attribute__((target("popcnt,bmi,lzcnt")))
+
+POPCNT_TARGET
+static unsigned int bitmap_find_popcnt(const unsigned long *addr,
+				       unsigned int pos, unsigned int nbits)
+{
+	return find_scalar((const __u64 *)addr, pos, nbits, 0);
+}
+
+POPCNT_TARGET
+static unsigned int bitmap_find_zero_popcnt(const unsigned long *addr,
+					    unsigned int pos,
+					    unsigned int nbits)
+{
+	return find_scalar((const __u64 *)addr, pos, nbits, ~0ULL);
+}
+
+POPCNT_TARGET
+static unsigned int bitmap_weight_popcnt(const unsigned long *addr,
+					 unsigned int nbits)
+{
+	return weight_words((const __u64 *)addr, 0, nbits);
+}
+
+POPCNT_TARGET
+static void bitmap_and_popcnt(unsigned long *dest, const unsigned long *src1,
+			      const unsigned long *src2, unsigned int nbits)
+{
+	and_words((__u64 *)dest, (const __u64 *)src1, (const __u64 *)src2,
+		  0, nbits);
+}
+
+POPCNT_TARGET
+static void bitmap_or_popcnt(unsigned long *dest, const unsigned long *src1,
+			     const unsigned long *src2, unsigned int nbits)
+{
+	or_words((__u64 *)dest, (const __u64 *)src1, (const __u64 *)src2,
+		 0, nbits);
+}
+
+POPCNT_TARGET
+static void bitmap_and_not_popcnt(unsigned long *dest,
+				  const unsigned long *src1,
+				  const unsigned long *src2,
+				  unsigned int nbits)
+{
+	and_not_words((__u64 *)dest, (const __u64 *)src1,
+		      (const __u64 *)src2, 0, nbits);
+}
+
+static bool bitmap_supported_popcnt(void)
+{
+	return __builtin_cpu_supports("popcnt") &&
+	       __builtin_cpu_supports("bmi") &&
+	       __builtin_cpu_supports("lzcnt");
+}
+
+/* AVX2 kernel */
+
+#define AVX2_TARGET __attribute__((target("avx2,popcnt,bmi,lzcnt")))
+
+/* Find from pos. The first (partial) word is checked by itself, then
+ * whole blocks of eight words that are all zero (or all ones for find
+ * zero) are skipped with vector tests, and the word loop finds the bit
+ */
+AVX2_TARGET
+static inline __attribute__((always_inline)) unsigned int find_avx2(
+		const __u64 *addr, unsigned int pos, unsigned int nbits,
+		__u64 flip)
+{
+	unsigned int i = pos / 64, nwords = BITS_TO_U64S(nbits);
+	__m256i ones = _mm256_set1_epi64x(-1);
+	__m256i v0, v1;
+	__u64 v;
+
+	if (pos >= nbits)
+		return nbits;
+
+	v = (addr[i] ^ flip) & (~0ULL << (pos % 64));
+	if (v)
+		return find_words(addr, i, nbits, v, flip);
+
+	for (i++; i + 8 <= nwords; i += 8) {
+		v0 = _mm256_loadu_si256((const __m256i *)&addr[i]);
+		v1 = _mm256_loadu_si256((const __m256i *)&addr[i + 4]);
+		if (flip) {
+			if (!_mm256_testc_si256(_mm256_and_si256(v0, v1),
+						ones))
+				break;
+		} else {
+			if (!_mm256_testz_si256(_mm256_or_si256(v0, v1),
+						_mm256_or_si256(v0, v1)))
+				break;
+		}
+	}
+
+	if (i >= nwords)
+		return nbits;
+
+	return find_words(addr, i, nbits, addr[i] ^ flip, flip);
+}
+
+AVX2_TARGET
+static unsigned int bitmap_find_avx2(const unsigned long *addr,
+				     unsigned int pos, unsigned int nbits)
+{
+	return find_avx2((const __u64 *)addr, pos, nbits, 0);
+}
+
+AVX2_TARGET
+static unsigned int bitmap_find_zero_avx2(const unsigned long *addr,
+					  unsigned int pos, unsigned int nbits)
+{
+	return find_avx2((const __u64 *)addr, pos, nbits, ~0ULL);
+}
+
+/* Count bits in each byte with two nibble lookups, sum bytes to sixty-four
+ * bit lanes with psadbw
+ */
+AVX2_TARGET
+static inline __m256i popcount_avx2(__m256i v)
+{
+	const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+					     1, 2, 2, 3, 2, 3, 3, 4,
+					     0, 1, 1, 2, 1, 2, 2, 3,
+					     1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low = _mm256_set1_epi8(0x0f);
+	__m256i lo, hi;
+
+	lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+	hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(
+					_mm256_srli_epi16(v, 4), low));
+
+	return _mm256_sad_epu8(_mm256_add_epi8(lo, hi),
+			       _mm256_setzero_si256());
+}
+
+AVX2_TARGET
+static unsigned int bitmap_weight_avx2(const unsigned long *laddr,
+				       unsigned int nbits)
+{
+	const __u64 *addr = (const __u64 *)laddr;
+	unsigned int i, nwords = nbits / 64;
+	__m256i acc0 = _mm256_setzero_si256();
+	__m256i acc1 = _mm256_setzero_si256();
+	__u64 lanes[4];
+
+	for (i = 0; i + 8 <= nwords; i += 8) {
+		acc0 = _mm256_add_epi64(acc0, popcount_avx2(
+			_mm256_loadu_si256((const __m256i *)&addr[i])));
+		acc1 = _mm256_add_epi64(acc1, popcount_avx2(
+			_mm256_loadu_si256((const __m256i *)&addr[i + 4])));
+	}
+
+	_mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+	       weight_words(addr, i, nbits);
+}
+
+#define BITMAP_LOGICAL_AVX2(NAME, VEXPR, WORDS)				\
+AVX2_TARGET								\
+static void NAME(unsigned long *ldest, const unsigned long *lsrc1,	\
+		 const unsigned long *lsrc2, unsigned int nbits)	\
+{									\
+	const __u64 *src1 = (const __u64 *)lsrc1;			\
+	const __u64 *src2 = (const __u64 *)lsrc2;			\
+	unsigned int i, nwords = nbits / 64;				\
+	__u64 *dest = (__u64 *)ldest;					\
+	__m256i a, b;							\
+									\
+	for (i = 0; i + 4 <= nwords; i += 4) {				\
+		a = _mm256_loadu_si256((const __m256i *)&src1[i]);	\
+		b = _mm256_loadu_si256((const __m256i *)&src2[i]);	\
+		_mm256_storeu_si256((__m256i *)&dest[i], VEXPR);	\
+	}								\
+									\
+	WORDS(dest, src1, src2, i, nbits);				\
+}
+
+BITMAP_LOGICAL_AVX2(bitmap_and_avx2, _mm256_and_si256(a, b), and_words)
+BITMAP_LOGICAL_AVX2(bitmap_or_avx2, _mm256_or_si256(a, b), or_words)
+BITMAP_LOGICAL_AVX2(bitmap_and_not_avx2, _mm256_andnot_si256(b, a),
+		    and_not_words)
+
+static bool bitmap_supported_avx2(void)
+{
+	return __builtin_cpu_supports("avx2") && bitmap_supported_popcnt();
+}
+
+#endif /* __x86_64__ */
+
+/* Kernels in order of preference, the first supported one is used */
+const struct xdp2_bitmap_kernel xdp2_bitmap_kernels[] = {
+#if defined(__x86_64__)
+	{ "avx2", bitmap_find_avx2, bitmap_find_zero_avx2, bitmap_weight_avx2,
+	  bitmap_and_avx2, bitmap_or_avx2, bitmap_and_not_avx2,
+	  bitmap_supported_avx2 },
+	{ "popcnt", bitmap_find_popcnt, bitmap_find_zero_popcnt,
+	  bitmap_weight_popcnt, bitmap_and_popcnt, bitmap_or_popcnt,
+	  bitmap_and_not_popcnt, bitmap_supported_popcnt },
+#endif
+	{ "generic", bitmap_find_generic, bitmap_find_zero_generic,
+	  bitmap_weight_generic, bitmap_and_generic, bitmap_or_generic,
+	  bitmap_and_not_generic, bitmap_supported_always },
+};
+
+const unsigned int xdp2_bitmap_num_kernels = ARRAY_SIZE(xdp2_bitmap_kernels);
+
+const struct xdp2_bitmap_kernel *xdp2_bitmap_kernel =
+		&xdp2_bitmap_kernels[ARRAY_SIZE(xdp2_bitmap_kernels) - 1];
+
+bool xdp2_bitmap_set_kernel(const char *name)
+{
+	const struct xdp2_bitmap_kernel *kernel;
+	unsigned int i;
+
+	for (i = 0; i < xdp2_bitmap_num_kernels; i++) {
+		kernel = &xdp2_bitmap_kernels[i];
+
+		if (strcmp(kernel->name, name))
+			continue;
+
+		if (!kernel->supported())
+			return false;
+
+		xdp2_bitmap_kernel = kernel;
+
+		return true;
+	}
+
+	return false;
+}
+
+static void __attribute__((constructor)) bitmap_select_kernel(void)
+{
+	unsigned int i;
+
+#if defined(__x86_64__)
+	/* Needed since constructors may run before the CPU model is set */
+	__builtin_cpu_init();
+#endif
+
+	for (i = 0; i < xdp2_bitmap_num_kernels; i++)
+		if (xdp2_bitmap_set_kernel(xdp2_bitmap_kernels[i].name))
+			return;
+}
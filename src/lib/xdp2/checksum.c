@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Checksum kernels and runtime selection
+ *
+ * The vector kernels zero extend each thirty-two bit word of a vector to
+ * sixty-four bits and add them into sixty-four bit lanes, so there are no
+ * carries to propagate until the lanes are added together at the end. A
+ * lane can take 2^32 additions before it could overflow, that is more than
+ * the maximum length of a checksummed buffer
+ */
+
+#include <string.h>
+
+#include "xdp2/checksum.h"
+#include "xdp2/utility.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+static __u64 checksum_partial_scalar(const void *src, size_t len)
+{
+	return __xdp2_checksum_partial_scalar(src, len);
+}
+
+static bool checksum_supported_always(void)
+{
+	return true;
+}
+
+#if defined(__x86_64__)
+
+/* SSE2 is part of x86_64 */
+static __u64 checksum_partial_sse2(const void *src, size_t len)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i acc0 = zero, acc1 = zero;
+	__m128i v0, v1;
+	__u64 lanes[2];
+
+	for (; len >= 32; len -= 32, src += 32) {
+		v0 = _mm_loadu_si128((const __m128i *)src);
+		v1 = _mm_loadu_si128((const __m128i *)(src + 16));
+		acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v0, zero));
+		acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v0, zero));
+		acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v1, zero));
+		acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v1, zero));
+	}
+
+	_mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+
+	return lanes[0] + lanes[1] +
+	       __xdp2_checksum_partial_scalar(src, len);
+}
+
+__attribute__((target("avx2")))
+static __u64 checksum_partial_avx2(const void *src, size_t len)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i acc0 = zero, acc1 = zero;
+	__m256i v0, v1;
+	__u64 lanes[4];
+
+	for (; len >= 64; len -= 64, src += 64) {
+		v0 = _mm256_loadu_si256((const __m256i *)src);
+		v1 = _mm256_loadu_si256((const __m256i *)(src + 32));
+		acc0 = _mm256_add_epi64(acc0,
+					_mm256_unpacklo_epi32(v0, zero));
+		acc1 = _mm256_add_epi64(acc1,
+					_mm256_unpackhi_epi32(v0, zero));
+		acc0 = _mm256_add_epi64(acc0,
+					_mm256_unpacklo_epi32(v1, zero));
+		acc1 = _mm256_add_epi64(acc1,
+					_mm256_unpackhi_epi32(v1, zero));
+	}
+
+	_mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+	       checksum_partial_sse2(src, len);
+}
+
+static bool checksum_supported_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx512f")))
+static __u64 checksum_partial_avx512(const void *src, size_t len)
+{
+	__m512i zero = _mm512_setzero_si512();
+	__m512i acc0 = zero, acc1 = zero;
+	__m512i v0, v1;
+
+	for (; len >= 128; len -= 128, src += 128) {
+		v0 = _mm512_loadu_si512(src);
+		v1 = _mm512_loadu_si512(src + 64);
+		acc0 = _mm512_add_epi64(acc0,
+					_mm512_unpacklo_epi32(v0, zero));
+		acc1 = _mm512_add_epi64(acc1,
+					_mm512_unpackhi_epi32(v0, zero));
+		acc0 = _mm512_add_epi64(acc0,
+					_mm512_unpacklo_epi32(v1, zero));
+		acc1 = _mm512_add_epi64(acc1,
+					_mm512_unpackhi_epi32(v1, zero));
+	}
+
+	return _mm512_reduce_add_epi64(_mm512_add_epi64(acc0, acc1)) +
+	       checksum_partial_avx2(src, len);
+}
+
+static bool checksum_supported_avx512(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+#endif /* __x86_64__ */
+
+/* Kernels in order of preference, the first supported one is used */
+const struct xdp2_checksum_kernel xdp2_checksum_kernels[] = {
+#if defined(__x86_64__)
+	{ "avx512", checksum_partial_avx512, checksum_supported_avx512 },
+	{ "avx2", checksum_partial_avx2, checksum_supported_avx2 },
+	{ "sse2", checksum_partial_sse2, checksum_supported_always },
+#endif
+	{ "scalar", checksum_partial_scalar, checksum_supported_always },
+};
+
+const unsigned int xdp2_checksum_num_kernels =
+					ARRAY_SIZE(xdp2_checksum_kernels);
+
+__u64 (*xdp2_checksum_partial_func)(const void *src, size_t len) =
+						checksum_partial_scalar;
+const char *xdp2_checksum_kernel_name = "scalar";
+
+bool xdp2_checksum_set_kernel(const char *name)
+{
+	const struct xdp2_checksum_kernel *kernel;
+	unsigned int i;
+
+	for (i = 0; i < xdp2_checksum_num_kernels; i++) {
+		kernel = &xdp2_checksum_kernels[i];
+
+		if (strcmp(kernel->name, name))
+			continue;
+
+		if (!kernel->supported())
+			return false;
+
+		xdp2_checksum_partial_func = kernel->partial;
+		xdp2_checksum_kernel_name = kernel->name;
+
+		return true;
+	}
+
+	return false;
+}
+
+static void __attribute__((constructor)) checksum_select_kernel(void)
+{
+	unsigned int i;
+
+#if defined(__x86_64__)
+	/* Needed since constructors may run before the CPU model is set */
+	__builtin_cpu_init();
+#endif
+
+	for (i = 0; i < xdp2_checksum_num_kernels; i++)
+		if (xdp2_checksum_set_kernel(xdp2_checksum_kernels[i].name))
+			return;
+}
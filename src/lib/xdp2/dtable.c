@@ -33,6 +33,7 @@
 
 #include "xdp2/cli.h"
 #include "xdp2/dtable.h"
+#include "xdp2/lpm_trie.h"
 
 /* Dynamic plain tables */
 
@@ -42,7 +43,39 @@ struct __xdp2_dtable_table_listhead plain_tables, lpm_tables, tern_tables;
 
 #define BASE_IDENT 1000000
 
-siphash_key_t siphash_key = { { 0x1234567890abcdef, 0xfedcba0987654321 } };
+/* Fixed key for hashing plain table keys. Tables are populated by the
+ * control plane so a random key isn't needed
+ */
+static struct xdp2_hash_key xdp2_dtable_hash_key = {
+	.siphash = { { 0x1234567890abcdef, 0xfedcba0987654321 } },
+	.seed = 0x1234567890abcdef,
+	.toeplitz = XDP2_HASH_TOEPLITZ_DEFAULT_KEY,
+};
+
+static struct xdp2_hash_toeplitz_tbl xdp2_dtable_toeplitz_tbl;
+
+/* Build the Toeplitz lookup tables the first time a table uses Toeplitz.
+ * Called from the control path before any lookups in the table
+ */
+static void xdp2_dtable_toeplitz_init(void)
+{
+	if (xdp2_dtable_hash_key.toeplitz_tbl)
+		return;
+
+	xdp2_hash_toeplitz_tbl_init(&xdp2_dtable_toeplitz_tbl,
+				    xdp2_dtable_hash_key.toeplitz);
+	xdp2_dtable_hash_key.toeplitz_tbl = &xdp2_dtable_toeplitz_tbl;
+}
+
+/* QSBR domain for lookups concurrent with updates (see xdp2/dtable.h) */
+XDP2_QSBR_DEFINE(xdp2_dtable_qsbr);
+
+/* Free memory that readers might still reference after a grace period */
+static void xdp2_dtable_defer_free(void *ptr)
+{
+	if (ptr)
+		xdp2_qsbr_call(&xdp2_dtable_qsbr, free, ptr);
+}
 
 /* Find a table. Arguments are:
  * - indent: A pointer to an identfier. If the value is zero then a table
@@ -166,6 +199,15 @@ static struct xdp2_dtable_table *xdp2_dtable_create(
 	table->entry_len = sizeof(struct xdp2_dtable_entry) +
 		target_len + all_key_len;
 	table->ident = *ident;
+	memset(&table->config, 0, sizeof(table->config));
+	table->config.size = -1U;
+	table->hash = NULL;
+	table->trie = NULL;
+	table->tss = NULL;
+	memset(&table->entry_ids, 0, sizeof(table->entry_ids));
+	table->id_index = NULL;
+	table->id_index_mask = 0;
+	table->num_entries = 0;
 
 	if (__xdp2_dtable_insert_table(table, ident, list_head))
 		return NULL;
@@ -173,260 +215,1423 @@ static struct xdp2_dtable_table *xdp2_dtable_create(
 	return table;
 }
 
+/* Entry identifiers
+ *
+ * An entry added with an identifier of zero is assigned the lowest unused
+ * identifier at or above BASE_IDENT. Each table tracks the identifiers in
+ * use from BASE_IDENT in an ID allocator (ID is identifier minus
+ * BASE_IDENT) so that assigning an identifier doesn't walk the entries
+ * list. The allocator starts at XDP2_DTABLE_MIN_IDS IDs and is doubled
+ * when it is full. Entries added with an explicit identifier in the
+ * automatic range are marked in the allocator if they're in its current
+ * range, else they're marked when the allocator grows to cover them.
+ *
+ * Entries are found by identifier in the table's identifier index, a hash
+ * table with chaining through id_next. This is constant time for both
+ * assigned and explicit identifiers. The index starts at
+ * XDP2_DTABLE_MIN_IDS buckets and is doubled when the number of entries
+ * exceeds the number of buckets. The index is only used by the control
+ * path. The entries list is not ordered by identifier
+ */
+
+#define XDP2_DTABLE_MIN_IDS	64
+#define XDP2_DTABLE_MAX_IDS	((unsigned int)INT_MAX - BASE_IDENT + 1)
+
+static inline bool xdp2_dtable_ident_tracked(struct xdp2_dtable_table *table,
+					     int ident)
+{
+	return ident >= BASE_IDENT &&
+	       (unsigned int)(ident - BASE_IDENT) < table->entry_ids.nbits;
+}
+
+/* Grow the identifier allocator of a table and mark the entries with
+ * explicit identifiers in the new range
+ */
+static int xdp2_dtable_grow_ids(struct xdp2_dtable_table *table)
+{
+	unsigned int nbits = table->entry_ids.nbits;
+	struct xdp2_dtable_entry *entry;
+	int err;
+
+	if (nbits >= XDP2_DTABLE_MAX_IDS)
+		return -ENOSPC;
+
+	nbits = nbits ? xdp2_min(2 * nbits, XDP2_DTABLE_MAX_IDS) :
+			XDP2_DTABLE_MIN_IDS;
+
+	err = xdp2_id_alloc_grow(&table->entry_ids, nbits);
+	if (err)
+		return err;
+
+	LIST_FOREACH(entry, &table->entries, list_ent)
+		if (xdp2_dtable_ident_tracked(table, entry->ident))
+			xdp2_id_alloc_set(&table->entry_ids,
+					  entry->ident - BASE_IDENT);
+
+	return 0;
+}
+
+static inline unsigned int xdp2_dtable_id_bucket(unsigned int mask,
+						 int ident)
+{
+	__u32 hash = (__u32)ident * 0x9e3779b1;
+
+	return (hash ^ (hash >> 16)) & mask;
+}
+
+/* Double the number of buckets in the identifier index of a table and
+ * rehash the entries
+ */
+static int xdp2_dtable_grow_id_index(struct xdp2_dtable_table *table)
+{
+	struct xdp2_dtable_entry **index, *entry, *next;
+	unsigned int nbuckets, i, b;
+
+	if (table->id_index_mask >= UINT_MAX / 2)
+		return -ENOSPC;
+
+	nbuckets = table->id_index ? 2 * (table->id_index_mask + 1) :
+				     XDP2_DTABLE_MIN_IDS;
+
+	index = calloc(nbuckets, sizeof(*index));
+	if (!index)
+		return -ENOMEM;
+
+	for (i = 0; table->id_index && i <= table->id_index_mask; i++) {
+		for (entry = table->id_index[i]; entry; entry = next) {
+			next = entry->id_next;
+			b = xdp2_dtable_id_bucket(nbuckets - 1, entry->ident);
+			entry->id_next = index[b];
+			index[b] = entry;
+		}
+	}
+
+	free(table->id_index);
+	table->id_index = index;
+	table->id_index_mask = nbuckets - 1;
+
+	return 0;
+}
+
+/* Return a pointer to the link to the entry with an identifier in the
+ * identifier index. The link is NULL if there's no such entry
+ */
+static struct xdp2_dtable_entry **xdp2_dtable_id_link(
+		struct xdp2_dtable_table *table, int ident)
+{
+	struct xdp2_dtable_entry **pentry;
+
+	pentry = &table->id_index[xdp2_dtable_id_bucket(table->id_index_mask,
+							ident)];
+	while (*pentry && (*pentry)->ident != ident)
+		pentry = &(*pentry)->id_next;
+
+	return pentry;
+}
+
 /* Find an entry by its identifier */
 static struct xdp2_dtable_entry *xdp2_dtable_find_ent_by_id(
 		struct xdp2_dtable_table *table, unsigned int ident)
+{
+	if (!table->id_index)
+		return NULL;
+
+	return *xdp2_dtable_id_link(table, ident);
+}
+
+/* Add an entry to a table. The entry is not visible to lookups until it's
+ * published with xdp2_dtable_publish
+ */
+static struct xdp2_dtable_entry *xdp2_dtable_add(
+		struct xdp2_dtable_table *table,
+		struct xdp2_dtable_entry *plentry,
+		int *ident, void *target)
 {
 	struct xdp2_dtable_entry *entry;
+	unsigned int id = 0;
 
-	LIST_FOREACH(entry, &table->entries, list_ent) {
-		if (entry->ident > ident)
-			break;
-		if (entry->ident == ident)
+	if (!table->id_index || table->num_entries > table->id_index_mask)
+		if (xdp2_dtable_grow_id_index(table))
+			return NULL;
+
+	if (*ident) {
+		if (xdp2_dtable_find_ent_by_id(table, *ident))
+			return NULL;
+	} else {
+		while ((id = xdp2_id_alloc_find_next_free(&table->entry_ids,
+				0)) >= table->entry_ids.nbits)
+			if (xdp2_dtable_grow_ids(table))
+				return NULL;
+	}
+
+	entry = malloc(table->entry_len);
+	if (!entry)
+		return NULL;
+
+	if (!*ident)
+		*ident = BASE_IDENT + id;
+
+	entry->ident = *ident;
+
+	if (xdp2_dtable_ident_tracked(table, *ident))
+		xdp2_id_alloc_set(&table->entry_ids, *ident - BASE_IDENT);
+
+	entry->id_next = NULL;
+	*xdp2_dtable_id_link(table, *ident) = entry;
+	table->num_entries++;
+
+	memcpy(XDP2_DTABLE_TARG(table, entry), target, table->targ_len);
+
+	LIST_INSERT_HEAD(&table->entries, entry, list_ent);
+
+	return entry;
+}
+
+/* Publish a new entry in the lookup list after its key is set. The entry
+ * is inserted after plentry, or at the head if plentry is NULL
+ */
+static void xdp2_dtable_publish(struct xdp2_dtable_table *table,
+				struct xdp2_dtable_entry *plentry,
+				struct xdp2_dtable_entry *entry)
+{
+	if (!plentry)
+		XDP2_LIST_INSERT_HEAD_RCU(&table->entries_lookup, entry,
+					  list_ent_lookup);
+	else
+		XDP2_LIST_INSERT_AFTER_RCU(plentry, entry, list_ent_lookup);
+}
+
+static void xdp2_dtable_tss_remove(struct xdp2_dtable_table *table,
+				   struct xdp2_dtable_tss *tss,
+				   struct xdp2_dtable_entry *entry);
+static void xdp2_dtable_tss_replace(struct xdp2_dtable_table *table,
+				    struct xdp2_dtable_entry *old,
+				    struct xdp2_dtable_entry *new);
+
+/* Delete an entry in a table */
+static void xdp2_dtable_del(struct xdp2_dtable_table *table,
+			     struct xdp2_dtable_entry *entry)
+{
+	if (table->tss)
+		xdp2_dtable_tss_remove(table, table->tss, entry);
+
+	LIST_REMOVE(entry, list_ent);
+	XDP2_LIST_REMOVE_RCU(entry, list_ent_lookup);
+
+	if (xdp2_dtable_ident_tracked(table, entry->ident))
+		xdp2_id_alloc_clear(&table->entry_ids,
+				    entry->ident - BASE_IDENT);
+
+	*xdp2_dtable_id_link(table, entry->ident) = entry->id_next;
+	table->num_entries--;
+
+	xdp2_dtable_defer_free(entry);
+}
+
+/* Delete an entry in a table by its identfier */
+static void xdp2_dtable_del_by_id(struct xdp2_dtable_table *table,
+				   unsigned int ident)
+{
+	struct xdp2_dtable_entry *entry;
+
+	entry = xdp2_dtable_find_ent_by_id(table, ident);
+	if (entry)
+		xdp2_dtable_del(table, entry);
+}
+
+static void xdp2_dtable_hash_replace(struct xdp2_dtable_table *table,
+				     struct xdp2_dtable_entry *old,
+				     struct xdp2_dtable_entry *new);
+
+/* Change the target of a table entry (change function or argument). The
+ * target isn't written in place since a concurrent lookup could see a
+ * partially written target. Instead a copy of the entry with the new
+ * target replaces the entry in the lists and the table's index
+ */
+static int xdp2_dtable_change(struct xdp2_dtable_table *table,
+			      struct xdp2_dtable_entry *entry,
+			      void *target)
+{
+	struct xdp2_lpm_entry_key *keyinfo;
+	struct xdp2_dtable_entry *nentry;
+
+	nentry = malloc(table->entry_len);
+	if (!nentry)
+		return -ENOMEM;
+
+	memcpy(nentry, entry, table->entry_len);
+	memcpy(XDP2_DTABLE_TARG(table, nentry), target, table->targ_len);
+
+	if (table->hash)
+		xdp2_dtable_hash_replace(table, entry, nentry);
+
+	if (table->trie) {
+		keyinfo = (struct xdp2_lpm_entry_key *)
+				XDP2_DTABLE_KEY(table, nentry);
+		xdp2_lpm_trie_replace(table->trie, keyinfo->key,
+				      keyinfo->prefix_len, nentry);
+	}
+
+	if (table->tss)
+		xdp2_dtable_tss_replace(table, entry, nentry);
+
+	*xdp2_dtable_id_link(table, entry->ident) = nentry;
+
+	LIST_INSERT_AFTER(entry, nentry, list_ent);
+	LIST_REMOVE(entry, list_ent);
+
+	XDP2_LIST_INSERT_AFTER_RCU(entry, nentry, list_ent_lookup);
+	XDP2_LIST_REMOVE_RCU(entry, list_ent_lookup);
+
+	xdp2_dtable_defer_free(entry);
+
+	return 0;
+}
+
+/* Change a table entry by its identfier */
+static int xdp2_dtable_change_by_id(struct xdp2_dtable_table *table,
+				     unsigned int ident, void *target)
+{
+	struct xdp2_dtable_entry *entry;
+
+	entry = xdp2_dtable_find_ent_by_id(table, ident);
+	if (!entry)
+		return -ENOENT;
+
+	return xdp2_dtable_change(table, entry, target);
+}
+
+/* Create a dynamic plain table */
+struct xdp2_dtable_plain_table *xdp2_dtable_create_plain(
+		const char *name, size_t key_len, void *default_target,
+		size_t target_len, int *ident)
+{
+	return (struct xdp2_dtable_plain_table *)
+	    xdp2_dtable_create(name, key_len,
+			key_len + sizeof(struct xdp2_plain_entry_key), ident,
+			sizeof(struct xdp2_dtable_plain_table),
+			default_target, target_len, &plain_tables);
+}
+
+/* Hash index for plain tables
+ *
+ * Plain tables are indexed by a bucketized cuckoo hash table. Each bucket
+ * is one cache line holding XDP2_DTABLE_HASH_BUCKET_ENTS entry pointers
+ * along with a 16-bit signature for each entry taken from the key hash, so
+ * a lookup only dereferences entries whose signature matches. An entry
+ * resides in one of two buckets: the primary bucket is selected by the low
+ * order bits of the hash and the alternate bucket is derived from the
+ * primary bucket and the signature, so entries can be moved between their
+ * two buckets without rehashing the key. A lookup probes at most two
+ * cache lines.
+ *
+ * The index is doubled in size when the load exceeds
+ * XDP2_DTABLE_HASH_MAX_LOAD percent or a cuckoo displacement path fails,
+ * and is halved when the load drops below XDP2_DTABLE_HASH_MIN_LOAD
+ * percent. The index is rebuilt from the table's entries list on resize
+ */
+
+#define XDP2_DTABLE_HASH_BUCKET_ENTS	6
+#define XDP2_DTABLE_HASH_MIN_BUCKETS	16
+#define XDP2_DTABLE_HASH_MAX_LOAD	90
+#define XDP2_DTABLE_HASH_MIN_LOAD	20
+#define XDP2_DTABLE_HASH_MAX_KICKS	128
+
+struct xdp2_dtable_hash_bucket {
+	__u16 sigs[XDP2_DTABLE_HASH_BUCKET_ENTS];
+	struct xdp2_dtable_entry *entries[XDP2_DTABLE_HASH_BUCKET_ENTS];
+} __aligned(XDP2_CACHELINE_SIZE);
+
+XDP2_BUILD_BUG_ON(sizeof(struct xdp2_dtable_hash_bucket) ==
+		  XDP2_CACHELINE_SIZE);
+
+/* Concurrent lookups
+ *
+ * An entry is put in a free slot by setting the signature and then
+ * storing the entry pointer, and is removed by clearing the pointer, so a
+ * lookup sees a slot either with or without the entry. A cuckoo
+ * displacement moves entries between buckets and a lookup could miss an
+ * entry that's being moved, so displacements are bracketed by the seq
+ * counter (odd while displacing) and a lookup that misses retries if seq
+ * changed. A resized index is built off to the side and replaces the old
+ * one with a pointer store, and the old index is freed after a grace
+ * period
+ */
+struct xdp2_dtable_hash {
+	unsigned int mask;	/* Number of buckets - 1 */
+	unsigned int count;	/* Number of entries in the index */
+	unsigned int seq;	/* Displacement sequence counter */
+	struct xdp2_dtable_hash_bucket buckets[];
+};
+
+static inline struct xdp2_dtable_entry *xdp2_dtable_hash_get_slot(
+		struct xdp2_dtable_hash_bucket *bucket, unsigned int slot)
+{
+	return __atomic_load_n(&bucket->entries[slot], __ATOMIC_ACQUIRE);
+}
+
+static inline void xdp2_dtable_hash_set_slot(
+		struct xdp2_dtable_hash_bucket *bucket, unsigned int slot,
+		struct xdp2_dtable_entry *entry, __u16 sig)
+{
+	__atomic_store_n(&bucket->sigs[slot], sig, __ATOMIC_RELAXED);
+	__atomic_store_n(&bucket->entries[slot], entry, __ATOMIC_RELEASE);
+}
+
+static inline __u16 xdp2_dtable_hash_sig(__u64 hash)
+{
+	return hash >> 48;
+}
+
+/* Get the other bucket for an entry given one of its buckets. Note that
+ * the function is its own inverse and, since the xor'ed value is odd, the
+ * two buckets are always different
+ */
+static inline unsigned int xdp2_dtable_hash_alt(struct xdp2_dtable_hash *h,
+						unsigned int bucket, __u16 sig)
+{
+	return (bucket ^ ((sig * 0x5bd1e995U) | 1)) & h->mask;
+}
+
+static inline unsigned int xdp2_dtable_hash_capacity(
+		struct xdp2_dtable_hash *h)
+{
+	return (h->mask + 1) * XDP2_DTABLE_HASH_BUCKET_ENTS;
+}
+
+/* Minimum number of buckets for a table. This is the larger of
+ * XDP2_DTABLE_HASH_MIN_BUCKETS and the size hint in the table configuration
+ */
+static unsigned int xdp2_dtable_hash_min_buckets(
+		struct xdp2_dtable_table *table)
+{
+	unsigned int num = XDP2_DTABLE_HASH_MIN_BUCKETS;
+	size_t want;
+
+	if (table->config.size == -1U || !table->config.size)
+		return num;
+
+	want = (table->config.size * 100) /
+		(XDP2_DTABLE_HASH_MAX_LOAD * XDP2_DTABLE_HASH_BUCKET_ENTS) + 1;
+
+	while (num < want && num < (1U << 30))
+		num <<= 1;
+
+	return num;
+}
+
+static struct xdp2_dtable_hash *xdp2_dtable_hash_alloc(
+		unsigned int num_buckets)
+{
+	struct xdp2_dtable_hash *h;
+	size_t size;
+
+	size = sizeof(*h) + num_buckets * sizeof(h->buckets[0]);
+
+	h = aligned_alloc(XDP2_CACHELINE_SIZE, size);
+	if (!h)
+		return NULL;
+
+	memset(h, 0, size);
+	h->mask = num_buckets - 1;
+
+	return h;
+}
+
+/* Find an entry with a matching key in a hash index. Return the entry
+ * and optionally its bucket and slot, or NULL if the key is not present
+ */
+static struct xdp2_dtable_entry *xdp2_dtable_hash_find(
+		struct xdp2_dtable_table *table, struct xdp2_dtable_hash *h,
+		const void *key, __u64 hash,
+		struct xdp2_dtable_hash_bucket **pbucket, unsigned int *pslot)
+{
+	__u16 sig = xdp2_dtable_hash_sig(hash);
+	unsigned int b = hash & h->mask;
+	unsigned int alt = xdp2_dtable_hash_alt(h, b, sig);
+	struct xdp2_dtable_hash_bucket *bucket;
+	int i, j;
+
+	__builtin_prefetch(&h->buckets[alt]);
+
+	for (i = 0; i < 2; i++, b = alt) {
+		bucket = &h->buckets[b];
+		for (j = 0; j < XDP2_DTABLE_HASH_BUCKET_ENTS; j++) {
+			struct xdp2_dtable_entry *entry =
+					xdp2_dtable_hash_get_slot(bucket, j);
+			struct xdp2_plain_entry_key *keyinfo;
+
+			if (!entry ||
+			    __atomic_load_n(&bucket->sigs[j],
+					    __ATOMIC_RELAXED) != sig)
+				continue;
+
+			keyinfo = (struct xdp2_plain_entry_key *)
+					XDP2_DTABLE_KEY(table, entry);
+
+			if (keyinfo->hash == hash &&
+			    xdp2_compare_equal(keyinfo->key, key,
+					       table->key_len)) {
+				if (pbucket)
+					*pbucket = bucket;
+				if (pslot)
+					*pslot = j;
+				return entry;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/* Lookup that may run concurrently with updates. If the key isn't found
+ * and entries were displaced during the lookup then the lookup is retried
+ */
+static struct xdp2_dtable_entry *xdp2_dtable_hash_lookup(
+		struct xdp2_dtable_table *table, const void *key, __u64 hash)
+{
+	struct xdp2_dtable_hash *h = xdp2_rcu_dereference(table->hash);
+	struct xdp2_dtable_entry *entry;
+	unsigned int seq;
+
+	if (!h)
+		return NULL;
+
+	do {
+		seq = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+
+		entry = xdp2_dtable_hash_find(table, h, key, hash, NULL, NULL);
+		if (entry)
 			return entry;
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) ||
+		 seq != __atomic_load_n(&h->seq, __ATOMIC_RELAXED));
+
+	return NULL;
+}
+
+/* Put an entry in a free slot of a bucket. Returns false if the bucket
+ * is full
+ */
+static bool xdp2_dtable_hash_bucket_insert(
+		struct xdp2_dtable_hash_bucket *bucket,
+		struct xdp2_dtable_entry *entry, __u16 sig)
+{
+	int i;
+
+	for (i = 0; i < XDP2_DTABLE_HASH_BUCKET_ENTS; i++) {
+		if (!bucket->entries[i]) {
+			xdp2_dtable_hash_set_slot(bucket, i, entry, sig);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Insert an entry into a hash index. If both candidate buckets are full
+ * then entries are displaced to their alternate buckets along a cuckoo
+ * path. If no path is found within XDP2_DTABLE_HASH_MAX_KICKS then the
+ * displacements are undone and -ENOSPC is returned
+ */
+static int __xdp2_dtable_hash_insert(struct xdp2_dtable_hash *h,
+				     struct xdp2_dtable_entry *entry,
+				     __u64 hash)
+{
+	struct {
+		unsigned int bucket;
+		unsigned int slot;
+	} path[XDP2_DTABLE_HASH_MAX_KICKS];
+	__u16 sig = xdp2_dtable_hash_sig(hash);
+	unsigned int b = hash & h->mask;
+	unsigned int slot = hash % XDP2_DTABLE_HASH_BUCKET_ENTS;
+	struct xdp2_dtable_hash_bucket *bucket;
+	struct xdp2_dtable_entry *victim;
+	__u16 vsig;
+	int i;
+
+	if (xdp2_dtable_hash_bucket_insert(&h->buckets[b], entry, sig) ||
+	    xdp2_dtable_hash_bucket_insert(
+			&h->buckets[xdp2_dtable_hash_alt(h, b, sig)],
+			entry, sig)) {
+		h->count++;
+		return 0;
+	}
+
+	/* Start displacing, seq is odd */
+	__atomic_store_n(&h->seq, h->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for (i = 0; i < XDP2_DTABLE_HASH_MAX_KICKS; i++) {
+		bucket = &h->buckets[b];
+		path[i].bucket = b;
+		path[i].slot = slot;
+
+		victim = bucket->entries[slot];
+		vsig = bucket->sigs[slot];
+		xdp2_dtable_hash_set_slot(bucket, slot, entry, sig);
+
+		entry = victim;
+		sig = vsig;
+		b = xdp2_dtable_hash_alt(h, b, sig);
+
+		if (xdp2_dtable_hash_bucket_insert(&h->buckets[b], entry,
+						   sig)) {
+			h->count++;
+			__atomic_store_n(&h->seq, h->seq + 1,
+					 __ATOMIC_RELEASE);
+			return 0;
+		}
+
+		slot = (slot + 1) % XDP2_DTABLE_HASH_BUCKET_ENTS;
+	}
+
+	/* Undo the displacements so the index is left unchanged */
+	for (i--; i >= 0; i--) {
+		bucket = &h->buckets[path[i].bucket];
+
+		victim = bucket->entries[path[i].slot];
+		vsig = bucket->sigs[path[i].slot];
+		xdp2_dtable_hash_set_slot(bucket, path[i].slot, entry, sig);
+
+		entry = victim;
+		sig = vsig;
+	}
+
+	__atomic_store_n(&h->seq, h->seq + 1, __ATOMIC_RELEASE);
+
+	return -ENOSPC;
+}
+
+/* Rebuild the hash index for a plain table with the given number of
+ * buckets. If the entries don't fit then the number of buckets is doubled
+ * and the rebuild is retried. The old index is only replaced on success,
+ * and is freed after a grace period
+ */
+static int xdp2_dtable_hash_rebuild(struct xdp2_dtable_table *table,
+				    unsigned int num_buckets)
+{
+	struct xdp2_dtable_entry *entry;
+	struct xdp2_dtable_hash *h;
+
+	for (; num_buckets && num_buckets <= (1U << 30); num_buckets <<= 1) {
+		h = xdp2_dtable_hash_alloc(num_buckets);
+		if (!h)
+			return -ENOMEM;
+
+		LIST_FOREACH(entry, &table->entries, list_ent) {
+			struct xdp2_plain_entry_key *keyinfo =
+				(struct xdp2_plain_entry_key *)
+					XDP2_DTABLE_KEY(table, entry);
+
+			if (__xdp2_dtable_hash_insert(h, entry,
+						      keyinfo->hash))
+				break;
+		}
+
+		if (!entry) {
+			xdp2_dtable_defer_free(table->hash);
+			xdp2_rcu_assign_pointer(table->hash, h);
+			return 0;
+		}
+
+		free(h);
+	}
+
+	return -ENOSPC;
+}
+
+/* Add an entry to the hash index of a plain table. The entry must already
+ * be in the table's entries list. The index is created on first insertion
+ * and grown as needed
+ */
+static int xdp2_dtable_hash_insert(struct xdp2_dtable_table *table,
+				   struct xdp2_dtable_entry *entry,
+				   __u64 hash)
+{
+	struct xdp2_dtable_hash *h = table->hash;
+
+	if (!h)
+		return xdp2_dtable_hash_rebuild(table,
+					xdp2_dtable_hash_min_buckets(table));
+
+	if ((h->count + 1) * 100 >
+	    xdp2_dtable_hash_capacity(h) * XDP2_DTABLE_HASH_MAX_LOAD)
+		return xdp2_dtable_hash_rebuild(table, (h->mask + 1) << 1);
+
+	if (__xdp2_dtable_hash_insert(h, entry, hash))
+		return xdp2_dtable_hash_rebuild(table, (h->mask + 1) << 1);
+
+	return 0;
+}
+
+/* Remove an entry from the hash index of a plain table. The index is
+ * shrunk if the load falls below XDP2_DTABLE_HASH_MIN_LOAD percent
+ */
+static void xdp2_dtable_hash_remove(struct xdp2_dtable_table *table,
+				    struct xdp2_dtable_entry *entry)
+{
+	struct xdp2_plain_entry_key *keyinfo =
+		(struct xdp2_plain_entry_key *)XDP2_DTABLE_KEY(table, entry);
+	struct xdp2_dtable_hash *h = table->hash;
+	__u16 sig = xdp2_dtable_hash_sig(keyinfo->hash);
+	unsigned int b = keyinfo->hash & h->mask;
+	struct xdp2_dtable_hash_bucket *bucket;
+	int i, j;
+
+	for (i = 0; i < 2; i++, b = xdp2_dtable_hash_alt(h, b, sig)) {
+		bucket = &h->buckets[b];
+		for (j = 0; j < XDP2_DTABLE_HASH_BUCKET_ENTS; j++) {
+			if (bucket->entries[j] == entry) {
+				__atomic_store_n(&bucket->entries[j], NULL,
+						 __ATOMIC_RELAXED);
+				h->count--;
+				return;
+			}
+		}
+	}
+}
+
+/* Replace an entry in the hash index of a plain table with a copy that
+ * has the same key
+ */
+static void xdp2_dtable_hash_replace(struct xdp2_dtable_table *table,
+				     struct xdp2_dtable_entry *old,
+				     struct xdp2_dtable_entry *new)
+{
+	struct xdp2_plain_entry_key *keyinfo =
+		(struct xdp2_plain_entry_key *)XDP2_DTABLE_KEY(table, old);
+	struct xdp2_dtable_hash_bucket *bucket;
+	unsigned int slot;
+
+	if (xdp2_dtable_hash_find(table, table->hash, keyinfo->key,
+				  keyinfo->hash, &bucket, &slot) == old)
+		__atomic_store_n(&bucket->entries[slot], new,
+				 __ATOMIC_RELEASE);
+}
+
+/* Shrink the hash index of a plain table if the load has fallen below
+ * XDP2_DTABLE_HASH_MIN_LOAD percent. This is best effort, on failure the
+ * current index is kept
+ */
+static void xdp2_dtable_hash_shrink(struct xdp2_dtable_table *table)
+{
+	struct xdp2_dtable_hash *h = table->hash;
+
+	if (h->mask + 1 > xdp2_dtable_hash_min_buckets(table) &&
+	    h->count * 100 <
+			xdp2_dtable_hash_capacity(h) * XDP2_DTABLE_HASH_MIN_LOAD)
+		xdp2_dtable_hash_rebuild(table, (h->mask + 1) >> 1);
+}
+
+/* Compute the hash of a key in a plain table. The signature is taken from
+ * the high order bits so the 32-bit Toeplitz hash is spread over the word
+ * with a multiply, which keeps the low order bits distinct
+ */
+static inline __u64 xdp2_dtable_key_hash(
+		struct xdp2_dtable_plain_table *table, const void *key)
+{
+	__u64 hash = xdp2_hash(table->config.hash_algo, key, table->key_len,
+			       &xdp2_dtable_hash_key);
+
+	if (table->config.hash_algo == XDP2_HASH_TOEPLITZ)
+		hash *= XDP2_HASH_PRIME64_1;
+
+	return hash;
+}
+
+/* Find a matching entry by key for a plain table and return it. Also
+ * return the computed hash for insertion
+ */
+static struct xdp2_dtable_entry *__xdp2_dtable_find_plain(
+		struct xdp2_dtable_plain_table *table, const void *key,
+		__u64 *_hash)
+{
+	__u64 hash;
+
+	hash = xdp2_dtable_key_hash(table, key);
+	if (_hash)
+		*_hash = hash;
+
+	if (!table->hash)
+		return NULL;
+
+	return xdp2_dtable_hash_find((struct xdp2_dtable_table *)table,
+				     table->hash, key, hash, NULL, NULL);
+}
+
+/* Remove an entry from a plain table and its hash index */
+static void xdp2_dtable_del_plain_entry(struct xdp2_dtable_table *table,
+					struct xdp2_dtable_entry *entry)
+{
+	xdp2_dtable_hash_remove(table, entry);
+	xdp2_dtable_del(table, entry);
+	xdp2_dtable_hash_shrink(table);
+}
+
+/* Add an entry to a plain table */
+int xdp2_dtable_add_plain(struct xdp2_dtable_plain_table *table,
+		int ident, const void *key, void *target)
+{
+	struct xdp2_dtable_entry *entry;
+	struct xdp2_plain_entry_key *keyinfo;
+	__u64 hash;
+
+	if (__xdp2_dtable_find_plain(table, key, &hash))
+		return -EALREADY;
+
+	entry = xdp2_dtable_add((struct xdp2_dtable_table *)table,
+				 NULL, &ident, target);
+	if (!entry)
+		return -ENOMEM;
+
+	keyinfo = (struct xdp2_plain_entry_key *)
+			XDP2_DTABLE_KEY(table, entry);
+	keyinfo->hash = hash;
+	memcpy(keyinfo->key, key, table->key_len);
+
+	xdp2_dtable_publish((struct xdp2_dtable_table *)table, NULL, entry);
+
+	if (xdp2_dtable_hash_insert((struct xdp2_dtable_table *)table,
+				    entry, hash)) {
+		xdp2_dtable_del((struct xdp2_dtable_table *)table, entry);
+		return -ENOMEM;
+	}
+
+	return ident;
+}
+
+/* Delete an entry from a plain table */
+void xdp2_dtable_del_plain(struct xdp2_dtable_plain_table *ptable,
+			    const void *key)
+{
+	struct xdp2_dtable_entry *entry;
+
+	entry = __xdp2_dtable_find_plain(ptable, key, NULL);
+	if (entry)
+		xdp2_dtable_del_plain_entry(
+			(struct xdp2_dtable_table *)ptable, entry);
+}
+
+/* Delete an entry from a plain table by its identifier */
+void xdp2_dtable_del_plain_by_id(struct xdp2_dtable_plain_table *ptable,
+				  int ident)
+{
+	struct xdp2_dtable_entry *entry;
+
+	entry = xdp2_dtable_find_ent_by_id((struct xdp2_dtable_table *)ptable,
+					   ident);
+	if (entry)
+		xdp2_dtable_del_plain_entry(
+			(struct xdp2_dtable_table *)ptable, entry);
+}
+
+/* Change an entry in a plain table */
+int xdp2_dtable_change_plain(struct xdp2_dtable_plain_table *ptable,
+			      const void *key, void *target)
+{
+	struct xdp2_dtable_entry *entry;
+
+	entry = __xdp2_dtable_find_plain(ptable, key, NULL);
+	if (!entry)
+		return -ENOENT;
+
+	return xdp2_dtable_change((struct xdp2_dtable_table *)ptable,
+				  entry, target);
+}
+
+/* Change an entry in a plain table by its identifier*/
+int xdp2_dtable_change_plain_by_id(struct xdp2_dtable_plain_table *ptable,
+				    int ident, void *target)
+{
+	return xdp2_dtable_change_by_id((struct xdp2_dtable_table *)ptable,
+					 ident, target);
+
+	return 0;
+}
+
+/* Perform a lookup in a plain table */
+const void *xdp2_dtable_lookup_plain(struct xdp2_dtable_plain_table *table,
+				      const void *key)
+{
+	struct xdp2_dtable_entry *entry;
+
+	if (!xdp2_rcu_dereference(table->hash))
+		return table->default_target;
+
+	entry = xdp2_dtable_hash_lookup((struct xdp2_dtable_table *)table,
+					key, xdp2_dtable_key_hash(table, key));
+
+	return entry ? XDP2_DTABLE_TARG(table, entry) : table->default_target;
+}
+
+/* Set the hash algorithm of a plain table */
+int xdp2_dtable_set_hash_algo(struct xdp2_dtable_plain_table *table,
+			      enum xdp2_hash_algo algo)
+{
+	if ((unsigned int)algo >= __XDP2_HASH_MAX)
+		return -EINVAL;
+
+	/* Entries and the hash index hold hashes computed with the current
+	 * algorithm
+	 */
+	if (!LIST_EMPTY(&table->entries))
+		return -EBUSY;
+
+	if (algo == XDP2_HASH_TOEPLITZ)
+		xdp2_dtable_toeplitz_init();
+
+	table->config.hash_algo = algo;
+
+	return 0;
+}
+
+/* Tuple space search for ternary tables
+ *
+ * Entries are grouped into subtables by key mask. A subtable is a hash
+ * table of the masked keys of its entries, so a lookup masks the key with
+ * the mask of each subtable and does one hash probe per subtable instead
+ * of comparing the key with every entry. Each entry has a priority made
+ * from its position and an insertion sequence number, so that entries
+ * with the same position are ordered by insertion like in the lookup
+ * list. Hash chains are sorted by priority, and subtables are visited in
+ * order of their best priority so that a lookup stops as soon as no
+ * remaining subtable can hold a better match.
+ *
+ * The ordered list of subtables is an array that is never modified, it's
+ * replaced when a subtable is added or removed or the best priority of a
+ * subtable changes. Hash chains are updated with single pointer stores and
+ * a subtable is resized by making a copy, so lookups can run concurrently
+ * with updates like for the other table types
+ */
+
+#define XDP2_DTABLE_TSS_MAX_KEY_LEN	64
+#define XDP2_DTABLE_TSS_MIN_BUCKETS	16
+
+struct xdp2_dtable_tss_node {
+	struct xdp2_dtable_tss_node *next;
+	struct xdp2_dtable_entry *entry;
+	__u64 prio;
+	__u8 key[];		/* Masked key */
+};
+
+struct xdp2_dtable_tss_subtable {
+	unsigned int mask;	/* Number of buckets - 1 */
+	unsigned int count;	/* Number of entries in the subtable */
+	__u8 *key_mask;		/* Follows the buckets */
+	struct xdp2_dtable_tss_node *buckets[];
+};
+
+struct xdp2_dtable_tss_ref {
+	__u64 min_prio;		/* Best priority in the subtable */
+	struct xdp2_dtable_tss_subtable *st;
+};
+
+struct xdp2_dtable_tss_refs {
+	unsigned int num;
+	struct xdp2_dtable_tss_ref refs[];
+};
+
+struct xdp2_dtable_tss {
+	struct xdp2_dtable_tss_refs *refs;
+	__u32 seq;		/* Insertion sequence number */
+};
+
+/* Mask a key and hash the masked key. This is done once per subtable in
+ * a lookup so it works on eight bytes at a time and uses a multiplicative
+ * hash instead of SipHash. Keys in the index are set by the control plane,
+ * so a keyed hash isn't needed to resist collision attacks
+ */
+static inline __u64 xdp2_dtable_tss_mask_hash(__u8 *mkey, const __u8 *key,
+					      const __u8 *key_mask,
+					      size_t len)
+{
+	__u64 hash = len, k, m;
+	size_t i;
+
+	for (i = 0; i + sizeof(k) <= len; i += sizeof(k)) {
+		memcpy(&k, key + i, sizeof(k));
+		memcpy(&m, key_mask + i, sizeof(m));
+		k &= m;
+		memcpy(mkey + i, &k, sizeof(k));
+		hash = (hash ^ k) * 0x9e3779b97f4a7c15ULL;
+	}
+
+	if (i < len) {
+		for (k = 0; i < len; i++) {
+			mkey[i] = key[i] & key_mask[i];
+			k = (k << 8) | mkey[i];
+		}
+		hash = (hash ^ k) * 0x9e3779b97f4a7c15ULL;
 	}
 
+	/* Mix the high bits into the low bits used for the bucket index */
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+static inline __u64 xdp2_dtable_tss_prio(struct xdp2_dtable_table *table,
+					 struct xdp2_dtable_entry *entry,
+					 __u32 seq)
+{
+	struct xdp2_tern_entry_key *keyinfo =
+		(struct xdp2_tern_entry_key *)XDP2_DTABLE_KEY(table, entry);
+
+	return ((__u64)keyinfo->pos << 32) | seq;
+}
+
+static struct xdp2_dtable_tss_subtable *xdp2_dtable_tss_subtable_alloc(
+		struct xdp2_dtable_table *table, unsigned int num_buckets,
+		const __u8 *key_mask)
+{
+	struct xdp2_dtable_tss_subtable *st;
+
+	st = calloc(1, sizeof(*st) + num_buckets * sizeof(st->buckets[0]) +
+		       table->key_len);
+	if (!st)
+		return NULL;
+
+	st->mask = num_buckets - 1;
+	st->key_mask = (__u8 *)&st->buckets[num_buckets];
+	memcpy(st->key_mask, key_mask, table->key_len);
+
+	return st;
+}
+
+/* Best priority in a subtable, each hash chain is sorted so only the
+ * heads need to be checked
+ */
+static __u64 xdp2_dtable_tss_min_prio(struct xdp2_dtable_tss_subtable *st)
+{
+	__u64 min_prio = -1ULL;
+	unsigned int i;
+
+	for (i = 0; i <= st->mask; i++)
+		if (st->buckets[i] && st->buckets[i]->prio < min_prio)
+			min_prio = st->buckets[i]->prio;
+
+	return min_prio;
+}
+
+/* Find the subtable for a key mask */
+static struct xdp2_dtable_tss_ref *xdp2_dtable_tss_find_ref(
+		struct xdp2_dtable_table *table, struct xdp2_dtable_tss *tss,
+		const __u8 *key_mask)
+{
+	struct xdp2_dtable_tss_refs *refs = tss->refs;
+	unsigned int i;
+
+	if (!refs)
+		return NULL;
+
+	for (i = 0; i < refs->num; i++)
+		if (xdp2_compare_equal(refs->refs[i].st->key_mask, key_mask,
+				       table->key_len))
+			return &refs->refs[i];
+
 	return NULL;
 }
 
-/* Add an entry to a table */
-static struct xdp2_dtable_entry *xdp2_dtable_add(
-		struct xdp2_dtable_table *table,
-		struct xdp2_dtable_entry *plentry,
-		int *ident, void *target)
+/* Replace the subtable list with a new one where old_st is replaced by
+ * new_st. If old_st is NULL then new_st is added, if new_st is NULL then
+ * old_st is removed. The best priority of new_st is recomputed and the
+ * list is sorted by best priority
+ */
+static int xdp2_dtable_tss_update_refs(struct xdp2_dtable_tss *tss,
+				       struct xdp2_dtable_tss_subtable *old_st,
+				       struct xdp2_dtable_tss_subtable *new_st)
 {
-	struct xdp2_dtable_entry  *entry, *pentry = NULL;
-	int want_ident = BASE_IDENT;
+	struct xdp2_dtable_tss_refs *old = tss->refs, *refs;
+	unsigned int num = old ? old->num : 0, i, j;
+	struct xdp2_dtable_tss_ref ref;
 
-	LIST_FOREACH(entry, &table->entries, list_ent) {
-		if (*ident) {
-			if (entry->ident == *ident)
-				return NULL;
-			if (entry->ident > *ident)
-				break;
-		} else {
-			if (entry->ident < BASE_IDENT)
+	refs = malloc(sizeof(*refs) + (num + 1) * sizeof(refs->refs[0]));
+	if (!refs)
+		return -ENOMEM;
+
+	for (i = 0, j = 0; i < num; i++) {
+		if (old->refs[i].st == old_st) {
+			if (!new_st)
 				continue;
-			if (entry->ident != want_ident) {
-				*ident = want_ident;
-				break;
-			}
-			want_ident++;
+			refs->refs[j].st = new_st;
+			refs->refs[j].min_prio =
+					xdp2_dtable_tss_min_prio(new_st);
+		} else {
+			refs->refs[j] = old->refs[i];
 		}
-		pentry = entry;
+		j++;
 	}
 
-	if (want_ident < 0)
-		return NULL;
-
-	entry = malloc(table->entry_len);
-	if (!entry)
-		return NULL;
-
-	if (!*ident)
-		*ident = want_ident;
-
-	entry->ident = *ident;
+	if (!old_st) {
+		refs->refs[j].st = new_st;
+		refs->refs[j].min_prio = xdp2_dtable_tss_min_prio(new_st);
+		j++;
+	}
 
-	memcpy(XDP2_DTABLE_TARG(table, entry), target, table->targ_len);
+	refs->num = j;
 
-	if (!pentry)
-		LIST_INSERT_HEAD(&table->entries, entry, list_ent);
-	else
-		LIST_INSERT_AFTER(pentry, entry, list_ent);
+	/* Insertion sort, the list is nearly sorted */
+	for (i = 1; i < refs->num; i++) {
+		ref = refs->refs[i];
+		for (j = i; j > 0 && refs->refs[j - 1].min_prio >
+						ref.min_prio; j--)
+			refs->refs[j] = refs->refs[j - 1];
+		refs->refs[j] = ref;
+	}
 
-	if (!plentry)
-		LIST_INSERT_HEAD(&table->entries_lookup, entry,
-				 list_ent_lookup);
-	else
-		LIST_INSERT_AFTER(plentry, entry, list_ent_lookup);
+	xdp2_rcu_assign_pointer(tss->refs, refs);
+	xdp2_dtable_defer_free(old);
 
-	return entry;
+	return 0;
 }
 
-/* Delete an entry in a table */
-static void xdp2_dtable_del(struct xdp2_dtable_table *table,
-			     struct xdp2_dtable_entry *entry)
+/* Link a node into its hash chain in priority order */
+static void xdp2_dtable_tss_link(struct xdp2_dtable_table *table,
+				 struct xdp2_dtable_tss_subtable *st,
+				 struct xdp2_dtable_tss_node *node)
 {
-	LIST_REMOVE(entry, list_ent);
-	LIST_REMOVE(entry, list_ent_lookup);
+	__u8 mkey[XDP2_DTABLE_TSS_MAX_KEY_LEN];
+	struct xdp2_dtable_tss_node **pnode;
+	__u64 hash;
 
-	free(entry);
-}
+	hash = xdp2_dtable_tss_mask_hash(mkey, node->key, st->key_mask,
+					 table->key_len);
 
-/* Delete an entry in a table by its identfier */
-static void xdp2_dtable_del_by_id(struct xdp2_dtable_table *table,
-				   unsigned int ident)
-{
-	struct xdp2_dtable_entry *entry;
+	pnode = &st->buckets[hash & st->mask];
+	while (*pnode && (*pnode)->prio < node->prio)
+		pnode = &(*pnode)->next;
 
-	entry = xdp2_dtable_find_ent_by_id(table, ident);
-	if (entry)
-		xdp2_dtable_del(table, entry);
+	node->next = *pnode;
+	xdp2_rcu_assign_pointer(*pnode, node);
+	st->count++;
 }
 
-/* Change a table entry in place (change function or argument) */
-static void xdp2_dtable_change(struct xdp2_dtable_table *table,
-				struct xdp2_dtable_entry *entry,
-				void *target)
+/* Free a subtable and its nodes after a grace period */
+static void xdp2_dtable_tss_subtable_free(struct xdp2_dtable_tss_subtable *st)
 {
-	memcpy(XDP2_DTABLE_TARG(table, entry), target, table->targ_len);
+	struct xdp2_dtable_tss_node *node, *next;
+	unsigned int i;
+
+	for (i = 0; i <= st->mask; i++) {
+		for (node = st->buckets[i]; node; node = next) {
+			next = node->next;
+			xdp2_dtable_defer_free(node);
+		}
+	}
+
+	xdp2_dtable_defer_free(st);
 }
 
-/* Change a table entry in place by its identfier */
-static int xdp2_dtable_change_by_id(struct xdp2_dtable_table *table,
-				     unsigned int ident, void *target)
+/* Double the number of buckets of a subtable. The nodes are copied into a
+ * new subtable which replaces the old one. If memory allocation fails the
+ * old subtable is kept
+ */
+static void xdp2_dtable_tss_grow(struct xdp2_dtable_table *table,
+				 struct xdp2_dtable_tss *tss,
+				 struct xdp2_dtable_tss_subtable *st)
 {
-	struct xdp2_dtable_entry *entry;
+	size_t node_len = sizeof(struct xdp2_dtable_tss_node) +
+							table->key_len;
+	struct xdp2_dtable_tss_node *node, *nnode;
+	struct xdp2_dtable_tss_subtable *nst;
+	unsigned int i;
+
+	nst = xdp2_dtable_tss_subtable_alloc(table, 2 * (st->mask + 1),
+					     st->key_mask);
+	if (!nst)
+		return;
+
+	for (i = 0; i <= st->mask; i++) {
+		for (node = st->buckets[i]; node; node = node->next) {
+			nnode = malloc(node_len);
+			if (!nnode)
+				goto fail;
+			memcpy(nnode, node, node_len);
+			xdp2_dtable_tss_link(table, nst, nnode);
+		}
+	}
 
-	entry = xdp2_dtable_find_ent_by_id(table, ident);
-	if (!entry)
-		return -ENOENT;
+	if (xdp2_dtable_tss_update_refs(tss, st, nst))
+		goto fail;
 
-	xdp2_dtable_change(table, entry, target);
+	xdp2_dtable_tss_subtable_free(st);
 
-	return 0;
-}
+	return;
 
-/* Create a dynamic plain table */
-struct xdp2_dtable_plain_table *xdp2_dtable_create_plain(
-		const char *name, size_t key_len, void *default_target,
-		size_t target_len, int *ident)
-{
-	return (struct xdp2_dtable_plain_table *)
-	    xdp2_dtable_create(name, key_len,
-			key_len + sizeof(struct xdp2_plain_entry_key), ident,
-			sizeof(struct xdp2_dtable_plain_table),
-			default_target, target_len, &plain_tables);
+fail:
+	for (i = 0; i <= nst->mask; i++) {
+		for (node = nst->buckets[i]; node; node = nnode) {
+			nnode = node->next;
+			free(node);
+		}
+	}
+	free(nst);
 }
 
-/* Find a matching entry by key for a plain table and return it. Also
- * return a pointer to the previous next for deletion
- */
-static struct xdp2_dtable_entry *__xdp2_dtable_find_plain(
-		struct xdp2_dtable_plain_table *table, const void *key,
-		struct xdp2_dtable_entry **pprev, __u64 *_hash)
+/* Insert an entry in the index */
+static int xdp2_dtable_tss_insert(struct xdp2_dtable_table *table,
+				  struct xdp2_dtable_tss *tss,
+				  struct xdp2_dtable_entry *entry)
 {
-	struct xdp2_dtable_entry *entry, *prev = NULL;
-	__u64 hash;
+	struct xdp2_tern_entry_key *keyinfo =
+		(struct xdp2_tern_entry_key *)XDP2_DTABLE_KEY(table, entry);
+	const __u8 *key_mask = keyinfo->key + table->key_len;
+	struct xdp2_dtable_tss_subtable *st;
+	struct xdp2_dtable_tss_node *node;
+	struct xdp2_dtable_tss_ref *ref;
+
+	node = malloc(sizeof(*node) + table->key_len);
+	if (!node)
+		return -ENOMEM;
 
-	hash = siphash(key, table->key_len, &siphash_key);
-	if (_hash)
-		*_hash = hash;
+	node->entry = entry;
+	node->prio = xdp2_dtable_tss_prio(table, entry, tss->seq++);
+	xdp2_dtable_tss_mask_hash(node->key, keyinfo->key, key_mask,
+				  table->key_len);
+
+	ref = xdp2_dtable_tss_find_ref(table, tss, key_mask);
+	if (!ref) {
+		/* New subtable, it's not visible until it's added to the
+		 * subtable list
+		 */
+		st = xdp2_dtable_tss_subtable_alloc(table,
+				XDP2_DTABLE_TSS_MIN_BUCKETS, key_mask);
+		if (!st) {
+			free(node);
+			return -ENOMEM;
+		}
 
-	LIST_FOREACH(entry, &table->entries_lookup, list_ent_lookup) {
-		struct xdp2_plain_entry_key *keyinfo =
-			(struct xdp2_plain_entry_key *)
-				XDP2_DTABLE_KEY(table, entry);
+		xdp2_dtable_tss_link(table, st, node);
 
-		if (keyinfo->hash > hash) {
-			entry = NULL;
-			break;
+		if (xdp2_dtable_tss_update_refs(tss, NULL, st)) {
+			free(node);
+			free(st);
+			return -ENOMEM;
 		}
 
-		if (keyinfo->hash == hash &&
-		    xdp2_compare_equal(keyinfo->key, key, table->key_len))
-			break;
-		prev = entry;
+		return 0;
 	}
 
-	if (pprev)
-		*pprev = prev;
+	st = ref->st;
+	xdp2_dtable_tss_link(table, st, node);
 
-	return entry;
+	/* A stale best priority that's too high could make lookups skip
+	 * the subtable, so on failure the node is unlinked
+	 */
+	if (node->prio < ref->min_prio &&
+	    xdp2_dtable_tss_update_refs(tss, st, st)) {
+		xdp2_dtable_tss_remove(table, tss, entry);
+		return -ENOMEM;
+	}
+
+	if (st->count > 2 * (st->mask + 1))
+		xdp2_dtable_tss_grow(table, tss, st);
+
+	return 0;
 }
 
-/* Add an entry to a plain table */
-int xdp2_dtable_add_plain(struct xdp2_dtable_plain_table *table,
-		int ident, const void *key, void *target)
+/* Find the node for an entry. Returns a pointer to the link to the node
+ * and the reference to its subtable
+ */
+static struct xdp2_dtable_tss_node **xdp2_dtable_tss_find_node(
+		struct xdp2_dtable_table *table, struct xdp2_dtable_tss *tss,
+		struct xdp2_dtable_entry *entry,
+		struct xdp2_dtable_tss_ref **pref)
 {
-	struct xdp2_dtable_entry *prev_entry, *entry;
-	struct xdp2_plain_entry_key *keyinfo;
+	struct xdp2_tern_entry_key *keyinfo =
+		(struct xdp2_tern_entry_key *)XDP2_DTABLE_KEY(table, entry);
+	const __u8 *key_mask = keyinfo->key + table->key_len;
+	__u8 mkey[XDP2_DTABLE_TSS_MAX_KEY_LEN];
+	struct xdp2_dtable_tss_node **pnode;
+	struct xdp2_dtable_tss_ref *ref;
 	__u64 hash;
 
-	if (__xdp2_dtable_find_plain(table, key, &prev_entry, &hash))
-		return -EALREADY;
+	ref = xdp2_dtable_tss_find_ref(table, tss, key_mask);
+	if (!ref)
+		return NULL;
 
-	entry = xdp2_dtable_add((struct xdp2_dtable_table *)table,
-				 prev_entry, &ident, target);
-	if (!entry)
-		return -ENOMEM;
+	hash = xdp2_dtable_tss_mask_hash(mkey, keyinfo->key, key_mask,
+					 table->key_len);
 
-	keyinfo = (struct xdp2_plain_entry_key *)
-			XDP2_DTABLE_KEY(table, entry);
-	keyinfo->hash = hash;
-	memcpy(keyinfo->key, key, table->key_len);
+	for (pnode = &ref->st->buckets[hash & ref->st->mask]; *pnode;
+	     pnode = &(*pnode)->next) {
+		if ((*pnode)->entry == entry) {
+			*pref = ref;
+			return pnode;
+		}
+	}
 
-	return ident;
+	return NULL;
 }
 
-/* Delete an entry from a plain table */
-void xdp2_dtable_del_plain(struct xdp2_dtable_plain_table *ptable,
-			    const void *key)
+/* Remove an entry from the index */
+static void xdp2_dtable_tss_remove(struct xdp2_dtable_table *table,
+				   struct xdp2_dtable_tss *tss,
+				   struct xdp2_dtable_entry *entry)
 {
-	struct xdp2_dtable_entry *entry;
+	struct xdp2_dtable_tss_node **pnode, *node;
+	struct xdp2_dtable_tss_subtable *st;
+	struct xdp2_dtable_tss_ref *ref;
+
+	pnode = xdp2_dtable_tss_find_node(table, tss, entry, &ref);
+	if (!pnode)
+		return;
+
+	node = *pnode;
+	st = ref->st;
+
+	xdp2_rcu_assign_pointer(*pnode, node->next);
+	st->count--;
+
+	/* Failing to update the list only leaves a best priority that's
+	 * too low, that's safe and is fixed by the next update
+	 */
+	if (!st->count) {
+		if (!xdp2_dtable_tss_update_refs(tss, st, NULL))
+			xdp2_dtable_defer_free(st);
+	} else if (node->prio == ref->min_prio) {
+		xdp2_dtable_tss_update_refs(tss, st, st);
+	}
 
-	entry = __xdp2_dtable_find_plain(ptable, key, NULL, NULL);
-	if (entry)
-		xdp2_dtable_del((struct xdp2_dtable_table *)ptable, entry);
+	xdp2_dtable_defer_free(node);
 }
 
-/* Delete an entry from a plain table by its identifier */
-void xdp2_dtable_del_plain_by_id(struct xdp2_dtable_plain_table *ptable,
-				  int ident)
+/* Replace an entry in the index with a copy */
+static void xdp2_dtable_tss_replace(struct xdp2_dtable_table *table,
+				    struct xdp2_dtable_entry *old,
+				    struct xdp2_dtable_entry *new)
 {
-	xdp2_dtable_del_by_id((struct xdp2_dtable_table *)ptable, ident);
+	struct xdp2_dtable_tss_node **pnode;
+	struct xdp2_dtable_tss_ref *ref;
+
+	pnode = xdp2_dtable_tss_find_node(table, table->tss, old, &ref);
+	if (pnode)
+		xdp2_rcu_assign_pointer((*pnode)->entry, new);
 }
 
-/* Change an entry in a plain table */
-int xdp2_dtable_change_plain(struct xdp2_dtable_plain_table *ptable,
-			      const void *key, void *target)
+/* Free an index after a grace period */
+static void xdp2_dtable_tss_free(struct xdp2_dtable_tss *tss)
 {
-	struct xdp2_dtable_entry *entry;
-
-	entry = __xdp2_dtable_find_plain(ptable, key, NULL, NULL);
-	if (!entry)
-		return -ENOENT;
+	unsigned int i;
 
-	xdp2_dtable_change((struct xdp2_dtable_table *)ptable,
-			    entry, target);
+	if (tss->refs) {
+		for (i = 0; i < tss->refs->num; i++)
+			xdp2_dtable_tss_subtable_free(tss->refs->refs[i].st);
+		xdp2_dtable_defer_free(tss->refs);
+	}
 
-	return 0;
+	xdp2_dtable_defer_free(tss);
 }
 
-/* Change an entry in a plain table by its identifier*/
-int xdp2_dtable_change_plain_by_id(struct xdp2_dtable_plain_table *ptable,
-				    int ident, void *target)
+/* Build an index from the entries in the lookup list and replace the
+ * current index. This is also done when the sequence number wraps
+ */
+static int xdp2_dtable_tss_build(struct xdp2_dtable_table *table)
 {
-	return xdp2_dtable_change_by_id((struct xdp2_dtable_table *)ptable,
-					 ident, target);
+	struct xdp2_dtable_tss *tss, *old = table->tss;
+	struct xdp2_dtable_entry *entry;
+	int err;
+
+	if (table->key_len > XDP2_DTABLE_TSS_MAX_KEY_LEN)
+		return -EINVAL;
+
+	tss = calloc(1, sizeof(*tss));
+	if (!tss)
+		return -ENOMEM;
+
+	LIST_FOREACH(entry, &table->entries_lookup, list_ent_lookup) {
+		err = xdp2_dtable_tss_insert(table, tss, entry);
+		if (err) {
+			/* Nothing was published so this frees right away
+			 * if there are no readers, else after a grace period
+			 */
+			xdp2_dtable_tss_free(tss);
+			return err;
+		}
+	}
+
+	xdp2_rcu_assign_pointer(table->tss, tss);
+	if (old)
+		xdp2_dtable_tss_free(old);
 
 	return 0;
 }
 
-/* Perform a lookup in a plain table */
-const void *xdp2_dtable_lookup_plain(struct xdp2_dtable_plain_table *table,
-				      const void *key)
+/* Lookup in the index */
+static const struct xdp2_dtable_entry *xdp2_dtable_tss_lookup(
+		const struct xdp2_dtable_table *table,
+		const struct xdp2_dtable_tss *tss, const __u8 *key)
 {
-	struct xdp2_dtable_entry *entry;
-	__u64 hash;
+	const struct xdp2_dtable_tss_refs *refs = xdp2_rcu_dereference(
+								tss->refs);
+	const struct xdp2_dtable_tss_node *node, *best = NULL;
+	__u8 mkey[XDP2_DTABLE_TSS_MAX_KEY_LEN];
+	const struct xdp2_dtable_tss_subtable *st;
+	__u64 best_prio = -1ULL, hash;
+	unsigned int i;
+
+	if (!refs)
+		return NULL;
 
-	hash = siphash(key, table->key_len, &siphash_key);
+	for (i = 0; i < refs->num; i++) {
+		/* Prune subtables that can't have a better match */
+		if (refs->refs[i].min_prio >= best_prio)
+			break;
 
-	LIST_FOREACH(entry, &table->entries_lookup, list_ent_lookup) {
-		struct xdp2_plain_entry_key *keyinfo =
-			(struct xdp2_plain_entry_key *)
-				XDP2_DTABLE_KEY(table, entry);
+		st = refs->refs[i].st;
+		hash = xdp2_dtable_tss_mask_hash(mkey, key, st->key_mask,
+						 table->key_len);
 
-		if (keyinfo->hash > hash)
-			break;
+		for (node = xdp2_rcu_dereference(st->buckets[hash & st->mask]);
+		     node; node = xdp2_rcu_dereference(node->next)) {
+			if (node->prio >= best_prio)
+				break;
+			if (xdp2_compare_equal(node->key, mkey,
+					       table->key_len)) {
+				best = node;
+				best_prio = node->prio;
+				break;
+			}
+		}
+	}
+
+	return best ? xdp2_rcu_dereference(best->entry) : NULL;
+}
 
-		if (keyinfo->hash == hash &&
-		    xdp2_compare_equal(keyinfo->key, key, table->key_len))
-			return XDP2_DTABLE_TARG(table, entry);
+/* Set the lookup algorithm of a ternary table */
+int xdp2_dtable_set_tern_algo(struct xdp2_dtable_tern_table *ttable,
+			      enum xdp2_dtable_tern_algo algo)
+{
+	struct xdp2_dtable_table *table = (struct xdp2_dtable_table *)ttable;
+	int err;
+
+	switch (algo) {
+	case XDP2_DTABLE_TERN_LINEAR:
+		if (table->tss) {
+			struct xdp2_dtable_tss *tss = table->tss;
+
+			xdp2_rcu_assign_pointer(table->tss, NULL);
+			xdp2_dtable_tss_free(tss);
+		}
+		break;
+	case XDP2_DTABLE_TERN_TSS:
+		if (!table->tss) {
+			err = xdp2_dtable_tss_build(table);
+			if (err)
+				return err;
+		}
+		break;
+	default:
+		return -EINVAL;
 	}
 
-	return table->default_target;
+	table->config.tern_algo = algo;
+
+	return 0;
 }
 
 /* Dynamic ternary tables */
@@ -484,10 +1689,21 @@ int xdp2_dtable_add_tern(struct xdp2_dtable_tern_table *table,
 {
 	struct xdp2_dtable_entry *prev_entry, *entry;
 	struct xdp2_tern_entry_key *keyinfo;
+	int err;
 
 	if (__xdp2_dtable_find_tern(table, key, key_mask, pos, &prev_entry))
 		return -EALREADY;
 
+	/* The index for a table configured for TSS is built on first use,
+	 * and is rebuilt to renumber entries when the sequence number wraps
+	 */
+	if (table->config.tern_algo == XDP2_DTABLE_TERN_TSS &&
+	    (!table->tss || table->tss->seq == -1U)) {
+		err = xdp2_dtable_tss_build((struct xdp2_dtable_table *)table);
+		if (err)
+			return err;
+	}
+
 	entry = xdp2_dtable_add((struct xdp2_dtable_table *)table, prev_entry,
 				 &ident, target);
 	if (!entry)
@@ -499,6 +1715,19 @@ int xdp2_dtable_add_tern(struct xdp2_dtable_tern_table *table,
 	memcpy(keyinfo->key, key, table->key_len);
 	memcpy(keyinfo->key + table->key_len, key_mask, table->key_len);
 
+	xdp2_dtable_publish((struct xdp2_dtable_table *)table, prev_entry,
+			    entry);
+
+	if (table->tss) {
+		err = xdp2_dtable_tss_insert((struct xdp2_dtable_table *)table,
+					     table->tss, entry);
+		if (err) {
+			xdp2_dtable_del((struct xdp2_dtable_table *)table,
+					entry);
+			return err;
+		}
+	}
+
 	return 0;
 }
 
@@ -532,10 +1761,8 @@ int xdp2_dtable_change_tern(struct xdp2_dtable_tern_table *ttable,
 	if (!tentry)
 		return -ENOENT;
 
-	xdp2_dtable_change((struct xdp2_dtable_table *)ttable,
-			    (struct xdp2_dtable_entry *)tentry, target);
-
-	return 0;
+	return xdp2_dtable_change((struct xdp2_dtable_table *)ttable,
+				  (struct xdp2_dtable_entry *)tentry, target);
 }
 
 /* Change an entry in a ternary table by its identifier */
@@ -548,24 +1775,70 @@ int xdp2_dtable_change_tern_by_id(struct xdp2_dtable_tern_table *ttable,
 	return 0;
 }
 
-/* Perform a lookup in a ternary table */
-const void *xdp2_dtable_lookup_tern(struct xdp2_dtable_tern_table *table,
-			      const void *key)
+/* Linear lookup in a ternary table. This is inlined with constant key
+ * lengths for common key sizes so that the key compare is specialized for
+ * the length
+ */
+static inline const struct xdp2_dtable_entry *__xdp2_dtable_lookup_tern(
+		struct xdp2_dtable_tern_table *table, const void *key,
+		size_t key_len)
 {
 	struct xdp2_dtable_entry *entry;
 
-	LIST_FOREACH(entry, &table->entries_lookup, list_ent_lookup) {
+	XDP2_LIST_FOREACH_RCU(entry, &table->entries_lookup, list_ent_lookup) {
 		struct xdp2_tern_entry_key *keyinfo =
 			(struct xdp2_tern_entry_key *)
 				XDP2_DTABLE_KEY(table, entry);
 
 		if (xdp2_compare_tern(keyinfo->key, key,
-				      keyinfo->key + table->key_len,
-				      table->key_len))
-			return XDP2_DTABLE_TARG(table, entry);
+				      keyinfo->key + key_len, key_len))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Perform a lookup in a ternary table */
+const void *xdp2_dtable_lookup_tern(struct xdp2_dtable_tern_table *table,
+			      const void *key)
+{
+	const struct xdp2_dtable_tss *tss = xdp2_rcu_dereference(table->tss);
+	const struct xdp2_dtable_entry *entry;
+
+	if (tss) {
+		entry = xdp2_dtable_tss_lookup(
+				(struct xdp2_dtable_table *)table, tss, key);
+
+		return entry ? XDP2_DTABLE_TARG(table, entry) :
+			       table->default_target;
+	}
+
+	switch (table->key_len) {
+	case 4:
+		entry = __xdp2_dtable_lookup_tern(table, key, 4);
+		break;
+	case 8:
+		entry = __xdp2_dtable_lookup_tern(table, key, 8);
+		break;
+	case 13:
+		entry = __xdp2_dtable_lookup_tern(table, key, 13);
+		break;
+	case 16:
+		entry = __xdp2_dtable_lookup_tern(table, key, 16);
+		break;
+	case 36:
+		entry = __xdp2_dtable_lookup_tern(table, key, 36);
+		break;
+	case 40:
+		entry = __xdp2_dtable_lookup_tern(table, key, 40);
+		break;
+	default:
+		entry = __xdp2_dtable_lookup_tern(table, key,
+						  table->key_len);
+		break;
 	}
 
-	return table->default_target;
+	return entry ? XDP2_DTABLE_TARG(table, entry) : table->default_target;
 }
 
 /* Dynamic LPM tables */
@@ -582,36 +1855,29 @@ struct xdp2_dtable_lpm_table *xdp2_dtable_create_lpm(
 				default_target, target_len, &lpm_tables);
 }
 
-/* Find a matching entry in a longest prefix match table and return it. Also
- * return a pointer to the previous next for deletion. The list is ordered
- * by descending prefix length
+/* Find an entry in a longest prefix match table with exactly the given
+ * key and prefix length
  */
-static struct xdp2_dtable_lpm_entry *__xdp2_dtable_find_lpm(
+static struct xdp2_dtable_entry *__xdp2_dtable_find_lpm(
 		struct xdp2_dtable_lpm_table *table, const void *key,
-		size_t prefix_len, struct xdp2_dtable_entry **pprev)
+		size_t prefix_len)
 {
-	struct xdp2_dtable_entry *entry, *prev = NULL;
-
-	LIST_FOREACH(entry, &table->entries_lookup, list_ent_lookup) {
-		struct xdp2_lpm_entry_key *keyinfo =
-			(struct xdp2_lpm_entry_key *)
-				XDP2_DTABLE_KEY(table, entry);
-
-		if (keyinfo->prefix_len < prefix_len) {
-			entry = NULL;
-			break;
-		}
+	if (!table->trie)
+		return NULL;
 
-		if (xdp2_compare_equal(keyinfo->key, key, table->key_len) &&
-		    keyinfo->prefix_len == prefix_len)
-			break;
-		prev = entry;
-	}
+	return (struct xdp2_dtable_entry *)xdp2_lpm_trie_find(table->trie,
+							      key, prefix_len);
+}
 
-	if (pprev)
-		*pprev = prev;
+/* Remove an entry from a longest prefix match table and its trie */
+static void xdp2_dtable_del_lpm_entry(struct xdp2_dtable_table *table,
+				      struct xdp2_dtable_entry *entry)
+{
+	struct xdp2_lpm_entry_key *keyinfo =
+		(struct xdp2_lpm_entry_key *)XDP2_DTABLE_KEY(table, entry);
 
-	return (struct xdp2_dtable_lpm_entry *)entry;
+	xdp2_lpm_trie_delete(table->trie, keyinfo->key, keyinfo->prefix_len);
+	xdp2_dtable_del(table, entry);
 }
 
 /* Add an entry to a longest prefix match table */
@@ -619,14 +1885,28 @@ int xdp2_dtable_add_lpm(struct xdp2_dtable_lpm_table *table,
 			 int ident, const void *key, size_t prefix_len,
 			 void *target)
 {
-	struct xdp2_dtable_entry *prev_entry, *entry;
+	struct xdp2_dtable_entry *entry;
 	struct xdp2_lpm_entry_key *keyinfo;
+	int err;
 
-	if (__xdp2_dtable_find_lpm(table, key, prefix_len, &prev_entry))
+	if (prefix_len > table->key_len * 8)
+		return -EINVAL;
+
+	if (__xdp2_dtable_find_lpm(table, key, prefix_len))
 		return -EALREADY;
 
+	if (!table->trie) {
+		struct xdp2_lpm_trie *trie = malloc(sizeof(*trie));
+
+		if (!trie)
+			return -ENOMEM;
+		xdp2_lpm_trie_init(trie, table->key_len);
+		trie->qsbr = &xdp2_dtable_qsbr;
+		xdp2_rcu_assign_pointer(table->trie, trie);
+	}
+
 	entry = xdp2_dtable_add((struct xdp2_dtable_table *)table,
-				 prev_entry, &ident, target);
+				 NULL, &ident, target);
 	if (!entry)
 		return -ENOMEM;
 
@@ -636,6 +1916,15 @@ int xdp2_dtable_add_lpm(struct xdp2_dtable_lpm_table *table,
 	keyinfo->prefix_len = prefix_len;
 	memcpy(keyinfo->key, key, table->key_len);
 
+	xdp2_dtable_publish((struct xdp2_dtable_table *)table, NULL, entry);
+
+	err = xdp2_lpm_trie_insert(table->trie, keyinfo->key, prefix_len,
+				   entry);
+	if (err) {
+		xdp2_dtable_del((struct xdp2_dtable_table *)table, entry);
+		return err;
+	}
+
 	return 0;
 }
 
@@ -643,19 +1932,25 @@ int xdp2_dtable_add_lpm(struct xdp2_dtable_lpm_table *table,
 void xdp2_dtable_del_lpm(struct xdp2_dtable_lpm_table *ltable,
 			  const void *key, size_t prefix_len)
 {
-	struct xdp2_dtable_lpm_entry *lentry;
+	struct xdp2_dtable_entry *entry;
 
-	lentry = __xdp2_dtable_find_lpm(ltable, key, prefix_len, NULL);
-	if (lentry)
-		xdp2_dtable_del((struct xdp2_dtable_table *)ltable,
-				 (struct xdp2_dtable_entry *)lentry);
+	entry = __xdp2_dtable_find_lpm(ltable, key, prefix_len);
+	if (entry)
+		xdp2_dtable_del_lpm_entry((struct xdp2_dtable_table *)ltable,
+					  entry);
 }
 
 /* Delete an entry from a longest prefix match table by its identifier*/
 void xdp2_dtable_del_lpm_by_id(struct xdp2_dtable_lpm_table *ltable,
 				int ident)
 {
-	xdp2_dtable_del_by_id((struct xdp2_dtable_table *)ltable, ident);
+	struct xdp2_dtable_entry *entry;
+
+	entry = xdp2_dtable_find_ent_by_id((struct xdp2_dtable_table *)ltable,
+					   ident);
+	if (entry)
+		xdp2_dtable_del_lpm_entry((struct xdp2_dtable_table *)ltable,
+					  entry);
 }
 
 /* Change an entry in a longest prefix match table */
@@ -663,16 +1958,14 @@ int xdp2_dtable_change_lpm(struct xdp2_dtable_lpm_table *ltable,
 			    const void *key, size_t prefix_len,
 			    void *target)
 {
-	struct xdp2_dtable_lpm_entry *lentry;
+	struct xdp2_dtable_entry *entry;
 
-	lentry = __xdp2_dtable_find_lpm(ltable, key, prefix_len, NULL);
-	if (!lentry)
+	entry = __xdp2_dtable_find_lpm(ltable, key, prefix_len);
+	if (!entry)
 		return -ENOENT;
 
-	xdp2_dtable_change((struct xdp2_dtable_table *)ltable,
-			    (struct xdp2_dtable_entry *)lentry, target);
-
-	return 0;
+	return xdp2_dtable_change((struct xdp2_dtable_table *)ltable, entry,
+				  target);
 }
 
 /* Change an entry in a longest prefix match table by its identifier */
@@ -683,26 +1976,19 @@ int xdp2_dtable_change_lpm_by_id(struct xdp2_dtable_lpm_table *ltable,
 					 ident, target);
 }
 
-/* Perform a lookup in a longest prefix match table. Note that this list
- * is sorted by descending prefix length, so the first match found will be
- * the correct one
- */
+/* Perform a lookup in a longest prefix match table */
 const void *xdp2_dtable_lookup_lpm(struct xdp2_dtable_lpm_table *table,
 				    const void *key)
 {
-	struct xdp2_dtable_entry *entry;
+	const struct xdp2_lpm_trie *trie = xdp2_rcu_dereference(table->trie);
+	const struct xdp2_dtable_entry *entry;
 
-	LIST_FOREACH(entry, &table->entries_lookup, list_ent_lookup) {
-		struct xdp2_lpm_entry_key *keyinfo =
-			(struct xdp2_lpm_entry_key *)
-				XDP2_DTABLE_KEY(table, entry);
+	if (!trie)
+		return table->default_target;
 
-		if (xdp2_compare_prefix(keyinfo->key, key,
-					keyinfo->prefix_len))
-			return XDP2_DTABLE_TARG(table, entry);
-	}
+	entry = xdp2_lpm_trie_lookup(trie, key);
 
-	return table->default_target;
+	return entry ? XDP2_DTABLE_TARG(table, entry) : table->default_target;
 }
 
 /* Create a dummy table to ensure that the section is defined (if no
@@ -786,6 +2072,10 @@ static void xdp2_dtable_print_one_plain_table(void *cli,
 	XDP2_CLI_PRINT(cli, "Plain table %s: ident %d, key length %lu,\n",
 	       table->name, table->ident, table->key_len);
 
+	if (table->hash)
+		XDP2_CLI_PRINT(cli, "\tHash index: buckets %u, entries %u\n",
+			       table->hash->mask + 1, table->hash->count);
+
 	LIST_FOREACH(entry, &table->entries_lookup, list_ent_lookup)
 		xdp2_dtable_print_plain_entry(cli, table, entry);
 }
@@ -812,6 +2102,11 @@ static void xdp2_dtable_print_one_lpm_table(void *cli,
 	XDP2_CLI_PRINT(cli, "Longest prefix match table %s: ident %u\n",
 	       table->name, table->ident);
 
+	if (table->trie)
+		XDP2_CLI_PRINT(cli, "\tTrie: prefixes %u, nodes %u\n",
+			       table->trie->num_prefixes,
+			       table->trie->num_nodes);
+
 	LIST_FOREACH(entry, &table->entries_lookup, list_ent_lookup)
 		xdp2_dtable_print_lpm_entry(cli, table, entry);
 }
@@ -992,6 +2287,9 @@ void xdp2_dtable_init(void)
 
 		switch (def_base[i].table_type) {
 		case XDP2_DTABLE_TABLE_TYPE_PLAIN:
+				if (def_base[i].config.hash_algo ==
+							XDP2_HASH_TOEPLITZ)
+					xdp2_dtable_toeplitz_init();
 				ident = 0;
 				if (__xdp2_dtable_insert_table(&def_base[i],
 							       &ident,
@@ -47,11 +47,11 @@ void xdp2_fifo_dump_one_fifo(const struct xdp2_fifo *fifo,
 	XDP2_CLI_PRINT(cli, "%s%s%s enqueued: %lu, dequeued %lu,"
 			    " num_in_queue: %u , "
 			    "num_enqueue_waiters: %u, num_ents: %u, "
-			    "ent_size: %u, %s %s %s %s %s %s\n",
+			    "ent_size: %u, mode: %s, %s %s %s %s %s %s\n",
 		       name, id1txt, id2txt, fifo->num_enqueued,
 		       fifo->num_dequeued, xdp2_fifo_num_in_queue(fifo),
 		       fifo->num_enqueue_waiters, fifo->num_ents,
-		       fifo->ent_size,
+		       fifo->ent_size, xdp2_fifo_mode_to_text(fifo->mode),
 		       xdp2_fifo_is_full(fifo) ? "full" : "not-full",
 		       xdp2_fifo_is_empty(fifo) ? "empty" : "not-empty",
 		       xdp2_fifo_is_error(fifo) ? "error" : "not-error",
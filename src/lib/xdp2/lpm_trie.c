@@ -0,0 +1,774 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Multibit trie (tree bitmap) for longest prefix match */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xdp2/bitmap_word.h"
+#include "xdp2/lpm_trie.h"
+#include "xdp2/qsbr.h"
+#include "xdp2/utility.h"
+
+#define XDP2_LPM_TRIE_BM_WORDS 4	/* 256 bits */
+
+struct xdp2_lpm_trie_node {
+	/* Prefixes of length 0 to 7 bits terminating in the node. The
+	 * prefix with length l and value v (the top l bits of the byte) is
+	 * bit (1 << l) - 1 + v
+	 */
+	__u64 internal[XDP2_LPM_TRIE_BM_WORDS];
+
+	/* Child nodes for each value of the byte */
+	__u64 external[XDP2_LPM_TRIE_BM_WORDS];
+
+	/* Values of the prefixes in the internal bitmap */
+	const void **values;
+
+	/* Child nodes are kept in one contiguous array so that following a
+	 * child is a single memory access
+	 */
+	struct xdp2_lpm_trie_node *children;
+};
+
+/* Bitmap helpers */
+
+static inline bool xdp2_lpm_trie_bm_test(const __u64 *bm, unsigned int bit)
+{
+	return !!(bm[bit / 64] & (1ULL << (bit % 64)));
+}
+
+static inline void xdp2_lpm_trie_bm_set(__u64 *bm, unsigned int bit)
+{
+	bm[bit / 64] |= 1ULL << (bit % 64);
+}
+
+static inline void xdp2_lpm_trie_bm_clear(__u64 *bm, unsigned int bit)
+{
+	bm[bit / 64] &= ~(1ULL << (bit % 64));
+}
+
+/* Return the number of set bits less than bit */
+static inline unsigned int xdp2_lpm_trie_bm_rank(const __u64 *bm,
+						 unsigned int bit)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < bit / 64; i++)
+		n += xdp2_bitmap_word64_weight(bm[i]);
+
+	return n + xdp2_bitmap_word64_weight(bm[i] &
+					     ((1ULL << (bit % 64)) - 1));
+}
+
+static inline unsigned int xdp2_lpm_trie_bm_count(const __u64 *bm)
+{
+	return xdp2_lpm_trie_bm_rank(bm, 255) + xdp2_lpm_trie_bm_test(bm, 255);
+}
+
+static inline bool xdp2_lpm_trie_bm_empty(const __u64 *bm)
+{
+	return !(bm[0] | bm[1] | bm[2] | bm[3]);
+}
+
+/* Index in the internal bitmap for a prefix of length plen (0 to 7) whose
+ * bits are the top bits of byte
+ */
+static inline unsigned int xdp2_lpm_trie_pfx_index(unsigned int byte,
+						   unsigned int plen)
+{
+	return (1U << plen) - 1 + (byte >> (8 - plen));
+}
+
+/* Insert a pointer at position pos in an array of num pointers */
+static int xdp2_lpm_trie_array_insert(void ***parray, unsigned int num,
+				      unsigned int pos, void *ptr)
+{
+	void **array;
+
+	array = realloc(*parray, (num + 1) * sizeof(*array));
+	if (!array)
+		return -ENOMEM;
+
+	memmove(&array[pos + 1], &array[pos], (num - pos) * sizeof(*array));
+	array[pos] = ptr;
+	*parray = array;
+
+	return 0;
+}
+
+/* Remove the pointer at position pos in an array of num pointers */
+static void xdp2_lpm_trie_array_remove(void ***parray, unsigned int num,
+				       unsigned int pos)
+{
+	void **array = *parray;
+
+	memmove(&array[pos], &array[pos + 1], (num - pos - 1) * sizeof(*array));
+
+	if (num == 1) {
+		free(array);
+		*parray = NULL;
+	} else {
+		/* Shrinking, so a failure leaves the old array in place */
+		array = realloc(array, (num - 1) * sizeof(*array));
+		if (array)
+			*parray = array;
+	}
+}
+
+/* Free the arrays of a node and its descendants (not the node itself) */
+static void xdp2_lpm_trie_node_release(struct xdp2_lpm_trie *trie,
+				       struct xdp2_lpm_trie_node *node)
+{
+	unsigned int i, num = xdp2_lpm_trie_bm_count(node->external);
+
+	for (i = 0; i < num; i++)
+		xdp2_lpm_trie_node_release(trie, &node->children[i]);
+
+	free(node->children);
+	free(node->values);
+
+	trie->num_nodes -= num;
+}
+
+static inline bool xdp2_lpm_trie_node_empty(struct xdp2_lpm_trie_node *node)
+{
+	return xdp2_lpm_trie_bm_empty(node->internal) &&
+	       xdp2_lpm_trie_bm_empty(node->external);
+}
+
+/* Get the child node of a node for a byte value, optionally creating it.
+ * Note that creating a child moves its siblings
+ */
+static struct xdp2_lpm_trie_node *xdp2_lpm_trie_get_child(
+		struct xdp2_lpm_trie *trie, struct xdp2_lpm_trie_node *node,
+		unsigned int byte, bool create)
+{
+	unsigned int pos = xdp2_lpm_trie_bm_rank(node->external, byte);
+	unsigned int num = xdp2_lpm_trie_bm_count(node->external);
+	struct xdp2_lpm_trie_node *children;
+
+	if (xdp2_lpm_trie_bm_test(node->external, byte))
+		return &node->children[pos];
+
+	if (!create)
+		return NULL;
+
+	children = realloc(node->children, (num + 1) * sizeof(*children));
+	if (!children)
+		return NULL;
+
+	memmove(&children[pos + 1], &children[pos],
+		(num - pos) * sizeof(*children));
+	memset(&children[pos], 0, sizeof(*children));
+
+	node->children = children;
+	xdp2_lpm_trie_bm_set(node->external, byte);
+	trie->num_nodes++;
+
+	return &children[pos];
+}
+
+/* Remove an empty child node */
+static void xdp2_lpm_trie_remove_child(struct xdp2_lpm_trie *trie,
+				       struct xdp2_lpm_trie_node *node,
+				       unsigned int byte)
+{
+	unsigned int pos = xdp2_lpm_trie_bm_rank(node->external, byte);
+	unsigned int num = xdp2_lpm_trie_bm_count(node->external);
+	struct xdp2_lpm_trie_node *children;
+
+	memmove(&node->children[pos], &node->children[pos + 1],
+		(num - pos - 1) * sizeof(*children));
+
+	if (num == 1) {
+		free(node->children);
+		node->children = NULL;
+	} else {
+		/* Shrinking, so a failure leaves the old array in place */
+		children = realloc(node->children,
+				   (num - 1) * sizeof(*children));
+		if (children)
+			node->children = children;
+	}
+
+	xdp2_lpm_trie_bm_clear(node->external, byte);
+	trie->num_nodes--;
+}
+
+void xdp2_lpm_trie_init(struct xdp2_lpm_trie *trie, size_t key_len)
+{
+	memset(trie, 0, sizeof(*trie));
+	trie->key_len = key_len;
+}
+
+void xdp2_lpm_trie_destroy(struct xdp2_lpm_trie *trie)
+{
+	if (trie->root) {
+		xdp2_lpm_trie_node_release(trie, trie->root);
+		free(trie->root);
+	}
+
+	trie->root = NULL;
+	trie->num_nodes = 0;
+	trie->num_prefixes = 0;
+}
+
+/* Copy on write updates
+ *
+ * For a trie with a QSBR domain, nodes reachable by readers are never
+ * modified. Since child nodes are stored in their parent's children array,
+ * changing a node means replacing the children array of its parent, and
+ * so on up to the root. An update builds new copies of the nodes on the
+ * path from the root to the node of the prefix, each with a new children
+ * array (and the last with a new values array), and then publishes a new
+ * root. Nodes off the path are shared with the old version of the trie.
+ * The old root and the replaced arrays are freed after a grace period
+ */
+
+static void xdp2_lpm_trie_defer_free(struct xdp2_lpm_trie *trie, void *ptr)
+{
+	if (ptr)
+		xdp2_qsbr_call(trie->qsbr, free, ptr);
+}
+
+/* Retire the arrays on the path of an update from node down that were
+ * replaced in the new version of the trie. The deepest arrays are retired
+ * first since a retired array may be freed right away when no reader is
+ * online, and the path below a node is in its children array
+ */
+static void __xdp2_lpm_trie_cow_retire(struct xdp2_lpm_trie *trie,
+				       struct xdp2_lpm_trie_node *node,
+				       const __u8 *k, size_t depth,
+				       size_t prefix_len)
+{
+	struct xdp2_lpm_trie_node *child;
+
+	if (depth == prefix_len / 8) {
+		xdp2_lpm_trie_defer_free(trie, node->values);
+		return;
+	}
+
+	child = xdp2_lpm_trie_get_child(trie, node, k[depth], false);
+	if (child)
+		__xdp2_lpm_trie_cow_retire(trie, child, k, depth + 1,
+					   prefix_len);
+
+	xdp2_lpm_trie_defer_free(trie, node->children);
+}
+
+/* Retire the old root and the arrays on the path of an update */
+static void xdp2_lpm_trie_cow_retire(struct xdp2_lpm_trie *trie,
+				     struct xdp2_lpm_trie_node *root,
+				     const __u8 *k, size_t prefix_len)
+{
+	__xdp2_lpm_trie_cow_retire(trie, root, k, 0, prefix_len);
+	xdp2_lpm_trie_defer_free(trie, root);
+}
+
+/* Build in new a copy of old with the prefix inserted. old is not
+ * modified and may be a zeroed node for a new child. On failure all the
+ * arrays allocated for the copy are freed
+ */
+static int xdp2_lpm_trie_cow_insert(struct xdp2_lpm_trie *trie,
+				    const struct xdp2_lpm_trie_node *old,
+				    struct xdp2_lpm_trie_node *new,
+				    const __u8 *k, size_t depth,
+				    size_t prefix_len, const void *value)
+{
+	struct xdp2_lpm_trie_node *children;
+	unsigned int idx, pos, num;
+	const void **values;
+	bool exists;
+	int err;
+
+	*new = *old;
+
+	if (depth == prefix_len / 8) {
+		idx = xdp2_lpm_trie_pfx_index(
+				depth < trie->key_len ? k[depth] : 0,
+				prefix_len % 8);
+		if (xdp2_lpm_trie_bm_test(old->internal, idx))
+			return -EALREADY;
+
+		pos = xdp2_lpm_trie_bm_rank(old->internal, idx);
+		num = xdp2_lpm_trie_bm_count(old->internal);
+
+		values = malloc((num + 1) * sizeof(*values));
+		if (!values)
+			return -ENOMEM;
+
+		memcpy(values, old->values, pos * sizeof(*values));
+		values[pos] = value;
+		memcpy(&values[pos + 1], &old->values[pos],
+		       (num - pos) * sizeof(*values));
+
+		new->values = values;
+		xdp2_lpm_trie_bm_set(new->internal, idx);
+
+		return 0;
+	}
+
+	pos = xdp2_lpm_trie_bm_rank(old->external, k[depth]);
+	num = xdp2_lpm_trie_bm_count(old->external);
+	exists = xdp2_lpm_trie_bm_test(old->external, k[depth]);
+
+	children = malloc((num + !exists) * sizeof(*children));
+	if (!children)
+		return -ENOMEM;
+
+	memcpy(children, old->children, pos * sizeof(*children));
+	memcpy(&children[pos + !exists], &old->children[pos],
+	       (num - pos) * sizeof(*children));
+	if (!exists)
+		memset(&children[pos], 0, sizeof(*children));
+
+	/* children[pos] is the old child or a zeroed node and is
+	 * overwritten with its copy
+	 */
+	err = xdp2_lpm_trie_cow_insert(trie, &children[pos], &children[pos],
+				       k, depth + 1, prefix_len, value);
+	if (err) {
+		free(children);
+		return err;
+	}
+
+	new->children = children;
+	if (!exists) {
+		xdp2_lpm_trie_bm_set(new->external, k[depth]);
+		trie->num_nodes++;
+	}
+
+	return 0;
+}
+
+/* Build in new a copy of old with the prefix deleted. Child nodes that
+ * become empty are dropped from the copy. On failure all the arrays
+ * allocated for the copy are freed
+ */
+static int xdp2_lpm_trie_cow_delete(struct xdp2_lpm_trie *trie,
+				    const struct xdp2_lpm_trie_node *old,
+				    struct xdp2_lpm_trie_node *new,
+				    const __u8 *k, size_t depth,
+				    size_t prefix_len)
+{
+	struct xdp2_lpm_trie_node *children;
+	unsigned int idx, pos, num;
+	const void **values = NULL;
+	int err;
+
+	*new = *old;
+
+	if (depth == prefix_len / 8) {
+		idx = xdp2_lpm_trie_pfx_index(
+				depth < trie->key_len ? k[depth] : 0,
+				prefix_len % 8);
+		if (!xdp2_lpm_trie_bm_test(old->internal, idx))
+			return -ENOENT;
+
+		pos = xdp2_lpm_trie_bm_rank(old->internal, idx);
+		num = xdp2_lpm_trie_bm_count(old->internal);
+
+		if (num > 1) {
+			values = malloc((num - 1) * sizeof(*values));
+			if (!values)
+				return -ENOMEM;
+
+			memcpy(values, old->values, pos * sizeof(*values));
+			memcpy(&values[pos], &old->values[pos + 1],
+			       (num - pos - 1) * sizeof(*values));
+		}
+
+		new->values = values;
+		xdp2_lpm_trie_bm_clear(new->internal, idx);
+
+		return 0;
+	}
+
+	if (!xdp2_lpm_trie_bm_test(old->external, k[depth]))
+		return -ENOENT;
+
+	pos = xdp2_lpm_trie_bm_rank(old->external, k[depth]);
+	num = xdp2_lpm_trie_bm_count(old->external);
+
+	children = malloc(num * sizeof(*children));
+	if (!children)
+		return -ENOMEM;
+
+	memcpy(children, old->children, num * sizeof(*children));
+
+	err = xdp2_lpm_trie_cow_delete(trie, &children[pos], &children[pos],
+				       k, depth + 1, prefix_len);
+	if (err) {
+		free(children);
+		return err;
+	}
+
+	if (xdp2_lpm_trie_node_empty(&children[pos])) {
+		/* An empty node has no arrays. The array is left with an
+		 * unused slot at the end
+		 */
+		memmove(&children[pos], &children[pos + 1],
+			(num - pos - 1) * sizeof(*children));
+		xdp2_lpm_trie_bm_clear(new->external, k[depth]);
+		trie->num_nodes--;
+		if (num == 1) {
+			free(children);
+			children = NULL;
+		}
+	}
+
+	new->children = children;
+
+	return 0;
+}
+
+static int xdp2_lpm_trie_cow_update(struct xdp2_lpm_trie *trie,
+				    const void *key, size_t prefix_len,
+				    const void *value, bool insert)
+{
+	struct xdp2_lpm_trie_node *old = trie->root, *root, zero;
+	int err;
+
+	root = malloc(sizeof(*root));
+	if (!root)
+		return -ENOMEM;
+
+	if (!old) {
+		memset(&zero, 0, sizeof(zero));
+		old = &zero;
+	}
+
+	err = insert ? xdp2_lpm_trie_cow_insert(trie, old, root, key, 0,
+						prefix_len, value) :
+		       xdp2_lpm_trie_cow_delete(trie, old, root, key, 0,
+						prefix_len);
+	if (err) {
+		free(root);
+		return err;
+	}
+
+	if (old == &zero)
+		trie->num_nodes++;
+
+	if (xdp2_lpm_trie_node_empty(root)) {
+		free(root);
+		root = NULL;
+		trie->num_nodes = 0;
+	}
+
+	xdp2_rcu_assign_pointer(trie->root, root);
+
+	if (old != &zero)
+		xdp2_lpm_trie_cow_retire(trie, old, key, prefix_len);
+
+	return 0;
+}
+
+int xdp2_lpm_trie_insert(struct xdp2_lpm_trie *trie, const void *key,
+			 size_t prefix_len, const void *value)
+{
+	size_t depth = prefix_len / 8, i;
+	struct xdp2_lpm_trie_node *node;
+	const __u8 *k = key;
+	unsigned int idx;
+
+	if (prefix_len > trie->key_len * 8)
+		return -EINVAL;
+
+	if (trie->qsbr) {
+		int err = xdp2_lpm_trie_cow_update(trie, key, prefix_len,
+						   value, true);
+
+		if (!err)
+			trie->num_prefixes++;
+
+		return err;
+	}
+
+	if (!trie->root) {
+		trie->root = calloc(1, sizeof(*trie->root));
+		if (!trie->root)
+			return -ENOMEM;
+		trie->num_nodes++;
+	}
+
+	node = trie->root;
+	for (i = 0; i < depth; i++) {
+		node = xdp2_lpm_trie_get_child(trie, node, k[i], true);
+		if (!node)
+			return -ENOMEM;
+	}
+
+	idx = xdp2_lpm_trie_pfx_index(depth < trie->key_len ? k[depth] : 0,
+				      prefix_len % 8);
+
+	if (xdp2_lpm_trie_bm_test(node->internal, idx))
+		return -EALREADY;
+
+	if (xdp2_lpm_trie_array_insert((void ***)&node->values,
+			xdp2_lpm_trie_bm_count(node->internal),
+			xdp2_lpm_trie_bm_rank(node->internal, idx),
+			(void *)value))
+		return -ENOMEM;
+
+	xdp2_lpm_trie_bm_set(node->internal, idx);
+	trie->num_prefixes++;
+
+	return 0;
+}
+
+/* Recursively delete a prefix starting at a node of some depth. Child
+ * nodes that become empty are freed on the way back up
+ */
+static int __xdp2_lpm_trie_delete(struct xdp2_lpm_trie *trie,
+				  struct xdp2_lpm_trie_node *node,
+				  const __u8 *k, size_t depth,
+				  size_t prefix_len)
+{
+	struct xdp2_lpm_trie_node *child;
+	unsigned int idx;
+	int err;
+
+	if (depth == prefix_len / 8) {
+		idx = xdp2_lpm_trie_pfx_index(
+				depth < trie->key_len ? k[depth] : 0,
+				prefix_len % 8);
+
+		if (!xdp2_lpm_trie_bm_test(node->internal, idx))
+			return -ENOENT;
+
+		xdp2_lpm_trie_array_remove((void ***)&node->values,
+				xdp2_lpm_trie_bm_count(node->internal),
+				xdp2_lpm_trie_bm_rank(node->internal, idx));
+		xdp2_lpm_trie_bm_clear(node->internal, idx);
+
+		return 0;
+	}
+
+	child = xdp2_lpm_trie_get_child(trie, node, k[depth], false);
+	if (!child)
+		return -ENOENT;
+
+	err = __xdp2_lpm_trie_delete(trie, child, k, depth + 1, prefix_len);
+	if (err)
+		return err;
+
+	if (xdp2_lpm_trie_node_empty(child))
+		xdp2_lpm_trie_remove_child(trie, node, k[depth]);
+
+	return 0;
+}
+
+int xdp2_lpm_trie_delete(struct xdp2_lpm_trie *trie, const void *key,
+			 size_t prefix_len)
+{
+	int err;
+
+	if (!trie->root || prefix_len > trie->key_len * 8)
+		return -ENOENT;
+
+	if (trie->qsbr) {
+		err = xdp2_lpm_trie_cow_update(trie, key, prefix_len, NULL,
+					       false);
+		if (!err)
+			trie->num_prefixes--;
+
+		return err;
+	}
+
+	err = __xdp2_lpm_trie_delete(trie, trie->root, key, 0, prefix_len);
+	if (err)
+		return err;
+
+	trie->num_prefixes--;
+
+	if (xdp2_lpm_trie_node_empty(trie->root)) {
+		free(trie->root);
+		trie->root = NULL;
+		trie->num_nodes = 0;
+	}
+
+	return 0;
+}
+
+int xdp2_lpm_trie_replace(struct xdp2_lpm_trie *trie, const void *key,
+			  size_t prefix_len, const void *value)
+{
+	struct xdp2_lpm_trie_node *node = trie->root;
+	size_t depth = prefix_len / 8, i;
+	const __u8 *k = key;
+	unsigned int idx;
+
+	if (prefix_len > trie->key_len * 8)
+		return -ENOENT;
+
+	for (i = 0; node && i < depth; i++)
+		node = xdp2_lpm_trie_get_child(trie, node, k[i], false);
+
+	if (!node)
+		return -ENOENT;
+
+	idx = xdp2_lpm_trie_pfx_index(depth < trie->key_len ? k[depth] : 0,
+				      prefix_len % 8);
+	if (!xdp2_lpm_trie_bm_test(node->internal, idx))
+		return -ENOENT;
+
+	/* A single pointer store, so lookups see the old or new value */
+	__atomic_store_n(&node->values[xdp2_lpm_trie_bm_rank(node->internal,
+							     idx)],
+			 value, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+const void *xdp2_lpm_trie_find(const struct xdp2_lpm_trie *trie,
+			       const void *key, size_t prefix_len)
+{
+	const struct xdp2_lpm_trie_node *node = trie->root;
+	size_t depth = prefix_len / 8, i;
+	const __u8 *k = key;
+	unsigned int idx;
+
+	if (prefix_len > trie->key_len * 8)
+		return NULL;
+
+	for (i = 0; node && i < depth; i++) {
+		if (!xdp2_lpm_trie_bm_test(node->external, k[i]))
+			return NULL;
+		node = &node->children[xdp2_lpm_trie_bm_rank(node->external,
+							     k[i])];
+	}
+
+	if (!node)
+		return NULL;
+
+	idx = xdp2_lpm_trie_pfx_index(depth < trie->key_len ? k[depth] : 0,
+				      prefix_len % 8);
+	if (!xdp2_lpm_trie_bm_test(node->internal, idx))
+		return NULL;
+
+	return node->values[xdp2_lpm_trie_bm_rank(node->internal, idx)];
+}
+
+/* Longest prefix match lookup. At each node the longest prefix that
+ * terminates in the node is found by checking the internal bitmap from
+ * the longest prefix length down. Since nodes deeper in the trie hold
+ * longer prefixes, a match in a node overrides a match in its ancestors.
+ * The value is only fetched for the final match
+ */
+const void *xdp2_lpm_trie_lookup(const struct xdp2_lpm_trie *trie,
+				 const void *key)
+{
+	const struct xdp2_lpm_trie_node *node, *match = NULL;
+	unsigned int byte, idx, match_idx = 0;
+	const __u8 *k = key;
+	size_t depth;
+	int plen;
+
+	node = xdp2_rcu_dereference(trie->root);
+
+	for (depth = 0; node; depth++) {
+		byte = depth < trie->key_len ? k[depth] : 0;
+
+		if (!xdp2_lpm_trie_bm_empty(node->internal)) {
+			for (plen = 7; plen >= 0; plen--) {
+				idx = xdp2_lpm_trie_pfx_index(byte, plen);
+				if (xdp2_lpm_trie_bm_test(node->internal,
+							  idx)) {
+					match = node;
+					match_idx = idx;
+					break;
+				}
+			}
+		}
+
+		if (depth == trie->key_len ||
+		    !xdp2_lpm_trie_bm_test(node->external, byte))
+			break;
+
+		node = &node->children[xdp2_lpm_trie_bm_rank(node->external,
+							     byte)];
+	}
+
+	if (!match)
+		return NULL;
+
+	return xdp2_rcu_dereference(match->values[
+			xdp2_lpm_trie_bm_rank(match->internal, match_idx)]);
+}
+
+const struct xdp2_lpm_trie *xdp2_lpm_trie_get_static(
+		struct xdp2_lpm_trie **ptrie, const void *entries,
+		unsigned int num_els, size_t entry_size, size_t key_len,
+		size_t prefix_len_off)
+{
+	struct xdp2_lpm_trie *trie, *expected = NULL;
+	unsigned int i, prefix_len;
+	const __u8 *entry;
+	int err;
+
+	trie = __atomic_load_n(ptrie, __ATOMIC_ACQUIRE);
+	if (trie)
+		return trie;
+
+	trie = malloc(sizeof(*trie));
+	if (!trie)
+		return NULL;
+
+	xdp2_lpm_trie_init(trie, key_len);
+
+	for (i = 0; i < num_els; i++) {
+		entry = (const __u8 *)entries + i * entry_size;
+		prefix_len = *(const unsigned int *)(entry + prefix_len_off);
+
+		/* Zero length prefixes never matched in the linear lookup
+		 * of static tables (the default target covers that case).
+		 * For duplicate prefixes the first entry wins
+		 */
+		if (!prefix_len)
+			continue;
+
+		err = xdp2_lpm_trie_insert(trie, entry, prefix_len, entry);
+		if (err == -ENOMEM) {
+			xdp2_lpm_trie_destroy(trie);
+			free(trie);
+			return NULL;
+		}
+	}
+
+	/* Another thread may have built the trie concurrently */
+	if (!__atomic_compare_exchange_n(ptrie, &expected, trie, false,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		xdp2_lpm_trie_destroy(trie);
+		free(trie);
+		return expected;
+	}
+
+	return trie;
+}
@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Placement of large memory regions (see xdp2/mem.h) */
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "xdp2/mem.h"
+#include "xdp2/utility.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT	26
+#endif
+
+/* Memory mapped by xdp2_mem_alloc. Allocations are few and large so a
+ * list is enough to find the length to unmap
+ */
+struct xdp2_mem_region {
+	void *addr;
+	size_t len;
+	size_t page_bytes;
+	struct xdp2_mem_region *next;
+};
+
+static struct xdp2_mem_region *xdp2_mem_regions;
+static pthread_mutex_t xdp2_mem_lock = PTHREAD_MUTEX_INITIALIZER;
+
+size_t xdp2_mem_page_bytes(enum xdp2_mem_page_size page_size)
+{
+	switch (page_size) {
+	case XDP2_MEM_PAGE_2M:
+		return 1UL << 21;
+	case XDP2_MEM_PAGE_1G:
+		return 1UL << 30;
+	default:
+		return sysconf(_SC_PAGESIZE);
+	}
+}
+
+int xdp2_mem_bind(void *p, size_t size, unsigned int node)
+{
+	unsigned long mask[XDP2_MEM_MAX_NODES / (8 * sizeof(long))] = {};
+
+	if (node >= XDP2_MEM_MAX_NODES)
+		return -EINVAL;
+
+	mask[node / (8 * sizeof(long))] = 1UL << (node % (8 * sizeof(long)));
+
+	/* The kernel reads maxnode - 1 bits of the mask */
+	if (syscall(SYS_mbind, p, size, MPOL_BIND, mask,
+		    XDP2_MEM_MAX_NODES + 1, 0) < 0)
+		return -errno;
+
+	return 0;
+}
+
+void xdp2_mem_prefault(void *p, size_t size, size_t page_bytes)
+{
+	volatile __u8 *bytes = p;
+	size_t off;
+
+	for (off = 0; off < size; off += page_bytes)
+		bytes[off] = 0;
+}
+
+/* Map anonymous memory backed by hugepages, or by regular pages if no
+ * hugepages are available and fallback is allowed. Returns the page size
+ * or zero on failure
+ */
+static size_t xdp2_mem_map(void **pp, size_t len,
+			   const struct xdp2_mem_config *config)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	size_t page_bytes;
+	void *p;
+
+	if (config->page_size != XDP2_MEM_PAGE_DEFAULT) {
+		page_bytes = xdp2_mem_page_bytes(config->page_size);
+
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 flags | MAP_HUGETLB |
+				(__builtin_ctzl(page_bytes) << MAP_HUGE_SHIFT),
+			 -1, 0);
+		if (p != MAP_FAILED) {
+			*pp = p;
+			return page_bytes;
+		}
+
+		if (config->no_fallback) {
+			XDP2_WARN("Mapping %lu bytes of %lu byte hugepages "
+				  "failed: %s", len, page_bytes,
+				  strerror(errno));
+			return 0;
+		}
+	}
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (p == MAP_FAILED)
+		return 0;
+
+	/* Regular pages, let the kernel use transparent hugepages */
+	if (config->page_size != XDP2_MEM_PAGE_DEFAULT)
+		madvise(p, len, MADV_HUGEPAGE);
+
+	*pp = p;
+
+	return xdp2_mem_page_bytes(XDP2_MEM_PAGE_DEFAULT);
+}
+
+void *xdp2_mem_alloc(size_t size, const struct xdp2_mem_config *config)
+{
+	struct xdp2_mem_region *region;
+	size_t len, page_bytes;
+	void *p;
+	int err;
+
+	if (xdp2_mem_config_is_default(config))
+		return calloc(1, size);
+
+	region = malloc(sizeof(*region));
+	if (!region)
+		return NULL;
+
+	/* Round up to the requested page size even if the allocation falls
+	 * back to regular pages
+	 */
+	len = xdp2_round_up(size ? : 1,
+			    xdp2_mem_page_bytes(config->page_size));
+
+	page_bytes = xdp2_mem_map(&p, len, config);
+	if (!page_bytes) {
+		free(region);
+		return NULL;
+	}
+
+	if (config->numa_bind) {
+		err = xdp2_mem_bind(p, len, config->numa_node);
+		if (err) {
+			XDP2_WARN("Binding memory to NUMA node %u failed: %s",
+				  config->numa_node, strerror(-err));
+			munmap(p, len);
+			free(region);
+			return NULL;
+		}
+	}
+
+	if (config->prefault)
+		xdp2_mem_prefault(p, len, page_bytes);
+
+	region->addr = p;
+	region->len = len;
+	region->page_bytes = page_bytes;
+
+	pthread_mutex_lock(&xdp2_mem_lock);
+	region->next = xdp2_mem_regions;
+	xdp2_mem_regions = region;
+	pthread_mutex_unlock(&xdp2_mem_lock);
+
+	return p;
+}
+
+/* Find and optionally unlink the region for an address */
+static struct xdp2_mem_region *xdp2_mem_find_region(const void *p,
+						    bool unlink)
+{
+	struct xdp2_mem_region **pregion, *region;
+
+	pthread_mutex_lock(&xdp2_mem_lock);
+
+	for (pregion = &xdp2_mem_regions; (region = *pregion);
+	     pregion = &region->next) {
+		if (region->addr == p) {
+			if (unlink)
+				*pregion = region->next;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&xdp2_mem_lock);
+
+	return region;
+}
+
+void xdp2_mem_free(void *p)
+{
+	struct xdp2_mem_region *region;
+
+	if (!p)
+		return;
+
+	region = xdp2_mem_find_region(p, true);
+	if (!region) {
+		/* Allocated with calloc */
+		free(p);
+		return;
+	}
+
+	munmap(region->addr, region->len);
+	free(region);
+}
+
+size_t xdp2_mem_alloc_page_bytes(const void *p)
+{
+	struct xdp2_mem_region *region = xdp2_mem_find_region(p, false);
+
+	return region ? region->page_bytes :
+			xdp2_mem_page_bytes(XDP2_MEM_PAGE_DEFAULT);
+}
+
+int xdp2_mem_cpu_node(unsigned int cpu)
+{
+	struct dirent *ent;
+	char path[64];
+	int node = -1;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+
+	dir = opendir(path);
+	if (!dir)
+		return -1;
+
+	while ((ent = readdir(dir))) {
+		if (!strncmp(ent->d_name, "node", 4) &&
+		    sscanf(ent->d_name + 4, "%d", &node) == 1)
+			break;
+	}
+
+	closedir(dir);
+
+	return node;
+}
+
+int xdp2_mem_current_node(void)
+{
+	unsigned int cpu, node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) < 0)
+		return -1;
+
+	return node;
+}
+
+unsigned int xdp2_mem_num_nodes(void)
+{
+	unsigned int first, last;
+	int n, ret = 1;
+	FILE *f;
+
+	/* The file has a range like 0-3, or just 0 */
+	f = fopen("/sys/devices/system/node/possible", "r");
+	if (!f)
+		return 1;
+
+	n = fscanf(f, "%u-%u", &first, &last);
+	if (n == 2)
+		ret = last + 1;
+	else if (n == 1)
+		ret = first + 1;
+
+	fclose(f);
+
+	return xdp2_min(ret, XDP2_MEM_MAX_NODES);
+}
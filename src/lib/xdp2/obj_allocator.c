@@ -24,11 +24,14 @@
  * SUCH DAMAGE.
  */
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include "xdp2/obj_allocator.h"
 
+__thread struct xdp2_obj_alloc_thread_cache *__xdp2_obj_alloc_thread_cache;
+
 static void *alloc_objects(size_t num_objs, size_t obj_size)
 {
 	if (obj_size < sizeof(void *) || num_objs == 0)
@@ -49,6 +52,8 @@ static void __xdp2_obj_alloc_common_init(
 	allocator->max_objs = num_objs;
 	allocator->addr_xlat_num = addr_xlat_num;
 	allocator->base_index = base_index;
+	allocator->cache_size = 0;
+	allocator->cache_batch = 0;
 
 	strncpy(allocator->name, name, XDP2_OBJ_ALLOC_NAME_LEN);
 	/* Ensure NULL terminated */
@@ -79,6 +84,13 @@ void __xdp2_obj_alloc_free_list_init(
 	__xdp2_obj_alloc_common_init(allocator, num_objs, obj_size,
 				      base, name, base_index, addr_xlat_num);
 	afl->num_free = num_objs;
+	afl->allocs = 0;
+	afl->alloc_fails = 0;
+	afl->num_cached = 0;
+	afl->cache_allocs = 0;
+	afl->cache_frees = 0;
+	afl->cache_refills = 0;
+	afl->cache_flushes = 0;
 	/* Save the base object by its relative address */
 	afl->free_list = XDP2_ADDR_REV_XLAT(addr_xlat_num, base);
 
@@ -174,6 +186,347 @@ void __xdp2_obj_alloc_show_allocator(struct xdp2_obj_allocator *allocator,
 			allocator->max_objs, afl->num_free,
 			afl->allocs, afl->alloc_fails);
 
+	if (allocator->cache_size)
+		XDP2_CLI_PRINT(cli, "\tthread cache: size: %u, batch: %u, "
+				    "num_cached: %u, cache_allocs: %lu, "
+				    "cache_frees: %lu, refills: %lu, "
+				    "flushes: %lu\n",
+				allocator->cache_size, allocator->cache_batch,
+				afl->num_cached, afl->cache_allocs,
+				afl->cache_frees, afl->cache_refills,
+				afl->cache_flushes);
+
 	if (cb)
 		cb(allocator, cli, arg);
 }
+
+/* Bulk operations on the shared free list. The caller holds the mutex */
+
+static unsigned int __free_list_alloc_bulk_locked(
+		struct xdp2_obj_allocator *allocator, void **objs,
+		unsigned int num)
+{
+	struct xdp2_obj_allocator_free_list *afl =
+				&allocator->alloc_free_list;
+	unsigned int i;
+	void *obj;
+
+	for (i = 0; i < num && afl->num_free; i++) {
+		obj = XDP2_ADDR_XLAT(allocator->addr_xlat_num, afl->free_list);
+		afl->free_list = *(void **)obj;
+		afl->num_free--;
+		objs[i] = obj;
+	}
+
+	afl->allocs += i;
+	if (i < num)
+		afl->alloc_fails++;
+
+	return i;
+}
+
+/* Link the objects into a chain before taking the lock so that pushing them
+ * onto the free list under the lock is constant time
+ */
+static void *__free_list_make_chain(struct xdp2_obj_allocator *allocator,
+				    void **objs, unsigned int num)
+{
+	unsigned int i;
+
+	for (i = 0; i < num - 1; i++) {
+#ifdef XDP2_OBJ_ALLOC_DEBUG // For debugging
+		__xdp2_obj_alloc_check_freed(allocator, objs[i]);
+#endif
+		*(void **)objs[i] = XDP2_ADDR_REV_XLAT(allocator->addr_xlat_num,
+						       objs[i + 1]);
+	}
+
+	return objs[num - 1];
+}
+
+static void __free_list_free_chain_locked(
+		struct xdp2_obj_allocator *allocator, void *first, void *last,
+		unsigned int num)
+{
+	struct xdp2_obj_allocator_free_list *afl =
+				&allocator->alloc_free_list;
+
+	*(void **)last = afl->free_list;
+	afl->free_list = XDP2_ADDR_REV_XLAT(allocator->addr_xlat_num, first);
+	afl->num_free += num;
+}
+
+/* Per-thread caches */
+
+static pthread_key_t thread_cache_key;
+static pthread_once_t thread_cache_key_once = PTHREAD_ONCE_INIT;
+
+static void thread_cache_destructor(void *arg)
+{
+	xdp2_obj_alloc_cache_flush_all();
+}
+
+static void thread_cache_key_init(void)
+{
+	pthread_key_create(&thread_cache_key, thread_cache_destructor);
+}
+
+bool xdp2_obj_alloc_cache_enable(struct xdp2_obj_allocator *allocator,
+				  unsigned int cache_size, unsigned int batch)
+{
+	XDP2_OBJ_ALLOC_CHECK_MAGIC(allocator);
+
+	if (!batch)
+		batch = cache_size > 1 ? cache_size / 2 : 1;
+
+	if (!cache_size || batch > cache_size)
+		return false;
+
+	allocator->cache_batch = batch;
+	allocator->cache_size = cache_size;
+
+	return true;
+}
+
+struct xdp2_obj_alloc_magazine *__xdp2_obj_alloc_new_magazine(
+				struct xdp2_obj_allocator *allocator)
+{
+	struct xdp2_obj_alloc_thread_cache *tcache =
+					__xdp2_obj_alloc_thread_cache;
+	struct xdp2_obj_alloc_magazine *mag;
+	void **objs;
+
+	if (!tcache) {
+		tcache = calloc(1, sizeof(*tcache));
+		if (!tcache)
+			return NULL;
+
+		pthread_once(&thread_cache_key_once, thread_cache_key_init);
+
+		/* The value is only used to trigger the destructor on
+		 * thread exit
+		 */
+		pthread_setspecific(thread_cache_key, tcache);
+		__xdp2_obj_alloc_thread_cache = tcache;
+	}
+
+	/* If the thread has too many magazines or we can't allocate one
+	 * then fall back to the shared free list
+	 */
+	if (tcache->num_mags >= XDP2_OBJ_ALLOC_MAX_THREAD_CACHES)
+		return NULL;
+
+	objs = malloc(allocator->cache_size * sizeof(void *));
+	if (!objs)
+		return NULL;
+
+	mag = &tcache->mags[tcache->num_mags];
+	mag->allocator = allocator;
+	mag->num = 0;
+	mag->allocs = 0;
+	mag->frees = 0;
+	mag->objs = objs;
+
+	/* Make the magazine visible only once it's fully set */
+	tcache->num_mags++;
+
+	return mag;
+}
+
+static void __magazine_sync_stats(struct xdp2_obj_allocator_free_list *afl,
+				  struct xdp2_obj_alloc_magazine *mag)
+{
+	afl->cache_allocs += mag->allocs;
+	afl->cache_frees += mag->frees;
+	mag->allocs = 0;
+	mag->frees = 0;
+}
+
+bool __xdp2_obj_alloc_magazine_refill(struct xdp2_obj_allocator *allocator,
+				       struct xdp2_obj_alloc_magazine *mag)
+{
+	struct xdp2_obj_allocator_free_list *afl =
+				&allocator->alloc_free_list;
+	unsigned int num;
+
+	XDP2_LOCKS_MUTEX_LOCK(&afl->mutex);
+
+	num = __free_list_alloc_bulk_locked(allocator, &mag->objs[mag->num],
+					    allocator->cache_batch);
+	afl->num_cached += num;
+	afl->cache_refills++;
+	__magazine_sync_stats(afl, mag);
+
+	XDP2_LOCKS_MUTEX_UNLOCK(&afl->mutex);
+
+	mag->num += num;
+
+	return !!num;
+}
+
+void __xdp2_obj_alloc_magazine_flush(struct xdp2_obj_allocator *allocator,
+				      struct xdp2_obj_alloc_magazine *mag,
+				      unsigned int num)
+{
+	struct xdp2_obj_allocator_free_list *afl =
+				&allocator->alloc_free_list;
+	void **objs, *last = NULL;
+
+	if (num > mag->num)
+		num = mag->num;
+
+	/* Flush the oldest objects from the bottom of the magazine, the
+	 * most recently freed ones are more likely to be cache hot
+	 */
+	objs = mag->objs;
+	if (num)
+		last = __free_list_make_chain(allocator, objs, num);
+
+	XDP2_LOCKS_MUTEX_LOCK(&afl->mutex);
+
+	if (num)
+		__free_list_free_chain_locked(allocator, objs[0], last, num);
+	afl->num_cached -= num;
+	afl->cache_flushes++;
+	__magazine_sync_stats(afl, mag);
+
+	XDP2_LOCKS_MUTEX_UNLOCK(&afl->mutex);
+
+	mag->num -= num;
+	memmove(objs, &objs[num], mag->num * sizeof(void *));
+}
+
+void xdp2_obj_alloc_cache_flush(struct xdp2_obj_allocator *allocator)
+{
+	struct xdp2_obj_alloc_thread_cache *tcache =
+					__xdp2_obj_alloc_thread_cache;
+	unsigned int i;
+
+	if (!tcache)
+		return;
+
+	for (i = 0; i < tcache->num_mags; i++) {
+		if (tcache->mags[i].allocator == allocator) {
+			__xdp2_obj_alloc_magazine_flush(allocator,
+				&tcache->mags[i], tcache->mags[i].num);
+			return;
+		}
+	}
+}
+
+void xdp2_obj_alloc_cache_flush_all(void)
+{
+	struct xdp2_obj_alloc_thread_cache *tcache =
+					__xdp2_obj_alloc_thread_cache;
+	struct xdp2_obj_alloc_magazine *mag;
+	unsigned int i;
+
+	if (!tcache)
+		return;
+
+	for (i = 0; i < tcache->num_mags; i++) {
+		mag = &tcache->mags[i];
+		__xdp2_obj_alloc_magazine_flush(mag->allocator, mag, mag->num);
+		free(mag->objs);
+	}
+
+	__xdp2_obj_alloc_thread_cache = NULL;
+	pthread_setspecific(thread_cache_key, NULL);
+	free(tcache);
+}
+
+/* Bulk alloc and free */
+
+static unsigned int __free_list_alloc_bulk(
+		struct xdp2_obj_allocator *allocator, void **objs,
+		unsigned int num)
+{
+	struct xdp2_obj_allocator_free_list *afl =
+				&allocator->alloc_free_list;
+
+	XDP2_LOCKS_MUTEX_LOCK(&afl->mutex);
+	num = __free_list_alloc_bulk_locked(allocator, objs, num);
+	XDP2_LOCKS_MUTEX_UNLOCK(&afl->mutex);
+
+	return num;
+}
+
+static void __free_list_free_bulk(struct xdp2_obj_allocator *allocator,
+				  void **objs, unsigned int num)
+{
+	struct xdp2_obj_allocator_free_list *afl =
+				&allocator->alloc_free_list;
+	void *last = __free_list_make_chain(allocator, objs, num);
+
+	XDP2_LOCKS_MUTEX_LOCK(&afl->mutex);
+	__free_list_free_chain_locked(allocator, objs[0], last, num);
+	XDP2_LOCKS_MUTEX_UNLOCK(&afl->mutex);
+}
+
+unsigned int xdp2_obj_alloc_alloc_bulk(struct xdp2_obj_allocator *allocator,
+				       void **objs, unsigned int num)
+{
+	struct xdp2_obj_alloc_magazine *mag;
+	unsigned int n = 0, take;
+
+	XDP2_OBJ_ALLOC_CHECK_MAGIC(allocator);
+
+	mag = xdp2_obj_alloc_get_magazine(allocator);
+	if (!mag)
+		return num ? __free_list_alloc_bulk(allocator, objs, num) : 0;
+
+	while (n < num) {
+		if (!mag->num) {
+			if (num - n >= allocator->cache_size) {
+				/* Large request, bypass the magazine */
+				n += __free_list_alloc_bulk(allocator,
+							    &objs[n], num - n);
+				break;
+			}
+			if (!__xdp2_obj_alloc_magazine_refill(allocator, mag))
+				break;
+		}
+
+		take = xdp2_min(mag->num, num - n);
+		mag->num -= take;
+		memcpy(&objs[n], &mag->objs[mag->num], take * sizeof(void *));
+		mag->allocs += take;
+		n += take;
+	}
+
+	return n;
+}
+
+void xdp2_obj_alloc_free_bulk(struct xdp2_obj_allocator *allocator,
+			      void **objs, unsigned int num)
+{
+	struct xdp2_obj_alloc_magazine *mag;
+	unsigned int take;
+
+	XDP2_OBJ_ALLOC_CHECK_MAGIC(allocator);
+
+	if (!num)
+		return;
+
+	mag = xdp2_obj_alloc_get_magazine(allocator);
+	if (!mag || num >= allocator->cache_size) {
+		/* No magazine or a large request, free directly to the
+		 * shared list
+		 */
+		__free_list_free_bulk(allocator, objs, num);
+		return;
+	}
+
+	while (num) {
+		if (mag->num >= allocator->cache_size)
+			__xdp2_obj_alloc_magazine_flush(allocator, mag,
+							 allocator->cache_batch);
+
+		take = xdp2_min(allocator->cache_size - mag->num, num);
+		memcpy(&mag->objs[mag->num], objs, take * sizeof(void *));
+		mag->num += take;
+		mag->frees += take;
+		objs += take;
+		num -= take;
+	}
+}
@@ -27,6 +27,7 @@
 /* XDP2 main parsing logic */
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <alloca.h>
@@ -34,12 +35,49 @@
 #include "xdp2/parser.h"
 #include "siphash/siphash.h"
 
+/* Lookup a key in the dispatch index of a protocol table. The dispatch index
+ * must be DENSE or SORTED type
+ */
+static __always_inline const void *lookup_dispatch(int key,
+				const struct xdp2_proto_dispatch *dispatch)
+{
+	unsigned int lo = 0, hi, mid;
+
+	if (dispatch->type == XDP2_DISPATCH_DENSE) {
+		mid = (unsigned int)key - (unsigned int)dispatch->min_key;
+
+		return mid < dispatch->num ? dispatch->nodes[mid] : NULL;
+	}
+
+	/* Binary search for the first key that's greater than or equal to
+	 * the lookup key
+	 */
+	hi = dispatch->num;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (dispatch->keys[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo < dispatch->num && dispatch->keys[lo] == key ?
+						dispatch->nodes[lo] : NULL;
+}
+
+/* Check if a protocol table has a dispatch index that is used for lookup */
+#define USE_DISPATCH(TABLE) ((TABLE)->dispatch &&			\
+			     (TABLE)->dispatch->type > XDP2_DISPATCH_LINEAR)
+
 /* Lookup a type in a node table*/
 static const struct xdp2_parse_node *lookup_node(int type,
 				    const struct xdp2_proto_table *table)
 {
 	int i;
 
+	if (USE_DISPATCH(table))
+		return lookup_dispatch(type, table->dispatch);
+
 	for (i = 0; i < table->num_ents; i++)
 		if (type == table->entries[i].value)
 			return table->entries[i].node;
@@ -53,6 +91,9 @@ static const struct xdp2_parse_tlv_node *lookup_tlv_node(int type,
 {
 	int i;
 
+	if (USE_DISPATCH(table))
+		return lookup_dispatch(type, table->dispatch);
+
 	for (i = 0; i < table->num_ents; i++)
 		if (type == table->entries[i].type)
 			return table->entries[i].node;
@@ -66,6 +107,9 @@ static const struct xdp2_parse_arrel_node *lookup_array_node(int type,
 {
 	int i;
 
+	if (USE_DISPATCH(table))
+		return lookup_dispatch(type, table->dispatch);
+
 	for (i = 0; i < table->num_ents; i++)
 		if (type == table->entries[i].type)
 			return table->entries[i].node;
@@ -88,6 +132,9 @@ static const struct xdp2_parse_flag_field_node *lookup_flag_field_node(int idx,
 {
 	int i;
 
+	if (USE_DISPATCH(table))
+		return lookup_dispatch(idx, table->dispatch);
+
 	for (i = 0; i < table->num_ents; i++)
 		if (idx == table->entries[i].index)
 			return table->entries[i].node;
@@ -447,259 +494,378 @@ parse_one_arrel:
 	return XDP2_OKAY;
 }
 
-/* Parse a packet
+/* Per packet parsing state. This is the state that is carried from one
+ * protocol layer to the next in the main parsing loop
+ */
+struct xdp2_parse_state {
+	const struct xdp2_parse_node *parse_node;
+	void *hdr;
+	size_t len;
+	void *frame;
+	unsigned int frame_num;
+	unsigned int nodes;
+};
+
+static __always_inline void xdp2_parse_state_init(
+		const struct xdp2_parser *parser,
+		struct xdp2_parse_state *st, void *hdr, size_t len,
+		void *metadata)
+{
+	st->parse_node = parser->root_node;
+	st->hdr = hdr;
+	st->len = len;
+	st->frame = metadata + parser->config.metameta_size;
+	st->frame_num = 0;
+	st->nodes = parser->config.max_nodes;
+}
+
+/* Parse one protocol layer
  *
- * Arguments:
- *   - parser: Parser being invoked
- *   - node: start root node (may be different than parser->root_node)
- *   - hdr: pointer to start of packet
- *   - len: length of packet
- *   - metadata: metadata structure
- *   - start_node: first node (typically node_ether)
- *   - flags: allowed parameterized parsing
+ * Process the current parse node in the parse state and set up the state
+ * for the next node. Returns XDP2_OKAY if parsing should continue at the
+ * next node, else the XDP2_STOP_* code that terminates parsing
  */
-int __xdp2_parse(const struct xdp2_parser *parser, void *hdr,
-		 size_t len, void *metadata,
-		 struct xdp2_ctrl_data *ctrl, unsigned int flags)
+static __always_inline int xdp2_parse_one_node(
+		const struct xdp2_parser *parser,
+		struct xdp2_parse_state *st, void *metadata,
+		struct xdp2_ctrl_data *ctrl, unsigned int flags)
 {
-	const struct xdp2_parse_node *parse_node = parser->root_node;
-	void *frame = metadata + parser->config.metameta_size;
+	const struct xdp2_parse_node *parse_node = st->parse_node;
+	const struct xdp2_proto_def *proto_def = parse_node->proto_def;
 	const struct xdp2_parse_node *next_parse_node;
-	unsigned int nodes = parser->config.max_nodes;
-	unsigned int frame_num = 0;
+	ssize_t hlen = proto_def->min_len;
+	size_t len = st->len;
+	void *hdr = st->hdr;
 	int type, ret;
 
-	/* Main parsing loop. The loop normal teminates when we encounter a
-	 * leaf node, an error condition, hitting limit on layers of
-	 * encapsulation, protocol condition to stop (i.e. flags that
-	 * indicate to stop at flow label or hitting fragment), or
-	 * unknown protocol result in table lookup for next node.
-	 */
-
-	do {
-		const struct xdp2_proto_def *proto_def = parse_node->proto_def;
-		ssize_t hlen = proto_def->min_len;
+	if (flags & XDP2_F_DEBUG)
+		printf("XDP2 parsing %s, remaining length %zu\n",
+		       proto_def->name, len);
 
-		if (flags & XDP2_F_DEBUG)
-			printf("XDP2 parsing %s, remaining length %zu\n",
-			       proto_def->name, len);
+	ctrl->var.last_node = parse_node;
 
-		ctrl->var.last_node = parse_node;
+	/* Protocol definition length checks */
 
-		/* Protocol definition length checks */
-
-		if (len < hlen) {
-			ret = XDP2_STOP_LENGTH;
-			goto out;
-		}
+	if (len < hlen)
+		return XDP2_STOP_LENGTH;
 
-		if (proto_def->ops.len) {
-			hlen = proto_def->ops.len(hdr, len);
-			if (len < hlen) {
-				ret = XDP2_STOP_LENGTH;
-				goto out;
-			}
+	if (proto_def->ops.len) {
+		hlen = proto_def->ops.len(hdr, len);
+		if (len < hlen)
+			return XDP2_STOP_LENGTH;
 
-			if (hlen < proto_def->min_len) {
-				ret = hlen < 0 ? hlen : XDP2_STOP_LENGTH;
-				goto out;
-			}
-		}
+		if (hlen < proto_def->min_len)
+			return hlen < 0 ? hlen : XDP2_STOP_LENGTH;
+	}
 
-		/* Callback processing order
-		 *    1) Extract Metadata
-		 *    2) Call handler
-		 *    3) Process TLVs or flag fields
-		 *	3.a) Extract metadata from each object
-		 *	3.b) Call handler for each object
-		 *    4) Call post handler
-		 */
+	/* Callback processing order
+	 *    1) Extract Metadata
+	 *    2) Call handler
+	 *    3) Process TLVs or flag fields
+	 *	3.a) Extract metadata from each object
+	 *	3.b) Call handler for each object
+	 *    4) Call post handler
+	 */
 
-		/* Extract metadata */
-		if (parse_node->ops.extract_metadata)
-			parse_node->ops.extract_metadata(hdr, hlen, metadata,
-							 frame, ctrl);
+	/* Extract metadata */
+	if (parse_node->ops.extract_metadata)
+		parse_node->ops.extract_metadata(hdr, hlen, metadata,
+						 st->frame, ctrl);
 
-		/* Call handler */
-		if (parse_node->ops.handler)
-			parse_node->ops.handler(hdr, hlen, metadata,
-						frame, ctrl);
+	/* Call handler */
+	if (parse_node->ops.handler)
+		parse_node->ops.handler(hdr, hlen, metadata, st->frame, ctrl);
 
-		switch (parse_node->node_type) {
-		case XDP2_NODE_TYPE_PLAIN:
-		default:
-			break;
-		case XDP2_NODE_TYPE_TLVS:
-			/* Process TLV nodes */
-			if (parse_node->proto_def->node_type ==
-			    XDP2_NODE_TYPE_TLVS) {
-				/* Need error in case parse_node is TLVs type
-				 * but proto_def is not TLVs type
-				 */
-				ret = xdp2_parse_tlvs(parse_node, hdr, hlen,
-						      metadata, frame, ctrl,
-						      flags);
-				if (ret != XDP2_OKAY)
-					goto out;
-			}
-			break;
-		case XDP2_NODE_TYPE_FLAG_FIELDS:
-			/* Process flag-fields */
-			if (parse_node->proto_def->node_type ==
-						XDP2_NODE_TYPE_FLAG_FIELDS) {
-				/* Need error in case parse_node is flag-fields
-				 * type but proto_def is not flag-fields type
-				 */
-				ret = xdp2_parse_flag_fields(parse_node, hdr,
-							     hlen, metadata,
-							     frame, ctrl,
-							     flags);
-				if (ret != XDP2_OKAY)
-					goto out;
-			}
-			break;
-		case XDP2_NODE_TYPE_ARRAY:
-			/* Process array */
-			if (parse_node->proto_def->node_type ==
-						XDP2_NODE_TYPE_ARRAY) {
-				/* Need error in case parse_node is array
-				 * type but proto_def is not array type
-				 */
-				ret = xdp2_parse_array(parse_node, hdr, hlen,
-						       metadata, frame,
-						       ctrl, flags);
-				if (ret != XDP2_OKAY)
-					goto out;
-			}
-			break;
+	switch (parse_node->node_type) {
+	case XDP2_NODE_TYPE_PLAIN:
+	default:
+		break;
+	case XDP2_NODE_TYPE_TLVS:
+		/* Process TLV nodes */
+		if (parse_node->proto_def->node_type ==
+		    XDP2_NODE_TYPE_TLVS) {
+			/* Need error in case parse_node is TLVs type
+			 * but proto_def is not TLVs type
+			 */
+			ret = xdp2_parse_tlvs(parse_node, hdr, hlen,
+					      metadata, st->frame, ctrl,
+					      flags);
+			if (ret != XDP2_OKAY)
+				return ret;
+		}
+		break;
+	case XDP2_NODE_TYPE_FLAG_FIELDS:
+		/* Process flag-fields */
+		if (parse_node->proto_def->node_type ==
+					XDP2_NODE_TYPE_FLAG_FIELDS) {
+			/* Need error in case parse_node is flag-fields
+			 * type but proto_def is not flag-fields type
+			 */
+			ret = xdp2_parse_flag_fields(parse_node, hdr,
+						     hlen, metadata,
+						     st->frame, ctrl,
+						     flags);
+			if (ret != XDP2_OKAY)
+				return ret;
 		}
+		break;
+	case XDP2_NODE_TYPE_ARRAY:
+		/* Process array */
+		if (parse_node->proto_def->node_type ==
+					XDP2_NODE_TYPE_ARRAY) {
+			/* Need error in case parse_node is array
+			 * type but proto_def is not array type
+			 */
+			ret = xdp2_parse_array(parse_node, hdr, hlen,
+					       metadata, st->frame,
+					       ctrl, flags);
+			if (ret != XDP2_OKAY)
+				return ret;
+		}
+		break;
+	}
 
-		/* Call handler */
-		if (parse_node->ops.post_handler)
-			parse_node->ops.post_handler(hdr, hlen, metadata,
-						     frame, ctrl);
+	/* Call handler */
+	if (parse_node->ops.post_handler)
+		parse_node->ops.post_handler(hdr, hlen, metadata,
+					     st->frame, ctrl);
 
-		/* Proceed to next protocol layer */
+	/* Proceed to next protocol layer */
 
-		if (!parse_node->proto_table && !parse_node->wildcard_node) {
-			/* Leaf parse node */
+	if (!parse_node->proto_table && !parse_node->wildcard_node) {
+		/* Leaf parse node */
 
-			ret = XDP2_STOP_OKAY;
-			goto out;
-		}
+		return XDP2_STOP_OKAY;
+	}
 
-		if (proto_def->encap) {
-			if (parser->config.atencap_node) {
-				ret = __xdp2_parse_run_exit_node(parser,
-					parser->config.atencap_node,
-					metadata, frame, ctrl, flags);
-				if (ret != XDP2_OKAY)
-					goto out;
-			}
+	if (proto_def->encap) {
+		if (parser->config.atencap_node) {
+			ret = __xdp2_parse_run_exit_node(parser,
+				parser->config.atencap_node,
+				metadata, st->frame, ctrl, flags);
+			if (ret != XDP2_OKAY)
+				return ret;
+		}
 
-			/* New encapsulation leyer. Check against
-			 * number of encap layers allowed and also
-			 * if we need a new metadata frame.
-			 */
-			if (++ctrl->var.encaps > parser->config.max_encaps) {
-				ret = XDP2_STOP_ENCAP_DEPTH;
-				goto out;
-			}
+		/* New encapsulation leyer. Check against
+		 * number of encap layers allowed and also
+		 * if we need a new metadata frame.
+		 */
+		if (++ctrl->var.encaps > parser->config.max_encaps)
+			return XDP2_STOP_ENCAP_DEPTH;
 
-			if (parser->config.max_frames > frame_num) {
-				frame += parser->config.frame_size;
-				frame_num++;
-			}
+		if (parser->config.max_frames > st->frame_num) {
+			st->frame += parser->config.frame_size;
+			st->frame_num++;
 		}
+	}
 
-		if (parse_node->proto_table &&
-		    (proto_def->ops.next_proto ||
-		     proto_def->ops.next_proto_keyin)) {
-			/* Lookup next proto */
-
-			type = proto_def->ops.next_proto_keyin ?
-				proto_def->ops.next_proto_keyin(hdr,
-					ctrl->key.keys[parse_node->key_sel]) :
-				proto_def->ops.next_proto(hdr);
-			if (type < 0) {
-				ret = type;
-				goto out;
-			}
+	if (parse_node->proto_table &&
+	    (proto_def->ops.next_proto ||
+	     proto_def->ops.next_proto_keyin)) {
+		/* Lookup next proto */
 
-			/* Get next node */
-			next_parse_node = lookup_node(type,
-						parse_node->proto_table);
+		type = proto_def->ops.next_proto_keyin ?
+			proto_def->ops.next_proto_keyin(hdr,
+				ctrl->key.keys[parse_node->key_sel]) :
+			proto_def->ops.next_proto(hdr);
+		if (type < 0)
+			return type;
 
-			if (next_parse_node)
-				goto found_next;
-		}
+		/* Get next node */
+		next_parse_node = lookup_node(type,
+					parse_node->proto_table);
 
-		/* Try wildcard node. Either table lookup failed to find a node
-		 * or there is only a wildcard
-		 */
-		if (parse_node->wildcard_node) {
-			/* Perform default processing in a wildcard node */
+		if (next_parse_node)
+			goto found_next;
+	}
 
-			next_parse_node = parse_node->wildcard_node;
-		} else {
-			/* Return default code. Parsing will stop
-			 * with the inidicated code
-			 */
+	/* Try wildcard node. Either table lookup failed to find a node
+	 * or there is only a wildcard
+	 */
+	if (parse_node->wildcard_node) {
+		/* Perform default processing in a wildcard node */
 
-			ret = parse_node->unknown_ret;
-			goto out;
-		}
+		next_parse_node = parse_node->wildcard_node;
+	} else {
+		/* Return default code. Parsing will stop
+		 * with the inidicated code
+		 */
 
-		if (parse_node->proto_table &&
-		    proto_def->ops.next_proto) {
-			/* Lookup next proto */
+		return parse_node->unknown_ret;
+	}
 
-			type = proto_def->ops.next_proto(hdr);
-			if (type < 0) {
-				ret = type;
-				goto out;
-			}
+	if (parse_node->proto_table &&
+	    proto_def->ops.next_proto) {
+		/* Lookup next proto */
 
-			/* Get next node */
-			next_parse_node = lookup_node(type,
-						parse_node->proto_table);
-		}
+		type = proto_def->ops.next_proto(hdr);
+		if (type < 0)
+			return type;
+
+		/* Get next node */
+		next_parse_node = lookup_node(type,
+					parse_node->proto_table);
+	}
 found_next:
-		/* Found next parse node, set up to process */
+	/* Found next parse node, set up to process */
 
-		if (!proto_def->overlay) {
-			/* Move over current header */
-			hdr += hlen;
-			len -= hlen;
-		}
+	if (!proto_def->overlay) {
+		/* Move over current header */
+		hdr += hlen;
+		len -= hlen;
+	}
 
-		if (!len && (parse_node->flags &
-			     XDP2_PARSE_NODE_F_ZERO_LEN_OK)) {
-			ret = XDP2_STOP_OKAY;
-			goto out;
-		}
+	if (!len && (parse_node->flags & XDP2_PARSE_NODE_F_ZERO_LEN_OK))
+		return XDP2_STOP_OKAY;
 
-		if (!nodes)
-			return XDP2_STOP_MAX_NODES;
-		nodes--;
+	st->parse_node = next_parse_node;
+	st->hdr = hdr;
+	st->len = len;
 
-		parse_node = next_parse_node;
+	return XDP2_OKAY;
+}
 
-	} while (1);
+/* Finish parsing a packet. Set the return code in the control data and
+ * run the okay or fail exit node
+ */
+static __always_inline int xdp2_parse_finish(const struct xdp2_parser *parser,
+					     struct xdp2_parse_state *st,
+					     void *metadata,
+					     struct xdp2_ctrl_data *ctrl,
+					     unsigned int flags, int ret)
+{
+	const struct xdp2_parse_node *parse_node;
 
-out:
 	parse_node = XDP2_CODE_IS_OKAY(ret) ?
 			parser->config.okay_node : parser->config.fail_node;
 
 	ctrl->var.ret_code = ret;
 
 	if (parse_node)
-		__xdp2_parse_run_exit_node(parser, parse_node, metadata, frame,
-					   ctrl, flags);
+		__xdp2_parse_run_exit_node(parser, parse_node, metadata,
+					   st->frame, ctrl, flags);
 
 	return ret;
 }
 
+/* Parse a packet
+ *
+ * Arguments:
+ *   - parser: Parser being invoked
+ *   - node: start root node (may be different than parser->root_node)
+ *   - hdr: pointer to start of packet
+ *   - len: length of packet
+ *   - metadata: metadata structure
+ *   - start_node: first node (typically node_ether)
+ *   - flags: allowed parameterized parsing
+ */
+int __xdp2_parse(const struct xdp2_parser *parser, void *hdr,
+		 size_t len, void *metadata,
+		 struct xdp2_ctrl_data *ctrl, unsigned int flags)
+{
+	struct xdp2_parse_state st;
+	int ret;
+
+	xdp2_parse_state_init(parser, &st, hdr, len, metadata);
+
+	/* Main parsing loop. The loop normal teminates when we encounter a
+	 * leaf node, an error condition, hitting limit on layers of
+	 * encapsulation, protocol condition to stop (i.e. flags that
+	 * indicate to stop at flow label or hitting fragment), or
+	 * unknown protocol result in table lookup for next node.
+	 */
+
+	while ((ret = xdp2_parse_one_node(parser, &st, metadata,
+					  ctrl, flags)) == XDP2_OKAY) {
+		if (!st.nodes)
+			return XDP2_STOP_MAX_NODES;
+		st.nodes--;
+	}
+
+	return xdp2_parse_finish(parser, &st, metadata, ctrl, flags, ret);
+}
+
+/* Parse a burst of packets
+ *
+ * The packets in the burst are advanced through the parse graph together,
+ * one protocol layer per packet in each round. Packets in a burst
+ * typically follow the same path through the parse graph, so the parse
+ * nodes, protocol definitions, and protocol tables for a layer are hot
+ * in the cache when processing all the packets at that layer. The next
+ * header of each packet is prefetched when the packet advances so that the
+ * load is in flight while the rest of the burst is processed.
+ *
+ * The result for each packet is returned in the ret field of the packet's
+ * burst descriptor. The function returns the number of packets for which
+ * parsing completed with an okay code
+ */
+static unsigned int __xdp2_parse_burst_one(const struct xdp2_parser *parser,
+					   struct xdp2_parse_burst_pkt *pkts,
+					   unsigned int num,
+					   unsigned int flags)
+{
+	struct xdp2_parse_state st[XDP2_PARSE_BURST_MAX];
+	unsigned int active[XDP2_PARSE_BURST_MAX];
+	unsigned int i, j, num_active, num_okay = 0;
+	int ret;
+
+	for (i = 0; i < num; i++) {
+		xdp2_parse_state_init(parser, &st[i], pkts[i].hdr,
+				      pkts[i].len, pkts[i].metadata);
+		__builtin_prefetch(pkts[i].hdr);
+		active[i] = i;
+	}
+	num_active = num;
+
+	while (num_active) {
+		for (i = 0, j = 0; i < num_active; i++) {
+			struct xdp2_parse_burst_pkt *pkt = &pkts[active[i]];
+			struct xdp2_parse_state *pst = &st[active[i]];
+
+			ret = xdp2_parse_one_node(parser, pst, pkt->metadata,
+						  pkt->ctrl, flags);
+			if (ret == XDP2_OKAY) {
+				if (pst->nodes) {
+					/* Packet continues to next round */
+					pst->nodes--;
+					__builtin_prefetch(pst->hdr);
+					active[j++] = active[i];
+					continue;
+				}
+				ret = XDP2_STOP_MAX_NODES;
+			} else {
+				ret = xdp2_parse_finish(parser, pst,
+							pkt->metadata,
+							pkt->ctrl, flags, ret);
+			}
+
+			pkt->ret = ret;
+			if (XDP2_CODE_IS_OKAY(ret))
+				num_okay++;
+		}
+		num_active = j;
+	}
+
+	return num_okay;
+}
+
+unsigned int __xdp2_parse_burst(const struct xdp2_parser *parser,
+				struct xdp2_parse_burst_pkt *pkts,
+				unsigned int num, unsigned int flags)
+{
+	unsigned int num_okay = 0, n;
+
+	while (num) {
+		n = xdp2_min(num, XDP2_PARSE_BURST_MAX);
+		num_okay += __xdp2_parse_burst_one(parser, pkts, n, flags);
+		pkts += n;
+		num -= n;
+	}
+
+	return num_okay;
+}
+
 int __xdp2_parse_fast(const struct xdp2_parser *parser, void *hdr,
 		      size_t len, void *metadata,
 		      struct xdp2_ctrl_data *ctrl)
@@ -917,18 +1083,348 @@ bool xdp2_parse_validate_fast(const struct xdp2_parser *parser)
 	return ret;
 }
 
-siphash_key_t __xdp2_hash_key;
+/* Key and node pair used to sort the entries of a protocol table */
+struct dispatch_ent {
+	int key;
+	unsigned int pos;
+	const void *node;
+};
+
+static int dispatch_ent_cmp(const void *a, const void *b)
+{
+	const struct dispatch_ent *ea = a, *eb = b;
+
+	if (ea->key != eb->key)
+		return ea->key < eb->key ? -1 : 1;
+
+	/* Sort duplicate keys by position in the table so that the first
+	 * entry for a key wins like in a linear search
+	 */
+	return ea->pos < eb->pos ? -1 : ea->pos > eb->pos;
+}
+
+/* Build the dispatch index for a protocol table from the sorted table
+ * entries
+ */
+static int build_dispatch(struct xdp2_proto_dispatch *dispatch,
+			  struct dispatch_ent *ents, unsigned int num)
+{
+	unsigned int i, j, range;
+
+	if (num <= XDP2_DISPATCH_LINEAR_MAX) {
+		dispatch->type = XDP2_DISPATCH_LINEAR;
+		return 0;
+	}
+
+	qsort(ents, num, sizeof(*ents), dispatch_ent_cmp);
+
+	range = (unsigned int)ents[num - 1].key -
+				(unsigned int)ents[0].key + 1;
+
+	if (range && (range <= XDP2_DISPATCH_DENSE_MAX || range / 4 <= num)) {
+		dispatch->nodes = calloc(range, sizeof(*dispatch->nodes));
+		if (!dispatch->nodes)
+			return -ENOMEM;
+
+		/* Iterate in reverse so that the first entry for a duplicate
+		 * key is set
+		 */
+		for (i = num; i > 0; i--)
+			dispatch->nodes[(unsigned int)ents[i - 1].key -
+					(unsigned int)ents[0].key] =
+							ents[i - 1].node;
+
+		dispatch->min_key = ents[0].key;
+		dispatch->num = range;
+		dispatch->type = XDP2_DISPATCH_DENSE;
+
+		return 0;
+	}
+
+	dispatch->keys = calloc(num, sizeof(*dispatch->keys));
+	dispatch->nodes = calloc(num, sizeof(*dispatch->nodes));
+	if (!dispatch->keys || !dispatch->nodes) {
+		free(dispatch->keys);
+		free(dispatch->nodes);
+		dispatch->keys = NULL;
+		dispatch->nodes = NULL;
+		return -ENOMEM;
+	}
+
+	/* Remove duplicate keys, first entry in the table for a key wins */
+	for (i = 0, j = 0; i < num; i++) {
+		if (j && dispatch->keys[j - 1] == ents[i].key)
+			continue;
+		dispatch->keys[j] = ents[i].key;
+		dispatch->nodes[j] = ents[i].node;
+		j++;
+	}
+
+	dispatch->num = j;
+	dispatch->type = XDP2_DISPATCH_SORTED;
+
+	return 0;
+}
+
+/* Create the dispatch index for a protocol table. TABLE is a pointer to a
+ * proto table, TLVs table, array table, or flag-fields table and KEY is the
+ * name of the key field in the table entries
+ */
+#define INIT_DISPATCH(TABLE, KEY) ({					\
+	struct xdp2_proto_dispatch *_dispatch = (TABLE)->dispatch;	\
+	struct dispatch_ent *_ents;					\
+	int _i, _ret = 0;						\
+									\
+	if (_dispatch && _dispatch->type == XDP2_DISPATCH_NONE &&	\
+	    (TABLE)->num_ents > 0) {					\
+		_ents = calloc((TABLE)->num_ents, sizeof(*_ents));	\
+		if (_ents) {						\
+			for (_i = 0; _i < (TABLE)->num_ents; _i++) {	\
+				_ents[_i].key = (TABLE)->entries[_i].KEY;\
+				_ents[_i].pos = _i;			\
+				_ents[_i].node = (TABLE)->entries[_i].node;\
+			}						\
+			_ret = build_dispatch(_dispatch, _ents,		\
+					      (TABLE)->num_ents);	\
+			free(_ents);					\
+		} else {						\
+			_ret = -ENOMEM;					\
+		}							\
+	}								\
+	_ret;								\
+})
+
+/* Set of visited nodes when walking a parse graph in xdp2_parser_init */
+struct visited_nodes {
+	const void **nodes;
+	unsigned int num;
+	unsigned int size;
+};
+
+/* Check if a node has been visited and if not add it to the visited set.
+ * Returns one if the node is newly visited, zero if it was already
+ * visited, or -ENOMEM if it couldn't be added to the set
+ */
+static int visit_node(struct visited_nodes *visited, const void *node)
+{
+	const void **nodes;
+	unsigned int i;
+
+	for (i = 0; i < visited->num; i++)
+		if (visited->nodes[i] == node)
+			return 0;
+
+	if (visited->num >= visited->size) {
+		nodes = realloc(visited->nodes, (visited->size + 64) *
+						sizeof(*nodes));
+		if (!nodes)
+			return -ENOMEM;
+		visited->nodes = nodes;
+		visited->size += 64;
+	}
+
+	visited->nodes[visited->num++] = node;
+
+	return 1;
+}
+
+static int init_parse_node(struct visited_nodes *visited,
+			   const struct xdp2_parse_node *parse_node);
+
+static int init_tlv_node(struct visited_nodes *visited,
+			 const struct xdp2_parse_tlv_node *tlv_node)
+{
+	const struct xdp2_proto_tlvs_table *table;
+	int i, ret;
+
+	if (!tlv_node)
+		return 0;
+
+	ret = visit_node(visited, tlv_node);
+	if (ret <= 0)
+		return ret;
+
+	table = tlv_node->overlay_table;
+	if (table) {
+		ret = INIT_DISPATCH(table, type);
+		if (ret)
+			return ret;
+
+		for (i = 0; i < table->num_ents; i++) {
+			ret = init_tlv_node(visited, table->entries[i].node);
+			if (ret)
+				return ret;
+		}
+	}
+
+	ret = init_tlv_node(visited, tlv_node->overlay_wildcard_node);
+	if (ret)
+		return ret;
+
+	return init_parse_node(visited, tlv_node->nested_node);
+}
+
+static int init_parse_node(struct visited_nodes *visited,
+			   const struct xdp2_parse_node *parse_node)
+{
+	const struct xdp2_proto_table *table;
+	int i, ret;
+
+	if (!parse_node)
+		return 0;
+
+	ret = visit_node(visited, parse_node);
+	if (ret <= 0)
+		return ret;
+
+	switch (parse_node->node_type) {
+	case XDP2_NODE_TYPE_PLAIN:
+	default:
+		break;
+	case XDP2_NODE_TYPE_TLVS: {
+		const struct xdp2_parse_tlvs_node *tlvs_node =
+			(const struct xdp2_parse_tlvs_node *)parse_node;
+		const struct xdp2_proto_tlvs_table *tlv_table =
+			tlvs_node->tlv_proto_table;
+
+		if (tlv_table) {
+			ret = INIT_DISPATCH(tlv_table, type);
+			if (ret)
+				return ret;
+
+			for (i = 0; i < tlv_table->num_ents; i++) {
+				ret = init_tlv_node(visited,
+						tlv_table->entries[i].node);
+				if (ret)
+					return ret;
+			}
+		}
+
+		ret = init_tlv_node(visited, tlvs_node->tlv_wildcard_node);
+		if (ret)
+			return ret;
+		break;
+	}
+	case XDP2_NODE_TYPE_FLAG_FIELDS: {
+		const struct xdp2_parse_flag_fields_node *flag_fields_node =
+			(const struct xdp2_parse_flag_fields_node *)parse_node;
+
+		if (flag_fields_node->flag_fields_proto_table) {
+			ret = INIT_DISPATCH(
+				flag_fields_node->flag_fields_proto_table,
+				index);
+			if (ret)
+				return ret;
+		}
+		break;
+	}
+	case XDP2_NODE_TYPE_ARRAY: {
+		const struct xdp2_parse_array_node *array_node =
+			(const struct xdp2_parse_array_node *)parse_node;
+
+		if (array_node->array_proto_table) {
+			ret = INIT_DISPATCH(array_node->array_proto_table,
+					    type);
+			if (ret)
+				return ret;
+		}
+		break;
+	}
+	}
+
+	table = parse_node->proto_table;
+	if (table) {
+		ret = INIT_DISPATCH(table, value);
+		if (ret)
+			return ret;
+
+		for (i = 0; i < table->num_ents; i++) {
+			ret = init_parse_node(visited, table->entries[i].node);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return init_parse_node(visited, parse_node->wildcard_node);
+}
+
+/* Initialize a parser
+ *
+ * Walk the parse graph of the parser and build the dispatch index for
+ * each protocol table in the graph. Protocol tables are shared between
+ * parsers that use the same parse nodes, so this is a no-op for tables
+ * whose index was already built. Returns zero on success, else a negative
+ * errno value. On failure lookups for the tables without an index fall
+ * back to linear search
+ */
+int xdp2_parser_init(const struct xdp2_parser *parser)
+{
+	struct visited_nodes visited = {};
+	int ret;
+
+	ret = init_parse_node(&visited, parser->root_node);
+	if (!ret)
+		ret = init_parse_node(&visited, parser->config.okay_node);
+	if (!ret)
+		ret = init_parse_node(&visited, parser->config.fail_node);
+	if (!ret)
+		ret = init_parse_node(&visited, parser->config.atencap_node);
+
+	free(visited.nodes);
+
+	return ret;
+}
+
+struct xdp2_hash_key __xdp2_hash_key = {
+	.toeplitz = XDP2_HASH_TOEPLITZ_DEFAULT_KEY,
+};
+enum xdp2_hash_algo __xdp2_hash_algo = XDP2_HASH_SIPHASH;
+
+/* Initialize the SipHash key and derive the seed for the CRC32C and
+ * xxHash3 style hashes from it. The Toeplitz key is left alone since it
+ * needs to match the key programmed in the NIC
+ */
 void xdp2_hash_secret_init(siphash_key_t *init_key)
 {
+	siphash_key_t *skey = &__xdp2_hash_key.siphash;
+
 	if (init_key) {
-		__xdp2_hash_key = *init_key;
+		*skey = *init_key;
 	} else {
-		__u8 *bytes = (__u8 *)&__xdp2_hash_key;
+		__u8 *bytes = (__u8 *)skey;
 		int i;
 
-		for (i = 0; i < sizeof(__xdp2_hash_key); i++)
+		for (i = 0; i < sizeof(*skey); i++)
 			bytes[i] = rand();
 	}
+
+	__xdp2_hash_key.seed = skey->key[0] ^
+			__xdp2_hash_rol64(skey->key[1], 32);
+}
+
+static struct xdp2_hash_toeplitz_tbl xdp2_parser_toeplitz_tbl;
+
+/* Build the Toeplitz lookup tables for the current key */
+static void xdp2_parser_toeplitz_tbl_build(void)
+{
+	xdp2_hash_toeplitz_tbl_init(&xdp2_parser_toeplitz_tbl,
+				    __xdp2_hash_key.toeplitz);
+	__xdp2_hash_key.toeplitz_tbl = &xdp2_parser_toeplitz_tbl;
+}
+
+void xdp2_hash_set_algo(enum xdp2_hash_algo algo)
+{
+	if (algo == XDP2_HASH_TOEPLITZ && !__xdp2_hash_key.toeplitz_tbl)
+		xdp2_parser_toeplitz_tbl_build();
+
+	__xdp2_hash_algo = algo;
+}
+
+void xdp2_hash_set_toeplitz_key(const __u8 *key)
+{
+	memcpy(__xdp2_hash_key.toeplitz, key,
+	       sizeof(__xdp2_hash_key.toeplitz));
+	xdp2_parser_toeplitz_tbl_build();
 }
 
 void xdp2_print_hash_input(const void *start, size_t len)
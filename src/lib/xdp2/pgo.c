@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Edge profiles for profile guided optimization of parsers */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include "xdp2/pgo.h"
+
+/* Make sure the section exists when no instrumented parser is linked in.
+ * The dummy counter has no parser and is skipped
+ */
+struct xdp2_pgo_edge __dummy_pgo_edge XDP2_SECTION_ATTR(xdp2_pgo_section);
+
+unsigned int xdp2_pgo_num_edges(void)
+{
+	struct xdp2_pgo_edge *edge = xdp2_section_base_xdp2_pgo_section();
+	unsigned int i, num_els, num = 0;
+
+	num_els = xdp2_section_array_size_xdp2_pgo_section();
+
+	for (i = 0; i < num_els; i++, edge++)
+		if (edge->parser)
+			num++;
+
+	return num;
+}
+
+void xdp2_pgo_reset(void)
+{
+	struct xdp2_pgo_edge *edge = xdp2_section_base_xdp2_pgo_section();
+	unsigned int i, num_els;
+
+	num_els = xdp2_section_array_size_xdp2_pgo_section();
+
+	for (i = 0; i < num_els; i++, edge++)
+		__atomic_store_n(&edge->hits, 0, __ATOMIC_RELAXED);
+}
+
+int xdp2_pgo_write(FILE *file)
+{
+	struct xdp2_pgo_edge *edge = xdp2_section_base_xdp2_pgo_section();
+	unsigned int i, num_els;
+
+	num_els = xdp2_section_array_size_xdp2_pgo_section();
+
+	fprintf(file, "# xdp2 parser edge profile\n");
+	fprintf(file, "# <parser> <from node> <to node> <hits>\n");
+
+	for (i = 0; i < num_els; i++, edge++) {
+		if (!edge->parser)
+			continue;
+
+		fprintf(file, "%s %s %s %llu\n", edge->parser, edge->from,
+			edge->to, (unsigned long long)__atomic_load_n(
+					&edge->hits, __ATOMIC_RELAXED));
+	}
+
+	return ferror(file) ? -EIO : 0;
+}
+
+int xdp2_pgo_write_file(const char *path)
+{
+	FILE *file;
+	int ret;
+
+	file = fopen(path, "w");
+	if (!file)
+		return -errno;
+
+	ret = xdp2_pgo_write(file);
+
+	if (fclose(file) && !ret)
+		ret = -errno;
+
+	return ret;
+}
@@ -0,0 +1,333 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Packet I/O layer: device registry, bursts, and the loopback backend */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "xdp2/cli.h"
+#include "xdp2/pkt_io.h"
+#include "xdp2/utility.h"
+
+struct xdp2_pkt_io_dev *xdp2_pkt_io_ports[XDP2_PKT_IO_MAX_PORTS];
+unsigned int xdp2_pkt_io_num_devs;
+
+static const struct xdp2_pkt_io_ops *backends[] = {
+	&xdp2_pkt_io_tpacket_ops,
+	&xdp2_pkt_io_xdp_ops,
+	&xdp2_pkt_io_loop_ops,
+};
+
+const struct xdp2_pkt_io_ops *xdp2_pkt_io_find_backend(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(backends); i++)
+		if (!strcmp(backends[i]->name, name))
+			return backends[i];
+
+	return NULL;
+}
+
+struct xdp2_pkt_io_dev *__xdp2_pkt_io_open(struct xdp2_pvbuf_mgr *pvmgr,
+		const char *backend, const struct xdp2_pkt_io_config *config,
+		unsigned int port)
+{
+	const struct xdp2_pkt_io_ops *ops;
+	struct xdp2_pkt_io_dev *dev;
+
+	ops = xdp2_pkt_io_find_backend(backend);
+	if (!ops) {
+		XDP2_WARN("Packet I/O open: unknown backend %s", backend);
+		return NULL;
+	}
+
+	if (port >= XDP2_PKT_IO_MAX_PORTS || xdp2_pkt_io_ports[port]) {
+		XDP2_WARN("Packet I/O open: port %u is invalid or in use",
+			  port);
+		return NULL;
+	}
+
+	dev = calloc(1, sizeof(*dev));
+	if (!dev)
+		return NULL;
+
+	dev->ops = ops;
+	dev->pvmgr = pvmgr;
+	dev->config = *config;
+	dev->port = port;
+	dev->fd = -1;
+
+	if (!dev->config.frame_size)
+		dev->config.frame_size = XDP2_PKT_IO_DEF_FRAME_SIZE;
+	if (!dev->config.num_frames)
+		dev->config.num_frames = XDP2_PKT_IO_DEF_NUM_FRAMES;
+
+	/* Ring sizes are powers of two */
+	dev->config.num_frames =
+		1U << xdp2_get_log_round_up(dev->config.num_frames);
+
+	if (config->ifname) {
+		strncpy(dev->ifname, config->ifname, sizeof(dev->ifname) - 1);
+		dev->ifindex = if_nametoindex(dev->ifname);
+		if (!dev->ifindex) {
+			XDP2_WARN("Packet I/O open: unknown interface %s",
+				  dev->ifname);
+			free(dev);
+			return NULL;
+		}
+	}
+	dev->config.ifname = dev->ifname;
+
+	if (ops->open(dev) < 0) {
+		free(dev);
+		return NULL;
+	}
+
+	xdp2_pkt_io_ports[port] = dev;
+	xdp2_pkt_io_num_devs++;
+
+	return dev;
+}
+
+void xdp2_pkt_io_close(struct xdp2_pkt_io_dev *dev)
+{
+	xdp2_pkt_io_flush(dev);
+
+	dev->ops->close(dev);
+
+	xdp2_pkt_io_ports[dev->port] = NULL;
+	xdp2_pkt_io_num_devs--;
+
+	free(dev);
+}
+
+unsigned int xdp2_pkt_io_recv_burst(struct xdp2_pkt_io_dev *dev,
+				    struct xdp2_pkt_io_pkt *pkts,
+				    unsigned int num)
+{
+	unsigned int i, n;
+
+	n = dev->ops->recv_burst(dev, pkts, num);
+	if (!n)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		pkts[i].dev = dev;
+		dev->stats.rx_bytes += pkts[i].len;
+	}
+
+	dev->stats.rx_packets += n;
+	dev->stats.rx_bursts++;
+
+	return n;
+}
+
+unsigned int xdp2_pkt_io_send_burst(struct xdp2_pkt_io_dev *dev,
+				    struct xdp2_pkt_io_pkt *pkts,
+				    unsigned int num)
+{
+	unsigned int n;
+
+	if (!num)
+		return 0;
+
+	n = dev->ops->send_burst(dev, pkts, num);
+
+	dev->stats.tx_packets += n;
+	dev->stats.tx_drops += num - n;
+	dev->stats.tx_bursts++;
+
+	return n;
+}
+
+void xdp2_pkt_io_flush_all(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < XDP2_PKT_IO_MAX_PORTS; i++)
+		if (xdp2_pkt_io_ports[i])
+			xdp2_pkt_io_flush(xdp2_pkt_io_ports[i]);
+}
+
+int xdp2_pkt_io_poll(struct xdp2_pkt_io_dev *dev, int timeout)
+{
+	struct pollfd pfd = { .fd = dev->fd, .events = POLLIN };
+
+	if (dev->ops->poll)
+		return dev->ops->poll(dev, timeout);
+
+	return poll(&pfd, 1, timeout);
+}
+
+size_t __xdp2_pkt_io_copy_pkt(struct xdp2_pvbuf_mgr *pvmgr,
+			      struct xdp2_pkt_io_pkt *pkt, void *data,
+			      size_t max_len)
+{
+	size_t len;
+
+	if (XDP2_PADDR_IS_PVBUF(pkt->paddr)) {
+		len = __xdp2_pvbuf_calc_length(pvmgr, pkt->paddr, false);
+		if (len > max_len)
+			return 0;
+
+		return __xdp2_pvbuf_copy_pvbuf_to_data(pvmgr, pkt->paddr,
+						       data, len, 0);
+	}
+
+	len = pkt->len;
+	if (len > max_len)
+		return 0;
+
+	memcpy(data, pkt->data, len);
+
+	return len;
+}
+
+void *xdp2_pkt_io_alloc_pbuf_base(unsigned int num_objs, size_t size)
+{
+	void *base;
+
+	base = mmap(NULL, num_objs * size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (base == MAP_FAILED) {
+		XDP2_WARN("Packet I/O: mmap of pbuf base failed: %s",
+			  strerror(errno));
+		return NULL;
+	}
+
+	return base;
+}
+
+void xdp2_pkt_io_show_dev(struct xdp2_pkt_io_dev *dev, void *cli)
+{
+	struct xdp2_pkt_io_stats *stats = &dev->stats;
+
+	XDP2_CLI_PRINT(cli, "Port %u: %s backend %s, queue %u, frame size "
+			    "%u, frames %u\n", dev->port,
+		       dev->ifname[0] ? dev->ifname : "-", dev->ops->name,
+		       dev->config.queue_id, dev->config.frame_size,
+		       dev->config.num_frames);
+	XDP2_CLI_PRINT(cli, "\trx: packets %lu, bytes %lu, drops %lu, "
+			    "bursts %lu\n", stats->rx_packets, stats->rx_bytes,
+		       stats->rx_drops, stats->rx_bursts);
+	XDP2_CLI_PRINT(cli, "\ttx: packets %lu, bytes %lu, drops %lu, "
+			    "bursts %lu, zero-copy %lu\n", stats->tx_packets,
+		       stats->tx_bytes, stats->tx_drops, stats->tx_bursts,
+		       stats->tx_zero_copy);
+}
+
+/* Loopback backend. Sent packets are put on a ring and received from it on
+ * the same device
+ */
+
+struct pkt_io_loop {
+	unsigned int head;
+	unsigned int tail;
+	unsigned int mask;
+	struct xdp2_pkt_io_pkt ring[];
+};
+
+static int pkt_io_loop_open(struct xdp2_pkt_io_dev *dev)
+{
+	unsigned int num = dev->config.num_frames;
+	struct pkt_io_loop *loop;
+
+	loop = calloc(1, sizeof(*loop) + num * sizeof(loop->ring[0]));
+	if (!loop)
+		return -ENOMEM;
+
+	loop->mask = num - 1;
+	dev->priv = loop;
+
+	return 0;
+}
+
+static void pkt_io_loop_close(struct xdp2_pkt_io_dev *dev)
+{
+	struct pkt_io_loop *loop = dev->priv;
+
+	while (loop->head != loop->tail)
+		xdp2_pkt_io_free_pkt(dev->pvmgr,
+				     &loop->ring[loop->head++ & loop->mask]);
+
+	free(loop);
+}
+
+static unsigned int pkt_io_loop_recv_burst(struct xdp2_pkt_io_dev *dev,
+					   struct xdp2_pkt_io_pkt *pkts,
+					   unsigned int num)
+{
+	struct pkt_io_loop *loop = dev->priv;
+	unsigned int n = 0;
+
+	while (n < num && loop->head != loop->tail)
+		pkts[n++] = loop->ring[loop->head++ & loop->mask];
+
+	return n;
+}
+
+static unsigned int pkt_io_loop_send_burst(struct xdp2_pkt_io_dev *dev,
+					   struct xdp2_pkt_io_pkt *pkts,
+					   unsigned int num)
+{
+	struct pkt_io_loop *loop = dev->priv;
+	unsigned int i, n = 0;
+
+	for (i = 0; i < num; i++) {
+		if (loop->tail - loop->head > loop->mask) {
+			xdp2_pkt_io_free_pkt(dev->pvmgr, &pkts[i]);
+			continue;
+		}
+
+		dev->stats.tx_bytes += pkts[i].len;
+		dev->stats.tx_zero_copy++;
+		loop->ring[loop->tail++ & loop->mask] = pkts[i];
+		n++;
+	}
+
+	return n;
+}
+
+static int pkt_io_loop_poll(struct xdp2_pkt_io_dev *dev, int timeout)
+{
+	struct pkt_io_loop *loop = dev->priv;
+
+	return loop->head != loop->tail;
+}
+
+const struct xdp2_pkt_io_ops xdp2_pkt_io_loop_ops = {
+	.name = "loop",
+	.open = pkt_io_loop_open,
+	.close = pkt_io_loop_close,
+	.recv_burst = pkt_io_loop_recv_burst,
+	.send_burst = pkt_io_loop_send_burst,
+	.poll = pkt_io_loop_poll,
+};
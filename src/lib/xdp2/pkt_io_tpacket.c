@@ -0,0 +1,342 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Packet I/O backend for AF_PACKET sockets with TPACKET_V3 rings
+ *
+ * One mmap covers the receive ring followed by the transmit ring. The
+ * receive ring is a ring of blocks; the kernel fills a block with variable
+ * sized frames and retires it to user space when it is full or the block
+ * timeout expires. The transmit ring is a ring of fixed size frames
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "xdp2/pkt_io.h"
+#include "xdp2/utility.h"
+
+#ifndef PACKET_IGNORE_OUTGOING
+#define PACKET_IGNORE_OUTGOING 23
+#endif
+
+/* Block size and block retire timeout (milliseconds) */
+#define PKT_IO_TPACKET_BLOCK_SIZE	(1 << 17)
+#define PKT_IO_TPACKET_BLOCK_TOV	1
+
+/* Offset of packet data in a transmit frame */
+#define PKT_IO_TPACKET_TX_OFF	(TPACKET3_HDRLEN - sizeof(struct sockaddr_ll))
+
+struct pkt_io_tpacket {
+	void *map;
+	size_t map_size;
+
+	void *rx_ring;
+	unsigned int rx_block_nr;
+	unsigned int rx_block;
+	struct tpacket3_hdr *rx_hdr;
+	unsigned int rx_left;
+
+	void *tx_ring;
+	unsigned int tx_frame_size;
+	unsigned int tx_frame_nr;
+	unsigned int tx_frame;
+};
+
+static struct tpacket_block_desc *pkt_io_tpacket_block(
+		struct pkt_io_tpacket *tp, unsigned int block)
+{
+	return tp->rx_ring + (size_t)block * PKT_IO_TPACKET_BLOCK_SIZE;
+}
+
+static void pkt_io_tpacket_close(struct xdp2_pkt_io_dev *dev)
+{
+	struct pkt_io_tpacket *tp = dev->priv;
+
+	if (tp->map)
+		munmap(tp->map, tp->map_size);
+	if (dev->fd >= 0)
+		close(dev->fd);
+
+	free(tp);
+}
+
+static int pkt_io_tpacket_open(struct xdp2_pkt_io_dev *dev)
+{
+	struct xdp2_pkt_io_config *config = &dev->config;
+	struct sockaddr_ll sll = { .sll_family = AF_PACKET };
+	struct tpacket_req3 req = {};
+	int ver = TPACKET_V3, one = 1;
+	struct pkt_io_tpacket *tp;
+	size_t ring_size;
+
+	if (!dev->ifindex) {
+		XDP2_WARN("TPACKET open: an interface is required");
+		return -EINVAL;
+	}
+
+	if (config->frame_size < TPACKET3_HDRLEN ||
+	    config->frame_size & (TPACKET_ALIGNMENT - 1) ||
+	    config->frame_size > PKT_IO_TPACKET_BLOCK_SIZE) {
+		XDP2_WARN("TPACKET open: bad frame size %u",
+			  config->frame_size);
+		return -EINVAL;
+	}
+
+	tp = calloc(1, sizeof(*tp));
+	if (!tp)
+		return -ENOMEM;
+	dev->priv = tp;
+
+	/* Bind to protocol zero until the rings are set up */
+	dev->fd = socket(AF_PACKET, SOCK_RAW, 0);
+	if (dev->fd < 0) {
+		XDP2_WARN("TPACKET open: socket failed: %s", strerror(errno));
+		goto err;
+	}
+
+	if (setsockopt(dev->fd, SOL_PACKET, PACKET_VERSION, &ver,
+		       sizeof(ver)) < 0) {
+		XDP2_WARN("TPACKET open: TPACKET_V3 not supported: %s",
+			  strerror(errno));
+		goto err;
+	}
+
+	/* Don't receive our own transmits, and transmit directly to the
+	 * device. Both are optimizations so failures are ignored
+	 */
+	setsockopt(dev->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one,
+		   sizeof(one));
+	setsockopt(dev->fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one,
+		   sizeof(one));
+
+	ring_size = (size_t)config->num_frames * config->frame_size;
+	tp->rx_block_nr = xdp2_round_up_div(ring_size,
+					    PKT_IO_TPACKET_BLOCK_SIZE);
+	tp->tx_frame_size = config->frame_size;
+	tp->tx_frame_nr = tp->rx_block_nr *
+			(PKT_IO_TPACKET_BLOCK_SIZE / config->frame_size);
+
+	req.tp_block_size = PKT_IO_TPACKET_BLOCK_SIZE;
+	req.tp_block_nr = tp->rx_block_nr;
+	req.tp_frame_size = config->frame_size;
+	req.tp_frame_nr = tp->tx_frame_nr;
+	req.tp_retire_blk_tov = PKT_IO_TPACKET_BLOCK_TOV;
+
+	if (setsockopt(dev->fd, SOL_PACKET, PACKET_RX_RING, &req,
+		       sizeof(req)) < 0) {
+		XDP2_WARN("TPACKET open: RX ring setup failed: %s",
+			  strerror(errno));
+		goto err;
+	}
+
+	req.tp_retire_blk_tov = 0;
+	if (setsockopt(dev->fd, SOL_PACKET, PACKET_TX_RING, &req,
+		       sizeof(req)) < 0) {
+		XDP2_WARN("TPACKET open: TX ring setup failed: %s",
+			  strerror(errno));
+		goto err;
+	}
+
+	tp->map_size = 2 * (size_t)tp->rx_block_nr *
+					PKT_IO_TPACKET_BLOCK_SIZE;
+	tp->map = mmap(NULL, tp->map_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, dev->fd, 0);
+	if (tp->map == MAP_FAILED) {
+		tp->map = NULL;
+		XDP2_WARN("TPACKET open: mmap failed: %s", strerror(errno));
+		goto err;
+	}
+
+	tp->rx_ring = tp->map;
+	tp->tx_ring = tp->map + tp->map_size / 2;
+
+	sll.sll_protocol = htons(config->protocol ? config->protocol :
+						    ETH_P_ALL);
+	sll.sll_ifindex = dev->ifindex;
+	if (bind(dev->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+		XDP2_WARN("TPACKET open: bind to %s failed: %s",
+			  dev->ifname, strerror(errno));
+		goto err;
+	}
+
+	return 0;
+
+err:
+	pkt_io_tpacket_close(dev);
+	return -1;
+}
+
+/* Walk the frames of retired blocks and copy them to pbufs. A block is
+ * handed back to the kernel as soon as its last frame is copied
+ */
+static unsigned int pkt_io_tpacket_recv_burst(struct xdp2_pkt_io_dev *dev,
+					      struct xdp2_pkt_io_pkt *pkts,
+					      unsigned int num)
+{
+	struct pkt_io_tpacket *tp = dev->priv;
+	struct tpacket_block_desc *bd;
+	struct tpacket3_hdr *hdr;
+	unsigned int n = 0;
+	xdp2_paddr_t paddr;
+	void *data;
+
+	while (n < num) {
+		bd = pkt_io_tpacket_block(tp, tp->rx_block);
+
+		if (!tp->rx_hdr) {
+			if (!(__atomic_load_n(&bd->hdr.bh1.block_status,
+					      __ATOMIC_ACQUIRE) &
+			      TP_STATUS_USER))
+				break;
+
+			tp->rx_hdr = (void *)bd +
+					bd->hdr.bh1.offset_to_first_pkt;
+			tp->rx_left = bd->hdr.bh1.num_pkts;
+		}
+
+		while (tp->rx_left && n < num) {
+			hdr = tp->rx_hdr;
+
+			paddr = __xdp2_pbuf_alloc(dev->pvmgr, hdr->tp_snaplen,
+						  false, &data);
+			if (paddr != XDP2_PADDR_NULL) {
+				memcpy(data, (void *)hdr + hdr->tp_mac,
+				       hdr->tp_snaplen);
+				pkts[n].paddr = paddr;
+				pkts[n].data = data;
+				pkts[n].len = hdr->tp_snaplen;
+				n++;
+			} else {
+				dev->stats.rx_drops++;
+			}
+
+			tp->rx_hdr = (void *)hdr + hdr->tp_next_offset;
+			tp->rx_left--;
+		}
+
+		if (tp->rx_left)
+			break;
+
+		/* Done with the block, give it back to the kernel */
+		__atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL,
+				 __ATOMIC_RELEASE);
+		tp->rx_hdr = NULL;
+		if (++tp->rx_block == tp->rx_block_nr)
+			tp->rx_block = 0;
+	}
+
+	return n;
+}
+
+static struct tpacket3_hdr *pkt_io_tpacket_tx_frame(
+		struct xdp2_pkt_io_dev *dev, struct pkt_io_tpacket *tp,
+		bool *kicked)
+{
+	struct tpacket3_hdr *hdr = tp->tx_ring +
+			(size_t)tp->tx_frame * tp->tx_frame_size;
+	unsigned int status;
+
+	status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+	if (status == TP_STATUS_AVAILABLE || status & TP_STATUS_WRONG_FORMAT)
+		return hdr;
+
+	if (*kicked)
+		return NULL;
+
+	/* Ring is full, kick the kernel to transmit what's queued and check
+	 * once more
+	 */
+	*kicked = true;
+	sendto(dev->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+
+	status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+	if (status == TP_STATUS_AVAILABLE || status & TP_STATUS_WRONG_FORMAT)
+		return hdr;
+
+	return NULL;
+}
+
+/* Copy a burst into the transmit ring and kick it with one send */
+static unsigned int pkt_io_tpacket_send_burst(struct xdp2_pkt_io_dev *dev,
+					      struct xdp2_pkt_io_pkt *pkts,
+					      unsigned int num)
+{
+	size_t max_len, len;
+	struct pkt_io_tpacket *tp = dev->priv;
+	unsigned int i, n = 0;
+	struct tpacket3_hdr *hdr;
+	bool kicked = false;
+
+	max_len = tp->tx_frame_size - PKT_IO_TPACKET_TX_OFF;
+
+	for (i = 0; i < num; i++) {
+		hdr = pkt_io_tpacket_tx_frame(dev, tp, &kicked);
+		if (!hdr) {
+			xdp2_pkt_io_free_pkt(dev->pvmgr, &pkts[i]);
+			continue;
+		}
+
+		len = __xdp2_pkt_io_copy_pkt(dev->pvmgr, &pkts[i],
+				(void *)hdr + PKT_IO_TPACKET_TX_OFF, max_len);
+		xdp2_pkt_io_free_pkt(dev->pvmgr, &pkts[i]);
+		if (!len)
+			continue;
+
+		hdr->tp_len = len;
+		hdr->tp_snaplen = len;
+		hdr->tp_next_offset = 0;
+		__atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST,
+				 __ATOMIC_RELEASE);
+
+		if (++tp->tx_frame == tp->tx_frame_nr)
+			tp->tx_frame = 0;
+
+		dev->stats.tx_bytes += len;
+		n++;
+	}
+
+	if (n && sendto(dev->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 &&
+	    errno != EAGAIN && errno != ENOBUFS)
+		XDP2_WARN_ONCE("TPACKET send on %s failed: %s", dev->ifname,
+			       strerror(errno));
+
+	return n;
+}
+
+const struct xdp2_pkt_io_ops xdp2_pkt_io_tpacket_ops = {
+	.name = "tpacket",
+	.open = pkt_io_tpacket_open,
+	.close = pkt_io_tpacket_close,
+	.recv_burst = pkt_io_tpacket_recv_burst,
+	.send_burst = pkt_io_tpacket_send_burst,
+};
@@ -0,0 +1,696 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Packet I/O backend for AF_XDP sockets
+ *
+ * The UMEM is the memory of the pbuf allocator for the frame size, so a
+ * UMEM address is the offset of a pbuf from the allocator base (which is
+ * the offset in a pbuf paddr). Frames are owned by the kernel while they
+ * are on the fill ring, the receive ring, or the transmit and completion
+ * rings; a count of kernel references for each frame is kept so that the
+ * frames still owned by the kernel can be freed when the device is closed
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "xdp2/pkt_io.h"
+#include "xdp2/utility.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+struct pkt_io_xsk_ring {
+	__u32 *producer;
+	__u32 *consumer;
+	__u32 *flags;
+	void *ring;
+	__u32 mask;
+
+	void *map;
+	size_t map_size;
+};
+
+struct pkt_io_xdp {
+	struct pkt_io_xsk_ring rx;
+	struct pkt_io_xsk_ring tx;
+	struct pkt_io_xsk_ring fill;
+	struct pkt_io_xsk_ring comp;
+
+	struct xdp2_pbuf_allocator *pallocator;
+	void *umem_base;
+	unsigned int num_frames;
+	unsigned int size_shift;
+	unsigned int btag;
+	bool one_ref;
+
+	int map_fd;
+	int prog_fd;
+	int link_fd;
+
+	/* Number of kernel references to each frame */
+	__u16 kernel_refs[];
+};
+
+/* Frame helpers */
+
+static xdp2_paddr_t pkt_io_xdp_frame_paddr(struct pkt_io_xdp *x, __u64 addr,
+					   size_t len)
+{
+	return xdp2_pbuf_make_paddr(x->one_ref, x->size_shift,
+				    addr >> x->size_shift,
+				    addr & ((1ULL << x->size_shift) - 1),
+				    len, NULL, NULL);
+}
+
+static void pkt_io_xdp_frame_to_kernel(struct pkt_io_xdp *x, __u64 addr)
+{
+	x->kernel_refs[addr >> x->size_shift]++;
+}
+
+static void pkt_io_xdp_frame_from_kernel(struct pkt_io_xdp *x, __u64 addr)
+{
+	x->kernel_refs[addr >> x->size_shift]--;
+}
+
+static void pkt_io_xdp_free_frame(struct xdp2_pkt_io_dev *dev,
+				  struct pkt_io_xdp *x, __u64 addr)
+{
+	__xdp2_pbuf_free(dev->pvmgr, pkt_io_xdp_frame_paddr(x, addr, 0));
+}
+
+/* Allocate a pbuf for a frame. Returns the UMEM address or -1 */
+static __u64 pkt_io_xdp_alloc_frame(struct xdp2_pkt_io_dev *dev,
+				    struct pkt_io_xdp *x, void **data)
+{
+	unsigned int zindex;
+
+	*data = ___xdp2_pbuf_alloc(dev->pvmgr, x->pallocator, &zindex,
+				   x->one_ref);
+	if (!*data)
+		return -1ULL;
+
+	return (__u64)zindex << x->size_shift;
+}
+
+/* Refill the fill ring from the pbuf allocator */
+static void pkt_io_xdp_refill(struct xdp2_pkt_io_dev *dev,
+			      struct pkt_io_xdp *x)
+{
+	__u32 prod = *x->fill.producer;
+	__u64 *ring = x->fill.ring;
+	__u32 space;
+	void *data;
+	__u64 addr;
+
+	space = x->fill.mask + 1 -
+		(prod - __atomic_load_n(x->fill.consumer, __ATOMIC_ACQUIRE));
+
+	while (space--) {
+		addr = pkt_io_xdp_alloc_frame(dev, x, &data);
+		if (addr == -1ULL)
+			break;
+
+		pkt_io_xdp_frame_to_kernel(x, addr);
+		ring[prod++ & x->fill.mask] = addr;
+	}
+
+	__atomic_store_n(x->fill.producer, prod, __ATOMIC_RELEASE);
+
+	if (*x->fill.flags & XDP_RING_NEED_WAKEUP)
+		recvfrom(dev->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+}
+
+/* Free the frames of completed transmits */
+static void pkt_io_xdp_reap_completions(struct xdp2_pkt_io_dev *dev,
+					struct pkt_io_xdp *x)
+{
+	__u32 prod = __atomic_load_n(x->comp.producer, __ATOMIC_ACQUIRE);
+	__u32 cons = *x->comp.consumer;
+	__u64 *ring = x->comp.ring;
+	__u64 addr;
+
+	if (cons == prod)
+		return;
+
+	while (cons != prod) {
+		addr = ring[cons++ & x->comp.mask];
+		pkt_io_xdp_frame_from_kernel(x, addr);
+		pkt_io_xdp_free_frame(dev, x, addr);
+	}
+
+	__atomic_store_n(x->comp.consumer, cons, __ATOMIC_RELEASE);
+}
+
+/* XDP program
+ *
+ * Redirect packets received on the queue to the socket through an XSKMAP,
+ * optionally only packets with a matching Ethertype. Packets that aren't
+ * redirected are passed to the stack
+ */
+
+#define PKT_IO_BPF_INSN(CODE, DST, SRC, OFF, IMM)			\
+	((struct bpf_insn){ .code = (CODE), .dst_reg = (DST),		\
+			    .src_reg = (SRC), .off = (OFF), .imm = (IMM) })
+
+#define PKT_IO_BPF_LDX(SIZE, DST, SRC, OFF)				\
+	PKT_IO_BPF_INSN(BPF_LDX | BPF_MEM | (SIZE), DST, SRC, OFF, 0)
+#define PKT_IO_BPF_MOV_REG(DST, SRC)					\
+	PKT_IO_BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_X, DST, SRC, 0, 0)
+#define PKT_IO_BPF_MOV_IMM(DST, IMM)					\
+	PKT_IO_BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_K, DST, 0, 0, IMM)
+#define PKT_IO_BPF_ADD_IMM(DST, IMM)					\
+	PKT_IO_BPF_INSN(BPF_ALU64 | BPF_ADD | BPF_K, DST, 0, 0, IMM)
+#define PKT_IO_BPF_JMP_REG(OP, DST, SRC, OFF)				\
+	PKT_IO_BPF_INSN(BPF_JMP | (OP) | BPF_X, DST, SRC, OFF, 0)
+#define PKT_IO_BPF_JMP_IMM(OP, DST, IMM, OFF)				\
+	PKT_IO_BPF_INSN(BPF_JMP | (OP) | BPF_K, DST, 0, OFF, IMM)
+#define PKT_IO_BPF_LD_MAP_FD(DST, FD)					\
+	PKT_IO_BPF_INSN(BPF_LD | BPF_DW | BPF_IMM, DST,		\
+			BPF_PSEUDO_MAP_FD, 0, FD),			\
+	PKT_IO_BPF_INSN(0, 0, 0, 0, 0)
+#define PKT_IO_BPF_CALL(FUNC)						\
+	PKT_IO_BPF_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, FUNC)
+#define PKT_IO_BPF_EXIT()						\
+	PKT_IO_BPF_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+
+static int pkt_io_sys_bpf(int cmd, union bpf_attr *attr)
+{
+	return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/* Create the XSKMAP with the socket for the device queue */
+static int pkt_io_xdp_create_map(struct xdp2_pkt_io_dev *dev,
+				 struct pkt_io_xdp *x)
+{
+	__u32 key = dev->config.queue_id, value = dev->fd;
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_XSKMAP;
+	attr.key_size = sizeof(key);
+	attr.value_size = sizeof(value);
+	attr.max_entries = key + 1;
+	x->map_fd = pkt_io_sys_bpf(BPF_MAP_CREATE, &attr);
+	if (x->map_fd < 0) {
+		XDP2_WARN("XDP open: XSKMAP create failed: %s",
+			  strerror(errno));
+		return -1;
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = x->map_fd;
+	attr.key = (uintptr_t)&key;
+	attr.value = (uintptr_t)&value;
+	if (pkt_io_sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+		XDP2_WARN("XDP open: XSKMAP update failed: %s",
+			  strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Load the program (the map must be created first) and attach it */
+static int pkt_io_xdp_load_prog(struct xdp2_pkt_io_dev *dev,
+				struct pkt_io_xdp *x)
+{
+	struct bpf_insn filter[] = {
+		/* r2 = data, r3 = data_end, r4 = rx_queue_index */
+		PKT_IO_BPF_LDX(BPF_W, BPF_REG_2, BPF_REG_1,
+			       offsetof(struct xdp_md, data)),
+		PKT_IO_BPF_LDX(BPF_W, BPF_REG_3, BPF_REG_1,
+			       offsetof(struct xdp_md, data_end)),
+		PKT_IO_BPF_LDX(BPF_W, BPF_REG_4, BPF_REG_1,
+			       offsetof(struct xdp_md, rx_queue_index)),
+
+		/* if (data + ETH_HLEN > data_end) goto pass */
+		PKT_IO_BPF_MOV_REG(BPF_REG_5, BPF_REG_2),
+		PKT_IO_BPF_ADD_IMM(BPF_REG_5, ETH_HLEN),
+		PKT_IO_BPF_JMP_REG(BPF_JGT, BPF_REG_5, BPF_REG_3, 8),
+
+		/* if (eth->h_proto != protocol) goto pass */
+		PKT_IO_BPF_LDX(BPF_H, BPF_REG_5, BPF_REG_2,
+			       offsetof(struct ethhdr, h_proto)),
+		PKT_IO_BPF_JMP_IMM(BPF_JNE, BPF_REG_5,
+				   htons(dev->config.protocol), 6),
+
+		/* return bpf_redirect_map(&xskmap, rx_queue_index,
+		 *			   XDP_PASS)
+		 */
+		PKT_IO_BPF_MOV_REG(BPF_REG_2, BPF_REG_4),
+		PKT_IO_BPF_LD_MAP_FD(BPF_REG_1, x->map_fd),
+		PKT_IO_BPF_MOV_IMM(BPF_REG_3, XDP_PASS),
+		PKT_IO_BPF_CALL(BPF_FUNC_redirect_map),
+		PKT_IO_BPF_EXIT(),
+
+		/* pass: return XDP_PASS */
+		PKT_IO_BPF_MOV_IMM(BPF_REG_0, XDP_PASS),
+		PKT_IO_BPF_EXIT(),
+	};
+	struct bpf_insn all[] = {
+		/* return bpf_redirect_map(&xskmap, ctx->rx_queue_index,
+		 *			   XDP_PASS)
+		 */
+		PKT_IO_BPF_LDX(BPF_W, BPF_REG_2, BPF_REG_1,
+			       offsetof(struct xdp_md, rx_queue_index)),
+		PKT_IO_BPF_LD_MAP_FD(BPF_REG_1, x->map_fd),
+		PKT_IO_BPF_MOV_IMM(BPF_REG_3, XDP_PASS),
+		PKT_IO_BPF_CALL(BPF_FUNC_redirect_map),
+		PKT_IO_BPF_EXIT(),
+	};
+	static char log[4096];
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_XDP;
+	attr.expected_attach_type = BPF_XDP;
+	if (dev->config.protocol) {
+		attr.insns = (uintptr_t)filter;
+		attr.insn_cnt = ARRAY_SIZE(filter);
+	} else {
+		attr.insns = (uintptr_t)all;
+		attr.insn_cnt = ARRAY_SIZE(all);
+	}
+	attr.license = (uintptr_t)"Dual BSD/GPL";
+	attr.log_buf = (uintptr_t)log;
+	attr.log_size = sizeof(log);
+	attr.log_level = 1;
+	x->prog_fd = pkt_io_sys_bpf(BPF_PROG_LOAD, &attr);
+	if (x->prog_fd < 0) {
+		XDP2_WARN("XDP open: program load failed: %s\n%s",
+			  strerror(errno), log);
+		return -1;
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	attr.link_create.prog_fd = x->prog_fd;
+	attr.link_create.target_ifindex = dev->ifindex;
+	attr.link_create.attach_type = BPF_XDP;
+	attr.link_create.flags = dev->config.drv_mode ? XDP_FLAGS_DRV_MODE :
+							XDP_FLAGS_SKB_MODE;
+	x->link_fd = pkt_io_sys_bpf(BPF_LINK_CREATE, &attr);
+	if (x->link_fd < 0) {
+		XDP2_WARN("XDP open: attach to %s failed: %s", dev->ifname,
+			  strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Socket setup */
+
+static int pkt_io_xdp_map_ring(struct xdp2_pkt_io_dev *dev,
+			       struct pkt_io_xsk_ring *ring,
+			       struct xdp_ring_offset *off, size_t desc_size,
+			       off_t pgoff)
+{
+	__u32 num = dev->config.num_frames;
+
+	ring->map_size = off->desc + num * desc_size;
+	ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, dev->fd, pgoff);
+	if (ring->map == MAP_FAILED) {
+		ring->map = NULL;
+		XDP2_WARN("XDP open: ring mmap failed: %s", strerror(errno));
+		return -1;
+	}
+
+	ring->producer = ring->map + off->producer;
+	ring->consumer = ring->map + off->consumer;
+	ring->flags = ring->map + off->flags;
+	ring->ring = ring->map + off->desc;
+	ring->mask = num - 1;
+
+	return 0;
+}
+
+static void pkt_io_xdp_unmap_ring(struct pkt_io_xsk_ring *ring)
+{
+	if (ring->map)
+		munmap(ring->map, ring->map_size);
+}
+
+static void pkt_io_xdp_close(struct xdp2_pkt_io_dev *dev)
+{
+	struct pkt_io_xdp *x = dev->priv;
+	unsigned int i;
+
+	/* Detach the program first so no more packets are redirected */
+	if (x->link_fd >= 0)
+		close(x->link_fd);
+	if (x->prog_fd >= 0)
+		close(x->prog_fd);
+	if (x->map_fd >= 0)
+		close(x->map_fd);
+	if (dev->fd >= 0)
+		close(dev->fd);
+
+	pkt_io_xdp_unmap_ring(&x->rx);
+	pkt_io_xdp_unmap_ring(&x->tx);
+	pkt_io_xdp_unmap_ring(&x->fill);
+	pkt_io_xdp_unmap_ring(&x->comp);
+
+	/* Frames that were owned by the kernel are back to us */
+	for (i = 0; i < x->num_frames; i++)
+		while (x->kernel_refs[i]) {
+			x->kernel_refs[i]--;
+			pkt_io_xdp_free_frame(dev, x,
+					      (__u64)i << x->size_shift);
+		}
+
+	free(x);
+}
+
+static int pkt_io_xdp_open(struct xdp2_pkt_io_dev *dev)
+{
+	struct xdp2_pkt_io_config *config = &dev->config;
+	struct xdp2_pvbuf_mgr *pvmgr = dev->pvmgr;
+	struct xdp2_pbuf_allocator_entry *entry;
+	struct sockaddr_xdp sxdp = {};
+	struct xdp_umem_reg mr = {};
+	struct xdp_mmap_offsets off;
+	struct xdp2_obj_allocator *allocator;
+	__u32 num = config->num_frames;
+	socklen_t optlen = sizeof(off);
+	unsigned int size_shift, btag;
+	struct pkt_io_xdp *x;
+
+	if (!dev->ifindex) {
+		XDP2_WARN("XDP open: an interface is required");
+		return -EINVAL;
+	}
+
+	/* Aligned UMEM chunks are a power of two from 2048 to a page */
+	size_shift = xdp2_get_log(config->frame_size);
+	if (config->frame_size != 1U << size_shift ||
+	    config->frame_size < 2048 ||
+	    config->frame_size > (unsigned int)getpagesize()) {
+		XDP2_WARN("XDP open: bad frame size %u", config->frame_size);
+		return -EINVAL;
+	}
+
+	btag = xdp2_pbuf_size_shift_to_buffer_tag(size_shift);
+	entry = &pvmgr->pbuf_allocator_table[btag];
+	if (!entry->pbuf_base || entry->alloc_size != config->frame_size) {
+		XDP2_WARN("XDP open: pbufs of size %u are not configured",
+			  config->frame_size);
+		return -EINVAL;
+	}
+
+	if ((uintptr_t)entry->pbuf_base & (getpagesize() - 1)) {
+		XDP2_WARN("XDP open: base of pbufs of size %u is not page "
+			  "aligned", config->frame_size);
+		return -EINVAL;
+	}
+
+	allocator = XDP2_PVBUF_GET_ADDRESS(pvmgr,
+			XDP2_PVBUF_GET_ADDRESS(pvmgr,
+					       entry->pallocator)->allocator);
+
+	x = calloc(1, sizeof(*x) +
+		      allocator->max_objs * sizeof(x->kernel_refs[0]));
+	if (!x)
+		return -ENOMEM;
+
+	x->pallocator = XDP2_PVBUF_GET_ADDRESS(pvmgr, entry->pallocator);
+	x->umem_base = entry->pbuf_base;
+	x->num_frames = allocator->max_objs;
+	x->size_shift = size_shift;
+	x->btag = btag;
+	x->one_ref = pvmgr->alloc_one_ref;
+	x->map_fd = -1;
+	x->prog_fd = -1;
+	x->link_fd = -1;
+	dev->priv = x;
+
+	dev->fd = socket(AF_XDP, SOCK_RAW, 0);
+	if (dev->fd < 0) {
+		XDP2_WARN("XDP open: socket failed: %s", strerror(errno));
+		goto err;
+	}
+
+	mr.addr = (uintptr_t)x->umem_base;
+	mr.len = (__u64)x->num_frames << size_shift;
+	mr.chunk_size = config->frame_size;
+	if (setsockopt(dev->fd, SOL_XDP, XDP_UMEM_REG, &mr, sizeof(mr)) < 0) {
+		XDP2_WARN("XDP open: UMEM register failed: %s",
+			  strerror(errno));
+		goto err;
+	}
+
+	if (setsockopt(dev->fd, SOL_XDP, XDP_UMEM_FILL_RING, &num,
+		       sizeof(num)) < 0 ||
+	    setsockopt(dev->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &num,
+		       sizeof(num)) < 0 ||
+	    setsockopt(dev->fd, SOL_XDP, XDP_RX_RING, &num,
+		       sizeof(num)) < 0 ||
+	    setsockopt(dev->fd, SOL_XDP, XDP_TX_RING, &num,
+		       sizeof(num)) < 0) {
+		XDP2_WARN("XDP open: ring setup failed: %s", strerror(errno));
+		goto err;
+	}
+
+	if (getsockopt(dev->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off,
+		       &optlen) < 0) {
+		XDP2_WARN("XDP open: get mmap offsets failed: %s",
+			  strerror(errno));
+		goto err;
+	}
+
+	if (pkt_io_xdp_map_ring(dev, &x->rx, &off.rx,
+				sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) ||
+	    pkt_io_xdp_map_ring(dev, &x->tx, &off.tx,
+				sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) ||
+	    pkt_io_xdp_map_ring(dev, &x->fill, &off.fr, sizeof(__u64),
+				XDP_UMEM_PGOFF_FILL_RING) ||
+	    pkt_io_xdp_map_ring(dev, &x->comp, &off.cr, sizeof(__u64),
+				XDP_UMEM_PGOFF_COMPLETION_RING))
+		goto err;
+
+	sxdp.sxdp_family = AF_XDP;
+	sxdp.sxdp_ifindex = dev->ifindex;
+	sxdp.sxdp_queue_id = config->queue_id;
+	sxdp.sxdp_flags = (config->zero_copy ? XDP_ZEROCOPY : XDP_COPY) |
+			  XDP_USE_NEED_WAKEUP;
+	if (bind(dev->fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) < 0) {
+		XDP2_WARN("XDP open: bind to %s queue %u failed: %s",
+			  dev->ifname, config->queue_id, strerror(errno));
+		goto err;
+	}
+
+	if (pkt_io_xdp_create_map(dev, x) < 0 ||
+	    pkt_io_xdp_load_prog(dev, x) < 0)
+		goto err;
+
+	pkt_io_xdp_refill(dev, x);
+
+	return 0;
+
+err:
+	pkt_io_xdp_close(dev);
+	return -1;
+}
+
+/* Receive descriptors are pbufs, return them as packets and refill the
+ * fill ring with new pbufs
+ */
+static unsigned int pkt_io_xdp_recv_burst(struct xdp2_pkt_io_dev *dev,
+					  struct xdp2_pkt_io_pkt *pkts,
+					  unsigned int num)
+{
+	struct pkt_io_xdp *x = dev->priv;
+	__u32 prod = __atomic_load_n(x->rx.producer, __ATOMIC_ACQUIRE);
+	__u32 cons = *x->rx.consumer;
+	struct xdp_desc *ring = x->rx.ring;
+	struct xdp_desc *desc;
+	unsigned int n;
+
+	if (prod - cons < num)
+		num = prod - cons;
+
+	for (n = 0; n < num; n++) {
+		desc = &ring[cons++ & x->rx.mask];
+
+		pkt_io_xdp_frame_from_kernel(x, desc->addr);
+		pkts[n].paddr = pkt_io_xdp_frame_paddr(x, desc->addr,
+						       desc->len);
+		pkts[n].data = x->umem_base + desc->addr;
+		pkts[n].len = desc->len;
+	}
+
+	if (n)
+		__atomic_store_n(x->rx.consumer, cons, __ATOMIC_RELEASE);
+
+	pkt_io_xdp_refill(dev, x);
+
+	return n;
+}
+
+/* Get the UMEM address to transmit a packet from. A pbuf in the UMEM is
+ * transmitted in place, and so is a pvbuf with a single reference counted
+ * pbuf in the UMEM; otherwise the packet is copied to a new frame. The
+ * packet is consumed. Returns -1 on error
+ */
+static __u64 pkt_io_xdp_tx_addr(struct xdp2_pkt_io_dev *dev,
+				struct pkt_io_xdp *x,
+				struct xdp2_pkt_io_pkt *pkt, size_t *len)
+{
+	struct xdp2_pvbuf_mgr *pvmgr = dev->pvmgr;
+	xdp2_paddr_t paddr = pkt->paddr;
+	struct xdp2_pvbuf *pvbuf;
+	struct xdp2_iovec *iovec;
+	__u64 addr, chunk;
+	void *data;
+
+	if (XDP2_PADDR_IS_PVBUF(paddr)) {
+		pvbuf = __xdp2_pvbuf_paddr_to_addr(pvmgr, paddr);
+		iovec = &pvbuf->iovec[xdp2_pvbuf_iovec_map_find(pvbuf)];
+
+		if (xdp2_pvbuf_iovec_map_weight(pvbuf) == 1 &&
+		    xdp2_paddr_get_paddr_tag_from_paddr(iovec->paddr) ==
+							XDP2_PADDR_TAG_PBUF &&
+		    xdp2_pbuf_buffer_tag_from_paddr(iovec->paddr) == x->btag) {
+			addr = xdp2_pbuf_get_offset_from_paddr(iovec->paddr);
+			*len = xdp2_pbuf_get_data_len_from_paddr(
+								iovec->paddr);
+
+			/* Take a reference on the pbuf for the kernel and
+			 * release the pvbuf
+			 */
+			__xdp2_pbuf_bump_refcnt(pvmgr, iovec->paddr);
+			xdp2_pkt_io_free_pkt(pvmgr, pkt);
+			dev->stats.tx_zero_copy++;
+
+			return addr;
+		}
+	} else if (xdp2_pbuf_buffer_tag_from_paddr(paddr) == x->btag) {
+		addr = pkt->data - x->umem_base;
+		chunk = addr >> x->size_shift;
+
+		if (pkt->data >= x->umem_base && chunk < x->num_frames &&
+		    (addr + pkt->len - 1) >> x->size_shift == chunk) {
+			/* The packet's reference goes to the kernel */
+			*len = pkt->len;
+			pkt->paddr = XDP2_PADDR_NULL;
+			dev->stats.tx_zero_copy++;
+
+			return addr;
+		}
+	}
+
+	addr = pkt_io_xdp_alloc_frame(dev, x, &data);
+	if (addr == -1ULL) {
+		xdp2_pkt_io_free_pkt(pvmgr, pkt);
+		return -1ULL;
+	}
+
+	*len = __xdp2_pkt_io_copy_pkt(pvmgr, pkt, data,
+				      1ULL << x->size_shift);
+	xdp2_pkt_io_free_pkt(pvmgr, pkt);
+	if (!*len) {
+		pkt_io_xdp_free_frame(dev, x, addr);
+		return -1ULL;
+	}
+
+	return addr;
+}
+
+static unsigned int pkt_io_xdp_send_burst(struct xdp2_pkt_io_dev *dev,
+					  struct xdp2_pkt_io_pkt *pkts,
+					  unsigned int num)
+{
+	struct pkt_io_xdp *x = dev->priv;
+	struct xdp_desc *ring = x->tx.ring;
+	__u32 prod = *x->tx.producer;
+	unsigned int i, n = 0;
+	struct xdp_desc *desc;
+	__u32 space;
+	size_t len;
+	__u64 addr;
+
+	pkt_io_xdp_reap_completions(dev, x);
+
+	space = x->tx.mask + 1 -
+		(prod - __atomic_load_n(x->tx.consumer, __ATOMIC_ACQUIRE));
+
+	for (i = 0; i < num; i++) {
+		if (!space) {
+			xdp2_pkt_io_free_pkt(dev->pvmgr, &pkts[i]);
+			continue;
+		}
+
+		addr = pkt_io_xdp_tx_addr(dev, x, &pkts[i], &len);
+		if (addr == -1ULL)
+			continue;
+
+		pkt_io_xdp_frame_to_kernel(x, addr);
+
+		desc = &ring[prod++ & x->tx.mask];
+		desc->addr = addr;
+		desc->len = len;
+		desc->options = 0;
+
+		dev->stats.tx_bytes += len;
+		space--;
+		n++;
+	}
+
+	if (!n)
+		return 0;
+
+	__atomic_store_n(x->tx.producer, prod, __ATOMIC_RELEASE);
+
+	if (*x->tx.flags & XDP_RING_NEED_WAKEUP)
+		sendto(dev->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+
+	return n;
+}
+
+const struct xdp2_pkt_io_ops xdp2_pkt_io_xdp_ops = {
+	.name = "xdp",
+	.open = pkt_io_xdp_open,
+	.close = pkt_io_xdp_close,
+	.recv_burst = pkt_io_xdp_recv_burst,
+	.send_burst = pkt_io_xdp_send_burst,
+};
@@ -2016,23 +2016,13 @@ static void __xdp2_clear_pvmgr(struct xdp2_pvbuf_mgr *pvmgr)
 	int i;
 
 	for (i = 0; i < XDP2_PVBUF_NUM_SIZES; i++) {
-		struct xdp2_obj_allocator *allocator =
-				pvmgr->pvbuf_allocator_table[i].allocator;
-
-		if (!allocator)
-			continue;
+		struct xdp2_pvbuf_allocator_entry *pentry =
+				&pvmgr->pvbuf_allocator_table[i];
 
-		if (allocator->base &&
-		    pvmgr->alloced_pvbufs_base) {
-			/* The base of the allocator points to the object
-			 * created for the allocator in the call to
-			 * xdp2_obj_alloc_fifo_init. There is currently no
-			 * function to destroy a fifo, so free them here
-			 */
-			free(allocator->base);
-		}
-		if (pvmgr->alloced_pvbuf_allocator[i])
-			free(allocator);
+		if (pentry->alloced_pvbufs_base)
+			xdp2_mem_free(pentry->pvbufs_base);
+		if (pentry->alloced_pvbuf_allocator)
+			xdp2_mem_free(pentry->allocator);
 	}
 
 	for (i = 0; i < XDP2_PBUF_NUM_SIZE_SHIFTS; i++) {
@@ -2056,13 +2046,13 @@ static void __xdp2_clear_pvmgr(struct xdp2_pvbuf_mgr *pvmgr)
 				 * currently no function to destroy a fifo,
 				 * so free them here
 				 */
-				free(pallocator->allocator->base);
+				xdp2_mem_free(pallocator->allocator->base);
 			}
 			if (pallocator->alloced_allocator)
-				free(pallocator->allocator);
+				xdp2_mem_free(pallocator->allocator);
 		}
 		if (pallocator->alloced_this_pallocator)
-			free(pallocator);
+			xdp2_mem_free(pallocator);
 	}
 }
 
@@ -2091,10 +2081,11 @@ static int __xdp2_pvbuf_init_pbuf_allocators(struct xdp2_pvbuf_mgr *pvmgr,
 			/* Allocate a pbuf allocator plus an atomic uint as a
 			 * reference count for each object
 			 */
-			pallocator = calloc(1,
+			pallocator = xdp2_mem_alloc(
 				sizeof(struct xdp2_pbuf_allocator) +
 						sizeof(atomic_uint) *
-						pbuf_allocs->obj[i].num_objs);
+						pbuf_allocs->obj[i].num_objs,
+				&pbuf_allocs->mem_config);
 			if (!pallocator)
 				return -ENOMEM;
 			pallocator->alloced_this_pallocator = true;
@@ -2103,25 +2094,38 @@ static int __xdp2_pvbuf_init_pbuf_allocators(struct xdp2_pvbuf_mgr *pvmgr,
 			pallocator->alloced_this_pallocator = false;
 		}
 
+		/* Record the pbuf allocator now so that __xdp2_clear_pvmgr
+		 * frees it if one of the allocations below fails
+		 */
+		pallocator->allocator = NULL;
+		pallocator->alloced_allocator = false;
+		pallocator->alloced_base = false;
+		pvmgr->pbuf_allocator_table[i].pallocator = pallocator;
+		pvmgr->pbuf_allocator_table[i].alloc_size_shift =
+				xdp2_pbuf_buffer_tag_to_size_shift(i);
+
 		if (!pbuf_allocs->obj[i].allocator) {
 			/* Allocate the allocator with and object allocator
 			 * FIFO
 			 */
-			allocator = malloc(XDP2_OBJ_ALLOC_SIZE(
-						pbuf_allocs->obj[i].num_objs));
+			allocator = xdp2_mem_alloc(XDP2_OBJ_ALLOC_SIZE(
+						pbuf_allocs->obj[i].num_objs),
+						&pbuf_allocs->mem_config);
 			if (!allocator)
 				return -ENOMEM;
 			pallocator->alloced_allocator = true;
 		} else {
 			allocator = pbuf_allocs->obj[i].allocator;
-			pallocator->alloced_allocator = false;
 		}
 
 		pallocator->allocator = allocator;
+		allocator->base = NULL;
 
 		if (!pbuf_allocs->obj[i].base) {
-			pbufs_base = calloc(pbuf_allocs->obj[i].num_objs,
-					xdp2_pbuf_buffer_tag_to_size(i));
+			pbufs_base = xdp2_mem_alloc(
+					(size_t)pbuf_allocs->obj[i].num_objs *
+					xdp2_pbuf_buffer_tag_to_size(i),
+					&pbuf_allocs->mem_config);
 			if (!pbufs_base)
 				return -ENOMEM;
 			pallocator->alloced_base = true;
@@ -2242,7 +2246,9 @@ static int __xdp2_pvbuf_init_pvbuf_allocators(struct xdp2_pvbuf_mgr *pvmgr,
 		entry = &pvmgr->pvbuf_allocator_table[i];
 
 		if (!allocator) {
-			allocator = malloc(XDP2_OBJ_ALLOC_SIZE(num_pvbufs));
+			allocator = xdp2_mem_alloc(
+					XDP2_OBJ_ALLOC_SIZE(num_pvbufs),
+					&pvbuf_allocs->mem_config);
 			if (!allocator)
 				return -ENOMEM;
 
@@ -2254,11 +2260,10 @@ static int __xdp2_pvbuf_init_pvbuf_allocators(struct xdp2_pvbuf_mgr *pvmgr,
 		entry->allocator = allocator;
 
 		if (!base) {
-			base = calloc(num_pvbufs, (i + 1) * 64);
-			if (!base) {
-				if (!entry->alloced_pvbufs_base)
-					return -ENOMEM;
-			}
+			base = xdp2_mem_alloc((size_t)num_pvbufs * (i + 1) * 64,
+					      &pvbuf_allocs->mem_config);
+			if (!base)
+				return -ENOMEM;
 			entry->alloced_pvbufs_base = true;
 		} else {
 			entry->alloced_pvbufs_base = false;
@@ -2384,13 +2389,111 @@ int __xdp2_pvbuf_init(struct xdp2_pvbuf_mgr *pvmgr,
 
 out_err:
 	/* Cleanup including freeing any resources that were allocated
-	 * above
+	 * above. Zero the manager so that the allocator tables don't point
+	 * to freed memory
 	 */
 	__xdp2_clear_pvmgr(pvmgr);
+	memset(pvmgr, 0, sizeof(*pvmgr));
 
 	return ret;
 }
 
+/* Per NUMA node packet buffer managers */
+
+static struct xdp2_pvbuf_mgr *xdp2_pvbuf_node_mgrs[XDP2_MEM_MAX_NODES];
+
+__thread struct xdp2_pvbuf_mgr *xdp2_pvbuf_thread_mgr;
+
+int xdp2_pvbuf_init_node(unsigned int node,
+			 struct xdp2_pbuf_init_allocator *pbuf_allocs,
+			 struct xdp2_pvbuf_init_allocator *pvbuf_allocs,
+			 bool random_pvbuf_size, bool alloc_one_ref)
+{
+	struct xdp2_mem_config mem_config = {
+		.numa_bind = true,
+		.numa_node = node,
+	};
+	struct xdp2_pvbuf_mgr *pvmgr;
+	char name[16];
+	int ret;
+
+	if (node >= XDP2_MEM_MAX_NODES)
+		return -EINVAL;
+
+	if (xdp2_pvbuf_node_mgrs[node])
+		return -EEXIST;
+
+	pbuf_allocs->mem_config.numa_bind = true;
+	pbuf_allocs->mem_config.numa_node = node;
+	pvbuf_allocs->mem_config.numa_bind = true;
+	pvbuf_allocs->mem_config.numa_node = node;
+
+	/* The manager is read on every operation so it's node local too */
+	pvmgr = xdp2_mem_alloc(sizeof(*pvmgr), &mem_config);
+	if (!pvmgr)
+		return -ENOMEM;
+
+	snprintf(name, sizeof(name), "node%u", node);
+
+	ret = __xdp2_pvbuf_init(pvmgr, pbuf_allocs, pvbuf_allocs, name, 0,
+				random_pvbuf_size, alloc_one_ref, NULL, NULL);
+	if (ret) {
+		xdp2_mem_free(pvmgr);
+		return ret;
+	}
+
+	xdp2_pvbuf_node_mgrs[node] = pvmgr;
+
+	return 0;
+}
+
+struct xdp2_pvbuf_mgr *xdp2_pvbuf_node_mgr(unsigned int node)
+{
+	return node < XDP2_MEM_MAX_NODES ? xdp2_pvbuf_node_mgrs[node] : NULL;
+}
+
+struct xdp2_pvbuf_mgr *xdp2_pvbuf_select_node_mgr(void)
+{
+	int node = xdp2_mem_current_node();
+
+	xdp2_pvbuf_thread_mgr = node >= 0 ? xdp2_pvbuf_node_mgr(node) : NULL;
+
+	return xdp2_pvbuf_local_mgr();
+}
+
+bool __xdp2_pvbuf_enable_thread_caches(struct xdp2_pvbuf_mgr *pvmgr,
+				       unsigned int cache_size,
+				       unsigned int batch)
+{
+	struct xdp2_pbuf_allocator_entry *entry;
+	struct xdp2_pbuf_allocator *pallocator;
+	struct xdp2_obj_allocator *allocator;
+	int i;
+
+	for (i = 0; i < XDP2_PVBUF_NUM_SIZES; i++) {
+		allocator = XDP2_PVBUF_GET_ALLOCATOR(pvmgr, i);
+		if (allocator && !xdp2_obj_alloc_cache_enable(allocator,
+							cache_size, batch))
+			return false;
+	}
+
+	for (i = 0; i < XDP2_PBUF_NUM_SIZE_SHIFTS; i++) {
+		entry = &pvmgr->pbuf_allocator_table[i];
+		if (entry->alloc_size_shift !=
+				xdp2_pbuf_buffer_tag_to_size_shift(i) ||
+		    !entry->pallocator)
+			continue;
+
+		pallocator = XDP2_PVBUF_GET_ADDRESS(pvmgr, entry->pallocator);
+		allocator = XDP2_PVBUF_GET_ADDRESS(pvmgr,
+						    pallocator->allocator);
+		if (!xdp2_obj_alloc_cache_enable(allocator, cache_size, batch))
+			return false;
+	}
+
+	return true;
+}
+
 /* Check functions */
 
 /* Check information for one pvbuf managed by the packet buffer manager in the
@@ -2755,7 +2858,7 @@ struct __xdp2_pvbuf_iter_checksum {
 static bool __xdp2_pvbuf_iterate_checksum(void *priv, __u8 *data, size_t len)
 {
 	struct __xdp2_pvbuf_iter_checksum *ist = priv;
-	__u16 csum;
+	bool done = false;
 
 	if (ist->offset) {
 		if (len <= ist->offset) {
@@ -2768,8 +2871,14 @@ static bool __xdp2_pvbuf_iterate_checksum(void *priv, __u8 *data, size_t len)
 		ist->offset = 0;
 	}
 
-	if (ist->len)
+	if (ist->len) {
+		/* Account for the bytes of this fragment before an odd
+		 * byte is consumed below
+		 */
 		len = xdp2_min(ist->len, len);
+		ist->len -= len;
+		done = !ist->len;
+	}
 
 	if (ist->odd_byte && len) {
 		ist->csum_total = xdp2_checksum_add16(ist->csum_total,
@@ -2779,19 +2888,14 @@ static bool __xdp2_pvbuf_iterate_checksum(void *priv, __u8 *data, size_t len)
 		ist->odd_byte = false;
 	}
 
-	csum = __xdp2_checksum_compute(data, len);
-	ist->csum_total = xdp2_checksum_add16(ist->csum_total, csum);
+	/* Accumulate the unfolded sum, it's folded once at the end */
+	ist->csum_total = xdp2_checksum_add64(ist->csum_total,
+					      xdp2_checksum_partial(data, len));
 
 	if (len & 1)
 		ist->odd_byte = true;
 
-	if (ist->len) {
-		ist->len -= len;
-		if (!ist->len)
-			return false;
-	}
-
-	return true;
+	return !done;
 }
 
 /* Compute the checksum over a PVbuf */
@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Quiescent state based reclamation (see xdp2/qsbr.h) */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xdp2/qsbr.h"
+
+void xdp2_qsbr_init(struct xdp2_qsbr *qsbr)
+{
+	memset(qsbr, 0, sizeof(*qsbr));
+
+	qsbr->epoch = 1;
+	pthread_mutex_init(&qsbr->lock, NULL);
+	LIST_INIT(&qsbr->threads);
+	qsbr->cbs_tail = &qsbr->cbs_head;
+}
+
+void xdp2_qsbr_fini(struct xdp2_qsbr *qsbr)
+{
+	xdp2_qsbr_barrier(qsbr);
+}
+
+struct xdp2_qsbr_thread *xdp2_qsbr_register(struct xdp2_qsbr *qsbr)
+{
+	struct xdp2_qsbr_thread *thread;
+
+	thread = aligned_alloc(XDP2_CACHELINE_SIZE, sizeof(*thread));
+	if (!thread)
+		return NULL;
+
+	memset(thread, 0, sizeof(*thread));
+	thread->qsbr = qsbr;
+
+	pthread_mutex_lock(&qsbr->lock);
+	LIST_INSERT_HEAD(&qsbr->threads, thread, link);
+	xdp2_qsbr_online(thread);
+	pthread_mutex_unlock(&qsbr->lock);
+
+	return thread;
+}
+
+void xdp2_qsbr_unregister(struct xdp2_qsbr_thread *thread)
+{
+	struct xdp2_qsbr *qsbr = thread->qsbr;
+
+	xdp2_qsbr_offline(thread);
+
+	pthread_mutex_lock(&qsbr->lock);
+	LIST_REMOVE(thread, link);
+	pthread_mutex_unlock(&qsbr->lock);
+
+	free(thread);
+}
+
+/* Return the oldest epoch observed by an online thread, or ~0 if no
+ * thread is online. Called with the lock held
+ */
+static __u64 xdp2_qsbr_min_epoch(struct xdp2_qsbr *qsbr)
+{
+	struct xdp2_qsbr_thread *thread;
+	__u64 min = ~0ULL, epoch;
+
+	LIST_FOREACH(thread, &qsbr->threads, link) {
+		epoch = __atomic_load_n(&thread->epoch, __ATOMIC_SEQ_CST);
+		if (epoch && epoch < min)
+			min = epoch;
+	}
+
+	return min;
+}
+
+/* Advance the epoch and return the new value */
+static __u64 xdp2_qsbr_advance(struct xdp2_qsbr *qsbr)
+{
+	return __atomic_add_fetch(&qsbr->epoch, 1, __ATOMIC_SEQ_CST);
+}
+
+static void __xdp2_qsbr_wait(struct xdp2_qsbr *qsbr, __u64 target)
+{
+	while (xdp2_qsbr_min_epoch(qsbr) < target)
+		sched_yield();
+}
+
+void xdp2_qsbr_synchronize(struct xdp2_qsbr *qsbr)
+{
+	__u64 target = xdp2_qsbr_advance(qsbr);
+
+	pthread_mutex_lock(&qsbr->lock);
+	__xdp2_qsbr_wait(qsbr, target);
+	pthread_mutex_unlock(&qsbr->lock);
+}
+
+/* Dequeue the callbacks whose epoch is at most min. Called with the lock
+ * held, the callbacks are run by the caller after dropping the lock
+ */
+static struct xdp2_qsbr_cb *xdp2_qsbr_dequeue(struct xdp2_qsbr *qsbr,
+					      __u64 min)
+{
+	struct xdp2_qsbr_cb *head = qsbr->cbs_head, *cb, **pnext;
+
+	/* Callbacks are queued in epoch order */
+	for (pnext = &qsbr->cbs_head; (cb = *pnext) && cb->epoch <= min;
+	     pnext = &cb->next)
+		qsbr->num_cbs--;
+
+	if (pnext == &qsbr->cbs_head)
+		return NULL;
+
+	qsbr->cbs_head = cb;
+	if (!cb)
+		qsbr->cbs_tail = &qsbr->cbs_head;
+	*pnext = NULL;
+
+	return head;
+}
+
+static unsigned int xdp2_qsbr_run(struct xdp2_qsbr_cb *cb)
+{
+	struct xdp2_qsbr_cb *next;
+	unsigned int num = 0;
+
+	for (; cb; cb = next, num++) {
+		next = cb->next;
+		cb->func(cb->arg);
+		free(cb);
+	}
+
+	return num;
+}
+
+unsigned int xdp2_qsbr_reclaim(struct xdp2_qsbr *qsbr)
+{
+	struct xdp2_qsbr_cb *cbs;
+
+	pthread_mutex_lock(&qsbr->lock);
+	cbs = xdp2_qsbr_dequeue(qsbr, xdp2_qsbr_min_epoch(qsbr));
+	pthread_mutex_unlock(&qsbr->lock);
+
+	return xdp2_qsbr_run(cbs);
+}
+
+int xdp2_qsbr_call(struct xdp2_qsbr *qsbr, void (*func)(void *arg),
+		   void *arg)
+{
+	struct xdp2_qsbr_cb *cb;
+	bool reclaim;
+
+	cb = malloc(sizeof(*cb));
+	if (!cb) {
+		xdp2_qsbr_synchronize(qsbr);
+		func(arg);
+		return -ENOMEM;
+	}
+
+	cb->func = func;
+	cb->arg = arg;
+	cb->next = NULL;
+
+	pthread_mutex_lock(&qsbr->lock);
+	cb->epoch = xdp2_qsbr_advance(qsbr);
+	*qsbr->cbs_tail = cb;
+	qsbr->cbs_tail = &cb->next;
+	reclaim = ++qsbr->num_cbs >= XDP2_QSBR_RECLAIM_THRESH;
+	pthread_mutex_unlock(&qsbr->lock);
+
+	if (reclaim)
+		xdp2_qsbr_reclaim(qsbr);
+
+	return 0;
+}
+
+void xdp2_qsbr_barrier(struct xdp2_qsbr *qsbr)
+{
+	struct xdp2_qsbr_cb *cbs;
+	__u64 target;
+
+	pthread_mutex_lock(&qsbr->lock);
+	target = xdp2_qsbr_advance(qsbr);
+	__xdp2_qsbr_wait(qsbr, target);
+	cbs = xdp2_qsbr_dequeue(qsbr, ~0ULL);
+	pthread_mutex_unlock(&qsbr->lock);
+
+	xdp2_qsbr_run(cbs);
+}
@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Software receive side scaling (see xdp2/rss.h) */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xdp2/rss.h"
+#include "xdp2/utility.h"
+
+static const __u8 xdp2_rss_default_key[XDP2_HASH_TOEPLITZ_KEY_LEN] =
+					XDP2_HASH_TOEPLITZ_DEFAULT_KEY;
+
+struct xdp2_rss *xdp2_rss_create(struct xdp2_fifo **fifos,
+				 unsigned int num_queues,
+				 unsigned int indir_size, const __u8 *key)
+{
+	struct xdp2_rss *rss;
+
+	if (!indir_size)
+		indir_size = XDP2_RSS_DEFAULT_INDIR_SIZE;
+
+	if (!num_queues || num_queues > XDP2_RSS_MAX_QUEUES ||
+	    (indir_size & (indir_size - 1)))
+		return NULL;
+
+	rss = aligned_alloc(XDP2_CACHELINE_SIZE,
+			    xdp2_round_up(sizeof(*rss) + indir_size *
+					  sizeof(rss->indir[0]),
+					  XDP2_CACHELINE_SIZE));
+	if (!rss)
+		return NULL;
+
+	rss->fifos = calloc(num_queues, sizeof(*rss->fifos));
+	rss->stats = calloc(num_queues, sizeof(*rss->stats));
+	if (!rss->fifos || !rss->stats) {
+		free(rss->fifos);
+		free(rss->stats);
+		free(rss);
+		return NULL;
+	}
+
+	memcpy(rss->fifos, fifos, num_queues * sizeof(*rss->fifos));
+	rss->num_queues = num_queues;
+	rss->indir_mask = indir_size - 1;
+
+	xdp2_rss_set_key(rss, key ? : xdp2_rss_default_key);
+	xdp2_rss_set_indir_equal(rss, num_queues);
+
+	return rss;
+}
+
+void xdp2_rss_free(struct xdp2_rss *rss)
+{
+	free(rss->fifos);
+	free(rss->stats);
+	free(rss);
+}
+
+void xdp2_rss_set_key(struct xdp2_rss *rss, const __u8 *key)
+{
+	memcpy(rss->key, key, sizeof(rss->key));
+	xdp2_hash_toeplitz_tbl_init(&rss->tbl, rss->key);
+}
+
+int xdp2_rss_set_indir(struct xdp2_rss *rss, const __u16 *indir)
+{
+	unsigned int i;
+
+	for (i = 0; i <= rss->indir_mask; i++)
+		if (indir[i] >= rss->num_queues)
+			return -EINVAL;
+
+	for (i = 0; i <= rss->indir_mask; i++)
+		__atomic_store_n(&rss->indir[i], indir[i], __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+int xdp2_rss_set_indir_equal(struct xdp2_rss *rss, unsigned int num)
+{
+	unsigned int i;
+
+	if (!num || num > rss->num_queues)
+		return -EINVAL;
+
+	for (i = 0; i <= rss->indir_mask; i++)
+		__atomic_store_n(&rss->indir[i], i % num, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+#define XDP2_RSS_STEER_BATCH	64
+
+/* Steer a batch of at most XDP2_RSS_STEER_BATCH messages. The messages are
+ * grouped by queue, keeping their order, so that each queue gets one burst
+ * enqueue. Batches are small so the grouping scans the batch once for
+ * each distinct queue
+ */
+static unsigned int xdp2_rss_steer_batch(struct xdp2_rss *rss,
+					 const __u32 *hashes,
+					 const __u64 *messages,
+					 unsigned int count, bool wait,
+					 __u64 **dropped)
+{
+	unsigned int queues[XDP2_RSS_STEER_BATCH];
+	__u64 sorted[XDP2_RSS_STEER_BATCH];
+	unsigned int i, j, n, queue;
+	unsigned int steered = 0;
+	__u64 done = 0;
+
+	for (i = 0; i < count; i++)
+		queues[i] = xdp2_rss_hash_to_queue(rss, hashes[i]);
+
+	for (i = 0; i < count; i++) {
+		if (done & (1ULL << i))
+			continue;
+
+		queue = queues[i];
+		for (j = i, n = 0; j < count; j++) {
+			if (queues[j] == queue) {
+				sorted[n++] = messages[j];
+				done |= 1ULL << j;
+			}
+		}
+
+		/* A burst enqueue that waits returns once some space is
+		 * available, keep going until all the messages are in
+		 */
+		j = 0;
+		do {
+			unsigned int k;
+
+			k = xdp2_fifo_enqueue_burst(rss->fifos[queue],
+						    sorted + j, n - j, wait);
+			if (!k)
+				break;
+			j += k;
+		} while (wait && j < n);
+
+		rss->stats[queue].steered += j;
+		rss->stats[queue].drops += n - j;
+		steered += j;
+
+		if (*dropped)
+			for (; j < n; j++)
+				*(*dropped)++ = sorted[j];
+	}
+
+	return steered;
+}
+
+unsigned int xdp2_rss_steer_burst(struct xdp2_rss *rss, const __u32 *hashes,
+				  const __u64 *messages, unsigned int count,
+				  bool wait, __u64 *dropped)
+{
+	unsigned int steered = 0, n, i;
+
+	for (i = 0; i < count; i += n) {
+		n = xdp2_min(count - i, XDP2_RSS_STEER_BATCH);
+		steered += xdp2_rss_steer_batch(rss, hashes + i,
+						messages + i, n, wait,
+						&dropped);
+	}
+
+	return steered;
+}
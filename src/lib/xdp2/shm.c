@@ -31,8 +31,12 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include <linux/memfd.h>
 
 #include "xdp2/addr_xlat.h"
+#include "xdp2/mem.h"
 #include "xdp2/shm.h"
 #include "xdp2/utility.h"
 
@@ -40,7 +44,6 @@
 int xdp2_shm_open_file(const char *name, size_t size, off_t offset,
 		       bool create, size_t *fsize)
 {
-	char c = 0;
 	int fd;
 
 	XDP2_ASSERT(!create || size, "SHM open file: create is set "
@@ -61,14 +64,11 @@ int xdp2_shm_open_file(const char *name, size_t size, off_t offset,
 	}
 
 	if (create) {
-		if (lseek(fd, offset + size - 1, SEEK_SET) < 0) {
-			XDP2_WARN("Open shm file: lseek failed for "
-				  "%s: %s\n", name, strerror(errno));
-			return -1;
-		}
-
-		if (write(fd, &c, 1) < 0) {
-			XDP2_WARN("Open shm file: write failed for "
+		/* Files on hugetlbfs can't be written so set the size with
+		 * ftruncate
+		 */
+		if (ftruncate(fd, offset + size) < 0) {
+			XDP2_WARN("Open shm file: ftruncate failed for "
 				  "%s: %s\n", name, strerror(errno));
 			return -1;
 		}
@@ -101,9 +101,77 @@ int xdp2_shm_open_file(const char *name, size_t size, off_t offset,
 	return fd;
 }
 
-/* mmap a shared memory file */
-void *xdp2_shm_map(const char *file, size_t size, off_t offset, bool create,
-		   bool zero_it)
+/* Map a shared memory file descriptor and place the memory per config.
+ * Hugepages come from the file system (hugetlbfs or a hugetlb memfd), if
+ * the file isn't backed by hugepages the mapping falls back to regular
+ * pages with transparent hugepages enabled unless no_fallback is set
+ */
+static void *__xdp2_shm_map_fd(int fd, const char *name, size_t size,
+			       off_t offset, bool zero_it,
+			       const struct xdp2_mem_config *config)
+{
+	size_t page_bytes = xdp2_mem_page_bytes(XDP2_MEM_PAGE_DEFAULT);
+	struct statfs stfs;
+	bool huge = false;
+	void *p;
+	int err;
+
+	if (!fstatfs(fd, &stfs) && stfs.f_type == HUGETLBFS_MAGIC) {
+		page_bytes = stfs.f_bsize;
+		huge = true;
+	}
+
+	if (config && config->page_size != XDP2_MEM_PAGE_DEFAULT && !huge &&
+	    config->no_fallback) {
+		XDP2_WARN("Mapping shared memory %s, file is not on "
+			  "hugetlbfs", name);
+		return NULL;
+	}
+
+	if (huge && (offset % page_bytes)) {
+		XDP2_WARN("Mapping shared memory %s, offset %lu is not "
+			  "aligned to the hugepage size %lu", name, offset,
+			  page_bytes);
+		return NULL;
+	}
+
+	p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+	if (p == MAP_FAILED) {
+		XDP2_WARN("Mmap shared field %s failed with error: %s",
+			  name, strerror(errno));
+		return NULL;
+	}
+
+	if (config && config->page_size != XDP2_MEM_PAGE_DEFAULT && !huge)
+		madvise(p, size, MADV_HUGEPAGE);
+
+	/* Binding only applies to pages faulted in after this, so bind
+	 * before zeroing or pre-faulting
+	 */
+	if (config && config->numa_bind) {
+		err = xdp2_mem_bind(p, xdp2_round_up(size, page_bytes),
+				    config->numa_node);
+		if (err) {
+			XDP2_WARN("Binding shared memory %s to NUMA node %u "
+				  "failed: %s", name, config->numa_node,
+				  strerror(-err));
+			munmap(p, size);
+			return NULL;
+		}
+	}
+
+	if (zero_it)
+		memset(p, 0, size);
+	else if (config && config->prefault)
+		xdp2_mem_prefault(p, size, page_bytes);
+
+	return p;
+}
+
+/* mmap a shared memory file with memory placement */
+void *xdp2_shm_map_mem(const char *file, size_t size, off_t offset,
+		       bool create, bool zero_it,
+		       const struct xdp2_mem_config *config)
 {
 	size_t fsize;
 	void *p;
@@ -115,6 +183,12 @@ void *xdp2_shm_map(const char *file, size_t size, off_t offset, bool create,
 		return NULL;
 	}
 
+	/* A new file on hugetlbfs must be a multiple of the hugepage size */
+	if (create && size && config &&
+	    config->page_size != XDP2_MEM_PAGE_DEFAULT)
+		size = xdp2_round_up(size,
+				     xdp2_mem_page_bytes(config->page_size));
+
 	fd = xdp2_shm_open_file(file, size, offset, create, &fsize);
 	if (fd < 0)
 		return NULL;
@@ -126,25 +200,89 @@ void *xdp2_shm_map(const char *file, size_t size, off_t offset, bool create,
 		XDP2_WARN("Mapping shared memory, trying to mmap beyond "
 			  "the end of the file: file size %lu mmap extent %lu",
 			  fsize, offset + size);
-		return NULL;
-	}
-
-	p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
-	if (p == MAP_FAILED) {
 		close(fd);
-		XDP2_WARN("Mmap shared field %s failed with error: %s",
-			  file, strerror(errno));
 		return NULL;
 	}
 
-	if (zero_it)
-		memset(p, 0, size);
+	p = __xdp2_shm_map_fd(fd, file, size, offset, zero_it, config);
 
 	close(fd);
 
 	return p;
 }
 
+/* mmap a shared memory file */
+void *xdp2_shm_map(const char *file, size_t size, off_t offset, bool create,
+		   bool zero_it)
+{
+	return xdp2_shm_map_mem(file, size, offset, create, zero_it, NULL);
+}
+
+/* Create an anonymous shared memory file with memfd_create */
+int xdp2_shm_memfd_create(const char *name, size_t size,
+			  const struct xdp2_mem_config *config)
+{
+	unsigned int flags = MFD_CLOEXEC;
+	size_t page_bytes;
+	int fd = -1;
+	void *p;
+
+	if (config && config->page_size != XDP2_MEM_PAGE_DEFAULT) {
+		page_bytes = xdp2_mem_page_bytes(config->page_size);
+
+		fd = memfd_create(name, flags | MFD_HUGETLB |
+				  (__builtin_ctzl(page_bytes) <<
+				   MFD_HUGE_SHIFT));
+		if (fd >= 0) {
+			size = xdp2_round_up(size, page_bytes);
+
+			/* Hugepages are reserved when the file is mapped, so
+			 * probe with a mapping to check that there are enough
+			 * free hugepages to back the file
+			 */
+			if (ftruncate(fd, size) < 0 ||
+			    (p = mmap(0, size, PROT_READ | PROT_WRITE,
+				      MAP_SHARED, fd, 0)) == MAP_FAILED) {
+				close(fd);
+				fd = -1;
+			} else {
+				munmap(p, size);
+			}
+		}
+
+		if (fd < 0 && config->no_fallback) {
+			XDP2_WARN("Create hugepage memfd %s failed: %s",
+				  name, strerror(errno));
+			return -1;
+		}
+	}
+
+	if (fd < 0) {
+		fd = memfd_create(name, flags);
+		if (fd < 0) {
+			XDP2_WARN("Create memfd %s failed: %s", name,
+				  strerror(errno));
+			return -1;
+		}
+
+		if (ftruncate(fd, size) < 0) {
+			XDP2_WARN("Set size of memfd %s failed: %s", name,
+				  strerror(errno));
+			close(fd);
+			return -1;
+		}
+	}
+
+	return fd;
+}
+
+/* mmap a shared memory file descriptor with memory placement */
+void *xdp2_shm_map_fd(int fd, size_t size, off_t offset, bool zero_it,
+		      const struct xdp2_mem_config *config)
+{
+	return __xdp2_shm_map_fd(fd, "fd", size, offset, zero_it, config);
+}
+
 /* Open an mmap the file for one instance of shared memory
  *   - If the size argument is non-zero and not -1UL then the shared memory
  *     exists with the specified size and needs to be initialized
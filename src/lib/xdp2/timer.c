@@ -25,6 +25,7 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -87,6 +88,29 @@ static void future_ts(struct xdp2_timer_wheel *wheel, struct timespec *ts,
 	ts->tv_sec += (delay / wheel->time_div) + nsecs / 1000000000;
 }
 
+/* Lock and unlock the timer wheel. Local wheels are only manipulated by
+ * their owner thread so they aren't locked
+ */
+static void timer_wheel_lock(struct xdp2_timer_wheel *wheel)
+{
+	if (!wheel->local)
+		pthread_mutex_lock(&wheel->mutex);
+}
+
+static void timer_wheel_unlock(struct xdp2_timer_wheel *wheel)
+{
+	if (!wheel->local)
+		pthread_mutex_unlock(&wheel->mutex);
+}
+
+/* Wheel has a timer thread if there's no external set_next_timer_pop
+ * and the wheel is not local
+ */
+static bool has_timer_thread(struct xdp2_timer_wheel *wheel)
+{
+	return !wheel->set_next_timer_pop && !wheel->local;
+}
+
 /* Set the pop time. Either call an external function or signal the timer
  * thread
  */
@@ -98,29 +122,148 @@ static void set_next_timer_pop(struct xdp2_timer_wheel *wheel)
 		 */
 		wheel->set_next_timer_pop(wheel->cbarg,
 					  wheel->next_expire_time);
-	} else {
+	} else if (!wheel->local) {
 		/* Timer thread is running, signal it */
 		pthread_cond_signal(&wheel->cond);
 	}
 }
 
+/* Helpers to get the slot list and bitmap for a level */
+
+static struct __xdp2_timer_wheel_list_head *get_slot(
+		struct xdp2_timer_wheel *wheel, unsigned int level,
+		unsigned int index)
+{
+	return &wheel->slots[level * wheel->num_slots + index];
+}
+
+static unsigned long *get_bitmap(struct xdp2_timer_wheel *wheel,
+				 unsigned int level)
+{
+	return &wheel->slot_bitmap[level * wheel->bitmap_words];
+}
+
+static unsigned int level_shift(struct xdp2_timer_wheel *wheel,
+				unsigned int level)
+{
+	return level * wheel->num_slots_order;
+}
+
+/* Insert a timer in the wheel at the lowest level that covers its
+ * expiration time relative to the wheel clock
+ */
+static void timer_insert_locked(struct xdp2_timer_wheel *wheel,
+				struct xdp2_timer *timer)
+{
+	unsigned long expire_time = timer->expire_time;
+	unsigned long delta = expire_time - wheel->clock;
+	unsigned int level, index;
+
+	if ((long)delta < 0) {
+		/* Already expired, put in the slot for the current clock */
+		expire_time = wheel->clock;
+		delta = 0;
+	}
+
+	for (level = 0; level < wheel->num_levels - 1; level++)
+		if (delta < 1UL << level_shift(wheel, level + 1))
+			break;
+
+	if (delta >= 1UL << level_shift(wheel, wheel->num_levels)) {
+		/* Beyond the range of the wheel (the clock is lagging the
+		 * current time). Place the timer in the last slot of the top
+		 * level, it will be re-placed when the slot is cascaded
+		 */
+		expire_time = wheel->clock +
+			(1UL << level_shift(wheel, wheel->num_levels)) - 1;
+	}
+
+	index = (expire_time >> level_shift(wheel, level)) &
+						(wheel->num_slots - 1);
+
+	timer->level = level;
+	timer->index = index;
+
+	CIRCLEQ_INSERT_TAIL(get_slot(wheel, level, index), timer, list_ent);
+	xdp2_bitmap_set(get_bitmap(wheel, level), index);
+}
+
 /* Remove a timer with the timer wheel already locked */
 static void timer_remove_locked(struct xdp2_timer_wheel *wheel,
 				struct xdp2_timer *timer)
 {
-	unsigned int index = timer->index;
+	struct __xdp2_timer_wheel_list_head *slot;
 
 	XDP2_ASSERT(timer->timer_set, "Timer being removed is not set");
 
-	CIRCLEQ_REMOVE(&wheel->slots[index], timer, list_ent);
+	slot = get_slot(wheel, timer->level, timer->index);
+
+	CIRCLEQ_REMOVE(slot, timer, list_ent);
 
-	if (CIRCLEQ_EMPTY(&wheel->slots[index]))
-		xdp2_bitmap_unset(wheel->slot_bitmap, index);
+	if (CIRCLEQ_EMPTY(slot))
+		xdp2_bitmap_unset(get_bitmap(wheel, timer->level),
+				  timer->index);
 
 	timer->timer_set = false;
 	wheel->timer_count--;
 }
 
+/* Process removes of timers in a local wheel that were queued by other
+ * threads. Called by the owner thread
+ */
+static void process_remote_removes(struct xdp2_timer_wheel *wheel)
+{
+	struct xdp2_timer *timer, *next;
+
+	if (!wheel->local ||
+	    !atomic_load_explicit(&wheel->cancel_list, memory_order_relaxed))
+		return;
+
+	timer = atomic_exchange_explicit(&wheel->cancel_list, NULL,
+					 memory_order_acquire);
+
+	for (; timer; timer = next) {
+		/* Get next before clearing cancel_queued since the timer
+		 * can be queued again once that is cleared
+		 */
+		next = timer->cancel_next;
+		atomic_store_explicit(&timer->cancel_queued, false,
+				      memory_order_release);
+
+		if (timer->timer_set)
+			timer_remove_locked(wheel, timer);
+
+		__XDP2_TIMER_BUMP_STAT(wheel, remote_removes);
+	}
+}
+
+/* Queue a remove of a timer in a local wheel from a thread other than the
+ * owner
+ */
+static void queue_remote_remove(struct xdp2_timer_wheel *wheel,
+				struct xdp2_timer *timer)
+{
+	struct xdp2_timer *head;
+
+	if (atomic_exchange_explicit(&timer->cancel_queued, true,
+				     memory_order_acquire)) {
+		/* Already queued */
+		return;
+	}
+
+	head = atomic_load_explicit(&wheel->cancel_list, memory_order_relaxed);
+	do {
+		timer->cancel_next = head;
+	} while (!atomic_compare_exchange_weak_explicit(&wheel->cancel_list,
+				&head, timer, memory_order_release,
+				memory_order_relaxed));
+}
+
+static bool is_remote_thread(struct xdp2_timer_wheel *wheel)
+{
+	return wheel->local && !pthread_equal(pthread_self(), wheel->owner);
+}
+
 /* Remove timer. If the timer structure is also being freed then
  * xdp2_check_wheel_running should be called before freeing the data structure
  *
@@ -131,7 +274,16 @@ bool xdp2_timer_remove(struct xdp2_timer_wheel *wheel,
 {
 	bool ret;
 
-	pthread_mutex_lock(&wheel->mutex);
+	if (is_remote_thread(wheel)) {
+		/* Remove from a thread that doesn't own a local wheel. Queue
+		 * the remove for the owner and report that the timer might
+		 * still fire
+		 */
+		queue_remote_remove(wheel, timer);
+		return true;
+	}
+
+	timer_wheel_lock(wheel);
 
 	TIMER_MUTEX_AT(wheel, "In remove timer");
 
@@ -142,7 +294,7 @@ bool xdp2_timer_remove(struct xdp2_timer_wheel *wheel,
 
 	if (!timer->timer_set) {
 		TIMER_MUTEX_AT(wheel, "Out remove timer");
-		pthread_mutex_unlock(&wheel->mutex);
+		timer_wheel_unlock(wheel);
 		return ret;
 	}
 
@@ -152,7 +304,7 @@ bool xdp2_timer_remove(struct xdp2_timer_wheel *wheel,
 
 	TIMER_MUTEX_AT(wheel, "Out remove timer");
 
-	pthread_mutex_unlock(&wheel->mutex);
+	timer_wheel_unlock(wheel);
 
 	return ret;
 }
@@ -167,13 +319,18 @@ void __xdp2_timer_add(struct xdp2_timer_wheel *wheel, struct xdp2_timer *timer,
 	unsigned long current_time;
 	unsigned long expire_time;
 
+	XDP2_ASSERT(!is_remote_thread(wheel), "Timer added to a local timer "
+		    "wheel by a thread that doesn't own the wheel");
+
 	/* We don't allow a delay of zero, so just make it 1 */
 	delay = delay ? : 1;
 
-	pthread_mutex_lock(&wheel->mutex);
+	timer_wheel_lock(wheel);
 
 	TIMER_MUTEX_AT(wheel, "In add timer");
 
+	process_remote_removes(wheel);
+
 	current_time = get_current_time(wheel);
 
 	expire_time = current_time + delay;
@@ -188,19 +345,24 @@ void __xdp2_timer_add(struct xdp2_timer_wheel *wheel, struct xdp2_timer *timer,
 	if (timer->timer_set) {
 		if (not_running) {
 			__XDP2_TIMER_BUMP_STAT(wheel, add_already_running);
-			pthread_mutex_unlock(&wheel->mutex);
+			timer_wheel_unlock(wheel);
 			return;
 		}
 		__XDP2_TIMER_BUMP_STAT(wheel, change_timers);
 		timer_remove_locked(wheel, timer);
 	}
 
-	/* Setup timer */
-	timer->gen = expire_time / wheel->num_slots;
-	timer->index = expire_time % wheel->num_slots;
+	if (!wheel->timer_count && !wheel->running &&
+	    xdp2_seqno_ul_lt(wheel->clock, current_time)) {
+		/* The wheel is empty, so catch up the clock to the current
+		 * time. This keeps new timers in the lowest levels
+		 */
+		wheel->clock = current_time;
+	}
 
-	CIRCLEQ_INSERT_HEAD(&wheel->slots[timer->index], timer, list_ent);
-	xdp2_bitmap_set(wheel->slot_bitmap, timer->index);
+	/* Setup timer */
+	timer->expire_time = expire_time;
+	timer_insert_locked(wheel, timer);
 	timer->timer_set = true;
 	wheel->timer_count++;
 
@@ -233,96 +395,164 @@ void __xdp2_timer_add(struct xdp2_timer_wheel *wheel, struct xdp2_timer *timer,
 
 	TIMER_MUTEX_AT(wheel, "Out add timer");
 
-	pthread_mutex_unlock(&wheel->mutex);
+	timer_wheel_unlock(wheel);
 }
 
-/* Safe version of CIRCLEQ foreach. This allows the entry to be removed in
- * the foreach loop
+/* Find the next time at or after the wheel clock where there is work to do.
+ * For level zero this is the expiration time of the next non-empty slot,
+ * for higher levels this is the time that the next non-empty slot is
+ * cascaded. Returns false if the wheel is empty
  */
-#define CIRCLEQ_FOREACH_SAFE(var, next, head, field)			\
-	for ((var) = (head)->cqh_first,					\
-				(next) = (var)->field.cqe_next;		\
-		(var) != (const void *)(head);				\
-		(var) = (next), next = ((var)->field.cqe_next))
+static bool find_next_event(struct xdp2_timer_wheel *wheel,
+			    unsigned long *next_event)
+{
+	unsigned int mask = wheel->num_slots - 1;
+	unsigned long clock = wheel->clock;
+	unsigned long best = 0, start, t;
+	unsigned int level, shift, first, index;
+	bool found = false;
+
+	for (level = 0; level < wheel->num_levels; level++) {
+		shift = level_shift(wheel, level);
+
+		/* First cascade boundary at or after the clock */
+		start = (clock + (1UL << shift) - 1) & ~((1UL << shift) - 1);
+		first = (start >> shift) & mask;
+
+		index = xdp2_bitmap_find(get_bitmap(wheel, level), first,
+					 wheel->num_slots);
+		if (index >= wheel->num_slots) {
+			index = xdp2_bitmap_find(get_bitmap(wheel, level), 0,
+						 first);
+			if (index >= first)
+				continue;
+		}
+
+		t = start + ((unsigned long)((index - first) & mask) << shift);
+		if (!found || t - clock < best - clock) {
+			best = t;
+			found = true;
+		}
+	}
+
+	*next_event = best;
 
-/* Run through the entries of one timer wheel slot
+	return found;
+}
+
+/* Move the timers in a slot to lower levels */
+static void cascade_slot(struct xdp2_timer_wheel *wheel, unsigned int level,
+			 unsigned int index)
+{
+	struct __xdp2_timer_wheel_list_head *slot = get_slot(wheel, level,
+							     index);
+	struct __xdp2_timer_wheel_list_head list;
+	struct xdp2_timer *timer;
+
+	/* Move the timers to a private list first. A timer beyond the
+	 * range of the wheel might be placed back in the same slot
+	 */
+	CIRCLEQ_INIT(&list);
+	while (!CIRCLEQ_EMPTY(slot)) {
+		timer = CIRCLEQ_FIRST(slot);
+		CIRCLEQ_REMOVE(slot, timer, list_ent);
+		CIRCLEQ_INSERT_TAIL(&list, timer, list_ent);
+	}
+	xdp2_bitmap_unset(get_bitmap(wheel, level), index);
+
+	while (!CIRCLEQ_EMPTY(&list)) {
+		timer = CIRCLEQ_FIRST(&list);
+		CIRCLEQ_REMOVE(&list, timer, list_ent);
+		timer_insert_locked(wheel, timer);
+		__XDP2_TIMER_BUMP_STAT(wheel, cascade_timers);
+	}
+
+	__XDP2_TIMER_BUMP_STAT(wheel, cascades);
+}
+
+struct expired_timer {
+	void (*callback)(void *arg);
+	void *arg;
+};
+
+/* Invoke a batch of timer callbacks with the timer wheel unlocked */
+static void run_callbacks(struct xdp2_timer_wheel *wheel,
+			  struct expired_timer *cbs, unsigned int *num_cbs)
+{
+	unsigned int i;
+
+	if (!*num_cbs)
+		return;
+
+	TIMER_MUTEX_AT(wheel, "Start time callbacks");
+	timer_wheel_unlock(wheel);
+	for (i = 0; i < *num_cbs; i++)
+		cbs[i].callback(cbs[i].arg);
+	timer_wheel_lock(wheel);
+	TIMER_MUTEX_AT(wheel, "End timer callbacks");
+
+	__XDP2_TIMER_BUMP_STAT(wheel, expire_batches);
+	*num_cbs = 0;
+}
+
+/* Process one tick of the wheel clock. First cascade any levels that roll
+ * over at this tick, and then expire the timers in the level zero slot
  *
  * Wheel timer mutex is held on entry, released for callbacks, and held
  * again at function return
  */
-static unsigned int run_slot(struct xdp2_timer_wheel *wheel, unsigned int index,
-			     unsigned long gen, unsigned long old_gen)
-{
-	unsigned long old_gen_mx = old_gen * wheel->num_slots;
-	unsigned long gen_mx = gen * wheel->num_slots;
-	struct {
-		void (*callback)(void *arg);
-		void *arg;
-	} cbs[8];
-	struct xdp2_timer *timer, *next;
-	int count, cb_count = 0, i;
+static unsigned int run_tick(struct xdp2_timer_wheel *wheel,
+			     struct expired_timer *cbs, unsigned int *num_cbs)
+{
+	unsigned int mask = wheel->num_slots - 1;
+	struct __xdp2_timer_wheel_list_head *slot;
+	unsigned int level, index, count = 0;
+	unsigned long clock = wheel->clock;
+	struct xdp2_timer *timer;
 
-	TIMER_MUTEX_AT(wheel, "In run slot");
-retry:
-	count = 0;
-	CIRCLEQ_FOREACH_SAFE(timer, next, &wheel->slots[index], list_ent) {
-		unsigned long t_gen_mx = timer->gen * wheel->num_slots;
+	TIMER_MUTEX_AT(wheel, "In run tick");
 
-		XDP2_ASSERT(xdp2_seqno_ul_gte(t_gen_mx, old_gen_mx),
-			    "Found timer in wheel with old generation "
-			    "%lu < %lu", t_gen_mx, old_gen_mx);
+	for (level = 1; level < wheel->num_levels; level++) {
+		if (clock & ((1UL << level_shift(wheel, level)) - 1))
+			break;
 
-		if (xdp2_seqno_ul_gt(t_gen_mx, gen_mx)) {
-			/* Still in the future */
-			continue;
-		}
+		index = (clock >> level_shift(wheel, level)) & mask;
+		if (xdp2_bitmap_isset(get_bitmap(wheel, level), index))
+			cascade_slot(wheel, level, index);
+	}
+
+	index = clock & mask;
+	slot = get_slot(wheel, 0, index);
+
+	/* The callbacks are made with the mutex released so timers could
+	 * be added or removed in the meantime. Remove expired timers from
+	 * the head of the slot and save their callbacks until a batch
+	 * is full, then invoke the batch and continue with the slot
+	 */
+	while (!CIRCLEQ_EMPTY(slot)) {
+		timer = CIRCLEQ_FIRST(slot);
+
+		XDP2_ASSERT(xdp2_seqno_ul_lte(timer->expire_time, clock),
+			    "Found timer in level zero slot with expire time "
+			    "%lu > clock %lu", timer->expire_time, clock);
 
 		/* Good expiration, remove from timer wheel */
-		CIRCLEQ_REMOVE(&wheel->slots[index], timer, list_ent);
+		CIRCLEQ_REMOVE(slot, timer, list_ent);
 		timer->timer_set = false;
 		wheel->timer_count--;
 
 		count++;
 
-		/* We want to make the callback with the mutex held which means
-		 * that timers could be added or emoved before returning. To
-		 * keep everything sane we batch up eight callbacks. If we
-		 * find all eight then unlock, invoke, and then reprocess the
-		 * slot from the beginning
-		 */
-		cbs[cb_count].callback =  timer->callback;
-		cbs[cb_count].arg =  timer->arg;
-
-		if (++cb_count >= 8) {
-			/* We got a full batch */
-
-			/* Unlock mutex for calling callbacks */
-			pthread_mutex_unlock(&wheel->mutex);
-			for (i = 0; i < cb_count; i++)
-				cbs[i].callback(cbs[i].arg);
-			pthread_mutex_lock(&wheel->mutex);
-
-			__XDP2_TIMER_BUMP_STAT(wheel, slot_retries);
-			cb_count = 0;
-			TIMER_MUTEX_AT(wheel, "Retry run slot");
-			goto retry;
-		}
-	}
-
-	if (CIRCLEQ_EMPTY(&wheel->slots[index]))
-		xdp2_bitmap_unset(wheel->slot_bitmap, index);
+		cbs[*num_cbs].callback = timer->callback;
+		cbs[*num_cbs].arg = timer->arg;
 
-	/* Unlock mutex for calling callbacks */
-	if (cb_count) {
-		TIMER_MUTEX_AT(wheel, "Start time callbacks");
-		pthread_mutex_unlock(&wheel->mutex);
-		for (i = 0; i < cb_count; i++)
-			cbs[i].callback(cbs[i].arg);
-		pthread_mutex_lock(&wheel->mutex);
-		TIMER_MUTEX_AT(wheel, "End timer callbacks");
+		if (++*num_cbs >= XDP2_TIMER_EXPIRE_BATCH)
+			run_callbacks(wheel, cbs, num_cbs);
 	}
 
-	TIMER_MUTEX_AT(wheel, "Out run slot");
+	xdp2_bitmap_unset(get_bitmap(wheel, 0), index);
+
+	TIMER_MUTEX_AT(wheel, "Out run tick");
 
 	return count;
 }
@@ -334,8 +564,9 @@ retry:
  */
 static void __xdp2_run_timer_wheel_locked(struct xdp2_timer_wheel *wheel)
 {
-	unsigned int index, last_index, count = 0;
-	unsigned long current_time, old_gen, new_gen;
+	struct expired_timer cbs[XDP2_TIMER_EXPIRE_BATCH];
+	unsigned long current_time, next_event;
+	unsigned int count = 0, num_cbs = 0;
 
 	TIMER_MUTEX_AT(wheel, "Run timer wheel locked enter");
 retry:
@@ -355,85 +586,44 @@ retry:
 
 	__XDP2_TIMER_BUMP_STAT(wheel, run_timer_wheel);
 
-	/* Compute current generation and new generation */
-	old_gen = wheel->last_runtime / wheel->num_slots;
-	new_gen = (current_time + 1) / wheel->num_slots;
+	process_remote_removes(wheel);
 
 	XDP2_ASSERT(xdp2_seqno_ul_lte(wheel->last_runtime, current_time),
 		    "Last runtime %lu is > current time %lu\n",
 		    wheel->last_runtime, current_time);
 
-	index = wheel->last_runtime % wheel->num_slots;
+	/* Advance the clock up to the current time. Jump directly to the
+	 * next tick that has timers to expire or a slot to cascade
+	 */
+	while (xdp2_seqno_ul_lte(wheel->clock, current_time)) {
+		if (!find_next_event(wheel, &next_event) ||
+		    xdp2_seqno_ul_gt(next_event, current_time)) {
+			wheel->clock = current_time + 1;
+			break;
+		}
 
-	if (old_gen == new_gen) {
-		/* Still on the old generation. Start from the previous
-		 * last run slot
-		 */
-		__XDP2_TIMER_BUMP_STAT(wheel, timer_wheel_same_gen);
-	} else if (old_gen + 1 == new_gen) {
-		/* Rolled over one generation. Process the remainder of the
-		 * previous generation and then reset index for the current
-		 * generation starting from zero
-		 */
-		TIMER_MUTEX_AT(wheel, "Run next gen slot start");
-		xdp2_bitmap_foreach_bit(wheel->slot_bitmap, index,
-					wheel->num_slots)
-			count += run_slot(wheel, index, new_gen - 1, old_gen);
-		index = 0;
-		__XDP2_TIMER_BUMP_STAT(wheel, timer_wheel_next_gen);
-		TIMER_MUTEX_AT(wheel, "Run next gen slot end");
-	} else {
-		/* We skipped more than one  to a new generation, do a full
-		 * sweep of all timers through the new generation minus one.
-		 * Then handle the current generation starting from a
-		 * zero index
-		 */
-		TIMER_MUTEX_AT(wheel, "Run next skips gen slot start");
-		index = 0;
-		xdp2_bitmap_foreach_bit(wheel->slot_bitmap, index,
-					wheel->num_slots)
-			count += run_slot(wheel, index, new_gen - 1, old_gen);
-		index = 0;
-		__XDP2_TIMER_BUMP_STAT(wheel, timer_wheel_skip_gens);
-		TIMER_MUTEX_AT(wheel, "Run next skip gen slots end");
+		wheel->clock = next_event;
+		count += run_tick(wheel, cbs, &num_cbs);
+		wheel->clock++;
 	}
 
-	TIMER_MUTEX_AT(wheel, "Run current gen slot start");
-	last_index = (current_time + 1) % wheel->num_slots;
-	xdp2_bitmap_foreach_bit(wheel->slot_bitmap, index,
-				last_index)
-		count += run_slot(wheel, index, new_gen, old_gen);
+	run_callbacks(wheel, cbs, &num_cbs);
 
 	wheel->last_runtime = current_time;
 
 	__XDP2_TIMER_ADD_STAT(wheel, timer_expires, count);
-	TIMER_MUTEX_AT(wheel, "Run current gen slot end");
-
-	/* Try to find next timeout */
-	index = xdp2_bitmap_find(wheel->slot_bitmap, last_index,
-				 wheel->num_slots);
-	if (index < wheel->num_slots) {
-		/* Next timer found in current generation. Note that the
-		 * timers for the slot might be for a later generation in
-		 * which case a spurious timeout will happen
-		 */
-		wheel->next_expire_time = new_gen * wheel->num_slots + index;
+
+	/* Set the next pop time. Note that if the next event is a cascade
+	 * then no timers might expire at the pop time
+	 */
+	if (find_next_event(wheel, &next_event)) {
+		wheel->next_expire_time = next_event;
 		set_next_timer_pop(wheel);
-	} else {
-		index = xdp2_bitmap_find(wheel->slot_bitmap, 0, last_index);
-		if (index < last_index) {
-			/* Next timer found in next generation. Note that the
-			 * timers for the slot might be for a later generation
-			 * in which case a spurious timeout will happen
-			 */
-			wheel->next_expire_time = (new_gen + 1) *
-						wheel->num_slots + index;
-			set_next_timer_pop(wheel);
-		} else {
-			/* No timers set in the wheel. Don't set
-			 * set the pop timer
-			 */
-		}
+	} else if (!has_timer_thread(wheel)) {
+		/* No timers set in the wheel. Don't set the pop timer and
+		 * mark it as not running
+		 */
+		wheel->next_expire_time = wheel->last_runtime;
 	}
 
 	if (!count)
@@ -466,11 +656,14 @@ void xdp2_run_timer_wheel(struct xdp2_timer_wheel *wheel)
 {
 	TIMER_MUTEX_AT_FUNC(wheel);
 
-	pthread_mutex_lock(&wheel->mutex);
+	XDP2_ASSERT(!is_remote_thread(wheel), "Local timer wheel run by a "
+		    "thread that doesn't own the wheel");
+
+	timer_wheel_lock(wheel);
 	TIMER_MUTEX_AT(wheel, "Before run timer wheel with lock");
 	__xdp2_run_timer_wheel_locked(wheel);
 	TIMER_MUTEX_AT(wheel, "After run timer wheel with lock");
-	pthread_mutex_unlock(&wheel->mutex);
+	timer_wheel_unlock(wheel);
 }
 
 /* Timer threads */
@@ -549,14 +742,14 @@ static struct xdp2_timer_wheel *__xdp2_timer_create_wheel(
 		unsigned long (*get_current_time)(void *arg),
 		void (*set_next_timer_pop)(void *arg,
 					   unsigned long expire_time),
-		unsigned int time_units)
+		unsigned int time_units, bool local)
 {
 	unsigned int num_slots = (1 << num_slots_order);
+	unsigned int bitmap_words = XDP2_BITMAP_NUM_BITS_TO_WORDS(num_slots);
+	/* Enough levels to cover the 32-bit delay of xdp2_timer_add */
+	unsigned int num_levels = 32 / num_slots_order + 1;
 	struct xdp2_timer_wheel *wheel;
-	size_t base_size = sizeof(*wheel) + (1 << num_slots_order) *
-			sizeof(struct __xdp2_timer_wheel_list_head);
-	size_t all_size = base_size + sizeof(unsigned long) *
-			XDP2_BITMAP_NUM_BITS_TO_WORDS(num_slots);
+	size_t base_size, all_size;
 	int i;
 
 	if (!time_units) {
@@ -564,24 +757,49 @@ static struct xdp2_timer_wheel *__xdp2_timer_create_wheel(
 		return NULL;
 	}
 
-	wheel = malloc(all_size);
+	if (!num_slots_order || num_slots_order > 16) {
+		XDP2_WARN("Number of slots order must be between 1 and 16 in "
+			  "timer wheel create");
+		return NULL;
+	}
+
+	base_size = sizeof(*wheel) + num_levels * num_slots *
+			sizeof(struct __xdp2_timer_wheel_list_head);
+	all_size = base_size + sizeof(unsigned long) * bitmap_words *
+			num_levels;
+
+	wheel = calloc(1, all_size);
 	if (!wheel)
 		return NULL;
 
 	/* Initialize timer wheel */
 	wheel->num_slots = num_slots;
+	wheel->num_slots_order = num_slots_order;
+	wheel->num_levels = num_levels;
 	wheel->slot_bitmap = (unsigned long *)((void *)wheel + base_size);
+	wheel->bitmap_words = bitmap_words;
 	wheel->cbarg = cbarg;
 	wheel->get_current_time = get_current_time;
 	wheel->set_next_timer_pop = set_next_timer_pop;
 	wheel->time_units = time_units;
 	wheel->time_div = 1000000000 / time_units;
 	wheel->where = "No info";
+	wheel->local = local;
+	wheel->owner = pthread_self();
+	atomic_init(&wheel->cancel_list, NULL);
+
+	/* Start the clock at the current time with the pop timer not
+	 * running. Note get_current_time is the argument here
+	 */
+	wheel->clock = get_current_time ? get_current_time(cbarg) :
+					  __get_current_time(wheel);
+	wheel->last_runtime = wheel->clock;
+	wheel->next_expire_time = wheel->clock;
 
 	pthread_mutex_init(&wheel->mutex, NULL);
 
 	/* Initialize the slots */
-	for (i = 0; i < num_slots; i++)
+	for (i = 0; i < num_levels * num_slots; i++)
 		CIRCLEQ_INIT(&wheel->slots[i]);
 
 	return wheel;
@@ -603,7 +821,20 @@ struct xdp2_timer_wheel *xdp2_timer_create_wheel(
 
 	return __xdp2_timer_create_wheel(num_slots_order, cbarg,
 					 get_current_time, set_next_timer_pop,
-					 time_units);
+					 time_units, false);
+}
+
+/* Create a local timer wheel owned by the calling thread */
+struct xdp2_timer_wheel *xdp2_timer_create_local_wheel(
+		unsigned int num_slots_order, void *cbarg,
+		unsigned long (*get_current_time)(void *arg),
+		void (*set_next_timer_pop)(void *arg,
+					   unsigned long expire_time),
+		unsigned int time_units)
+{
+	return __xdp2_timer_create_wheel(num_slots_order, cbarg,
+					 get_current_time, set_next_timer_pop,
+					 time_units, true);
 }
 
 /* Create timer wheel with external and start timer thread) */
@@ -616,7 +847,7 @@ struct xdp2_timer_wheel *xdp2_timer_create_wheel_with_timer_thread(
 	struct timespec ts;
 
 	wheel = __xdp2_timer_create_wheel(num_slots_order, NULL, NULL, NULL,
-					  time_units);
+					  time_units, false);
 	if (!wheel)
 		goto fail_wheel_create;
 
@@ -659,30 +890,34 @@ fail_wheel_create:
 static void show_timers(struct xdp2_timer_wheel *wheel, void *cli)
 {
 	struct xdp2_timer *timer;
-	unsigned int index = 0;
+	unsigned int level, index;
 
 	/* We don't want to hold the wheel timer mutex for the whole
 	 * function, just when processing each slot. This does mean that
 	 * some of the output might be a little inconsistent due to race
 	 * conditions (it's just debug info afterall)
 	 */
-	xdp2_bitmap_foreach_bit(wheel->slot_bitmap, index,
-				wheel->num_slots) {
-		XDP2_CLI_PRINT(cli, "Slot %u:\n", index);
+	for (level = 0; level < wheel->num_levels; level++) {
+		index = 0;
+		xdp2_bitmap_foreach_bit(get_bitmap(wheel, level), index,
+					wheel->num_slots) {
+			XDP2_CLI_PRINT(cli, "Level %u slot %u:\n",
+				       level, index);
 
-		/* We take the wheel timer mutex for processing each slot
-		 * to ensure pointer consistency
-		 */
-		pthread_mutex_lock(&wheel->mutex);
+			/* We take the wheel timer mutex for processing each
+			 * slot to ensure pointer consistency
+			 */
+			timer_wheel_lock(wheel);
 
-		CIRCLEQ_FOREACH(timer, &wheel->slots[index], list_ent)
-			XDP2_CLI_PRINT(cli, "\tTimer: gen: %lu index: %u, "
-				       "expire-time: %lu\n", timer->gen,
-				       timer->index,
-				       (timer->gen * wheel->num_slots) +
-								timer->index);
+			CIRCLEQ_FOREACH(timer, get_slot(wheel, level, index),
+					list_ent)
+				XDP2_CLI_PRINT(cli, "\tTimer: level: %u "
+					       "index: %u, expire-time: %lu\n",
+					       timer->level, timer->index,
+					       timer->expire_time);
 
-		pthread_mutex_unlock(&wheel->mutex);
+			timer_wheel_unlock(wheel);
+		}
 	}
 }
 
@@ -695,10 +930,13 @@ static void show_timer_wheel(struct xdp2_timer_wheel *wheel, bool show_all,
 {
 	struct xdp2_timer_wheel_stats *stats = &wheel->stats;
 
-	XDP2_CLI_PRINT(cli, "Timer wheel: %s, timer_count %u\n",
+	XDP2_CLI_PRINT(cli, "Timer wheel: %s%s, timer_count %u\n",
 		       wheel->last_runtime == wheel->next_expire_time ?
 						"not running" : "running",
-		       wheel->timer_count);
+		       wheel->local ? " (local)" : "", wheel->timer_count);
+	XDP2_CLI_PRINT(cli, "    Levels: %u, slots per level: %u, "
+			    "clock: %lu\n", wheel->num_levels,
+		       wheel->num_slots, wheel->clock);
 	XDP2_CLI_PRINT(cli, "    Current time: %lu\n",
 		       get_current_time(wheel));
 	XDP2_CLI_PRINT(cli, "    Last runtime %lu, Next expire time: %lu\n",
@@ -709,18 +947,17 @@ static void show_timer_wheel(struct xdp2_timer_wheel *wheel, bool show_all,
 		       stats->change_timers, stats->add_already_running);
 	XDP2_CLI_PRINT(cli, "    Timer expires: %lu, timer wheel runs: %lu\n",
 		       stats->timer_expires, stats->run_timer_wheel);
-	XDP2_CLI_PRINT(cli, "    Slot retries: %lu, timer mutex where: %s\n",
-		       stats->slot_retries, wheel->where);
+	XDP2_CLI_PRINT(cli, "    Expire batches: %lu, timer mutex where: %s\n",
+		       stats->expire_batches, wheel->where);
 	XDP2_CLI_PRINT(cli, "    Timer wheel runs: %lu, retries: %lu\n",
 		       stats->run_timer_wheel, stats->run_timer_wheel_retries);
 	XDP2_CLI_PRINT(cli, "    Spurious runs: %lu, remove with running %lu\n",
 		       stats->spurious_run_timer_wheel,
 		       stats->remove_wheel_running);
-	XDP2_CLI_PRINT(cli, "    Timer wheel same gen: %lu, "
-			    "next gen: %lu, skip gens: %lu\n",
-		       stats->timer_wheel_same_gen,
-		       stats->timer_wheel_next_gen,
-		       stats->timer_wheel_skip_gens);
+	XDP2_CLI_PRINT(cli, "    Cascades: %lu, cascaded timers: %lu, "
+			    "remote removes: %lu\n",
+		       stats->cascades, stats->cascade_timers,
+		       stats->remote_removes);
 
 	if (show_all)
 		show_timers(wheel, cli);
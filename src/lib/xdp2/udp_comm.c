@@ -0,0 +1,311 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Batched send and receive, GSO/GRO, and scatter-gather sends for UDP
+ * socket communications handles
+ */
+
+#include <errno.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "xdp2/udp_comm.h"
+#include "xdp2/utility.h"
+
+static void set_sockaddr(struct sockaddr_in *sin, struct in_addr addr,
+			 unsigned short port)
+{
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_port = port;
+	sin->sin_addr = addr;
+}
+
+/* Send a message as separate datagrams of seg_size bytes when the socket
+ * doesn't support GSO. Returns zero if all datagrams were sent
+ */
+static int send_segs(int sockfd, struct xdp2_comm_msg *msg)
+{
+	struct mmsghdr mmsgs[XDP2_COMM_BATCH_MAX];
+	struct iovec iovs[XDP2_COMM_BATCH_MAX];
+	struct sockaddr_in sin;
+	size_t off = 0, len;
+	unsigned int i;
+	int n;
+
+	set_sockaddr(&sin, msg->addr, msg->port);
+
+	while (off < msg->len) {
+		memset(mmsgs, 0, sizeof(mmsgs));
+
+		for (i = 0; i < XDP2_COMM_BATCH_MAX && off < msg->len; i++) {
+			len = xdp2_min(msg->len - off, (size_t)msg->seg_size);
+
+			iovs[i].iov_base = (__u8 *)msg->buff + off;
+			iovs[i].iov_len = len;
+			mmsgs[i].msg_hdr.msg_iov = &iovs[i];
+			mmsgs[i].msg_hdr.msg_iovlen = 1;
+			mmsgs[i].msg_hdr.msg_name = &sin;
+			mmsgs[i].msg_hdr.msg_namelen = sizeof(sin);
+			off += len;
+		}
+
+		n = sendmmsg(sockfd, mmsgs, i, 0);
+		if (n < 0)
+			return -1;
+
+		if (n < i) {
+			/* Partial send, resume from the first unsent
+			 * datagram
+			 */
+			off -= (i - n - 1) * msg->seg_size +
+			       iovs[i - 1].iov_len;
+		}
+	}
+
+	return 0;
+}
+
+static bool needs_gso(struct xdp2_comm_msg *msg)
+{
+	return msg->seg_size && msg->len > msg->seg_size;
+}
+
+int xdp2_udp_socket_send_batch(struct xdp2_comm_handle *comm,
+			       struct xdp2_comm_msg *msgs, unsigned int num)
+{
+	char cmsgs[XDP2_COMM_BATCH_MAX][CMSG_SPACE(sizeof(__u16))];
+	struct sockaddr_in sins[XDP2_COMM_BATCH_MAX];
+	struct mmsghdr mmsgs[XDP2_COMM_BATCH_MAX];
+	struct iovec iovs[XDP2_COMM_BATCH_MAX];
+	bool gso = comm->flags & XDP2_COMM_F_GSO;
+	unsigned int sent = 0, i, cnt;
+	struct xdp2_comm_msg *msg;
+	struct cmsghdr *cm;
+	int n;
+
+	num = xdp2_min(num, XDP2_COMM_BATCH_MAX);
+
+	while (sent < num) {
+		if (!gso && needs_gso(&msgs[sent])) {
+			/* No GSO, send the segments the slow way */
+			if (send_segs(comm->info, &msgs[sent]) < 0)
+				goto err;
+			sent++;
+			continue;
+		}
+
+		memset(mmsgs, 0, sizeof(mmsgs));
+
+		for (cnt = 0, i = sent; i < num; i++, cnt++) {
+			msg = &msgs[i];
+
+			if (!gso && needs_gso(msg))
+				break;
+
+			iovs[cnt].iov_base = msg->buff;
+			iovs[cnt].iov_len = msg->len;
+			set_sockaddr(&sins[cnt], msg->addr, msg->port);
+
+			mmsgs[cnt].msg_hdr.msg_iov = &iovs[cnt];
+			mmsgs[cnt].msg_hdr.msg_iovlen = 1;
+			mmsgs[cnt].msg_hdr.msg_name = &sins[cnt];
+			mmsgs[cnt].msg_hdr.msg_namelen = sizeof(sins[cnt]);
+
+			if (needs_gso(msg)) {
+				mmsgs[cnt].msg_hdr.msg_control = cmsgs[cnt];
+				mmsgs[cnt].msg_hdr.msg_controllen =
+						sizeof(cmsgs[cnt]);
+				cm = CMSG_FIRSTHDR(&mmsgs[cnt].msg_hdr);
+				cm->cmsg_level = SOL_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(__u16));
+				*(__u16 *)CMSG_DATA(cm) = msg->seg_size;
+			}
+		}
+
+		n = sendmmsg(comm->info, mmsgs, cnt, 0);
+		if (n < 0)
+			goto err;
+
+		sent += n;
+		if (n < cnt)
+			break;
+	}
+
+	return sent;
+
+err:
+	return sent ? (int)sent : -1;
+}
+
+int xdp2_udp_socket_recv_batch(struct xdp2_comm_handle *comm,
+			       struct xdp2_comm_msg *msgs, unsigned int num,
+			       bool wait)
+{
+	char cmsgs[XDP2_COMM_BATCH_MAX][CMSG_SPACE(sizeof(int))];
+	struct sockaddr_in sins[XDP2_COMM_BATCH_MAX];
+	struct mmsghdr mmsgs[XDP2_COMM_BATCH_MAX];
+	struct iovec iovs[XDP2_COMM_BATCH_MAX];
+	bool gro = comm->flags & XDP2_COMM_F_GRO;
+	struct cmsghdr *cm;
+	unsigned int i;
+	int n;
+
+	num = xdp2_min(num, XDP2_COMM_BATCH_MAX);
+
+	memset(mmsgs, 0, num * sizeof(mmsgs[0]));
+
+	for (i = 0; i < num; i++) {
+		iovs[i].iov_base = msgs[i].buff;
+		iovs[i].iov_len = msgs[i].len;
+		mmsgs[i].msg_hdr.msg_iov = &iovs[i];
+		mmsgs[i].msg_hdr.msg_iovlen = 1;
+		mmsgs[i].msg_hdr.msg_name = &sins[i];
+		mmsgs[i].msg_hdr.msg_namelen = sizeof(sins[i]);
+		if (gro) {
+			mmsgs[i].msg_hdr.msg_control = cmsgs[i];
+			mmsgs[i].msg_hdr.msg_controllen = sizeof(cmsgs[i]);
+		}
+	}
+
+	n = recvmmsg(comm->info, mmsgs, num,
+		     wait ? MSG_WAITFORONE : MSG_DONTWAIT, NULL);
+	if (n < 0)
+		return (!wait && (errno == EAGAIN || errno == EWOULDBLOCK)) ?
+								0 : -1;
+
+	for (i = 0; i < n; i++) {
+		msgs[i].len = mmsgs[i].msg_len;
+		msgs[i].addr = sins[i].sin_addr;
+		msgs[i].port = sins[i].sin_port;
+		msgs[i].seg_size = 0;
+
+		if (!gro)
+			continue;
+
+		for (cm = CMSG_FIRSTHDR(&mmsgs[i].msg_hdr); cm;
+		     cm = CMSG_NXTHDR(&mmsgs[i].msg_hdr, cm)) {
+			if (cm->cmsg_level == SOL_UDP &&
+			    cm->cmsg_type == UDP_GRO) {
+				msgs[i].seg_size = *(int *)CMSG_DATA(cm);
+				break;
+			}
+		}
+	}
+
+	return n;
+}
+
+ssize_t xdp2_udp_socket_send_iov(struct xdp2_comm_handle *comm,
+				 const struct iovec *iov, unsigned int iovcnt,
+				 struct in_addr to, unsigned short to_port)
+{
+	struct sockaddr_in sin;
+	struct msghdr mh;
+
+	set_sockaddr(&sin, to, to_port);
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_name = &sin;
+	mh.msg_namelen = sizeof(sin);
+	mh.msg_iov = (struct iovec *)iov;
+	mh.msg_iovlen = iovcnt;
+
+	return sendmsg(comm->info, &mh, 0);
+}
+
+struct send_pvbuf_iter {
+	struct iovec iovs[XDP2_COMM_MAX_IOVS];
+	unsigned int cnt;
+	bool overflow;
+};
+
+static bool send_pvbuf_iterate(void *priv, __u8 *data, size_t len)
+{
+	struct send_pvbuf_iter *ist = priv;
+
+	if (!len)
+		return true;
+
+	if (ist->cnt >= XDP2_COMM_MAX_IOVS) {
+		ist->overflow = true;
+		return false;
+	}
+
+	ist->iovs[ist->cnt].iov_base = data;
+	ist->iovs[ist->cnt].iov_len = len;
+	ist->cnt++;
+
+	return true;
+}
+
+ssize_t __xdp2_udp_socket_send_pvbuf(struct xdp2_pvbuf_mgr *pvmgr,
+				     struct xdp2_comm_handle *comm,
+				     xdp2_paddr_t paddr, struct in_addr to,
+				     unsigned short to_port)
+{
+	struct send_pvbuf_iter ist;
+
+	ist.cnt = 0;
+	ist.overflow = false;
+
+	__xdp2_pvbuf_iterate(pvmgr, paddr, send_pvbuf_iterate, &ist);
+
+	if (ist.overflow) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	return comm->send_data_iov(comm, ist.iovs, ist.cnt, to, to_port);
+}
+
+void xdp2_udp_socket_probe_gso(struct xdp2_comm_handle *comm)
+{
+	socklen_t len;
+	int val;
+
+	len = sizeof(val);
+	if (!getsockopt(comm->info, SOL_UDP, UDP_SEGMENT, &val, &len))
+		comm->flags |= XDP2_COMM_F_GSO;
+	else
+		comm->flags &= ~XDP2_COMM_F_GSO;
+}
+
+int xdp2_udp_socket_set_gro(struct xdp2_comm_handle *comm, bool enable)
+{
+	int val = enable;
+
+	if (setsockopt(comm->info, SOL_UDP, UDP_GRO, &val, sizeof(val)) < 0)
+		return -1;
+
+	if (enable)
+		comm->flags |= XDP2_COMM_F_GRO;
+	else
+		comm->flags &= ~XDP2_COMM_F_GRO;
+
+	return 0;
+}
@@ -32,6 +32,9 @@
 #include "xdp2/parser.h"
 #include "xdp2/proto_defs_define.h"
 #include "xdp2/compiler_helpers.h"
+<!--(if pgo_instrument)-->
+#include "xdp2/pgo.h"
+<!--(end)-->
 #include "@!filename!@"
 
 /* Template for making a plain C parser */
@@ -81,11 +84,15 @@ static inline __unused() __attribute__((always_inline)) int
 @!generate_xdp2_parse_tlv_function!@
 <!--(for root in roots)-->
 @!generate_xdp2_encap_layer(parser_name=root['parser_name'],frame_size=root['frame_size'],max_encaps=root['max_encaps'])!@
-	<!--(for node in graph)-->
-@!generate_protocol_parse_function_decl(parser_name=root['parser_name'],name=node)!@
-	<!--(end)-->
-	<!--(for node in graph)-->
-@!generate_protocol_parse_function(parser_name=root['parser_name'],name=node)!@
+	<!--(if codegen_iterative)-->
+@!generate_iterative_parse_function(parser_name=root['parser_name'],root_name=root['node_name'],nodes=layout[root['parser_name']])!@
+	<!--(else)-->
+		<!--(for node in graph)-->
+@!generate_protocol_parse_function_decl(parser_name=root['parser_name'],name=node,pgo_node=pgo[root['parser_name']][node])!@
+		<!--(end)-->
+		<!--(for node in graph)-->
+@!generate_protocol_parse_function(parser_name=root['parser_name'],name=node,pgo_node=pgo[root['parser_name']][node])!@
+		<!--(end)-->
 	<!--(end)-->
 @!generate_entry_parse_function(parser_name=root['parser_name'],root_name=root['node_name'],parser_add=root['parser_add'],parser_ext=root['parser_ext'],max_nodes=root['max_nodes'],max_frames=root['max_frames'],max_encaps=root['max_encaps'],metameta_size=root['metameta_size'],frame_size=root['frame_size'],num_counters=root['num_counters'],num_keys=root['num_keys'],okay_node=root['okay_node'],fail_node=root['fail_node'],atencap_node=root['atencap_node'])!@
 <!--(end)-->
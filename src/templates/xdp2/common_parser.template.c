@@ -45,12 +45,17 @@ static inline __unused() int
 	const struct xdp2_parse_node *parse_node;
 	int ret;
 
-	<!--(for node in graph)-->
+	<!--(if codegen_iterative)-->
+	ret = __@!parser_name!@_xdp2_parse_iter(
+			parser, hdr, len, metadata, &frame, 0, ctrl, flags);
+	<!--(else)-->
+		<!--(for node in graph)-->
 	(void)&__@!parser_name!@_@!node!@_xdp2_parse;
-	<!--(end)-->
+		<!--(end)-->
 
 	ret = __@!parser_name!@_@!root_name!@_xdp2_parse(
 			parser, hdr, len, metadata, &frame, 0, ctrl, flags);
+	<!--(end)-->
 
 	ctrl->var.ret_code = ret;
 
@@ -263,14 +268,14 @@ static inline __unused() __attribute__((unused)) int
 <!--(macro generate_protocol_parse_function_decl)-->
 
 /* Prototype for parse functions */
-static inline __unused() int
+static @!pgo_node['inline']!@__unused() int
 	__@!parser_name!@_@!name!@_xdp2_parse(
 		const struct xdp2_parser *parser, void *hdr, size_t len,
 		void *metadata, void **frame, unsigned int frame_num,
 		struct xdp2_ctrl_data *ctrl, unsigned int flags);
 <!--(end)-->
-
-<!--(macro generate_protocol_parse_function)-->
+<!--(macro generate_protocol_parse_next)-->@!('goto node_' + target + ';') if iterative else ('return __' + parser_name + '_' + target + '_xdp2_parse(')!@<!--(end)-->
+<!--(macro generate_protocol_parse_helpers)-->
 	<!--(if len(graph[name]['tlv_nodes']) != 0)-->
 @!generate_protocol_tlvs_parse_function(parser_name=parser_name,name=name)!@
 	<!--(end)-->
@@ -278,19 +283,16 @@ static inline __unused() int
 @!generate_protocol_fields_parse_function(parser_name=parser_name,name=name)!@
 	<!--(end)-->
 
-/* Parse function */
-static inline __unused() int
-	__@!parser_name!@_@!name!@_xdp2_parse(
-		const struct xdp2_parser *parser, void *hdr, size_t len,
-		void *metadata, void **frame, unsigned int frame_num,
-		struct xdp2_ctrl_data *ctrl, unsigned int flags)
-{
-	const struct xdp2_parse_node *parse_node =
-		(const struct xdp2_parse_node*)&@!name!@;
-	const struct xdp2_proto_def *proto_def = parse_node->proto_def;
-	ssize_t hlen;
-	int ret;
+	<!--(if len(pgo_node['targets']) != 0)-->
+/* Edge counters for profiling */
+		<!--(for target in pgo_node['targets'])-->
+XDP2_PGO_EDGE(__@!parser_name!@_@!name!@_pgo_@!target!@, "@!parser_name!@",
+	      "@!name!@", "@!target!@");
+		<!--(end)-->
 
+	<!--(end)-->
+<!--(end)-->
+<!--(macro generate_protocol_parse_body)-->
 	ctrl->var.last_node = parse_node;
 
 	ret = check_pkt_len(hdr, parse_node->proto_def, len, &hlen);
@@ -356,18 +358,42 @@ static inline __unused() int
 		len -= hlen;
 	}
 
+		<!--(if pgo_node['likely'])-->
+	/* Profiled fast path */
+	if (__builtin_expect(type == (@!pgo_node['likely']['macro_name']!@), 1)) {
+			<!--(if len(pgo_node['targets']) != 0)-->
+		xdp2_pgo_hit(&__@!parser_name!@_@!name!@_pgo_@!pgo_node['likely']['target']!@);
+			<!--(end)-->
+		@!generate_protocol_parse_next(parser_name=parser_name,target=pgo_node['likely']['target'],iterative=iterative)!@
+			<!--(if not iterative)-->
+			parser, hdr, len, metadata, frame, frame_num,
+			ctrl, flags);
+			<!--(end)-->
+	}
+
+		<!--(end)-->
 	switch (type) {
-		<!--(for edge_target in graph[name]['out_edges'])-->
+		<!--(for edge_target in pgo_node['edges'])-->
 	case @!edge_target['macro_name']!@:
-		return __@!parser_name!@_@!edge_target['target']!@_xdp2_parse(
+			<!--(if len(pgo_node['targets']) != 0)-->
+		xdp2_pgo_hit(&__@!parser_name!@_@!name!@_pgo_@!edge_target['target']!@);
+			<!--(end)-->
+		@!generate_protocol_parse_next(parser_name=parser_name,target=edge_target['target'],iterative=iterative)!@
+			<!--(if not iterative)-->
 			parser, hdr, len, metadata, frame, frame_num,
 			ctrl, flags);
+			<!--(end)-->
 		<!--(end)-->
 	}
 		<!--(if len(graph[name]['wildcard_proto_node']) != 0)-->
-	return __@!parser_name!@_@!graph[name]['wildcard_proto_node']!@_xdp2_parse(
+			<!--(if len(pgo_node['targets']) != 0)-->
+	xdp2_pgo_hit(&__@!parser_name!@_@!name!@_pgo_@!graph[name]['wildcard_proto_node']!@);
+			<!--(end)-->
+	@!generate_protocol_parse_next(parser_name=parser_name,target=graph[name]['wildcard_proto_node'],iterative=iterative)!@
+			<!--(if not iterative)-->
 		parser, hdr, len, metadata,
 		frame, frame_num, ctrl, flags);
+			<!--(end)-->
 		<!--(else)-->
 	return parse_node->unknown_ret;
 		<!--(end)-->
@@ -381,12 +407,67 @@ static inline __unused() int
 		len -= hlen;
 	}
 
-	return __@!parser_name!@_@!graph[name]['wildcard_proto_node']!@_xdp2_parse(
+			<!--(if len(pgo_node['targets']) != 0)-->
+	xdp2_pgo_hit(&__@!parser_name!@_@!name!@_pgo_@!graph[name]['wildcard_proto_node']!@);
+			<!--(end)-->
+	@!generate_protocol_parse_next(parser_name=parser_name,target=graph[name]['wildcard_proto_node'],iterative=iterative)!@
+			<!--(if not iterative)-->
 		parser, hdr, len, metadata, frame, frame_num, ctrl, flags);
+			<!--(end)-->
 		<!--(else)-->
 	return XDP2_STOP_OKAY;
 		<!--(end)-->
 	<!--(end)-->
+<!--(end)-->
+<!--(macro generate_protocol_parse_function)-->
+@!generate_protocol_parse_helpers(parser_name=parser_name,name=name,pgo_node=pgo_node)!@/* Parse function */
+static @!pgo_node['inline']!@__unused() @!pgo_node['attr']!@int
+	__@!parser_name!@_@!name!@_xdp2_parse(
+		const struct xdp2_parser *parser, void *hdr, size_t len,
+		void *metadata, void **frame, unsigned int frame_num,
+		struct xdp2_ctrl_data *ctrl, unsigned int flags)
+{
+	const struct xdp2_parse_node *parse_node =
+		(const struct xdp2_parse_node*)&@!name!@;
+	const struct xdp2_proto_def *proto_def = parse_node->proto_def;
+	ssize_t hlen;
+	int ret;
+
+@!generate_protocol_parse_body(parser_name=parser_name,name=name,pgo_node=pgo_node,iterative=False)!@}
+<!--(end)-->
+<!--(macro generate_iterative_parse_function)-->
+	<!--(for node in nodes)-->
+@!generate_protocol_parse_helpers(parser_name=parser_name,name=node,pgo_node=pgo[parser_name][node])!@
+	<!--(end)-->
+/* Parse function for the whole parse graph. Each parse node is a label and
+ * moving to the next node is a jump, so parsing runs in one stack frame
+ * however deep the packet is. The number of nodes visited is bounded by
+ * max_nodes
+ */
+static inline __unused() int
+	__@!parser_name!@_xdp2_parse_iter(
+		const struct xdp2_parser *parser, void *hdr, size_t len,
+		void *metadata, void **frame, unsigned int frame_num,
+		struct xdp2_ctrl_data *ctrl, unsigned int flags)
+{
+	const struct xdp2_parse_node *parse_node;
+	const struct xdp2_proto_def *proto_def;
+	unsigned int nodes = parser->config.max_nodes + 1;
+	ssize_t hlen;
+	int ret;
+
+	goto node_@!root_name!@;
+
+	<!--(for node in nodes)-->
+node_@!node!@:
+	if (!nodes--)
+		return XDP2_STOP_MAX_NODES;
+
+	parse_node = (const struct xdp2_parse_node *)&@!node!@;
+	proto_def = parse_node->proto_def;
+
+@!generate_protocol_parse_body(parser_name=parser_name,name=node,pgo_node=pgo[parser_name][node],iterative=True)!@
+	<!--(end)-->
 }
 <!--(end)-->
 
@@ -42,6 +42,10 @@
 #define XDP2_LOOP_COUNT 8
 #endif
 
+#ifndef XDP2_TAILCALL_LOOP_COUNT
+#define XDP2_TAILCALL_LOOP_COUNT 1
+#endif
+
 #define XDP2_MAX_ENCAPS (XDP2_LOOP_COUNT + 32)
 enum {
 <!--(for node in graph)-->
@@ -77,23 +81,40 @@ static __attribute__((unused)) __always_inline int
 
 <!--(macro generate_xdp2_encap_layer)-->
 static inline __attribute__((unused)) __attribute__((always_inline)) int
-	@!parser_name!@_xdp2_encap_layer(struct xdp2_metadata_all *metadata,
-					 void **frame, unsigned int *frame_num,
+	@!parser_name!@_xdp2_encap_layer(struct xdp2_xdp_ctx *ctx,
 					 unsigned int flags)
 {
 	/* New encapsulation layer. Check against number of encap layers
-	 * allowed and also if we need a new metadata frame.
+	 * allowed and also if we need a new metadata frame. Both counters
+	 * live in the context so that they persist across tail calls
 	 */
-	/* if (++metadata->num_encaps > @!max_encaps!@) */
-	/*	return XDP2_STOP_ENCAP_DEPTH; */
+	if (++ctx->num_encaps > @!max_encaps!@)
+		return XDP2_STOP_ENCAP_DEPTH;
 
-	/* if (metadata->num_encaps > *frame_num) { */
-	/*	*frame += @!frame_size!@; */
-	/*	*frame_num = (*frame_num) + 1; */
-	/* } */
+	if (ctx->frame_num + 1 < @!max_frames!@)
+		ctx->frame_num++;
 
 	return XDP2_OKAY;
 }
+
+/* Return the current metadata frame. The frame number is clamped to a
+ * constant so that the verifier can bound the offset into the metadata
+ */
+static inline __attribute__((unused)) __attribute__((always_inline)) void *
+	@!parser_name!@_xdp2_get_frame(struct xdp2_xdp_ctx *ctx,
+				       void *_metadata)
+{
+	<!--(if max_frames > 1)-->
+	__u32 frame_num = ctx->frame_num;
+
+	if (frame_num > @!max_frames - 1!@)
+		frame_num = @!max_frames - 1!@;
+
+	return _metadata + @!metameta_size!@ + frame_num * @!frame_size!@;
+	<!--(else)-->
+	return _metadata + @!metameta_size!@;
+	<!--(end)-->
+}
 <!--(end)-->
 
 /* Parse one TLV */
@@ -146,7 +167,10 @@ static __attribute__((unused)) __always_inline int
 		const void *hdr_end, void *_metadata, bool tailcall,
 		unsigned int flags)
 {
-	void *frame = (void *)_metadata;
+	void *frame = @!parser_name!@_xdp2_get_frame(ctx, _metadata);
+#ifdef XDP2_TAILCALL_AT_ENCAP
+	__u32 num_encaps = ctx->num_encaps;
+#endif
 	const void *start_hdr = *hdr;
 	int ret = XDP2_OKAY;
 
@@ -155,7 +179,18 @@ static __attribute__((unused)) __always_inline int
 						 frame, flags);
 
 	#pragma unroll
-	for (int i = 0; i < (tailcall ? 1 : XDP2_LOOP_COUNT); i++) {
+	for (int i = 0; i < (tailcall ? XDP2_TAILCALL_LOOP_COUNT :
+					XDP2_LOOP_COUNT); i++) {
+#ifdef XDP2_TAILCALL_AT_ENCAP
+		/* Parse each encapsulation layer in its own tail call to
+		 * keep the program within the verifier limits
+		 */
+		if (ctx->num_encaps != num_encaps)
+			break;
+#endif
+		/* Frame may have been advanced by an encapsulation protocol */
+		frame = @!parser_name!@_xdp2_get_frame(ctx, _metadata);
+
 		if (ctx->next == CODE_IGNORE || ret != XDP2_OKAY)
 			break;
 		<!--(for node in graph)-->
@@ -388,8 +423,7 @@ static __attribute__((unused)) __always_inline int __@!name!@_xdp2_parse(
 	<!--(end)-->
 
 	if (proto_def->encap) {
-		ret = @!parser_name!@_xdp2_encap_layer(_metadata, &frame,
-					&ctx->frame_num, flags);
+		ret = @!parser_name!@_xdp2_encap_layer(ctx, flags);
 		if (ret != XDP2_OKAY)
 			return ret;
 	}
@@ -410,9 +444,8 @@ static __attribute__((unused)) __always_inline int __@!name!@_xdp2_parse(
 	}
 	/* Unknown protocol */
 		<!--(if len(graph[name]['wildcard_proto_node']) != 0)-->
-	return __@!graph[name]['wildcard_proto_node']!@_xdp2_parse(
-		parser, hdr, len, _metadata, flags, max_encaps,
-		frame, frame_num, flags);
+	ctx->next = CODE_@!graph[name]['wildcard_proto_node']!@;
+	return XDP2_OKAY;
 		<!--(else)-->
 	return XDP2_STOP_UNKNOWN_PROTO;
 		<!--(end)-->
@@ -424,7 +457,7 @@ static __attribute__((unused)) __always_inline int __@!name!@_xdp2_parse(
 <!--(end)-->
 
 <!--(for root in roots)-->
-@!generate_xdp2_encap_layer(parser_name=root['parser_name'],frame_size=root['frame_size'],max_encaps=root['max_encaps'])!@
+@!generate_xdp2_encap_layer(parser_name=root['parser_name'],frame_size=root['frame_size'],max_encaps=root['max_encaps'],max_frames=root['max_frames'],metameta_size=root['metameta_size'])!@
   <!--(for node in graph)-->
 @!generate_protocol_parse_function_decl(name=node)!@
   <!--(end)-->
@@ -0,0 +1,630 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Test and benchmark for the accelerator stage library
+ *
+ * Run: ./test_accel_stages [ -c <test-count> ] [ -B <bench_mbytes> ] [-b]
+ *			    [-T] [-v]
+ *
+ * Random data, part compressible and part random, of random lengths is run
+ * through pipelines of the library stages:
+ *
+ *	checksum -> LZF compress -> CRC-32C append -> CRC-32C verify ->
+ *		LZF decompress, with default and small pipe sizes. The
+ *		output must be the input and the checksum and CRC must
+ *		match the ones computed over the linear data
+ *	LZF compress and LZF decompress as separate pipelines, and
+ *		decompress of a truncated and a corrupted stream
+ *	CRC-32C append -> corrupt a byte -> CRC-32C verify
+ *	checksum append -> checksum, the checksum of the data with its
+ *		checksum appended must be zero
+ *	segment -> segment with random segment sizes over random pvbufs
+ *	checksum -> a stage that fails or never consumes its input ->
+ *		checksum, the run must end with the stage's error or
+ *		ENOSPC
+ *
+ * Then the throughput of the compress and the round trip pipelines is
+ * measured (-b to only run the benchmark). -T runs the pipelines in
+ * threaded mode with each stage in its own thread
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crc/crc32c.h"
+#include "xdp2/accel_stages.h"
+#include "xdp2/checksum.h"
+#include "xdp2/pvbuf.h"
+#include "xdp2/utility.h"
+
+#define MAX_LEN (300 * 1000)
+#define MAX_PKTS 32
+#define MAX_PKT_LEN 9000
+#define MAX_SEGS (64 * 1024)
+
+static unsigned long errors;
+static bool verbose;
+
+static __u8 data[MAX_LEN];
+/* Sized for the worst case of stored blocks with a block size of one */
+static __u8 zdata[XDP2_ACCEL_LZF_MAX_OUT(MAX_LEN, 1)];
+static __u8 odata[2 * MAX_LEN];
+
+/* Test stage that flips the bits of the byte at an offset */
+
+struct corrupt_arg {
+	size_t offset;
+	size_t pos;
+};
+
+static ssize_t corrupt_dd(__u8 *ibytes, size_t ibytes_size,
+			  __u8 *obytes, size_t obytes_size,
+			  size_t *ibytes_consumed, void *arg)
+{
+	struct corrupt_arg *carg = arg;
+	size_t len = xdp2_min(ibytes_size, obytes_size);
+
+	memcpy(obytes, ibytes, len);
+
+	if (carg->offset >= carg->pos && carg->offset < carg->pos + len)
+		obytes[carg->offset - carg->pos] ^= 0xff;
+
+	carg->pos += len;
+	*ibytes_consumed = len;
+
+	return len;
+}
+
+static const struct xdp2_accelerator corrupt = {
+	.handler_dd = corrupt_dd,
+};
+
+/* Test stage that returns an error without consuming its input. The error
+ * is the argument
+ */
+
+static ssize_t stuck_dd(__u8 *ibytes, size_t ibytes_size,
+			__u8 *obytes, size_t obytes_size,
+			size_t *ibytes_consumed, void *arg)
+{
+	*ibytes_consumed = 0;
+
+	return -*(int *)arg;
+}
+
+static const struct xdp2_accelerator stuck = {
+	.handler_dd = stuck_dd,
+};
+
+/* Pipelines */
+
+XDP2_PIPELINE(roundtrip, D, xdp2_accel_checksum, D, xdp2_accel_lzf_compress,
+	      D, xdp2_accel_crc32c_append, D, xdp2_accel_crc32c_verify,
+	      D, xdp2_accel_lzf_decompress, D)
+
+XDP2_PIPELINE_SZ(roundtrip_sz, D, xdp2_accel_checksum, (D, 1021),
+		 xdp2_accel_lzf_compress, (D, 3001),
+		 xdp2_accel_crc32c_append, (D, 7),
+		 xdp2_accel_crc32c_verify, (D, 4093),
+		 xdp2_accel_lzf_decompress, D)
+
+XDP2_PIPELINE_SZ(zip, D, xdp2_accel_lzf_compress, (D, 1000),
+		 xdp2_accel_checksum, D)
+
+XDP2_PIPELINE_SZ(unzip, D, xdp2_accel_lzf_decompress, (D, 999),
+		 xdp2_accel_checksum, D)
+
+XDP2_PIPELINE_SZ(crc_bad, D, xdp2_accel_crc32c_append, (D, 555), corrupt,
+		 (D, 333), xdp2_accel_crc32c_verify, X)
+
+XDP2_PIPELINE_SZ(csum_append, D, xdp2_accel_checksum, (D, 101),
+		 xdp2_accel_checksum, X)
+
+XDP2_PIPELINE_SZ(seg, P, xdp2_accel_segment, (P, 17), xdp2_accel_segment, P)
+
+XDP2_PIPELINE_SZ(stall, D, xdp2_accel_checksum, (D, 101), stuck, (D, 101),
+		 xdp2_accel_checksum, X)
+
+static struct xdp2_pipeline *all_plines[] = {
+	&roundtrip_struct, &roundtrip_sz_struct, &zip_struct, &unzip_struct,
+	&crc_bad_struct, &csum_append_struct, &seg_struct, &stall_struct,
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Fill with a mix of random bytes and repeated words so that some LZF blocks
+ * are compressed and some are stored
+ */
+static void fill_data(__u8 *buf, size_t len)
+{
+	static const char *words[] = { "xdp2 ", "accelerator ", "pipeline ",
+				       "stage ", "lzf ", "crc32c " };
+	size_t i, chunk, wlen;
+	const char *w;
+
+	while (len) {
+		chunk = xdp2_min(len, 1 + (size_t)(random() % 4096));
+
+		if (random() % 4) {
+			for (i = 0; i < chunk; i += wlen) {
+				w = words[random() % ARRAY_SIZE(words)];
+				wlen = xdp2_min(strlen(w), chunk - i);
+				memcpy(&buf[i], w, wlen);
+			}
+		} else {
+			for (i = 0; i < chunk; i++)
+				buf[i] = random();
+		}
+
+		buf += chunk;
+		len -= chunk;
+	}
+}
+
+static size_t random_len(void)
+{
+	switch (random() % 4) {
+	case 0:
+		return random() % 16;
+	case 1:
+		return random() % 1024;
+	default:
+		return random() % MAX_LEN;
+	}
+}
+
+static size_t random_block_size(void)
+{
+	switch (random() % 4) {
+	case 0:
+		return 1 + random() % 64;
+	case 1:
+		return 0;
+	default:
+		return 1 + random() % XDP2_ACCEL_LZF_MAX_BLOCK;
+	}
+}
+
+static void fail(const char *what, size_t len, unsigned int error,
+		 unsigned int error_stage)
+{
+	fprintf(stderr, "%s failed: len %lu error %u stage %u\n", what, len,
+		error, error_stage);
+	errors++;
+}
+
+static __u16 linear_csum(const __u8 *buf, size_t len)
+{
+	return ~xdp2_checksum_compute(buf, len);
+}
+
+static void test_roundtrip(struct xdp2_pipeline *pline, size_t len,
+			   size_t osize)
+{
+	struct xdp2_accel_crc32c crca, crcv;
+	static struct xdp2_accel_lzf lzfc, lzfd;
+	unsigned int error = 0, error_stage = 0;
+	struct xdp2_accel_checksum cs;
+	void *args[] = { &cs, &lzfc, &crca, &crcv, &lzfd };
+	size_t olen;
+
+	xdp2_accel_checksum_init(&cs, false);
+	xdp2_accel_lzf_init(&lzfc, random_block_size());
+	xdp2_accel_crc32c_init(&crca);
+	xdp2_accel_crc32c_init(&crcv);
+	xdp2_accel_lzf_init(&lzfd, 0);
+
+	olen = __xdp2_run_pipeline_dd(pline, data, len, odata, osize,
+				      &error, &error_stage, args);
+
+	if (osize < len) {
+		/* The output doesn't fit */
+		if (error != ENOSPC || olen > osize)
+			fail("Round trip overflow", len, error, error_stage);
+		return;
+	}
+
+	if (error || olen != len || memcmp(data, odata, len) || !crcv.ok ||
+	    crca.crc != crcv.crc || cs.csum != linear_csum(data, len))
+		fail("Round trip", len, error, error_stage);
+}
+
+static size_t do_zip(size_t len, size_t block_size, unsigned int *error)
+{
+	static struct xdp2_accel_lzf lzf;
+	unsigned int error_stage = 0;
+	struct xdp2_accel_checksum cs;
+	void *args[] = { &lzf, &cs };
+	size_t zlen;
+
+	xdp2_accel_lzf_init(&lzf, block_size);
+	xdp2_accel_checksum_init(&cs, false);
+
+	*error = 0;
+	zlen = zip(data, len, zdata, sizeof(zdata), error, &error_stage,
+		   args);
+
+	if (cs.csum != linear_csum(zdata, zlen))
+		fail("Zip checksum", len, *error, error_stage);
+
+	return zlen;
+}
+
+static size_t do_unzip(size_t zlen, unsigned int *error)
+{
+	static struct xdp2_accel_lzf lzf;
+	unsigned int error_stage = 0;
+	struct xdp2_accel_checksum cs;
+	void *args[] = { &lzf, &cs };
+
+	xdp2_accel_lzf_init(&lzf, 0);
+	xdp2_accel_checksum_init(&cs, false);
+
+	*error = 0;
+	return unzip(zdata, zlen, odata, sizeof(odata), error, &error_stage,
+		     args);
+}
+
+static void test_zip(size_t len)
+{
+	unsigned int error;
+	size_t zlen, olen;
+
+	zlen = do_zip(len, random_block_size(), &error);
+	if (error) {
+		fail("Zip", len, error, 0);
+		return;
+	}
+
+	olen = do_unzip(zlen, &error);
+	if (error || olen != len || memcmp(data, odata, len))
+		fail("Unzip", len, error, 0);
+
+	if (!zlen)
+		return;
+
+	/* Truncated stream */
+	do_unzip(zlen - 1, &error);
+	if (error != EINVAL)
+		fail("Unzip truncated", len, error, 0);
+
+	/* Bad block header */
+	zdata[0] ^= 0xff;
+	do_unzip(zlen, &error);
+	if (error != EINVAL)
+		fail("Unzip corrupted", len, error, 0);
+}
+
+/* Compress into an output buffer that's too small for the compressed
+ * stream, the run fails with ENOSPC instead of waiting for space
+ */
+static void test_zip_overflow(size_t len)
+{
+	size_t zlen, olen, osize, block_size = 1 + random() % 64;
+	static struct xdp2_accel_lzf lzf;
+	unsigned int error, error_stage = 0;
+	struct xdp2_accel_checksum cs;
+	void *args[] = { &lzf, &cs };
+
+	zlen = do_zip(len, block_size, &error);
+	if (error || !zlen)
+		return;
+
+	osize = random() % zlen;
+
+	xdp2_accel_lzf_init(&lzf, block_size);
+	xdp2_accel_checksum_init(&cs, false);
+
+	error = 0;
+	olen = zip(data, len, zdata, osize, &error, &error_stage, args);
+	if (error != ENOSPC || olen > osize)
+		fail("Zip overflow", len, error, error_stage);
+}
+
+/* A middle stage that fails ends the run with its error, and one that
+ * never consumes its input ends the run with ENOSPC
+ */
+static void test_stall(size_t len, int err)
+{
+	unsigned int error = 0, error_stage = 0;
+	struct xdp2_accel_checksum cs1, cs2;
+	void *args[] = { &cs1, &err, &cs2 };
+	unsigned int expect_stage = err == EAGAIN ? 3 : 1;
+	int expect = err == EAGAIN ? ENOSPC : err;
+
+	xdp2_accel_checksum_init(&cs1, false);
+	xdp2_accel_checksum_init(&cs2, false);
+
+	stall(data, len, NULL, 0, &error, &error_stage, args);
+
+	if (error != expect || error_stage != expect_stage)
+		fail("Stalled stage", len, error, error_stage);
+}
+
+static void test_crc_bad(size_t len)
+{
+	unsigned int error = 0, error_stage = 0;
+	struct xdp2_accel_crc32c crca, crcv;
+	struct corrupt_arg carg = {};
+	void *args[] = { &crca, &carg, &crcv };
+
+	if (!len)
+		return;
+
+	xdp2_accel_crc32c_init(&crca);
+	xdp2_accel_crc32c_init(&crcv);
+	carg.offset = random() % (len + XDP2_ACCEL_CRC32C_LEN);
+
+	crc_bad(data, len, NULL, 0, &error, &error_stage, args);
+
+	if (crcv.ok)
+		fail("CRC corrupt", len, error, error_stage);
+}
+
+static void test_csum_append(size_t len)
+{
+	struct xdp2_accel_checksum cs1, cs2;
+	unsigned int error = 0, error_stage = 0;
+	void *args[] = { &cs1, &cs2 };
+
+	/* The appended checksum must be sixteen bit aligned */
+	len &= ~1UL;
+
+	xdp2_accel_checksum_init(&cs1, true);
+	xdp2_accel_checksum_init(&cs2, false);
+
+	csum_append(data, len, NULL, 0, &error, &error_stage, args);
+
+	if (error || cs2.len != len + sizeof(__u16) || cs2.csum)
+		fail("Checksum append", len, error, error_stage);
+}
+
+static xdp2_paddr_t make_pkt(const __u8 *buf, size_t len)
+{
+	struct xdp2_pvbuf *pvbuf;
+	xdp2_paddr_t paddr;
+
+	paddr = xdp2_pvbuf_alloc_params(len, 0, 0, &pvbuf);
+	XDP2_ASSERT(paddr, "pvbuf alloc failed");
+
+	XDP2_ASSERT(xdp2_pvbuf_copy_data_to_pvbuf(paddr, (void *)buf, len,
+						   0) == len,
+		    "Bad pvbuf copy");
+
+	return paddr;
+}
+
+static void test_segment(void)
+{
+	static xdp2_paddr_t opkts[MAX_SEGS];
+	unsigned int error = 0, error_stage = 0;
+	struct xdp2_accel_segment seg1, seg2;
+	size_t size1, size2, lens[MAX_PKTS];
+	xdp2_paddr_t ipkts[MAX_PKTS];
+	void *args[] = { &seg1, &seg2 };
+	unsigned int i, num, cnt;
+	size_t len, total = 0, off = 0, expect = 0;
+
+	size1 = 64 + random() % 3000;
+	size2 = 64 + random() % 3000;
+	num = 1 + random() % MAX_PKTS;
+
+	xdp2_accel_segment_init(&seg1, size1);
+	xdp2_accel_segment_init(&seg2, size2);
+
+	for (i = 0; i < num; i++) {
+		lens[i] = 1 + random() % MAX_PKT_LEN;
+		ipkts[i] = make_pkt(&data[total], lens[i]);
+		total += lens[i];
+
+		/* Segments of size1 split into segments of size2 */
+		expect += (lens[i] / size1) *
+				xdp2_round_up_div(size1, size2) +
+			  xdp2_round_up_div(lens[i] % size1, size2);
+	}
+
+	cnt = seg((void **)ipkts, num, (void **)opkts, MAX_SEGS, &error,
+		  &error_stage, args);
+
+	if (error || cnt != expect)
+		fail("Segment", total, error, error_stage);
+
+	for (i = 0; i < cnt; i++) {
+		len = xdp2_pvbuf_calc_length(opkts[i]);
+		if (len > xdp2_min(size1, size2) || off + len > total ||
+		    xdp2_pvbuf_copy_pvbuf_to_data(opkts[i], odata, len,
+						  0) != len ||
+		    memcmp(odata, &data[off], len)) {
+			fail("Segment data", total, 0, 0);
+			break;
+		}
+		off += len;
+	}
+
+	if (i == cnt && off != total)
+		fail("Segment length", total, 0, 0);
+
+	for (i = 0; i < cnt; i++)
+		xdp2_pvbuf_free(opkts[i]);
+}
+
+static void run_tests(unsigned int count)
+{
+	unsigned int i;
+	size_t len;
+
+	for (i = 0; i < count; i++) {
+		len = random_len();
+		fill_data(data, len);
+
+		test_roundtrip(&roundtrip_struct, len, sizeof(odata));
+		test_roundtrip(&roundtrip_sz_struct, len, sizeof(odata));
+		if (len)
+			test_roundtrip(&roundtrip_sz_struct, len,
+				       random() % len);
+		test_zip(len);
+		test_zip_overflow(len);
+		test_stall(len, EINVAL);
+		test_stall(len, EAGAIN);
+		test_crc_bad(len);
+		test_csum_append(len);
+		test_segment();
+
+		if (verbose)
+			printf("Test %u: len %lu\n", i, len);
+	}
+}
+
+static void bench(unsigned long bytes)
+{
+	static struct xdp2_accel_lzf lzfc, lzfd;
+	unsigned int error = 0, error_stage = 0;
+	struct xdp2_accel_crc32c crca, crcv;
+	struct xdp2_accel_checksum cs;
+	void *rargs[] = { &cs, &lzfc, &crca, &crcv, &lzfd };
+	unsigned long i, iters = xdp2_round_up_div(bytes, MAX_LEN);
+	size_t zlen = 0;
+	double secs;
+
+	fill_data(data, MAX_LEN);
+
+	secs = now();
+	for (i = 0; i < iters; i++)
+		zlen = do_zip(MAX_LEN, 0, &error);
+	secs = now() - secs;
+
+	printf("Compress: %.1f MB/s, ratio %.2f\n",
+	       iters * MAX_LEN / secs / 1e6, (double)MAX_LEN / zlen);
+
+	secs = now();
+	for (i = 0; i < iters; i++) {
+		xdp2_accel_checksum_init(&cs, false);
+		xdp2_accel_lzf_init(&lzfc, 0);
+		xdp2_accel_crc32c_init(&crca);
+		xdp2_accel_crc32c_init(&crcv);
+		xdp2_accel_lzf_init(&lzfd, 0);
+
+		roundtrip(data, MAX_LEN, odata, sizeof(odata), &error,
+			  &error_stage, rargs);
+	}
+	secs = now() - secs;
+
+	printf("Round trip: %.1f MB/s\n", iters * MAX_LEN / secs / 1e6);
+}
+
+#define ARGS "c:B:bTv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-c <count>] [-B <bench_mbytes>] ", name);
+	fprintf(stderr, "[-b] [-T] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct xdp2_pbuf_init_allocator pbuf_allocs = {
+		.obj[5].num_objs = 4096,
+	};
+	struct xdp2_pvbuf_init_allocator pvbuf_allocs = {
+		.obj[1].num_pvbufs = 4 * MAX_SEGS,
+	};
+	unsigned long bench_bytes = 64UL << 20;
+	bool bench_only = false, threaded = false;
+	unsigned int count = 100;
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'B':
+			bench_bytes = strtoul(optarg, NULL, 10) << 20;
+			break;
+		case 'b':
+			bench_only = true;
+			break;
+		case 'T':
+			threaded = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (xdp2_pvbuf_init(&pbuf_allocs, &pvbuf_allocs, false, false,
+			    NULL, NULL)) {
+		fprintf(stderr, "pvbuf init failed\n");
+		exit(-1);
+	}
+
+	if (xdp2_init_pipelines()) {
+		fprintf(stderr, "pipeline init failed\n");
+		exit(-1);
+	}
+
+	if (threaded) {
+		for (i = 0; i < ARRAY_SIZE(all_plines); i++) {
+			if (xdp2_pipeline_start_threads(all_plines[i], NULL,
+							0, NULL)) {
+				fprintf(stderr, "start threads failed\n");
+				exit(-1);
+			}
+		}
+	}
+
+	if (!bench_only) {
+		run_tests(count);
+		printf("Tests done: %lu errors\n", errors);
+	}
+
+	if (bench_bytes)
+		bench(bench_bytes);
+
+	if (threaded)
+		for (i = 0; i < ARRAY_SIZE(all_plines); i++)
+			xdp2_pipeline_stop_threads(all_plines[i]);
+
+	return errors ? -1 : 0;
+}
@@ -29,11 +29,18 @@
  * Run: ./test_accel [ -c <test-count> ] [ -v <verbose> ]
  *		     [ -I <report-interval> ][ -C <cli_port_num> ]
  *		     [-R] [ -t <test> ] [ -B <byte-count> ]
+ *		     [-T] [ -W <work> ] [-S]
+ *
+ * -T runs the pipelines in threaded mode with each stage in its own thread.
+ * -W adds some work per byte in the handlers to simulate heavy stages.
+ * -S measures the throughput of a pipeline (set by -t) in sequential and
+ * threaded mode
  */
 
 #include <errno.h>
 #include <getopt.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "xdp2/accelerator.h"
 #include "xdp2/pvbuf.h"
@@ -44,6 +51,7 @@
 #define MAX_BYTES 10000000
 #define CONSEC_NO_OUT 10000000
 #define NUM_TESTS 100000
+#define NUM_BENCH_RUNS 20
 
 /* Set the block size divisor to 95, that seems to be the maximum value
  * without getting output packets stuck
@@ -56,6 +64,9 @@ xdp2_paddr_t big_input_pkt;
 
 static int verbose;
 
+/* Iterations of work per byte done by the handlers */
+static unsigned int stage_work;
+
 struct iterate_struct {
 	size_t offset; /* Offset for skipping bytes */
 	size_t len; /* Output length remaining */
@@ -100,10 +111,11 @@ enum test_types {
 
 struct my_pipeline_s {
 	void *pfunc;
+	struct xdp2_pipeline *pline;
 	int value;
 	const char *name;
 	enum test_types type;
-};
+} XDP2_ALIGN_SECTION;
 
 #if 0
 static bool print_iterate(void *priv, __u8 *data, size_t len)
@@ -162,10 +174,22 @@ static void init_packet(xdp2_paddr_t pkt)
 static void iadd(__u8 *ibytes, __u8 *obytes, size_t len,
 		 unsigned int v)
 {
+	unsigned int j;
+	__u8 b;
 	int i;
 
-	for (i = 0; i < len; i++)
-		obytes[i] = ibytes[i] + v;
+	if (!stage_work) {
+		for (i = 0; i < len; i++)
+			obytes[i] = ibytes[i] + v;
+		return;
+	}
+
+	for (i = 0; i < len; i++) {
+		b = ibytes[i];
+		for (j = 0; j < stage_work; j++)
+			__asm__ __volatile__("" : "+r" (b));
+		obytes[i] = b + v;
+	}
 }
 
 /* Check a range of bytes for the expected value */
@@ -705,6 +729,7 @@ XDP2_DEFINE_SECTION(all_my_piplines, struct my_pipeline_s)
 	    XDP2_SECTION_ATTR(all_my_piplines) = {			\
 		.type = TYPE,						\
 		.pfunc = NAME,						\
+		.pline = &XDP2_JOIN2(NAME, _struct),			\
 		.value = VALUE,						\
 		.name = XDP2_STRING_IT(NAME),				\
 	};
@@ -925,10 +950,72 @@ static void run_one_d_(__u8 *data, struct my_pipeline_s *pline, int tnum,
 	}
 }
 
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Start threaded mode for a pipeline with each stage in its own thread.
+ * Workers are pinned to CPUs round robin starting from CPU one, the caller
+ * runs the first stage
+ */
+static void start_threads(struct my_pipeline_s *pline)
+{
+	long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int cpus[XDP2_PIPELINE_MAX_STAGES];
+	int i, ret;
+
+	for (i = 0; i < XDP2_PIPELINE_MAX_STAGES; i++)
+		cpus[i] = (i + 1) % num_cpus;
+
+	ret = xdp2_pipeline_start_threads(pline->pline, NULL, 0, cpus);
+	if (ret)
+		XDP2_ERR(1, "Start threads for %s failed: %s", pline->name,
+			 strerror(-ret));
+}
+
+/* Run one test on a pipeline */
+static void run_one(__u8 *data, struct my_pipeline_s *pline, int which,
+		    size_t byte_count, size_t block_size)
+{
+	switch (pline->type) {
+	case TEST_DD:
+		run_one_d_(data, pline, which, XDP2_PIPELINE_D,
+			   byte_count, block_size);
+		break;
+	case TEST_DP:
+		run_one_d_(data, pline, which, XDP2_PIPELINE_P,
+			   byte_count, block_size);
+		break;
+	case TEST_DX:
+		run_one_d_(data, pline, which, XDP2_PIPELINE_X,
+			   byte_count, block_size);
+		break;
+	case TEST_PD:
+		run_one_p_(data, pline, which, XDP2_PIPELINE_D,
+			   byte_count, block_size);
+		break;
+	case TEST_PP:
+		run_one_p_(data, pline, which, XDP2_PIPELINE_P,
+			   byte_count, block_size);
+		break;
+	case TEST_PX:
+		run_one_p_(data, pline, which, XDP2_PIPELINE_X,
+			   byte_count, block_size);
+		break;
+	default:
+		break;
+	}
+}
+
 /* Run the tests */
 static void run_all(unsigned long num_tests, const char *run_test,
 		    size_t byte_count, size_t block_size, bool kill_tests,
-		    int intv)
+		    int intv, bool threaded)
 {
 	unsigned int num_my_pipes = xdp2_section_array_size_all_my_piplines();
 	struct my_pipeline_s *plines = xdp2_section_base_all_my_piplines();
@@ -968,35 +1055,68 @@ static void run_all(unsigned long num_tests, const char *run_test,
 
 		pipeline_counts[which].used++;
 
-		switch (pline->type) {
-		case TEST_DD:
-			run_one_d_(data, pline, which, XDP2_PIPELINE_D,
-				   byte_count, block_size);
-			break;
-		case TEST_DP:
-			run_one_d_(data, pline, which, XDP2_PIPELINE_P,
-				   byte_count, block_size);
-			break;
-		case TEST_DX:
-			run_one_d_(data, pline, which, XDP2_PIPELINE_X,
-				   byte_count, block_size);
-			break;
-		case TEST_PD:
-			run_one_p_(data, pline, which, XDP2_PIPELINE_D,
-				   byte_count, block_size);
-			break;
-		case TEST_PP:
-			run_one_p_(data, pline, which, XDP2_PIPELINE_P,
-				   byte_count, block_size);
-			break;
-		case TEST_PX:
-			run_one_p_(data, pline, which, XDP2_PIPELINE_X,
-				   byte_count, block_size);
-			break;
-		default:
+		/* In threaded mode start and stop the threads for each test
+		 * to exercise the setup and teardown
+		 */
+		if (threaded)
+			start_threads(pline);
+
+		run_one(data, pline, which, byte_count, block_size);
+
+		if (threaded)
+			xdp2_pipeline_stop_threads(pline->pline);
+	}
+}
+
+/* Measure the throughput of one pipeline in sequential and threaded mode */
+static void run_bench(unsigned long num_tests, const char *run_test,
+		      size_t byte_count, size_t block_size)
+{
+	unsigned int num_my_pipes = xdp2_section_array_size_all_my_piplines();
+	struct my_pipeline_s *plines = xdp2_section_base_all_my_piplines();
+	struct my_pipeline_s *pline = NULL;
+	double start, rates[2];
+	unsigned long i;
+	int which, mode;
+	__u8 *data;
+
+	if (!run_test)
+		run_test = "test7sz_dd";
+
+	for (which = 0; which < num_my_pipes; which++) {
+		pline = &plines[which];
+		if (!strcmp(pline->name, run_test))
 			break;
-		}
 	}
+	if (which >= num_my_pipes)
+		XDP2_ERR(1, "Unable to find pipline %s", run_test);
+
+	data = calloc(1, MAX_BYTES);
+	if (!data)
+		exit(1);
+
+	if (!byte_count)
+		byte_count = MAX_BYTES;
+
+	for (mode = 0; mode < 2; mode++) {
+		if (mode)
+			start_threads(pline);
+
+		start = now();
+		for (i = 0; i < num_tests; i++)
+			run_one(data, pline, which, byte_count, block_size);
+		rates[mode] = byte_count * num_tests / (now() - start) / 1e6;
+
+		if (mode)
+			xdp2_pipeline_stop_threads(pline->pline);
+	}
+
+	printf("%s %u stages work %u: sequential %.1f MB/s, "
+	       "threaded %.1f MB/s (%.2fx)\n", pline->name,
+	       pline->pline->num_stages, stage_work, rates[0], rates[1],
+	       rates[1] / rates[0]);
+
+	free(data);
 }
 
 /* Allocate PVbufs */
@@ -1013,7 +1133,11 @@ static void make_pvbuf(void)
 	struct xdp2_pvbuf *pvbuf;
 	int i;
 
-	xdp2_pvbuf_init(&pbuf_allocs, &pvbuf_allocs, false, false, NULL, NULL);
+	if (xdp2_pvbuf_init(&pbuf_allocs, &pvbuf_allocs, false, false, NULL,
+			    NULL)) {
+		fprintf(stderr, "pvbuf init failed\n");
+		exit(-1);
+	}
 
 	for (i = 0; i < MAX_IPKTS; i++) {
 		input_pkt[i] = xdp2_pvbuf_alloc_params(MAX_BYTES / MAX_IPKTS,
@@ -1050,7 +1174,7 @@ static void show_pipelines(void *cli,
 
 XDP2_CLI_ADD_SHOW_CONFIG("pipelines", show_pipelines, 0xffff);
 
-#define ARGS "c:v:I:C:Rt:B:b:kP:"
+#define ARGS "c:v:I:C:Rt:B:b:kP:TW:S"
 
 static void usage(char *prog)
 {
@@ -1059,6 +1183,7 @@ static void usage(char *prog)
 	fprintf(stderr, "\t[ -I <report-interval> ][ -C <cli_port_num> ]\n");
 	fprintf(stderr, "\t[-R] [ -t <test> ] [ -B <byte-count> ]\n");
 	fprintf(stderr, "\t[ -b <block-size> ] [-k] [ -P <prompt-color> ]\n");
+	fprintf(stderr, "\t[-T] [ -W <work> ] [-S]\n");
 
 	exit(1);
 }
@@ -1068,10 +1193,12 @@ int main(int argc, char *argv[])
 	static struct xdp2_cli_thread_info cli_thread_info;
 	size_t byte_count = 0, block_size = 0;
 	int cli_port_num = 0, sleep_time = 0;
-	unsigned long num_tests = NUM_TESTS;
+	unsigned long num_tests = 0;
 	const char *prompt_color = NULL;
 	bool random_seed = false;
 	bool kill_tests = false;
+	bool threaded = false;
+	bool bench = false;
 	char *run_test = NULL;
 	unsigned int intv = 0;
 	int c;
@@ -1108,11 +1235,23 @@ int main(int argc, char *argv[])
 		case 'P':
 			prompt_color = xdp2_print_color_select_text(optarg);
 			break;
+		case 'T':
+			threaded = true;
+			break;
+		case 'W':
+			stage_work = strtoul(optarg, NULL, 10);
+			break;
+		case 'S':
+			bench = true;
+			break;
 		default:
 			usage(argv[0]);
 		}
 	}
 
+	if (!num_tests)
+		num_tests = bench ? NUM_BENCH_RUNS : NUM_TESTS;
+
 	if (random_seed)
 		srand(time(NULL));
 
@@ -1131,7 +1270,13 @@ int main(int argc, char *argv[])
 	pipeline_counts = calloc(xdp2_section_array_size_all_my_piplines(),
 		sizeof(struct pipeline_counts));
 
-	run_all(num_tests, run_test, byte_count, block_size, kill_tests, intv);
+	if (bench) {
+		run_bench(num_tests, run_test, byte_count, block_size);
+		return 0;
+	}
+
+	run_all(num_tests, run_test, byte_count, block_size, kill_tests, intv,
+		threaded);
 
 	sleep(sleep_time);
 }
@@ -0,0 +1,289 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2025 Tom Herbert
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Test and benchmark for the bulk bitmap kernels
+ *
+ * Each kernel supported by the CPU is checked against a bit at a time
+ * reference on random bitmaps of various densities and sizes, then the
+ * kernels are benchmarked on a large bitmap. The generic kernel is the
+ * inline word at a time bitmap code
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/bitmap.h"
+#include "xdp2/utility.h"
+
+#include "bench_bitmap.h"
+
+#define BULK_MAX_NBITS	4096
+#define BULK_MAX_WORDS	(BULK_MAX_NBITS / 64)
+
+static unsigned long bulk_errors;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool ref_isset(const unsigned long *map, unsigned int pos)
+{
+	return !!(map[pos / 64] & (1UL << (pos % 64)));
+}
+
+static unsigned int ref_find(const unsigned long *map, unsigned int pos,
+			     unsigned int nbits, bool val)
+{
+	for (; pos < nbits; pos++)
+		if (ref_isset(map, pos) == val)
+			return pos;
+
+	return nbits;
+}
+
+/* Fill a map where each word is empty, full, or random with one in
+ * density chance of each bit being set, so that finds need to skip runs
+ * of empty and full words
+ */
+static void fill_map(unsigned long *map, unsigned int nwords)
+{
+	unsigned int i, j, density;
+
+	for (i = 0; i < nwords; i++) {
+		switch (random() % 4) {
+		case 0:
+			map[i] = 0;
+			break;
+		case 1:
+			map[i] = ~0UL;
+			break;
+		default:
+			density = 1 + random() % 64;
+			map[i] = 0;
+			for (j = 0; j < 64; j++)
+				if (!(random() % density))
+					map[i] |= 1UL << j;
+			break;
+		}
+	}
+}
+
+static void bulk_error(const struct xdp2_bitmap_kernel *kernel,
+		       const char *op, unsigned int pos, unsigned int nbits,
+		       unsigned int got, unsigned int expect)
+{
+	printf("Kernel %s %s mismatch pos %u nbits %u: got %u expected %u\n",
+	       kernel->name, op, pos, nbits, got, expect);
+	bulk_errors++;
+}
+
+static void check_logical(const struct xdp2_bitmap_kernel *kernel,
+			  const char *op, const unsigned long *dest,
+			  const unsigned long *orig, const unsigned long *src1,
+			  const unsigned long *src2, unsigned int nbits)
+{
+	unsigned int i;
+	bool a, b, r;
+
+	for (i = 0; i < BULK_MAX_NBITS; i++) {
+		if (i >= nbits) {
+			/* Bits past nbits must not change */
+			r = ref_isset(orig, i);
+		} else {
+			a = ref_isset(src1, i);
+			b = ref_isset(src2, i);
+			if (!strcmp(op, "and"))
+				r = a && b;
+			else if (!strcmp(op, "or"))
+				r = a || b;
+			else
+				r = a && !b;
+		}
+
+		if (ref_isset(dest, i) != r) {
+			bulk_error(kernel, op, i, nbits, !r, r);
+			return;
+		}
+	}
+}
+
+static void test_kernel(const struct xdp2_bitmap_kernel *kernel,
+			unsigned long count)
+{
+	unsigned long src1[BULK_MAX_WORDS], src2[BULK_MAX_WORDS];
+	unsigned long dest[BULK_MAX_WORDS], orig[BULK_MAX_WORDS];
+	unsigned int nbits, pos, got, expect, w;
+	unsigned long i;
+
+	for (i = 0; i < count; i++) {
+		fill_map(src1, BULK_MAX_WORDS);
+		fill_map(src2, BULK_MAX_WORDS);
+		fill_map(orig, BULK_MAX_WORDS);
+
+		nbits = 1 + random() % BULK_MAX_NBITS;
+		pos = random() % (nbits + 1);
+
+		got = kernel->find(src1, pos, nbits);
+		expect = ref_find(src1, pos, nbits, true);
+		if (got != expect)
+			bulk_error(kernel, "find", pos, nbits, got, expect);
+
+		got = kernel->find_zero(src1, pos, nbits);
+		expect = ref_find(src1, pos, nbits, false);
+		if (got != expect)
+			bulk_error(kernel, "find_zero", pos, nbits, got,
+				   expect);
+
+		for (w = 0, pos = 0; pos < nbits; pos++)
+			w += ref_isset(src1, pos);
+		got = kernel->weight(src1, nbits);
+		if (got != w)
+			bulk_error(kernel, "weight", 0, nbits, got, w);
+
+		memcpy(dest, orig, sizeof(dest));
+		kernel->op_and(dest, src1, src2, nbits);
+		check_logical(kernel, "and", dest, orig, src1, src2, nbits);
+
+		memcpy(dest, orig, sizeof(dest));
+		kernel->op_or(dest, src1, src2, nbits);
+		check_logical(kernel, "or", dest, orig, src1, src2, nbits);
+
+		memcpy(dest, orig, sizeof(dest));
+		kernel->op_and_not(dest, src1, src2, nbits);
+		check_logical(kernel, "and_not", dest, orig, src1, src2,
+			      nbits);
+
+		if (bulk_errors)
+			exit(-1);
+	}
+}
+
+void test_bulk_kernels(unsigned long count)
+{
+	const struct xdp2_bitmap_kernel *kernel;
+	unsigned int i;
+
+	for (i = 0; i < xdp2_bitmap_num_kernels; i++) {
+		kernel = &xdp2_bitmap_kernels[i];
+		if (kernel->supported())
+			test_kernel(kernel, count);
+	}
+}
+
+static void bench_kernel(const struct xdp2_bitmap_kernel *kernel,
+			 unsigned long *map1, unsigned long *map2,
+			 unsigned long *dest, unsigned int nbits,
+			 unsigned long bytes)
+{
+	unsigned long iters = bytes / (nbits / 8), i;
+	volatile unsigned int sink;
+	double start;
+
+	printf("%-8s", kernel->name);
+
+	/* map1 is empty except for the last bit, map2 is full except for
+	 * the last bit, so finds scan the whole map
+	 */
+	start = now();
+	for (i = 0; i < iters; i++)
+		sink = kernel->find(map1, 0, nbits);
+	printf(" %9.2f", bytes / (now() - start) / 1e9);
+
+	start = now();
+	for (i = 0; i < iters; i++)
+		sink = kernel->find_zero(map2, 0, nbits);
+	printf(" %9.2f", bytes / (now() - start) / 1e9);
+
+	start = now();
+	for (i = 0; i < iters; i++)
+		sink = kernel->weight(map2, nbits);
+	printf(" %9.2f", bytes / (now() - start) / 1e9);
+
+	start = now();
+	for (i = 0; i < iters; i++)
+		kernel->op_and(dest, map1, map2, nbits);
+	printf(" %9.2f", bytes / (now() - start) / 1e9);
+
+	start = now();
+	for (i = 0; i < iters; i++)
+		kernel->op_or(dest, map1, map2, nbits);
+	printf(" %9.2f", bytes / (now() - start) / 1e9);
+
+	start = now();
+	for (i = 0; i < iters; i++)
+		kernel->op_and_not(dest, map1, map2, nbits);
+	printf(" %9.2f\n", bytes / (now() - start) / 1e9);
+
+	(void)sink;
+}
+
+/* Benchmark each kernel on nbits bitmaps (a multiple of 64) over bytes of
+ * bitmap data per operation. Results are in GB/s of source bitmap
+ */
+void bench_bulk_kernels(unsigned int nbits, unsigned long bytes)
+{
+	const struct xdp2_bitmap_kernel *kernel;
+	unsigned long *map1, *map2, *dest;
+	unsigned int i, nwords;
+
+	nbits = xdp2_round_up(nbits, 64);
+	nwords = nbits / 64;
+
+	map1 = calloc(nwords, sizeof(*map1));
+	map2 = calloc(nwords, sizeof(*map2));
+	dest = calloc(nwords, sizeof(*dest));
+	if (!map1 || !map2 || !dest) {
+		fprintf(stderr, "Allocation failed\n");
+		exit(-1);
+	}
+
+	memset(map2, 0xff, nwords * sizeof(*map2));
+	map1[nwords - 1] = 1UL << 63;
+	map2[nwords - 1] = ~(1UL << 63);
+
+	printf("Selected kernel: %s, %u bit bitmaps\n",
+	       xdp2_bitmap_kernel->name, nbits);
+	printf("GB/s          find find_zero    weight       and        or"
+	       "   and_not\n");
+
+	for (i = 0; i < xdp2_bitmap_num_kernels; i++) {
+		kernel = &xdp2_bitmap_kernels[i];
+		if (kernel->supported())
+			bench_kernel(kernel, map1, map2, dest, nbits, bytes);
+	}
+
+	free(map1);
+	free(map2);
+	free(dest);
+}
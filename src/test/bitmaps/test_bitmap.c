@@ -36,6 +36,7 @@
 #include "xdp2/cli.h"
 #include "xdp2/utility.h"
 
+#include "bench_bitmap.h"
 #include "test_bitmap.h"
 
 /* Test for XDP2 bitmaps
@@ -43,6 +44,9 @@
  * Run: ./test_bitmap [ -c <test-count> ] [ -v <verbose> ]
  *                    [ -I <report-interval> ][ -C <cli_port_num> ]
  *                    [-R] [ -F <function> ] [ -l ]
+ *                    [ -b ] [ -N <bench-nbits> ]
+ *
+ * -b benchmarks the bulk bitmap kernels on bitmaps of bench-nbits bits
  */
 
 #define NUM_WORDS (((MAX_NBITS - 1) / 64) + 1)
@@ -1049,7 +1053,7 @@ static void do_test(struct bitmap_func *ifunc, unsigned long count,
 	}
 }
 
-#define ARGS "c:v:I:C:RF:l"
+#define ARGS "c:v:I:C:RF:lbN:"
 
 static void usage(char *prog)
 {
@@ -1057,6 +1061,7 @@ static void usage(char *prog)
 		prog);
 	fprintf(stderr, "\t[ -I <report-interval> ][ -C <cli_port_num> ]\n");
 	fprintf(stderr, "\t[-R] [ -F <function> ] [-l]\n");
+	fprintf(stderr, "\t[-b] [ -N <bench-nbits> ]\n");
 
 	exit(-1);
 }
@@ -1065,7 +1070,9 @@ int main(int argc, char *argv[])
 {
 	static struct xdp2_cli_thread_info cli_thread_info;
 	struct bitmap_func *func = NULL;
+	unsigned int bench_nbits = 65536;
 	unsigned int cli_port_num = 0;
+	bool do_bench = false;
 	unsigned long count = 1000;
 	bool random_seed = false;
 	unsigned int intv = -1U;
@@ -1096,6 +1103,12 @@ int main(int argc, char *argv[])
 		case 'l':
 			do_list = true;
 			break;
+		case 'b':
+			do_bench = true;
+			break;
+		case 'N':
+			bench_nbits = strtoul(optarg, NULL, 10);
+			break;
 		default:
 			usage(argv[0]);
 		}
@@ -1128,5 +1141,13 @@ int main(int argc, char *argv[])
 		xdp2_cli_start(&cli_thread_info);
 	}
 
+	if (do_bench) {
+		bench_bulk_kernels(bench_nbits, 1UL << 30);
+		exit(0);
+	}
+
 	do_test(func, count, intv);
+
+	if (!func)
+		test_bulk_kernels(count);
 }
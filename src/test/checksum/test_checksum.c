@@ -0,0 +1,369 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Test and benchmark for the checksum functions
+ *
+ * Each checksum kernel supported by the CPU is checked against a reference
+ * implementation for all lengths up to a maximum at all alignments, the
+ * incremental update functions are checked against full recomputation, and
+ * pvbuf checksums over scatter-gather lists with odd length fragments are
+ * checked against the checksum of the linear data. Then the kernels are
+ * benchmarked across packet sizes (-b to only run the benchmark)
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/checksum.h"
+#include "xdp2/pvbuf.h"
+#include "xdp2/utility.h"
+
+#define MAX_LEN 2048
+#define BUF_SIZE (16 * 1024)
+
+static unsigned char buf[BUF_SIZE + 64];
+static unsigned long errors;
+static bool verbose;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_random(unsigned char *data, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		data[i] = random();
+}
+
+/* The original one word at a time algorithm */
+static __u16 ref_checksum(const void *src, size_t len)
+{
+	__u64 sum = 0;
+	__u32 w;
+	size_t i;
+
+	for (i = 0; i < len / sizeof(__u32); i++, src += sizeof(__u32)) {
+		memcpy(&w, src, sizeof(w));
+		sum += w;
+	}
+
+	if (len & 2) {
+		sum += *(__u16 *)src;
+		src += sizeof(__u16);
+	}
+	if (len & 1)
+		sum += *(__u8 *)src;
+
+	return xdp2_checksum_fold64(sum);
+}
+
+static void test_kernel(const struct xdp2_checksum_kernel *kernel)
+{
+	unsigned int off, pattern;
+	size_t len;
+
+	for (pattern = 0; pattern < 2; pattern++) {
+		/* Random data, and all ones to stress the carries */
+		if (pattern)
+			memset(buf, 0xff, sizeof(buf));
+		else
+			fill_random(buf, sizeof(buf));
+
+		for (off = 0; off < 8; off++) {
+			for (len = 0; len <= MAX_LEN; len++) {
+				if (xdp2_checksum_fold64(kernel->partial(
+						&buf[off], len)) ==
+				    ref_checksum(&buf[off], len))
+					continue;
+
+				if (verbose)
+					fprintf(stderr, "%s: mismatch len "
+						"%lu off %u\n", kernel->name,
+						len, off);
+				errors++;
+			}
+		}
+	}
+}
+
+/* Check that a buffer with a checksum field at offset csum_off is valid */
+static bool checksum_valid(const void *data, size_t len)
+{
+	return xdp2_checksum_compute(data, len) == 0xffff;
+}
+
+static void set_checksum(unsigned char *data, size_t len, size_t csum_off)
+{
+	__u16 csum = 0;
+
+	memcpy(&data[csum_off], &csum, sizeof(csum));
+	csum = ~xdp2_checksum_compute(data, len);
+	memcpy(&data[csum_off], &csum, sizeof(csum));
+}
+
+static void test_update(unsigned int count)
+{
+	unsigned char data[64], new[16];
+	struct iphdr *iph = (struct iphdr *)data;
+	__u32 addr;
+	__u16 csum;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		/* IPv4 header TTL decrement and address rewrite */
+		fill_random(data, sizeof(struct iphdr));
+		iph->ttl |= 1;
+		set_checksum(data, sizeof(struct iphdr),
+			     offsetof(struct iphdr, check));
+
+		xdp2_checksum_ipv4_dec_ttl(iph);
+		if (!checksum_valid(data, sizeof(struct iphdr)))
+			errors++;
+
+		addr = random();
+		iph->check = xdp2_checksum_update32(iph->check, iph->saddr,
+						    addr);
+		iph->saddr = addr;
+		if (!checksum_valid(data, sizeof(struct iphdr)))
+			errors++;
+
+		/* Sixteen byte field, like an IPv6 address */
+		fill_random(data, sizeof(data));
+		set_checksum(data, sizeof(data), 2);
+		fill_random(new, sizeof(new));
+		memcpy(&csum, &data[2], sizeof(csum));
+		csum = xdp2_checksum_update(csum, &data[24], new, sizeof(new));
+		memcpy(&data[2], &csum, sizeof(csum));
+		memcpy(&data[24], new, sizeof(new));
+		if (!checksum_valid(data, sizeof(data)))
+			errors++;
+	}
+}
+
+/* Checksum a pvbuf made of fragments with random lengths, and windows of it
+ * with random offsets and lengths, and compare with the linear checksum
+ */
+static void test_pvbuf(unsigned int count)
+{
+	struct xdp2_pvbuf *pvbuf;
+	xdp2_paddr_t pvbuf_paddr, paddr;
+	size_t total, len, off, flen;
+	unsigned int i, j, nfrags;
+	void *data;
+
+	for (i = 0; i < count; i++) {
+		pvbuf_paddr = xdp2_pvbuf_alloc_empty(1, &pvbuf);
+		if (pvbuf_paddr == XDP2_PADDR_NULL) {
+			errors++;
+			return;
+		}
+
+		nfrags = 1 + random() % 8;
+		total = 0;
+		for (j = 0; j < nfrags; j++) {
+			flen = 1 + random() % 1500;
+			paddr = xdp2_pbuf_alloc(flen, &data);
+			fill_random(data, flen);
+			memcpy(&buf[total], data, flen);
+			if (!__xdp2_pvbuf_append_paddr(&xdp2_pvbuf_global_mgr,
+						       pvbuf_paddr, paddr, 0,
+						       flen, false)) {
+				xdp2_pbuf_free(paddr);
+				break;
+			}
+			total += flen;
+		}
+
+		if (xdp2_pvbuf_checksum(pvbuf_paddr, 0, 0) !=
+		    ref_checksum(buf, total))
+			errors++;
+
+		off = random() % total;
+		len = 1 + random() % (total - off);
+		if (xdp2_pvbuf_checksum(pvbuf_paddr, len, off) !=
+		    ref_checksum(&buf[off], len)) {
+			if (verbose)
+				fprintf(stderr, "pvbuf mismatch: frags %u "
+					"total %lu off %lu len %lu\n", nfrags,
+					total, off, len);
+			errors++;
+		}
+
+		xdp2_pvbuf_free(pvbuf_paddr);
+	}
+}
+
+static const size_t bench_sizes[] = {
+	20, 64, 128, 256, 512, 1024, 1500, 4096, 9000
+};
+
+static __u64 api_partial(const void *src, size_t len)
+{
+	return xdp2_checksum_partial(src, len);
+}
+
+/* The public function, that is the inline kernel for short buffers and the
+ * selected kernel otherwise
+ */
+static const struct xdp2_checksum_kernel api_kernel = {
+	.name = "api",
+	.partial = api_partial,
+};
+
+static void bench(const struct xdp2_checksum_kernel *kernel,
+		  unsigned long bytes)
+{
+	unsigned long iters, n;
+	volatile __u64 sink;
+	unsigned int i;
+	double secs;
+	size_t len;
+
+	printf("%-8s", kernel->name);
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		len = bench_sizes[i];
+		iters = bytes / len;
+
+		secs = now();
+		for (n = 0; n < iters; n++)
+			sink = kernel->partial(&buf[(n * 64) %
+						    (BUF_SIZE - len)], len);
+		secs = now() - secs;
+		(void)sink;
+
+		printf(" %8.2f", iters * len / secs / 1e9);
+	}
+	printf("\n");
+}
+
+#define ARGS "c:B:k:bv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-c <count>] [-B <bench_mbytes>] ", name);
+	fprintf(stderr, "[-k <kernel>] [-b] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct xdp2_pbuf_init_allocator pbuf_allocs = {
+		.obj[5].num_objs = 1024,
+	};
+	struct xdp2_pvbuf_init_allocator pvbuf_allocs = {
+		.obj[1].num_pvbufs = 64,
+	};
+	const struct xdp2_checksum_kernel *kernel;
+	unsigned long bench_bytes = 256UL << 20;
+	const char *only_kernel = NULL;
+	bool bench_only = false;
+	unsigned int count = 10000;
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'B':
+			bench_bytes = strtoul(optarg, NULL, 10) << 20;
+			break;
+		case 'k':
+			only_kernel = optarg;
+			break;
+		case 'b':
+			bench_only = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (only_kernel && !xdp2_checksum_set_kernel(only_kernel)) {
+		fprintf(stderr, "Kernel %s is unknown or not supported\n",
+			only_kernel);
+		exit(-1);
+	}
+
+	printf("Selected kernel: %s\n", xdp2_checksum_kernel_name);
+
+	if (!bench_only) {
+		for (i = 0; i < xdp2_checksum_num_kernels; i++) {
+			kernel = &xdp2_checksum_kernels[i];
+			if (kernel->supported())
+				test_kernel(kernel);
+		}
+
+		test_update(count);
+
+		if (xdp2_pvbuf_init(&pbuf_allocs, &pvbuf_allocs, false, false,
+				    NULL, NULL)) {
+			fprintf(stderr, "pvbuf init failed\n");
+			exit(-1);
+		}
+		test_pvbuf(count);
+
+		printf("Tests done: %lu errors\n", errors);
+	}
+
+	if (!bench_bytes)
+		return errors ? -1 : 0;
+
+	fill_random(buf, sizeof(buf));
+
+	printf("GB/s    ");
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++)
+		printf(" %8lu", bench_sizes[i]);
+	printf("\n");
+
+	for (i = 0; i < xdp2_checksum_num_kernels; i++) {
+		kernel = &xdp2_checksum_kernels[i];
+		if (!kernel->supported() ||
+		    (only_kernel && strcmp(only_kernel, kernel->name)))
+			continue;
+		bench(kernel, bench_bytes);
+	}
+	bench(&api_kernel, bench_bytes);
+
+	return errors ? -1 : 0;
+}
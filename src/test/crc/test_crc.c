@@ -0,0 +1,340 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Test and benchmark for the CRC functions
+ *
+ * The CRC-32C, CRC-64 and CRC-16 functions selected for the CPU are checked
+ * against the table-driven software versions for all lengths up to a maximum
+ * at all alignments, for long random lengths, and when chained across
+ * random split points. CRCs of pvbufs with random fragments are checked
+ * against the CRC of the linear data. Then the selected functions are
+ * benchmarked against the software versions (-b to only run the benchmark)
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crc/crc.h"
+#include "xdp2/pvbuf.h"
+#include "xdp2/utility.h"
+
+#define MAX_LEN 2048
+#define BUF_SIZE (64 * 1024)
+
+static unsigned char buf[BUF_SIZE + 64];
+static unsigned long errors;
+static bool verbose;
+
+struct crc_impl {
+	const char *name;
+	unsigned char bitw;
+	__u64 (*func)(__u64 crc, const void *data, size_t len);
+	__u64 check;	/* CRC of "123456789" */
+};
+
+static __u64 crc32c_api(__u64 crc, const void *data, size_t len)
+{
+	return crc32c(crc, data, len);
+}
+
+static __u64 crc32c_ref(__u64 crc, const void *data, size_t len)
+{
+	return crc32c_sw(crc, data, len);
+}
+
+static __u64 crc64_ref(__u64 crc, const void *data, size_t len)
+{
+	return crc64_sw(crc, data, len);
+}
+
+static __u64 crc16_api(__u64 crc, const void *data, size_t len)
+{
+	return crc16_update(crc, data, len);
+}
+
+static __u64 crc16_ref(__u64 crc, const void *data, size_t len)
+{
+	return crc16_sw(crc, data, len);
+}
+
+/* Pairs of selected and software implementations */
+static struct crc_impl impls[][2] = {
+	{
+		{ "crc32c", CRC32, crc32c_api, 0xe3069283 },
+		{ "crc32c-sw", CRC32, crc32c_ref, 0xe3069283 },
+	},
+	{
+		{ "crc64", CRC64, crc64, 0xe9c6d914c4b8d9caULL },
+		{ "crc64-sw", CRC64, crc64_ref, 0xe9c6d914c4b8d9caULL },
+	},
+	{
+		{ "crc16", CRC16, crc16_api, 0x31c3 },
+		{ "crc16-sw", CRC16, crc16_ref, 0x31c3 },
+	},
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_random(unsigned char *data, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		data[i] = random();
+}
+
+static void mismatch(const struct crc_impl *impl, const char *what,
+		     size_t len, size_t off)
+{
+	if (verbose)
+		fprintf(stderr, "%s: %s mismatch len %lu off %lu\n",
+			impl->name, what, len, off);
+	errors++;
+}
+
+static void test_impl(const struct crc_impl *impl,
+		      const struct crc_impl *ref, unsigned int count)
+{
+	unsigned int off, pattern, i;
+	size_t len, split;
+	__u64 crc;
+
+	if (impl->func(0, "123456789", 9) != impl->check ||
+	    ref->func(0, "123456789", 9) != ref->check)
+		mismatch(impl, "check value", 9, 0);
+
+	for (pattern = 0; pattern < 2; pattern++) {
+		if (pattern)
+			memset(buf, 0xff, sizeof(buf));
+		else
+			fill_random(buf, sizeof(buf));
+
+		for (off = 0; off < 8; off++)
+			for (len = 0; len <= MAX_LEN; len++)
+				if (impl->func(0, &buf[off], len) !=
+				    ref->func(0, &buf[off], len))
+					mismatch(impl, "short", len, off);
+	}
+
+	for (i = 0; i < count; i++) {
+		/* Long buffers reach the interleaved and folding loops */
+		len = random() % (BUF_SIZE - 8);
+		off = random() % 8;
+		crc = random();
+		if (impl->bitw == CRC16)
+			crc &= 0xffff;
+		else if (impl->bitw == CRC32)
+			crc &= 0xffffffff;
+
+		if (impl->func(crc, &buf[off], len) !=
+		    ref->func(crc, &buf[off], len))
+			mismatch(impl, "long", len, off);
+
+		/* Chaining at a random split point */
+		split = len ? random() % len : 0;
+		if (impl->func(impl->func(crc, &buf[off], split),
+			       &buf[off + split], len - split) !=
+		    ref->func(crc, &buf[off], len))
+			mismatch(impl, "chained", len, split);
+	}
+}
+
+/* CRC of a pvbuf made of fragments with random lengths, and windows of it
+ * with random offsets and lengths, compared with the linear CRC
+ */
+static void test_pvbuf(unsigned int count)
+{
+	const struct crc_impl *ref;
+	struct xdp2_pvbuf *pvbuf;
+	xdp2_paddr_t pvbuf_paddr, paddr;
+	size_t total, len, off, flen;
+	unsigned int i, j, k, nfrags;
+	void *data;
+
+	for (i = 0; i < count; i++) {
+		pvbuf_paddr = xdp2_pvbuf_alloc_empty(1, &pvbuf);
+		if (pvbuf_paddr == XDP2_PADDR_NULL) {
+			errors++;
+			return;
+		}
+
+		nfrags = 1 + random() % 8;
+		total = 0;
+		for (j = 0; j < nfrags; j++) {
+			flen = 1 + random() % 1500;
+			paddr = xdp2_pbuf_alloc(flen, &data);
+			fill_random(data, flen);
+			memcpy(&buf[total], data, flen);
+			if (!__xdp2_pvbuf_append_paddr(&xdp2_pvbuf_global_mgr,
+						       pvbuf_paddr, paddr, 0,
+						       flen, false)) {
+				xdp2_pbuf_free(paddr);
+				break;
+			}
+			total += flen;
+		}
+
+		off = random() % total;
+		len = 1 + random() % (total - off);
+
+		for (k = 0; k < ARRAY_SIZE(impls); k++) {
+			ref = &impls[k][1];
+
+			if (crc_pvbuf(ref->bitw, 0, pvbuf_paddr, 0, 0) !=
+			    ref->func(0, buf, total))
+				mismatch(ref, "pvbuf", total, 0);
+
+			if (crc_pvbuf(ref->bitw, 0, pvbuf_paddr, len, off) !=
+			    ref->func(0, &buf[off], len))
+				mismatch(ref, "pvbuf window", len, off);
+		}
+
+		xdp2_pvbuf_free(pvbuf_paddr);
+	}
+}
+
+static const size_t bench_sizes[] = {
+	64, 256, 1500, 4096, 9000, 65536
+};
+
+static void bench(const struct crc_impl *impl, unsigned long bytes)
+{
+	unsigned long iters, n;
+	volatile __u64 sink;
+	unsigned int i;
+	double secs;
+	size_t len;
+
+	printf("%-10s", impl->name);
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		len = bench_sizes[i];
+		iters = bytes / len;
+
+		secs = now();
+		for (n = 0; n < iters; n++)
+			sink = impl->func(0, &buf[(n * 64) %
+						  (BUF_SIZE - len + 1)], len);
+		secs = now() - secs;
+		(void)sink;
+
+		printf(" %8.2f", iters * len / secs / 1e9);
+	}
+	printf("\n");
+}
+
+#define ARGS "c:B:bv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-c <count>] [-B <bench_mbytes>] ", name);
+	fprintf(stderr, "[-b] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct xdp2_pbuf_init_allocator pbuf_allocs = {
+		.obj[5].num_objs = 1024,
+	};
+	struct xdp2_pvbuf_init_allocator pvbuf_allocs = {
+		.obj[1].num_pvbufs = 64,
+	};
+	unsigned long bench_bytes = 256UL << 20;
+	bool bench_only = false;
+	unsigned int count = 1000;
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'B':
+			bench_bytes = strtoul(optarg, NULL, 10) << 20;
+			break;
+		case 'b':
+			bench_only = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	crc16_init();
+	crc32c_init();
+	crc64_init();
+
+	printf("Selected: crc32c %s, crc64 %s, crc16 %s\n", crc32c_impl,
+	       crc64_impl, crc16_impl);
+
+	if (!bench_only) {
+		for (i = 0; i < ARRAY_SIZE(impls); i++)
+			test_impl(&impls[i][0], &impls[i][1], count);
+
+		if (xdp2_pvbuf_init(&pbuf_allocs, &pvbuf_allocs, false, false,
+				    NULL, NULL)) {
+			fprintf(stderr, "pvbuf init failed\n");
+			exit(-1);
+		}
+		test_pvbuf(count);
+
+		printf("Tests done: %lu errors\n", errors);
+	}
+
+	if (!bench_bytes)
+		return errors ? -1 : 0;
+
+	fill_random(buf, sizeof(buf));
+
+	printf("GB/s      ");
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++)
+		printf(" %8lu", bench_sizes[i]);
+	printf("\n");
+
+	for (i = 0; i < ARRAY_SIZE(impls); i++) {
+		bench(&impls[i][0], bench_bytes);
+		bench(&impls[i][1], bench_bytes);
+	}
+
+	return errors ? -1 : 0;
+}
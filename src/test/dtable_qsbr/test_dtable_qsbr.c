@@ -0,0 +1,311 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/* Stress test for dtable lookups concurrent with updates
+ *
+ * Reader threads look up random keys in a plain, a ternary, a ternary
+ * table using tuple space search, and an LPM table while the main thread
+ * adds, deletes, and changes entries. Each target holds its key so a
+ * reader can check that a lookup returns either the target for the key
+ * or the default target. Readers report a quiescent state after each
+ * batch of lookups and freed entries are reclaimed through the dtable
+ * QSBR domain. At the end the tables are checked against a shadow copy of
+ * the entries
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xdp2/dtable.h"
+#include "xdp2/qsbr.h"
+#include "xdp2/utility.h"
+
+#define TARG_MAGIC	0x5eedf00d
+#define DEFAULT_KEY	0xffffffff
+
+#define BATCH		64
+
+struct test_targ {
+	__u32 magic;
+	__u32 key;
+	__u32 gen;
+};
+
+/* Shadow entry for a key, valid is set when the key is in the tables */
+struct shadow {
+	bool valid;
+	__u32 gen;
+};
+
+static struct xdp2_dtable_plain_table *plain_table;
+static struct xdp2_dtable_tern_table *tern_table;
+static struct xdp2_dtable_tern_table *tss_table;
+static struct xdp2_dtable_lpm_table *lpm_table;
+
+static unsigned int num_keys = 1024;
+static unsigned long errors;
+static bool verbose;
+static bool stop;
+
+/* Keys for the tables. The ternary and LPM entries for key K match all
+ * of 10.K.K.x
+ */
+static void make_tern_key(__u32 k, __u8 low, __u8 *key)
+{
+	key[0] = 10;
+	key[1] = k >> 8;
+	key[2] = k;
+	key[3] = low;
+}
+
+static const __u8 tern_mask[4] = { 0xff, 0xff, 0xff, 0 };
+
+static bool check_targ(const char *name, const struct test_targ *targ,
+		       __u32 k)
+{
+	if (targ && targ->magic == TARG_MAGIC &&
+	    (targ->key == k || targ->key == DEFAULT_KEY))
+		return true;
+
+	if (verbose)
+		fprintf(stderr, "%s lookup for key %u returned bad target\n",
+			name, k);
+
+	return false;
+}
+
+static void *reader(void *arg)
+{
+	unsigned int seed = (unsigned long)arg;
+	struct xdp2_qsbr_thread *thread;
+	const struct test_targ *targ;
+	unsigned long errs = 0;
+	__u8 key[4];
+	unsigned int i;
+	__u32 k;
+
+	thread = xdp2_qsbr_register(&xdp2_dtable_qsbr);
+	if (!thread) {
+		fprintf(stderr, "QSBR register failed\n");
+		exit(-1);
+	}
+
+	while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+		for (i = 0; i < BATCH; i++) {
+			k = rand_r(&seed) % num_keys;
+			make_tern_key(k, rand_r(&seed), key);
+
+			targ = xdp2_dtable_lookup_plain(plain_table, &k);
+			errs += !check_targ("Plain", targ, k);
+
+			targ = xdp2_dtable_lookup_tern(tern_table, key);
+			errs += !check_targ("Ternary", targ, k);
+
+			targ = xdp2_dtable_lookup_tern(tss_table, key);
+			errs += !check_targ("TSS", targ, k);
+
+			targ = xdp2_dtable_lookup_lpm(lpm_table, key);
+			errs += !check_targ("LPM", targ, k);
+		}
+		xdp2_qsbr_quiescent(thread);
+	}
+
+	xdp2_qsbr_unregister(thread);
+
+	__atomic_add_fetch(&errors, errs, __ATOMIC_RELAXED);
+
+	return NULL;
+}
+
+static void update(struct shadow *shadow, __u32 k, unsigned int op)
+{
+	struct test_targ targ = { .magic = TARG_MAGIC, .key = k };
+	bool err = false;
+	__u8 key[4];
+
+	make_tern_key(k, 0, key);
+
+	if (!shadow[k].valid) {
+		targ.gen = ++shadow[k].gen;
+		err |= xdp2_dtable_add_plain(plain_table, 0, &k, &targ) < 0;
+		err |= xdp2_dtable_add_tern(tern_table, 0, key, tern_mask,
+					    k, &targ) < 0;
+		err |= xdp2_dtable_add_tern(tss_table, 0, key, tern_mask,
+					    k, &targ) < 0;
+		err |= xdp2_dtable_add_lpm(lpm_table, 0, key, 24, &targ) < 0;
+		shadow[k].valid = true;
+	} else if (op & 1) {
+		xdp2_dtable_del_plain(plain_table, &k);
+		xdp2_dtable_del_tern(tern_table, key, tern_mask, k);
+		xdp2_dtable_del_tern(tss_table, key, tern_mask, k);
+		xdp2_dtable_del_lpm(lpm_table, key, 24);
+		shadow[k].valid = false;
+	} else {
+		targ.gen = ++shadow[k].gen;
+		err |= xdp2_dtable_change_plain(plain_table, &k, &targ) < 0;
+		err |= xdp2_dtable_change_tern(tern_table, key, tern_mask,
+					       k, &targ) < 0;
+		err |= xdp2_dtable_change_tern(tss_table, key, tern_mask,
+					       k, &targ) < 0;
+		err |= xdp2_dtable_change_lpm(lpm_table, key, 24, &targ) < 0;
+	}
+
+	if (err) {
+		if (verbose)
+			fprintf(stderr, "Update for key %u failed\n", k);
+		errors++;
+	}
+}
+
+static void check_final(const char *name, const struct test_targ *targ,
+			struct shadow *shadow, __u32 k)
+{
+	if (shadow[k].valid ? (targ->key == k && targ->gen == shadow[k].gen) :
+			      targ->key == DEFAULT_KEY)
+		return;
+
+	if (verbose)
+		fprintf(stderr, "%s final check for key %u failed\n", name, k);
+	errors++;
+}
+
+static void create_tables(void)
+{
+	struct test_targ def = { .magic = TARG_MAGIC, .key = DEFAULT_KEY };
+	int plain_ident = 0, tern_ident = 0, tss_ident = 0, lpm_ident = 0;
+
+	plain_table = xdp2_dtable_create_plain("qsbr_plain", sizeof(__u32),
+					       &def, sizeof(def),
+					       &plain_ident);
+	tern_table = xdp2_dtable_create_tern("qsbr_tern", 4, &def,
+					     sizeof(def), &tern_ident);
+	tss_table = xdp2_dtable_create_tern("qsbr_tss", 4, &def,
+					    sizeof(def), &tss_ident);
+	lpm_table = xdp2_dtable_create_lpm("qsbr_lpm", 4, &def,
+					   sizeof(def), &lpm_ident);
+	if (!plain_table || !tern_table || !tss_table || !lpm_table ||
+	    xdp2_dtable_set_tern_algo(tss_table, XDP2_DTABLE_TERN_TSS)) {
+		fprintf(stderr, "Create tables failed\n");
+		exit(-1);
+	}
+}
+
+#define ARGS "n:c:k:v"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-n <num_readers>] [-c <count>] ", name);
+	fprintf(stderr, "[-k <num_keys>] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int num_readers = 4, count = 200000, seed = 1;
+	struct shadow *shadow;
+	pthread_t *threads;
+	__u8 key[4];
+	unsigned int i;
+	__u32 k;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'n':
+			num_readers = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'k':
+			num_keys = strtoul(optarg, NULL, 10);
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!num_keys || num_keys > 65536)
+		usage(argv[0]);
+
+	create_tables();
+
+	shadow = calloc(num_keys, sizeof(*shadow));
+	threads = calloc(num_readers, sizeof(*threads));
+	if (!shadow || !threads) {
+		fprintf(stderr, "Allocation failed\n");
+		exit(-1);
+	}
+
+	for (i = 0; i < num_readers; i++) {
+		if (pthread_create(&threads[i], NULL, reader,
+				   (void *)(unsigned long)(i + 1))) {
+			fprintf(stderr, "Create thread failed\n");
+			exit(-1);
+		}
+	}
+
+	for (i = 0; i < count; i++)
+		update(shadow, rand_r(&seed) % num_keys, rand_r(&seed));
+
+	__atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+
+	for (i = 0; i < num_readers; i++)
+		pthread_join(threads[i], NULL);
+
+	/* All readers are gone so this runs all the pending frees */
+	xdp2_qsbr_barrier(&xdp2_dtable_qsbr);
+
+	for (k = 0; k < num_keys; k++) {
+		make_tern_key(k, k, key);
+
+		check_final("Plain", xdp2_dtable_lookup_plain(plain_table, &k),
+			    shadow, k);
+		check_final("Ternary", xdp2_dtable_lookup_tern(tern_table,
+							       key),
+			    shadow, k);
+		check_final("TSS", xdp2_dtable_lookup_tern(tss_table, key),
+			    shadow, k);
+		check_final("LPM", xdp2_dtable_lookup_lpm(lpm_table, key),
+			    shadow, k);
+	}
+
+	free(threads);
+	free(shadow);
+
+	printf("Tests done: %lu errors\n", errors);
+
+	return errors ? -1 : 0;
+}
@@ -36,6 +36,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "xdp2/fifo.h"
@@ -79,6 +80,10 @@ static unsigned int ent_size = 1;
  */
 bool no_init;
 
+/* FIFO mode (locked, or lock-free SPSC or MPMC) */
+static enum xdp2_fifo_mode fifo_mode = XDP2_FIFO_MODE_LOCKED;
+static bool fifo_mode_set;
+
 #define MAX_ENT_SIZE 255
 
 /* Producer instance */
@@ -316,8 +321,8 @@ static void run_server(struct xdp2_fifo_stats *stats,
 
 	if (!no_init) {
 		for (i = 0; i < num_threads; i++)
-			__xdp2_fifo_init(fifos[i], 16, ent_size, 8,
-					 &stats[i], 1);
+			__xdp2_fifo_init_mode(fifos[i], 16, ent_size, 8,
+					      &stats[i], 1, fifo_mode);
 	}
 
 	cons_arg = calloc(1, sizeof(*cons_arg));
@@ -461,14 +466,271 @@ static void run_test(unsigned int count, char *gshmfile,
 		pause();
 }
 
-#define ARGS "c:G:o:I:n:NSCvQDK:sk"
+
+/* Benchmark
+ *
+ * Throughput: bench_producers threads each enqueue count messages in bursts
+ * on one FIFO and bench_consumers threads dequeue them in bursts. Each
+ * message encodes the producer number and a sequence number. With a single
+ * consumer the sequence numbers of each producer must arrive in order, and
+ * in any case the total and sum of messages are checked
+ *
+ * Latency: two threads ping-pong a message over a pair of FIFOs and the
+ * average one way latency is reported
+ *
+ * The benchmark spins with sched_yield when a FIFO is full or empty so that
+ * it can run with more threads than CPUs
+ */
+
+#define BENCH_MAX_BURST 256
+
+static unsigned int bench_producers = 1;
+static unsigned int bench_consumers = 1;
+static unsigned int bench_burst = 32;
+static unsigned int bench_num_ents = 1024;
+
+struct bench_thread {
+	struct xdp2_fifo *fifo;
+	pthread_t thread;
+	unsigned int num;
+	unsigned int count;
+	unsigned long received;
+	unsigned long sum;
+	unsigned long errors;
+};
+
+static atomic_ulong bench_remaining;
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *bench_producer_func(void *arg)
+{
+	struct bench_thread *bt = arg;
+	__u64 messages[BENCH_MAX_BURST];
+	unsigned int i, n, seq = 0;
+
+	while (seq < bt->count) {
+		n = xdp2_min(bench_burst, bt->count - seq);
+		for (i = 0; i < n; i++)
+			messages[i] = ((__u64)bt->num << 40) | (seq + i);
+
+		n = xdp2_fifo_enqueue_burst(bt->fifo, messages, n, false);
+		if (!n) {
+			sched_yield();
+			continue;
+		}
+		seq += n;
+	}
+
+	return NULL;
+}
+
+static void *bench_consumer_func(void *arg)
+{
+	__u64 messages[BENCH_MAX_BURST], next[MAX_THREADS] = { 0 };
+	struct bench_thread *bt = arg;
+	unsigned int i, n, prod;
+
+	while (atomic_load(&bench_remaining)) {
+		n = xdp2_fifo_dequeue_burst(bt->fifo, messages, bench_burst,
+					    false);
+		if (!n) {
+			sched_yield();
+			continue;
+		}
+
+		atomic_fetch_sub(&bench_remaining, n);
+
+		for (i = 0; i < n; i++) {
+			prod = messages[i] >> 40;
+			bt->sum += messages[i] & ((1ULL << 40) - 1);
+
+			if (bench_consumers == 1) {
+				if ((messages[i] & ((1ULL << 40) - 1)) !=
+				    next[prod])
+					bt->errors++;
+				next[prod] = (messages[i] &
+					      ((1ULL << 40) - 1)) + 1;
+			}
+		}
+		bt->received += n;
+	}
+
+	return NULL;
+}
+
+static bool bench_throughput(enum xdp2_fifo_mode mode, unsigned int count)
+{
+	struct bench_thread prods[MAX_THREADS], conss[MAX_THREADS];
+	unsigned long received = 0, sum = 0, errors = 0;
+	struct xdp2_fifo_stats stats;
+	struct xdp2_fifo *fifo;
+	double secs;
+	int i;
+
+	fifo = __xdp2_fifo_create_mode(bench_num_ents, 1,
+				       bench_num_ents / 2, &stats,
+				       XDP2_ADDR_XLAT_NO_XLAT, mode);
+	XDP2_ASSERT(fifo, "Create FIFO failed");
+
+	atomic_store(&bench_remaining, (unsigned long)count * bench_producers);
+
+	memset(prods, 0, sizeof(prods));
+	memset(conss, 0, sizeof(conss));
+
+	secs = bench_now();
+
+	for (i = 0; i < bench_consumers; i++) {
+		conss[i].fifo = fifo;
+		pthread_create(&conss[i].thread, NULL, bench_consumer_func,
+			       &conss[i]);
+	}
+	for (i = 0; i < bench_producers; i++) {
+		prods[i].fifo = fifo;
+		prods[i].num = i;
+		prods[i].count = count;
+		pthread_create(&prods[i].thread, NULL, bench_producer_func,
+			       &prods[i]);
+	}
+
+	for (i = 0; i < bench_producers; i++)
+		pthread_join(prods[i].thread, NULL);
+	for (i = 0; i < bench_consumers; i++) {
+		pthread_join(conss[i].thread, NULL);
+		received += conss[i].received;
+		sum += conss[i].sum;
+		errors += conss[i].errors;
+	}
+
+	secs = bench_now() - secs;
+
+	if (received != (unsigned long)count * bench_producers ||
+	    sum != (unsigned long)count * (count - 1) / 2 * bench_producers)
+		errors++;
+
+	printf("%-8s producers %u consumers %u burst %3u: %8.2f Mmsgs/s, "
+	       "waits %lu, errors %lu\n", xdp2_fifo_mode_to_text(mode),
+	       bench_producers, bench_consumers, bench_burst,
+	       received / secs / 1e6, stats.producer.blocked +
+	       stats.consumer.blocked, errors);
+
+	if (verbose)
+		dump_one_fifo(fifo, "bench-fifo", -1, -1);
+
+	free(fifo);
+
+	return !errors;
+}
+
+struct bench_pingpong {
+	struct xdp2_fifo *in;
+	struct xdp2_fifo *out;
+	unsigned int count;
+	pthread_t thread;
+};
+
+static void *bench_pong_func(void *arg)
+{
+	struct bench_pingpong *bp = arg;
+	unsigned int i;
+	__u64 v;
+
+	for (i = 0; i < bp->count; i++) {
+		while (!xdp2_fifo_dequeue(bp->in, &v, false))
+			sched_yield();
+		while (!xdp2_fifo_enqueue(bp->out, v, false))
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+static bool bench_latency(enum xdp2_fifo_mode mode, unsigned int count)
+{
+	struct bench_pingpong bp;
+	struct xdp2_fifo *f1, *f2;
+	unsigned long errors = 0;
+	unsigned int i;
+	double secs;
+	__u64 v;
+
+	f1 = __xdp2_fifo_create_mode(bench_num_ents, 1, 1, NULL,
+				     XDP2_ADDR_XLAT_NO_XLAT, mode);
+	f2 = __xdp2_fifo_create_mode(bench_num_ents, 1, 1, NULL,
+				     XDP2_ADDR_XLAT_NO_XLAT, mode);
+	XDP2_ASSERT(f1 && f2, "Create FIFO failed");
+
+	bp.in = f1;
+	bp.out = f2;
+	bp.count = count;
+
+	secs = bench_now();
+
+	pthread_create(&bp.thread, NULL, bench_pong_func, &bp);
+
+	for (i = 0; i < count; i++) {
+		while (!xdp2_fifo_enqueue(f1, i, false))
+			sched_yield();
+		while (!xdp2_fifo_dequeue(f2, &v, false))
+			sched_yield();
+		if (v != i)
+			errors++;
+	}
+
+	pthread_join(bp.thread, NULL);
+
+	secs = bench_now() - secs;
+
+	printf("%-8s ping-pong: %8.1f ns one way, errors %lu\n",
+	       xdp2_fifo_mode_to_text(mode), secs / count / 2 * 1e9, errors);
+
+	free(f1);
+	free(f2);
+
+	return !errors;
+}
+
+static void run_bench(unsigned int count)
+{
+	enum xdp2_fifo_mode mode;
+	bool ok = true;
+
+	for (mode = XDP2_FIFO_MODE_LOCKED; mode <= XDP2_FIFO_MODE_MPMC;
+	     mode++) {
+		if (fifo_mode_set && mode != fifo_mode)
+			continue;
+
+		/* SPSC only works for one producer and one consumer */
+		if (mode == XDP2_FIFO_MODE_SPSC &&
+		    (bench_producers > 1 || bench_consumers > 1))
+			continue;
+
+		ok &= bench_throughput(mode, count);
+		ok &= bench_latency(mode, count > 16 ? count / 16 : 1);
+	}
+
+	exit(ok ? 0 : 1);
+}
+
+#define ARGS "c:G:o:I:n:NSCvQDK:skM:bP:R:B:E:"
 
 static void usage(char *name)
 {
 	fprintf(stderr, "Usage: %s [-v] [-c <count>] [-I <interval>] ", name);
 	fprintf(stderr, "[-G <gshmfile>] [-o <gshfile_offset>] ");
 	fprintf(stderr, "[-n <num_threads>] ");
-	fprintf(stderr, "[-N] [-R] [-S] [-C] [-Q] [-D] [-s] [-v] [-k]\n");
+	fprintf(stderr, "[-N] [-R] [-S] [-C] [-Q] [-D] [-s] [-v] [-k] ");
+	fprintf(stderr, "[-M locked|spsc|mpmc]\n");
+	fprintf(stderr, "       %s -b [-c <count>] [-M <mode>] ", name);
+	fprintf(stderr, "[-P <producers>] [-R <consumers>] [-B <burst>] ");
+	fprintf(stderr, "[-E <num_ents>] [-v]\n");
 
 	exit(-1);
 }
@@ -478,6 +740,7 @@ int main(int argc, char *argv[])
 	off_t gshmfile_offset = 0;
 	unsigned int count = 1000;
 	char *gshmfile = NULL;
+	bool bench = false;
 	int c;
 
 	while ((c = getopt(argc, argv, ARGS)) != -1) {
@@ -531,6 +794,35 @@ int main(int argc, char *argv[])
 		case 'v':
 			verbose = true;
 			break;
+		case 'M':
+			if (!strcmp(optarg, "locked")) {
+				fifo_mode = XDP2_FIFO_MODE_LOCKED;
+			} else if (!strcmp(optarg, "spsc")) {
+				fifo_mode = XDP2_FIFO_MODE_SPSC;
+			} else if (!strcmp(optarg, "mpmc")) {
+				fifo_mode = XDP2_FIFO_MODE_MPMC;
+			} else {
+				fprintf(stderr, "Unknown FIFO mode %s\n",
+					optarg);
+				usage(argv[0]);
+			}
+			fifo_mode_set = true;
+			break;
+		case 'b':
+			bench = true;
+			break;
+		case 'P':
+			bench_producers = strtoul(optarg, NULL, 10);
+			break;
+		case 'R':
+			bench_consumers = strtoul(optarg, NULL, 10);
+			break;
+		case 'B':
+			bench_burst = strtoul(optarg, NULL, 10);
+			break;
+		case 'E':
+			bench_num_ents = strtoul(optarg, NULL, 10);
+			break;
 		default:
 			usage(argv[0]);
 		}
@@ -538,5 +830,15 @@ int main(int argc, char *argv[])
 
 	xdp2_locks_init_locks();
 
+	if (bench) {
+		if (!bench_producers || bench_producers > MAX_THREADS ||
+		    !bench_consumers || bench_consumers > MAX_THREADS ||
+		    !bench_burst || bench_burst > BENCH_MAX_BURST) {
+			fprintf(stderr, "Bad benchmark parameters\n");
+			exit(-1);
+		}
+		run_bench(count);
+	}
+
 	run_test(count, gshmfile, gshmfile_offset);
 }
@@ -0,0 +1,480 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Test and benchmark for the hash functions
+ *
+ * The Toeplitz hash is checked against the verification vectors of the
+ * Microsoft RSS specification and the Toeplitz lookup tables against the
+ * bit at a time hash, the hardware and software CRC32C hashes are
+ * checked to give the same results, and xdp2_hash is checked against the
+ * direct functions. Then the per packet cost of each algorithm is measured
+ * for hash inputs the size of the IPv4 and IPv6 metadata hash areas, and
+ * for lookups in a plain dtable keyed by a 5-tuple (-b to only run the
+ * benchmark)
+ */
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/dtable.h"
+#include "xdp2/hash.h"
+#include "xdp2/utility.h"
+
+#define NUM_KEYS 4096
+
+static unsigned long errors;
+static bool verbose;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_random(void *data, size_t len)
+{
+	__u8 *bytes = data;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		bytes[i] = random();
+}
+
+static const __u8 rss_key[XDP2_HASH_TOEPLITZ_KEY_LEN] =
+					XDP2_HASH_TOEPLITZ_DEFAULT_KEY;
+
+/* Verification vectors from the Microsoft RSS specification. The hash
+ * input is the source address, destination address, source port, and
+ * destination port
+ */
+static const struct {
+	int af;
+	const char *src, *dst;
+	__u16 sport, dport;
+	__u32 hash_addrs, hash_ports;
+} rss_vectors[] = {
+	{ AF_INET, "66.9.149.187", "161.142.100.80", 2794, 1766,
+	  0x323e8fc2, 0x51ccc178 },
+	{ AF_INET, "199.92.111.2", "65.69.140.83", 14230, 4739,
+	  0xd718262a, 0xc626b0ea },
+	{ AF_INET, "24.19.198.95", "12.22.207.184", 12898, 38024,
+	  0xd2d0a5de, 0x5c2b394a },
+	{ AF_INET, "38.27.205.30", "209.142.163.6", 48228, 2217,
+	  0x82989176, 0xafc7327f },
+	{ AF_INET, "153.39.163.191", "202.188.127.2", 44251, 1303,
+	  0x5d1809c5, 0x10e828a2 },
+	{ AF_INET6, "3ffe:2501:200:1fff::7", "3ffe:2501:200:3::1",
+	  2794, 1766, 0x2cc18cd5, 0x40207d3d },
+	{ AF_INET6, "3ffe:501:8::260:97ff:fe40:efab", "ff02::1",
+	  14230, 4739, 0x0f0c461c, 0xdde51bbf },
+	{ AF_INET6, "3ffe:1900:4545:3:200:f8ff:fe21:67cf",
+	  "fe80::200:f8ff:fe21:67cf", 44251, 38024,
+	  0x4b61e985, 0x02d1feef },
+};
+
+static struct xdp2_hash_toeplitz_tbl toeplitz_tbl;
+
+static void test_toeplitz(void)
+{
+	__u8 input[36];
+	unsigned int i;
+	__u16 port;
+	size_t alen;
+	__u32 hash;
+
+	xdp2_hash_toeplitz_tbl_init(&toeplitz_tbl, rss_key);
+
+	for (i = 0; i < ARRAY_SIZE(rss_vectors); i++) {
+		alen = rss_vectors[i].af == AF_INET ? 4 : 16;
+
+		inet_pton(rss_vectors[i].af, rss_vectors[i].src, input);
+		inet_pton(rss_vectors[i].af, rss_vectors[i].dst,
+			  input + alen);
+		port = htons(rss_vectors[i].sport);
+		memcpy(input + 2 * alen, &port, sizeof(port));
+		port = htons(rss_vectors[i].dport);
+		memcpy(input + 2 * alen + 2, &port, sizeof(port));
+
+		hash = xdp2_hash_toeplitz(input, 2 * alen, rss_key);
+		if (hash != rss_vectors[i].hash_addrs) {
+			printf("Toeplitz vector %u addresses: got %08x "
+			       "expected %08x\n", i, hash,
+			       rss_vectors[i].hash_addrs);
+			errors++;
+		}
+
+		hash = xdp2_hash_toeplitz(input, 2 * alen + 4, rss_key);
+		if (hash != rss_vectors[i].hash_ports) {
+			printf("Toeplitz vector %u ports: got %08x "
+			       "expected %08x\n", i, hash,
+			       rss_vectors[i].hash_ports);
+			errors++;
+		}
+
+		hash = xdp2_hash_toeplitz_tbl(&toeplitz_tbl, input,
+					      2 * alen + 4);
+		if (hash != rss_vectors[i].hash_ports) {
+			printf("Toeplitz table vector %u ports: got %08x "
+			       "expected %08x\n", i, hash,
+			       rss_vectors[i].hash_ports);
+			errors++;
+		}
+	}
+}
+
+/* Check the Toeplitz lookup tables against the bit at a time hash for
+ * random keys and inputs longer than the key
+ */
+static void test_toeplitz_tbl(unsigned int count)
+{
+	__u8 key[XDP2_HASH_TOEPLITZ_KEY_LEN];
+	__u8 data[128];
+	unsigned int i;
+	size_t len;
+
+	for (i = 0; i < count; i++) {
+		fill_random(key, sizeof(key));
+		fill_random(data, sizeof(data));
+		xdp2_hash_toeplitz_tbl_init(&toeplitz_tbl, key);
+
+		for (len = 0; len <= sizeof(data); len++) {
+			if (xdp2_hash_toeplitz_tbl(&toeplitz_tbl, data,
+						   len) !=
+			    xdp2_hash_toeplitz(data, len, key)) {
+				if (verbose)
+					printf("Toeplitz table mismatch len "
+					       "%zu\n", len);
+				errors++;
+			}
+		}
+	}
+
+}
+
+static void test_crc32c(unsigned int count)
+{
+#if defined(__x86_64__) || defined(__ARM_FEATURE_CRC32)
+	__u8 data[256 + 8];
+	unsigned int i;
+	__u64 seed;
+	size_t len;
+
+#if defined(__x86_64__)
+	if (!__builtin_cpu_supports("sse4.2")) {
+		printf("CRC32 instruction not supported, skipping\n");
+		return;
+	}
+#endif
+
+	for (i = 0; i < count; i++) {
+		fill_random(data, sizeof(data));
+		fill_random(&seed, sizeof(seed));
+
+		for (len = 0; len <= 256; len++) {
+			__u64 hw = __xdp2_hash_crc32c_hw(data + (i & 7), len,
+							 seed);
+			__u64 sw = __xdp2_hash_crc32c_sw(data + (i & 7), len,
+							 seed);
+
+			if (hw != sw) {
+				if (verbose)
+					printf("CRC32C mismatch len %zu: "
+					       "%016llx != %016llx\n", len,
+					       (unsigned long long)hw,
+					       (unsigned long long)sw);
+				errors++;
+			}
+		}
+	}
+#endif
+}
+
+/* Check xdp2_hash against the direct functions and check that inputs
+ * differing in one bit give different hashes
+ */
+static void test_algos(unsigned int count)
+{
+	struct xdp2_hash_key key;
+	__u8 data[64], data2[64];
+	unsigned int i, algo;
+	__u64 h, h2, exp;
+	size_t len;
+
+	fill_random(&key, sizeof(key));
+	key.toeplitz_tbl = NULL;
+
+	for (i = 0; i < count; i++) {
+		fill_random(data, sizeof(data));
+		len = 1 + random() % sizeof(data);
+
+		for (algo = 0; algo < __XDP2_HASH_MAX; algo++) {
+			switch (algo) {
+			case XDP2_HASH_SIPHASH:
+				exp = siphash(data, len, &key.siphash);
+				break;
+			case XDP2_HASH_CRC32C:
+				exp = xdp2_hash_crc32c(data, len, key.seed);
+				break;
+			case XDP2_HASH_XXH3:
+				exp = xdp2_hash_xxh3(data, len, key.seed);
+				break;
+			case XDP2_HASH_TOEPLITZ:
+				exp = xdp2_hash_toeplitz(data, len,
+							 key.toeplitz);
+				break;
+			}
+
+			h = xdp2_hash(algo, data, len, &key);
+			if (h != exp) {
+				printf("%s: xdp2_hash mismatch\n",
+				       xdp2_hash_algo_name(algo));
+				errors++;
+			}
+
+			memcpy(data2, data, len);
+			data2[random() % len] ^= 1 << (random() % 8);
+			h2 = xdp2_hash(algo, data2, len, &key);
+			if (h == h2) {
+				if (verbose)
+					printf("%s: one bit change gives "
+					       "the same hash\n",
+					       xdp2_hash_algo_name(algo));
+				errors++;
+			}
+		}
+	}
+
+	for (algo = 0; algo < __XDP2_HASH_MAX; algo++) {
+		if (xdp2_hash_algo_from_name(xdp2_hash_algo_name(algo)) !=
+								algo) {
+			printf("%s: name lookup failed\n",
+			       xdp2_hash_algo_name(algo));
+			errors++;
+		}
+	}
+}
+
+static const size_t bench_sizes[] = { 12, 13, 36, 37, 64 };
+
+static __u8 keys[NUM_KEYS][64];
+
+static void bench_hash(enum xdp2_hash_algo algo, const char *name,
+		       const struct xdp2_hash_toeplitz_tbl *tbl,
+		       unsigned long iters)
+{
+	struct xdp2_hash_key key;
+	volatile __u64 sink;
+	unsigned long n;
+	unsigned int i;
+	double secs;
+	size_t len;
+
+	fill_random(&key, sizeof(key));
+	key.toeplitz_tbl = tbl;
+
+	printf("%-10s", name);
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		len = bench_sizes[i];
+
+		secs = now();
+		for (n = 0; n < iters; n++)
+			sink = xdp2_hash(algo, keys[n % NUM_KEYS], len, &key);
+		secs = now() - secs;
+		(void)sink;
+
+		printf(" %8.2f", secs / iters * 1e9);
+	}
+	printf("\n");
+}
+
+static void bench_crc32c_sw(unsigned long iters)
+{
+	volatile __u64 sink;
+	unsigned long n;
+	unsigned int i;
+	double secs;
+
+	printf("%-10s", "crc32c-sw");
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		secs = now();
+		for (n = 0; n < iters; n++)
+			sink = __xdp2_hash_crc32c_sw(keys[n % NUM_KEYS],
+						     bench_sizes[i], n);
+		secs = now() - secs;
+		(void)sink;
+
+		printf(" %8.2f", secs / iters * 1e9);
+	}
+	printf("\n");
+}
+
+/* Look up 5-tuples in a plain dtable using the hash algorithm */
+static void bench_dtable(enum xdp2_hash_algo algo, unsigned long iters)
+{
+	struct xdp2_dtable_plain_table *table;
+	unsigned int i, targ = 0;
+	volatile bool miss = false;
+	unsigned long n;
+	char name[32];
+	int ident = 0;
+	double secs;
+
+	snprintf(name, sizeof(name), "hash_%s", xdp2_hash_algo_name(algo));
+
+	table = xdp2_dtable_create_plain(name, 13, &targ, sizeof(targ),
+					 &ident);
+	if (!table) {
+		fprintf(stderr, "Create table %s failed\n", name);
+		exit(-1);
+	}
+
+	if (xdp2_dtable_set_hash_algo(table, algo)) {
+		fprintf(stderr, "Set hash algorithm %s failed\n", name);
+		exit(-1);
+	}
+
+	for (i = 0; i < NUM_KEYS; i++) {
+		targ = i + 1;
+		if (xdp2_dtable_add_plain(table, 0, keys[i], &targ) < 0) {
+			fprintf(stderr, "Add to table %s failed\n", name);
+			exit(-1);
+		}
+	}
+
+	if (xdp2_dtable_set_hash_algo(table, algo) != -EBUSY) {
+		printf("%s: set algorithm on non-empty table\n", name);
+		errors++;
+	}
+
+	secs = now();
+	for (n = 0; n < iters; n++)
+		if (*(unsigned int *)xdp2_dtable_lookup_plain(table,
+				keys[n % NUM_KEYS]) != n % NUM_KEYS + 1)
+			miss = true;
+	secs = now() - secs;
+
+	if (miss) {
+		printf("%s: lookup returned the wrong target\n", name);
+		errors++;
+	}
+
+	printf("%-10s %8.2f\n", xdp2_hash_algo_name(algo),
+	       secs / iters * 1e9);
+}
+
+#define ARGS "c:i:a:bv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-c <count>] [-i <bench_iters>] ", name);
+	fprintf(stderr, "[-a <algo>] [-b] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long iters = 10000000;
+	unsigned int count = 1000;
+	bool bench_only = false;
+	int only_algo = -1;
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'i':
+			iters = strtoul(optarg, NULL, 10);
+			break;
+		case 'a':
+			only_algo = xdp2_hash_algo_from_name(optarg);
+			if (only_algo < 0) {
+				fprintf(stderr, "Unknown hash algorithm %s\n",
+					optarg);
+				exit(-1);
+			}
+			break;
+		case 'b':
+			bench_only = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!bench_only) {
+		test_toeplitz();
+		test_toeplitz_tbl(count / 10);
+		test_crc32c(count);
+		test_algos(count * 10);
+
+		printf("Tests done: %lu errors\n", errors);
+	}
+
+	if (!iters)
+		return errors ? -1 : 0;
+
+	fill_random(keys, sizeof(keys));
+	xdp2_hash_toeplitz_tbl_init(&toeplitz_tbl, rss_key);
+
+	printf("ns/hash   ");
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++)
+		printf(" %8zu", bench_sizes[i]);
+	printf("\n");
+
+	for (i = 0; i < __XDP2_HASH_MAX; i++)
+		if (only_algo < 0 || only_algo == i)
+			bench_hash(i, xdp2_hash_algo_name(i), NULL, iters);
+	if (only_algo < 0 || only_algo == XDP2_HASH_TOEPLITZ)
+		bench_hash(XDP2_HASH_TOEPLITZ, "toep-tbl", &toeplitz_tbl,
+			   iters);
+	if (only_algo < 0 || only_algo == XDP2_HASH_CRC32C)
+		bench_crc32c_sw(iters / 10);
+
+	printf("ns/lookup (plain dtable, 13 byte key, %u entries)\n",
+	       NUM_KEYS);
+	for (i = 0; i < __XDP2_HASH_MAX; i++)
+		if (only_algo < 0 || only_algo == i)
+			bench_dtable(i, iters);
+
+	return errors ? -1 : 0;
+}
@@ -0,0 +1,316 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Test and benchmark for the hierarchical bitmap ID allocator
+ *
+ * Random allocate, set, and clear operations are run against allocators
+ * of various sizes and the results of allocation and of finding the next
+ * free and allocated IDs are checked against a flat bitmap. Allocators are
+ * grown part way through. Then allocating an ID in a nearly full allocator
+ * is benchmarked against a scan of a flat bitmap (-b to only run the
+ * benchmark)
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/bitmap.h"
+#include "xdp2/id_alloc.h"
+
+static unsigned long errors;
+static bool verbose;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void check(struct xdp2_id_alloc *ida, const unsigned long *ref,
+		  unsigned int nbits, unsigned int pos, unsigned int count)
+{
+	unsigned int got, expect;
+
+	got = xdp2_id_alloc_find_next_free(ida, pos);
+	expect = xdp2_bitmap_find_zero(ref, pos, nbits);
+	if (got != expect) {
+		if (verbose)
+			fprintf(stderr, "nbits %u find free from %u: got %u "
+				"expected %u\n", nbits, pos, got, expect);
+		errors++;
+	}
+
+	got = xdp2_id_alloc_find_next(ida, pos);
+	expect = xdp2_bitmap_find(ref, pos, nbits);
+	if (got != expect) {
+		if (verbose)
+			fprintf(stderr, "nbits %u find from %u: got %u "
+				"expected %u\n", nbits, pos, got, expect);
+		errors++;
+	}
+
+	if (ida->count != count) {
+		if (verbose)
+			fprintf(stderr, "nbits %u count %u expected %u\n",
+				nbits, ida->count, count);
+		errors++;
+	}
+}
+
+static void test_one(unsigned int nbits, unsigned int grow_nbits,
+		     unsigned int ops)
+{
+	unsigned int i, id, count = 0, expect, max = grow_nbits;
+	struct xdp2_id_alloc ida;
+	unsigned long *ref;
+
+	ref = calloc(XDP2_BITMAP_NUM_BITS_TO_WORDS(max),
+		     sizeof(unsigned long));
+	if (!ref || xdp2_id_alloc_init(&ida, nbits)) {
+		fprintf(stderr, "Allocation failed\n");
+		exit(-1);
+	}
+
+	for (i = 0; i < ops; i++) {
+		if (i == ops / 2 && grow_nbits != nbits) {
+			if (xdp2_id_alloc_grow(&ida, grow_nbits)) {
+				fprintf(stderr, "Grow failed\n");
+				exit(-1);
+			}
+			nbits = grow_nbits;
+		}
+
+		id = random() % nbits;
+
+		switch (random() % 4) {
+		case 0:
+			/* Allocate the lowest free ID, biased towards
+			 * allocation to fill up the bitmap
+			 */
+		case 1:
+			expect = xdp2_bitmap_find_zero(ref, 0, nbits);
+			id = xdp2_id_alloc_get(&ida);
+			if (id != expect) {
+				if (verbose)
+					fprintf(stderr, "nbits %u get %u "
+						"expected %u\n", nbits, id,
+						expect);
+				errors++;
+			}
+			if (expect < nbits) {
+				xdp2_bitmap_set(ref, expect);
+				count++;
+			}
+			break;
+		case 2:
+			if (xdp2_id_alloc_set(&ida, id) ==
+			    xdp2_bitmap_isset(ref, id)) {
+				if (verbose)
+					fprintf(stderr, "nbits %u set %u "
+						"mismatch\n", nbits, id);
+				errors++;
+			}
+			if (!xdp2_bitmap_isset(ref, id)) {
+				xdp2_bitmap_set(ref, id);
+				count++;
+			}
+			break;
+		case 3:
+			if (xdp2_id_alloc_clear(&ida, id) !=
+			    xdp2_bitmap_isset(ref, id)) {
+				if (verbose)
+					fprintf(stderr, "nbits %u clear %u "
+						"mismatch\n", nbits, id);
+				errors++;
+			}
+			if (xdp2_bitmap_isset(ref, id)) {
+				xdp2_bitmap_unset(ref, id);
+				count--;
+			}
+			break;
+		}
+
+		check(&ida, ref, nbits, random() % (nbits + 1), count);
+	}
+
+	/* Iterating returns the allocated IDs in order */
+	expect = 0;
+	xdp2_id_alloc_foreach(&ida, id) {
+		if (!xdp2_bitmap_isset(ref, id)) {
+			if (verbose)
+				fprintf(stderr, "nbits %u foreach %u not set\n",
+					nbits, id);
+			errors++;
+		}
+		expect++;
+	}
+	if (expect != count) {
+		if (verbose)
+			fprintf(stderr, "nbits %u foreach %u expected %u\n",
+				nbits, expect, count);
+		errors++;
+	}
+
+	/* Fill the rest, then allocation fails */
+	while (xdp2_id_alloc_get(&ida) < nbits)
+		count++;
+	if (count != nbits || ida.count != nbits ||
+	    xdp2_id_alloc_find_next_free(&ida, 0) != nbits) {
+		if (verbose)
+			fprintf(stderr, "nbits %u fill count %u\n", nbits,
+				count);
+		errors++;
+	}
+
+	xdp2_id_alloc_fini(&ida);
+	free(ref);
+}
+
+static void test(unsigned int ops)
+{
+	static const unsigned int sizes[][2] = {
+		{ 1, 1 }, { 63, 64 }, { 64, 65 }, { 65, 4096 },
+		{ 4095, 4097 }, { 4097, 10000 }, { 262143, 262145 },
+		{ 300000, 300000 },
+	};
+	unsigned int i;
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		test_one(sizes[i][0], sizes[i][1], ops);
+}
+
+/* Allocate and free a random ID in an allocator where all but a few IDs
+ * are allocated, compared with scanning a flat bitmap for a zero bit
+ */
+static void bench(unsigned int nbits, unsigned int count)
+{
+	struct xdp2_id_alloc ida;
+	unsigned long *ref;
+	unsigned long sum = 0;
+	unsigned int i, id;
+	double start;
+
+	ref = calloc(XDP2_BITMAP_NUM_BITS_TO_WORDS(nbits),
+		     sizeof(unsigned long));
+	if (!ref || xdp2_id_alloc_init(&ida, nbits)) {
+		fprintf(stderr, "Allocation failed\n");
+		exit(-1);
+	}
+
+	for (i = 0; i < nbits; i++) {
+		xdp2_id_alloc_set(&ida, i);
+		xdp2_bitmap_set(ref, i);
+	}
+
+	start = now();
+	for (i = 0; i < count; i++) {
+		id = (i * 40503) % nbits;
+		xdp2_id_alloc_clear(&ida, id);
+		sum += xdp2_id_alloc_get(&ida);
+	}
+	printf("id_alloc get:  %10.1f nsecs/alloc\n",
+	       (now() - start) * 1e9 / count);
+
+	start = now();
+	for (i = 0; i < count; i++) {
+		id = (i * 40503) % nbits;
+		xdp2_bitmap_unset(ref, id);
+		id = xdp2_bitmap_find_zero(ref, 0, nbits);
+		xdp2_bitmap_set(ref, id);
+		sum -= id;
+	}
+	printf("bitmap scan:   %10.1f nsecs/alloc\n",
+	       (now() - start) * 1e9 / count);
+
+	if (sum) {
+		fprintf(stderr, "Benchmark allocations differ\n");
+		errors++;
+	}
+
+	xdp2_id_alloc_fini(&ida);
+	free(ref);
+}
+
+#define ARGS "n:c:o:bv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-n <nbits>] [-c <count>] ", name);
+	fprintf(stderr, "[-o <ops>] [-b] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int nbits = 1 << 20, count = 10000, ops = 20000;
+	bool bench_only = false;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'n':
+			nbits = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			ops = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			bench_only = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!nbits) {
+		fprintf(stderr, "Number of bits must be non-zero\n");
+		exit(-1);
+	}
+
+	if (!bench_only) {
+		test(ops);
+		printf("Tests done: %lu errors\n", errors);
+	}
+
+	if (count)
+		bench(nbits, count);
+
+	return errors ? -1 : 0;
+}
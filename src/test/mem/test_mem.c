@@ -0,0 +1,450 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Test and benchmark for memory placement
+ *
+ * Memory is allocated with each page size and checked to be zeroed and
+ * usable, with hugepages falling back to regular pages when none are
+ * reserved. NUMA binding is checked with move_pages. Shared memory is
+ * created as a memfd and as a file and checked to be shared between two
+ * mappings. A per node packet buffer manager is initialized, selected by
+ * the thread, and used to allocate pvbufs and pbufs. The benchmark
+ * measures random cache line reads over a large region for each page size
+ * (-b to only run the benchmark)
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xdp2/mem.h"
+#include "xdp2/pvbuf.h"
+#include "xdp2/shm.h"
+#include "xdp2/utility.h"
+
+static unsigned long errors;
+static bool verbose;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char *page_size_names[] = {
+	[XDP2_MEM_PAGE_DEFAULT] = "4K",
+	[XDP2_MEM_PAGE_2M] = "2M",
+	[XDP2_MEM_PAGE_1G] = "1G",
+};
+
+static bool check_zero(const unsigned char *p, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		if (p[i])
+			return false;
+
+	return true;
+}
+
+static void test_alloc(enum xdp2_mem_page_size page_size)
+{
+	struct xdp2_mem_config config = {
+		.page_size = page_size,
+		.prefault = true,
+	};
+	size_t size = (3 << 20) + 100, page_bytes;
+	unsigned char *p;
+
+	p = xdp2_mem_alloc(size, &config);
+	if (!p) {
+		printf("Alloc %s pages failed\n", page_size_names[page_size]);
+		errors++;
+		return;
+	}
+
+	if (!check_zero(p, size)) {
+		printf("Alloc %s pages not zeroed\n",
+		       page_size_names[page_size]);
+		errors++;
+	}
+
+	memset(p, 0xa5, size);
+
+	page_bytes = xdp2_mem_alloc_page_bytes(p);
+	if (page_bytes != xdp2_mem_page_bytes(page_size) &&
+	    page_bytes != xdp2_mem_page_bytes(XDP2_MEM_PAGE_DEFAULT)) {
+		printf("Alloc %s pages: bad page size %lu\n",
+		       page_size_names[page_size], page_bytes);
+		errors++;
+	}
+
+	if (verbose)
+		printf("Alloc %s pages: got %lu byte pages\n",
+		       page_size_names[page_size], page_bytes);
+
+	xdp2_mem_free(p);
+
+	/* Without fallback the allocation either gets hugepages or fails */
+	config.no_fallback = true;
+	p = xdp2_mem_alloc(size, &config);
+	if (p) {
+		if (xdp2_mem_alloc_page_bytes(p) !=
+		    xdp2_mem_page_bytes(page_size)) {
+			printf("Alloc %s pages no fallback: bad page size\n",
+			       page_size_names[page_size]);
+			errors++;
+		}
+		xdp2_mem_free(p);
+	}
+}
+
+/* Check that all the pages of a range are on a node */
+static void check_node(void *p, size_t size, size_t page_bytes,
+		       unsigned int node, const char *what)
+{
+	unsigned long i, num = size / page_bytes;
+	void *pages[num];
+	int status[num];
+
+	for (i = 0; i < num; i++)
+		pages[i] = p + i * page_bytes;
+
+	if (syscall(SYS_move_pages, 0, num, pages, NULL, status, 0)) {
+		if (verbose)
+			printf("%s: move_pages failed: %s\n", what,
+			       strerror(errno));
+		return;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (status[i] != node) {
+			printf("%s: page %lu on node %d expected %u\n",
+			       what, i, status[i], node);
+			errors++;
+			return;
+		}
+	}
+}
+
+static void test_bind(void)
+{
+	int node = xdp2_mem_current_node();
+	struct xdp2_mem_config config = {
+		.numa_bind = true,
+		.prefault = true,
+	};
+	size_t size = 1 << 20;
+	void *p;
+
+	if (node < 0 || node >= xdp2_mem_num_nodes()) {
+		printf("Current node %d is invalid for %u nodes\n", node,
+		       xdp2_mem_num_nodes());
+		errors++;
+		return;
+	}
+
+	if (xdp2_mem_cpu_node(sched_getcpu()) != node) {
+		printf("CPU node %d doesn't match current node %d\n",
+		       xdp2_mem_cpu_node(sched_getcpu()), node);
+		errors++;
+	}
+
+	config.numa_node = node;
+	p = xdp2_mem_alloc(size, &config);
+	if (!p) {
+		printf("Alloc bound to node %d failed\n", node);
+		errors++;
+		return;
+	}
+
+	check_node(p, size, xdp2_mem_alloc_page_bytes(p), node, "Bind");
+
+	xdp2_mem_free(p);
+
+	/* A node that can't exist */
+	config.numa_node = XDP2_MEM_MAX_NODES;
+	p = xdp2_mem_alloc(size, &config);
+	if (p) {
+		printf("Alloc bound to a bad node succeeded\n");
+		xdp2_mem_free(p);
+		errors++;
+	}
+}
+
+static void check_shared(unsigned char *p1, unsigned char *p2, size_t size,
+			 const char *what)
+{
+	if (!p1 || !p2) {
+		printf("%s: map failed\n", what);
+		errors++;
+		return;
+	}
+
+	if (!check_zero(p1, size)) {
+		printf("%s: not zeroed\n", what);
+		errors++;
+	}
+
+	p1[0] = 1;
+	p1[size - 1] = 2;
+
+	if (p2[0] != 1 || p2[size - 1] != 2) {
+		printf("%s: memory is not shared\n", what);
+		errors++;
+	}
+}
+
+static void test_shm(void)
+{
+	struct xdp2_mem_config config = {
+		.page_size = XDP2_MEM_PAGE_2M,
+		.numa_bind = true,
+		.prefault = true,
+	};
+	char file[64];
+	size_t size = 4 << 20;
+	void *p1, *p2;
+	int fd;
+
+	config.numa_node = xdp2_mem_current_node();
+
+	fd = xdp2_shm_memfd_create("test_mem", size, &config);
+	if (fd < 0) {
+		printf("memfd create failed\n");
+		errors++;
+		return;
+	}
+
+	p1 = xdp2_shm_map_fd(fd, size, 0, false, &config);
+	p2 = xdp2_shm_map_fd(fd, size, 0, false, NULL);
+	check_shared(p1, p2, size, "memfd");
+
+	munmap(p1, size);
+	munmap(p2, size);
+	close(fd);
+
+	snprintf(file, sizeof(file), "/tmp/test_mem_%d", getpid());
+	unlink(file);
+
+	p1 = xdp2_shm_map_mem(file, size, 0, true, true, &config);
+	p2 = xdp2_shm_map(file, 0, 0, false, false);
+	check_shared(p1, p2, size, "shm file");
+
+	munmap(p1, size);
+	munmap(p2, size);
+	unlink(file);
+}
+
+static void test_node_mgr(void)
+{
+	struct xdp2_pbuf_init_allocator pbuf_allocs = {
+		.obj[5].num_objs = 1024,
+		.mem_config.page_size = XDP2_MEM_PAGE_2M,
+		.mem_config.prefault = true,
+	};
+	struct xdp2_pvbuf_init_allocator pvbuf_allocs = {
+		.obj[1].num_pvbufs = 64,
+		.mem_config.page_size = XDP2_MEM_PAGE_2M,
+	};
+	int node = xdp2_mem_current_node();
+	struct xdp2_pvbuf_mgr *pvmgr;
+	unsigned char data[3000], out[3000];
+	struct xdp2_pvbuf *pvbuf;
+	xdp2_paddr_t paddr;
+	void *pbuf, *base;
+	unsigned int i;
+	int ret;
+
+	ret = xdp2_pvbuf_init_node(node, &pbuf_allocs, &pvbuf_allocs,
+				   false, false);
+	if (ret) {
+		printf("Init node %d manager failed: %d\n", node, ret);
+		errors++;
+		return;
+	}
+
+	if (xdp2_pvbuf_init_node(node, &pbuf_allocs, &pvbuf_allocs,
+				 false, false) != -EEXIST) {
+		printf("Init node manager twice didn't fail\n");
+		errors++;
+	}
+
+	if (xdp2_pvbuf_local_mgr() != &xdp2_pvbuf_global_mgr) {
+		printf("Default thread manager isn't the global manager\n");
+		errors++;
+	}
+
+	pvmgr = xdp2_pvbuf_select_node_mgr();
+	if (pvmgr != xdp2_pvbuf_node_mgr(node) ||
+	    pvmgr != xdp2_pvbuf_local_mgr()) {
+		printf("Select node manager failed\n");
+		errors++;
+		return;
+	}
+
+	base = pvmgr->pbuf_allocator_table[5].pbuf_base;
+	check_node(base, xdp2_mem_alloc_page_bytes(base), 4096, node,
+		   "Node manager");
+
+	paddr = __xdp2_pbuf_alloc(pvmgr, 2048, false, &pbuf);
+	if (!paddr || pbuf < base ||
+	    pbuf >= base + 1024 * xdp2_pbuf_buffer_tag_to_size(5)) {
+		printf("Node manager pbuf is not in the node pool\n");
+		errors++;
+	}
+	if (paddr)
+		__xdp2_pbuf_free(pvmgr, paddr);
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 7;
+
+	paddr = __xdp2_pvbuf_alloc(pvmgr, sizeof(data), &pvbuf);
+	if (!paddr) {
+		printf("Node manager pvbuf alloc failed\n");
+		errors++;
+		goto out;
+	}
+
+	__xdp2_pvbuf_copy_data_to_pvbuf(pvmgr, paddr, data, sizeof(data), 0);
+	__xdp2_pvbuf_copy_pvbuf_to_data(pvmgr, paddr, out, sizeof(out), 0);
+
+	if (__xdp2_pvbuf_calc_length(pvmgr, paddr, true) != sizeof(data) ||
+	    memcmp(data, out, sizeof(data))) {
+		printf("Node manager pvbuf data mismatch\n");
+		errors++;
+	}
+
+	__xdp2_pvbuf_free(pvmgr, paddr);
+
+	if (pvmgr->allocs != pvmgr->frees) {
+		printf("Node manager allocs %lu frees %lu\n", pvmgr->allocs,
+		       pvmgr->frees);
+		errors++;
+	}
+
+out:
+	xdp2_pvbuf_set_thread_mgr(NULL);
+}
+
+/* Random cache line reads over a region */
+static void bench(enum xdp2_mem_page_size page_size, size_t size,
+		  unsigned long count)
+{
+	struct xdp2_mem_config config = {
+		.page_size = page_size,
+		.prefault = true,
+	};
+	unsigned long i, lines = size / 64, x = 1, sum = 0;
+	size_t page_bytes;
+	double start;
+	char *p;
+
+	p = xdp2_mem_alloc(size, &config);
+	if (!p) {
+		printf("Bench alloc %s pages failed\n",
+		       page_size_names[page_size]);
+		return;
+	}
+	page_bytes = xdp2_mem_alloc_page_bytes(p);
+
+	start = now();
+	for (i = 0; i < count; i++) {
+		x = x * 6364136223846793005UL + 1442695040888963407UL;
+		sum += p[((x >> 20) % lines) * 64];
+	}
+
+	printf("Random reads %luMB %s pages (got %luK): %.2f ns/read%s\n",
+	       size >> 20, page_size_names[page_size], page_bytes >> 10,
+	       (now() - start) * 1e9 / count, sum ? " (nonzero)" : "");
+
+	xdp2_mem_free(p);
+}
+
+#define ARGS "s:n:bv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-s <bench_MB>] [-n <bench_count>] ",
+		name);
+	fprintf(stderr, "[-b] [-v]\n");
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long bench_count = 10000000;
+	size_t bench_size = 1UL << 30;
+	bool bench_only = false;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 's':
+			bench_size = strtoul(optarg, NULL, 10) << 20;
+			break;
+		case 'n':
+			bench_count = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			bench_only = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!bench_only) {
+		test_alloc(XDP2_MEM_PAGE_DEFAULT);
+		test_alloc(XDP2_MEM_PAGE_2M);
+		test_alloc(XDP2_MEM_PAGE_1G);
+		test_bind();
+		test_shm();
+		test_node_mgr();
+
+		printf("Tests done: %lu errors\n", errors);
+	}
+
+	if (bench_count) {
+		bench(XDP2_MEM_PAGE_DEFAULT, bench_size, bench_count);
+		bench(XDP2_MEM_PAGE_2M, bench_size, bench_count);
+	}
+
+	return errors ? -1 : 0;
+}
@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Multithreaded benchmark for the object allocator
+ *
+ * Each thread repeatedly allocates a burst of objects, writes to them, and
+ * frees them. The test is run with the per-thread caches disabled (every
+ * alloc and free takes the allocator mutex) or enabled (-C), and with the
+ * single object or bulk APIs (-k). At the end all the objects must be back
+ * on the shared free list
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/locks.h"
+#include "xdp2/obj_allocator.h"
+#include "xdp2/utility.h"
+
+#define MAX_THREADS 64
+#define MAX_BURST 1024
+
+static struct xdp2_obj_allocator allocator;
+
+static unsigned int num_threads = 1;
+static unsigned int count = 100000;
+static unsigned int burst = 32;
+static bool use_bulk;
+static bool verbose;
+
+struct thread_info {
+	pthread_t thread;
+	unsigned int num;
+	unsigned long ops;
+	unsigned long fails;
+	double secs;
+};
+
+static struct thread_info threads[MAX_THREADS];
+
+static pthread_barrier_t barrier;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned int alloc_burst(void **objs)
+{
+	unsigned int i, index;
+
+	if (use_bulk)
+		return xdp2_obj_alloc_alloc_bulk(&allocator, objs, burst);
+
+	for (i = 0; i < burst; i++) {
+		objs[i] = xdp2_obj_alloc_alloc(&allocator, &index);
+		if (!objs[i])
+			break;
+	}
+
+	return i;
+}
+
+static void free_burst(void **objs, unsigned int num)
+{
+	unsigned int i;
+
+	if (use_bulk) {
+		xdp2_obj_alloc_free_bulk(&allocator, objs, num);
+		return;
+	}
+
+	for (i = 0; i < num; i++)
+		xdp2_obj_alloc_free(&allocator, objs[i]);
+}
+
+static void *run_thread(void *arg)
+{
+	struct thread_info *ti = arg;
+	void *objs[MAX_BURST];
+	unsigned int i, j, num;
+	double start;
+
+	pthread_barrier_wait(&barrier);
+
+	start = now();
+
+	for (i = 0; i < count; i++) {
+		num = alloc_burst(objs);
+		if (num < burst)
+			ti->fails++;
+
+		/* Touch the objects like a user would. Don't write the
+		 * first word so that a corrupted free list is detected
+		 * by validation
+		 */
+		for (j = 0; j < num; j++)
+			((unsigned long *)objs[j])[1] = ti->num;
+
+		free_burst(objs, num);
+		ti->ops += num;
+	}
+
+	ti->secs = now() - start;
+
+	return NULL;
+}
+
+#define ARGS "n:c:o:s:b:C:B:kv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-n <num_threads>] [-c <count>] ", name);
+	fprintf(stderr, "[-o <num_objs>] [-s <obj_size>] [-b <burst>] ");
+	fprintf(stderr, "[-C <cache_size>] [-B <cache_batch>] [-k] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int cache_size = 0, cache_batch = 0;
+	unsigned int num_objs = 1 << 16;
+	unsigned long total_ops = 0;
+	size_t obj_size = 64;
+	double max_secs = 0;
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'n':
+			num_threads = strtoul(optarg, NULL, 10);
+			if (!num_threads || num_threads > MAX_THREADS) {
+				fprintf(stderr, "Number of threads must be "
+						"between 1 and %u\n",
+					MAX_THREADS);
+				exit(-1);
+			}
+			break;
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			num_objs = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			obj_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			burst = strtoul(optarg, NULL, 10);
+			if (!burst || burst > MAX_BURST) {
+				fprintf(stderr, "Burst must be between 1 and "
+						"%u\n", MAX_BURST);
+				exit(-1);
+			}
+			break;
+		case 'C':
+			cache_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'B':
+			cache_batch = strtoul(optarg, NULL, 10);
+			break;
+		case 'k':
+			use_bulk = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (obj_size < 2 * sizeof(unsigned long)) {
+		fprintf(stderr, "Object size must be at least %lu\n",
+			2 * sizeof(unsigned long));
+		exit(-1);
+	}
+
+	xdp2_locks_init_locks();
+
+	if (!xdp2_obj_alloc_init(&allocator, num_objs, obj_size, "bench",
+				 XDP2_ADDR_XLAT_NO_XLAT)) {
+		fprintf(stderr, "Allocator init failed\n");
+		exit(-1);
+	}
+
+	if (cache_size && !xdp2_obj_alloc_cache_enable(&allocator, cache_size,
+						       cache_batch)) {
+		fprintf(stderr, "Bad cache size %u or batch %u\n",
+			cache_size, cache_batch);
+		exit(-1);
+	}
+
+	pthread_barrier_init(&barrier, NULL, num_threads);
+
+	for (i = 0; i < num_threads; i++) {
+		threads[i].num = i;
+		pthread_create(&threads[i].thread, NULL, run_thread,
+			       &threads[i]);
+	}
+
+	for (i = 0; i < num_threads; i++) {
+		pthread_join(threads[i].thread, NULL);
+		total_ops += threads[i].ops;
+		max_secs = xdp2_max(max_secs, threads[i].secs);
+		if (verbose)
+			printf("Thread %u: %lu ops, %lu short bursts, "
+			       "%.1f ns/op\n", i, threads[i].ops,
+			       threads[i].fails,
+			       threads[i].secs * 1e9 / threads[i].ops);
+	}
+
+	printf("%u threads, cache %u/%u, %s: %lu alloc+free ops in %.3f "
+	       "secs, %.2f Mops/sec\n", num_threads, allocator.cache_size,
+	       allocator.cache_batch, use_bulk ? "bulk" : "single",
+	       total_ops, max_secs, total_ops / max_secs / 1e6);
+
+	if (verbose)
+		xdp2_obj_alloc_show_allocator(&allocator, NULL);
+
+	/* Magazines are flushed at thread exit, so all the objects must be
+	 * on the shared free list
+	 */
+	__xdp2_obj_alloc_validate(&allocator);
+	if (allocator.alloc_free_list.num_free != num_objs ||
+	    allocator.alloc_free_list.num_cached) {
+		fprintf(stderr, "Objects leaked: num_free %u, num_cached %u, "
+				"expected %u free\n",
+			allocator.alloc_free_list.num_free,
+			allocator.alloc_free_list.num_cached, num_objs);
+		exit(1);
+	}
+
+	return 0;
+}
@@ -34,6 +34,10 @@
 #include "test-parser-core.h"
 #include "common-xdp2.h"
 
+static const char *xdp2_md_to_out(struct xdp2_parser_big_metadata_one *md,
+				  int err, struct test_parser_out *out,
+				  unsigned int flags);
+
 const char *common_core_xdp2_process(struct xdp2_priv *p, void *data,
 				     size_t len,
 				     struct test_parser_out *out,
@@ -42,7 +46,7 @@ const char *common_core_xdp2_process(struct xdp2_priv *p, void *data,
 				     bool use_fast)
 {
 	struct xdp2_ctrl_data ctrl;
-	int i, err;
+	int err;
 
 	memset(&p->md, 0, sizeof(p->md));
 	memset(out, 0, sizeof(*out));
@@ -72,6 +76,65 @@ const char *common_core_xdp2_process(struct xdp2_priv *p, void *data,
 			 (now_tp.tv_nsec - begin_tp.tv_nsec);
 	}
 
+	return xdp2_md_to_out(&p->md, err, out, flags);
+}
+
+void common_core_xdp2_process_burst(struct xdp2_priv *p, void **data,
+				    size_t *lens,
+				    struct test_parser_out *outs,
+				    const char **errs, unsigned int num,
+				    unsigned int flags, long long *time,
+				    const struct xdp2_parser *parser)
+{
+	struct xdp2_parse_burst_pkt pkts[XDP2_PARSE_BURST_MAX];
+	struct xdp2_ctrl_data ctrls[XDP2_PARSE_BURST_MAX];
+	int i;
+
+	if (num > XDP2_PARSE_BURST_MAX) {
+		fprintf(stderr, "Burst size %u is greater than maximum %u\n",
+			num, XDP2_PARSE_BURST_MAX);
+		exit(-1);
+	}
+
+	memset(p->bmd, 0, num * sizeof(p->bmd[0]));
+	memset(ctrls, 0, num * sizeof(ctrls[0]));
+
+	for (i = 0; i < num; i++) {
+		pkts[i].hdr = data[i];
+		pkts[i].len = lens[i];
+		pkts[i].metadata = &p->bmd[i];
+		pkts[i].ctrl = &ctrls[i];
+		pkts[i].ret = XDP2_OKAY;
+	}
+
+	if (!(flags & CORE_F_NOCORE)) {
+		struct timespec begin_tp, now_tp;
+		unsigned int pflags = 0;
+
+		if (flags & CORE_F_DEBUG)
+			pflags |= XDP2_F_DEBUG;
+
+		clock_gettime(CLOCK_MONOTONIC_RAW, &begin_tp);
+		xdp2_parse_burst(parser, pkts, num, pflags);
+		clock_gettime(CLOCK_MONOTONIC_RAW, &now_tp);
+
+		*time += (now_tp.tv_sec - begin_tp.tv_sec) * 1000000000 +
+			 (now_tp.tv_nsec - begin_tp.tv_nsec);
+	}
+
+	for (i = 0; i < num; i++) {
+		memset(&outs[i], 0, sizeof(outs[i]));
+		errs[i] = xdp2_md_to_out(&p->bmd[i], pkts[i].ret, &outs[i],
+					 flags);
+	}
+}
+
+static const char *xdp2_md_to_out(struct xdp2_parser_big_metadata_one *md,
+				  int err, struct test_parser_out *out,
+				  unsigned int flags)
+{
+	int i;
+
 	switch (err) {
 	case XDP2_OKAY:
 		// printf("XDP2 status OKAY\n");
@@ -89,18 +152,18 @@ const char *common_core_xdp2_process(struct xdp2_priv *p, void *data,
 		return "XDP2: STOP_ENCAP_DEPTH";
 	}
 #if 0
-	if (p->md.xdp2_data.encaps)
+	if (md->xdp2_data.encaps)
 		printf("XDP2 encaps %u\n",
-		       (unsigned int)p->md.xdp2_data.encaps);
-	if (p->md.xdp2_data.max_frame_num)
+		       (unsigned int)md->xdp2_data.encaps);
+	if (md->xdp2_data.max_frame_num)
 		printf("XDP2 max_frame_num %u\n",
-		       (unsigned int)p->md.xdp2_data.max_frame_num);
-	if (p->md.xdp2_data.frame_size)
+		       (unsigned int)md->xdp2_data.max_frame_num);
+	if (md->xdp2_data.frame_size)
 		printf("XDP2 frame_size %u\n",
-		       (unsigned int)p->md.xdp2_data.frame_size);
+		       (unsigned int)md->xdp2_data.frame_size);
 #endif
 
-	switch (p->md.frame.addr_type) {
+	switch (md->frame.addr_type) {
 	case 0:
 		break;
 	case XDP2_ADDR_TYPE_IPV4:
@@ -123,16 +186,16 @@ const char *common_core_xdp2_process(struct xdp2_priv *p, void *data,
 	 */
 
 #if 0
-	if (p->md.frame.is_fragment)
-		printf("XDP2 is_fragment %d\n", (int)p->md.frame.is_fragment);
-	if (p->md.frame.first_frag)
-		printf("XDP2 first_frag %d\n", (int)p->md.frame.first_frag);
+	if (md->frame.is_fragment)
+		printf("XDP2 is_fragment %d\n", (int)md->frame.is_fragment);
+	if (md->frame.first_frag)
+		printf("XDP2 first_frag %d\n", (int)md->frame.first_frag);
 
-	if (p->md.frame.vlan_count)
-		printf("XDP2 vlan_count %d\n", (int)p->md.frame.vlan_count);
+	if (md->frame.vlan_count)
+		printf("XDP2 vlan_count %d\n", (int)md->frame.vlan_count);
 #endif
 
-	if (ARRAY_SIZE(p->md.frame.eth_addrs) !=
+	if (ARRAY_SIZE(md->frame.eth_addrs) !=
 	    ARRAY_SIZE(out->k_eth_addrs.src) +
 	    ARRAY_SIZE(out->k_eth_addrs.dst)) {
 		fprintf(stderr, "XDP2 and output struct disagree on Ethernet "
@@ -140,110 +203,110 @@ const char *common_core_xdp2_process(struct xdp2_priv *p, void *data,
 		exit(-1);
 	}
 
-	memcpy(out->k_eth_addrs.dst, p->md.frame.eth_addrs,
+	memcpy(out->k_eth_addrs.dst, md->frame.eth_addrs,
 	       ARRAY_SIZE(out->k_eth_addrs.dst));
 	memcpy(out->k_eth_addrs.src,
-	       &p->md.frame.eth_addrs[ARRAY_SIZE(out->k_eth_addrs.dst)],
+	       &md->frame.eth_addrs[ARRAY_SIZE(out->k_eth_addrs.dst)],
 	       ARRAY_SIZE(out->k_eth_addrs.src));
 
-	out->k_mpls.mpls_ttl = p->md.frame.mpls.ttl;
-	out->k_mpls.mpls_bos = p->md.frame.mpls.bos;
-	out->k_mpls.mpls_tc = p->md.frame.mpls.tc;
-	out->k_mpls.mpls_label = p->md.frame.mpls.label;
-	out->k_arp.s_ip = p->md.frame.arp.sip;
-	out->k_arp.t_ip = p->md.frame.arp.tip;
-	out->k_arp.op = p->md.frame.arp.op;
-
-	out->k_gre.flags = p->md.frame.gre.flags;
-	out->k_gre.csum = p->md.frame.gre.csum;
-	out->k_gre.keyid = p->md.frame.gre.keyid;
-	out->k_gre.seq = p->md.frame.gre.seq;
-	out->k_gre.routing = p->md.frame.gre.routing;
-
-	out->k_gre_pptp.flags = p->md.frame.gre_pptp.flags;
-	out->k_gre_pptp.length = p->md.frame.gre_pptp.length;
-	out->k_gre_pptp.callid = p->md.frame.gre_pptp.callid;
-	out->k_gre_pptp.seq = p->md.frame.gre_pptp.seq;
-	out->k_gre_pptp.ack = p->md.frame.gre_pptp.ack;
-
-	memcpy(out->k_arp.s_hw, p->md.frame.arp.sha,
-	       xdp2_min(ARRAY_SIZE(p->md.frame.arp.sha),
+	out->k_mpls.mpls_ttl = md->frame.mpls.ttl;
+	out->k_mpls.mpls_bos = md->frame.mpls.bos;
+	out->k_mpls.mpls_tc = md->frame.mpls.tc;
+	out->k_mpls.mpls_label = md->frame.mpls.label;
+	out->k_arp.s_ip = md->frame.arp.sip;
+	out->k_arp.t_ip = md->frame.arp.tip;
+	out->k_arp.op = md->frame.arp.op;
+
+	out->k_gre.flags = md->frame.gre.flags;
+	out->k_gre.csum = md->frame.gre.csum;
+	out->k_gre.keyid = md->frame.gre.keyid;
+	out->k_gre.seq = md->frame.gre.seq;
+	out->k_gre.routing = md->frame.gre.routing;
+
+	out->k_gre_pptp.flags = md->frame.gre_pptp.flags;
+	out->k_gre_pptp.length = md->frame.gre_pptp.length;
+	out->k_gre_pptp.callid = md->frame.gre_pptp.callid;
+	out->k_gre_pptp.seq = md->frame.gre_pptp.seq;
+	out->k_gre_pptp.ack = md->frame.gre_pptp.ack;
+
+	memcpy(out->k_arp.s_hw, md->frame.arp.sha,
+	       xdp2_min(ARRAY_SIZE(md->frame.arp.sha),
 			 ARRAY_SIZE(out->k_arp.s_hw)));
-	memcpy(out->k_arp.t_hw, p->md.frame.arp.tha,
-	       xdp2_min(ARRAY_SIZE(p->md.frame.arp.tha),
+	memcpy(out->k_arp.t_hw, md->frame.arp.tha,
+	       xdp2_min(ARRAY_SIZE(md->frame.arp.tha),
 			 ARRAY_SIZE(out->k_arp.t_hw)));
 
-	out->k_tcp_opt.mss = p->md.frame.tcp_options.mss;
-	out->k_tcp_opt.ws = p->md.frame.tcp_options.window_scaling;
-	out->k_tcp_opt.ts_val = p->md.frame.tcp_options.timestamp.value;
-	out->k_tcp_opt.ts_echo = p->md.frame.tcp_options.timestamp.echo;
+	out->k_tcp_opt.mss = md->frame.tcp_options.mss;
+	out->k_tcp_opt.ws = md->frame.tcp_options.window_scaling;
+	out->k_tcp_opt.ts_val = md->frame.tcp_options.timestamp.value;
+	out->k_tcp_opt.ts_echo = md->frame.tcp_options.timestamp.echo;
 
 	/* We assume that the first SACK element with both edges zero
 	 * indicates the end of the SACK list.
 	 */
-	for (i = 0; (i < ARRAY_SIZE(p->md.frame.tcp_options.sack)) &&
+	for (i = 0; (i < ARRAY_SIZE(md->frame.tcp_options.sack)) &&
 	     (i < ARRAY_SIZE(out->k_tcp_opt.sack)) &&
-	     (p->md.frame.tcp_options.sack[i].left_edge ||
-	      p->md.frame.tcp_options.sack[i].right_edge); i++) {
+	     (md->frame.tcp_options.sack[i].left_edge ||
+	      md->frame.tcp_options.sack[i].right_edge); i++) {
 		out->k_tcp_opt.sack[i].l =
-		    p->md.frame.tcp_options.sack[i].left_edge;
+		    md->frame.tcp_options.sack[i].left_edge;
 		out->k_tcp_opt.sack[i].r =
-		    p->md.frame.tcp_options.sack[i].right_edge;
+		    md->frame.tcp_options.sack[i].right_edge;
 	}
 
 	if (i < ARRAY_SIZE(out->k_tcp_opt.sack)) {
 		out->k_tcp_opt.sack[i].l = 0;
 		out->k_tcp_opt.sack[i].r = 0;
 	}
-	out->k_basic.n_proto = p->md.frame.eth_proto;
-	out->k_basic.ip_proto = p->md.frame.ip_proto;
-	out->k_flow_label.flow_label = p->md.frame.flow_label;
+	out->k_basic.n_proto = md->frame.eth_proto;
+	out->k_basic.ip_proto = md->frame.ip_proto;
+	out->k_flow_label.flow_label = md->frame.flow_label;
 
-	switch (p->md.frame.vlan_count) {
+	switch (md->frame.vlan_count) {
 	case 0:
 		break;
 	case 1:
-		out->k_vlan.vlan_id = p->md.frame.vlan[0].id;
-		out->k_vlan.vlan_dei = p->md.frame.vlan[0].dei;
-		out->k_vlan.vlan_priority = p->md.frame.vlan[0].priority;
-		out->k_vlan.vlan_tpid = p->md.frame.vlan[0].tpid;
+		out->k_vlan.vlan_id = md->frame.vlan[0].id;
+		out->k_vlan.vlan_dei = md->frame.vlan[0].dei;
+		out->k_vlan.vlan_priority = md->frame.vlan[0].priority;
+		out->k_vlan.vlan_tpid = md->frame.vlan[0].tpid;
 		break;
 	default:
 #if 0
-		printf("XDP2 vlan_count %d\n", (int)p->md.frame.vlan_count);
+		printf("XDP2 vlan_count %d\n", (int)md->frame.vlan_count);
 #endif
 		break;
 	}
 
 #if 0
-	if (p->md.frame.keyid)
+	if (md->frame.keyid)
 		printf("XDP2 keyid %08lx\n",
-		       (unsigned long)p->md.frame.keyid);
+		       (unsigned long)md->frame.keyid);
 #endif
 
-	out->k_ports.src = p->md.frame.src_port;
-	out->k_ports.dst = p->md.frame.dst_port;
-	out->k_icmp.type = p->md.frame.icmp.type;
-	out->k_icmp.code = p->md.frame.icmp.code;
-	out->k_icmp.id = p->md.frame.icmp.id;
+	out->k_ports.src = md->frame.src_port;
+	out->k_ports.dst = md->frame.dst_port;
+	out->k_icmp.type = md->frame.icmp.type;
+	out->k_icmp.code = md->frame.icmp.code;
+	out->k_icmp.id = md->frame.icmp.id;
 
-	switch (p->md.frame.addr_type) {
+	switch (md->frame.addr_type) {
 	case XDP2_ADDR_TYPE_IPV4:
-		out->k_ipv4_addrs.src = p->md.frame.addrs.v4_addrs[0];
-		out->k_ipv4_addrs.dst = p->md.frame.addrs.v4_addrs[1];
+		out->k_ipv4_addrs.src = md->frame.addrs.v4_addrs[0];
+		out->k_ipv4_addrs.dst = md->frame.addrs.v4_addrs[1];
 		break;
 	case XDP2_ADDR_TYPE_IPV6:
-		memcpy(out->k_ipv6_addrs.src, p->md.frame.addrs.v6_addrs, 16);
-		memcpy(out->k_ipv6_addrs.dst, &p->md.frame.addrs.v6_addrs[1],
+		memcpy(out->k_ipv6_addrs.src, md->frame.addrs.v6_addrs, 16);
+		memcpy(out->k_ipv6_addrs.dst, &md->frame.addrs.v6_addrs[1],
 		       16);
 		break;
 	case XDP2_ADDR_TYPE_TIPC:
-		out->k_tipc.key = p->md.frame.addrs.tipckey;
+		out->k_tipc.key = md->frame.addrs.tipckey;
 		break;
 	}
 
 	if (flags & CORE_F_HASH)
-		out->k_hash.hash = xdp2_parser_big_hash_frame(&p->md.frame);
+		out->k_hash.hash = xdp2_parser_big_hash_frame(&md->frame);
 
 	return 0;
 }
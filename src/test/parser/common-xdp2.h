@@ -37,6 +37,7 @@
 
 struct xdp2_priv {
 	struct xdp2_parser_big_metadata_one md;
+	struct xdp2_parser_big_metadata_one bmd[XDP2_PARSE_BURST_MAX];
 };
 
 const char *common_core_xdp2_process(struct xdp2_priv *p, void *data,
@@ -46,4 +47,11 @@ const char *common_core_xdp2_process(struct xdp2_priv *p, void *data,
 				     const struct xdp2_parser *parser,
 				     bool use_fast);
 
+void common_core_xdp2_process_burst(struct xdp2_priv *p, void **data,
+				    size_t *lens,
+				    struct test_parser_out *outs,
+				    const char **errs, unsigned int num,
+				    unsigned int flags, long long *time,
+				    const struct xdp2_parser *parser);
+
 #endif /* __PARSER_TEST_COMMON_XDP2_H__ */
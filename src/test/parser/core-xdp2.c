@@ -48,6 +48,11 @@ static void *core_xdp2_init(const char *args)
 		exit(-1);
 	}
 
+	if (xdp2_parser_init(xdp2_parser_big_ether)) {
+		fprintf(stderr, "xdp2_parser_init failed\n");
+		exit(-11);
+	}
+
 	p = calloc(1, sizeof(struct xdp2_priv));
 	if (!p) {
 		fprintf(stderr, "xdp2_parser_init failed\n");
@@ -66,9 +71,19 @@ static const char *core_xdp2_process(void *pv, void *data, size_t len,
 					xdp2_parser_big_ether, false);
 }
 
+static void core_xdp2_process_burst(void *pv, void **data, size_t *lens,
+				    struct test_parser_out *outs,
+				    const char **errs, unsigned int num,
+				    unsigned int flags, long long *time)
+{
+	common_core_xdp2_process_burst((struct xdp2_priv *)pv, data, lens,
+				       outs, errs, num, flags, time,
+				       xdp2_parser_big_ether);
+}
+
 static void core_xdp2_done(void *pv)
 {
 	free(pv);
 }
 
-CORE_DECL(xdp2)
+CORE_DECL_BURST(xdp2)
@@ -58,6 +58,11 @@ static void *core_xdp2_notcpopts_init(const char *args)
 		exit(-1);
 	}
 
+	if (xdp2_parser_init(my_parser_big_ether)) {
+		fprintf(stderr, "xdp2_parser_init failed\n");
+		exit(-11);
+	}
+
 	p = calloc(1, sizeof(struct xdp2_priv));
 	if (!p) {
 		fprintf(stderr, "xdp2_parser_init failed\n");
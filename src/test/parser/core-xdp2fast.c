@@ -54,6 +54,11 @@ static void *core_xdp2fast_init(const char *args)
 		exit(-1);
 	}
 
+	if (xdp2_parser_init(xdp2_parser_big_ether)) {
+		fprintf(stderr, "xdp2_parser_init failed\n");
+		exit(-1);
+	}
+
 	p = calloc(1, sizeof(struct xdp2_priv));
 	if (!p) {
 		fprintf(stderr, "xdp2_parser_init failed\n");
@@ -66,9 +66,19 @@ static const char *core_xdp2opt_process(void *pv, void *data, size_t len,
 					xdp2_parser_big_ether_opt, false);
 }
 
+static void core_xdp2opt_process_burst(void *pv, void **data, size_t *lens,
+				    struct test_parser_out *outs,
+				    const char **errs, unsigned int num,
+				    unsigned int flags, long long *time)
+{
+	common_core_xdp2_process_burst((struct xdp2_priv *)pv, data, lens,
+				       outs, errs, num, flags, time,
+				       xdp2_parser_big_ether_opt);
+}
+
 static void core_xdp2opt_done(void *pv)
 {
 	free(pv);
 }
 
-CORE_DECL(xdp2opt)
+CORE_DECL_BURST(xdp2opt)
@@ -31,6 +31,9 @@
 
 #include "imethod.h"
 #include "omethod.h"
+#include "parselite/parser.h"
+#include "xdp2/parser.h"
+#include "xdp2/pgo.h"
 #include "xdp2/utility.h"
 #include "test-parser-out.h"
 #include "test-parser-core.h"
@@ -45,6 +48,7 @@ extern const char *__progname;
 unsigned char pktdata[MAXPKT] __defaligned();
 ssize_t pktlen;
 static int repeat = 1;
+static int burst = 1;
 static unsigned int coreflags;
 static struct imethod *imethod;
 static void *imarg;
@@ -53,6 +57,7 @@ static void *omarg;
 static struct test_parser_core *core;
 static void *carg;
 static unsigned int pktnum;
+static const char *profile;
 
 /* Read packets.  This just calls on the input method. */
 static int readpkt(void)
@@ -128,7 +133,63 @@ static void processpkt(void)
 	(*omethod->post) (omarg, coreerr, &out);
 }
 
-static void set_repeat(const char *name)
+/* Burst mode. Packets are collected from the input method in bursts and
+ * the core processes the whole burst in one call
+ */
+static unsigned char *burstdata;
+static void *burstpkts[XDP2_PARSE_BURST_MAX];
+static size_t burstlens[XDP2_PARSE_BURST_MAX];
+static struct test_parser_out burstouts[XDP2_PARSE_BURST_MAX];
+static const char *bursterrs[XDP2_PARSE_BURST_MAX];
+
+/* Read a burst of packets. Returns the number of packets read */
+static unsigned int readburst(void)
+{
+	unsigned int n = 0;
+
+	while (n < burst && readpkt()) {
+		if (pktlen < 14) {
+			fprintf(stderr, "Length %lu - too small for Ethernet\n",
+				pktlen);
+			continue;
+		}
+		burstpkts[n] = &burstdata[n * MAXPKT];
+		memcpy(burstpkts[n], pktdata, pktlen);
+		burstlens[n] = pktlen;
+		n++;
+	}
+
+	return n;
+}
+
+static void processburst(unsigned int num)
+{
+	unsigned int i;
+
+	if (!core->process_burst) {
+		fprintf(stderr,
+			"%s: core %s does not support burst mode\n",
+			__progname, core->name);
+		exit(-1);
+	}
+	if (!omethod) {
+		fprintf(stderr,
+			"%s: no output method specified (use -h for help)\n",
+			__progname);
+		exit(-1);
+	}
+
+	(*core->process_burst) (carg, burstpkts, burstlens, burstouts,
+				bursterrs, num, coreflags, &_time);
+
+	for (i = 0; i < num; i++) {
+		pktnum++;
+		(*omethod->pre) (omarg, burstpkts[i], burstlens[i], pktnum);
+		(*omethod->post) (omarg, bursterrs[i], &burstouts[i]);
+	}
+}
+
+static int get_count(const char *name)
 {
 	long liv;
 	char *ep;
@@ -151,7 +212,37 @@ static void set_repeat(const char *name)
 			liv);
 		exit(-1);
 	}
-	repeat = iv;
+
+	return iv;
+}
+
+static void set_repeat(const char *name)
+{
+	repeat = get_count(name);
+}
+
+static void set_burst(const char *name)
+{
+	burst = get_count(name);
+	if (burst > XDP2_PARSE_BURST_MAX) {
+		fprintf(stderr, "%s: burst size %d is greater than maximum "
+			"%u\n", __progname, burst, XDP2_PARSE_BURST_MAX);
+		exit(-1);
+	}
+}
+
+static void set_hash_algo(const char *name)
+{
+	int algo = xdp2_hash_algo_from_name(name);
+
+	if (algo < 0) {
+		fprintf(stderr, "%s: unknown hash algorithm %s\n",
+			__progname, name);
+		exit(-1);
+	}
+
+	xdp2_hash_set_algo(algo);
+	parselite_hash_set_algo(algo);
 }
 
 static void set_imethod(const char *name)
@@ -299,6 +390,26 @@ static void set_core(const char *name)
 	exit(-1);
 }
 
+/* Write the edge profile of the instrumented parsers (see xdp2/pgo.h) */
+static void write_profile(void)
+{
+	int ret;
+
+	if (!profile)
+		return;
+
+	if (!xdp2_pgo_num_edges())
+		fprintf(stderr, "%s: no instrumented parser, profile `%s' "
+			"is empty\n", __progname, profile);
+
+	ret = xdp2_pgo_write_file(profile);
+	if (ret) {
+		fprintf(stderr, "%s: write profile `%s' failed: %s\n",
+			__progname, profile, strerror(-ret));
+		exit(-1);
+	}
+}
+
 static void show_help(void)
 {
 	fprintf(stderr,
@@ -307,10 +418,19 @@ static void show_help(void)
 		"-h      Show this help\n"
 		"-N      Suppress the actual parser call.\n"
 		"-H      Compute/print metadata hashes.\n"
+		"-A ALGO Hash algorithm for metadata hashes: siphash "
+		"(default),\n"
+		"        crc32c, xxh3, or toeplitz\n"
 		"-v      show computation cost\n"
 		"-d      enable debug messages\n"
 		"-n N    Repeat each input packet a total of N times "
 		"(default 1)\n"
+		"-P FILE Write the parse graph edge profile to FILE. "
+		"Needs a core\n"
+		"        built with xdp2-compiler --pgo-instrument\n"
+		"-b N    Parse packets in bursts of N packets (default 1, "
+		"maximum %u).\n"
+		"        Only supported by cores with a burst mode\n"
 		"-i NAME[,ARGS]\n"
 		"        Use input method NAME; ARGS is an optional string "
 		"which is\n"
@@ -346,24 +466,28 @@ static void show_help(void)
 		"                -o help,%s\n"
 		"        For `list' and `help', does not start after "
 		"printing.\n",
-		__progname, imethods[0]->name, omethods[0]->name,
+		__progname, XDP2_PARSE_BURST_MAX, imethods[0]->name, omethods[0]->name,
 		cores[0]->name);
 }
 
 static void usage(char *progname)
 {
-	fprintf(stderr, "Usage: %s [-NHvd] [-n <number>] [-i <type>[,<arg>]] "
+	fprintf(stderr, "Usage: %s [-NHvd] [-A <algo>] [-n <number>] "
+		"[-b <number>] [-P <file>] [-i <type>[,<arg>]] "
 		"[-o <type>[,<arg>]] [-c <core>]\n", progname);
 
 	exit(-1);
 }
 
-#define ARGS "n:NHi:o:c:hvd"
+#define ARGS "n:b:NHA:P:i:o:c:hvd"
 
 static struct option long_options[] = {
 	{ "number", required_argument, 0, 'n' },
+	{ "burst", required_argument, 0, 'b' },
 	{ "nocore", no_argument, 0, 'N' },
 	{ "hash", no_argument, 0, 'H' },
+	{ "hash-algo", required_argument, 0, 'A' },
+	{ "profile", required_argument, 0, 'P' },
 	{ "input", required_argument, 0, 'i' },
 	{ "output", required_argument, 0, 'o' },
 	{ "core", required_argument, 0, 'c' },
@@ -383,12 +507,21 @@ static void handleargs(int argc, char **argv)
 		case 'n':
 			set_repeat(optarg);
 			break;
+		case 'b':
+			set_burst(optarg);
+			break;
 		case 'N':
 			coreflags |= CORE_F_NOCORE;
 			break;
 		case 'H':
 			coreflags |= CORE_F_HASH;
 			break;
+		case 'A':
+			set_hash_algo(optarg);
+			break;
+		case 'P':
+			profile = optarg;
+			break;
 		case 'v':
 			coreflags |= CORE_F_VERBOSE;
 			break;
@@ -422,6 +555,44 @@ int main(int argc, char **argv)
 
 	handleargs(argc, argv);
 
+	if (burst > 1) {
+		unsigned int n;
+
+		if (!core) {
+			fprintf(stderr, "%s: no computation core specified "
+				"(use -h for help)\n", __progname);
+			exit(-1);
+		}
+
+		burstdata = malloc(burst * MAXPKT);
+		if (!burstdata) {
+			fprintf(stderr, "%s: burst buffer allocation "
+				"failed\n", __progname);
+			exit(-1);
+		}
+
+		while ((n = readburst())) {
+			int i;
+
+			for (i = repeat; i > 0; i--)
+				processburst(n);
+
+			j += n;
+		}
+
+		avg = j ? (_time / (j * repeat)) : 0;
+		if (coreflags & CORE_F_VERBOSE)
+			printf("Total avg %lld ns/packet %lld Mpps "
+			       "(burst %d)\n", avg, avg ? 1000 / avg : 0,
+			       burst);
+
+		free(burstdata);
+
+		write_profile();
+
+		return 0;
+	}
+
 	while (readpkt()) {
 		int i;
 
@@ -445,5 +616,7 @@ int main(int argc, char **argv)
 		printf("Total avg %lld ns/packet %lld Mpps\n", avg,
 			avg ? 1000 / avg : 0);
 
+	write_profile();
+
 	return 0;
 }
@@ -57,6 +57,17 @@ $basedir/test_parser -i fuzz -c xdp2 -o text < $basedir/test-in.fuzz | \
 	grep -v Dumping | diff -u $basedir/test-out-xdp2.fuzz -
 
 echo "running xdp2 optimized parser basic validation tests"
+#xdp2 iterative code generation must parse the same as per node functions
+if $basedir/test_parser -c list | grep -q xdp2iter_notcpopts; then
+	for input in raw,test-in.raw pcap,test-in.pcap tcpdump,test-in.tcpdump; do
+		$basedir/test_parser -i ${input%%,*},$basedir/${input#*,} \
+			-c xdp2opt_notcpopts -o text > opt.out
+		$basedir/test_parser -i ${input%%,*},$basedir/${input#*,} \
+			-c xdp2iter_notcpopts -o text > iter.out
+		diff -u opt.out iter.out
+	done
+	rm -f opt.out iter.out
+fi
 
 arch=$(uname -m)
 if [[ "$arch" != *"riscv"* ]]; then
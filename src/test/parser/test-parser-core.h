@@ -56,6 +56,11 @@
  * the packet length, the OUT it should put the results into, and some
  * flag bits.
  *
+ * process_burst is optional. When set it is called to process a burst of
+ * packets in one call (see the -b option). It is passed the cookie from
+ * init, arrays of buffer pointers, packet lengths, OUTs, and error strings
+ * for each packet, the number of packets in the burst, and some flag bits.
+ *
  * done is called to clean up before exiting. This is not, strictly,
  * necessary, since exiting cleans up most things. This exists both
  * in case there is something (like a temporary file in the
@@ -74,6 +79,10 @@ struct test_parser_core {
 #define CORE_F_VERBOSE   0x4
 #define CORE_F_DEBUG	 0x8
 	void (*done)(void *pv);
+	void (*process_burst)(void *pv, void **data, size_t *lens,
+			      struct test_parser_out *outs,
+			      const char **errs, unsigned int num,
+			      unsigned int flags, long long *ptr);
 };
 
 #define CORE_DECL(name)						\
@@ -85,6 +94,16 @@ struct test_parser_core {
 		&core_##name##_done,				\
 	};
 
+#define CORE_DECL_BURST(name)					\
+	struct test_parser_core test_parser_core_##name = {	\
+		#name,						\
+		&core_##name##_help,				\
+		&core_##name##_init,				\
+		&core_##name##_process,				\
+		&core_##name##_done,				\
+		&core_##name##_process_burst,			\
+	};
+
 extern struct test_parser_core *cores[];
 
 #endif
@@ -0,0 +1,422 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/* Test and benchmark for UET PDC and Falcon connection lookup
+ *
+ * A fabric endpoint is filled with PDCs (64K by default), each PDC is
+ * looked up by its initiator tuple and by its remote FA and PDCID through
+ * the hash tables and the result is checked, then half the PDCs are
+ * closed and lookups are checked again. The same is done for Falcon
+ * connections. Then hashed lookup is benchmarked against a scan of the
+ * allocated PDCs (-b to only run the benchmark)
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "falcon/protocol.h"
+#include "uet/protocol.h"
+#include "xdp2/utility.h"
+
+bool use_colors, debug_colors_feps, debug_colors_instances;
+
+static unsigned long errors;
+static bool verbose;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Lookup tuple for PDC number i. Four PDCs share each remote FA and are
+ * distinguished by PDC type and traffic class, and by remote PDCID
+ */
+static struct in_addr pdc_remote_fa(unsigned int i)
+{
+	struct in_addr addr = { .s_addr = htonl(0x0a000000 + (i >> 2)) };
+
+	return addr;
+}
+
+#define PDC_PORT	htons(4793)
+#define PDC_TYPE(I)	((I) & 1 ? UET_PDC_TYPE_ROD : UET_PDC_TYPE_RUD)
+#define PDC_TC(I)	(((I) >> 1) & 1)
+#define PDC_RPDCID(I)	htons(((I) & 3) + 1)
+
+/* Reference lookup by scanning the allocated PDCs */
+static struct uet_pdc *scan_initiator_request(struct uet_fep *fep,
+					      struct in_addr dest, __be16 port,
+					      enum uet_pdc_type pdc_type,
+					      __u8 traffic_class)
+{
+	struct uet_pdc *pdc;
+	unsigned int i;
+
+	xdp2_id_alloc_foreach(&fep->pdc_ids, i) {
+		pdc = &fep->pdcs[i];
+
+		if (pdc->initiator && pdc->remote_fa.s_addr == dest.s_addr &&
+		    pdc->remote_port == port && pdc->type == pdc_type &&
+		    pdc->traffic_class == traffic_class)
+			return pdc;
+	}
+
+	return NULL;
+}
+
+static struct uet_fep *create_fep(unsigned int max_pdcs)
+{
+	struct uet_fep *fep;
+
+	fep = calloc(1, sizeof(*fep) + max_pdcs * sizeof(fep->pdcs[0]));
+	if (!fep)
+		return NULL;
+
+	fep->max_pdcs = max_pdcs;
+	if (xdp2_id_alloc_init(&fep->pdc_ids, max_pdcs)) {
+		free(fep);
+		return NULL;
+	}
+
+	if (uet_fep_pdc_hash_init(fep)) {
+		xdp2_id_alloc_fini(&fep->pdc_ids);
+		free(fep);
+		return NULL;
+	}
+
+	return fep;
+}
+
+static void destroy_fep(struct uet_fep *fep)
+{
+	uet_fep_pdc_hash_fini(fep);
+	xdp2_id_alloc_fini(&fep->pdc_ids);
+	free(fep);
+}
+
+static struct uet_pdc *open_pdc(struct uet_fep *fep, unsigned int i)
+{
+	struct in_addr local_fa = { .s_addr = htonl(0x0a800001) };
+	struct uet_pdc *pdc;
+
+	pdc = uet_pdc_open(fep, local_fa, pdc_remote_fa(i), PDC_PORT,
+			   PDC_TYPE(i), PDC_TC(i), true, 0);
+	if (!pdc)
+		return NULL;
+
+	/* Target PDCID is learned after the PDC is opened */
+	uet_pdc_set_remote_pdcid(pdc, PDC_RPDCID(i));
+
+	return pdc;
+}
+
+static void check_pdc(struct uet_fep *fep, unsigned int i,
+		      struct uet_pdc *expect)
+{
+	struct in_addr local_fa = { .s_addr = htonl(0x0a800001) };
+	struct uet_pdc *pdc;
+
+	pdc = uet_pdc_get_pdc_from_initiator_request(fep, local_fa,
+			pdc_remote_fa(i), PDC_PORT, PDC_TYPE(i), PDC_TC(i));
+	if (pdc != expect) {
+		if (verbose)
+			fprintf(stderr, "PDC %u initiator lookup mismatch\n",
+				i);
+		errors++;
+	}
+
+	pdc = uet_get_from_syn(fep, pdc_remote_fa(i), PDC_RPDCID(i));
+	if (pdc != expect) {
+		if (verbose)
+			fprintf(stderr, "PDC %u SYN lookup mismatch\n", i);
+		errors++;
+	}
+}
+
+static void test_pdcs(unsigned int num_pdcs)
+{
+	struct uet_pdc **pdcs;
+	struct uet_fep *fep;
+	struct uet_pdc *pdc;
+	unsigned int i;
+	double start;
+
+	fep = create_fep(num_pdcs);
+	pdcs = calloc(num_pdcs, sizeof(*pdcs));
+	if (!fep || !pdcs) {
+		fprintf(stderr, "Allocation failed\n");
+		exit(-1);
+	}
+
+	start = now();
+	for (i = 0; i < num_pdcs; i++) {
+		pdcs[i] = open_pdc(fep, i);
+		if (!pdcs[i]) {
+			fprintf(stderr, "Open PDC %u failed\n", i);
+			exit(-1);
+		}
+	}
+	printf("Opened %u PDCs in %.2f msecs\n", num_pdcs,
+	       (now() - start) * 1e3);
+
+	if (open_pdc(fep, num_pdcs)) {
+		fprintf(stderr, "Open PDC succeeded with all PDCs in use\n");
+		errors++;
+	}
+
+	for (i = 0; i < num_pdcs; i++)
+		check_pdc(fep, i, pdcs[i]);
+
+	/* Close odd PDCs, they must not be found any more */
+	for (i = 1; i < num_pdcs; i += 2)
+		uet_pdc_close(pdcs[i]);
+
+	for (i = 0; i < num_pdcs; i++)
+		check_pdc(fep, i, i & 1 ? NULL : pdcs[i]);
+
+	/* Reopen them, they take the free slots */
+	for (i = 1; i < num_pdcs; i += 2) {
+		pdc = open_pdc(fep, i);
+		if (pdc != pdcs[i]) {
+			if (verbose)
+				fprintf(stderr, "PDC %u reopen mismatch\n", i);
+			errors++;
+		}
+	}
+
+	for (i = 0; i < num_pdcs; i++)
+		check_pdc(fep, i, pdcs[i]);
+
+	free(pdcs);
+	destroy_fep(fep);
+}
+
+static struct falcon_instance *create_instance(unsigned int max_conns)
+{
+	struct falcon_instance *instance;
+
+	instance = calloc(1, sizeof(*instance) +
+			     max_conns * sizeof(instance->conns[0]));
+	if (!instance)
+		return NULL;
+
+	instance->max_conns = max_conns;
+	if (falcon_instance_conn_hash_init(instance)) {
+		free(instance);
+		return NULL;
+	}
+
+	return instance;
+}
+
+static void check_conn(struct falcon_instance *instance,
+		       struct falcon_conn *conn, unsigned int i,
+		       struct falcon_conn *expect)
+{
+	if (falcon_lookup_conn(instance, conn->remote, conn->dport,
+			       conn->protocol_type) != expect) {
+		if (verbose)
+			fprintf(stderr, "Conn %u remote lookup mismatch\n", i);
+		errors++;
+	}
+
+	if (falcon_lookup_conn_by_remote_cid(instance, conn->remote,
+					     i + 1) != expect) {
+		if (verbose)
+			fprintf(stderr, "Conn %u CID lookup mismatch\n", i);
+		errors++;
+	}
+}
+
+static void test_conns(unsigned int num_conns)
+{
+	struct falcon_instance *instance;
+	struct falcon_conn *conns;
+	unsigned int i;
+
+	instance = create_instance(num_conns);
+	conns = calloc(num_conns, sizeof(*conns));
+	if (!instance || !conns) {
+		fprintf(stderr, "Allocation failed\n");
+		exit(-1);
+	}
+
+	for (i = 0; i < num_conns; i++) {
+		conns[i].local_cid = i;
+		conns[i].remote = pdc_remote_fa(i);
+		conns[i].dport = 4793 + (i & 3);
+		conns[i].protocol_type = FALCON_PROTO_TYPE_RDMA;
+		conns[i].instance = instance;
+		falcon_conn_hash_insert(instance, &conns[i]);
+		falcon_set_remote_cid(instance, i, i + 1);
+	}
+
+	for (i = 0; i < num_conns; i++)
+		check_conn(instance, &conns[i], i, &conns[i]);
+
+	for (i = 1; i < num_conns; i += 2)
+		falcon_conn_hash_remove(instance, &conns[i]);
+
+	for (i = 0; i < num_conns; i++) {
+		check_conn(instance, &conns[i], i,
+			   i & 1 ? NULL : &conns[i]);
+		if (instance->conns[i] != (i & 1 ? NULL : &conns[i])) {
+			if (verbose)
+				fprintf(stderr, "Conn %u cid mismatch\n", i);
+			errors++;
+		}
+	}
+
+	falcon_instance_conn_hash_fini(instance);
+	free(instance);
+	free(conns);
+}
+
+static void bench(unsigned int num_pdcs, unsigned int count,
+		  unsigned int scan_count)
+{
+	struct in_addr local_fa = { .s_addr = htonl(0x0a800001) };
+	struct uet_pdc *pdc;
+	struct uet_fep *fep;
+	unsigned int i, j;
+	double start, secs;
+	unsigned long found = 0;
+
+	fep = create_fep(num_pdcs);
+	if (!fep) {
+		fprintf(stderr, "Allocation failed\n");
+		exit(-1);
+	}
+
+	for (i = 0; i < num_pdcs; i++)
+		open_pdc(fep, i);
+
+	/* Stride through PDCs with a large odd step so that successive
+	 * lookups don't hit the same cache lines
+	 */
+	start = now();
+	for (i = 0, j = 0; i < count; i++, j = (j + 40503) % num_pdcs) {
+		pdc = uet_pdc_get_pdc_from_initiator_request(fep, local_fa,
+				pdc_remote_fa(j), PDC_PORT, PDC_TYPE(j),
+				PDC_TC(j));
+		found += !!pdc;
+	}
+	secs = now() - start;
+	printf("hash initiator lookup: %8.1f nsecs/lookup\n",
+	       secs * 1e9 / count);
+
+	start = now();
+	for (i = 0, j = 0; i < count; i++, j = (j + 40503) % num_pdcs) {
+		pdc = uet_get_from_syn(fep, pdc_remote_fa(j), PDC_RPDCID(j));
+		found += !!pdc;
+	}
+	secs = now() - start;
+	printf("hash SYN lookup:       %8.1f nsecs/lookup\n",
+	       secs * 1e9 / count);
+
+	start = now();
+	for (i = 0, j = 0; i < scan_count;
+	     i++, j = (j + 40503) % num_pdcs) {
+		pdc = scan_initiator_request(fep, pdc_remote_fa(j), PDC_PORT,
+					     PDC_TYPE(j), PDC_TC(j));
+		found += !!pdc;
+	}
+	secs = now() - start;
+	printf("scan initiator lookup: %8.1f nsecs/lookup\n",
+	       secs * 1e9 / scan_count);
+
+	if (found != 2UL * count + scan_count) {
+		fprintf(stderr, "Benchmark lookups missed\n");
+		errors++;
+	}
+
+	destroy_fep(fep);
+}
+
+#define ARGS "n:c:s:bv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-n <num_pdcs>] [-c <count>] ", name);
+	fprintf(stderr, "[-s <scan_count>] [-b] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int num_pdcs = 65535, count = 10000000, scan_count = 1000;
+	bool bench_only = false;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'n':
+			num_pdcs = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			scan_count = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			bench_only = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	/* PDCIDs are sixteen bits and zero is reserved */
+	if (!num_pdcs || num_pdcs > 65535) {
+		fprintf(stderr, "Number of PDCs must be 1 to 65535\n");
+		exit(-1);
+	}
+
+	if (!bench_only) {
+		test_pdcs(num_pdcs);
+		test_conns(num_pdcs);
+		printf("Tests done: %lu errors\n", errors);
+	}
+
+	if (count && scan_count)
+		bench(num_pdcs, count, scan_count);
+
+	return errors ? -1 : 0;
+}
@@ -0,0 +1,374 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Test for the packet I/O layer
+ *
+ * Packets with a sequence number and a payload pattern are sent on one
+ * device with the packet actions in pkt_action.h and received on another
+ * (or the same) device, and the received packets are checked. With the
+ * loop backend no interface is needed. With the tpacket and xdp backends
+ * packets can be sent and received on the loopback interface or across a
+ * veth pair, for instance:
+ *
+ *	ip link add vtest0 type veth peer name vtest1
+ *	ip link set vtest0 up; ip link set vtest1 up
+ *	test_pkt_io -b xdp -i vtest0 -o vtest1
+ *
+ * At the end all the pbufs must have been freed
+ */
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <linux/if_ether.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/pkt_action.h"
+#include "xdp2/pkt_io.h"
+#include "xdp2/pvbuf.h"
+#include "xdp2/utility.h"
+
+#define NUM_PBUFS 8192
+
+static unsigned int count = 10000;
+static unsigned int pkt_len = 128;
+static unsigned short ethertype = 0x88b5;
+static bool use_pvbufs;
+static bool verbose;
+
+static unsigned char *seen;
+static unsigned long received, errors, dups, others;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_pkt(unsigned char *data, unsigned int seq)
+{
+	struct ethhdr *eth = (struct ethhdr *)data;
+	unsigned int i;
+
+	memset(eth->h_dest, 0xff, ETH_ALEN);
+	memcpy(eth->h_source, "\x02\x00\x00\x00\x00\x01", ETH_ALEN);
+	eth->h_proto = htons(ethertype);
+
+	memcpy(&data[ETH_HLEN], &seq, sizeof(seq));
+	for (i = ETH_HLEN + sizeof(seq); i < pkt_len; i++)
+		data[i] = seq + i;
+}
+
+/* Make a packet in a pbuf, or in a pvbuf that holds a pbuf */
+static bool make_pkt(struct xdp2_pkt_io_pkt *pkt, unsigned int seq)
+{
+	struct xdp2_pvbuf *pvbuf;
+	xdp2_paddr_t paddr;
+	void *data;
+
+	paddr = xdp2_pbuf_alloc(pkt_len, &data);
+	if (paddr == XDP2_PADDR_NULL)
+		return false;
+
+	fill_pkt(data, seq);
+
+	pkt->len = pkt_len;
+	pkt->dev = NULL;
+
+	if (!use_pvbufs) {
+		pkt->paddr = paddr;
+		pkt->data = data;
+		return true;
+	}
+
+	pkt->paddr = xdp2_pvbuf_alloc_empty(0, &pvbuf);
+	if (pkt->paddr == XDP2_PADDR_NULL) {
+		xdp2_pbuf_free(paddr);
+		return false;
+	}
+	pkt->data = NULL;
+
+	if (!__xdp2_pvbuf_append_paddr(&xdp2_pvbuf_global_mgr, pkt->paddr,
+				       paddr, 0, pkt_len, false)) {
+		xdp2_pbuf_free(paddr);
+		xdp2_pvbuf_free(pkt->paddr);
+		return false;
+	}
+
+	return true;
+}
+
+static void check_pkt(struct xdp2_pkt_io_pkt *pkt)
+{
+	unsigned char *data = pkt->data, buf[1500];
+	struct ethhdr *eth;
+	unsigned int seq, i;
+
+	if (!data) {
+		/* A pvbuf (from the loop backend), linearize it */
+		if (!__xdp2_pkt_io_copy_pkt(&xdp2_pvbuf_global_mgr, pkt, buf,
+					    sizeof(buf))) {
+			errors++;
+			return;
+		}
+		data = buf;
+	}
+	eth = (struct ethhdr *)data;
+
+	if (pkt->len < ETH_HLEN || eth->h_proto != htons(ethertype)) {
+		/* Some other traffic on the interface */
+		others++;
+		return;
+	}
+
+	if (pkt->len != pkt_len) {
+		if (verbose)
+			fprintf(stderr, "Bad length %lu\n", pkt->len);
+		errors++;
+		return;
+	}
+
+	memcpy(&seq, &data[ETH_HLEN], sizeof(seq));
+	if (seq >= count) {
+		errors++;
+		return;
+	}
+
+	for (i = ETH_HLEN + sizeof(seq); i < pkt_len; i++) {
+		if (data[i] != (unsigned char)(seq + i)) {
+			if (verbose)
+				fprintf(stderr, "Bad data in packet %u "
+						"offset %u\n", seq, i);
+			errors++;
+			return;
+		}
+	}
+
+	if (seen[seq]) {
+		dups++;
+		return;
+	}
+
+	seen[seq] = 1;
+	received++;
+}
+
+static void receive(struct xdp2_pkt_io_dev *dev, int timeout)
+{
+	struct xdp2_pkt_io_pkt pkts[XDP2_PKT_IO_BURST];
+	unsigned int i, n;
+
+	if (xdp2_pkt_io_poll(dev, timeout) <= 0)
+		return;
+
+	while ((n = xdp2_pkt_io_recv_burst(dev, pkts,
+					   XDP2_PKT_IO_BURST))) {
+		for (i = 0; i < n; i++) {
+			check_pkt(&pkts[i]);
+			xdp2_pkt_drop(&pkts[i]);
+		}
+		xdp2_pkt_io_release_burst(dev, pkts, n);
+	}
+}
+
+#define ARGS "b:i:o:c:l:f:F:e:zdpv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-b <backend>] [-i <tx_ifname>] ", name);
+	fprintf(stderr, "[-o <rx_ifname>] [-c <count>] [-l <length>] ");
+	fprintf(stderr, "[-f <frame_size>] [-F <num_frames>] ");
+	fprintf(stderr, "[-e <ethertype>] [-z] [-d] [-p] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct xdp2_pvbuf_init_allocator pvbuf_allocs = {
+		.obj[0].num_pvbufs = NUM_PBUFS,
+	};
+	struct xdp2_pbuf_init_allocator pbuf_allocs = {};
+	struct xdp2_pkt_io_config config = {};
+	struct xdp2_pkt_io_dev *tx_dev, *rx_dev;
+	struct xdp2_pbuf_allocator_entry *entry;
+	const char *rx_ifname = NULL;
+	struct xdp2_obj_allocator *allocator;
+	struct xdp2_pkt_io_pkt pkt;
+	const char *backend = "loop";
+	unsigned int seq, btag;
+	double start, secs;
+	int c, ret = 0;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'b':
+			backend = optarg;
+			break;
+		case 'i':
+			config.ifname = optarg;
+			break;
+		case 'o':
+			rx_ifname = optarg;
+			break;
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			pkt_len = strtoul(optarg, NULL, 10);
+			break;
+		case 'f':
+			config.frame_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'F':
+			config.num_frames = strtoul(optarg, NULL, 10);
+			break;
+		case 'e':
+			ethertype = strtoul(optarg, NULL, 0);
+			break;
+		case 'z':
+			config.zero_copy = true;
+			break;
+		case 'd':
+			config.drv_mode = true;
+			break;
+		case 'p':
+			use_pvbufs = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!config.frame_size)
+		config.frame_size = XDP2_PKT_IO_DEF_FRAME_SIZE;
+	if (!config.num_frames)
+		config.num_frames = 1024;
+	config.protocol = ethertype;
+
+	if (pkt_len < ETH_HLEN + sizeof(seq) || pkt_len > 1500) {
+		fprintf(stderr, "Length must be between %lu and 1500\n",
+			ETH_HLEN + sizeof(seq));
+		exit(-1);
+	}
+
+	/* Packets are allocated from the pbufs of the frame size, whose
+	 * memory is page aligned so it can be used as an AF_XDP UMEM
+	 */
+	btag = xdp2_pbuf_size_to_buffer_tag(config.frame_size);
+	pbuf_allocs.obj[btag].num_objs = NUM_PBUFS;
+	pbuf_allocs.obj[btag].base = xdp2_pkt_io_alloc_pbuf_base(NUM_PBUFS,
+							config.frame_size);
+	if (!pbuf_allocs.obj[btag].base)
+		exit(-1);
+
+	if (xdp2_pvbuf_init(&pbuf_allocs, &pvbuf_allocs, false, false, NULL,
+			    NULL)) {
+		fprintf(stderr, "pvbuf init failed\n");
+		exit(-1);
+	}
+
+	seen = calloc(count, 1);
+	if (!seen)
+		exit(-1);
+
+	tx_dev = xdp2_pkt_io_open(backend, &config, 0);
+	if (!tx_dev)
+		exit(-1);
+
+	rx_dev = tx_dev;
+	if (rx_ifname) {
+		config.ifname = rx_ifname;
+		rx_dev = xdp2_pkt_io_open(backend, &config, 1);
+		if (!rx_dev)
+			exit(-1);
+	}
+
+	start = now();
+
+	for (seq = 0; seq < count; seq++) {
+		if (!make_pkt(&pkt, seq)) {
+			/* Out of pbufs, flush and receive to free some */
+			xdp2_pkt_io_flush(tx_dev);
+			receive(rx_dev, 1);
+			if (!make_pkt(&pkt, seq)) {
+				fprintf(stderr, "Out of packet buffers\n");
+				exit(-1);
+			}
+		}
+
+		xdp2_pkt_send(&pkt, tx_dev->port);
+
+		if (!tx_dev->num_tx_pending)
+			receive(rx_dev, 0);
+	}
+
+	xdp2_pkt_io_flush(tx_dev);
+
+	while (received < count && now() - start < count / 10000.0 + 1)
+		receive(rx_dev, 10);
+
+	secs = now() - start;
+
+	printf("%s: sent %lu, received %lu, lost %lu, dups %lu, errors %lu, "
+	       "other %lu, %.3f Mpps\n", backend, tx_dev->stats.tx_packets,
+	       received, count - received, dups, errors, others,
+	       received / secs / 1e6);
+
+	if (verbose) {
+		xdp2_pkt_io_show_dev(tx_dev, NULL);
+		if (rx_dev != tx_dev)
+			xdp2_pkt_io_show_dev(rx_dev, NULL);
+	}
+
+	if (rx_dev != tx_dev)
+		xdp2_pkt_io_close(rx_dev);
+	xdp2_pkt_io_close(tx_dev);
+
+	if (errors || dups || received != count)
+		ret = -1;
+
+	/* All packets and frames have been freed */
+	entry = &xdp2_pvbuf_global_mgr.pbuf_allocator_table[btag];
+	allocator = entry->pallocator->allocator;
+	if (allocator->alloc_free_list.num_free != allocator->max_objs) {
+		fprintf(stderr, "Leaked %u pbufs\n",
+			allocator->max_objs -
+				allocator->alloc_free_list.num_free);
+		ret = -1;
+	}
+
+	return ret;
+}
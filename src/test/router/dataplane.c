@@ -73,13 +73,16 @@ static int handler_okay(const void *hdr, size_t hdr_len, void *metadata,
 {
 	struct router_metadata *frame = _frame;
 	struct ethhdr *eth = (struct ethhdr *)
-				(ctrl->pkt.packet + frame->ether_offset);
+				(ctrl->pkt.start + frame->ether_offset);
+	struct iphdr *iph = (struct iphdr *)
+				(ctrl->pkt.start + frame->ip_offset);
 	const struct next_hop *nh;
 
 	nh = router_lpm_table_lookup(frame);
 
 	if (nh) {
 		memcpy(eth->h_dest, nh->edest, sizeof(eth->h_dest));
+		xdp2_checksum_ipv4_dec_ttl(iph);
 		xdp2_pkt_send(ctrl->pkt.packet, nh->port);
 		printf("HIT port %u\n", nh->port);
 		return XDP2_OKAY;
@@ -0,0 +1,458 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Test and benchmark for software RSS steering
+ *
+ * The metadata based NIC hash is checked against the verification vectors
+ * of the Microsoft RSS specification. Messages are steered singly and in
+ * bursts and checked to arrive on the queue selected by the indirection
+ * table in their original order, drops are checked to be returned and
+ * counted, and indirection table updates are checked. Then a producer
+ * thread hashes and steers packets to worker threads that each read one
+ * SPSC FIFO (-b to only run the benchmark)
+ */
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/fifo.h"
+#include "xdp2/parser_metadata.h"
+#include "xdp2/rss.h"
+#include "xdp2/utility.h"
+
+#define MAX_QUEUES 64
+#define FIFO_ENTS 1024
+
+/* Metadata with the common fields used for hashing */
+struct metadata {
+	XDP2_METADATA_addr_type;
+	XDP2_METADATA_ip_proto;
+	XDP2_METADATA_ports;
+	XDP2_METADATA_addrs;
+};
+
+static unsigned long errors;
+static bool verbose;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Verification vectors from the Microsoft RSS specification */
+static const struct {
+	int af;
+	const char *src, *dst;
+	__u16 sport, dport;
+	__u32 hash_addrs, hash_ports;
+} rss_vectors[] = {
+	{ AF_INET, "66.9.149.187", "161.142.100.80", 2794, 1766,
+	  0x323e8fc2, 0x51ccc178 },
+	{ AF_INET, "199.92.111.2", "65.69.140.83", 14230, 4739,
+	  0xd718262a, 0xc626b0ea },
+	{ AF_INET6, "3ffe:2501:200:1fff::7", "3ffe:2501:200:3::1",
+	  2794, 1766, 0x2cc18cd5, 0x40207d3d },
+	{ AF_INET6, "3ffe:501:8::260:97ff:fe40:efab", "ff02::1",
+	  14230, 4739, 0x0f0c461c, 0xdde51bbf },
+};
+
+static void test_nic_hash(struct xdp2_rss *rss)
+{
+	struct metadata md;
+	unsigned int i;
+	__u32 hash;
+
+	for (i = 0; i < ARRAY_SIZE(rss_vectors); i++) {
+		memset(&md, 0, sizeof(md));
+
+		if (rss_vectors[i].af == AF_INET) {
+			md.addr_type = XDP2_ADDR_TYPE_IPV4;
+			inet_pton(AF_INET, rss_vectors[i].src,
+				  &md.addrs.v4.saddr);
+			inet_pton(AF_INET, rss_vectors[i].dst,
+				  &md.addrs.v4.daddr);
+		} else {
+			md.addr_type = XDP2_ADDR_TYPE_IPV6;
+			inet_pton(AF_INET6, rss_vectors[i].src,
+				  &md.addrs.v6.saddr);
+			inet_pton(AF_INET6, rss_vectors[i].dst,
+				  &md.addrs.v6.daddr);
+		}
+		md.src_port = htons(rss_vectors[i].sport);
+		md.dst_port = htons(rss_vectors[i].dport);
+
+		md.ip_proto = IPPROTO_TCP;
+		hash = XDP2_RSS_COMPUTE_NIC_HASH(rss, &md);
+		if (hash != rss_vectors[i].hash_ports) {
+			printf("NIC hash vector %u TCP: got %08x expected "
+			       "%08x\n", i, hash, rss_vectors[i].hash_ports);
+			errors++;
+		}
+
+		md.ip_proto = IPPROTO_ICMP;
+		hash = XDP2_RSS_COMPUTE_NIC_HASH(rss, &md);
+		if (hash != rss_vectors[i].hash_addrs) {
+			printf("NIC hash vector %u addresses: got %08x "
+			       "expected %08x\n", i, hash,
+			       rss_vectors[i].hash_addrs);
+			errors++;
+		}
+	}
+}
+
+static struct xdp2_fifo *create_fifos(struct xdp2_fifo **fifos,
+				      unsigned int num, unsigned int ents,
+				      enum xdp2_fifo_mode mode)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		fifos[i] = xdp2_fifo_create_mode(ents, ents / 2, NULL, mode);
+		XDP2_ASSERT(fifos[i], "Create FIFO failed");
+	}
+
+	return fifos[0];
+}
+
+static void free_fifos(struct xdp2_fifo **fifos, unsigned int num)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++)
+		free(fifos[i]);
+}
+
+/* Dequeue all the messages and check that each one is on the queue for
+ * its hash and that each queue is in order. Message values are indexes in
+ * hashes
+ */
+static unsigned int check_queues(struct xdp2_rss *rss,
+				 struct xdp2_fifo **fifos,
+				 unsigned int num_queues,
+				 const __u32 *hashes)
+{
+	unsigned int i, total = 0;
+	__u64 message, last;
+
+	for (i = 0; i < num_queues; i++) {
+		last = -1ULL;
+		while (xdp2_fifo_dequeue(fifos[i], &message, false)) {
+			if (xdp2_rss_hash_to_queue(rss, hashes[message]) !=
+			    i) {
+				if (verbose)
+					printf("Message %llu on queue %u\n",
+					       (unsigned long long)message, i);
+				errors++;
+			}
+			if (last != -1ULL && message <= last) {
+				if (verbose)
+					printf("Queue %u out of order\n", i);
+				errors++;
+			}
+			last = message;
+			total++;
+		}
+	}
+
+	return total;
+}
+
+static void test_steer(unsigned int num_queues, unsigned int count)
+{
+	struct xdp2_fifo *fifos[MAX_QUEUES];
+	__u64 messages[FIFO_ENTS], dropped[FIFO_ENTS];
+	__u32 hashes[FIFO_ENTS];
+	__u16 indir[XDP2_RSS_DEFAULT_INDIR_SIZE];
+	unsigned int i, n, total;
+	struct xdp2_rss *rss;
+	__u64 drops = 0;
+
+	create_fifos(fifos, num_queues, FIFO_ENTS, XDP2_FIFO_MODE_SPSC);
+
+	rss = xdp2_rss_create(fifos, num_queues, 0, NULL);
+	XDP2_ASSERT(rss, "Create RSS failed");
+
+	for (i = 0; i < FIFO_ENTS; i++) {
+		hashes[i] = random();
+		messages[i] = i;
+	}
+
+	/* One at a time */
+	for (i = 0; i < FIFO_ENTS; i++)
+		if (!xdp2_rss_steer(rss, hashes[i], messages[i], false))
+			errors++;
+	if (check_queues(rss, fifos, num_queues, hashes) != FIFO_ENTS)
+		errors++;
+
+	/* Bursts of random size */
+	for (i = 0; i < count; i++) {
+		n = 1 + random() % FIFO_ENTS;
+		if (xdp2_rss_steer_burst(rss, hashes, messages, n, false,
+					 NULL) != n)
+			errors++;
+		if (check_queues(rss, fifos, num_queues, hashes) != n)
+			errors++;
+	}
+
+	/* Move everything to the first two queues */
+	if (num_queues >= 2) {
+		xdp2_rss_set_indir_equal(rss, 2);
+		xdp2_rss_steer_burst(rss, hashes, messages, FIFO_ENTS, false,
+				     NULL);
+		for (i = 2; i < num_queues; i++)
+			if (!xdp2_fifo_is_empty(fifos[i]))
+				errors++;
+		check_queues(rss, fifos, num_queues, hashes);
+	}
+
+	/* Everything to the last queue, two bursts overflow it */
+	for (i = 0; i < ARRAY_SIZE(indir); i++)
+		indir[i] = num_queues - 1;
+	if (xdp2_rss_set_indir(rss, indir))
+		errors++;
+	n = xdp2_rss_steer_burst(rss, hashes, messages, FIFO_ENTS, false,
+				 dropped);
+	n += xdp2_rss_steer_burst(rss, hashes, messages, FIFO_ENTS, false,
+				  dropped);
+	if (n != FIFO_ENTS || dropped[0] != 0 ||
+	    dropped[FIFO_ENTS - 1] != FIFO_ENTS - 1)
+		errors++;
+	total = check_queues(rss, fifos, num_queues, hashes);
+	if (total != FIFO_ENTS)
+		errors++;
+
+	for (i = 0; i < num_queues; i++)
+		drops += rss->stats[i].drops;
+	if (drops != FIFO_ENTS)
+		errors++;
+
+	indir[0] = num_queues;
+	if (xdp2_rss_set_indir(rss, indir) != -EINVAL ||
+	    xdp2_rss_set_indir_equal(rss, num_queues + 1) != -EINVAL)
+		errors++;
+
+	if (xdp2_rss_create(fifos, num_queues, 100, NULL))
+		errors++;
+
+	xdp2_rss_free(rss);
+	free_fifos(fifos, num_queues);
+}
+
+/* Benchmark: one producer thread steers packets to worker threads */
+
+static atomic_bool bench_done;
+static unsigned int bench_burst = 32;
+static pthread_cond_t bench_cond;
+
+struct worker {
+	pthread_t thread;
+	struct xdp2_fifo *fifo;
+	unsigned long received;
+};
+
+static void *worker_func(void *arg)
+{
+	struct worker *w = arg;
+	__u64 messages[64];
+	unsigned int n;
+
+	for (;;) {
+		n = xdp2_fifo_dequeue_burst(w->fifo, messages, 64, false);
+		if (n) {
+			w->received += n;
+			continue;
+		}
+		if (atomic_load(&bench_done) && xdp2_fifo_is_empty(w->fifo))
+			break;
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+static void bench(unsigned int num_queues, unsigned long count)
+{
+	struct xdp2_fifo *fifos[MAX_QUEUES];
+	struct worker workers[MAX_QUEUES];
+	__u64 messages[64], sent = 0;
+	unsigned long received = 0;
+	struct metadata *mds;
+	struct xdp2_rss *rss;
+	unsigned int i, j, n;
+	__u32 hashes[64];
+	double secs;
+
+	mds = calloc(4096, sizeof(*mds));
+	XDP2_ASSERT(mds, "Allocate metadata failed");
+
+	for (i = 0; i < 4096; i++) {
+		mds[i].addr_type = XDP2_ADDR_TYPE_IPV4;
+		mds[i].ip_proto = IPPROTO_TCP;
+		mds[i].addrs.v4.saddr = random();
+		mds[i].addrs.v4.daddr = random();
+		mds[i].ports = random();
+	}
+
+	create_fifos(fifos, num_queues, 4096, XDP2_FIFO_MODE_SPSC);
+
+	/* The producer blocks when a worker falls behind */
+	pthread_cond_init(&bench_cond, NULL);
+	for (i = 0; i < num_queues; i++)
+		xdp2_fifo_init_producer(fifos[i],
+					(XDP2_LOCKS_COND_T *)&bench_cond);
+
+	rss = xdp2_rss_create(fifos, num_queues, 0, NULL);
+	XDP2_ASSERT(rss, "Create RSS failed");
+
+	/* Hash cost alone */
+	secs = now();
+	for (n = 0, i = 0; i < count; i++)
+		n += XDP2_RSS_COMPUTE_NIC_HASH(rss, &mds[i & 4095]);
+	secs = now() - secs;
+	printf("NIC hash (IPv4 TCP): %.2f ns/pkt (%u)\n",
+	       secs / count * 1e9, n & 1);
+
+	atomic_store(&bench_done, false);
+	memset(workers, 0, sizeof(workers));
+	for (i = 0; i < num_queues; i++) {
+		workers[i].fifo = fifos[i];
+		pthread_create(&workers[i].thread, NULL, worker_func,
+			       &workers[i]);
+	}
+
+	secs = now();
+	for (i = 0; i < count; i += n) {
+		n = xdp2_min(bench_burst, count - i);
+		for (j = 0; j < n; j++) {
+			hashes[j] = XDP2_RSS_COMPUTE_NIC_HASH(rss,
+						&mds[(i + j) & 4095]);
+			messages[j] = i + j;
+		}
+		sent += xdp2_rss_steer_burst(rss, hashes, messages, n, true,
+					     NULL);
+	}
+	atomic_store(&bench_done, true);
+
+	for (i = 0; i < num_queues; i++) {
+		pthread_join(workers[i].thread, NULL);
+		received += workers[i].received;
+	}
+	secs = now() - secs;
+
+	if (received != sent || sent != count)
+		errors++;
+
+	printf("Steer %u queues burst %u: %.2f Mpps\n", num_queues,
+	       bench_burst, count / secs / 1e6);
+	if (verbose)
+		for (i = 0; i < num_queues; i++)
+			printf("\tqueue %u: %lu\n", i, workers[i].received);
+
+	xdp2_rss_free(rss);
+	free_fifos(fifos, num_queues);
+	free(mds);
+}
+
+#define ARGS "c:q:B:n:bv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-c <count>] [-q <queues>] ", name);
+	fprintf(stderr, "[-B <burst>] [-n <bench_count>] [-b] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long bench_count = 2000000;
+	unsigned int num_queues = 4;
+	bool bench_only = false;
+	unsigned int count = 100;
+	struct xdp2_fifo *fifo;
+	struct xdp2_rss *rss;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'q':
+			num_queues = strtoul(optarg, NULL, 10);
+			break;
+		case 'B':
+			bench_burst = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			bench_count = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			bench_only = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!num_queues || num_queues > MAX_QUEUES || !bench_burst ||
+	    bench_burst > 64)
+		usage(argv[0]);
+
+	if (!bench_only) {
+		fifo = xdp2_fifo_create(16, 8, NULL);
+		rss = xdp2_rss_create(&fifo, 1, 0, NULL);
+		XDP2_ASSERT(rss, "Create RSS failed");
+		test_nic_hash(rss);
+		xdp2_rss_free(rss);
+		free(fifo);
+
+		test_steer(1, count);
+		test_steer(num_queues, count);
+
+		printf("Tests done: %lu errors\n", errors);
+	}
+
+	if (bench_count)
+		bench(num_queues, bench_count);
+
+	return errors ? -1 : 0;
+}
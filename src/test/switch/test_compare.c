@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/* Test and benchmark for the switch compare functions
+ *
+ * The word at a time xdp2_compare_equal, xdp2_compare_tern, and
+ * xdp2_compare_prefix are checked against byte at a time reference
+ * compares for all key lengths up to 64 bytes with random keys, masks,
+ * and single bit differences. Then the compares are benchmarked against
+ * the reference for typical key lengths (-b to only run the benchmark)
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/switch.h"
+#include "xdp2/utility.h"
+
+#define MAX_LEN		64
+#define NUM_KEYS	1024
+
+static unsigned long errors;
+static bool verbose;
+
+static __u64 rand_state = 88172645463325252ULL;
+
+static __u64 xrand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+
+	return rand_state;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Byte at a time reference compares */
+static bool ref_equal(const __u8 *f1, const __u8 *f2, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (f1[i] != f2[i])
+			return false;
+
+	return true;
+}
+
+static bool ref_tern(const __u8 *f1, const __u8 *f2, const __u8 *mask,
+		     size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if ((f1[i] ^ f2[i]) & mask[i])
+			return false;
+
+	return true;
+}
+
+static bool ref_prefix(const __u8 *f1, const __u8 *f2, size_t prefix_len)
+{
+	size_t i;
+
+	for (i = 0; i < prefix_len; i++)
+		if ((f1[i / 8] ^ f2[i / 8]) & (0x80 >> (i % 8)))
+			return false;
+
+	return true;
+}
+
+static void check(const char *name, bool got, bool expect, size_t len)
+{
+	if (got == expect)
+		return;
+
+	if (verbose)
+		fprintf(stderr, "%s mismatch for length %zu: got %u\n",
+			name, len, got);
+	errors++;
+}
+
+/* The keys are put at the end of buffers so that reading past the end of
+ * a key would be caught by a memory checker, and at odd offsets to
+ * exercise unaligned loads
+ */
+static void test_compares(unsigned int count)
+{
+	__u8 *b1 = malloc(MAX_LEN + 1), *b2 = malloc(MAX_LEN + 1);
+	__u8 *bm = malloc(MAX_LEN + 1);
+	unsigned int i, j, bit;
+	size_t len;
+
+	if (!b1 || !b2 || !bm) {
+		fprintf(stderr, "Allocation failed\n");
+		exit(-1);
+	}
+
+	for (len = 1; len <= MAX_LEN; len++) {
+		__u8 *f1 = b1 + MAX_LEN + 1 - len;
+		__u8 *f2 = b2 + MAX_LEN + 1 - len;
+		__u8 *m = bm + MAX_LEN + 1 - len;
+
+		for (i = 0; i < count; i++) {
+			for (j = 0; j < len; j++) {
+				f1[j] = xrand();
+				m[j] = xrand() & xrand();
+			}
+			memcpy(f2, f1, len);
+
+			/* Flip a random bit in half the cases */
+			if (i & 1) {
+				bit = xrand() % (len * 8);
+				f2[bit / 8] ^= 0x80 >> (bit % 8);
+			}
+
+			check("equal", xdp2_compare_equal(f1, f2, len),
+			      ref_equal(f1, f2, len), len);
+			check("tern", xdp2_compare_tern(f1, f2, m, len),
+			      ref_tern(f1, f2, m, len), len);
+
+			bit = xrand() % (len * 8 + 1);
+			check("prefix", xdp2_compare_prefix(f1, f2, bit),
+			      ref_prefix(f1, f2, bit), len);
+		}
+	}
+
+	free(b1);
+	free(b2);
+	free(bm);
+}
+
+/* Benchmark functions are made for each key length so that the length is
+ * a compile time constant like it is in the table macros
+ */
+#define MAKE_BENCH(LEN)							\
+static void bench_##LEN(__u8 *keys, __u8 *masks, unsigned int count)	\
+{									\
+	unsigned long match = 0;					\
+	double start, ref_secs, secs;					\
+	unsigned int i;							\
+									\
+	start = now();							\
+	for (i = 0; i < count; i++)					\
+		match += ref_tern(&keys[(i % NUM_KEYS) * MAX_LEN],	\
+				  &keys[((i + 1) % NUM_KEYS) * MAX_LEN],\
+				  &masks[(i % NUM_KEYS) * MAX_LEN], LEN);\
+	ref_secs = now() - start;					\
+									\
+	start = now();							\
+	for (i = 0; i < count; i++)					\
+		match += xdp2_compare_tern(				\
+				&keys[(i % NUM_KEYS) * MAX_LEN],	\
+				&keys[((i + 1) % NUM_KEYS) * MAX_LEN],	\
+				&masks[(i % NUM_KEYS) * MAX_LEN], LEN);	\
+	secs = now() - start;						\
+									\
+	printf("tern %2u bytes: %5.2f nsecs byte compare, "		\
+	       "%5.2f nsecs word compare (%lu)\n", LEN,		\
+	       ref_secs * 1e9 / count, secs * 1e9 / count, match);	\
+}
+
+MAKE_BENCH(13)
+MAKE_BENCH(16)
+MAKE_BENCH(36)
+MAKE_BENCH(40)
+
+static void bench(unsigned int count)
+{
+	__u8 *keys = malloc(NUM_KEYS * MAX_LEN);
+	__u8 *masks = malloc(NUM_KEYS * MAX_LEN);
+	unsigned int i;
+
+	if (!keys || !masks) {
+		fprintf(stderr, "Allocation failed\n");
+		exit(-1);
+	}
+
+	/* Keys are mostly equal under the masks so that compares don't
+	 * stop at the first byte
+	 */
+	for (i = 0; i < NUM_KEYS * MAX_LEN; i++) {
+		keys[i] = xrand() & 0x1;
+		masks[i] = 0xfe | !(xrand() % 64);
+	}
+
+	bench_13(keys, masks, count);
+	bench_16(keys, masks, count);
+	bench_36(keys, masks, count);
+	bench_40(keys, masks, count);
+
+	free(keys);
+	free(masks);
+}
+
+#define ARGS "c:n:bv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-c <count>] [-n <bench_count>] [-b] [-v]\n",
+		name);
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int count = 1000, bench_count = 10000000;
+	bool bench_only = false;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			bench_count = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			bench_only = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!bench_only)
+		test_compares(count);
+
+	bench(bench_count);
+
+	printf("Tests done: %lu errors\n", errors);
+
+	return errors ? -1 : 0;
+}
@@ -0,0 +1,430 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Benchmark for ternary tables with a synthetic ACL
+ *
+ * Generates a classbench style rule set of 5-tuple rules (source and
+ * destination prefixes, exact, wildcard, or masked range ports, and exact
+ * or wildcard protocol) with the rule number as the position, and loads
+ * it into a ternary table using linear search and one using tuple space
+ * search. Lookup rates are measured for both and every TSS lookup is
+ * checked against the linear lookup, before and after deleting half of
+ * the rules.
+ *
+ * Run: ./test_acl [ -n <num-rules> ] [ -l <num-lookups> ]
+ *		   [ -L <num-linear-lookups> ] [ -r <seed> ] [ -v <verbose> ]
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/dtable.h"
+#include "xdp2/switch.h"
+#include "xdp2/utility.h"
+
+struct acl_key {
+	__be32 saddr;
+	__be32 daddr;
+	__be16 sport;
+	__be16 dport;
+	__u8 proto;
+	__u8 pad[3];
+};
+
+struct rule {
+	struct acl_key key;
+	struct acl_key mask;
+	__u32 action;
+	bool dup;
+};
+
+static int verbose;
+static __u64 rand_state = 88172645463325252ULL;
+
+static __u64 xrand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+
+	return rand_state;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Field distributions roughly following the classbench ACL seeds. Each
+ * entry is a value and a cumulative percentage
+ */
+static const unsigned int prefix_dist[][2] = {
+	{ 0, 15 }, { 16, 20 }, { 24, 45 }, { 32, 100 },
+};
+
+/* Port kinds: wildcard, well known exact port, random exact port, the
+ * ephemeral range 32768-65535 (a single masked range), and 1024-2047
+ */
+enum {
+	PORT_WC,
+	PORT_WELL_KNOWN,
+	PORT_EXACT,
+	PORT_HIGH,
+	PORT_RANGE,
+};
+
+static const unsigned int sport_dist[][2] = {
+	{ PORT_WC, 90 }, { PORT_HIGH, 100 },
+};
+
+static const unsigned int dport_dist[][2] = {
+	{ PORT_WC, 20 }, { PORT_WELL_KNOWN, 65 }, { PORT_EXACT, 75 },
+	{ PORT_HIGH, 90 }, { PORT_RANGE, 100 },
+};
+
+static const unsigned int proto_dist[][2] = {
+	{ 0, 15 }, { 6, 75 }, { 17, 95 }, { 1, 100 },
+};
+
+static const __u16 well_known_ports[] = {
+	20, 21, 22, 23, 25, 53, 80, 110, 123, 143, 161, 443, 993, 3306,
+};
+
+static unsigned int pick(const unsigned int (*dist)[2])
+{
+	unsigned int pct = xrand() % 100, i;
+
+	for (i = 0; dist[i][1] <= pct; i++)
+		;
+
+	return dist[i][0];
+}
+
+static __be32 prefix_mask(unsigned int prefix_len)
+{
+	return htonl(prefix_len ? ~0U << (32 - prefix_len) : 0);
+}
+
+static void make_port(__be16 *port, __be16 *mask, unsigned int kind)
+{
+	switch (kind) {
+	case PORT_WC:
+		*port = 0;
+		*mask = 0;
+		break;
+	case PORT_WELL_KNOWN:
+		*port = htons(well_known_ports[xrand() %
+					       ARRAY_SIZE(well_known_ports)]);
+		*mask = 0xffff;
+		break;
+	case PORT_EXACT:
+		*port = htons(xrand());
+		*mask = 0xffff;
+		break;
+	case PORT_HIGH:
+		*port = htons(0x8000);
+		*mask = htons(0x8000);
+		break;
+	case PORT_RANGE:
+		*port = htons(0x400);
+		*mask = htons(0xfc00);
+		break;
+	}
+}
+
+/* Addresses are drawn from a small pool of /16s so that rules overlap
+ * like in real ACLs
+ */
+static __be32 make_addr(void)
+{
+	return htonl((10 << 24) | ((xrand() % 64) << 16) | (xrand() & 0xffff));
+}
+
+static unsigned int mask_bits(const struct rule *r)
+{
+	const __u8 *m = (const __u8 *)&r->mask;
+	unsigned int i, bits = 0;
+
+	for (i = 0; i < sizeof(r->mask); i++)
+		bits += __builtin_popcount(m[i]);
+
+	return bits;
+}
+
+static int compare_rules(const void *a, const void *b)
+{
+	return (int)mask_bits(b) - (int)mask_bits(a);
+}
+
+/* Like in real ACLs more specific rules come first, so many packets are
+ * compared with a large part of the rules before they match
+ */
+static void make_rules(struct rule *rules, unsigned int num)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < num; i++) {
+		struct rule *r = &rules[i];
+		__u8 *k = (__u8 *)&r->key, *m = (__u8 *)&r->mask;
+
+		memset(r, 0, sizeof(*r));
+
+		r->mask.saddr = prefix_mask(pick(prefix_dist));
+		r->mask.daddr = prefix_mask(pick(prefix_dist));
+		r->key.saddr = make_addr();
+		r->key.daddr = make_addr();
+		make_port(&r->key.sport, &r->mask.sport, pick(sport_dist));
+		make_port(&r->key.dport, &r->mask.dport, pick(dport_dist));
+		r->key.proto = pick(proto_dist);
+		r->mask.proto = r->key.proto ? 0xff : 0;
+
+		for (j = 0; j < sizeof(r->key); j++)
+			k[j] &= m[j];
+	}
+
+	qsort(rules, num, sizeof(*rules), compare_rules);
+
+	for (i = 0; i < num; i++)
+		rules[i].action = i + 1;
+}
+
+/* Make a packet key. Most keys are made to match a random rule, the
+ * rest are random
+ */
+static void make_pkt(struct acl_key *key, struct rule *rules,
+		     unsigned int num)
+{
+	__u8 *k = (__u8 *)key;
+	unsigned int i;
+
+	memset(key, 0, sizeof(*key));
+	key->saddr = make_addr();
+	key->daddr = make_addr();
+	key->sport = htons(xrand());
+	key->dport = htons(xrand());
+	key->proto = pick(proto_dist) ? : 6;
+
+	if (xrand() % 4) {
+		struct rule *r = &rules[xrand() % num];
+		const __u8 *rk = (__u8 *)&r->key, *rm = (__u8 *)&r->mask;
+
+		for (i = 0; i < sizeof(*key); i++)
+			k[i] = (k[i] & ~rm[i]) | rk[i];
+	}
+}
+
+/* Number of distinct rule masks, that is the number of TSS subtables */
+static unsigned int count_masks(struct rule *rules, unsigned int num)
+{
+	unsigned int i, j, count = 0;
+
+	for (i = 0; i < num; i++) {
+		for (j = 0; j < i; j++)
+			if (!memcmp(&rules[i].mask, &rules[j].mask,
+				    sizeof(rules[i].mask)))
+				break;
+		count += (j == i);
+	}
+
+	return count;
+}
+
+static struct xdp2_dtable_tern_table *load_table(
+		const char *name, struct rule *rules, unsigned int num,
+		enum xdp2_dtable_tern_algo algo, unsigned int *dups)
+{
+	struct xdp2_dtable_tern_table *table;
+	__u32 miss = 0;
+	unsigned int i;
+	int ident = 0;
+	double start;
+	int err;
+
+	table = xdp2_dtable_create_tern(name, sizeof(struct acl_key), &miss,
+					sizeof(miss), &ident);
+	if (!table)
+		XDP2_ERR(1, "Create ternary table failed\n");
+
+	if (xdp2_dtable_set_tern_algo(table, algo))
+		XDP2_ERR(1, "Set ternary algorithm failed\n");
+
+	*dups = 0;
+	start = now();
+	for (i = 0; i < num; i++) {
+		err = xdp2_dtable_add_tern(table, 0, &rules[i].key,
+					   &rules[i].mask, i, &rules[i].action);
+		if (err == -EALREADY) {
+			rules[i].dup = true;
+			(*dups)++;
+		} else if (err < 0) {
+			XDP2_ERR(1, "Add rule %u failed: %d\n", i, err);
+		}
+	}
+	printf("%s insert: %u rules (%u duplicates) in %.3f secs\n", name,
+	       num, *dups, now() - start);
+
+	return table;
+}
+
+static void bench(const char *name, struct xdp2_dtable_tern_table *table,
+		  struct acl_key *pkts, unsigned int num)
+{
+	double start, elapsed;
+	unsigned int i;
+	__u32 sum = 0;
+
+	start = now();
+	for (i = 0; i < num; i++)
+		sum += *(const __u32 *)xdp2_dtable_lookup_tern(table,
+							       &pkts[i]);
+	elapsed = now() - start;
+	printf("%s lookup: %u lookups in %.3f secs, %.1f ns/lookup "
+	       "(checksum %u)\n", name, num, elapsed, elapsed * 1e9 / num,
+	       sum);
+}
+
+static unsigned int check(struct xdp2_dtable_tern_table *linear,
+			  struct xdp2_dtable_tern_table *tss,
+			  struct acl_key *pkts, unsigned int num)
+{
+	unsigned int i, errs = 0;
+	__u32 a1, a2;
+
+	for (i = 0; i < num; i++) {
+		a1 = *(const __u32 *)xdp2_dtable_lookup_tern(linear, &pkts[i]);
+		a2 = *(const __u32 *)xdp2_dtable_lookup_tern(tss, &pkts[i]);
+		if (a1 != a2) {
+			if (verbose >= 1)
+				printf("Mismatch @%u: linear %u TSS %u\n",
+				       i, a1, a2);
+			errs++;
+		}
+	}
+
+	return errs;
+}
+
+#define ARGS "n:l:L:r:v:"
+
+static void usage(char *prog)
+{
+	fprintf(stderr, "Usage: %s [ -n <num-rules> ] [ -l <num-lookups> ]\n"
+			"\t[ -L <num-linear-lookups> ] [ -r <seed> ] "
+			"[ -v <verbose> ]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int num_rules = 5000, num_lookups = 2000000;
+	unsigned int num_linear = 20000, dups, errs = 0, i;
+	struct xdp2_dtable_tern_table *linear, *tss;
+	struct acl_key *pkts;
+	struct rule *rules;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'n':
+			num_rules = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			num_lookups = strtoul(optarg, NULL, 10);
+			break;
+		case 'L':
+			num_linear = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			rand_state = strtoull(optarg, NULL, 0) ? : rand_state;
+			break;
+		case 'v':
+			verbose = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!num_rules || num_linear > num_lookups)
+		XDP2_ERR(1, "Bad arguments\n");
+
+	xdp2_dtable_init();
+
+	rules = calloc(num_rules, sizeof(*rules));
+	pkts = calloc(num_lookups, sizeof(*pkts));
+	if (!rules || !pkts)
+		XDP2_ERR(1, "Allocation failed\n");
+
+	make_rules(rules, num_rules);
+	printf("%u rules with %u distinct masks\n", num_rules,
+	       count_masks(rules, num_rules));
+	for (i = 0; i < num_lookups; i++)
+		make_pkt(&pkts[i], rules, num_rules);
+
+	linear = load_table("linear", rules, num_rules,
+			    XDP2_DTABLE_TERN_LINEAR, &dups);
+	tss = load_table("tss", rules, num_rules, XDP2_DTABLE_TERN_TSS,
+			 &dups);
+
+	if (verbose >= 10)
+		xdp2_dtable_print_all_tables();
+
+	bench("linear", linear, pkts, num_linear);
+	bench("tss", tss, pkts, num_lookups);
+
+	errs += check(linear, tss, pkts, num_linear);
+
+	/* Delete every other rule and check again */
+	for (i = 0; i < num_rules; i += 2) {
+		if (rules[i].dup)
+			continue;
+		xdp2_dtable_del_tern(linear, &rules[i].key, &rules[i].mask, i);
+		xdp2_dtable_del_tern(tss, &rules[i].key, &rules[i].mask, i);
+	}
+
+	errs += check(linear, tss, pkts, num_linear);
+
+	/* Building the index from a loaded table gives the same result */
+	if (xdp2_dtable_set_tern_algo(linear, XDP2_DTABLE_TERN_TSS))
+		XDP2_ERR(1, "Set ternary algorithm failed\n");
+
+	errs += check(linear, tss, pkts, num_linear);
+
+	printf("Checked %u lookups: %u mismatches\n", 3 * num_linear, errs);
+
+	free(pkts);
+	free(rules);
+
+	return !!errs;
+}
@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Benchmark for longest prefix match tables with a synthetic FIB
+ *
+ * Loads a dynamic LPM table with a full size synthetic routing table,
+ * measures insert, lookup, and delete rates, and verifies a sample of the
+ * lookups against a linear scan of the routes.
+ *
+ * Run: ./test_fib [ -6 ] [ -n <num-routes> ] [ -l <num-lookups> ]
+ *		   [ -c <num-checks> ] [ -r <seed> ] [ -v <verbose> ]
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/dtable.h"
+#include "xdp2/switch.h"
+#include "xdp2/utility.h"
+
+#define MAX_KEY_LEN 16
+
+struct route {
+	__u8 key[MAX_KEY_LEN];
+	unsigned int prefix_len;
+	__u32 nh;
+	bool dup;
+};
+
+static int verbose;
+static __u64 rand_state = 88172645463325252ULL;
+
+static __u64 xrand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+
+	return rand_state;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Prefix length distributions roughly matching the public IPv4 and IPv6
+ * routing tables. Each entry is a prefix length and a cumulative
+ * percentage
+ */
+static const unsigned int ipv4_dist[][2] = {
+	{ 8, 1 }, { 12, 2 }, { 14, 3 }, { 16, 6 }, { 17, 8 }, { 18, 11 },
+	{ 19, 16 }, { 20, 22 }, { 21, 28 }, { 22, 38 }, { 23, 45 },
+	{ 24, 98 }, { 28, 99 }, { 32, 100 },
+};
+
+static const unsigned int ipv6_dist[][2] = {
+	{ 19, 1 }, { 24, 3 }, { 28, 6 }, { 29, 10 }, { 32, 22 }, { 36, 26 },
+	{ 40, 32 }, { 44, 40 }, { 46, 44 }, { 47, 46 }, { 48, 90 },
+	{ 56, 93 }, { 64, 99 }, { 128, 100 },
+};
+
+static unsigned int pick_prefix_len(bool ipv6)
+{
+	const unsigned int (*dist)[2] = ipv6 ? ipv6_dist : ipv4_dist;
+	unsigned int pct = xrand() % 100, i;
+
+	for (i = 0; dist[i][1] <= pct; i++)
+		;
+
+	return dist[i][0];
+}
+
+/* Mask off bits of a key beyond the prefix length */
+static void mask_key(__u8 *key, size_t key_len, unsigned int prefix_len)
+{
+	unsigned int i;
+
+	for (i = 0; i < key_len; i++) {
+		if (prefix_len >= 8) {
+			prefix_len -= 8;
+			continue;
+		}
+		key[i] &= (__u8)(0xff << (8 - prefix_len));
+		prefix_len = 0;
+	}
+}
+
+static void make_routes(struct route *routes, unsigned int num,
+			size_t key_len, bool ipv6)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < num; i++) {
+		struct route *r = &routes[i];
+
+		for (j = 0; j < key_len; j++)
+			r->key[j] = xrand();
+
+		/* Cluster the routes in a part of the address space like
+		 * real tables do (1.0.0.0/8 to 223.0.0.0/8 for IPv4 and
+		 * 2000::/4 for IPv6)
+		 */
+		if (ipv6)
+			r->key[0] = 0x20 | (r->key[0] & 0x0f);
+		else
+			r->key[0] = 1 + r->key[0] % 223;
+
+		r->prefix_len = pick_prefix_len(ipv6);
+		r->nh = i + 1;
+		r->dup = false;
+		mask_key(r->key, key_len, r->prefix_len);
+	}
+}
+
+/* Make a lookup address. Half the addresses are taken from within routes
+ * so that most lookups hit, the rest are random
+ */
+static void make_addr(__u8 *addr, struct route *routes, unsigned int num,
+		      size_t key_len)
+{
+	unsigned int i;
+
+	if (xrand() & 1) {
+		struct route *r = &routes[xrand() % num];
+		__u8 mask[MAX_KEY_LEN];
+
+		memset(mask, 0xff, key_len);
+		mask_key(mask, key_len, r->prefix_len);
+		for (i = 0; i < key_len; i++)
+			addr[i] = (xrand() & ~mask[i]) | r->key[i];
+	} else {
+		for (i = 0; i < key_len; i++)
+			addr[i] = xrand();
+	}
+}
+
+/* Reference lookup by linear scan */
+static __u32 linear_lookup(struct route *routes, unsigned int num,
+			   const __u8 *addr)
+{
+	unsigned int i, longest = 0;
+	__u32 nh = 0;
+
+	for (i = 0; i < num; i++) {
+		if (routes[i].dup || (nh && routes[i].prefix_len <= longest))
+			continue;
+		if (xdp2_compare_prefix(routes[i].key, addr,
+					routes[i].prefix_len)) {
+			longest = routes[i].prefix_len;
+			nh = routes[i].nh;
+		}
+	}
+
+	return nh;
+}
+
+#define ARGS "6n:l:c:r:v:"
+
+static void usage(char *prog)
+{
+	fprintf(stderr, "Usage: %s [ -6 ] [ -n <num-routes> ] "
+			"[ -l <num-lookups> ]\n"
+			"\t[ -c <num-checks> ] [ -r <seed> ] "
+			"[ -v <verbose> ]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int num_routes = 0, num_lookups = 10000000;
+	unsigned int num_checks = 100, dups = 0, errs = 0;
+	struct xdp2_dtable_lpm_table *table;
+	__u8 addr[MAX_KEY_LEN], *addrs;
+	struct route *routes;
+	__u32 miss = 0, sum = 0;
+	int ident = 0, c, err;
+	bool ipv6 = false;
+	size_t key_len;
+	unsigned int i;
+	double start, elapsed;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case '6':
+			ipv6 = true;
+			break;
+		case 'n':
+			num_routes = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			num_lookups = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			num_checks = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			rand_state = strtoull(optarg, NULL, 0) ? : rand_state;
+			break;
+		case 'v':
+			verbose = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	key_len = ipv6 ? 16 : 4;
+	if (!num_routes)
+		num_routes = ipv6 ? 200000 : 950000;
+
+	xdp2_dtable_init();
+
+	table = xdp2_dtable_create_lpm("fib", key_len, &miss, sizeof(miss),
+				       &ident);
+	if (!table)
+		XDP2_ERR(1, "Create LPM table failed\n");
+
+	routes = calloc(num_routes, sizeof(*routes));
+	addrs = malloc(num_lookups * key_len);
+	if (!routes || !addrs)
+		XDP2_ERR(1, "Allocation failed\n");
+
+	make_routes(routes, num_routes, key_len, ipv6);
+	for (i = 0; i < num_lookups; i++)
+		make_addr(&addrs[i * key_len], routes, num_routes, key_len);
+
+	start = now();
+	for (i = 0; i < num_routes; i++) {
+		err = xdp2_dtable_add_lpm(table, num_routes - i,
+					  routes[i].key, routes[i].prefix_len,
+					  &routes[i].nh);
+		if (err == -EALREADY) {
+			routes[i].dup = true;
+			dups++;
+		} else if (err) {
+			XDP2_ERR(1, "Add route %u failed: %d\n", i, err);
+		}
+	}
+	elapsed = now() - start;
+	printf("Insert: %u routes (%u duplicates) in %.3f secs, "
+	       "%.1f ns/route\n", num_routes, dups, elapsed,
+	       elapsed * 1e9 / num_routes);
+
+	if (verbose >= 10)
+		xdp2_dtable_print_all_tables();
+
+	start = now();
+	for (i = 0; i < num_lookups; i++)
+		sum += *(const __u32 *)xdp2_dtable_lookup_lpm(table,
+						&addrs[i * key_len]);
+	elapsed = now() - start;
+	printf("Lookup: %u lookups in %.3f secs, %.1f ns/lookup "
+	       "(checksum %u)\n", num_lookups, elapsed,
+	       elapsed * 1e9 / num_lookups, sum);
+
+	for (i = 0; i < num_checks; i++) {
+		__u32 nh, rnh;
+
+		make_addr(addr, routes, num_routes, key_len);
+		nh = *(const __u32 *)xdp2_dtable_lookup_lpm(table, addr);
+		rnh = linear_lookup(routes, num_routes, addr);
+		if (nh != rnh) {
+			if (verbose >= 1)
+				printf("Mismatch @%u: got %u expected %u\n",
+				       i, nh, rnh);
+			errs++;
+		}
+	}
+
+	/* Delete every other route and check again */
+	start = now();
+	for (i = 0; i < num_routes; i += 2) {
+		if (routes[i].dup)
+			continue;
+		xdp2_dtable_del_lpm(table, routes[i].key,
+				    routes[i].prefix_len);
+		routes[i].dup = true;
+	}
+	printf("Delete: %u routes in %.3f secs\n", num_routes / 2,
+	       now() - start);
+
+	for (i = 0; i < num_checks; i++) {
+		__u32 nh, rnh;
+
+		make_addr(addr, routes, num_routes, key_len);
+		nh = *(const __u32 *)xdp2_dtable_lookup_lpm(table, addr);
+		rnh = linear_lookup(routes, num_routes, addr);
+		if (nh != rnh) {
+			if (verbose >= 1)
+				printf("Mismatch after delete @%u: got %u "
+				       "expected %u\n", i, nh, rnh);
+			errs++;
+		}
+	}
+
+	printf("Checked %u lookups: %u mismatches\n", 2 * num_checks, errs);
+
+	free(addrs);
+	free(routes);
+
+	return !!errs;
+}
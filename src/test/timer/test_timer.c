@@ -29,7 +29,13 @@
  *		      [ -I <report-interval> ][ -C <cli_port_num> ]
  *		      [-R] [ -s <sleep-time> ] [-P <prompt-color> ]
  *		      [ -n <num-timers> ] [ -t <num-threads>] [-u]
- *		      [ -T <time-units> ] [ -x <num-sub> ]
+ *		      [ -T <time-units> ] [ -x <num-sub> ] [-L]
+ *
+ * With -L a local timer wheel is tested. The main thread owns the wheel,
+ * it adds timers with delays covering all the levels of the wheel, advances
+ * the time, and runs the wheel. Each callback checks that its timer didn't
+ * fire early or late. The other threads (-t) remove random timers
+ * remotely. At the end all timers must have fired or been removed
  */
 
 #include <errno.h>
@@ -87,8 +93,14 @@ struct my_timer {
 	struct xdp2_timer timer;
 	unsigned int thread_num;
 	unsigned int timer_num;
+	unsigned long expire_time;
 };
 
+/* Local wheel test variables */
+static unsigned long last_run_time;
+static unsigned long local_expires;
+static unsigned long local_errors;
+
 /* Timer callback */
 static void callback(void *arg)
 {
@@ -98,6 +110,29 @@ static void callback(void *arg)
 		printf("Got timer %u:%u\n", mtim->thread_num, mtim->timer_num);
 }
 
+/* Timer callback for the local wheel test. The wheel is run every time
+ * the time is advanced so a timer must fire in the run after its
+ * expiration time is reached
+ */
+static void local_callback(void *arg)
+{
+	struct my_timer *mtim = arg;
+
+	local_expires++;
+
+	if (xdp2_seqno_ul_lt(my_time, mtim->expire_time)) {
+		fprintf(stderr, "Timer %u fired early: time %lu, expire time "
+				"%lu\n", mtim->timer_num, my_time,
+			mtim->expire_time);
+		local_errors++;
+	} else if (xdp2_seqno_ul_lte(mtim->expire_time, last_run_time)) {
+		fprintf(stderr, "Timer %u fired late: time %lu, expire time "
+				"%lu, last run %lu\n", mtim->timer_num,
+			my_time, mtim->expire_time, last_run_time);
+		local_errors++;
+	}
+}
+
 /* Manually advance time */
 static void advance_time(struct xdp2_timer_wheel *wheel,
 			 unsigned long adv)
@@ -224,6 +259,140 @@ static void run_test(unsigned long count, int num_timers,
 		pthread_join(test_id[i], NULL);
 }
 
+/* Local wheel test */
+
+static volatile bool local_done;
+static struct my_timer *local_timers;
+
+/* Remove random timers from a thread that doesn't own the wheel */
+static void *run_remote_removes(void *arg)
+{
+	struct test_add *test = arg;
+	unsigned int seed = test->thread_num;
+
+	while (!local_done) {
+		xdp2_timer_remove(main_wheel,
+			&local_timers[rand_r(&seed) % test->num_timers].timer);
+		usleep(rand_r(&seed) % clock_sleep_mod);
+	}
+
+	return NULL;
+}
+
+/* Get a random delay. Mostly short delays with some covering all the
+ * levels of the wheel
+ */
+static unsigned int random_delay(void)
+{
+	switch (rand() % 4) {
+	case 0:
+		return rand() % 16 + 1;
+	case 1:
+		return rand() % (4 * main_wheel->num_slots) + 1;
+	default:
+		return (rand() % (1U << (rand() % 31))) + 1;
+	}
+}
+
+static void run_local_test(unsigned long count, int num_timers,
+			   int num_threads, unsigned int interval)
+{
+	pthread_t test_id[MAX_THREADS];
+	struct test_add test[MAX_THREADS];
+	unsigned long i, adds = 0;
+	struct timespec start, end;
+	struct my_timer *mtim;
+	double secs;
+	int t;
+
+	main_wheel = xdp2_timer_create_local_wheel(7, NULL, get_current_time,
+						   NULL, 1);
+	local_timers = calloc(num_timers, sizeof(*local_timers));
+
+	for (i = 0; i < num_timers; i++) {
+		local_timers[i].timer_num = i;
+		local_timers[i].timer.callback = local_callback;
+		local_timers[i].timer.arg = &local_timers[i];
+	}
+
+	for (i = 0; i < num_threads; i++) {
+		test[i].num_timers = num_timers;
+		test[i].thread_num = i;
+		if (pthread_create(&test_id[i], NULL, run_remote_removes,
+				   &test[i])) {
+			perror("pthread_create failed");
+			exit(1);
+		}
+	}
+
+	last_run_time = my_time;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < count; i++) {
+		if (interval && (i % interval) == 0)
+			printf("L: %lu\n", i);
+
+		mtim = &local_timers[rand() % num_timers];
+
+		switch (rand() % 4) {
+		case 0:
+		case 1:
+			mtim->expire_time = my_time + random_delay();
+			xdp2_timer_add(main_wheel, &mtim->timer,
+				       mtim->expire_time - my_time);
+			adds++;
+			break;
+		case 2:
+			xdp2_timer_remove(main_wheel, &mtim->timer);
+			break;
+		case 3:
+		default:
+			my_time += rand() % 8 ? rand() % 64 :
+					rand() % (1U << (rand() % 24));
+			xdp2_run_timer_wheel(main_wheel);
+			last_run_time = my_time;
+			break;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	local_done = true;
+	for (i = 0; i < num_threads; i++)
+		pthread_join(test_id[i], NULL);
+
+	/* Advance past all the timers and run the wheel */
+	my_time += 1UL << 33;
+	xdp2_run_timer_wheel(main_wheel);
+
+	for (t = 0; t < num_timers; t++) {
+		if (local_timers[t].timer.timer_set) {
+			fprintf(stderr, "Timer %u still set at end of test\n",
+				t);
+			local_errors++;
+		}
+	}
+
+	if (main_wheel->timer_count) {
+		fprintf(stderr, "Timer count %u at end of test\n",
+			main_wheel->timer_count);
+		local_errors++;
+	}
+
+	secs = (end.tv_sec - start.tv_sec) +
+				(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("Local wheel: %lu ops, %lu adds, %lu expires in %.3f secs, "
+	       "%lu errors\n", count, adds, local_expires, secs, local_errors);
+
+	if (verbose)
+		xdp2_timer_show_wheel(main_wheel, NULL);
+
+	if (local_errors)
+		exit(1);
+}
+
 /* CLI commands */
 
 XDP2_CLI_MAKE_NUMBER_SET(verbose, verbose);
@@ -244,7 +413,7 @@ static void show_timers_all(void *cli,
 
 XDP2_CLI_ADD_SHOW_CONFIG("timers", show_timers_all, 0xffff);
 
-#define ARGS "c:v:I:C:Rs:P:t:T:n:x:u"
+#define ARGS "c:v:I:C:Rs:P:t:T:n:x:uL"
 
 static void *usage(char *prog)
 {
@@ -255,7 +424,7 @@ static void *usage(char *prog)
 	fprintf(stderr, "\t[-R] [ -s <sleep-time> ]\n");
 	fprintf(stderr, "\t[ -P <prompt-color> ] [ -n <num-timers> ]\n");
 	fprintf(stderr, "\t[ -t <num-threads> ] [-u] [ -T <time-units> ]\n");
-	fprintf(stderr, "\t[ -x <num-sub> ]\n");
+	fprintf(stderr, "\t[ -x <num-sub> ] [-L]\n");
 
 	exit(-1);
 }
@@ -268,6 +437,7 @@ int main(int argc, char *argv[])
 	unsigned long count = 1000000000;
 	const char *prompt_color = "";
 	bool use_timer_thread = false;
+	bool local_wheel = false;
 	unsigned int time_units = 1;
 	bool random_seed = false;
 	unsigned long time_sub;
@@ -304,6 +474,9 @@ int main(int argc, char *argv[])
 		case 'u':
 			use_timer_thread = true;
 			break;
+		case 'L':
+			local_wheel = true;
+			break;
 		case 'T':
 			time_units = strtol(optarg, NULL, 10);
 			break;
@@ -335,6 +508,11 @@ int main(int argc, char *argv[])
 		xdp2_cli_start(&cli_thread_info);
 	}
 
+	if (local_wheel) {
+		run_local_test(count, num_timers, num_threads, interval);
+		return 0;
+	}
+
 	run_test(count, num_timers, num_threads, interval, use_timer_thread,
 		 time_units);
 
@@ -0,0 +1,467 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2026 XDPnet Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/* Test and benchmark for the batched UDP communications handle operations
+ *
+ * Over loopback, batches of datagrams are sent with send_data_batch and
+ * received with recv_data_batch, GSO sends are checked with and without
+ * kernel GSO support and with GRO on the receiver, and a pvbuf with
+ * several pbufs is sent with a scatter-gather send. Then per packet sends
+ * are benchmarked against batched and GSO sends (-b to only run the
+ * benchmark)
+ */
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xdp2/pvbuf.h"
+#include "xdp2/udp_comm.h"
+#include "xdp2/utility.h"
+
+#define MAX_MSG_LEN	1400
+#define GRO_BUF_SIZE	65536
+
+static struct xdp2_comm_handle *tx, *rx;
+static struct in_addr rx_addr;
+static unsigned short rx_port, tx_port;
+static unsigned long errors;
+static bool verbose;
+
+static __u8 tx_buf[XDP2_COMM_BATCH_MAX * MAX_MSG_LEN];
+static __u8 rx_buf[XDP2_COMM_BATCH_MAX][GRO_BUF_SIZE];
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_random(__u8 *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = random();
+}
+
+static unsigned short socket_port(struct xdp2_comm_handle *comm)
+{
+	struct sockaddr_in sin;
+	socklen_t alen = sizeof(sin);
+
+	if (getsockname(comm->info, (struct sockaddr *)&sin, &alen) < 0) {
+		perror("getsockname");
+		exit(-1);
+	}
+
+	return sin.sin_port;
+}
+
+static void open_sockets(void)
+{
+	int size = 4 * 1024 * 1024;
+
+	tx = xdp2_udp_socket_start(0);
+	rx = xdp2_udp_socket_start(0);
+	if (!tx || !rx) {
+		fprintf(stderr, "Socket create failed\n");
+		exit(-1);
+	}
+
+	setsockopt(rx->info, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+	rx_addr.s_addr = htonl(INADDR_LOOPBACK);
+	rx_port = socket_port(rx);
+	tx_port = socket_port(tx);
+}
+
+/* Receive datagrams until total bytes have arrived and compare them with
+ * expect. Coalesced (GRO) receives are split into their segments and
+ * each segment is checked against the expected datagram lengths in lens.
+ * Returns the number of receive messages
+ */
+static unsigned int recv_check(const __u8 *expect, const size_t *lens,
+			       unsigned int num_lens, const char *label)
+{
+	struct xdp2_comm_msg msgs[XDP2_COMM_BATCH_MAX];
+	unsigned int i, j = 0, num_msgs = 0;
+	size_t off = 0, seg_off, seg_len;
+	int n;
+
+	while (j < num_lens) {
+		for (i = 0; i < XDP2_COMM_BATCH_MAX; i++) {
+			msgs[i].buff = rx_buf[i];
+			msgs[i].len = GRO_BUF_SIZE;
+		}
+
+		n = rx->recv_data_batch(rx, msgs, XDP2_COMM_BATCH_MAX, true);
+		if (n <= 0) {
+			fprintf(stderr, "%s: receive failed\n", label);
+			errors++;
+			return num_msgs;
+		}
+
+		for (i = 0; i < n; i++) {
+			num_msgs++;
+
+			if (msgs[i].port != tx_port) {
+				fprintf(stderr, "%s: bad source port\n",
+					label);
+				errors++;
+			}
+
+			/* Split a GRO receive into its datagrams */
+			for (seg_off = 0; seg_off < msgs[i].len;
+			     seg_off += seg_len, j++) {
+				seg_len = msgs[i].len - seg_off;
+				if (msgs[i].seg_size)
+					seg_len = xdp2_min(seg_len,
+						(size_t)msgs[i].seg_size);
+
+				if (j >= num_lens || seg_len != lens[j] ||
+				    memcmp(&rx_buf[i][seg_off], &expect[off],
+					   seg_len)) {
+					if (verbose)
+						fprintf(stderr, "%s: datagram "
+							"%u mismatch\n",
+							label, j);
+					errors++;
+					return num_msgs;
+				}
+				off += seg_len;
+			}
+		}
+	}
+
+	return num_msgs;
+}
+
+/* Send a batch of datagrams with random lengths */
+static void test_batch(unsigned int count)
+{
+	struct xdp2_comm_msg msgs[XDP2_COMM_BATCH_MAX];
+	size_t lens[XDP2_COMM_BATCH_MAX], off;
+	unsigned int i, j, num;
+	int n;
+
+	for (i = 0; i < count; i++) {
+		num = 1 + random() % XDP2_COMM_BATCH_MAX;
+		fill_random(tx_buf, sizeof(tx_buf));
+
+		for (off = 0, j = 0; j < num; j++) {
+			lens[j] = 1 + random() % MAX_MSG_LEN;
+			msgs[j].buff = &tx_buf[off];
+			msgs[j].len = lens[j];
+			msgs[j].addr = rx_addr;
+			msgs[j].port = rx_port;
+			msgs[j].seg_size = 0;
+			off += lens[j];
+		}
+
+		n = tx->send_data_batch(tx, msgs, num);
+		if (n != num) {
+			fprintf(stderr, "Batch send returned %d expected "
+				"%u\n", n, num);
+			errors++;
+			return;
+		}
+
+		recv_check(tx_buf, lens, num, "batch");
+	}
+}
+
+/* Send one GSO message of num_segs segments of seg_size bytes, the last
+ * one is short. Returns the number of receive messages it took
+ */
+static unsigned int gso_send_check(unsigned int num_segs,
+				   unsigned short seg_size, const char *label)
+{
+	size_t lens[XDP2_COMM_BATCH_MAX];
+	struct xdp2_comm_msg msg;
+	unsigned int i;
+
+	fill_random(tx_buf, sizeof(tx_buf));
+
+	for (i = 0; i < num_segs; i++)
+		lens[i] = seg_size;
+	lens[num_segs - 1] = seg_size / 2;
+
+	msg.buff = tx_buf;
+	msg.len = (num_segs - 1) * seg_size + seg_size / 2;
+	msg.addr = rx_addr;
+	msg.port = rx_port;
+	msg.seg_size = seg_size;
+
+	if (tx->send_data_batch(tx, &msg, 1) != 1) {
+		perror("GSO send");
+		errors++;
+		return 0;
+	}
+
+	return recv_check(tx_buf, lens, num_segs, label);
+}
+
+static void test_gso(void)
+{
+	unsigned int tx_flags = tx->flags, n;
+
+	printf("GSO %ssupported\n", tx->flags & XDP2_COMM_F_GSO ? "" : "not ");
+
+	if (tx->flags & XDP2_COMM_F_GSO) {
+		n = gso_send_check(11, 1000, "gso");
+		if (n != 11) {
+			fprintf(stderr, "GSO without GRO received %u "
+				"messages expected 11\n", n);
+			errors++;
+		}
+
+		if (!xdp2_udp_socket_set_gro(rx, true)) {
+			n = gso_send_check(11, 1000, "gso+gro");
+			printf("GSO with GRO received in %u message(s)\n", n);
+			xdp2_udp_socket_set_gro(rx, false);
+		}
+	}
+
+	/* Software segmentation fallback */
+	tx->flags &= ~XDP2_COMM_F_GSO;
+	n = gso_send_check(XDP2_COMM_BATCH_MAX, 500, "segs");
+	if (n != XDP2_COMM_BATCH_MAX) {
+		fprintf(stderr, "Segment fallback received %u messages "
+			"expected %u\n", n, XDP2_COMM_BATCH_MAX);
+		errors++;
+	}
+	tx->flags = tx_flags;
+}
+
+/* Send pvbufs made of several pbufs as single datagrams */
+static void test_pvbuf(unsigned int count)
+{
+	xdp2_paddr_t pvbuf_paddr, paddr;
+	struct xdp2_pvbuf *pvbuf;
+	unsigned int i, j, nfrags;
+	size_t total, flen;
+	ssize_t n;
+	void *data;
+
+	for (i = 0; i < count; i++) {
+		pvbuf_paddr = xdp2_pvbuf_alloc_empty(1, &pvbuf);
+		if (pvbuf_paddr == XDP2_PADDR_NULL) {
+			errors++;
+			return;
+		}
+
+		nfrags = 1 + random() % 8;
+		total = 0;
+		for (j = 0; j < nfrags; j++) {
+			flen = 1 + random() % 1000;
+			paddr = xdp2_pbuf_alloc(flen, &data);
+			fill_random(data, flen);
+			memcpy(&tx_buf[total], data, flen);
+			if (!__xdp2_pvbuf_append_paddr(&xdp2_pvbuf_global_mgr,
+						       pvbuf_paddr, paddr, 0,
+						       flen, false)) {
+				xdp2_pbuf_free(paddr);
+				break;
+			}
+			total += flen;
+		}
+
+		n = xdp2_udp_socket_send_pvbuf(tx, pvbuf_paddr, rx_addr,
+					       rx_port);
+		if (n != total) {
+			fprintf(stderr, "pvbuf send returned %ld expected "
+				"%lu\n", n, total);
+			errors++;
+		} else {
+			recv_check(tx_buf, &total, 1, "pvbuf");
+		}
+
+		xdp2_pvbuf_free(pvbuf_paddr);
+	}
+}
+
+enum bench_mode {
+	BENCH_SINGLE,
+	BENCH_BATCH,
+	BENCH_GSO,
+};
+
+static const char *bench_names[] = {
+	[BENCH_SINGLE] = "single",
+	[BENCH_BATCH] = "batch",
+	[BENCH_GSO] = "gso",
+};
+
+/* Send bursts of XDP2_COMM_BATCH_MAX datagrams and drain the receiver
+ * after each burst. Both sides are counted in the rate
+ */
+static void bench(enum bench_mode mode, unsigned long count, size_t len)
+{
+	struct xdp2_comm_msg msgs[XDP2_COMM_BATCH_MAX];
+	unsigned long sent = 0, received = 0;
+	unsigned int i, num;
+	double start, secs;
+	int n;
+
+	if (mode == BENCH_GSO && !(tx->flags & XDP2_COMM_F_GSO))
+		return;
+
+	start = now();
+
+	while (sent < count) {
+		num = XDP2_COMM_BATCH_MAX;
+
+		switch (mode) {
+		case BENCH_SINGLE:
+			for (i = 0; i < num; i++)
+				tx->send_data(tx, tx_buf, len, rx_addr,
+					      rx_port);
+			break;
+		case BENCH_BATCH:
+			for (i = 0; i < num; i++) {
+				msgs[i].buff = tx_buf;
+				msgs[i].len = len;
+				msgs[i].addr = rx_addr;
+				msgs[i].port = rx_port;
+				msgs[i].seg_size = 0;
+			}
+			tx->send_data_batch(tx, msgs, num);
+			break;
+		case BENCH_GSO:
+			msgs[0].buff = tx_buf;
+			msgs[0].len = num * len;
+			msgs[0].addr = rx_addr;
+			msgs[0].port = rx_port;
+			msgs[0].seg_size = len;
+			tx->send_data_batch(tx, msgs, 1);
+			break;
+		}
+		sent += num;
+
+		do {
+			for (i = 0; i < XDP2_COMM_BATCH_MAX; i++) {
+				msgs[i].buff = rx_buf[i];
+				msgs[i].len = GRO_BUF_SIZE;
+			}
+			n = rx->recv_data_batch(rx, msgs,
+						XDP2_COMM_BATCH_MAX, false);
+			if (n > 0)
+				received += n;
+		} while (n > 0);
+	}
+
+	secs = now() - start;
+
+	printf("%-8s %6lu %8.3f Mpps sent %8.3f Mpps received\n",
+	       bench_names[mode], len, sent / secs / 1e6,
+	       received / secs / 1e6);
+}
+
+#define ARGS "c:n:l:bv"
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage: %s [-c <count>] [-n <bench_pkts>] ", name);
+	fprintf(stderr, "[-l <bench_len>] [-b] [-v]\n");
+
+	exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct xdp2_pbuf_init_allocator pbuf_allocs = {
+		.obj[5].num_objs = 1024,
+	};
+	struct xdp2_pvbuf_init_allocator pvbuf_allocs = {
+		.obj[1].num_pvbufs = 64,
+	};
+	unsigned long bench_pkts = 1000000;
+	bool bench_only = false;
+	unsigned int count = 100;
+	size_t bench_len = 64;
+	int c;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			bench_pkts = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			bench_len = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			bench_only = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!bench_len || bench_len > MAX_MSG_LEN) {
+		fprintf(stderr, "Benchmark length must be 1 to %u\n",
+			MAX_MSG_LEN);
+		exit(-1);
+	}
+
+	open_sockets();
+
+	if (!bench_only) {
+		test_batch(count);
+		test_gso();
+
+		if (xdp2_pvbuf_init(&pbuf_allocs, &pvbuf_allocs, false, false,
+				    NULL, NULL)) {
+			fprintf(stderr, "pvbuf init failed\n");
+			exit(-1);
+		}
+		test_pvbuf(count);
+
+		printf("Tests done: %lu errors\n", errors);
+	}
+
+	if (bench_pkts) {
+		bench(BENCH_SINGLE, bench_pkts, bench_len);
+		bench(BENCH_BATCH, bench_pkts, bench_len);
+		bench(BENCH_GSO, bench_pkts, bench_len);
+	}
+
+	return errors ? -1 : 0;
+}
@@ -31,7 +31,13 @@ public:
                 boost::program_options::value<std::vector<std::string>>()
                     ->multitoken(),
                 "Additional include directories to use")(
-                "resource-path", boost::program_options::value<std::string>(), "CLANG's resource path");
+                "resource-path", boost::program_options::value<std::string>(), "CLANG's resource path")(
+                "pgo-instrument",
+                "Count the hits on each parse graph edge in the generated .c parser, see xdp2/pgo.h")(
+                "profile,p", boost::program_options::value<std::string>(),
+                "Edge profile from an instrumented parser used to optimize the generated .c parser")(
+                "iterative",
+                "Generate the .c parser as one function that jumps between parse nodes instead of a function per node");
 
             boost::program_options::store(
                 boost::program_options::parse_command_line(argc, argv,
@@ -522,7 +522,10 @@ void show_py_exception()
  */
 int generate_root_parser_c(std::string filename, std::string output,
                            graph_t graph, std::vector<parser<graph_t>> roots,
-                           clang_ast::metadata_record record)
+                           clang_ast::metadata_record record,
+                           bool pgo_instrument = false,
+                           std::string pgo_profile = "",
+                           bool codegen_iterative = false)
 {
     {
         auto ptr = [](auto *p) { PyMem_RawFree(p); };
@@ -570,7 +573,8 @@ int generate_root_parser_c(std::string filename, std::string output,
 
             call_function(generate_parser_entry_function, filename, output,
                           py_graph.get(), py_roots.get(),
-                          py_metadata_record.get(), template_str.c_str());
+                          py_metadata_record.get(), template_str.c_str(),
+                          pgo_instrument, pgo_profile, codegen_iterative);
         }
     }
 
@@ -437,9 +437,19 @@ int main(int argc, char *argv[])
                        ".c") {
                 output_basename =
                     output.substr(std::max(output.size() - 2, 0ul));
+                bool pgo_instrument =
+                    xdp2gen_input_handler.verify_flag_existence(
+                        "pgo-instrument");
+                bool codegen_iterative =
+                    xdp2gen_input_handler.verify_flag_existence("iterative");
+                std::string pgo_profile;
+
+                xdp2gen_input_handler.get_flag_value("profile", pgo_profile);
+
                 try {
                     auto res = xdp2gen::python::generate_root_parser_c(
-                        filename, output, graph, roots, record);
+                        filename, output, graph, roots, record,
+                        pgo_instrument, pgo_profile, codegen_iterative);
 
                     if (res != 0) {
                         plog::log(std::cout)
@@ -1242,13 +1242,205 @@ from textwrap import dedent
 from pathlib import Path
 import sys
 
+# Profile guided optimization
+#
+# A profile written by an instrumented parser (see xdp2/pgo.h) gives the
+# number of times each edge of the parse graph was taken. Per node, the out
+# edges are tested in decreasing order of hits and the hottest edge gets a
+# __builtin_expect test ahead of the switch when it carries at least
+# PGO_LIKELY_RATIO of the packets leaving the node. The nodes on the fast
+# path, found by following the hottest edge from the root, are inlined into
+# their callers and nodes never reached in the profile are outlined as cold
+PGO_LIKELY_RATIO = 0.5
+
+PGO_ATTR_INLINE = '__attribute__((always_inline, hot)) '
+PGO_ATTR_HOT = '__attribute__((hot)) '
+PGO_ATTR_COLD = '__attribute__((noinline, cold)) '
+
+def pgo_load_profile(path: str):
+  profile = {}
+
+  with open(Path(path)) as f:
+    for num, line in enumerate(f, 1):
+      fields = line.split('#', 1)[0].split()
+      if not fields:
+        continue
+      if len(fields) != 4 or not fields[3].isdigit():
+        raise ValueError(f"{path}:{num}: expected "
+                         "'<parser> <from node> <to node> <hits>'")
+      parser, src, dst, hits = fields
+      edges = profile.setdefault(parser, {})
+      edges[(src, dst)] = edges.get((src, dst), 0) + int(hits)
+
+  return profile
+
+def pgo_successors(graph, name: str):
+  targets = []
+
+  for edge in graph[name]['out_edges']:
+    if edge['target'] not in targets:
+      targets.append(edge['target'])
+
+  wildcard = graph[name]['wildcard_proto_node']
+  if len(wildcard) != 0 and wildcard not in targets:
+    targets.append(wildcard)
+
+  return targets
+
+def pgo_reachable(graph, name: str):
+  seen = set()
+  stack = [name]
+
+  while stack:
+    name = stack.pop()
+    if name in seen or name not in graph:
+      continue
+    seen.add(name)
+    stack.extend(pgo_successors(graph, name))
+
+  return seen
+
+def pgo_in_cycle(graph, name: str):
+  return any(name in pgo_reachable(graph, target)
+             for target in pgo_successors(graph, name))
+
+def pgo_fast_path(graph, root: str, hits):
+  path = [root]
+
+  while True:
+    name = path[-1]
+    best = None
+    for target in pgo_successors(graph, name):
+      if hits.get((name, target), 0) > hits.get((name, best), 0):
+        best = target
+    if best is None or best in path:
+      return path
+    path.append(best)
+
+def pgo_annotate_parser(graph, root, instrument: bool, hits):
+  parser = root['parser_name']
+  reachable = pgo_reachable(graph, root['node_name'])
+  fast_path = pgo_fast_path(graph, root['node_name'], hits) if hits else []
+  reached = set(dst for (src, dst), count in hits.items() if count)
+  nodes = {}
+
+  for name in graph:
+    edges = graph[name]['out_edges']
+    targets = pgo_successors(graph, name)
+    hit = lambda edge: hits.get((name, edge['target']), 0)
+    ordered = sorted(edges, key=lambda edge: -hit(edge))
+    total = sum(hits.get((name, target), 0) for target in targets)
+    likely = None
+    attr = ''
+
+    # Only hint an edge when it is the single way to reach its target,
+    # the profile can't tell which of several keys was matched
+    if (ordered and hit(ordered[0]) and
+        hit(ordered[0]) >= total * PGO_LIKELY_RATIO and
+        [e['target'] for e in edges].count(ordered[0]['target']) == 1):
+      likely = ordered[0]
+      ordered = ordered[1:]
+
+    if name in fast_path:
+      # always_inline can't be used on a cycle of the graph
+      attr = PGO_ATTR_HOT if pgo_in_cycle(graph, name) else PGO_ATTR_INLINE
+    elif (hits and name in reachable and name != root['node_name'] and
+          name not in reached):
+      attr = PGO_ATTR_COLD
+
+    nodes[name] = {
+      'edges': ordered,
+      'likely': likely,
+      'attr': attr,
+      'inline': '' if attr == PGO_ATTR_COLD else 'inline ',
+      'targets': targets if instrument and name in reachable else [],
+    }
+
+  return nodes
+
+def pgo_report(graph, root, hits, nodes):
+  parser = root['parser_name']
+  name = root['node_name']
+  total = sum(hits.get((name, target), 0)
+              for target in pgo_successors(graph, name))
+
+  if not total:
+    print(f"PGO: {parser}: no profile data, parser not optimized",
+          file=sys.stderr)
+    return
+
+  path = pgo_fast_path(graph, name, hits)
+  steps = [path[0]]
+  for src, dst in zip(path, path[1:]):
+    share = 100.0 * hits[(src, dst)] / total
+    steps.append(f"{dst} [{share:.1f}%]")
+
+  inlined = [n for n in nodes.values() if n['attr'] == PGO_ATTR_INLINE]
+  cold = [n for n in nodes.values() if n['attr'] == PGO_ATTR_COLD]
+  hinted = [n for n in nodes.values() if n['likely']]
+
+  print(f"PGO: {parser}: {total} packets profiled")
+  print(f"PGO: {parser}: fast path " + ' -> '.join(steps))
+  print(f"PGO: {parser}: {len(inlined)} inlined, {len(cold)} cold, " +
+        f"{len(hinted)} hinted nodes")
+
+def pgo_annotate(graph, roots, instrument: bool, profile, report: bool):
+  pgo = {}
+
+  for (parser, (src, dst)) in ((p, e) for p in profile for e in profile[p]):
+    if src not in graph or dst not in pgo_successors(graph, src):
+      print(f"PGO: {parser}: ignoring unknown edge {src} -> {dst} "
+            "in profile", file=sys.stderr)
+
+  for root in roots:
+    hits = profile.get(root['parser_name'], {})
+    pgo[root['parser_name']] = pgo_annotate_parser(graph, root,
+                                                    instrument, hits)
+    if report:
+      pgo_report(graph, root, hits, pgo[root['parser_name']])
+
+  return pgo
+
+# Iterative code generation
+#
+# Instead of a function per parse node that calls the function of the next
+# node, the parse graph of a parser is generated as one function with a
+# label per node and a goto for each edge. Nodes are laid out in the order
+# a packet is expected to visit them: the profiled fast path first, then
+# the rest of the graph depth first, with nodes never reached in the
+# profile last
+def layout_nodes(graph, root: str, hits):
+  fast_path = pgo_fast_path(graph, root, hits) if hits else [root]
+  order = list(fast_path)
+  stack = [root]
+
+  while stack:
+    name = stack.pop()
+    if name not in graph:
+      continue
+    if name not in order:
+      order.append(name)
+    for target in reversed(pgo_successors(graph, name)):
+      if target not in order and target not in stack:
+        stack.append(target)
+
+  if hits:
+    reached = set(dst for (src, dst), count in hits.items() if count)
+    cold = [n for n in order if n != root and n not in reached]
+    order = [n for n in order if n not in cold] + cold
+
+  return order
+
 def generate_parser_function(
     filename: str,
     output: str,
     graph,
     roots,
     metadata_record,
-    template_str: str
+    template_str: str,
+    pgo_instrument: bool = False,
+    pgo_profile: str = '',
+    codegen_iterative: bool = False
 ):
   # Debug: print graph vertex info
   print(f"[Python template] Graph has {len(graph)} vertices", file=sys.stderr)
@@ -1260,7 +1452,15 @@ def generate_parser_function(
       for edge in out_edges:
         print(f"[Python template]     -> {edge.get('target', 'unknown')} key={edge.get('macro_name', 'N/A')}", file=sys.stderr)
 
+  profile = pgo_load_profile(pgo_profile) if pgo_profile else {}
+  pgo = pgo_annotate(graph, roots, pgo_instrument, profile, bool(pgo_profile))
+  layout = {}
+
+  for root in roots:
+    layout[root['parser_name']] = layout_nodes(
+        graph, root['node_name'], profile.get(root['parser_name'], {}))
+
   with open(Path(output), 'w') as f:
     template = Template(template_str)
-    f.write(dedent(template(roots=roots, graph=graph, filename=filename, metadata_record=metadata_record)))
+    f.write(dedent(template(roots=roots, graph=graph, filename=filename, metadata_record=metadata_record, pgo=pgo, pgo_instrument=pgo_instrument, layout=layout, codegen_iterative=codegen_iterative)))
 )";